@@ -0,0 +1,137 @@
+//
+// AliasTable.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Darts, Dice, and Coins: Sampling from a Discrete Distribution (http://www.keithschwarz.com/darts-dice-coins)
+//
+
+#include "AliasTable.h"
+
+#pragma region Init
+
+AliasTable::AliasTable()
+{
+	m_fTotalWeight = 0.0f;
+}
+
+AliasTable::~AliasTable()
+{
+}
+
+bool AliasTable::Initialize(const float* weights, int iCount)
+{
+	m_probabilities.clear();
+	m_aliases.clear();
+	m_fTotalWeight = 0.0f;
+
+	if (weights == nullptr || iCount <= 0)
+	{
+		return false;
+	}
+
+	// Accumulate in double so that thousands of small triangle areas do not lose precision
+	double totalWeight = 0.0;
+	for (int i = 0; i < iCount; i++)
+	{
+		if (weights[i] < 0.0f)
+		{
+			return false;
+		}
+		totalWeight += weights[i];
+	}
+	if (totalWeight <= 0.0)
+	{
+		return false;
+	}
+
+	m_probabilities.resize(iCount);
+	m_aliases.resize(iCount);
+	m_fTotalWeight = (float)totalWeight;
+
+	// Scale the weights so that the average column holds exactly 1
+	std::vector<double> scaledWeights(iCount);
+	std::vector<int> small;
+	std::vector<int> large;
+	small.reserve(iCount);
+	large.reserve(iCount);
+
+	for (int i = 0; i < iCount; i++)
+	{
+		scaledWeights[i] = weights[i] * iCount / totalWeight;
+		if (scaledWeights[i] < 1.0)
+		{
+			small.push_back(i);
+		}
+		else
+		{
+			large.push_back(i);
+		}
+	}
+
+	// Vose's method: fill each underfull column with the excess of an overfull one
+	while (!small.empty() && !large.empty())
+	{
+		int iSmall = small.back();
+		small.pop_back();
+		int iLarge = large.back();
+
+		m_probabilities[iSmall] = (float)scaledWeights[iSmall];
+		m_aliases[iSmall] = iLarge;
+
+		scaledWeights[iLarge] = (scaledWeights[iLarge] + scaledWeights[iSmall]) - 1.0;
+		if (scaledWeights[iLarge] < 1.0)
+		{
+			large.pop_back();
+			small.push_back(iLarge);
+		}
+	}
+
+	// Whatever is left is full up to rounding error
+	for (int i : large)
+	{
+		m_probabilities[i] = 1.0f;
+		m_aliases[i] = i;
+	}
+	for (int i : small)
+	{
+		m_probabilities[i] = 1.0f;
+		m_aliases[i] = i;
+	}
+
+	return true;
+}
+
+#pragma endregion
+
+#pragma region Getters
+
+int AliasTable::GetCount() const
+{
+	return (int)m_probabilities.size();
+}
+
+float AliasTable::GetTotalWeight() const
+{
+	return m_fTotalWeight;
+}
+
+#pragma endregion
+
+#pragma region Sample
+
+int AliasTable::Sample(float fU1, float fU2) const
+{
+	int iCount = (int)m_probabilities.size();
+
+	// Pick a column uniformly, then either keep it or take its alias
+	int i = (int)(fU1 * iCount);
+	if (i >= iCount)
+	{
+		i = iCount - 1;
+	}
+
+	return (fU2 < m_probabilities[i]) ? i : m_aliases[i];
+}
+
+#pragma endregion
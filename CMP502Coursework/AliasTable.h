@@ -0,0 +1,33 @@
+//
+// AliasTable.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Darts, Dice, and Coins: Sampling from a Discrete Distribution (http://www.keithschwarz.com/darts-dice-coins)
+//
+
+#ifndef ALIAS_TABLE_H
+#define ALIAS_TABLE_H
+
+#include <vector>
+
+// Walker alias table for sampling an index in O(1) with probability proportional to its weight
+class AliasTable
+{
+public:
+	AliasTable();
+	~AliasTable();
+
+	bool Initialize(const float* weights, int iCount);
+	int Sample(float fU1, float fU2) const; // fU1 and fU2 are uniform random numbers in [0, 1)
+
+	int GetCount() const;
+	float GetTotalWeight() const;
+
+private:
+	std::vector<float> m_probabilities;	// Probability of keeping the column instead of taking its alias
+	std::vector<int> m_aliases;
+	float m_fTotalWeight;
+};
+
+#endif
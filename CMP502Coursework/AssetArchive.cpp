@@ -0,0 +1,544 @@
+//
+// AssetArchive.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// LZ4 Block Format Description (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md)
+// FNV Hash (http://www.isthe.com/chongo/tech/comp/fnv/index.html)
+//
+
+#include "AssetArchive.h"
+#include <atomic>
+#include <cstring>
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const unsigned int ArchiveMagic = 0x4B415041; // "APAK"
+	const unsigned int ArchiveVersion = 1;
+
+	size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+#pragma region Init
+
+AssetArchive::AssetArchive()
+{
+	m_mappedData = nullptr;
+	m_mappedSize = 0;
+#ifdef _WIN32
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = nullptr;
+#endif
+	m_pHeader = nullptr;
+	m_slots = nullptr;
+	m_entries = nullptr;
+	m_chunks = nullptr;
+	m_names = nullptr;
+}
+
+AssetArchive::~AssetArchive()
+{
+	Close();
+}
+
+bool AssetArchive::Open(const char* filename)
+{
+	Close();
+
+	if (!MapFile(filename) || !Validate())
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void AssetArchive::Close()
+{
+#ifdef _WIN32
+	if (m_mappedData)
+	{
+		UnmapViewOfFile(m_mappedData);
+	}
+	if (m_hMapping)
+	{
+		CloseHandle(m_hMapping);
+	}
+	if (m_hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hFile);
+	}
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = nullptr;
+#else
+	if (m_mappedData)
+	{
+		munmap((void*)m_mappedData, m_mappedSize);
+	}
+#endif
+	m_mappedData = nullptr;
+	m_mappedSize = 0;
+	m_pHeader = nullptr;
+	m_slots = nullptr;
+	m_entries = nullptr;
+	m_chunks = nullptr;
+	m_names = nullptr;
+}
+
+bool AssetArchive::MapFile(const char* filename)
+{
+#ifdef _WIN32
+	m_hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_hFile, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(Header) || (unsigned long long)fileSize.QuadPart > (size_t)-1)
+	{
+		return false;
+	}
+
+	m_hMapping = CreateFileMapping(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_hMapping)
+	{
+		return false;
+	}
+
+	m_mappedData = (const unsigned char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!m_mappedData)
+	{
+		return false;
+	}
+	m_mappedSize = (size_t)fileSize.QuadPart;
+#else
+	int fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat fileInfo;
+	if (fstat(fd, &fileInfo) != 0 || fileInfo.st_size < (off_t)sizeof(Header))
+	{
+		close(fd);
+		return false;
+	}
+
+	// The mapping keeps its own reference to the file
+	void* data = mmap(nullptr, (size_t)fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+	m_mappedData = (const unsigned char*)data;
+	m_mappedSize = (size_t)fileInfo.st_size;
+#endif
+
+	return true;
+}
+
+bool AssetArchive::Validate()
+{
+	// Everything is checked up front so that lookups and loads can trust the table of contents
+	const Header* pHeader = (const Header*)m_mappedData;
+	if (pHeader->uiMagic != ArchiveMagic || pHeader->uiVersion != ArchiveVersion)
+	{
+		return false;
+	}
+
+	unsigned int uiSlotCount = pHeader->uiSlotCount;
+	if (uiSlotCount == 0 || (uiSlotCount & (uiSlotCount - 1)) != 0 || uiSlotCount < (unsigned long long)pHeader->uiEntryCount * 2)
+	{
+		return false;
+	}
+
+	unsigned long long ullTableSize = sizeof(Header) + (unsigned long long)uiSlotCount * sizeof(unsigned int) + (unsigned long long)pHeader->uiEntryCount * sizeof(Entry) + (unsigned long long)pHeader->uiChunkCount * sizeof(Chunk) + pHeader->uiNamesSize;
+	if (ullTableSize > m_mappedSize)
+	{
+		return false;
+	}
+
+	m_pHeader = pHeader;
+	m_slots = (const unsigned int*)(m_mappedData + sizeof(Header));
+	m_entries = (const Entry*)(m_slots + uiSlotCount);
+	m_chunks = (const Chunk*)(m_entries + pHeader->uiEntryCount);
+	m_names = (const char*)(m_chunks + pHeader->uiChunkCount);
+
+	// Probes end at an empty slot, so there must be some
+	unsigned int uiUsedSlots = 0;
+	for (unsigned int i = 0; i < uiSlotCount; i++)
+	{
+		if (m_slots[i] > pHeader->uiEntryCount)
+		{
+			return false;
+		}
+		uiUsedSlots += (m_slots[i] != 0) ? 1 : 0;
+	}
+	if (uiUsedSlots > pHeader->uiEntryCount)
+	{
+		return false;
+	}
+
+	for (unsigned int i = 0; i < pHeader->uiEntryCount; i++)
+	{
+		const Entry& entry = m_entries[i];
+		if ((unsigned long long)entry.uiNameOffset + entry.uiNameLength > pHeader->uiNamesSize ||
+			entry.ullDataOffset > m_mappedSize || entry.ullDataOffset % Alignment != 0)
+		{
+			return false;
+		}
+
+		if (entry.ullSize > (unsigned long long)pHeader->uiChunkCount * ChunkSize)
+		{
+			return false;
+		}
+
+		unsigned long long ullChunkCount = (entry.ullSize + ChunkSize - 1) / ChunkSize;
+		if (entry.uiFirstChunk + ullChunkCount > pHeader->uiChunkCount)
+		{
+			return false;
+		}
+
+		for (unsigned long long j = 0; j < ullChunkCount; j++)
+		{
+			const Chunk& chunk = m_chunks[entry.uiFirstChunk + j];
+			unsigned long long ullChunkSize = (std::min)((unsigned long long)ChunkSize, entry.ullSize - j * ChunkSize);
+			if (entry.ullDataOffset + chunk.uiOffset + chunk.uiCompressedSize > m_mappedSize ||
+				(entry.uiStored && (chunk.uiOffset != j * ChunkSize || chunk.uiCompressedSize != ullChunkSize)))
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+#pragma endregion
+
+#pragma region Getters
+
+bool AssetArchive::Contains(const char* name) const
+{
+	return Find(name) != nullptr;
+}
+
+size_t AssetArchive::GetSize(const char* name) const
+{
+	const Entry* pEntry = Find(name);
+	return pEntry ? (size_t)pEntry->ullSize : 0;
+}
+
+int AssetArchive::GetEntryCount() const
+{
+	return m_pHeader ? (int)m_pHeader->uiEntryCount : 0;
+}
+
+std::string AssetArchive::GetEntryName(int iEntry) const
+{
+	const Entry& entry = m_entries[iEntry];
+	return std::string(m_names + entry.uiNameOffset, entry.uiNameLength);
+}
+
+const AssetArchive::Entry* AssetArchive::Find(const char* name) const
+{
+	if (!m_pHeader)
+	{
+		return nullptr;
+	}
+
+	std::string normalizedName = NormalizeName(name);
+	unsigned long long ullHash = HashName(normalizedName);
+	unsigned int uiMask = m_pHeader->uiSlotCount - 1;
+
+	// The table is at most half full, so an empty slot always ends the probe
+	for (unsigned int uiSlot = (unsigned int)ullHash & uiMask; m_slots[uiSlot] != 0; uiSlot = (uiSlot + 1) & uiMask)
+	{
+		const Entry& entry = m_entries[m_slots[uiSlot] - 1];
+		if (entry.ullNameHash != ullHash || entry.uiNameLength != normalizedName.size())
+		{
+			continue;
+		}
+
+		const char* entryName = m_names + entry.uiNameOffset;
+		size_t i = 0;
+		while (i < normalizedName.size() && NormalizeChar(entryName[i]) == normalizedName[i])
+		{
+			i++;
+		}
+		if (i == normalizedName.size())
+		{
+			return &entry;
+		}
+	}
+
+	return nullptr;
+}
+
+std::string AssetArchive::NormalizeName(const char* name)
+{
+	std::string normalizedName(name);
+	for (auto& c : normalizedName)
+	{
+		c = NormalizeChar(c);
+	}
+	return normalizedName;
+}
+
+char AssetArchive::NormalizeChar(char c)
+{
+	return (c == '\\') ? '/' : (char)tolower((unsigned char)c);
+}
+
+unsigned long long AssetArchive::HashName(const std::string& name)
+{
+	unsigned long long ullHash = 14695981039346656037ull;
+	for (char c : name)
+	{
+		ullHash = (ullHash ^ (unsigned char)c) * 1099511628211ull;
+	}
+	return ullHash;
+}
+
+#pragma endregion
+
+#pragma region Load
+
+const unsigned char* AssetArchive::Load(const char* name, size_t* pSize, std::vector<unsigned char>& buffer, int iThreadCount) const
+{
+	const Entry* pEntry = Find(name);
+	if (!pEntry)
+	{
+		return nullptr;
+	}
+
+	const unsigned char* data = m_mappedData + pEntry->ullDataOffset;
+	size_t size = (size_t)pEntry->ullSize;
+	if (pSize)
+	{
+		*pSize = size;
+	}
+	if (pEntry->uiStored)
+	{
+		return data;
+	}
+
+	// Chunks decompress straight from the mapping into their place in the buffer, several at once
+	buffer.resize(size);
+	int iChunkCount = (int)((size + ChunkSize - 1) / ChunkSize);
+	std::atomic<bool> bFailed(false);
+	Utils::ParallelFor(iChunkCount, iThreadCount, [&](int iBegin, int iEnd)
+	{
+		for (int i = iBegin; i < iEnd && !bFailed; i++)
+		{
+			const Chunk& chunk = m_chunks[pEntry->uiFirstChunk + i];
+			size_t chunkSize = (std::min)((size_t)ChunkSize, size - (size_t)i * ChunkSize);
+			unsigned char* output = buffer.data() + (size_t)i * ChunkSize;
+			if (chunk.uiCompressedSize == chunkSize)
+			{
+				memcpy(output, data + chunk.uiOffset, chunkSize);
+			}
+			else if (!LZCompressor::Decompress(data + chunk.uiOffset, chunk.uiCompressedSize, output, chunkSize))
+			{
+				bFailed = true;
+			}
+		}
+	}, 2);
+
+	return bFailed ? nullptr : buffer.data();
+}
+
+#pragma endregion
+
+#pragma region Build
+
+bool AssetArchive::Build(const char* directory, const char* filename, int iThreadCount, ArchiveStats* pStats)
+{
+	std::vector<std::string> filenames;
+	if (!Utils::ListFiles(directory, filenames))
+	{
+		return false;
+	}
+
+	// Read every file
+	struct PackedFile
+	{
+		std::string name;
+		std::vector<unsigned char> data;
+		unsigned int uiFirstChunk;
+		bool bStored;
+	};
+	std::vector<PackedFile> files(filenames.size());
+	for (size_t i = 0; i < filenames.size(); i++)
+	{
+		files[i].name = std::string(directory) + "/" + filenames[i];
+		std::ifstream file(files[i].name, std::ios::binary);
+		if (file.fail())
+		{
+			return false;
+		}
+		files[i].data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	// Split them into chunks and compress all the chunks in parallel
+	struct PackedChunk
+	{
+		int iFile;
+		size_t offset; // In the file
+		size_t size;
+		std::vector<unsigned char> compressed; // Empty when stored
+	};
+	std::vector<PackedChunk> chunks;
+	for (int i = 0; i < (int)files.size(); i++)
+	{
+		files[i].uiFirstChunk = (unsigned int)chunks.size();
+		for (size_t offset = 0; offset < files[i].data.size(); offset += ChunkSize)
+		{
+			chunks.push_back({ i, offset, (std::min)((size_t)ChunkSize, files[i].data.size() - offset), {} });
+		}
+	}
+
+	Utils::ParallelFor((int)chunks.size(), iThreadCount, [&](int iBegin, int iEnd)
+	{
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			PackedChunk& chunk = chunks[i];
+			LZCompressor::Compress(files[chunk.iFile].data.data() + chunk.offset, chunk.size, chunk.compressed);
+
+			// Chunks that shrink by less than an eighth are not worth decoding
+			if (chunk.compressed.size() > chunk.size - chunk.size / 8)
+			{
+				chunk.compressed.clear();
+			}
+		}
+	}, 2);
+
+	for (auto& file : files)
+	{
+		file.bStored = true;
+	}
+	for (const auto& chunk : chunks)
+	{
+		files[chunk.iFile].bStored &= chunk.compressed.empty();
+	}
+
+	// Table of contents
+	Header header = {};
+	header.uiMagic = ArchiveMagic;
+	header.uiVersion = ArchiveVersion;
+	header.uiEntryCount = (unsigned int)files.size();
+	header.uiSlotCount = 1;
+	while (header.uiSlotCount < header.uiEntryCount * 2)
+	{
+		header.uiSlotCount *= 2;
+	}
+	header.uiChunkCount = (unsigned int)chunks.size();
+
+	std::string names;
+	std::vector<Entry> entries(files.size());
+	std::vector<unsigned int> slots(header.uiSlotCount, 0);
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		Entry& entry = entries[i];
+		entry.ullNameHash = HashName(NormalizeName(files[i].name.c_str()));
+		entry.ullSize = files[i].data.size();
+		entry.uiNameOffset = (unsigned int)names.size();
+		entry.uiNameLength = (unsigned int)files[i].name.size();
+		entry.uiFirstChunk = files[i].uiFirstChunk;
+		entry.uiStored = files[i].bStored ? 1 : 0;
+		names += files[i].name;
+
+		unsigned int uiSlot = (unsigned int)entry.ullNameHash & (header.uiSlotCount - 1);
+		while (slots[uiSlot] != 0)
+		{
+			uiSlot = (uiSlot + 1) & (header.uiSlotCount - 1);
+		}
+		slots[uiSlot] = (unsigned int)i + 1;
+	}
+	header.uiNamesSize = (unsigned int)names.size();
+
+	// Lay out each entry's chunks back to back from an aligned offset
+	std::vector<Chunk> chunkTable(chunks.size());
+	size_t offset = AlignUp(sizeof(Header) + slots.size() * sizeof(unsigned int) + entries.size() * sizeof(Entry) + chunkTable.size() * sizeof(Chunk) + names.size(), Alignment);
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		entries[i].ullDataOffset = offset;
+		size_t entrySize = 0;
+		for (unsigned int j = files[i].uiFirstChunk; j < chunks.size() && chunks[j].iFile == (int)i; j++)
+		{
+			size_t chunkSize = chunks[j].compressed.empty() ? chunks[j].size : chunks[j].compressed.size();
+			chunkTable[j].uiOffset = (unsigned int)entrySize;
+			chunkTable[j].uiCompressedSize = (unsigned int)chunkSize;
+			entrySize += chunkSize;
+		}
+		offset = AlignUp(offset + entrySize, Alignment);
+	}
+
+	// Write
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (file.fail())
+	{
+		return false;
+	}
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)slots.data(), slots.size() * sizeof(unsigned int));
+	file.write((const char*)entries.data(), entries.size() * sizeof(Entry));
+	file.write((const char*)chunkTable.data(), chunkTable.size() * sizeof(Chunk));
+	file.write(names.data(), names.size());
+
+	const char padding[Alignment] = {};
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		file.write(padding, entries[i].ullDataOffset - (size_t)file.tellp());
+		for (unsigned int j = files[i].uiFirstChunk; j < chunks.size() && chunks[j].iFile == (int)i; j++)
+		{
+			if (chunks[j].compressed.empty())
+			{
+				file.write((const char*)files[i].data.data() + chunks[j].offset, chunks[j].size);
+			}
+			else
+			{
+				file.write((const char*)chunks[j].compressed.data(), chunks[j].compressed.size());
+			}
+		}
+	}
+	file.write(padding, offset - (size_t)file.tellp());
+	if (file.fail())
+	{
+		return false;
+	}
+
+	if (pStats)
+	{
+		*pStats = {};
+		pStats->iEntryCount = (int)files.size();
+		for (const auto& chunk : chunks)
+		{
+			(chunk.compressed.empty() ? pStats->iStoredChunks : pStats->iCompressedChunks)++;
+		}
+		for (const auto& packedFile : files)
+		{
+			pStats->originalBytes += packedFile.data.size();
+		}
+		pStats->archiveBytes = offset;
+	}
+
+	return true;
+}
+
+#pragma endregion
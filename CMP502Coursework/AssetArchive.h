@@ -0,0 +1,105 @@
+//
+// AssetArchive.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// LZ4 Block Format Description (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md)
+// FNV Hash (http://www.isthe.com/chongo/tech/comp/fnv/index.html)
+//
+
+#ifndef ASSET_ARCHIVE_H
+#define ASSET_ARCHIVE_H
+
+#include <string>
+#include <vector>
+#include "LZCompressor.h"
+#include "Utils.h"
+
+struct ArchiveStats
+{
+	int iEntryCount;
+	int iCompressedChunks;
+	int iStoredChunks;	   // Chunks that compression did not shrink enough to be worth decoding
+	size_t originalBytes;
+	size_t archiveBytes;
+};
+
+// Read-only pack of resource files, memory mapped as a whole
+// Layout: header, hashed table of contents (slots, entries, chunks, names), then each entry's data starting on a 4 KB boundary
+// Entries are split into 64 KB chunks that are LZ compressed independently, so one entry decompresses on several threads
+// Entries whose chunks were all stored uncompressed are read in place from the mapping
+class AssetArchive
+{
+public:
+	static const int ChunkSize = LZCompressor::MaxBlockSize;
+	static const int Alignment = 4096;
+
+	AssetArchive();
+	~AssetArchive();
+
+	bool Open(const char* filename); // Maps the archive and checks the table of contents
+	void Close();
+
+	// Names are relative paths as given to Build (for example "Resources/stone.dds"), matched without case and with either slash
+	bool Contains(const char* name) const;
+	size_t GetSize(const char* name) const; // Uncompressed; 0 if missing
+
+	// Returns the entry's data: a view into the mapping when it is stored uncompressed, otherwise the buffer, into which it is decompressed
+	// Returns nullptr if the entry is missing or corrupt; the data stays valid while the archive is open (and the buffer is alive)
+	const unsigned char* Load(const char* name, size_t* pSize, std::vector<unsigned char>& buffer, int iThreadCount = 0) const;
+
+	int GetEntryCount() const;
+	std::string GetEntryName(int iEntry) const;
+
+	// Packs every file directly inside the directory, compressing the chunks on iThreadCount threads (0 uses every core)
+	static bool Build(const char* directory, const char* filename, int iThreadCount = 0, ArchiveStats* pStats = nullptr);
+
+private:
+	struct Header
+	{
+		unsigned int uiMagic;
+		unsigned int uiVersion;
+		unsigned int uiEntryCount;
+		unsigned int uiSlotCount; // Power of two, at least twice the entry count
+		unsigned int uiChunkCount;
+		unsigned int uiNamesSize;
+	};
+
+	struct Entry
+	{
+		unsigned long long ullNameHash;
+		unsigned long long ullDataOffset; // From the start of the archive, a multiple of the alignment
+		unsigned long long ullSize;
+		unsigned int uiNameOffset;
+		unsigned int uiNameLength;
+		unsigned int uiFirstChunk;
+		unsigned int uiStored; // Every chunk is uncompressed, so the data is contiguous
+	};
+
+	struct Chunk
+	{
+		unsigned int uiOffset; // From the entry's data
+		unsigned int uiCompressedSize; // Equal to the chunk's size when stored
+	};
+
+	const unsigned char* m_mappedData;
+	size_t m_mappedSize;
+#ifdef _WIN32
+	HANDLE m_hFile;
+	HANDLE m_hMapping;
+#endif
+	const Header* m_pHeader;
+	const unsigned int* m_slots; // Entry index + 1, or 0 when empty; probed linearly from the name hash
+	const Entry* m_entries;
+	const Chunk* m_chunks;
+	const char* m_names;
+
+	bool MapFile(const char* filename);
+	bool Validate();
+	const Entry* Find(const char* name) const;
+	static std::string NormalizeName(const char* name);
+	static char NormalizeChar(char c); // Lower case, forward slashes
+	static unsigned long long HashName(const std::string& name); // FNV-1a
+};
+
+#endif
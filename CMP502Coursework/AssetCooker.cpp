@@ -0,0 +1,517 @@
+//
+// AssetCooker.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Content-Addressable Storage (https://en.wikipedia.org/wiki/Content-addressable_storage)
+// FNV Hash (http://www.isthe.com/chongo/tech/comp/fnv/index.html)
+//
+
+#include "AssetCooker.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/stat.h>
+#endif
+
+const char* const AssetCooker::SourceDirectory = "Resources";
+const char* const AssetCooker::OutputDirectory = "Cooked";
+const char* const AssetCooker::CacheDirectory = "CookCache";
+
+#pragma region Cooking
+
+bool AssetCooker::Cook(const char* sourceDirectory, const char* outputDirectory, const char* cacheDirectory, int iThreadCount, CookStats* pStats)
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	std::vector<std::string> filenames;
+	if (!Utils::ListFiles(sourceDirectory, filenames) || !MakeDirectory(outputDirectory) || !MakeDirectory(cacheDirectory))
+	{
+		return false;
+	}
+
+	struct CookJob
+	{
+		AssetType type;
+		std::string source;
+		std::string dependency; // Another source the result is made from, if any
+		std::string output;
+		bool bCached;
+		bool bFailed;
+		double dMilliseconds;
+		std::string message;
+	};
+	std::vector<CookJob> jobs;
+	for (const auto& filename : filenames)
+	{
+		CookJob job = {};
+		job.type = GetAssetType(filename);
+		job.source = std::string(sourceDirectory) + "/" + filename;
+		job.output = std::string(outputDirectory) + "/" + GetCookedName(filename);
+		jobs.push_back(job);
+
+		// Impostors are baked from the text model and the texture named after it
+		if (job.type == MeshAsset && GetImpostorSettings(filename.c_str()).bEnabled)
+		{
+			std::string name = filename.substr(0, filename.find_last_of('.'));
+			job.type = ImpostorAsset;
+			job.dependency = std::string(sourceDirectory) + "/" + name + ".dds";
+			job.output = std::string(outputDirectory) + "/" + name + "_impostor.dds";
+			jobs.push_back(job);
+		}
+	}
+
+	// Assets are handed out one at a time, as their costs differ by orders of magnitude
+	if (iThreadCount <= 0)
+	{
+		iThreadCount = (std::max)(1, (int)std::thread::hardware_concurrency());
+	}
+	std::atomic<int> nextJob(0);
+	Utils::ParallelFor(iThreadCount, iThreadCount, [&](int, int)
+	{
+		for (int i = nextJob++; i < (int)jobs.size(); i = nextJob++)
+		{
+			CookJob& job = jobs[i];
+			auto jobStartTime = std::chrono::steady_clock::now();
+
+			// Sources are mapped rather than read, as each is only hashed and parsed once
+			MappedFile source;
+			if (!source.Open(job.source.c_str()))
+			{
+				job.bFailed = true;
+				job.message = "could not be read";
+				continue;
+			}
+
+			// A missing dependency isn't an error; the asset is cooked without it (and cooked again once it appears)
+			std::vector<unsigned char> dependency;
+			bool bDependencyFound = !job.dependency.empty() && ReadFile(job.dependency, dependency);
+
+			// The cache file is named after everything that affects the result, so a hit can be used without checking anything else
+			std::string cacheFilename = std::string(cacheDirectory) + "/" + GetCacheKey(job.source, job.type, source.GetData(), source.GetSize(), dependency) + "_" + GetBaseName(job.output);
+			std::vector<unsigned char> cooked;
+			if (ReadFile(cacheFilename, cooked))
+			{
+				job.bCached = true;
+			}
+			else
+			{
+				bool bResult = true;
+				switch (job.type)
+				{
+				case MeshAsset:
+					bResult = CookMesh(source.GetData(), source.GetSize(), cooked, &job.message);
+					break;
+				case TextureAsset:
+					bResult = CookTexture(source.GetData(), source.GetSize(), GetTextureSettings(job.source.c_str()), cooked, &job.message);
+					break;
+				case ImpostorAsset:
+					bResult = CookImpostor(source.GetData(), source.GetSize(), dependency.data(), dependency.size(), GetImpostorSettings(job.source.c_str()), cooked, &job.message);
+					if (bResult && !bDependencyFound)
+					{
+						job.message += " (" + job.dependency + " not found, baked untextured)";
+					}
+					break;
+				default:
+					break;
+				}
+				if (!bResult)
+				{
+					job.bFailed = true;
+					continue;
+				}
+				if (cooked.empty())
+				{
+					cooked.assign(source.GetData(), source.GetData() + source.GetSize()); // Already in its runtime form
+				}
+				WriteFile(cacheFilename, cooked); // A cook that can't be cached is still used
+			}
+
+			if (!WriteFile(job.output, cooked))
+			{
+				job.bFailed = true;
+				job.message = "could not be written";
+				continue;
+			}
+			job.dMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - jobStartTime).count();
+		}
+	}, 1);
+
+	CookStats stats = {};
+	stats.iAssetCount = (int)jobs.size();
+	for (const auto& job : jobs)
+	{
+		if (job.bFailed)
+		{
+			stats.iFailedCount++;
+			Utils::Log("Failed to cook " + job.source + (job.message.empty() ? "" : ": " + job.message));
+		}
+		else if (job.bCached)
+		{
+			stats.iCachedCount++;
+		}
+		else
+		{
+			stats.iCookedCount++;
+			Utils::Log("Cooked " + job.source + " to " + job.output + " in " + std::to_string((int)job.dMilliseconds) + " ms" + (job.message.empty() ? "" : ": " + job.message));
+		}
+	}
+	stats.dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	Utils::Log("Cooked " + std::to_string(stats.iAssetCount) + " assets in " + std::to_string(stats.dSeconds) + " s (" + std::to_string(stats.iCookedCount) + " cooked, " + std::to_string(stats.iCachedCount) + " from the cache, " + std::to_string(stats.iFailedCount) + " failed)");
+
+	if (pStats)
+	{
+		*pStats = stats;
+	}
+	return stats.iFailedCount == 0;
+}
+
+bool AssetCooker::CookTexture(const unsigned char* data, size_t size, const TextureSettings& settings, std::vector<unsigned char>& output, std::string* pMessage)
+{
+	// Textures the importer can't decode are used as they are
+	TextureImage image;
+	if (!image.LoadFromMemory(data, size))
+	{
+		return true;
+	}
+
+	// Block compressed textures are already in their final form, unless they were shipped without mipmaps (which streaming needs)
+	// Those are decoded, given a chain and encoded again in their own format
+	TextureFormat format = settings.format;
+	if (image.GetFormat() != RGBA8Format)
+	{
+		if (image.GetMipCount() > 1 || !BlockCompressor::CanCompress(image.GetFormat()))
+		{
+			return true;
+		}
+		format = image.GetFormat();
+	}
+
+	// Direct3D needs the top level of a block compressed texture to be a whole number of blocks
+	if (image.GetWidth() % 4 != 0 || image.GetHeight() % 4 != 0)
+	{
+		format = RGBA8Format;
+	}
+
+	bool bGenerateMips = (image.GetMipCount() == 1);
+	if (!bGenerateMips && format == RGBA8Format)
+	{
+		return true;
+	}
+
+	// Sprites use the box filter so that lower mips spread their outline as little as possible
+	MipFilter filter = settings.bTiling ? MipFilter::KaiserFilter : MipFilter::BoxFilter;
+	if (bGenerateMips && !MipGenerator::GenerateMipChain(image, filter, settings.bTiling))
+	{
+		if (pMessage)
+		{
+			*pMessage = "failed to generate mipmaps";
+		}
+		return false;
+	}
+
+	float fRMSE = 0.0f;
+	if (!image.SaveToMemory(output, format, HighQuality, &fRMSE))
+	{
+		if (pMessage)
+		{
+			*pMessage = "failed to compress";
+		}
+		return false;
+	}
+
+	if (pMessage)
+	{
+		*pMessage = std::to_string(image.GetMipCount()) + " mip levels";
+		if (format != RGBA8Format)
+		{
+			*pMessage += ", RMSE " + std::to_string(fRMSE) + ", PSNR " + std::to_string(BlockCompressor::GetPSNR(fRMSE)) + " dB";
+		}
+	}
+	return true;
+}
+
+bool AssetCooker::CookMesh(const unsigned char* data, size_t size, std::vector<unsigned char>& output, std::string* pMessage)
+{
+	std::vector<ModelData> sourceVertices;
+	std::vector<std::string> errors;
+	if (!MeshFile::ParseText(data, size, sourceVertices, &errors))
+	{
+		if (pMessage)
+		{
+			*pMessage = "not a valid text model";
+			for (const auto& error : errors)
+			{
+				*pMessage += "\n  " + error;
+			}
+		}
+		return false;
+	}
+
+	std::vector<ModelData> vertices;
+	std::vector<unsigned int> indices;
+	MeshOptimizer::Weld(sourceVertices.data(), (int)sourceVertices.size(), vertices, indices);
+
+	auto simplifyStartTime = std::chrono::steady_clock::now();
+	std::vector<MeshLod> lods;
+	MeshSimplifier::GenerateLods(vertices.data(), (int)vertices.size(), indices, lods);
+	double dSimplifyMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - simplifyStartTime).count();
+
+	// Each level is reordered for the vertex cache on its own, then the vertices in order of first use (the full level uses every one of them)
+	std::vector<unsigned int> lodIndices;
+	for (const auto& lod : lods)
+	{
+		lodIndices.assign(indices.begin() + lod.uiFirstIndex, indices.begin() + lod.uiFirstIndex + lod.uiIndexCount);
+		MeshOptimizer::OptimizeVertexCache(lodIndices, (int)vertices.size());
+		std::copy(lodIndices.begin(), lodIndices.end(), indices.begin() + lod.uiFirstIndex);
+	}
+
+	// The full level of a large mesh is then split into meshlets, each reordered for the vertex cache again on its own
+	std::vector<Meshlet> meshlets;
+	double dMeshletMilliseconds = 0.0;
+	if ((int)lods[0].uiIndexCount / 3 >= MinMeshletTriangles)
+	{
+		auto meshletStartTime = std::chrono::steady_clock::now();
+		MeshletBuilder::Build(vertices.data(), (int)vertices.size(), indices, lods[0].uiFirstIndex, lods[0].uiIndexCount, meshlets);
+		for (const auto& meshlet : meshlets)
+		{
+			lodIndices.assign(indices.begin() + meshlet.uiFirstIndex, indices.begin() + meshlet.uiFirstIndex + meshlet.uiIndexCount);
+			MeshOptimizer::OptimizeVertexCache(lodIndices, (int)vertices.size());
+			std::copy(lodIndices.begin(), lodIndices.end(), indices.begin() + meshlet.uiFirstIndex);
+		}
+		dMeshletMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - meshletStartTime).count();
+	}
+
+	MeshOptimizer::OptimizeVertexFetch(vertices, indices);
+	MeshFile::WriteCooked(vertices, indices, lods, meshlets, output);
+
+	if (pMessage)
+	{
+		// The source is unindexed, so every one of its vertices is transformed
+		lodIndices.assign(indices.begin(), indices.begin() + lods[0].uiIndexCount);
+		char message[128];
+		snprintf(message, sizeof(message), "%d vertices welded to %d, %d triangles, ACMR 3.00 -> %.2f, levels of detail", (int)sourceVertices.size(), (int)vertices.size(), (int)lods[0].uiIndexCount / 3, MeshOptimizer::GetACMR(lodIndices, (int)vertices.size()));
+		*pMessage = message;
+		for (size_t i = 1; i < lods.size(); i++)
+		{
+			snprintf(message, sizeof(message), " %d (%.3g)", (int)lods[i].uiIndexCount / 3, lods[i].fError);
+			*pMessage += message;
+		}
+		snprintf(message, sizeof(message), "%s in %.1f ms", (lods.size() > 1) ? "" : " none", dSimplifyMilliseconds);
+		*pMessage += message;
+		if (!meshlets.empty())
+		{
+			snprintf(message, sizeof(message), ", %d meshlets (%.1f triangles each) in %.1f ms", (int)meshlets.size(), lods[0].uiIndexCount / 3.0f / meshlets.size(), dMeshletMilliseconds);
+			*pMessage += message;
+		}
+	}
+	return true;
+}
+
+bool AssetCooker::CookImpostor(const unsigned char* data, size_t size, const unsigned char* textureData, size_t textureSize, const ImpostorSettings& settings, std::vector<unsigned char>& output, std::string* pMessage)
+{
+	std::vector<ModelData> sourceVertices;
+	if (!MeshFile::ParseText(data, size, sourceVertices))
+	{
+		if (pMessage)
+		{
+			*pMessage = "not a valid text model";
+		}
+		return false;
+	}
+
+	std::vector<ModelData> vertices;
+	std::vector<unsigned int> indices;
+	MeshOptimizer::Weld(sourceVertices.data(), (int)sourceVertices.size(), vertices, indices);
+
+	TextureImage texture;
+	bool bTextured = (textureSize > 0) && texture.LoadFromMemory(textureData, textureSize);
+	if (bTextured && texture.GetMipCount() == 1)
+	{
+		MipGenerator::GenerateMipChain(texture, MipFilter::KaiserFilter, true); // For sampling distant triangles without aliasing
+	}
+
+	auto bakeStartTime = std::chrono::steady_clock::now();
+	TextureImage atlas;
+	if (!ImpostorBaker::Bake(vertices.data(), (int)vertices.size(), indices.data(), (int)indices.size(), bTextured ? &texture : nullptr, settings.bOpaque, atlas))
+	{
+		if (pMessage)
+		{
+			*pMessage = "failed to bake an impostor";
+		}
+		return false;
+	}
+	double dBakeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bakeStartTime).count();
+
+	// BC3 rather than BC7, as its separate alpha block keeps the coverage and the mode 6 encoder loses more on the normals
+	float fRMSE = 0.0f;
+	if (!atlas.SaveToMemory(output, BC3Format, HighQuality, &fRMSE))
+	{
+		if (pMessage)
+		{
+			*pMessage = "failed to compress";
+		}
+		return false;
+	}
+
+	if (pMessage)
+	{
+		char message[160];
+		snprintf(message, sizeof(message), "%d views of %d triangles baked in %.1f ms, %dx%d with %d mip levels, RMSE %.2f, PSNR %.2f dB", ImpostorBaker::FrameCount * ImpostorBaker::FrameCount, (int)indices.size() / 3, dBakeMilliseconds, atlas.GetWidth(), atlas.GetHeight(), atlas.GetMipCount(), fRMSE, BlockCompressor::GetPSNR(fRMSE));
+		*pMessage = message;
+	}
+	return true;
+}
+
+#pragma endregion
+
+#pragma region Setters/Getters
+
+std::string AssetCooker::GetCookedFilename(const char* filename)
+{
+	return std::string(OutputDirectory) + "/" + GetCookedName(filename);
+}
+
+std::string AssetCooker::GetImpostorFilename(const char* filename)
+{
+	std::string name = GetBaseName(filename);
+	return std::string(OutputDirectory) + "/" + name.substr(0, name.find_last_of('.')) + "_impostor.dds";
+}
+
+TextureSettings AssetCooker::GetTextureSettings(const char* filename)
+{
+	TextureSettings settings;
+	settings.bTiling = (GetBaseName(filename) != "particle.dds");
+	settings.format = BC7Format; // Uncompressed textures are block compressed
+	return settings;
+}
+
+ImpostorSettings AssetCooker::GetImpostorSettings(const char* filename)
+{
+	// The plants are scattered in the hundreds, and lupines are blended where lavender is opaque
+	std::string name = GetBaseName(filename);
+	ImpostorSettings settings;
+	settings.bEnabled = (name == "lavender.txt" || name == "lupine.txt");
+	settings.bOpaque = (name == "lavender.txt");
+	return settings;
+}
+
+AssetCooker::AssetType AssetCooker::GetAssetType(const std::string& filename)
+{
+	size_t extension = filename.find_last_of('.');
+	std::string extensionName = (extension == std::string::npos) ? "" : filename.substr(extension);
+	std::transform(extensionName.begin(), extensionName.end(), extensionName.begin(), ::tolower);
+	if (extensionName == ".txt")
+	{
+		return MeshAsset;
+	}
+	if (extensionName == ".dds")
+	{
+		return TextureAsset;
+	}
+	return CopiedAsset;
+}
+
+std::string AssetCooker::GetBaseName(const std::string& filename)
+{
+	size_t separator = filename.find_last_of("/\\");
+	return (separator == std::string::npos) ? filename : filename.substr(separator + 1);
+}
+
+std::string AssetCooker::GetCookedName(const std::string& filename)
+{
+	std::string name = GetBaseName(filename);
+	if (GetAssetType(name) == MeshAsset)
+	{
+		name = name.substr(0, name.find_last_of('.')) + ".mesh";
+	}
+	return name;
+}
+
+std::string AssetCooker::GetCacheKey(const std::string& filename, AssetType type, const unsigned char* data, size_t size, const std::vector<unsigned char>& dependency)
+{
+	// FNV-1a over the settings, then the source bytes and the dependency's
+	std::string settings = "v" + std::to_string(Version) + " type " + std::to_string(type);
+	if (type == TextureAsset)
+	{
+		TextureSettings textureSettings = GetTextureSettings(filename.c_str());
+		settings += " tiling " + std::to_string(textureSettings.bTiling) + " format " + std::to_string(textureSettings.format);
+	}
+	else if (type == ImpostorAsset)
+	{
+		ImpostorSettings impostorSettings = GetImpostorSettings(filename.c_str());
+		settings += " opaque " + std::to_string(impostorSettings.bOpaque) + " frames " + std::to_string(ImpostorBaker::FrameCount) + "x" + std::to_string(ImpostorBaker::FrameSize) + " dependency " + std::to_string(dependency.size());
+	}
+
+	unsigned long long ullHash = 14695981039346656037ull;
+	for (char c : settings)
+	{
+		ullHash = (ullHash ^ (unsigned char)c) * 1099511628211ull;
+	}
+	for (size_t i = 0; i < size; i++)
+	{
+		ullHash = (ullHash ^ data[i]) * 1099511628211ull;
+	}
+	for (unsigned char c : dependency)
+	{
+		ullHash = (ullHash ^ c) * 1099511628211ull;
+	}
+
+	char key[17];
+	snprintf(key, sizeof(key), "%016llx", ullHash);
+	return key;
+}
+
+#pragma endregion
+
+#pragma region Files
+
+bool AssetCooker::ReadFile(const std::string& filename, std::vector<unsigned char>& data)
+{
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (file.fail())
+	{
+		return false;
+	}
+	data.resize((size_t)file.tellg());
+	file.seekg(0);
+	file.read((char*)data.data(), data.size());
+	return !file.fail();
+}
+
+bool AssetCooker::WriteFile(const std::string& filename, const std::vector<unsigned char>& data)
+{
+	// Named per thread, as two assets with the same contents share a cache file
+	std::string temporaryFilename = filename + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream file(temporaryFilename, std::ios::binary | std::ios::trunc);
+		if (!file.is_open() || !file.write((const char*)data.data(), data.size()))
+		{
+			return false;
+		}
+	}
+
+	std::remove(filename.c_str());
+	if (std::rename(temporaryFilename.c_str(), filename.c_str()) != 0)
+	{
+		std::remove(temporaryFilename.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool AssetCooker::MakeDirectory(const char* directory)
+{
+#ifdef _WIN32
+	return CreateDirectoryA(directory, nullptr) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+	return mkdir(directory, 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+#pragma endregion
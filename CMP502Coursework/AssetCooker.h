@@ -0,0 +1,93 @@
+//
+// AssetCooker.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Content-Addressable Storage (https://en.wikipedia.org/wiki/Content-addressable_storage)
+// FNV Hash (http://www.isthe.com/chongo/tech/comp/fnv/index.html)
+//
+
+#ifndef ASSET_COOKER_H
+#define ASSET_COOKER_H
+
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "ImpostorBaker.h"
+#include "MeshFile.h"
+#include "MeshletBuilder.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MipGenerator.h"
+#include "TextureImage.h"
+#include "Utils.h"
+
+struct TextureSettings
+{
+	bool bTiling;		  // Wraps around when filtered; sprites don't
+	TextureFormat format; // For sources that are not block compressed yet
+};
+
+struct ImpostorSettings
+{
+	bool bEnabled; // Baked alongside the model, to draw distant instances with
+	bool bOpaque;  // Drawn without blending, so the texture's alpha is ignored
+};
+
+struct CookStats
+{
+	int iAssetCount;
+	int iCookedCount; // Processed from scratch
+	int iCachedCount; // Taken from the cache
+	int iFailedCount;
+	double dSeconds;
+};
+
+// Turns the source assets into their runtime forms ahead of time: text models are welded, simplified into levels of detail, split into meshlets (if large) and reordered into indexed meshes (.mesh),
+// and textures get full mip chains and block compression; anything else is copied as it is
+// Vegetation models also get an impostor atlas (_impostor.dds), baked with the texture of the same name
+// Results are cached under a hash of the source bytes (and those of any texture baked in) and the processing settings, so only assets that changed are cooked again
+// No device is needed, so the cooker also runs on its own (AssetCookerTool.cpp)
+class AssetCooker
+{
+public:
+	static const char* const SourceDirectory;
+	static const char* const OutputDirectory;
+	static const char* const CacheDirectory;
+
+	// Cooks every file directly inside the source directory on iThreadCount threads (0 uses every core)
+	static bool Cook(const char* sourceDirectory, const char* outputDirectory, const char* cacheDirectory, int iThreadCount = 0, CookStats* pStats = nullptr);
+
+	static std::string GetCookedFilename(const char* filename); // For example "Resources/statue.txt" becomes "Cooked/statue.mesh"
+	static std::string GetImpostorFilename(const char* filename); // For example "Resources/lavender.txt" becomes "Cooked/lavender_impostor.dds"
+	static TextureSettings GetTextureSettings(const char* filename);
+	static ImpostorSettings GetImpostorSettings(const char* filename);
+
+	// Both leave the output empty if the source is already in its runtime form; pMessage describes the result (or the failure)
+	static bool CookTexture(const unsigned char* data, size_t size, const TextureSettings& settings, std::vector<unsigned char>& output, std::string* pMessage = nullptr);
+	static bool CookMesh(const unsigned char* data, size_t size, std::vector<unsigned char>& output, std::string* pMessage = nullptr);
+	// Bakes a text model into an impostor atlas; without texture data the model is baked white
+	static bool CookImpostor(const unsigned char* data, size_t size, const unsigned char* textureData, size_t textureSize, const ImpostorSettings& settings, std::vector<unsigned char>& output, std::string* pMessage = nullptr);
+
+private:
+	static const unsigned int Version = 4; // Part of every cache key; bump it when the processing changes so that everything is cooked again
+	static const int MinMeshletTriangles = 4096; // Smaller meshes are drawn whole, as culling their few meshlets would cost more than it saves
+
+	enum AssetType : int
+	{
+		CopiedAsset = 0,
+		MeshAsset,
+		TextureAsset,
+		ImpostorAsset // Made from a model (and its texture) rather than a file of its own
+	};
+
+	static AssetType GetAssetType(const std::string& filename);
+	static std::string GetBaseName(const std::string& filename); // Without the directory
+	static std::string GetCookedName(const std::string& filename); // Base name with the runtime extension
+	static std::string GetCacheKey(const std::string& filename, AssetType type, const unsigned char* data, size_t size, const std::vector<unsigned char>& dependency); // Source and dependency bytes, asset type, settings and version
+	static bool ReadFile(const std::string& filename, std::vector<unsigned char>& data);
+	static bool WriteFile(const std::string& filename, const std::vector<unsigned char>& data); // Through a temporary file, so a failure never leaves half a file
+	static bool MakeDirectory(const char* directory);
+};
+
+#endif
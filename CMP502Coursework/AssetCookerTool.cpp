@@ -0,0 +1,33 @@
+//
+// AssetCookerTool.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Command line front end for AssetCooker, so that assets can be cooked without the game (for example on a Linux build machine)
+// It isn't part of the game's build; on Linux it builds against DirectX-Headers (for the Windows types) and DirectXMath:
+// g++ -O2 -std=c++17 -I<DirectX-Headers>/include -I<DirectX-Headers>/include/wsl/stubs -I<DirectXMath>/Inc AssetCookerTool.cpp AssetCooker.cpp
+//     MappedFile.cpp MeshFile.cpp MeshOptimizer.cpp MeshSimplifier.cpp MeshletBuilder.cpp ImpostorBaker.cpp TextureImage.cpp MipGenerator.cpp BlockCompressor.cpp DDSFile.cpp Utils.cpp -lpthread -o AssetCooker
+// Benchmarks/CMakeLists.txt also builds it
+//
+// Usage: AssetCooker [source directory] [output directory] [cache directory] [threads]
+//
+
+#include <cstdlib>
+#include "AssetCooker.h"
+
+int main(int argc, char* argv[])
+{
+	const char* sourceDirectory = (argc > 1) ? argv[1] : AssetCooker::SourceDirectory;
+	const char* outputDirectory = (argc > 2) ? argv[2] : AssetCooker::OutputDirectory;
+	const char* cacheDirectory = (argc > 3) ? argv[3] : AssetCooker::CacheDirectory;
+	int iThreadCount = (argc > 4) ? atoi(argv[4]) : 0;
+
+	// The cooker logs each asset and a summary as it goes
+	CookStats stats = {};
+	bool bResult = AssetCooker::Cook(sourceDirectory, outputDirectory, cacheDirectory, iThreadCount, &stats);
+	if (stats.iAssetCount == 0 && !bResult)
+	{
+		Utils::Log(std::string("Could not read ") + sourceDirectory + " or create the output and cache directories");
+	}
+
+	return bResult ? 0 : 1;
+}
@@ -0,0 +1,693 @@
+//
+// AsyncFileReader.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// I/O Completion Ports (https://docs.microsoft.com/en-us/windows/desktop/FileIO/i-o-completion-ports)
+// Efficient IO with io_uring (Axboe, 2019) (https://kernel.dk/io_uring.pdf)
+//
+
+#include "AsyncFileReader.h"
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace
+{
+	// Files are read in pieces no larger than this, as ReadFile and io_uring take 32-bit lengths
+	const size_t MaxReadSize = 1 << 30;
+}
+
+#ifdef __linux__
+
+struct AsyncFileReader::Ring
+{
+	static const unsigned int EntryCount = 64;
+
+	int iFile;
+	unsigned int uiEntryCount;
+	unsigned char* pSubmissionQueue;
+	size_t submissionQueueSize;
+	unsigned char* pCompletionQueue; // The same mapping as the submission queue on kernels with IORING_FEAT_SINGLE_MMAP
+	size_t completionQueueSize;
+	io_uring_sqe* submissionEntries;
+	unsigned int* puiSubmissionTail;
+	unsigned int* puiSubmissionArray;
+	unsigned int uiSubmissionMask;
+	unsigned int* puiCompletionHead;
+	unsigned int* puiCompletionTail;
+	unsigned int uiCompletionMask;
+	io_uring_cqe* completionEntries;
+
+	std::mutex mutex; // Reads are issued by both Submit and the completion thread
+	std::deque<Request*> waitingReads; // Opened, waiting for room in the ring
+	unsigned int uiInFlight; // Kept within the entry count, so that the completion queue (twice the size) can't overflow
+	unsigned int uiUnsubmitted;
+
+	Ring()
+	{
+		iFile = -1;
+		pSubmissionQueue = nullptr;
+		pCompletionQueue = nullptr;
+		submissionEntries = nullptr;
+		uiInFlight = 0;
+		uiUnsubmitted = 0;
+	}
+
+	~Ring()
+	{
+		if (submissionEntries)
+		{
+			munmap(submissionEntries, uiEntryCount * sizeof(io_uring_sqe));
+		}
+		if (pCompletionQueue && pCompletionQueue != pSubmissionQueue)
+		{
+			munmap(pCompletionQueue, completionQueueSize);
+		}
+		if (pSubmissionQueue)
+		{
+			munmap(pSubmissionQueue, submissionQueueSize);
+		}
+		if (iFile >= 0)
+		{
+			close(iFile);
+		}
+	}
+
+	bool Create()
+	{
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		iFile = (int)syscall(__NR_io_uring_setup, EntryCount, &params);
+		if (iFile < 0)
+		{
+			return false;
+		}
+
+		// IORING_OP_READ and the probe for it both arrived in Linux 5.6; older kernels use the blocking fallback
+		std::vector<unsigned char> probeData(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+		io_uring_probe* pProbe = (io_uring_probe*)probeData.data();
+		if (syscall(__NR_io_uring_register, iFile, IORING_REGISTER_PROBE, pProbe, 256) < 0 || pProbe->last_op < IORING_OP_READ || !(pProbe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED))
+		{
+			return false;
+		}
+
+		uiEntryCount = params.sq_entries;
+		submissionQueueSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+		completionQueueSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		bool bSingleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (bSingleMapping)
+		{
+			submissionQueueSize = completionQueueSize = (std::max)(submissionQueueSize, completionQueueSize);
+		}
+
+		void* data = mmap(nullptr, submissionQueueSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, iFile, IORING_OFF_SQ_RING);
+		if (data == MAP_FAILED)
+		{
+			return false;
+		}
+		pSubmissionQueue = (unsigned char*)data;
+
+		if (bSingleMapping)
+		{
+			pCompletionQueue = pSubmissionQueue;
+		}
+		else
+		{
+			data = mmap(nullptr, completionQueueSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, iFile, IORING_OFF_CQ_RING);
+			if (data == MAP_FAILED)
+			{
+				return false;
+			}
+			pCompletionQueue = (unsigned char*)data;
+		}
+
+		data = mmap(nullptr, uiEntryCount * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, iFile, IORING_OFF_SQES);
+		if (data == MAP_FAILED)
+		{
+			return false;
+		}
+		submissionEntries = (io_uring_sqe*)data;
+
+		puiSubmissionTail = (unsigned int*)(pSubmissionQueue + params.sq_off.tail);
+		puiSubmissionArray = (unsigned int*)(pSubmissionQueue + params.sq_off.array);
+		uiSubmissionMask = *(unsigned int*)(pSubmissionQueue + params.sq_off.ring_mask);
+		puiCompletionHead = (unsigned int*)(pCompletionQueue + params.cq_off.head);
+		puiCompletionTail = (unsigned int*)(pCompletionQueue + params.cq_off.tail);
+		uiCompletionMask = *(unsigned int*)(pCompletionQueue + params.cq_off.ring_mask);
+		completionEntries = (io_uring_cqe*)(pCompletionQueue + params.cq_off.cqes);
+
+		return true;
+	}
+
+	// Call with the mutex held; a null request is a no-op that wakes the completion thread to stop
+	void Push(Request* pRequest)
+	{
+		// Only this side writes the tail, and the kernel consumes every entry during io_uring_enter, so there is always room
+		unsigned int uiTail = *puiSubmissionTail;
+		unsigned int uiIndex = uiTail & uiSubmissionMask;
+		io_uring_sqe& entry = submissionEntries[uiIndex];
+		memset(&entry, 0, sizeof(entry));
+		if (pRequest)
+		{
+			entry.opcode = IORING_OP_READ;
+			entry.fd = pRequest->iFile;
+			entry.off = pRequest->bytesRead;
+			entry.addr = (unsigned long long)(uintptr_t)(pRequest->data.data() + pRequest->bytesRead);
+			entry.len = (unsigned int)(std::min)(pRequest->data.size() - pRequest->bytesRead, MaxReadSize);
+		}
+		else
+		{
+			entry.opcode = IORING_OP_NOP;
+		}
+		entry.user_data = (unsigned long long)(uintptr_t)pRequest;
+		puiSubmissionArray[uiIndex] = uiIndex;
+		__atomic_store_n(puiSubmissionTail, uiTail + 1, __ATOMIC_RELEASE);
+
+		uiInFlight++;
+		uiUnsubmitted++;
+	}
+
+	// Call with the mutex held: issues waiting reads while there is room, then hands them all to the kernel in one call
+	void Flush()
+	{
+		while (!waitingReads.empty() && uiInFlight < uiEntryCount)
+		{
+			Push(waitingReads.front());
+			waitingReads.pop_front();
+		}
+		Enter();
+	}
+
+	void Enter()
+	{
+		while (uiUnsubmitted > 0)
+		{
+			int iSubmitted = (int)syscall(__NR_io_uring_enter, iFile, uiUnsubmitted, 0, 0, nullptr, 0);
+			if (iSubmitted < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (iSubmitted <= 0)
+			{
+				break; // Left for the next call
+			}
+			uiUnsubmitted -= (std::min)((unsigned int)iSubmitted, uiUnsubmitted);
+		}
+	}
+};
+
+#endif
+
+#pragma region Init
+
+AsyncFileReader::AsyncFileReader()
+{
+	m_bStopping = false;
+	m_bBlocking = true;
+#ifdef _WIN32
+	m_hPort = nullptr;
+#elif defined(__linux__)
+	m_pRing = nullptr;
+#endif
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+	if (!m_workers.empty())
+	{
+		WaitAll();
+	}
+
+	if (m_completionThread.joinable())
+	{
+#ifdef _WIN32
+		PostQueuedCompletionStatus(m_hPort, 0, 0, nullptr);
+#elif defined(__linux__)
+		{
+			std::lock_guard<std::mutex> lock(m_pRing->mutex);
+			m_pRing->Push(nullptr);
+			m_pRing->Enter();
+		}
+#endif
+		m_completionThread.join();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_jobCondition.notify_all();
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+
+#ifdef _WIN32
+	if (m_hPort)
+	{
+		CloseHandle(m_hPort);
+	}
+#elif defined(__linux__)
+	SAFE_DELETE(m_pRing);
+#endif
+}
+
+bool AsyncFileReader::Initialize(int iThreadCount)
+{
+	if (iThreadCount <= 0)
+	{
+		iThreadCount = (std::max)(1, (int)std::thread::hardware_concurrency());
+	}
+
+#ifdef _WIN32
+	m_hPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+	m_bBlocking = !m_hPort;
+#elif defined(__linux__)
+	m_pRing = new Ring();
+	if (!m_pRing->Create())
+	{
+		SAFE_DELETE(m_pRing);
+	}
+	m_bBlocking = !m_pRing;
+#endif
+
+	if (!m_bBlocking)
+	{
+		m_completionThread = std::thread(&AsyncFileReader::CompletionThread, this);
+	}
+	for (int i = 0; i < iThreadCount; i++)
+	{
+		m_workers.emplace_back(&AsyncFileReader::WorkerThread, this);
+	}
+
+	return true;
+}
+
+#pragma endregion
+
+#pragma region Setters/Getters
+
+const char* AsyncFileReader::GetBackendName() const
+{
+	if (m_bBlocking)
+	{
+		return "blocking reads";
+	}
+#ifdef _WIN32
+	return "I/O completion port";
+#else
+	return "io_uring";
+#endif
+}
+
+#pragma endregion
+
+#pragma region Reading
+
+int AsyncFileReader::Read(const char* filename, ReadCallback onComplete)
+{
+	std::unique_ptr<Request> request(new Request());
+	request->filename = filename;
+	request->onComplete = onComplete;
+	request->bytesRead = 0;
+	request->bFailed = false;
+	request->bComplete = false;
+#ifdef _WIN32
+	request->hFile = INVALID_HANDLE_VALUE;
+#else
+	request->iFile = -1;
+#endif
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_queuedRequests.push_back(request.get());
+	m_requests.push_back(std::move(request));
+	return (int)m_requests.size() - 1;
+}
+
+void AsyncFileReader::Submit()
+{
+	std::vector<Request*> requests;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		requests.swap(m_queuedRequests);
+		if (m_bBlocking)
+		{
+			m_jobs.insert(m_jobs.end(), requests.begin(), requests.end());
+		}
+	}
+
+	if (m_bBlocking)
+	{
+		m_jobCondition.notify_all();
+	}
+	else if (!requests.empty())
+	{
+		StartReads(requests);
+	}
+}
+
+bool AsyncFileReader::Wait(int iRequest)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (iRequest < 0 || iRequest >= (int)m_requests.size())
+	{
+		return false;
+	}
+	Request* pRequest = m_requests[iRequest].get();
+	if (!m_queuedRequests.empty())
+	{
+		lock.unlock();
+		Submit();
+		lock.lock();
+	}
+
+	m_completeCondition.wait(lock, [pRequest] { return pRequest->bComplete; });
+	return !pRequest->bFailed;
+}
+
+void AsyncFileReader::WaitAll()
+{
+	Submit();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_completeCondition.wait(lock, [this]
+	{
+		return std::all_of(m_requests.begin(), m_requests.end(), [](const std::unique_ptr<Request>& request) { return request->bComplete; });
+	});
+}
+
+bool AsyncFileReader::OpenFile(Request* pRequest)
+{
+#ifdef _WIN32
+	pRequest->hFile = CreateFileA(pRequest->filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, (m_bBlocking ? 0 : FILE_FLAG_OVERLAPPED) | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (pRequest->hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(pRequest->hFile, &fileSize) || (unsigned long long)fileSize.QuadPart > (size_t)-1)
+	{
+		CloseFile(pRequest);
+		return false;
+	}
+	pRequest->data.resize((size_t)fileSize.QuadPart);
+#else
+	pRequest->iFile = open(pRequest->filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if (pRequest->iFile < 0)
+	{
+		return false;
+	}
+
+	struct stat fileInfo;
+	if (fstat(pRequest->iFile, &fileInfo) != 0)
+	{
+		CloseFile(pRequest);
+		return false;
+	}
+	pRequest->data.resize((size_t)fileInfo.st_size);
+#endif
+
+	return true;
+}
+
+void AsyncFileReader::CloseFile(Request* pRequest)
+{
+#ifdef _WIN32
+	if (pRequest->hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(pRequest->hFile);
+		pRequest->hFile = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (pRequest->iFile >= 0)
+	{
+		close(pRequest->iFile);
+		pRequest->iFile = -1;
+	}
+#endif
+}
+
+bool AsyncFileReader::ReadBlocking(Request* pRequest)
+{
+	if (!OpenFile(pRequest))
+	{
+		return false;
+	}
+
+	while (pRequest->bytesRead < pRequest->data.size())
+	{
+		size_t size = (std::min)(pRequest->data.size() - pRequest->bytesRead, MaxReadSize);
+#ifdef _WIN32
+		DWORD dwRead = 0;
+		if (!ReadFile(pRequest->hFile, &pRequest->data[pRequest->bytesRead], (DWORD)size, &dwRead, nullptr) || dwRead == 0)
+		{
+			break;
+		}
+		pRequest->bytesRead += dwRead;
+#else
+		ssize_t iRead = pread(pRequest->iFile, &pRequest->data[pRequest->bytesRead], size, (off_t)pRequest->bytesRead);
+		if (iRead < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (iRead <= 0)
+		{
+			break;
+		}
+		pRequest->bytesRead += (size_t)iRead;
+#endif
+	}
+
+	CloseFile(pRequest);
+	return pRequest->bytesRead == pRequest->data.size();
+}
+
+#ifdef _WIN32
+
+bool AsyncFileReader::IssueRead(Request* pRequest)
+{
+	// The completion is queued on the port even when ReadFile finishes immediately
+	size_t size = (std::min)(pRequest->data.size() - pRequest->bytesRead, MaxReadSize);
+	ZeroMemory(&pRequest->overlapped, sizeof(OVERLAPPED));
+	pRequest->overlapped.Offset = (DWORD)pRequest->bytesRead;
+	pRequest->overlapped.OffsetHigh = (DWORD)((unsigned long long)pRequest->bytesRead >> 32);
+	return ReadFile(pRequest->hFile, &pRequest->data[pRequest->bytesRead], (DWORD)size, nullptr, &pRequest->overlapped) || GetLastError() == ERROR_IO_PENDING;
+}
+
+void AsyncFileReader::StartReads(const std::vector<Request*>& requests)
+{
+	// Every read is in flight before the first one is waited on, so the OS can queue and reorder them together
+	for (Request* pRequest : requests)
+	{
+		if (!OpenFile(pRequest))
+		{
+			FinishRead(pRequest, false);
+		}
+		else if (pRequest->data.empty())
+		{
+			CloseFile(pRequest);
+			FinishRead(pRequest, true);
+		}
+		else if (!CreateIoCompletionPort(pRequest->hFile, m_hPort, (ULONG_PTR)pRequest, 0) || !IssueRead(pRequest))
+		{
+			CloseFile(pRequest);
+			FinishRead(pRequest, false);
+		}
+	}
+}
+
+void AsyncFileReader::CompletionThread()
+{
+	for (;;)
+	{
+		DWORD dwRead = 0;
+		ULONG_PTR key = 0;
+		OVERLAPPED* pOverlapped = nullptr;
+		BOOL bResult = GetQueuedCompletionStatus(m_hPort, &dwRead, &key, &pOverlapped, INFINITE);
+		Request* pRequest = (Request*)key;
+		if (!pRequest)
+		{
+			return; // Posted by the destructor
+		}
+
+		if (!bResult || dwRead == 0)
+		{
+			CloseFile(pRequest);
+			FinishRead(pRequest, false);
+			continue;
+		}
+
+		pRequest->bytesRead += dwRead;
+		if (pRequest->bytesRead < pRequest->data.size())
+		{
+			if (!IssueRead(pRequest))
+			{
+				CloseFile(pRequest);
+				FinishRead(pRequest, false);
+			}
+			continue;
+		}
+
+		CloseFile(pRequest);
+		FinishRead(pRequest, true);
+	}
+}
+
+#elif defined(__linux__)
+
+void AsyncFileReader::StartReads(const std::vector<Request*>& requests)
+{
+	std::vector<Request*> openedRequests;
+	for (Request* pRequest : requests)
+	{
+		if (!OpenFile(pRequest))
+		{
+			FinishRead(pRequest, false);
+		}
+		else if (pRequest->data.empty())
+		{
+			CloseFile(pRequest);
+			FinishRead(pRequest, true);
+		}
+		else
+		{
+			openedRequests.push_back(pRequest);
+		}
+	}
+
+	// One system call submits the whole batch (as much of it as fits in the ring; the rest follows as reads complete)
+	std::lock_guard<std::mutex> lock(m_pRing->mutex);
+	m_pRing->waitingReads.insert(m_pRing->waitingReads.end(), openedRequests.begin(), openedRequests.end());
+	m_pRing->Flush();
+}
+
+void AsyncFileReader::CompletionThread()
+{
+	for (;;)
+	{
+		// Returns early if interrupted, which just makes the pass below find less (or nothing)
+		syscall(__NR_io_uring_enter, m_pRing->iFile, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+		std::lock_guard<std::mutex> lock(m_pRing->mutex);
+		bool bStopping = false;
+		unsigned int uiHead = *m_pRing->puiCompletionHead;
+		unsigned int uiTail = __atomic_load_n(m_pRing->puiCompletionTail, __ATOMIC_ACQUIRE);
+		for (; uiHead != uiTail; uiHead++)
+		{
+			const io_uring_cqe& entry = m_pRing->completionEntries[uiHead & m_pRing->uiCompletionMask];
+			Request* pRequest = (Request*)(uintptr_t)entry.user_data;
+			int iResult = entry.res;
+			m_pRing->uiInFlight--;
+
+			if (!pRequest)
+			{
+				bStopping = true;
+			}
+			else if (iResult == -EAGAIN || iResult == -EINTR)
+			{
+				m_pRing->waitingReads.push_back(pRequest);
+			}
+			else if (iResult <= 0)
+			{
+				CloseFile(pRequest);
+				FinishRead(pRequest, false);
+			}
+			else
+			{
+				// Short reads carry on from where they stopped
+				pRequest->bytesRead += (size_t)iResult;
+				if (pRequest->bytesRead < pRequest->data.size())
+				{
+					m_pRing->waitingReads.push_back(pRequest);
+				}
+				else
+				{
+					CloseFile(pRequest);
+					FinishRead(pRequest, true);
+				}
+			}
+		}
+		__atomic_store_n(m_pRing->puiCompletionHead, uiHead, __ATOMIC_RELEASE);
+
+		if (bStopping)
+		{
+			return;
+		}
+		m_pRing->Flush();
+	}
+}
+
+#else
+
+void AsyncFileReader::StartReads(const std::vector<Request*>& requests)
+{
+}
+
+void AsyncFileReader::CompletionThread()
+{
+}
+
+#endif
+
+void AsyncFileReader::FinishRead(Request* pRequest, bool bSucceeded)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		pRequest->bFailed = !bSucceeded;
+		m_jobs.push_back(pRequest);
+	}
+	m_jobCondition.notify_one();
+}
+
+void AsyncFileReader::WorkerThread()
+{
+	for (;;)
+	{
+		Request* pRequest = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobCondition.wait(lock, [this] { return m_bStopping || !m_jobs.empty(); });
+			if (m_jobs.empty())
+			{
+				return;
+			}
+			pRequest = m_jobs.front();
+			m_jobs.pop_front();
+		}
+
+		if (m_bBlocking)
+		{
+			pRequest->bFailed = !ReadBlocking(pRequest);
+		}
+
+		// Empty files still get a valid pointer, so that only failures are null
+		static const unsigned char empty = 0;
+		const unsigned char* data = pRequest->bFailed ? nullptr : pRequest->data.empty() ? &empty : pRequest->data.data();
+		if (pRequest->onComplete)
+		{
+			pRequest->onComplete(data, pRequest->bFailed ? 0 : pRequest->data.size());
+		}
+		std::vector<unsigned char>().swap(pRequest->data);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			pRequest->bComplete = true;
+		}
+		m_completeCondition.notify_all();
+	}
+}
+
+#pragma endregion
@@ -0,0 +1,90 @@
+//
+// AsyncFileReader.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// I/O Completion Ports (https://docs.microsoft.com/en-us/windows/desktop/FileIO/i-o-completion-ports)
+// Efficient IO with io_uring (Axboe, 2019) (https://kernel.dk/io_uring.pdf)
+//
+
+#ifndef ASYNC_FILE_READER_H
+#define ASYNC_FILE_READER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Utils.h"
+
+// Runs on a worker thread once the whole file has been read; data is nullptr if the read failed, and is freed when the callback returns
+typedef std::function<void(const unsigned char* data, size_t size)> ReadCallback;
+
+// Reads whole files in the background: Submit hands every queued read to the OS at once, and each file's callback (its decode job) runs on a worker as soon as that file has been read
+// Windows uses overlapped reads on an I/O completion port and Linux uses io_uring; elsewhere, or if the ring can't be created, the workers read the files with blocking calls
+class AsyncFileReader
+{
+public:
+	AsyncFileReader();
+	~AsyncFileReader(); // Waits for every submitted read
+
+	bool Initialize(int iThreadCount = 0); // Workers that run the callbacks (0 uses every core)
+	int Read(const char* filename, ReadCallback onComplete); // Queued until the next Submit; returns the request index
+	void Submit();
+	bool Wait(int iRequest); // Submits if needed, then blocks until the request's callback has returned; false if the read failed
+	void WaitAll();
+	const char* GetBackendName() const;
+
+private:
+	struct Request
+	{
+		std::string filename;
+		ReadCallback onComplete;
+		std::vector<unsigned char> data;
+		size_t bytesRead;
+		bool bFailed;
+		bool bComplete; // The callback has returned
+#ifdef _WIN32
+		HANDLE hFile;
+		OVERLAPPED overlapped;
+#else
+		int iFile;
+#endif
+	};
+
+#ifdef __linux__
+	struct Ring; // io_uring submission and completion queues, mapped from the kernel
+#endif
+
+	std::vector<std::unique_ptr<Request>> m_requests;
+	std::vector<Request*> m_queuedRequests; // Waiting for Submit
+	std::vector<std::thread> m_workers;
+	std::thread m_completionThread; // Turns finished reads into jobs for the workers (the blocking fallback has none)
+	std::mutex m_mutex;
+	std::condition_variable m_jobCondition;
+	std::condition_variable m_completeCondition;
+	std::deque<Request*> m_jobs; // Reads that have finished, or that the workers have to do themselves when blocking
+	bool m_bStopping;
+	bool m_bBlocking;
+#ifdef _WIN32
+	HANDLE m_hPort;
+#elif defined(__linux__)
+	Ring* m_pRing;
+#endif
+
+	bool OpenFile(Request* pRequest); // Opens the file and sizes the buffer
+	void CloseFile(Request* pRequest);
+	bool ReadBlocking(Request* pRequest);
+#ifdef _WIN32
+	bool IssueRead(Request* pRequest); // The next piece of the file, from where the last one stopped
+#endif
+	void StartReads(const std::vector<Request*>& requests);
+	void FinishRead(Request* pRequest, bool bSucceeded); // Queues the callback
+	void CompletionThread();
+	void WorkerThread();
+};
+
+#endif
@@ -0,0 +1,189 @@
+//
+// AliasTableBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Samples per second from an AliasTable built over the triangle areas of the fountain, against a binary search of the cumulative areas,
+// for the whole mesh and for the spout that the particles are emitted from
+// Checks, with a chi-square test, that the triangles are sampled in proportion to their areas, and that the test rejects sampling them
+// uniformly instead
+//
+// Usage: AliasTableBenchmark [resource directory] [samples] (Resources and 10000000 by default)
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "AliasTable.h"
+#include "Benchmark.h"
+#include "MappedFile.h"
+#include "MeshFile.h"
+
+namespace
+{
+	const int MinSampleCount = 1000000;
+	const double MinSamplesPerSecond = 1e6;
+	const double ChiSquareZ = 3.09; // Standard normal quantile of the test's significance, 0.001
+	const double MinExpectedCount = 5.0; // Triangles expected fewer samples than this are pooled into one bin
+
+	// Triangle areas as ParticleSystem::SetEmitterMesh weighs them, keeping only those entirely above the minimum height once transformed
+	std::vector<float> GetAreas(const std::vector<ModelData>& vertices, const XMMATRIX& transformMatrix, float fMinHeight)
+	{
+		std::vector<float> areas;
+		for (size_t i = 0; i + 2 < vertices.size(); i += 3)
+		{
+			XMVECTOR vA = XMVector3TransformCoord(XMVectorSet(vertices[i].x, vertices[i].y, vertices[i].z, 1.0f), transformMatrix);
+			XMVECTOR vB = XMVector3TransformCoord(XMVectorSet(vertices[i + 1].x, vertices[i + 1].y, vertices[i + 1].z, 1.0f), transformMatrix);
+			XMVECTOR vC = XMVector3TransformCoord(XMVectorSet(vertices[i + 2].x, vertices[i + 2].y, vertices[i + 2].z, 1.0f), transformMatrix);
+			if (XMVectorGetY(vA) < fMinHeight || XMVectorGetY(vB) < fMinHeight || XMVectorGetY(vC) < fMinHeight)
+			{
+				continue;
+			}
+
+			float fArea = 0.5f * XMVectorGetX(XMVector3Length(XMVector3Cross(vB - vA, vC - vA)));
+			if (fArea > 0.0f)
+			{
+				areas.push_back(fArea);
+			}
+		}
+
+		return areas;
+	}
+
+	// Pearson's statistic of the counts against the areas, with the bins expected too few samples pooled, and its critical value
+	// (Wilson and Hilferty's approximation of the chi-square quantile for the degrees of freedom left)
+	void GetChiSquare(const std::vector<int>& counts, const std::vector<float>& areas, double& dStatistic, double& dCriticalValue, int& iBinCount)
+	{
+		double dTotalArea = 0.0;
+		long long llTotalCount = 0;
+		for (size_t i = 0; i < areas.size(); i++)
+		{
+			dTotalArea += areas[i];
+			llTotalCount += counts[i];
+		}
+
+		dStatistic = 0.0;
+		iBinCount = 0;
+		double dPooledExpected = 0.0;
+		long long llPooledCount = 0;
+		for (size_t i = 0; i < areas.size(); i++)
+		{
+			double dExpected = llTotalCount * areas[i] / dTotalArea;
+			if (dExpected < MinExpectedCount)
+			{
+				dPooledExpected += dExpected;
+				llPooledCount += counts[i];
+				continue;
+			}
+			dStatistic += (counts[i] - dExpected) * (counts[i] - dExpected) / dExpected;
+			iBinCount++;
+		}
+		if (dPooledExpected > 0.0)
+		{
+			dStatistic += (llPooledCount - dPooledExpected) * (llPooledCount - dPooledExpected) / dPooledExpected;
+			iBinCount++;
+		}
+
+		double dFreedom = (std::max)(iBinCount - 1, 1);
+		double dTerm = 2.0 / (9.0 * dFreedom);
+		dCriticalValue = dFreedom * pow(1.0 - dTerm + ChiSquareZ * sqrt(dTerm), 3.0);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string resourceDirectory = Benchmark::GetArgument(argc, argv, 1, RESOURCE_DIRECTORY);
+	int iSampleCount = (std::max)(Benchmark::GetArgument(argc, argv, 2, 10000000), MinSampleCount);
+
+	MappedFile file;
+	std::vector<ModelData> vertices;
+	if (!Benchmark::Check(file.Open((resourceDirectory + "/fountain.txt").c_str()) && MeshFile::ParseText(file.GetData(), file.GetSize(), vertices), "fountain.txt loads"))
+	{
+		return Benchmark::GetExitCode();
+	}
+
+	// The same uniform numbers for every sampler, so only the lookups are timed
+	std::mt19937 generator(1);
+	std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+	std::vector<float> uniforms(2 * (size_t)iSampleCount);
+	for (float& fU : uniforms)
+	{
+		fU = distribution(generator);
+	}
+
+	// GraphicsEngine's spout: the fountain placed as ResourceManager places it, in the space of the particle system at (0, 5.5, -7.5)
+	struct Region
+	{
+		const char* name;
+		XMMATRIX transformMatrix;
+		float fMinHeight;
+	};
+	const Region regions[] =
+	{
+		{ "whole fountain", XMMatrixIdentity(), -FLT_MAX },
+		{ "spout", XMMatrixTranslation(3.0f, 125.0f, -375.0f) * XMMatrixScaling(0.02f, 0.02f, 0.02f) * XMMatrixTranslation(0.0f, -5.5f, 7.5f), -1.2f }
+	};
+	for (const Region& region : regions)
+	{
+		std::vector<float> areas = GetAreas(vertices, region.transformMatrix, region.fMinHeight);
+		AliasTable table;
+		auto start = Benchmark::Clock::now();
+		bool bInitialized = table.Initialize(areas.data(), (int)areas.size());
+		double dBuildTime = Benchmark::GetMilliseconds(start);
+		if (!Benchmark::Check(bInitialized, std::string("the alias table of the ") + region.name + " builds"))
+		{
+			continue;
+		}
+
+		std::vector<int> counts(areas.size(), 0);
+		start = Benchmark::Clock::now();
+		for (int i = 0; i < iSampleCount; i++)
+		{
+			counts[table.Sample(uniforms[2 * i], uniforms[2 * i + 1])]++;
+		}
+		double dAliasTime = Benchmark::GetMilliseconds(start);
+
+		// What the table replaces: a binary search of the running total of the areas
+		std::vector<float> cumulativeAreas(areas.size());
+		float fTotal = 0.0f;
+		for (size_t i = 0; i < areas.size(); i++)
+		{
+			fTotal += areas[i];
+			cumulativeAreas[i] = fTotal;
+		}
+		long long llSearchSum = 0;
+		start = Benchmark::Clock::now();
+		for (int i = 0; i < iSampleCount; i++)
+		{
+			llSearchSum += std::upper_bound(cumulativeAreas.begin(), cumulativeAreas.end() - 1, uniforms[2 * i] * fTotal) - cumulativeAreas.begin();
+		}
+		double dSearchTime = Benchmark::GetMilliseconds(start);
+
+		double dSamplesPerSecond = iSampleCount / (dAliasTime / 1000.0);
+		printf("%s (%d triangles): built in %.3f ms; %d samples at %.1f million a second (%.1f ns each), binary search %.1f million a second (mean triangle %.0f)\n", region.name,
+			(int)areas.size(), dBuildTime, iSampleCount, dSamplesPerSecond / 1e6, dAliasTime * 1e6 / iSampleCount, iSampleCount / (dSearchTime / 1000.0) / 1e6, (double)llSearchSum / iSampleCount);
+		Benchmark::Check(dSamplesPerSecond >= MinSamplesPerSecond, std::string("the ") + region.name + " samples at least a million times a second");
+
+		double dStatistic, dCriticalValue;
+		int iBinCount;
+		GetChiSquare(counts, areas, dStatistic, dCriticalValue, iBinCount);
+		printf("  Chi-square %.1f over %d bins (critical %.1f at 0.001)\n", dStatistic, iBinCount, dCriticalValue);
+		Benchmark::Check(dStatistic < dCriticalValue, std::string("the ") + region.name + "'s triangles are sampled in proportion to their areas");
+
+		// Ignoring the areas must fail the same test, or it proves nothing
+		std::vector<int> uniformCounts(areas.size(), 0);
+		for (int i = 0; i < iSampleCount; i++)
+		{
+			uniformCounts[(std::min)((int)(uniforms[2 * i] * areas.size()), (int)areas.size() - 1)]++;
+		}
+		double dUniformStatistic, dUniformCriticalValue;
+		GetChiSquare(uniformCounts, areas, dUniformStatistic, dUniformCriticalValue, iBinCount);
+		printf("  Sampled uniformly instead: chi-square %.1f (critical %.1f)\n", dUniformStatistic, dUniformCriticalValue);
+		Benchmark::Check(dUniformStatistic > dUniformCriticalValue, std::string("the test rejects sampling the ") + region.name + "'s triangles uniformly");
+	}
+
+	return Benchmark::GetExitCode();
+}
@@ -0,0 +1,203 @@
+//
+// AssetArchiveBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Size of the resources packed into an AssetArchive, and the time to load every one of them from the archive (on one thread and
+// on every core) against reading the loose files, from a cold page cache (the files dropped from it before each load, on Linux) and a warm one
+// Checks that every entry round trips, that names match without case and with either slash, that LZCompressor round trips
+// runs of every length class, and that randomly corrupted or truncated archives are rejected or loaded without overrunning
+//
+// Usage: AssetArchiveBenchmark [resource directory] [archive] [corrupted copies] (Resources, Resources.pak and 3000 by default)
+//
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "AssetArchive.h"
+#include "Benchmark.h"
+
+namespace
+{
+	const int RepeatCount = 7;
+
+	bool ReadFile(const std::string& filename, std::vector<unsigned char>& data)
+	{
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		data.resize((size_t)file.tellg());
+		file.seekg(0);
+		return (bool)file.read((char*)data.data(), data.size());
+	}
+
+	double GetMedian(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		return values[values.size() / 2];
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string resourceDirectory = Benchmark::GetArgument(argc, argv, 1, RESOURCE_DIRECTORY);
+	std::string archiveFilename = Benchmark::GetArgument(argc, argv, 2, "Resources.pak");
+	int iCorruptedCount = Benchmark::GetArgument(argc, argv, 3, 3000);
+
+	// Single blocks of one repeated byte cover the literal-only, short match and long match length encodings
+	for (size_t length : { 1, 8, 20, 100, 1000, 65536 })
+	{
+		std::vector<unsigned char> run(length, 7);
+		std::vector<unsigned char> compressed;
+		std::vector<unsigned char> decompressed(length);
+		LZCompressor::Compress(run.data(), length, compressed);
+		bool bRoundTrips = LZCompressor::Decompress(compressed.data(), compressed.size(), decompressed.data(), length) && decompressed == run;
+		Benchmark::Check(bRoundTrips && compressed.size() <= LZCompressor::GetMaxCompressedSize(length), "a run of " + std::to_string(length) + " bytes round trips");
+	}
+
+	ArchiveStats stats = {};
+	auto start = Benchmark::Clock::now();
+	bool bBuilt = AssetArchive::Build(resourceDirectory.c_str(), archiveFilename.c_str(), 0, &stats);
+	double dBuildMilliseconds = Benchmark::GetMilliseconds(start);
+	AssetArchive archive;
+	if (!Benchmark::Check(bBuilt && archive.Open(archiveFilename.c_str()), "the archive builds and opens"))
+	{
+		return Benchmark::GetExitCode();
+	}
+	printf("Built in %.0f ms: %d entries, %d chunks compressed and %d stored, %.1f MB packed into %.1f MB\n",
+		dBuildMilliseconds, stats.iEntryCount, stats.iCompressedChunks, stats.iStoredChunks, stats.originalBytes / 1048576.0, stats.archiveBytes / 1048576.0);
+
+	std::vector<std::string> names;
+	for (int i = 0; i < archive.GetEntryCount(); i++)
+	{
+		std::string name = archive.GetEntryName(i);
+		names.push_back(name);
+
+		std::vector<unsigned char> original;
+		std::vector<unsigned char> buffer;
+		size_t size = 0;
+		const unsigned char* data = archive.Load(name.c_str(), &size, buffer);
+		bool bMatches = ReadFile(name, original) && data && size == original.size() && memcmp(data, original.data(), size) == 0;
+		Benchmark::Check(bMatches, name + " round trips");
+	}
+	Benchmark::Check(archive.GetEntryCount() == stats.iEntryCount, "every file is packed");
+
+	std::string upperCaseName = names.empty() ? std::string() : names.back();
+	std::transform(upperCaseName.begin(), upperCaseName.end(), upperCaseName.begin(), [](char c) { return (c == '/') ? '\\' : (char)toupper(c); });
+	Benchmark::Check(archive.Contains(upperCaseName.c_str()), "names match without case and with either slash");
+	Benchmark::Check(!archive.Contains((resourceDirectory + "/missing.dds").c_str()), "missing names are not found");
+
+	// Touch every page, as a consumer would; cold runs drop the archive and the loose files from the page cache before each load, so they
+	// read from disk, and warm runs leave them cached, so they time decompression against copying
+	volatile unsigned int uiSink = 0;
+	bool bEvicted = true;
+	for (bool bCold : { true, false })
+	{
+		std::vector<double> looseTimes;
+		std::vector<double> singleThreadTimes;
+		std::vector<double> parallelTimes;
+		auto evict = [&]()
+		{
+			if (bCold)
+			{
+				archive.Close(); // Mapped pages are not dropped
+				bEvicted &= Benchmark::EvictFile(archiveFilename);
+				for (const std::string& name : names)
+				{
+					bEvicted &= Benchmark::EvictFile(name);
+				}
+				archive.Open(archiveFilename.c_str());
+			}
+		};
+
+		for (int iRepeat = 0; iRepeat < RepeatCount; iRepeat++)
+		{
+			evict();
+			start = Benchmark::Clock::now();
+			for (const std::string& name : names)
+			{
+				std::vector<unsigned char> data;
+				ReadFile(name, data);
+				for (size_t i = 0; i < data.size(); i += 4096)
+				{
+					uiSink += data[i];
+				}
+			}
+			looseTimes.push_back(Benchmark::GetMilliseconds(start));
+
+			for (int iThreadCount : { 1, 0 })
+			{
+				evict();
+				start = Benchmark::Clock::now();
+				for (const std::string& name : names)
+				{
+					std::vector<unsigned char> buffer;
+					size_t size = 0;
+					const unsigned char* data = archive.Load(name.c_str(), &size, buffer, iThreadCount);
+					for (size_t i = 0; data && i < size; i += 4096)
+					{
+						uiSink += data[i];
+					}
+				}
+				((iThreadCount == 1) ? singleThreadTimes : parallelTimes).push_back(Benchmark::GetMilliseconds(start));
+			}
+		}
+		if (bCold && !bEvicted)
+		{
+			printf("The page cache could not be dropped here, so the cold runs below are warm\n");
+		}
+		printf("Loading every entry %s (median of %d): loose files %.2f ms, archive on one thread %.2f ms, archive on every core %.2f ms\n",
+			bCold ? "from a cold cache" : "from a warm cache", RepeatCount, GetMedian(looseTimes), GetMedian(singleThreadTimes), GetMedian(parallelTimes));
+	}
+	archive.Close();
+
+	std::vector<unsigned char> file;
+	ReadFile(archiveFilename, file);
+	std::string corruptedFilename = archiveFilename + ".corrupt";
+	std::mt19937 generator(7);
+	int iOpenedCount = 0;
+	int iWrongSizeCount = 0;
+	for (int i = 0; i < iCorruptedCount && !file.empty(); i++)
+	{
+		// Mostly in the header and table of contents, where a bad offset would do the most damage
+		std::vector<unsigned char> corrupted = file;
+		int iByteCount = 1 + generator() % 8;
+		for (int j = 0; j < iByteCount; j++)
+		{
+			size_t position = (generator() % 2) ? generator() % 2048 : generator() % corrupted.size();
+			corrupted[position] = (unsigned char)generator();
+		}
+		size_t length = (generator() % 5 == 0) ? generator() % corrupted.size() : corrupted.size();
+		std::ofstream(corruptedFilename, std::ios::binary | std::ios::trunc).write((const char*)corrupted.data(), length);
+
+		AssetArchive corruptedArchive;
+		if (!corruptedArchive.Open(corruptedFilename.c_str()))
+		{
+			continue;
+		}
+
+		iOpenedCount++;
+		for (int iEntry = 0; iEntry < corruptedArchive.GetEntryCount(); iEntry++)
+		{
+			std::string name = corruptedArchive.GetEntryName(iEntry);
+			std::vector<unsigned char> buffer;
+			size_t size = 0;
+			if (corruptedArchive.Load(name.c_str(), &size, buffer) && size != corruptedArchive.GetSize(name.c_str()))
+			{
+				iWrongSizeCount++;
+			}
+		}
+	}
+	remove(corruptedFilename.c_str());
+	printf("%d corrupted copies: %d still opened\n", iCorruptedCount, iOpenedCount);
+	Benchmark::Check(iWrongSizeCount == 0, "corrupted entries either fail or load at their full size");
+
+	return Benchmark::GetExitCode();
+}
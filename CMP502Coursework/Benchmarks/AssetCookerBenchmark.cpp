@@ -0,0 +1,158 @@
+//
+// AssetCookerBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Time to cook a copy of the resources from scratch, again from the cache, and again after one source changes, and the vertex
+// cache miss ratio (ACMR) of each cooked mesh against the unindexed text model
+// Checks the cooked and cached counts, that every cooked mesh holds the same triangles as its text model at full detail, that a
+// truncated mesh is rejected, and that cooking on one thread gives the same bytes as cooking on every core
+//
+// Usage: AssetCookerBenchmark [resource directory] [working directory] (Resources and CookBenchmark by default)
+// The working directory is deleted and filled with a copy of the sources, the cooked output and the caches
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "AssetCooker.h"
+#include "Benchmark.h"
+
+namespace
+{
+	bool ReadFile(const std::string& filename, std::vector<unsigned char>& data)
+	{
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		data.resize((size_t)file.tellg());
+		file.seekg(0);
+		return (bool)file.read((char*)data.data(), data.size());
+	}
+
+	// Each triangle as the bytes of its three vertices, starting from the smallest so that the optimizer's rotations don't matter
+	std::string GetTriangleKey(const ModelData& a, const ModelData& b, const ModelData& c)
+	{
+		std::string corners[3] = { std::string((const char*)&a, sizeof(ModelData)), std::string((const char*)&b, sizeof(ModelData)), std::string((const char*)&c, sizeof(ModelData)) };
+		int iFirst = (int)(std::min_element(corners, corners + 3) - corners);
+		return corners[iFirst] + corners[(iFirst + 1) % 3] + corners[(iFirst + 2) % 3];
+	}
+
+	bool Cook(const std::string& sourceDirectory, const std::string& outputDirectory, const std::string& cacheDirectory, int iThreadCount, CookStats& stats, double& dMilliseconds)
+	{
+		stats = CookStats();
+		auto start = Benchmark::Clock::now();
+		bool bResult = AssetCooker::Cook(sourceDirectory.c_str(), outputDirectory.c_str(), cacheDirectory.c_str(), iThreadCount, &stats);
+		dMilliseconds = Benchmark::GetMilliseconds(start);
+		return bResult;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string resourceDirectory = Benchmark::GetArgument(argc, argv, 1, RESOURCE_DIRECTORY);
+	std::string workingDirectory = Benchmark::GetArgument(argc, argv, 2, "CookBenchmark");
+	std::string sourceDirectory = workingDirectory + "/Resources";
+	std::string outputDirectory = workingDirectory + "/Cooked";
+	std::string cacheDirectory = workingDirectory + "/CookCache";
+
+	// A copy of the sources, so that one of them can be changed
+	std::error_code error;
+	std::filesystem::remove_all(workingDirectory, error);
+	std::filesystem::create_directories(sourceDirectory, error);
+	std::filesystem::copy(resourceDirectory, sourceDirectory, error);
+	if (!Benchmark::Check(!error, "the sources are copied"))
+	{
+		return Benchmark::GetExitCode();
+	}
+
+	CookStats stats;
+	double dMilliseconds = 0.0;
+	bool bCooked = Cook(sourceDirectory, outputDirectory, cacheDirectory, 0, stats, dMilliseconds);
+	printf("From scratch: %d assets in %.0f ms (%d cooked, %d from the cache)\n", stats.iAssetCount, dMilliseconds, stats.iCookedCount, stats.iCachedCount);
+	Benchmark::Check(bCooked && stats.iFailedCount == 0 && stats.iCookedCount == stats.iAssetCount, "every asset cooks from scratch");
+	int iAssetCount = stats.iAssetCount;
+
+	bCooked = Cook(sourceDirectory, outputDirectory, cacheDirectory, 0, stats, dMilliseconds);
+	printf("Unchanged: %d assets in %.0f ms (%d cooked, %d from the cache)\n", stats.iAssetCount, dMilliseconds, stats.iCookedCount, stats.iCachedCount);
+	Benchmark::Check(bCooked && stats.iCachedCount == iAssetCount, "every asset comes from the cache when nothing changed");
+
+	std::ofstream(sourceDirectory + "/plane.txt", std::ios::binary | std::ios::app) << "\n";
+	bCooked = Cook(sourceDirectory, outputDirectory, cacheDirectory, 0, stats, dMilliseconds);
+	printf("One source changed: %d assets in %.0f ms (%d cooked, %d from the cache)\n", stats.iAssetCount, dMilliseconds, stats.iCookedCount, stats.iCachedCount);
+	Benchmark::Check(bCooked && stats.iCookedCount == 1 && stats.iCachedCount == iAssetCount - 1, "only the changed asset cooks again");
+
+	std::vector<std::string> filenames;
+	Utils::ListFiles(sourceDirectory.c_str(), filenames);
+	for (const std::string& filename : filenames)
+	{
+		if (filename.size() < 4 || filename.compare(filename.size() - 4, 4, ".txt") != 0)
+		{
+			continue;
+		}
+
+		std::vector<unsigned char> text;
+		std::vector<unsigned char> cooked;
+		std::vector<ModelData> textVertices;
+		std::vector<ModelData> vertices;
+		std::vector<unsigned int> indices;
+		std::vector<MeshLod> lods;
+		std::vector<Meshlet> meshlets;
+		bool bRead = ReadFile(sourceDirectory + "/" + filename, text) && ReadFile(outputDirectory + "/" + filename.substr(0, filename.size() - 4) + ".mesh", cooked)
+			&& MeshFile::ParseText(text.data(), text.size(), textVertices) && MeshFile::ReadCooked(cooked.data(), cooked.size(), vertices, indices, lods, meshlets);
+		if (!Benchmark::Check(bRead, filename + " has a cooked mesh"))
+		{
+			continue;
+		}
+
+		// The triangles welding keeps: the ones whose corners are all different
+		std::vector<std::string> textTriangles;
+		for (size_t i = 0; i + 2 < textVertices.size(); i += 3)
+		{
+			const ModelData* corners = &textVertices[i];
+			if (memcmp(&corners[0], &corners[1], sizeof(ModelData)) != 0 && memcmp(&corners[1], &corners[2], sizeof(ModelData)) != 0 && memcmp(&corners[0], &corners[2], sizeof(ModelData)) != 0)
+			{
+				textTriangles.push_back(GetTriangleKey(corners[0], corners[1], corners[2]));
+			}
+		}
+
+		unsigned int uiFullIndexCount = lods.empty() ? (unsigned int)indices.size() : lods[0].uiIndexCount;
+		std::vector<unsigned int> fullIndices(indices.begin(), indices.begin() + uiFullIndexCount);
+		std::vector<std::string> cookedTriangles;
+		for (size_t i = 0; i + 2 < fullIndices.size(); i += 3)
+		{
+			cookedTriangles.push_back(GetTriangleKey(vertices[fullIndices[i]], vertices[fullIndices[i + 1]], vertices[fullIndices[i + 2]]));
+		}
+		std::sort(textTriangles.begin(), textTriangles.end());
+		std::sort(cookedTriangles.begin(), cookedTriangles.end());
+		Benchmark::Check(textTriangles == cookedTriangles, filename + " keeps its triangles");
+
+		printf("%s: %d vertices welded to %d, ACMR 3.00 unindexed and %.2f cooked\n", filename.c_str(), (int)textVertices.size(), (int)vertices.size(), MeshOptimizer::GetACMR(fullIndices, (int)vertices.size()));
+
+		cooked.pop_back();
+		Benchmark::Check(!MeshFile::ReadCooked(cooked.data(), cooked.size(), vertices, indices, lods, meshlets), filename + " is rejected when truncated");
+	}
+
+	// Each asset is cooked on its own, so the thread count can't change the output
+	std::string singleThreadDirectory = workingDirectory + "/CookedOnOneThread";
+	bCooked = Cook(sourceDirectory, singleThreadDirectory, workingDirectory + "/CookCacheOnOneThread", 1, stats, dMilliseconds);
+	printf("From scratch on one thread: %d assets in %.0f ms\n", stats.iAssetCount, dMilliseconds);
+	std::vector<std::string> cookedFilenames;
+	Utils::ListFiles(outputDirectory.c_str(), cookedFilenames);
+	bool bSame = bCooked && !cookedFilenames.empty();
+	for (const std::string& filename : cookedFilenames)
+	{
+		std::vector<unsigned char> data;
+		std::vector<unsigned char> singleThreadData;
+		bSame &= ReadFile(outputDirectory + "/" + filename, data) && ReadFile(singleThreadDirectory + "/" + filename, singleThreadData) && data == singleThreadData;
+	}
+	Benchmark::Check(bSame, "cooking on one thread gives the same files");
+
+	return Benchmark::GetExitCode();
+}
@@ -0,0 +1,212 @@
+//
+// AsyncFileReaderBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Time to read every shipped resource, and to read and parse every model, with AsyncFileReader (callbacks on the workers) against
+// sequential ifstream reads on the calling thread, from a cold page cache (the files dropped from it before each pass, on Linux) and a warm one
+// Checks that 300 reads, submitted in two batches and mixing in missing and empty files, deliver exactly the files' contents,
+// that missing files reach their callback as nullptr and make Wait fail, and that the reader can be destroyed with reads outstanding
+//
+// Usage: AsyncFileReaderBenchmark [resource directory] [repeats] (Resources and 5 by default)
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "AsyncFileReader.h"
+#include "Benchmark.h"
+#include "MeshFile.h"
+
+namespace
+{
+	std::vector<unsigned char> ReadFile(const std::string& filename)
+	{
+		std::vector<unsigned char> data;
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		if (file.is_open())
+		{
+			data.resize((size_t)file.tellg());
+			file.seekg(0);
+			file.read((char*)data.data(), data.size());
+		}
+
+		return data;
+	}
+
+	size_t ParseModel(const unsigned char* data, size_t size)
+	{
+		std::vector<ModelData> vertices;
+		return MeshFile::ParseText(data, size, vertices, nullptr, 1) ? vertices.size() : 0;
+	}
+
+	double GetMedian(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		return values[values.size() / 2];
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string resourceDirectory = Benchmark::GetArgument(argc, argv, 1, RESOURCE_DIRECTORY);
+	int iRepeatCount = (std::max)(Benchmark::GetArgument(argc, argv, 2, 5), 1);
+
+	std::vector<std::string> filenames;
+	Utils::ListFiles(resourceDirectory.c_str(), filenames);
+	std::vector<std::string> files;
+	std::vector<std::string> models;
+	for (const std::string& filename : filenames)
+	{
+		files.push_back(resourceDirectory + "/" + filename);
+		if (filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".txt") == 0)
+		{
+			models.push_back(files.back());
+		}
+	}
+	if (!Benchmark::Check(!files.empty() && !models.empty(), "the resources are found"))
+	{
+		return Benchmark::GetExitCode();
+	}
+
+	const std::string missingFilename = resourceDirectory + "/missing.txt";
+	const std::string emptyFilename = "AsyncFileReaderBenchmark.empty";
+	std::ofstream(emptyFilename, std::ios::binary | std::ios::trunc);
+	{
+		AsyncFileReader reader;
+		reader.Initialize();
+		printf("Backend: %s\n", reader.GetBackendName());
+
+		const int iRequestCount = 300;
+		std::vector<std::vector<unsigned char>> contents(iRequestCount);
+		std::vector<std::string> requestFilenames;
+		std::vector<int> requests;
+		std::atomic<int> iNullCount(0);
+		for (int i = 0; i < iRequestCount; i++)
+		{
+			requestFilenames.push_back((i % 17 == 5) ? missingFilename : (i % 19 == 3) ? emptyFilename : files[i % files.size()]);
+			std::vector<unsigned char>* pContents = &contents[i];
+			requests.push_back(reader.Read(requestFilenames.back().c_str(), [pContents, &iNullCount](const unsigned char* data, size_t size)
+			{
+				if (data)
+				{
+					pContents->assign(data, data + size);
+				}
+				else
+				{
+					iNullCount++;
+				}
+			}));
+
+			// Part way through, so that the second batch is queued while the first is in flight
+			if (i == iRequestCount / 2)
+			{
+				reader.Submit();
+			}
+		}
+
+		int iWrongCount = 0;
+		int iMissingCount = 0;
+		for (int i = 0; i < iRequestCount; i++)
+		{
+			bool bMissing = requestFilenames[i] == missingFilename;
+			bool bRead = reader.Wait(requests[i]);
+			iMissingCount += bMissing ? 1 : 0;
+			iWrongCount += (bRead == bMissing || (bRead && contents[i] != ReadFile(requestFilenames[i]))) ? 1 : 0;
+		}
+		Benchmark::Check(iWrongCount == 0, "every read delivers the file's contents, and only missing files fail");
+		Benchmark::Check(iNullCount == iMissingCount, "missing files reach their callback as nullptr");
+
+		// Left outstanding for the destructor
+		for (const std::string& file : files)
+		{
+			reader.Read(file.c_str(), nullptr);
+		}
+		reader.Submit();
+	}
+	remove(emptyFilename.c_str());
+
+	// Cold runs drop every file from the page cache before each pass, so they read from disk; warm runs leave them cached
+	bool bEvicted = true;
+	for (bool bCold : { true, false })
+	{
+		auto evict = [&]()
+		{
+			for (const std::string& file : files)
+			{
+				bEvicted &= !bCold || Benchmark::EvictFile(file);
+			}
+		};
+
+		std::vector<double> sequentialReadTimes;
+		std::vector<double> asyncReadTimes;
+		std::vector<double> sequentialParseTimes;
+		std::vector<double> asyncParseTimes;
+		size_t totalBytes = 0;
+		size_t vertexCount = 0;
+		for (int iRepeat = 0; iRepeat < iRepeatCount; iRepeat++)
+		{
+			evict();
+			auto start = Benchmark::Clock::now();
+			totalBytes = 0;
+			for (const std::string& file : files)
+			{
+				totalBytes += ReadFile(file).size();
+			}
+			sequentialReadTimes.push_back(Benchmark::GetMilliseconds(start));
+
+			evict();
+			start = Benchmark::Clock::now();
+			std::atomic<size_t> asyncBytes(0);
+			{
+				AsyncFileReader reader;
+				reader.Initialize();
+				for (const std::string& file : files)
+				{
+					reader.Read(file.c_str(), [&asyncBytes](const unsigned char*, size_t size) { asyncBytes += size; });
+				}
+				reader.WaitAll();
+			}
+			asyncReadTimes.push_back(Benchmark::GetMilliseconds(start));
+			Benchmark::Check(asyncBytes == totalBytes, "the reader reads as many bytes as ifstream");
+
+			evict();
+			start = Benchmark::Clock::now();
+			vertexCount = 0;
+			for (const std::string& model : models)
+			{
+				std::vector<unsigned char> data = ReadFile(model);
+				vertexCount += ParseModel(data.data(), data.size());
+			}
+			sequentialParseTimes.push_back(Benchmark::GetMilliseconds(start));
+
+			evict();
+			start = Benchmark::Clock::now();
+			std::atomic<size_t> asyncVertexCount(0);
+			{
+				AsyncFileReader reader;
+				reader.Initialize();
+				for (const std::string& model : models)
+				{
+					reader.Read(model.c_str(), [&asyncVertexCount](const unsigned char* data, size_t size) { asyncVertexCount += ParseModel(data, size); });
+				}
+				reader.WaitAll();
+			}
+			asyncParseTimes.push_back(Benchmark::GetMilliseconds(start));
+			Benchmark::Check(asyncVertexCount == vertexCount, "the reader's parse jobs find every vertex");
+		}
+		if (bCold && !bEvicted)
+		{
+			printf("The page cache could not be dropped here, so the cold runs below are warm\n");
+		}
+		const char* cache = bCold ? "cold" : "warm";
+		printf("Reading %d files from a %s cache (%.1f MB, median of %d): sequential %.2f ms, asynchronous %.2f ms\n",
+			(int)files.size(), cache, totalBytes / 1048576.0, iRepeatCount, GetMedian(sequentialReadTimes), GetMedian(asyncReadTimes));
+		printf("Reading and parsing %d models from a %s cache (%d vertices, one thread per model): sequential %.1f ms, asynchronous %.1f ms\n",
+			(int)models.size(), cache, (int)vertexCount, GetMedian(sequentialParseTimes), GetMedian(asyncParseTimes));
+	}
+
+	return Benchmark::GetExitCode();
+}
@@ -0,0 +1,73 @@
+//
+// Benchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+
+#include "Benchmark.h"
+#include <cstdio>
+#include <cstdlib>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	int iFailedCheckCount = 0;
+}
+
+double Benchmark::GetMilliseconds(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+bool Benchmark::Check(bool bPassed, const std::string& description)
+{
+	if (!bPassed)
+	{
+		printf("FAILED: %s\n", description.c_str());
+		iFailedCheckCount++;
+	}
+
+	return bPassed;
+}
+
+int Benchmark::GetExitCode()
+{
+	if (iFailedCheckCount > 0)
+	{
+		printf("%d check(s) failed\n", iFailedCheckCount);
+		return 1;
+	}
+
+	return 0;
+}
+
+int Benchmark::GetArgument(int argc, char* argv[], int iArgument, int iDefault)
+{
+	return (iArgument < argc) ? atoi(argv[iArgument]) : iDefault;
+}
+
+std::string Benchmark::GetArgument(int argc, char* argv[], int iArgument, const char* defaultValue)
+{
+	return (iArgument < argc) ? argv[iArgument] : defaultValue;
+}
+
+bool Benchmark::EvictFile(const std::string& filename)
+{
+#ifdef __linux__
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	// Dirty pages are not dropped, so anything just written is flushed first; pages still mapped by this process stay too
+	bool bEvicted = fdatasync(fd) == 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+	close(fd);
+	return bEvicted;
+#else
+	(void)filename;
+	return false;
+#endif
+}
@@ -0,0 +1,26 @@
+//
+// Benchmark.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+#include <string>
+
+// Shared by the headless benchmarks, which print their measurements and fail (for ctest) when one of their checks does
+class Benchmark
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	static double GetMilliseconds(Clock::time_point start); // Since start
+	static bool Check(bool bPassed, const std::string& description); // Failures are printed, and counted for the exit code
+	static int GetExitCode(); // For main to return: 1 once a check has failed
+	static int GetArgument(int argc, char* argv[], int iArgument, int iDefault);
+	static std::string GetArgument(int argc, char* argv[], int iArgument, const char* defaultValue);
+	static bool EvictFile(const std::string& filename); // Drops the file from the page cache, so the next read is from disk (false where unsupported)
+};
+
+#endif
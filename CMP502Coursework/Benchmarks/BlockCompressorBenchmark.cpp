@@ -0,0 +1,75 @@
+//
+// BlockCompressorBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Quality (PSNR) and throughput of BlockCompressor for each format and quality preset, on one thread
+// Checks that the error the encoder reports is the error of its blocks once decoded, and that the quality doesn't fall
+//
+// Usage: BlockCompressorBenchmark [resource directory] [texture] (cloud1.dds by default)
+//
+
+#include <cstdio>
+#include <string>
+#include "Benchmark.h"
+#include "TextureImage.h"
+
+int main(int argc, char* argv[])
+{
+	std::string resourceDirectory = Benchmark::GetArgument(argc, argv, 1, RESOURCE_DIRECTORY);
+	std::string filename = Benchmark::GetArgument(argc, argv, 2, "cloud1.dds");
+
+	TextureImage image;
+	if (!Benchmark::Check(image.LoadFromFile((resourceDirectory + "/" + filename).c_str()), filename + " loads"))
+	{
+		return Benchmark::GetExitCode();
+	}
+
+	int iWidth = image.GetWidth();
+	int iHeight = image.GetHeight();
+	long long llTexelCount = (long long)iWidth * iHeight;
+	std::vector<unsigned char> decoded(llTexelCount * 4);
+
+	// PSNR the presets have to reach on cloud1.dds, a little under what they measured when they were tuned
+	const bool bCloud = filename == "cloud1.dds";
+	const float minimumPSNRs[][3] = { { 37.0f, 37.5f, 38.0f }, { 37.0f, 37.5f, 38.0f }, { 43.5f, 49.5f, 50.0f } };
+
+	const char* formatNames[] = { "BC1", "BC3", "BC7" };
+	const TextureFormat formats[] = { BC1Format, BC3Format, BC7Format };
+	const char* qualityNames[] = { "low", "medium", "high" };
+	for (int iFormat = 0; iFormat < 3; iFormat++)
+	{
+		for (int iQuality = LowQuality; iQuality <= HighQuality; iQuality++)
+		{
+			std::vector<unsigned char> blocks;
+			double dSquaredError = 0.0;
+			auto start = Benchmark::Clock::now();
+			bool bCompressed = BlockCompressor::Compress(image.GetPixels(), iWidth, iHeight, formats[iFormat], (QualityLevel)iQuality, blocks, &dSquaredError, 1);
+			double dMilliseconds = Benchmark::GetMilliseconds(start);
+			std::string name = std::string(formatNames[iFormat]) + " " + qualityNames[iQuality];
+			if (!Benchmark::Check(bCompressed, name + " compresses"))
+			{
+				continue;
+			}
+
+			float fRMSE = BlockCompressor::GetRMSE(dSquaredError, llTexelCount);
+			float fPSNR = BlockCompressor::GetPSNR(fRMSE);
+			printf("%s, %s: RMSE %.3f, PSNR %.2f dB, %.2f MP/s\n", name.c_str(), filename.c_str(), fRMSE, fPSNR, llTexelCount / dMilliseconds / 1000.0);
+
+			// The encoder measures its error against the texels it expects the blocks to decode to
+			BlockCompressor::Decompress(blocks.data(), iWidth, iHeight, formats[iFormat], decoded.data(), 1);
+			double dDecodedError = 0.0;
+			for (long long i = 0; i < llTexelCount * 4; i++)
+			{
+				double dDifference = (double)decoded[i] - image.GetPixels()[i];
+				dDecodedError += dDifference * dDifference;
+			}
+			Benchmark::Check(dDecodedError == dSquaredError, name + " reported error matches the decoded blocks");
+			if (bCloud)
+			{
+				Benchmark::Check(fPSNR >= minimumPSNRs[iFormat][iQuality], name + " PSNR");
+			}
+		}
+	}
+
+	return Benchmark::GetExitCode();
+}
@@ -0,0 +1,134 @@
+//
+// BlockDecoderBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Decode throughput of BlockCompressor, measured as a full TextureImage load of each shipped texture
+// Checks that textures saved as BC1, BC3 and BC7 decode to exactly the error the encoder reported on every mip level, and that
+// random blocks of every format decode to what an independent reference decoder produced for the same blocks
+//
+// Usage: BlockDecoderBenchmark [resource directory] (Resources by default)
+//
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include "Benchmark.h"
+#include "MipGenerator.h"
+
+namespace
+{
+	double GetSquaredError(const TextureImage& a, const TextureImage& b, long long& llTexelCount)
+	{
+		double dSquaredError = 0.0;
+		llTexelCount = 0;
+		for (int iLevel = 0; iLevel < a.GetMipCount(); iLevel++)
+		{
+			long long llLevelTexelCount = (long long)a.GetMipWidth(iLevel) * a.GetMipHeight(iLevel);
+			for (long long i = 0; i < llLevelTexelCount * 4; i++)
+			{
+				double dDifference = (double)a.GetPixels(iLevel)[i] - b.GetPixels(iLevel)[i];
+				dSquaredError += dDifference * dDifference;
+			}
+			llTexelCount += llLevelTexelCount;
+		}
+
+		return dSquaredError;
+	}
+
+	// FNV-1a over the texels of every block, each block's bytes taken from a Mersenne Twister seeded with the format
+	unsigned int HashRandomBlocks(TextureFormat format, int iBlockCount)
+	{
+		std::mt19937 generator(format);
+		unsigned int uiHash = 2166136261u;
+		for (int i = 0; i < iBlockCount; i++)
+		{
+			unsigned char block[16];
+			for (auto& ucByte : block)
+			{
+				ucByte = (unsigned char)generator();
+			}
+
+			unsigned char texels[64];
+			BlockCompressor::DecodeBlock(block, format, texels);
+			for (unsigned char ucTexel : texels)
+			{
+				uiHash = (uiHash ^ ucTexel) * 16777619u;
+			}
+		}
+
+		return uiHash;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string resourceDirectory = Benchmark::GetArgument(argc, argv, 1, RESOURCE_DIRECTORY);
+
+	const char* formatNames[] = { "RGBA8", "BC1", "BC2", "BC3", "BC4", "BC5", "BC7" };
+	for (const char* filename : { "particle.dds", "cloud1.dds" })
+	{
+		TextureImage image;
+		if (!Benchmark::Check(image.LoadFromFile((resourceDirectory + "/" + filename).c_str()), std::string(filename) + " loads"))
+		{
+			continue;
+		}
+		MipGenerator::GenerateMipChain(image, BoxFilter, false);
+
+		for (TextureFormat format : { BC1Format, BC3Format, BC7Format })
+		{
+			std::string name = std::string(filename) + " as " + formatNames[format];
+			std::vector<unsigned char> file;
+			float fRMSE = 0.0f;
+			TextureImage decoded;
+			if (!Benchmark::Check(image.SaveToMemory(file, format, HighQuality, &fRMSE) && decoded.LoadFromMemory(file.data(), file.size()), name + " round trips"))
+			{
+				continue;
+			}
+
+			bool bSameShape = decoded.GetFormat() == format && decoded.GetMipCount() == image.GetMipCount();
+			float fDecodedRMSE = 0.0f;
+			if (bSameShape)
+			{
+				long long llTexelCount = 0;
+				double dSquaredError = GetSquaredError(image, decoded, llTexelCount);
+				fDecodedRMSE = BlockCompressor::GetRMSE(dSquaredError, llTexelCount);
+			}
+			printf("%s: encoder RMSE %.5f, decoded RMSE %.5f\n", name.c_str(), fRMSE, fDecodedRMSE);
+			Benchmark::Check(bSameShape, name + " keeps its format and mip levels");
+			Benchmark::Check(fDecodedRMSE == fRMSE, name + " decodes to the error the encoder reported");
+		}
+	}
+
+	for (const char* filename : { "stone.dds", "grass.dds", "hedge.dds", "cloud1.dds", "cloud2.dds", "particle.dds" })
+	{
+		TextureImage image;
+		auto start = Benchmark::Clock::now();
+		bool bLoaded = image.LoadFromFile((resourceDirectory + "/" + filename).c_str());
+		double dMilliseconds = Benchmark::GetMilliseconds(start);
+		if (!Benchmark::Check(bLoaded, std::string(filename) + " loads"))
+		{
+			continue;
+		}
+
+		long long llTexelCount = 0;
+		for (int iLevel = 0; iLevel < image.GetMipCount(); iLevel++)
+		{
+			llTexelCount += (long long)image.GetMipWidth(iLevel) * image.GetMipHeight(iLevel);
+		}
+		printf("%s (%s, %dx%d, %d mips): loaded in %.2f ms, %.1f MP/s\n", filename, formatNames[image.GetFormat()], image.GetWidth(), image.GetHeight(), image.GetMipCount(), dMilliseconds, llTexelCount / dMilliseconds / 1000.0);
+	}
+
+	// Hashes of the reference decoder's texels for the same blocks; BC7 gets more, to reach every mode and partition
+	const TextureFormat randomFormats[] = { BC1Format, BC2Format, BC3Format, BC4Format, BC5Format, BC7Format };
+	const int randomBlockCounts[] = { 3000, 3000, 3000, 3000, 3000, 20000 };
+	const unsigned int referenceHashes[] = { 0x5890f1b7u, 0x3bd48b9cu, 0x4cdf2ffau, 0x5f51fc7fu, 0x5bd65d63u, 0x034e267fu };
+	for (int i = 0; i < 6; i++)
+	{
+		unsigned int uiHash = HashRandomBlocks(randomFormats[i], randomBlockCounts[i]);
+		printf("%d random %s blocks: hash %08x\n", randomBlockCounts[i], formatNames[randomFormats[i]], uiHash);
+		Benchmark::Check(uiHash == referenceHashes[i], std::string("random ") + formatNames[randomFormats[i]] + " blocks match the reference decoder");
+	}
+
+	return Benchmark::GetExitCode();
+}
@@ -0,0 +1,175 @@
+//
+// DDSFileBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Time and heap allocations per file of DDSFile::Open (memory mapping) against reading the file into the heap and parsing it,
+// over every shipped texture
+// Checks that both give the same subresources, that every truncated copy of a file is rejected, and that corrupted headers
+// never give views past the end of the data
+//
+// Usage: DDSFileBenchmark [resource directory] [repeats] (Resources and 2000 repeats by default)
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include "Benchmark.h"
+#include "TextureImage.h"
+
+namespace
+{
+	size_t uAllocationCount = 0;
+	size_t uAllocatedBytes = 0;
+
+	bool ReadFile(const std::string& filename, std::vector<uint8_t>& data)
+	{
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		data.resize((size_t)file.tellg());
+		file.seekg(0);
+		return (bool)file.read((char*)data.data(), data.size());
+	}
+
+	bool HasSameSubresources(const DDSFile& a, const DDSFile& b)
+	{
+		if (a.GetSubresources().size() != b.GetSubresources().size())
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < a.GetSubresources().size(); i++)
+		{
+			const DDSSubresource& subresourceA = a.GetSubresources()[i];
+			const DDSSubresource& subresourceB = b.GetSubresources()[i];
+			if (subresourceA.width != subresourceB.width || subresourceA.height != subresourceB.height || subresourceA.slicePitch != subresourceB.slicePitch
+				|| memcmp(subresourceA.data, subresourceB.data, subresourceA.slicePitch * subresourceA.depth) != 0)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+// Counted, so the benchmark can report what each way of loading allocates
+void* operator new(size_t uSize)
+{
+	uAllocationCount++;
+	uAllocatedBytes += uSize;
+	if (void* pMemory = malloc(uSize ? uSize : 1))
+	{
+		return pMemory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* pMemory) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete(void* pMemory, size_t) noexcept
+{
+	free(pMemory);
+}
+
+int main(int argc, char* argv[])
+{
+	std::string resourceDirectory = Benchmark::GetArgument(argc, argv, 1, RESOURCE_DIRECTORY);
+	int iRepeatCount = (std::max)(Benchmark::GetArgument(argc, argv, 2, 2000), 1);
+
+	for (const char* filename : { "cloud1.dds", "cloud2.dds", "grass.dds", "hedge.dds", "particle.dds", "stone.dds" })
+	{
+		std::string path = resourceDirectory + "/" + filename;
+		DDSFile mapped;
+		DDSFile parsed;
+		std::vector<uint8_t> data;
+		if (!Benchmark::Check(SUCCEEDED(mapped.Open(path.c_str())) && ReadFile(path, data) && SUCCEEDED(parsed.Parse(data.data(), data.size())), std::string(filename) + " opens"))
+		{
+			continue;
+		}
+		Benchmark::Check(HasSameSubresources(mapped, parsed), std::string(filename) + " maps to the same subresources it parses to from the heap");
+
+		size_t uStartCount = uAllocationCount;
+		size_t uStartBytes = uAllocatedBytes;
+		auto start = Benchmark::Clock::now();
+		for (int i = 0; i < iRepeatCount; i++)
+		{
+			DDSFile file;
+			file.Open(path.c_str());
+		}
+		double dMappedMicroseconds = Benchmark::GetMilliseconds(start) * 1000.0 / iRepeatCount;
+		double dMappedAllocations = (double)(uAllocationCount - uStartCount) / iRepeatCount;
+		double dMappedBytes = (double)(uAllocatedBytes - uStartBytes) / iRepeatCount;
+
+		uStartCount = uAllocationCount;
+		uStartBytes = uAllocatedBytes;
+		start = Benchmark::Clock::now();
+		for (int i = 0; i < iRepeatCount; i++)
+		{
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			size_t uSize = (size_t)file.tellg();
+			file.seekg(0);
+			std::unique_ptr<uint8_t[]> buffer(new uint8_t[uSize]);
+			file.read((char*)buffer.get(), uSize);
+			DDSFile ddsFile;
+			ddsFile.Parse(buffer.get(), uSize);
+		}
+		double dReadMicroseconds = Benchmark::GetMilliseconds(start) * 1000.0 / iRepeatCount;
+		double dReadAllocations = (double)(uAllocationCount - uStartCount) / iRepeatCount;
+		double dReadBytes = (double)(uAllocatedBytes - uStartBytes) / iRepeatCount;
+
+		printf("%s: mapped %.1f us, %.1f allocations (%.0f B); read %.1f us, %.1f allocations (%.0f B)\n",
+			filename, dMappedMicroseconds, dMappedAllocations, dMappedBytes, dReadMicroseconds, dReadAllocations, dReadBytes);
+	}
+
+	// A file with a full mip chain, so that every level's size is validated
+	TextureImage image;
+	image.SetSize(64, 32);
+	image.SetMipCount(7);
+	std::vector<uint8_t> file;
+	if (Benchmark::Check(image.SaveToMemory(file, BC7Format, LowQuality), "a BC7 file saves"))
+	{
+		int iAcceptedCount = 0;
+		for (size_t uSize = 0; uSize < file.size(); uSize++)
+		{
+			DDSFile truncated;
+			iAcceptedCount += SUCCEEDED(truncated.Parse(file.data(), uSize)) ? 1 : 0;
+		}
+		Benchmark::Check(iAcceptedCount == 0, "every truncated copy is rejected");
+
+		std::mt19937 generator(1);
+		int iOutOfBoundsCount = 0;
+		for (int i = 0; i < 100000; i++)
+		{
+			std::vector<uint8_t> corrupted = file;
+			for (int j = 0; j < 4; j++)
+			{
+				corrupted[generator() % 148] = (uint8_t)generator(); // The magic number, DDS_HEADER and DDS_HEADER_DXT10
+			}
+
+			DDSFile ddsFile;
+			if (SUCCEEDED(ddsFile.Parse(corrupted.data(), corrupted.size())))
+			{
+				for (const DDSSubresource& subresource : ddsFile.GetSubresources())
+				{
+					iOutOfBoundsCount += (subresource.data + subresource.slicePitch * subresource.depth > corrupted.data() + corrupted.size()) ? 1 : 0;
+				}
+			}
+		}
+		Benchmark::Check(iOutOfBoundsCount == 0, "corrupted headers never give views past the end of the data");
+	}
+
+	return Benchmark::GetExitCode();
+}
@@ -0,0 +1,100 @@
+//
+// FluidBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Steps per second of FluidSimulation on a block of water dropped into the fountain's bounds, on one thread and on every core (at least four)
+// Checks that the particles stay finite and inside the bounds, and that splitting the passes across threads gives the same result
+//
+// Usage: FluidBenchmark [steps] [particle count]... (60 steps of 10000, 50000 and 200000 particles by default)
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Benchmark.h"
+#include "FluidSimulation.h"
+
+namespace
+{
+	const float TimeStep = 1.0f / 240.0f; // One simulation step per update
+	const float ParticleSpacing = 0.05f; // Half the smoothing radius
+
+	void EmitBlock(FluidSimulation& simulation, int iCount)
+	{
+		// A cube of particles at rest, sized so they are spaced as the simulation's mass assumes, just above the floor of the default bounds
+		// (larger counts packed into a fixed cube would mostly time the neighbors of an overcompressed block)
+		float fSide = ParticleSpacing * cbrtf((float)iCount);
+		std::mt19937 generator(7);
+		std::uniform_real_distribution<float> distribution(-0.5f * fSide, 0.5f * fSide);
+		for (int i = 0; i < iCount; i++)
+		{
+			XMFLOAT3 position(distribution(generator), distribution(generator) + 0.5f * fSide - 2.95f, distribution(generator));
+			simulation.EmitParticle(position, XMFLOAT3(0.0f, 0.0f, 0.0f));
+		}
+	}
+
+	// Steps a second of a fresh simulation of the block
+	double RunSimulation(FluidSimulation& simulation, int iParticleCount, int iThreadCount, int iStepCount)
+	{
+		simulation.Initialize(iParticleCount, iThreadCount);
+		EmitBlock(simulation, iParticleCount);
+
+		auto start = Benchmark::Clock::now();
+		for (int i = 0; i < iStepCount; i++)
+		{
+			simulation.Update(TimeStep);
+		}
+		return iStepCount / (Benchmark::GetMilliseconds(start) / 1000.0);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int iStepCount = Benchmark::GetArgument(argc, argv, 1, 60);
+	std::vector<int> particleCounts;
+	for (int i = 2; i < argc; i++)
+	{
+		particleCounts.push_back(atoi(argv[i]));
+	}
+	if (particleCounts.empty())
+	{
+		particleCounts = { 10000, 50000, 200000 };
+	}
+	int iThreadCount = (std::max)((int)std::thread::hardware_concurrency(), 4);
+
+	for (int iParticleCount : particleCounts)
+	{
+		FluidSimulation simulation;
+		double dStepsPerSecond = RunSimulation(simulation, iParticleCount, 1, iStepCount);
+
+		// Against the simulation's default bounds
+		const XMFLOAT4* positions = simulation.GetPositions();
+		double dHeight = 0.0;
+		double dDensity = 0.0;
+		bool bInside = true;
+		for (int i = 0; i < simulation.GetParticleCount(); i++)
+		{
+			const XMFLOAT4& position = positions[i];
+			bInside &= std::isfinite(position.w) && position.x >= -2.5f && position.x <= 2.5f && position.y >= -3.0f && position.y <= 1.0f && position.z >= -2.5f && position.z <= 2.5f;
+			dHeight += position.y;
+			dDensity += position.w;
+		}
+		printf("%d particles: %.1f steps a second on one thread, mean height %.4f, mean density %.1f\n", iParticleCount, dStepsPerSecond, dHeight / iParticleCount, dDensity / iParticleCount);
+		Benchmark::Check(simulation.GetParticleCount() == iParticleCount, "every particle is still alive");
+		Benchmark::Check(bInside, "every particle is finite and inside the bounds");
+
+		// Each particle is computed on its own, so the split can't change the result
+		FluidSimulation threadedSimulation;
+		double dThreadedStepsPerSecond = RunSimulation(threadedSimulation, iParticleCount, iThreadCount, iStepCount);
+		printf("  %.1f steps a second on %d threads (%.2fx)\n", dThreadedStepsPerSecond, iThreadCount, dThreadedStepsPerSecond / dStepsPerSecond);
+		Benchmark::Check(threadedSimulation.GetParticleCount() == iParticleCount &&
+			memcmp(threadedSimulation.GetPositions(), positions, sizeof(XMFLOAT4) * iParticleCount) == 0, std::to_string(iThreadCount) + " threads match one");
+	}
+
+	return Benchmark::GetExitCode();
+}
@@ -0,0 +1,282 @@
+//
+// GltfBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Time and heap allocated to load a model from .glb with GltfFile against mapping and parsing its text file and copying it into
+// buffer layout; the .glb files are written from the text models (welded), once interleaved as ModelData with 32-bit indices, and
+// once with separate attributes and 16-bit indices, as Blender exports them
+// Checks that the interleaved file is read in place, that both read back to the welded mesh, the node matrices (mirrored to
+// left-handed) and the material's texture, and that truncated and byte-flipped files are rejected or give views inside the data
+//
+// Usage: GltfBenchmark [resource directory] [corrupted copies] (Resources and 20000 by default)
+//
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include "Benchmark.h"
+#include "GltfFile.h"
+#include "MeshOptimizer.h"
+
+namespace
+{
+	size_t uAllocatedBytes = 0;
+
+	const int NodeCount = 2; // The first is turned 90 degrees about y, the second is moved 2 along x
+	const float NodeRotation[4] = { 0.0f, 0.70710678f, 0.0f, 0.70710678f };
+
+	void Append(std::string& bytes, const void* data, size_t size)
+	{
+		bytes.append((const char*)data, size);
+	}
+
+	// The welded mesh as a .glb file, with a material whose base color image is textures/Stone.png
+	std::string WriteGlb(const std::vector<ModelData>& vertices, const std::vector<unsigned int>& indices, bool bInterleaved)
+	{
+		std::string binary;
+		std::string bufferViews;
+		std::string accessors;
+		int iVertexCount = (int)vertices.size();
+		if (bInterleaved)
+		{
+			Append(binary, vertices.data(), vertices.size() * sizeof(ModelData));
+			bufferViews = "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" + std::to_string(binary.size()) + ",\"byteStride\":32}";
+			for (int iOffset : { 0, 12, 20 })
+			{
+				accessors += std::string(accessors.empty() ? "" : ",") + "{\"bufferView\":0,\"byteOffset\":" + std::to_string(iOffset) + ",\"componentType\":5126,\"count\":"
+					+ std::to_string(iVertexCount) + ",\"type\":\"" + ((iOffset == 12) ? "VEC2" : "VEC3") + "\"}";
+			}
+		}
+		else
+		{
+			const int componentCounts[] = { 3, 2, 3 };
+			const int componentOffsets[] = { 0, 3, 5 };
+			for (int iAttribute = 0; iAttribute < 3; iAttribute++)
+			{
+				size_t offset = binary.size();
+				for (const ModelData& vertex : vertices)
+				{
+					Append(binary, &vertex.x + componentOffsets[iAttribute], componentCounts[iAttribute] * sizeof(float));
+				}
+				bufferViews += std::string(iAttribute ? "," : "") + "{\"buffer\":0,\"byteOffset\":" + std::to_string(offset) + ",\"byteLength\":" + std::to_string(binary.size() - offset) + "}";
+				accessors += std::string(iAttribute ? "," : "") + "{\"bufferView\":" + std::to_string(iAttribute) + ",\"componentType\":5126,\"count\":" + std::to_string(iVertexCount)
+					+ ",\"type\":\"" + ((iAttribute == 1) ? "VEC2" : "VEC3") + "\"}";
+			}
+		}
+
+		bool bShortIndices = !bInterleaved && iVertexCount <= 65536;
+		size_t indexOffset = binary.size();
+		for (unsigned int uiIndex : indices)
+		{
+			unsigned short usIndex = (unsigned short)uiIndex;
+			Append(binary, bShortIndices ? (const void*)&usIndex : (const void*)&uiIndex, bShortIndices ? sizeof(usIndex) : sizeof(uiIndex));
+		}
+		binary.resize((binary.size() + 3) & ~3, '\0');
+		bufferViews += ",{\"buffer\":0,\"byteOffset\":" + std::to_string(indexOffset) + ",\"byteLength\":" + std::to_string(indices.size() * (bShortIndices ? 2 : 4)) + "}";
+		accessors += ",{\"bufferView\":" + std::to_string(bInterleaved ? 1 : 3) + ",\"componentType\":" + (bShortIndices ? "5123" : "5125") + ",\"count\":" + std::to_string(indices.size()) + ",\"type\":\"SCALAR\"}";
+
+		std::string json = "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0,1]}],\"nodes\":["
+			"{\"mesh\":0,\"rotation\":[0,0.70710678,0,0.70710678]},{\"mesh\":0,\"translation\":[2,0,0]}],"
+			"\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"TEXCOORD_0\":1,\"NORMAL\":2},\"indices\":3,\"material\":0}]}],"
+			"\"materials\":[{\"name\":\"Stone\",\"pbrMetallicRoughness\":{\"baseColorTexture\":{\"index\":0}}}],\"textures\":[{\"source\":0}],\"images\":[{\"uri\":\"textures/Stone.png\"}],"
+			"\"buffers\":[{\"byteLength\":" + std::to_string(binary.size()) + "}],\"bufferViews\":[" + bufferViews + "],\"accessors\":[" + accessors + "]}";
+		json.resize((json.size() + 3) & ~3, ' ');
+
+		const unsigned int header[] = { 0x46546C67, 2, (unsigned int)(12 + 8 + json.size() + 8 + binary.size()), (unsigned int)json.size(), 0x4E4F534A };
+		const unsigned int binaryHeader[] = { (unsigned int)binary.size(), 0x004E4942 };
+		std::string file;
+		Append(file, header, sizeof(header));
+		file += json;
+		Append(file, binaryHeader, sizeof(binaryHeader));
+		return file + binary;
+	}
+
+	bool IsInside(const GltfAccessor& accessor, const unsigned char* data, size_t size)
+	{
+		static const int componentSizes[] = { 1, 1, 2, 2, 4, 4, 4 }; // 5120 to 5126
+		int iComponentSize = (accessor.iComponentType >= 5120 && accessor.iComponentType <= 5126) ? componentSizes[accessor.iComponentType - 5120] : 4;
+		return !accessor.data || accessor.iCount == 0
+			|| (accessor.data >= data && accessor.data + (size_t)(accessor.iCount - 1) * accessor.iStride + (size_t)accessor.iComponentCount * iComponentSize <= data + size);
+	}
+}
+
+// Counted, so the benchmark can report what each way of loading allocates
+void* operator new(size_t uSize)
+{
+	uAllocatedBytes += uSize;
+	if (void* pMemory = malloc(uSize ? uSize : 1))
+	{
+		return pMemory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* pMemory) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete(void* pMemory, size_t) noexcept
+{
+	free(pMemory);
+}
+
+int main(int argc, char* argv[])
+{
+	std::string resourceDirectory = Benchmark::GetArgument(argc, argv, 1, RESOURCE_DIRECTORY);
+	int iCorruptedCount = Benchmark::GetArgument(argc, argv, 2, 20000);
+
+	for (const char* modelName : { "balustrade", "statue" })
+	{
+		std::string textFilename = resourceDirectory + "/" + modelName + ".txt";
+
+		// The text path as LoadModel took it: map, parse, and copy into the vertex and index buffer layout
+		size_t uStartBytes = uAllocatedBytes;
+		auto start = Benchmark::Clock::now();
+		std::vector<ModelData> textVertices;
+		{
+			MappedFile file;
+			if (!Benchmark::Check(file.Open(textFilename.c_str()) && MeshFile::ParseText(file.GetData(), file.GetSize(), textVertices), std::string(modelName) + ".txt parses"))
+			{
+				continue;
+			}
+			std::vector<ModelData> bufferVertices(textVertices);
+			std::vector<unsigned int> bufferIndices(textVertices.size());
+			for (size_t i = 0; i < bufferIndices.size(); i++)
+			{
+				bufferIndices[i] = (unsigned int)i;
+			}
+		}
+		double dTextMilliseconds = Benchmark::GetMilliseconds(start);
+		printf("%s.txt: %.2f ms, %.0f KB allocated\n", modelName, dTextMilliseconds, (uAllocatedBytes - uStartBytes) / 1024.0);
+
+		// glTF is right-handed
+		for (ModelData& vertex : textVertices)
+		{
+			vertex.z = -vertex.z;
+			vertex.nz = -vertex.nz;
+		}
+		std::vector<ModelData> vertices;
+		std::vector<unsigned int> indices;
+		MeshOptimizer::Weld(textVertices.data(), (int)textVertices.size(), vertices, indices);
+
+		for (bool bInterleaved : { true, false })
+		{
+			std::string name = std::string(modelName) + (bInterleaved ? "_interleaved.glb" : "_separate.glb");
+			std::string glb = WriteGlb(vertices, indices, bInterleaved);
+			std::ofstream(name, std::ios::binary | std::ios::trunc).write(glb.data(), glb.size());
+
+			uStartBytes = uAllocatedBytes;
+			start = Benchmark::Clock::now();
+			GltfFile file;
+			bool bOpened = file.Open(name.c_str());
+			std::vector<ModelData> copiedVertices;
+			std::vector<unsigned int> copiedIndices;
+			const ModelData* vertexData = bOpened ? file.GetVertexData(0) : nullptr;
+			const unsigned int* indexData = bOpened ? file.GetIndexData(0) : nullptr;
+			if (bOpened && !vertexData)
+			{
+				file.ReadVertices(0, copiedVertices);
+				vertexData = copiedVertices.data();
+			}
+			if (bOpened && !indexData)
+			{
+				file.ReadIndices(0, copiedIndices);
+				indexData = copiedIndices.data();
+			}
+			double dMilliseconds = Benchmark::GetMilliseconds(start);
+			if (!Benchmark::Check(bOpened && file.GetMeshes().size() == 1, name + " opens: " + file.GetError()))
+			{
+				continue;
+			}
+			printf("%s: %.2f ms, %.0f KB allocated, vertices %s, indices %s\n", name.c_str(), dMilliseconds, (uAllocatedBytes - uStartBytes) / 1024.0,
+				copiedVertices.empty() ? "in place" : "interleaved", copiedIndices.empty() ? "in place" : "widened");
+
+			const GltfMesh& mesh = file.GetMeshes()[0];
+			Benchmark::Check(!bInterleaved || (copiedVertices.empty() && copiedIndices.empty()), name + " is read in place");
+			Benchmark::Check(mesh.iVertexCount == (int)vertices.size() && mesh.iIndexCount == (int)indices.size()
+				&& memcmp(vertexData, vertices.data(), vertices.size() * sizeof(ModelData)) == 0 && memcmp(indexData, indices.data(), indices.size() * sizeof(unsigned int)) == 0,
+				name + " reads back to the welded mesh");
+
+			// Each node's world matrix, then the mirror to left-handed
+			XMMATRIX mirrorMatrix = XMMatrixScaling(1.0f, 1.0f, -1.0f);
+			XMMATRIX expectedMatrices[NodeCount] = { XMMatrixRotationQuaternion(XMVectorSet(NodeRotation[0], NodeRotation[1], NodeRotation[2], NodeRotation[3])) * mirrorMatrix, XMMatrixTranslation(2.0f, 0.0f, 0.0f) * mirrorMatrix };
+			bool bSameMatrices = mesh.nodeMatrices.size() == NodeCount;
+			for (int iNode = 0; bSameMatrices && iNode < NodeCount; iNode++)
+			{
+				XMFLOAT4X4 expected;
+				XMStoreFloat4x4(&expected, expectedMatrices[iNode]);
+				for (int i = 0; i < 16; i++)
+				{
+					bSameMatrices &= fabsf((&mesh.nodeMatrices[iNode]._11)[i] - (&expected._11)[i]) < 1e-6f;
+				}
+			}
+			Benchmark::Check(bSameMatrices, name + " has both node matrices, mirrored to left-handed");
+			Benchmark::Check(file.GetMaterials().size() == 1 && file.GetMaterials()[0].baseColorTexture == "textures/Stone.png", name + " names its base color image");
+			file.Close();
+			remove(name.c_str());
+		}
+	}
+
+	// Small enough to copy for every case
+	std::vector<ModelData> quad = { { -1, 0, -1, 0, 1, 0, 1, 0 }, { -1, 0, 1, 0, 0, 0, 1, 0 }, { 1, 0, 1, 1, 0, 0, 1, 0 }, { 1, 0, -1, 1, 1, 0, 1, 0 } };
+	std::vector<unsigned int> quadIndices = { 0, 1, 2, 0, 2, 3 };
+	int iOutsideCount = 0;
+	int iAcceptedCount = 0;
+	for (bool bInterleaved : { true, false })
+	{
+		std::string glb = WriteGlb(quad, quadIndices, bInterleaved);
+		std::mt19937 generator(bInterleaved ? 1 : 2);
+		for (int i = 0; i < iCorruptedCount / 2; i++)
+		{
+			std::vector<unsigned char> corrupted(glb.begin(), glb.end());
+			if (i % 4 == 0)
+			{
+				corrupted.resize(generator() % corrupted.size());
+			}
+			else
+			{
+				int iByteCount = 1 + generator() % 4;
+				for (int j = 0; j < iByteCount; j++)
+				{
+					corrupted[generator() % corrupted.size()] = (unsigned char)generator();
+				}
+			}
+
+			GltfFile file;
+			if (!file.Parse(corrupted.data(), corrupted.size()))
+			{
+				continue;
+			}
+
+			iAcceptedCount++;
+			for (const GltfMesh& mesh : file.GetMeshes())
+			{
+				for (const GltfPrimitive& primitive : mesh.primitives)
+				{
+					for (const GltfAccessor* pAccessor : { &primitive.positions, &primitive.texcoords, &primitive.normals, &primitive.indices })
+					{
+						iOutsideCount += IsInside(*pAccessor, corrupted.data(), corrupted.size()) ? 0 : 1;
+					}
+				}
+			}
+			for (int iMesh = 0; iMesh < (int)file.GetMeshes().size(); iMesh++)
+			{
+				std::vector<ModelData> corruptedVertices;
+				std::vector<unsigned int> corruptedIndices;
+				file.ReadVertices(iMesh, corruptedVertices);
+				file.ReadIndices(iMesh, corruptedIndices);
+			}
+		}
+	}
+	printf("%d truncated or byte-flipped files: %d still parsed\n", iCorruptedCount, iAcceptedCount);
+	Benchmark::Check(iOutsideCount == 0, "corrupted files never give views outside the data");
+
+	return Benchmark::GetExitCode();
+}
@@ -0,0 +1,215 @@
+//
+// ImpostorBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Time to bake the lavender and lupine impostor atlases, the alpha-tested coverage of each mip level, and the size and error of the
+// atlas as BC3 and as BC7; then, for a field of each plant seen from the scene's start camera at 1080p, the instances drawn as meshes
+// and as impostors, the triangles that saves, and the time to split them
+// Checks the atlas layout, that coverage holds within 10% down the mips, that BC3 keeps the atlas closer than BC7, and that every
+// instance in view is drawn as one or the other
+//
+// Usage: ImpostorBenchmark [resource directory] [field side] [compare formats] (Resources, 100 and 1 by default)
+// The textures of the plants aren't shipped, so the atlases are baked untextured
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "Benchmark.h"
+#include "Camera.h"
+#include "ImpostorBaker.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+
+namespace
+{
+	const float FieldSpacing = 0.65f;
+	const float ViewportHeight = 1080.0f;
+	const float FadeLength = 0.25f; // Impostor's, as a fraction of the distance the fade starts at
+	const int SplitRepeatCount = 50;
+
+	// Texels at or above the alpha test's threshold, over the albedo half of the atlas
+	double GetCoverage(const TextureImage& atlas, int iLevel)
+	{
+		int iWidth = atlas.GetMipWidth(iLevel);
+		int iHeight = atlas.GetMipHeight(iLevel);
+		const unsigned char* pixels = atlas.GetPixels(iLevel);
+		long long llCovered = 0;
+		for (int y = 0; y < iHeight; y++)
+		{
+			for (int x = 0; x < iWidth / 2; x++)
+			{
+				llCovered += (pixels[(y * iWidth + x) * 4 + 3] >= 128) ? 1 : 0;
+			}
+		}
+
+		return (double)llCovered / ((iWidth / 2) * iHeight);
+	}
+
+	// Impostor::Update's split, over instance rows: culled by the frustum, then meshes nearer than the fade's end and impostors beyond its start
+	void SplitInstances(const std::vector<XMFLOAT4X4>& instances, const XMFLOAT4& boundingSphere, float fInstanceRadius, Camera& camera,
+		std::vector<int>& modelInstances, std::vector<int>& impostorInstances, int& iInViewCount, float& fFadeStart, float& fFadeEnd)
+	{
+		XMFLOAT4X4 projection;
+		XMStoreFloat4x4(&projection, camera.GetProjectionMatrix());
+		float fNearZ = -projection._43 / projection._33;
+		float fFarZ = projection._43 / (1.0f - projection._33);
+		float fHorizontalLength = sqrtf(projection._11 * projection._11 + 1.0f);
+		float fVerticalLength = sqrtf(projection._22 * projection._22 + 1.0f);
+
+		float fPixelsPerUnit = projection._22 * ViewportHeight * 0.5f;
+		fFadeStart = fPixelsPerUnit * 2.0f * fInstanceRadius / ImpostorBaker::FrameSize;
+		fFadeEnd = fFadeStart * (1.0f + FadeLength);
+
+		XMMATRIX viewMatrix = camera.GetViewMatrix();
+		XMFLOAT3 cameraPosition = camera.GetPosition();
+		XMVECTOR vCameraPosition = XMLoadFloat3(&cameraPosition);
+		XMVECTOR vModelCenter = XMVectorSet(boundingSphere.x, boundingSphere.y, boundingSphere.z, 1.0f);
+		modelInstances.clear();
+		impostorInstances.clear();
+		iInViewCount = 0;
+		for (int i = 0; i < (int)instances.size(); i++)
+		{
+			XMMATRIX rows = XMLoadFloat4x4(&instances[i]);
+			XMVECTOR vCenter = XMVectorSet(XMVectorGetX(XMVector4Dot(rows.r[0], vModelCenter)), XMVectorGetX(XMVector4Dot(rows.r[1], vModelCenter)),
+				XMVectorGetX(XMVector4Dot(rows.r[2], vModelCenter)), 1.0f);
+
+			XMFLOAT3 center;
+			XMStoreFloat3(&center, XMVector3TransformCoord(vCenter, viewMatrix));
+			if (center.z + fInstanceRadius < fNearZ || center.z - fInstanceRadius > fFarZ ||
+				(fabsf(center.x) * projection._11 - center.z) / fHorizontalLength > fInstanceRadius ||
+				(fabsf(center.y) * projection._22 - center.z) / fVerticalLength > fInstanceRadius)
+			{
+				continue;
+			}
+
+			iInViewCount++;
+			float fDistance = XMVectorGetX(XMVector3Length(vCenter - vCameraPosition));
+			if (fDistance < fFadeEnd)
+			{
+				modelInstances.push_back(i);
+			}
+			if (fDistance > fFadeStart)
+			{
+				impostorInstances.push_back(i);
+			}
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string resourceDirectory = Benchmark::GetArgument(argc, argv, 1, RESOURCE_DIRECTORY);
+	int iFieldSide = (std::max)(Benchmark::GetArgument(argc, argv, 2, 100), 1);
+	bool bCompareFormats = Benchmark::GetArgument(argc, argv, 3, 1) != 0;
+
+	// At the largest axis of the scale the scene gives each
+	struct Plant
+	{
+		const char* filename;
+		float fScale;
+	};
+	const Plant plants[] = { { "lavender.txt", 0.006f }, { "lupine.txt", 0.017f } };
+	for (const Plant& plant : plants)
+	{
+		MappedFile file;
+		std::vector<ModelData> textVertices;
+		std::vector<ModelData> vertices;
+		std::vector<unsigned int> indices;
+		bool bLoaded = file.Open((resourceDirectory + "/" + plant.filename).c_str()) && MeshFile::ParseText(file.GetData(), file.GetSize(), textVertices);
+		if (!Benchmark::Check(bLoaded, std::string(plant.filename) + " loads"))
+		{
+			continue;
+		}
+		MeshOptimizer::Weld(textVertices.data(), (int)textVertices.size(), vertices, indices);
+		int iTriangleCount = (int)indices.size() / 3;
+
+		TextureImage atlas;
+		auto start = Benchmark::Clock::now();
+		bool bBaked = ImpostorBaker::Bake(vertices.data(), (int)vertices.size(), indices.data(), (int)indices.size(), nullptr, false, atlas, 1);
+		double dSingleThreadTime = Benchmark::GetMilliseconds(start);
+		start = Benchmark::Clock::now();
+		bBaked &= ImpostorBaker::Bake(vertices.data(), (int)vertices.size(), indices.data(), (int)indices.size(), nullptr, false, atlas);
+		double dParallelTime = Benchmark::GetMilliseconds(start);
+		printf("%s (%d triangles): baked in %.0f ms on one thread, %.0f ms on every core\n", plant.filename, iTriangleCount, dSingleThreadTime, dParallelTime);
+		int iAtlasSize = ImpostorBaker::FrameCount * ImpostorBaker::FrameSize;
+		if (!Benchmark::Check(bBaked && atlas.GetWidth() == 2 * iAtlasSize && atlas.GetHeight() == iAtlasSize && atlas.GetMipCount() == ImpostorBaker::MipCount,
+			std::string(plant.filename) + " bakes an atlas of albedo and normal frames with every mip"))
+		{
+			continue;
+		}
+
+		double dTopCoverage = GetCoverage(atlas, 0);
+		bool bCoverageHolds = dTopCoverage > 0.0;
+		printf("  Coverage:");
+		for (int iLevel = 0; iLevel < atlas.GetMipCount(); iLevel++)
+		{
+			double dCoverage = GetCoverage(atlas, iLevel);
+			bCoverageHolds &= fabs(dCoverage - dTopCoverage) <= 0.1 * dTopCoverage;
+			printf(" %.3f at %dx%d", dCoverage, atlas.GetMipWidth(iLevel), atlas.GetMipHeight(iLevel));
+		}
+		printf("\n");
+		Benchmark::Check(bCoverageHolds, std::string(plant.filename) + " keeps its alpha-tested coverage down the mips");
+
+		if (bCompareFormats)
+		{
+			float fBC3Error = 0.0f;
+			float fBC7Error = 0.0f;
+			std::vector<unsigned char> bc3Output;
+			std::vector<unsigned char> bc7Output;
+			start = Benchmark::Clock::now();
+			bool bSaved = atlas.SaveToMemory(bc3Output, BC3Format, HighQuality, &fBC3Error);
+			double dBC3Time = Benchmark::GetMilliseconds(start);
+			start = Benchmark::Clock::now();
+			bSaved &= atlas.SaveToMemory(bc7Output, BC7Format, HighQuality, &fBC7Error);
+			double dBC7Time = Benchmark::GetMilliseconds(start);
+			printf("  BC3: %.1f MB, RMSE %.2f, %.1f s; BC7: %.1f MB, RMSE %.2f, %.1f s\n", bc3Output.size() / 1048576.0, fBC3Error, dBC3Time / 1000.0,
+				bc7Output.size() / 1048576.0, fBC7Error, dBC7Time / 1000.0);
+			// Both are a byte per texel, so only the headers differ in size
+			Benchmark::Check(bSaved && fBC3Error < fBC7Error, std::string(plant.filename) + " is closer as BC3 than as BC7");
+		}
+
+		// A square field in front of the camera, on the ground as the scene places plants
+		std::vector<XMFLOAT4X4> instances;
+		XMMATRIX scalingMatrix = XMMatrixScaling(plant.fScale, plant.fScale, plant.fScale);
+		for (int z = 0; z < iFieldSide; z++)
+		{
+			for (int x = 0; x < iFieldSide; x++)
+			{
+				XMFLOAT4X4 rows;
+				XMStoreFloat4x4(&rows, XMMatrixTranspose(scalingMatrix * XMMatrixTranslation((x - iFieldSide / 2) * FieldSpacing, -1.5f, z * FieldSpacing - 10.0f)));
+				instances.push_back(rows);
+			}
+		}
+		XMFLOAT4 boundingSphere = ImpostorBaker::ComputeBoundingSphere(vertices.data(), (int)vertices.size());
+		Camera camera(XMFLOAT3(0.0f, 8.0f, -22.0f), 16.0f / 9.0f); // GraphicsEngine's start
+		camera.Update();
+
+		std::vector<int> modelInstances;
+		std::vector<int> impostorInstances;
+		int iInViewCount = 0;
+		float fFadeStart = 0.0f;
+		float fFadeEnd = 0.0f;
+		start = Benchmark::Clock::now();
+		for (int i = 0; i < SplitRepeatCount; i++)
+		{
+			SplitInstances(instances, boundingSphere, boundingSphere.w * plant.fScale, camera, modelInstances, impostorInstances, iInViewCount, fFadeStart, fFadeEnd);
+		}
+		double dSplitTime = Benchmark::GetMilliseconds(start) / SplitRepeatCount;
+
+		long long llMeshTriangles = (long long)iInViewCount * iTriangleCount;
+		long long llSplitTriangles = (long long)modelInstances.size() * iTriangleCount + 2LL * impostorInstances.size();
+		printf("  Field of %d: %d in view, %d meshes and %d impostors (fading over %.1f-%.1f m); %lld triangles against %lld as meshes (%.1fx fewer); split in %.2f ms\n",
+			(int)instances.size(), iInViewCount, (int)modelInstances.size(), (int)impostorInstances.size(), fFadeStart, fFadeEnd, llSplitTriangles, llMeshTriangles,
+			(double)llMeshTriangles / (std::max)(llSplitTriangles, 1LL), dSplitTime);
+
+		std::vector<int> drawnInstances;
+		std::set_union(modelInstances.begin(), modelInstances.end(), impostorInstances.begin(), impostorInstances.end(), std::back_inserter(drawnInstances));
+		Benchmark::Check((int)drawnInstances.size() == iInViewCount, std::string(plant.filename) + " draws every instance in view as a mesh, an impostor or both");
+	}
+
+	return Benchmark::GetExitCode();
+}
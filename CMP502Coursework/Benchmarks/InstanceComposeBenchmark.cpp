@@ -0,0 +1,126 @@
+//
+// InstanceComposeBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Time for InstancePacker::ComposeMatrices to build the instance rows of animated instances from positions, quaternions and scales,
+// against its scalar loop run over every instance and against XMMatrix S * R * T, both for a frame's worth of instances and for a
+// batch small enough to stay in the cache
+// Checks that the result matches the scalar loop bit for bit and XMMatrix to rounding, at counts that leave every tail length
+//
+// Usage: InstanceComposeBenchmark [instances] [repeats] (100000 and 20 by default)
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "Benchmark.h"
+#include "InstancePacker.h"
+
+namespace
+{
+	const int CachedCount = 1000;
+
+	typedef void (*ComposeFunction)(const XMFLOAT3* positions, const XMFLOAT4* rotations, const XMFLOAT3* scales, int iCount, InstanceData* instances);
+
+	// The scalar loop ComposeMatrices finishes with, for every instance
+	void ComposeScalar(const XMFLOAT3* positions, const XMFLOAT4* rotations, const XMFLOAT3* scales, int iCount, InstanceData* instances)
+	{
+		for (int i = 0; i < iCount; i++)
+		{
+			const XMFLOAT4& q = rotations[i];
+			const XMFLOAT3& s = scales[i];
+			const XMFLOAT3& t = positions[i];
+			float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+			float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+			float xw = q.x * q.w, yw = q.y * q.w, zw = q.z * q.w;
+			instances[i].worldMatrix[0] = XMFLOAT4(s.x * (1.0f - 2.0f * (yy + zz)), s.y * 2.0f * (xy - zw), s.z * 2.0f * (xz + yw), t.x);
+			instances[i].worldMatrix[1] = XMFLOAT4(s.x * 2.0f * (xy + zw), s.y * (1.0f - 2.0f * (xx + zz)), s.z * 2.0f * (yz - xw), t.y);
+			instances[i].worldMatrix[2] = XMFLOAT4(s.x * 2.0f * (xz - yw), s.y * 2.0f * (yz + xw), s.z * (1.0f - 2.0f * (xx + yy)), t.z);
+		}
+	}
+
+	// The obvious way: a full matrix product per instance, transposed into the instance rows
+	void ComposeWithMatrices(const XMFLOAT3* positions, const XMFLOAT4* rotations, const XMFLOAT3* scales, int iCount, InstanceData* instances)
+	{
+		for (int i = 0; i < iCount; i++)
+		{
+			XMMATRIX worldMatrix = XMMatrixTranspose(XMMatrixScaling(scales[i].x, scales[i].y, scales[i].z) * XMMatrixRotationQuaternion(XMLoadFloat4(&rotations[i]))
+				* XMMatrixTranslation(positions[i].x, positions[i].y, positions[i].z));
+			for (int j = 0; j < 3; j++)
+			{
+				XMStoreFloat4(&instances[i].worldMatrix[j], worldMatrix.r[j]);
+			}
+		}
+	}
+
+	// Best of the repeats, in nanoseconds per instance
+	double Time(ComposeFunction compose, const XMFLOAT3* positions, const XMFLOAT4* rotations, const XMFLOAT3* scales, int iCount, InstanceData* instances, int iRepeatCount)
+	{
+		double dBest = 1e30;
+		for (int iRepeat = 0; iRepeat < iRepeatCount; iRepeat++)
+		{
+			auto start = Benchmark::Clock::now();
+			compose(positions, rotations, scales, iCount, instances);
+			dBest = (std::min)(dBest, Benchmark::GetMilliseconds(start));
+		}
+
+		return dBest * 1e6 / iCount;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int iInstanceCount = (std::max)(Benchmark::GetArgument(argc, argv, 1, 100000), CachedCount);
+	int iRepeatCount = (std::max)(Benchmark::GetArgument(argc, argv, 2, 20), 1);
+
+	// A field of instances swaying, stretching and turning, as an animated frame would set them
+	std::vector<XMFLOAT3> positions(iInstanceCount);
+	std::vector<XMFLOAT4> rotations(iInstanceCount);
+	std::vector<XMFLOAT3> scales(iInstanceCount);
+	for (int i = 0; i < iInstanceCount; i++)
+	{
+		float fAngle = 0.3f + i * 0.01f;
+		positions[i] = XMFLOAT3((i % 316) * 3.0f + sinf(0.3f + i), 0.5f * cosf(0.6f + i), (i / 316) * 3.0f);
+		XMStoreFloat4(&rotations[i], XMQuaternionNormalize(XMVectorSet(sinf(fAngle), cosf(fAngle * 1.3f), 0.3f, cosf(fAngle))));
+		scales[i] = XMFLOAT3(1.0f + 0.2f * sinf(fAngle), 1.0f, 1.5f);
+	}
+
+	std::vector<InstanceData> instances(iInstanceCount);
+	std::vector<InstanceData> scalarInstances(iInstanceCount);
+	std::vector<InstanceData> matrixInstances(iInstanceCount);
+	bool bSame = true;
+	double dMaxError = 0.0;
+	for (int iCount : { 1, 3, 4, 5, 6, 7, 8, 13, iInstanceCount })
+	{
+		InstancePacker::ComposeMatrices(positions.data(), rotations.data(), scales.data(), iCount, instances.data());
+		ComposeScalar(positions.data(), rotations.data(), scales.data(), iCount, scalarInstances.data());
+		ComposeWithMatrices(positions.data(), rotations.data(), scales.data(), iCount, matrixInstances.data());
+		for (int i = 0; i < iCount; i++)
+		{
+			bSame &= memcmp(instances[i].worldMatrix, scalarInstances[i].worldMatrix, sizeof(instances[i].worldMatrix)) == 0;
+			const float* values = &instances[i].worldMatrix[0].x;
+			const float* matrixValues = &matrixInstances[i].worldMatrix[0].x;
+			for (int j = 0; j < 12; j++)
+			{
+				dMaxError = (std::max)(dMaxError, fabs((double)values[j] - matrixValues[j]) / (1.0 + fabs(matrixValues[j])));
+			}
+		}
+	}
+	printf("Largest difference from XMMatrix S * R * T: %.2e (relative)\n", dMaxError);
+	Benchmark::Check(bSame, "the kernel matches its scalar loop bit for bit");
+	Benchmark::Check(dMaxError < 1e-6, "the kernel matches XMMatrix S * R * T to rounding");
+
+	for (int iCount : { iInstanceCount, CachedCount })
+	{
+		int iRepeats = (iCount == CachedCount) ? iRepeatCount * 100 : iRepeatCount;
+		double dKernelTime = Time(InstancePacker::ComposeMatrices, positions.data(), rotations.data(), scales.data(), iCount, instances.data(), iRepeats);
+		double dScalarTime = Time(ComposeScalar, positions.data(), rotations.data(), scales.data(), iCount, scalarInstances.data(), iRepeats);
+		double dMatrixTime = Time(ComposeWithMatrices, positions.data(), rotations.data(), scales.data(), iCount, matrixInstances.data(), iRepeats);
+		printf("%d instances (best of %d): ComposeMatrices %.2f ns (%.3f ms), scalar %.2f ns (%.3f ms), XMMatrix %.2f ns (%.3f ms) per instance\n", iCount, iRepeats,
+			dKernelTime, dKernelTime * iCount / 1e6, dScalarTime, dScalarTime * iCount / 1e6, dMatrixTime, dMatrixTime * iCount / 1e6);
+	}
+
+	return Benchmark::GetExitCode();
+}
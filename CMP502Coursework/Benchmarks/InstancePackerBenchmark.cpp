@@ -0,0 +1,221 @@
+//
+// InstancePackerBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Size of each instance layout, and the time to copy, pack (3x4) and compact pack random scaled, rotated and translated instances,
+// then to expand them again with C++ copies of the vertex shaders (IVS and CIVS in LightInstancedVertexShader.hlsl)
+// Checks the largest position, normal and light direction errors of each layout against the full world matrix, that every such
+// instance packs compactly, and that shears, mirrors, uneven or zero scales and long light directions are refused
+//
+// Usage: InstancePackerBenchmark [instances] (1000000 by default)
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "Benchmark.h"
+#include "InstancePacker.h"
+
+namespace
+{
+	const int RepeatCount = 3;
+
+	// IVS: mul(worldMatrix, position)
+	XMFLOAT3 Expand(const InstanceData& data, const XMFLOAT3& position)
+	{
+		const XMFLOAT4* rows = data.worldMatrix;
+		return XMFLOAT3(rows[0].x * position.x + rows[0].y * position.y + rows[0].z * position.z + rows[0].w,
+			rows[1].x * position.x + rows[1].y * position.y + rows[1].z * position.z + rows[1].w,
+			rows[2].x * position.x + rows[2].y * position.y + rows[2].z * position.z + rows[2].w);
+	}
+
+	XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	// Rotate: v + 2 * cross(q.xyz, cross(q.xyz, v) + q.w * v)
+	XMFLOAT3 Rotate(const XMFLOAT3& v, const XMFLOAT4& q)
+	{
+		XMFLOAT3 axis(q.x, q.y, q.z);
+		XMFLOAT3 inner = Cross(axis, v);
+		XMFLOAT3 outer = Cross(axis, XMFLOAT3(inner.x + q.w * v.x, inner.y + q.w * v.y, inner.z + q.w * v.z));
+		return XMFLOAT3(v.x + 2.0f * outer.x, v.y + 2.0f * outer.y, v.z + 2.0f * outer.z);
+	}
+
+	// The rotation as the input assembler reads it (signed normalized), renormalized as CIVS does
+	XMFLOAT4 GetRotation(const CompactInstanceData& data)
+	{
+		float q[4];
+		for (int i = 0; i < 4; i++)
+		{
+			q[i] = (std::max)(data.rotation[i] / 32767.0f, -1.0f);
+		}
+		float fLength = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+		return XMFLOAT4(q[0] / fLength, q[1] / fLength, q[2] / fLength, q[3] / fLength);
+	}
+
+	// CIVS: Rotate(position, rotation) * scale + translation
+	XMFLOAT3 Expand(const CompactInstanceData& data, const XMFLOAT4& rotation, const XMFLOAT3& position)
+	{
+		XMFLOAT3 rotated = Rotate(position, rotation);
+		return XMFLOAT3(rotated.x * data.fScale + data.position.x, rotated.y * data.fScale + data.position.y, rotated.z * data.fScale + data.position.z);
+	}
+
+	XMFLOAT3 GetLightDirection(const CompactInstanceData& data)
+	{
+		return XMFLOAT3((data.uiLightDirection & 1023) / 1023.0f * 2.0f - 1.0f, ((data.uiLightDirection >> 10) & 1023) / 1023.0f * 2.0f - 1.0f,
+			((data.uiLightDirection >> 20) & 1023) / 1023.0f * 2.0f - 1.0f);
+	}
+
+	double GetDistance(const XMFLOAT3& a, const double b[3])
+	{
+		return sqrt((a.x - b[0]) * (a.x - b[0]) + (a.y - b[1]) * (a.y - b[1]) + (a.z - b[2]) * (a.z - b[2]));
+	}
+
+	// Radians between two directions
+	double GetAngle(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		double dDot = (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z;
+		XMFLOAT3 cross = Cross(a, b);
+		return atan2(sqrt((double)cross.x * cross.x + (double)cross.y * cross.y + (double)cross.z * cross.z), dDot);
+	}
+
+	bool PacksCompact(const XMMATRIX& worldMatrix, const XMFLOAT3& lightDirection)
+	{
+		Instance instance;
+		instance.worldMatrix = XMMatrixTranspose(worldMatrix);
+		instance.uiTextureSlice = 0;
+		instance.lightDirection = lightDirection;
+		CompactInstanceData data;
+		return InstancePacker::PackCompact(instance, data);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int iInstanceCount = (std::max)(Benchmark::GetArgument(argc, argv, 1, 1000000), 1);
+
+	printf("Instance %d bytes, InstanceData (3x4) %d bytes, CompactInstanceData %d bytes\n", (int)sizeof(Instance), (int)sizeof(InstanceData), (int)sizeof(CompactInstanceData));
+	Benchmark::Check(sizeof(InstanceData) == 64 && sizeof(CompactInstanceData) == 32, "the instance buffer layouts are 64 and 32 bytes");
+
+	// Scales from 1/20 to 20, any rotation, and translations across a large level
+	std::mt19937 generator(3);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	std::vector<Instance> instances(iInstanceCount);
+	std::vector<XMFLOAT4X4> worldMatrices(iInstanceCount);
+	for (int i = 0; i < iInstanceCount; i++)
+	{
+		float fScale = expf(distribution(generator) * 3.0f);
+		XMMATRIX worldMatrix = XMMatrixScaling(fScale, fScale, fScale) * XMMatrixRotationRollPitchYaw(distribution(generator) * XM_PI, distribution(generator) * XM_PI, distribution(generator) * XM_PI)
+			* XMMatrixTranslation(distribution(generator) * 2000.0f, distribution(generator) * 300.0f, distribution(generator) * 2000.0f);
+		XMStoreFloat4x4(&worldMatrices[i], worldMatrix);
+		instances[i].worldMatrix = XMMatrixTranspose(worldMatrix);
+		instances[i].uiTextureSlice = i & 7;
+		instances[i].lightDirection = XMFLOAT3(distribution(generator), -0.8f, distribution(generator));
+	}
+
+	// Best of several runs
+	std::vector<Instance> copies(iInstanceCount);
+	std::vector<InstanceData> packed(iInstanceCount);
+	std::vector<CompactInstanceData> compactPacked(iInstanceCount);
+	double dCopyTime = 1e30, dPackTime = 1e30, dCompactPackTime = 1e30, dExpandTime = 1e30, dCompactExpandTime = 1e30;
+	int iRefusedCount = 0;
+	volatile float fSink = 0.0f;
+	for (int iRepeat = 0; iRepeat < RepeatCount; iRepeat++)
+	{
+		auto start = Benchmark::Clock::now();
+		memcpy(copies.data(), instances.data(), iInstanceCount * sizeof(Instance));
+		dCopyTime = (std::min)(dCopyTime, Benchmark::GetMilliseconds(start));
+
+		start = Benchmark::Clock::now();
+		for (int i = 0; i < iInstanceCount; i++)
+		{
+			InstancePacker::Pack(instances[i], packed[i]);
+		}
+		dPackTime = (std::min)(dPackTime, Benchmark::GetMilliseconds(start));
+
+		start = Benchmark::Clock::now();
+		iRefusedCount = 0;
+		for (int i = 0; i < iInstanceCount; i++)
+		{
+			iRefusedCount += InstancePacker::PackCompact(instances[i], compactPacked[i]) ? 0 : 1;
+		}
+		dCompactPackTime = (std::min)(dCompactPackTime, Benchmark::GetMilliseconds(start));
+
+		const XMFLOAT3 position(0.3f, 0.7f, -0.2f);
+		float fSum = 0.0f;
+		start = Benchmark::Clock::now();
+		for (int i = 0; i < iInstanceCount; i++)
+		{
+			fSum += Expand(packed[i], position).x;
+		}
+		dExpandTime = (std::min)(dExpandTime, Benchmark::GetMilliseconds(start));
+
+		start = Benchmark::Clock::now();
+		for (int i = 0; i < iInstanceCount; i++)
+		{
+			fSum += Expand(compactPacked[i], GetRotation(compactPacked[i]), position).x;
+		}
+		dCompactExpandTime = (std::min)(dCompactExpandTime, Benchmark::GetMilliseconds(start));
+		fSink = fSum;
+	}
+	printf("%d instances: copy %.1f ms (%.1f MB), pack 3x4 %.1f ms (%.1f MB), pack compact %.1f ms (%.1f MB)\n", iInstanceCount,
+		dCopyTime, iInstanceCount * sizeof(Instance) / 1048576.0, dPackTime, iInstanceCount * sizeof(InstanceData) / 1048576.0, dCompactPackTime, iInstanceCount * sizeof(CompactInstanceData) / 1048576.0);
+	printf("Expanding one vertex per instance: 3x4 %.1f ms, compact %.1f ms (sum of x %.1f)\n", dExpandTime, dCompactExpandTime, (float)fSink);
+	Benchmark::Check(std::isfinite((float)fSink), "every expanded vertex is finite");
+	Benchmark::Check(iRefusedCount == 0, "every rotated, uniformly scaled and translated instance packs compactly");
+
+	// The corners of a cube around the model's origin, against the world matrix in double precision; position errors are relative to
+	// the instance's scale, plus the float rounding of the translation itself, which both layouts share
+	const XMFLOAT3 normal(0.267f, 0.535f, 0.802f);
+	double dMaxError = 0.0, dMaxCompactError = 0.0, dMaxTranslationError = 0.0, dMaxNormalError = 0.0, dMaxLightError = 0.0;
+	for (int i = 0; i < iInstanceCount; i++)
+	{
+		const XMFLOAT4X4& m = worldMatrices[i];
+		double dScale = sqrt((double)m._11 * m._11 + (double)m._12 * m._12 + (double)m._13 * m._13);
+		double dTranslationError = (fabs(m._41) + fabs(m._42) + fabs(m._43)) * FLT_EPSILON;
+		dMaxTranslationError = (std::max)(dMaxTranslationError, dTranslationError / dScale);
+		XMFLOAT4 rotation = GetRotation(compactPacked[i]);
+		for (int iCorner = 0; iCorner < 8; iCorner++)
+		{
+			XMFLOAT3 corner((iCorner & 1) ? 1.0f : -1.0f, (iCorner & 2) ? 1.0f : -1.0f, (iCorner & 4) ? 1.0f : -1.0f);
+			double reference[3];
+			for (int j = 0; j < 3; j++)
+			{
+				reference[j] = corner.x * (double)m.m[0][j] + corner.y * (double)m.m[1][j] + corner.z * (double)m.m[2][j] + m.m[3][j];
+			}
+			dMaxError = (std::max)(dMaxError, (GetDistance(Expand(packed[i], corner), reference) - dTranslationError) / dScale);
+			dMaxCompactError = (std::max)(dMaxCompactError, (GetDistance(Expand(compactPacked[i], rotation, corner), reference) - dTranslationError) / dScale);
+		}
+
+		XMFLOAT3 referenceNormal;
+		XMStoreFloat3(&referenceNormal, XMVector3TransformNormal(XMLoadFloat3(&normal), XMLoadFloat4x4(&m)));
+		dMaxNormalError = (std::max)(dMaxNormalError, GetAngle(Rotate(normal, rotation), referenceNormal));
+
+		XMFLOAT3 lightDirection = GetLightDirection(compactPacked[i]);
+		const XMFLOAT3& referenceLightDirection = instances[i].lightDirection;
+		dMaxLightError = (std::max)(dMaxLightError, (double)(std::max)({ fabsf(lightDirection.x - referenceLightDirection.x), fabsf(lightDirection.y - referenceLightDirection.y), fabsf(lightDirection.z - referenceLightDirection.z) }));
+	}
+	printf("Largest errors over 8 cube corners per instance: position 3x4 %.2e and compact %.2e x scale (beyond the translation's own rounding, up to %.2e x scale), "
+		"normal %.2e rad, light direction %.2e\n", dMaxError, dMaxCompactError, dMaxTranslationError, dMaxNormalError, dMaxLightError);
+	Benchmark::Check(dMaxError < 1e-5, "3x4 instances land where the world matrix puts them");
+	Benchmark::Check(dMaxCompactError < 2e-4 && dMaxNormalError < 2e-4, "compact instances are within the quaternion's quantization");
+	Benchmark::Check(dMaxLightError <= 1.0 / 1023.0, "compact light directions are within half a 10 bit step");
+
+	const XMFLOAT3 lightDirection(0.0f, -0.8f, 0.5f);
+	XMMATRIX shear = XMMatrixIdentity();
+	shear.r[1] = XMVectorSet(0.3f, 1.0f, 0.0f, 0.0f);
+	Benchmark::Check(!PacksCompact(XMMatrixScaling(1.0f, 2.0f, 1.0f), lightDirection), "uneven scales are refused");
+	Benchmark::Check(!PacksCompact(XMMatrixScaling(1.0f, 1.0f, -1.0f), lightDirection), "mirrors are refused");
+	Benchmark::Check(!PacksCompact(shear, lightDirection), "shears are refused");
+	Benchmark::Check(!PacksCompact(XMMatrixScaling(0.0f, 0.0f, 0.0f), lightDirection), "zero scales are refused");
+	Benchmark::Check(!PacksCompact(XMMatrixIdentity(), XMFLOAT3(0.0f, -2.0f, 0.0f)), "light directions outside [-1, 1] are refused");
+	Benchmark::Check(PacksCompact(XMMatrixIdentity(), XMFLOAT3(0.0f, -1.0f, 0.0f)), "the identity with a unit light direction packs");
+
+	return Benchmark::GetExitCode();
+}
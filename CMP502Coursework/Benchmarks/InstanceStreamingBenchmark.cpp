@@ -0,0 +1,192 @@
+//
+// InstanceStreamingBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Time per frame to move the instances of a dynamic model and upload them through an UploadRing, on a WARP device: every one of
+// 100000 instances animated each frame, and a tenth of them moving in 1000 separate runs; with the bytes and ring discards per frame
+// Checks, by reading the instance buffer back, that it matches the model's copy after frames of random overlapping updates that wrap
+// the ring many times, after updates split across a ring smaller than one update, and after each timed run
+//
+// Usage: InstanceStreamingBenchmark [random frames] [timed frames] (300 and 120 by default)
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "Benchmark.h"
+#include "Model.h"
+
+namespace
+{
+	const int InstanceCount = 100000;
+	const UINT RingSize = 8 * 1024 * 1024; // ResourceManager's
+
+	// Exposes the instance buffer, to read it back
+	class StreamedModel : public Model
+	{
+	public:
+		ID3D11Buffer* GetInstanceBuffer()
+		{
+			return m_pInstanceBuffer;
+		}
+	};
+
+	bool MatchesInstanceBuffer(ID3D11Device* device, ID3D11DeviceContext* immediateContext, StreamedModel& model)
+	{
+		const std::vector<InstanceData>& instances = model.GetInstanceData();
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.ByteWidth = (UINT)(instances.size() * sizeof(InstanceData));
+		bufferDesc.Usage = D3D11_USAGE_STAGING;
+		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		ID3D11Buffer* pStagingBuffer = nullptr;
+		if (FAILED(device->CreateBuffer(&bufferDesc, nullptr, &pStagingBuffer)))
+		{
+			return false;
+		}
+
+		immediateContext->CopyResource(pStagingBuffer, model.GetInstanceBuffer());
+		D3D11_MAPPED_SUBRESOURCE mappedResource;
+		bool bMatches = false;
+		if (SUCCEEDED(immediateContext->Map(pStagingBuffer, 0, D3D11_MAP_READ, 0, &mappedResource)))
+		{
+			bMatches = memcmp(mappedResource.pData, instances.data(), bufferDesc.ByteWidth) == 0;
+			immediateContext->Unmap(pStagingBuffer, 0);
+		}
+		pStagingBuffer->Release();
+		return bMatches;
+	}
+
+	// Instances swaying, stretching and turning on a grid, at time fTime
+	void Animate(float fTime, std::vector<XMFLOAT3>& positions, std::vector<XMFLOAT4>& rotations, std::vector<XMFLOAT3>& scales)
+	{
+		for (int i = 0; i < (int)positions.size(); i++)
+		{
+			float fAngle = fTime + i * 0.01f;
+			positions[i] = XMFLOAT3((i % 316) * 3.0f + sinf(fTime + i), 0.5f * cosf(fTime * 2.0f + i), (i / 316) * 3.0f);
+			XMStoreFloat4(&rotations[i], XMQuaternionNormalize(XMVectorSet(sinf(fAngle), cosf(fAngle * 1.3f), 0.3f, cosf(fAngle))));
+			scales[i] = XMFLOAT3(1.0f + 0.2f * sinf(fAngle), 1.0f, 1.5f);
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int iRandomFrameCount = Benchmark::GetArgument(argc, argv, 1, 300);
+	int iTimedFrameCount = (std::max)(Benchmark::GetArgument(argc, argv, 2, 120), 1);
+
+	ID3D11Device* device = nullptr;
+	ID3D11DeviceContext* immediateContext = nullptr;
+	HRESULT result = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, 0, nullptr, 0, D3D11_SDK_VERSION, &device, nullptr, &immediateContext);
+	if (!Benchmark::Check(SUCCEEDED(result), "a WARP device is created"))
+	{
+		return Benchmark::GetExitCode();
+	}
+
+	{
+		// One triangle, as only the instances matter
+		ModelData vertices[3] = {};
+		unsigned int indices[3] = { 0, 1, 2 };
+		std::vector<Instance> instances(InstanceCount);
+		for (Instance& instance : instances)
+		{
+			instance.worldMatrix = XMMatrixIdentity();
+			instance.uiTextureSlice = 0;
+		}
+		StreamedModel model;
+		model.SetModelData(vertices);
+		model.SetVertexCount(3);
+		model.SetIndexData(indices);
+		model.SetIndexCount(3);
+		model.SetInstancesDynamic(true);
+		UploadRing ring;
+		if (!Benchmark::Check(model.InitializeBuffers(device, InstanceCount, instances.data()) && !model.IsCompactInstanced() && ring.Initialize(device, RingSize),
+			"a dynamic model and the ring are created, with 3x4 instances"))
+		{
+			immediateContext->Release();
+			device->Release();
+			return Benchmark::GetExitCode();
+		}
+
+		std::vector<XMFLOAT3> positions(InstanceCount);
+		std::vector<XMFLOAT4> rotations(InstanceCount);
+		std::vector<XMFLOAT3> scales(InstanceCount);
+
+		// Overlapping runs, mostly short with the odd long one, so that batches both share maps and wrap the ring
+		std::mt19937 generator(7);
+		bool bUpdated = true;
+		for (int iFrame = 0; iFrame < iRandomFrameCount && bUpdated; iFrame++)
+		{
+			int iRunCount = (int)(generator() % 20) + 1;
+			for (int iRun = 0; iRun < iRunCount; iRun++)
+			{
+				int iFirst = (int)(generator() % InstanceCount);
+				int iCount = (std::min)(InstanceCount - iFirst, (int)((generator() % 3 == 0) ? generator() % 60000 : generator() % 500));
+				Animate(iFrame * 0.1f + iRun, positions, rotations, scales);
+				bUpdated &= model.SetInstanceTransforms(iFirst, iCount, &positions[iFirst], &rotations[iFirst], &scales[iFirst]);
+			}
+			bUpdated &= model.UpdateInstanceBuffer(immediateContext, &ring);
+		}
+		printf("%d frames of random runs: the ring wrapped %d times\n", iRandomFrameCount, ring.GetDiscardCount());
+		Benchmark::Check(bUpdated && MatchesInstanceBuffer(device, immediateContext, model), "the instance buffer matches after random runs");
+		Benchmark::Check(!model.SetInstanceTransforms(InstanceCount - 1, 2, positions.data(), rotations.data(), scales.data()), "runs past the last instance are refused");
+
+		// Every instance, then a tenth of them in 1000 runs of 10 that shift each frame
+		for (int iPass = 0; iPass < 2; iPass++)
+		{
+			int iDiscardCount = ring.GetDiscardCount();
+			double dComposeTime = 0.0;
+			double dUploadTime = 0.0;
+			for (int iFrame = 0; iFrame < iTimedFrameCount; iFrame++)
+			{
+				Animate(iFrame / 60.0f, positions, rotations, scales);
+				auto start = Benchmark::Clock::now();
+				if (iPass == 0)
+				{
+					model.SetInstanceTransforms(0, InstanceCount, positions.data(), rotations.data(), scales.data());
+				}
+				else
+				{
+					for (int iRun = 0; iRun < 1000; iRun++)
+					{
+						int iFirst = iRun * 100 + iFrame % 90;
+						model.SetInstanceTransforms(iFirst, 10, &positions[iFirst], &rotations[iFirst], &scales[iFirst]);
+					}
+				}
+				dComposeTime += Benchmark::GetMilliseconds(start);
+
+				start = Benchmark::Clock::now();
+				model.UpdateInstanceBuffer(immediateContext, &ring);
+				immediateContext->Flush();
+				dUploadTime += Benchmark::GetMilliseconds(start);
+			}
+			int iMovedCount = (iPass == 0) ? InstanceCount : 10000;
+			printf("%d instances moving%s, per frame: compose %.3f ms, map, write and copy %.3f ms, %.2f MB, %.3f discards\n", iMovedCount, (iPass == 0) ? "" : " in 1000 runs",
+				dComposeTime / iTimedFrameCount, dUploadTime / iTimedFrameCount, iMovedCount * sizeof(InstanceData) / 1048576.0, (ring.GetDiscardCount() - iDiscardCount) / (double)iTimedFrameCount);
+			Benchmark::Check(MatchesInstanceBuffer(device, immediateContext, model), (iPass == 0) ? "the instance buffer matches after every instance moves" : "the instance buffer matches after scattered runs");
+		}
+
+		// Room for 1000 instances and a half, so that one update takes a hundred maps and ends part way into a batch
+		UploadRing smallRing;
+		Animate(9.0f, positions, rotations, scales);
+		bUpdated = smallRing.Initialize(device, 1000 * sizeof(InstanceData) + sizeof(InstanceData) / 2)
+			&& model.SetInstanceTransforms(0, InstanceCount, positions.data(), rotations.data(), scales.data()) && model.UpdateInstanceBuffer(immediateContext, &smallRing);
+		printf("Through a ring of 1000 instances: %d discards\n", smallRing.GetDiscardCount());
+		Benchmark::Check(bUpdated && MatchesInstanceBuffer(device, immediateContext, model), "the instance buffer matches after updates split across a small ring");
+
+		XMMATRIX worldMatrix = model.GetInstanceWorldMatrix(5);
+		XMMATRIX expectedMatrix = XMMatrixScaling(scales[5].x, scales[5].y, scales[5].z) * XMMatrixRotationQuaternion(XMLoadFloat4(&rotations[5])) * XMMatrixTranslation(positions[5].x, positions[5].y, positions[5].z);
+		float fError = 0.0f;
+		for (int i = 0; i < 4; i++)
+		{
+			fError = (std::max)(fError, XMVectorGetX(XMVector4Length(worldMatrix.r[i] - expectedMatrix.r[i])));
+		}
+		Benchmark::Check(fError < 1e-5f, "instance world matrices read back as S * R * T");
+	}
+
+	immediateContext->Release();
+	device->Release();
+	return Benchmark::GetExitCode();
+}
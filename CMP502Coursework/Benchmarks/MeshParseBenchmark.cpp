@@ -0,0 +1,156 @@
+//
+// MeshParseBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Throughput of MeshFile::ParseText on each text model, on one thread and on every core, against the istream parsing it replaced
+// Checks that every float matches the istream parse bit for bit, that random decimal strings match strtof, that well formed
+// edge cases (signs, exponents, CRLF, blank lines) are read, and that malformed lines and wrong vertex counts fail with errors
+//
+// Usage: MeshParseBenchmark [resource directory] [random vertices] (Resources and 100000 by default)
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Benchmark.h"
+#include "MappedFile.h"
+#include "MeshFile.h"
+
+namespace
+{
+	const int RepeatCount = 5;
+
+	// The loop LoadModel used before ParseText: skip to the count, skip to the data, then operator>> for every value
+	bool ParseWithStream(const unsigned char* data, size_t size, std::vector<ModelData>& vertices)
+	{
+		std::istringstream file(std::string((const char*)data, size));
+		char input;
+		while (file.get(input) && input != ':')
+		{
+		}
+		int iVertexCount = 0;
+		file >> iVertexCount;
+		while (file.get(input) && input != ':')
+		{
+		}
+
+		vertices.resize((std::max)(iVertexCount, 0));
+		for (ModelData& vertex : vertices)
+		{
+			file >> vertex.x >> vertex.y >> vertex.z >> vertex.tu >> vertex.tv >> vertex.nx >> vertex.ny >> vertex.nz;
+		}
+
+		return iVertexCount > 0 && !file.fail();
+	}
+
+	bool Parses(const char* text, std::vector<ModelData>& vertices, std::vector<std::string>& errors)
+	{
+		errors.clear();
+		return MeshFile::ParseText((const unsigned char*)text, strlen(text), vertices, &errors);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string resourceDirectory = Benchmark::GetArgument(argc, argv, 1, RESOURCE_DIRECTORY);
+	int iRandomVertexCount = Benchmark::GetArgument(argc, argv, 2, 100000);
+
+	std::vector<std::string> filenames;
+	Utils::ListFiles(resourceDirectory.c_str(), filenames);
+	for (const std::string& filename : filenames)
+	{
+		MappedFile file;
+		if (filename.size() < 4 || filename.compare(filename.size() - 4, 4, ".txt") != 0 || !Benchmark::Check(file.Open((resourceDirectory + "/" + filename).c_str()), filename + " opens"))
+		{
+			continue;
+		}
+
+		// Best of several runs, as the file is already in the page cache
+		std::vector<ModelData> streamVertices;
+		std::vector<ModelData> vertices;
+		double streamTimes[RepeatCount];
+		double singleThreadTimes[RepeatCount];
+		double parallelTimes[RepeatCount];
+		bool bParsed = true;
+		for (int i = 0; i < RepeatCount; i++)
+		{
+			auto start = Benchmark::Clock::now();
+			bParsed &= ParseWithStream(file.GetData(), file.GetSize(), streamVertices);
+			streamTimes[i] = Benchmark::GetMilliseconds(start);
+
+			start = Benchmark::Clock::now();
+			bParsed &= MeshFile::ParseText(file.GetData(), file.GetSize(), vertices, nullptr, 1);
+			singleThreadTimes[i] = Benchmark::GetMilliseconds(start);
+
+			start = Benchmark::Clock::now();
+			bParsed &= MeshFile::ParseText(file.GetData(), file.GetSize(), vertices, nullptr, 0);
+			parallelTimes[i] = Benchmark::GetMilliseconds(start);
+		}
+		bool bSame = bParsed && vertices.size() == streamVertices.size() && memcmp(vertices.data(), streamVertices.data(), vertices.size() * sizeof(ModelData)) == 0;
+		Benchmark::Check(bSame, filename + " parses to the same floats as operator>>");
+
+		double dMegabytes = file.GetSize() / 1048576.0;
+		printf("%s (%.2f MB): istringstream %.1f MB/s, ParseText on one thread %.1f MB/s, on every core %.1f MB/s\n", filename.c_str(), dMegabytes,
+			dMegabytes * 1000.0 / *std::min_element(streamTimes, streamTimes + RepeatCount),
+			dMegabytes * 1000.0 / *std::min_element(singleThreadTimes, singleThreadTimes + RepeatCount),
+			dMegabytes * 1000.0 / *std::min_element(parallelTimes, parallelTimes + RepeatCount));
+	}
+
+	// Fixed point, scientific with up to 80 bits of fraction, and short decimals, at random precisions
+	std::mt19937_64 generator(1);
+	std::string text = "Vertex Count: " + std::to_string(iRandomVertexCount) + "\n\nData:\n\n";
+	std::vector<float> expected;
+	for (int i = 0; i < iRandomVertexCount * 8; i++)
+	{
+		int iKind = (int)(generator() % 3);
+		double dValue = (iKind == 0) ? (double)((long long)(generator() % 2000001) - 1000000) / 1e6
+			: (iKind == 1) ? ldexp((double)(generator() >> 11), -(int)(generator() % 80)) * ((generator() & 1) ? 1.0 : -1.0)
+			: (double)(generator() % 100000) / 1e3;
+		char number[64];
+		snprintf(number, sizeof(number), (iKind == 1) ? "%.*g" : "%.*f", (int)(generator() % 12 + 1), dValue);
+		text += number;
+		text += (i % 8 == 7) ? '\n' : ' ';
+		expected.push_back(strtof(number, nullptr));
+	}
+	std::vector<ModelData> randomVertices;
+	bool bRandomParsed = MeshFile::ParseText((const unsigned char*)text.data(), text.size(), randomVertices);
+	int iDifferentCount = 0;
+	for (size_t i = 0; bRandomParsed && i < expected.size(); i++)
+	{
+		iDifferentCount += (memcmp(&expected[i], &randomVertices[i / 8].x + i % 8, sizeof(float)) != 0) ? 1 : 0;
+	}
+	printf("%d random decimal strings: %d differ from strtof\n", (int)expected.size(), iDifferentCount);
+	Benchmark::Check(bRandomParsed && iDifferentCount == 0, "random decimal strings match strtof");
+
+	std::vector<ModelData> vertices;
+	std::vector<std::string> errors;
+	bool bParsed = Parses("Vertex Count: 3\r\n\r\nData:\r\n\r\n1 2 3 4 5 6 7 8\r\n-1.5e2 +2 .5 4. 5e-3 6E+1 0.000 -0\r\n\r\n1 1 1 1 1 1 1 1", vertices, errors);
+	Benchmark::Check(bParsed && vertices.size() == 3 && vertices[1].x == -150.0f && vertices[1].z == 0.5f && vertices[1].tu == 4.0f && vertices[1].tv == 0.005f && vertices[1].nx == 60.0f && std::signbit(vertices[1].nz),
+		"signs, exponents, CRLF and blank lines are read");
+	bParsed = Parses("Vertex Count: 1\nData:\n3.4028235e38 1.17549435e-38 1e-50 0.1 0.30000001192092896 12345678901234567890123 0 0\n", vertices, errors);
+	Benchmark::Check(bParsed && vertices[0].x == 3.4028235e38f && vertices[0].y == 1.17549435e-38f && vertices[0].z == 0.0f && vertices[0].tu == 0.1f && vertices[0].tv == 0.3f && vertices[0].nx == 1.2345679e22f,
+		"extreme and long values round like strtof");
+
+	const char* malformedTexts[] =
+	{
+		"Vertex Count: 2\n\nData:\n\n1 2 3 4 5 6 7 8\n1 2 3 4 5 6 7\n", // Too few values
+		"Vertex Count: 2\n\nData:\n\n1 2 3 4 5 6 7 8\n1 2 3 4 5 6 7 8 9\n", // Too many
+		"Vertex Count: 2\n\nData:\n\n1 2 3 4 5 6 7 8\n1 2 x 4 5 6 7 8\n", // Not a number
+		"Vertex Count: 1\nData:\n1 2 3 4 5 6 7 8e\n", // Exponent without digits
+		"Vertex Count: 3\n\nData:\n\n1 2 3 4 5 6 7 8\n1 2 3 4 5 6 7 8\n", // Fewer vertices than declared
+		"Data" // No header
+	};
+	for (const char* malformedText : malformedTexts)
+	{
+		bParsed = Parses(malformedText, vertices, errors);
+		Benchmark::Check(!bParsed && !errors.empty(), std::string("malformed model is rejected with an error: ") + malformedText);
+	}
+
+	return Benchmark::GetExitCode();
+}
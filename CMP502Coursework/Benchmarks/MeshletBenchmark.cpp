@@ -0,0 +1,270 @@
+//
+// MeshletBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Meshlets of the cooked statue and balustrade, and how many the frustum and normal cone tests reject along a recorded camera path
+// through the scene (the statue and its 9 balustrades): triangles kept, draws, the time to cull and gather the kept indices each frame,
+// and how often the meshlet index buffer would be rewritten
+// Checks that the meshlets are within their limits and tile the full level, and, every few frames, that no meshlet the frustum
+// rejects has a vertex in view and no meshlet the cone rejects has a triangle facing the camera
+//
+// Usage: MeshletBenchmark [resource directory] [frames between keys] (Resources and 60 by default)
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "AssetCooker.h"
+#include "Benchmark.h"
+#include "Camera.h"
+#include "MappedFile.h"
+
+namespace
+{
+	const int CheckInterval = 10; // Frames between the checks of what was rejected
+
+	struct Mesh
+	{
+		std::vector<ModelData> vertices;
+		std::vector<unsigned int> indices;
+		std::vector<MeshLod> lods;
+		std::vector<Meshlet> meshlets;
+		std::vector<XMMATRIX> worldMatrices;
+		std::vector<std::vector<int>> drawnMeshlets; // Kept for each instance at the last rewrite
+		std::vector<unsigned int> meshletIndices; // The meshlet index buffer
+		int iDrawCount;
+	};
+
+	// The camera at a key of the path: position, then yaw and pitch in degrees
+	struct PathKey
+	{
+		XMFLOAT3 position;
+		float fYaw;
+		float fPitch;
+	};
+
+	// The start view, the statue close up, an orbit of the garden, overhead, and a walk down the middle and back to the start
+	const PathKey Path[] =
+	{
+		{ XMFLOAT3(0.0f, 8.0f, -22.0f), 0.0f, 20.0f }, { XMFLOAT3(0.0f, 3.7f, -12.0f), 0.0f, 10.0f }, { XMFLOAT3(6.0f, 3.0f, -6.0f), -45.0f, 15.0f },
+		{ XMFLOAT3(10.0f, 4.0f, 4.0f), -110.0f, 15.0f }, { XMFLOAT3(3.0f, 3.0f, 12.0f), -170.0f, 10.0f }, { XMFLOAT3(-8.0f, 3.0f, 9.0f), 120.0f, 10.0f },
+		{ XMFLOAT3(-10.0f, 4.0f, -4.0f), 60.0f, 15.0f }, { XMFLOAT3(-4.0f, 6.0f, -14.0f), 15.0f, 25.0f }, { XMFLOAT3(0.0f, 12.0f, 0.0f), 0.0f, 80.0f },
+		{ XMFLOAT3(0.0f, 2.0f, 10.0f), 0.0f, 0.0f }, { XMFLOAT3(0.0f, 2.0f, 20.0f), 180.0f, 5.0f }, { XMFLOAT3(0.0f, 8.0f, -22.0f), 0.0f, 20.0f }
+	};
+
+	bool LoadMesh(const std::string& filename, Mesh& mesh)
+	{
+		MappedFile file;
+		std::vector<unsigned char> cooked;
+		std::string message;
+		auto start = Benchmark::Clock::now();
+		bool bCooked = file.Open(filename.c_str()) && AssetCooker::CookMesh(file.GetData(), file.GetSize(), cooked, &message);
+		double dMilliseconds = Benchmark::GetMilliseconds(start);
+		if (!bCooked || !MeshFile::ReadCooked(cooked.data(), cooked.size(), mesh.vertices, mesh.indices, mesh.lods, mesh.meshlets))
+		{
+			return false;
+		}
+
+		printf("%s: %d triangles, %d meshlets (%.1f triangles each), cooked in %.0f ms\n", filename.substr(filename.find_last_of('/') + 1).c_str(), (int)mesh.lods[0].uiIndexCount / 3, (int)mesh.meshlets.size(),
+			mesh.lods[0].uiIndexCount / 3.0 / (std::max)((int)mesh.meshlets.size(), 1), dMilliseconds);
+		mesh.iDrawCount = 0;
+		return true;
+	}
+
+	// Within the builder's limits, contiguous, and covering the full level once
+	bool AreMeshletsValid(const Mesh& mesh)
+	{
+		unsigned int uiNextIndex = mesh.lods[0].uiFirstIndex;
+		for (const Meshlet& meshlet : mesh.meshlets)
+		{
+			std::vector<unsigned int> vertices(mesh.indices.begin() + meshlet.uiFirstIndex, mesh.indices.begin() + meshlet.uiFirstIndex + meshlet.uiIndexCount);
+			std::sort(vertices.begin(), vertices.end());
+			int iVertexCount = (int)(std::unique(vertices.begin(), vertices.end()) - vertices.begin());
+			if (meshlet.uiFirstIndex != uiNextIndex || meshlet.uiIndexCount % 3 != 0 || (int)meshlet.uiIndexCount / 3 > MeshletBuilder::MaxTriangles || iVertexCount > MeshletBuilder::MaxVertices)
+			{
+				return false;
+			}
+			uiNextIndex += meshlet.uiIndexCount;
+		}
+
+		return !mesh.meshlets.empty() && uiNextIndex == mesh.lods[0].uiFirstIndex + mesh.lods[0].uiIndexCount;
+	}
+
+	// Whether any vertex of the meshlet is inside the planes, or any of its triangles faces the camera, both in model space
+	bool IsAnyVertexInView(const Mesh& mesh, const Meshlet& meshlet, const XMFLOAT4* frustumPlanes)
+	{
+		for (unsigned int i = meshlet.uiFirstIndex; i < meshlet.uiFirstIndex + meshlet.uiIndexCount; i++)
+		{
+			const ModelData& vertex = mesh.vertices[mesh.indices[i]];
+			bool bInside = true;
+			for (int j = 0; j < 6; j++)
+			{
+				bInside &= frustumPlanes[j].x * vertex.x + frustumPlanes[j].y * vertex.y + frustumPlanes[j].z * vertex.z + frustumPlanes[j].w >= 0.0f;
+			}
+			if (bInside)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool IsAnyTriangleFacing(const Mesh& mesh, const Meshlet& meshlet, const XMFLOAT3& cameraPosition)
+	{
+		XMVECTOR vCameraPosition = XMLoadFloat3(&cameraPosition);
+		for (unsigned int i = meshlet.uiFirstIndex; i < meshlet.uiFirstIndex + meshlet.uiIndexCount; i += 3)
+		{
+			const ModelData* corners[3] = { &mesh.vertices[mesh.indices[i]], &mesh.vertices[mesh.indices[i + 1]], &mesh.vertices[mesh.indices[i + 2]] };
+			XMVECTOR vA = XMVectorSet(corners[0]->x, corners[0]->y, corners[0]->z, 0.0f);
+			XMVECTOR vB = XMVectorSet(corners[1]->x, corners[1]->y, corners[1]->z, 0.0f);
+			XMVECTOR vC = XMVectorSet(corners[2]->x, corners[2]->y, corners[2]->z, 0.0f);
+
+			// Clockwise triangles face the camera, as the rasterizer sees them
+			XMVECTOR vNormal = XMVector3Cross(vB - vA, vC - vA);
+			if (XMVectorGetX(XMVector3Dot(vNormal, vA - vCameraPosition)) < 0.0f)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string resourceDirectory = Benchmark::GetArgument(argc, argv, 1, RESOURCE_DIRECTORY);
+	int iFramesPerKey = (std::max)(Benchmark::GetArgument(argc, argv, 2, 60), 1);
+
+	// Placed as ResourceManager places them
+	Mesh meshes[2];
+	if (!Benchmark::Check(LoadMesh(resourceDirectory + "/statue.txt", meshes[0]) && LoadMesh(resourceDirectory + "/balustrade.txt", meshes[1]), "the statue and balustrade cook with meshlets"))
+	{
+		return Benchmark::GetExitCode();
+	}
+	meshes[0].worldMatrices.push_back(XMMatrixIdentity());
+	const float balustrades[9][3] = { { -0.84f, 0.95f, 0.0f }, { -0.03f, 0.95f, 0.0f }, { 0.78f, 0.95f, 0.0f }, { 0.45f, 1.273f, -0.5f }, { -0.36f, 1.273f, -0.5f }, { -1.17f, 1.273f, -0.5f },
+		{ -0.5f, 1.273f, 0.5f }, { 0.31f, 1.273f, 0.5f }, { 1.12f, 1.273f, 0.5f } };
+	for (const auto& balustrade : balustrades)
+	{
+		meshes[1].worldMatrices.push_back(XMMatrixTranslation(balustrade[0], -0.125f, balustrade[1]) * XMMatrixRotationRollPitchYaw(0.0f, XM_PI * balustrade[2], 0.0f) * XMMatrixScaling(11.0f, 11.0f, 11.0f));
+	}
+	for (Mesh& mesh : meshes)
+	{
+		mesh.meshletIndices.resize(mesh.lods[0].uiIndexCount * mesh.worldMatrices.size()); // Every instance may keep different meshlets
+		Benchmark::Check(AreMeshletsValid(mesh), "meshlets are within their limits and tile the full level");
+	}
+
+	int iKeyCount = sizeof(Path) / sizeof(Path[0]);
+	int iFrameCount = (iKeyCount - 1) * iFramesPerKey;
+	long long llFullTriangles = 0, llKeptTriangles = 0, llDrawCount = 0;
+	long long llMeshletTests = 0, llFrustumRejects = 0, llConeRejects = 0;
+	int iRewriteCount = 0;
+	int iWrongFrustumRejects = 0, iWrongConeRejects = 0;
+	double dCullTime = 0.0;
+	for (int iFrame = 0; iFrame < iFrameCount; iFrame++)
+	{
+		const PathKey& key = Path[iFrame / iFramesPerKey];
+		const PathKey& nextKey = Path[iFrame / iFramesPerKey + 1];
+		float fT = (iFrame % iFramesPerKey) / (float)iFramesPerKey;
+		XMFLOAT3 position;
+		XMStoreFloat3(&position, XMVectorLerp(XMLoadFloat3(&key.position), XMLoadFloat3(&nextKey.position), fT));
+		Camera camera(position, 16.0f / 9.0f);
+		camera.Rotate(key.fYaw + (nextKey.fYaw - key.fYaw) * fT, key.fPitch + (nextKey.fPitch - key.fPitch) * fT - 20.0f); // The camera starts pitched down 20 degrees
+		camera.Update();
+		XMMATRIX viewProjectionMatrix = camera.GetViewMatrix() * camera.GetProjectionMatrix();
+		XMFLOAT3 cameraPosition = camera.GetPosition();
+
+		for (Mesh& mesh : meshes)
+		{
+			// As Model::CullMeshlets does for models of up to 16 instances: a list for each, taken into its model space
+			auto start = Benchmark::Clock::now();
+			std::vector<std::vector<int>> culledMeshlets(mesh.worldMatrices.size());
+			for (size_t i = 0; i < mesh.worldMatrices.size(); i++)
+			{
+				XMFLOAT4 frustumPlanes[6];
+				MeshletBuilder::GetFrustumPlanes(mesh.worldMatrices[i] * viewProjectionMatrix, frustumPlanes);
+				XMVECTOR vDeterminant;
+				XMMATRIX inverseWorldMatrix = XMMatrixInverse(&vDeterminant, mesh.worldMatrices[i]);
+				XMFLOAT3 modelCameraPosition;
+				XMStoreFloat3(&modelCameraPosition, XMVector3TransformCoord(XMLoadFloat3(&cameraPosition), inverseWorldMatrix));
+				bool bMirrored = XMVectorGetX(vDeterminant) < 0.0f;
+				for (int j = 0; j < (int)mesh.meshlets.size(); j++)
+				{
+					if (MeshletBuilder::IsInFrustum(mesh.meshlets[j], frustumPlanes) && (bMirrored || !MeshletBuilder::IsBackFacing(mesh.meshlets[j], modelCameraPosition)))
+					{
+						culledMeshlets[i].push_back(j);
+					}
+				}
+			}
+
+			// Gathered into the index buffer only when a list changes, with runs of instances keeping the same meshlets drawn together
+			if (culledMeshlets != mesh.drawnMeshlets)
+			{
+				iRewriteCount++;
+				mesh.iDrawCount = 0;
+				unsigned int uiIndexCount = 0;
+				for (size_t i = 0; i < culledMeshlets.size(); i++)
+				{
+					if (culledMeshlets[i].empty() || (i > 0 && culledMeshlets[i] == culledMeshlets[i - 1]))
+					{
+						continue;
+					}
+					mesh.iDrawCount++;
+					for (int j : culledMeshlets[i])
+					{
+						const Meshlet& meshlet = mesh.meshlets[j];
+						memcpy(&mesh.meshletIndices[uiIndexCount], &mesh.indices[meshlet.uiFirstIndex], meshlet.uiIndexCount * sizeof(unsigned int));
+						uiIndexCount += meshlet.uiIndexCount;
+					}
+				}
+				mesh.drawnMeshlets.swap(culledMeshlets);
+			}
+			dCullTime += Benchmark::GetMilliseconds(start);
+			llDrawCount += mesh.iDrawCount;
+
+			// Why each meshlet of each instance was rejected, and whether it should have been
+			for (size_t i = 0; i < mesh.worldMatrices.size(); i++)
+			{
+				XMFLOAT4 frustumPlanes[6];
+				MeshletBuilder::GetFrustumPlanes(mesh.worldMatrices[i] * viewProjectionMatrix, frustumPlanes);
+				XMFLOAT3 modelCameraPosition;
+				XMStoreFloat3(&modelCameraPosition, XMVector3TransformCoord(XMLoadFloat3(&cameraPosition), XMMatrixInverse(nullptr, mesh.worldMatrices[i])));
+				for (const Meshlet& meshlet : mesh.meshlets)
+				{
+					llMeshletTests++;
+					llFullTriangles += meshlet.uiIndexCount / 3;
+					bool bChecked = iFrame % CheckInterval == 0;
+					if (!MeshletBuilder::IsInFrustum(meshlet, frustumPlanes))
+					{
+						llFrustumRejects++;
+						iWrongFrustumRejects += (bChecked && IsAnyVertexInView(mesh, meshlet, frustumPlanes)) ? 1 : 0;
+					}
+					else if (MeshletBuilder::IsBackFacing(meshlet, modelCameraPosition))
+					{
+						llConeRejects++;
+						iWrongConeRejects += (bChecked && IsAnyTriangleFacing(mesh, meshlet, modelCameraPosition)) ? 1 : 0;
+					}
+				}
+				for (int j : mesh.drawnMeshlets[i])
+				{
+					llKeptTriangles += mesh.meshlets[j].uiIndexCount / 3;
+				}
+			}
+		}
+	}
+
+	printf("%d frames: %.1f%% of meshlets rejected by the frustum and %.1f%% by the normal cone, for each instance\n", iFrameCount,
+		100.0 * llFrustumRejects / llMeshletTests, 100.0 * llConeRejects / llMeshletTests);
+	printf("Per frame: %lld of %lld triangles kept (%.1f%%), %.1f draws (2 without meshlets), culled and gathered in %.3f ms\n",
+		llKeptTriangles / iFrameCount, llFullTriangles / iFrameCount, 100.0 * llKeptTriangles / llFullTriangles, (double)llDrawCount / iFrameCount, dCullTime / iFrameCount);
+	printf("Meshlet index buffers rewritten on %d of %d model updates\n", iRewriteCount, iFrameCount * 2);
+	Benchmark::Check(iWrongFrustumRejects == 0, "no meshlet outside the frustum has a vertex in view");
+	Benchmark::Check(iWrongConeRejects == 0, "no meshlet behind its normal cone has a triangle facing the camera");
+
+	return Benchmark::GetExitCode();
+}
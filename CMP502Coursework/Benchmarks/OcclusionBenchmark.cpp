@@ -0,0 +1,417 @@
+//
+// OcclusionBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// How many instances in view the pillars, hedges and balustrades hide along a recorded camera path through the garden, with the
+// occluder triangles submitted and rasterized, and the time to render the occluders (on one thread and on every core) and to test every
+// instance, each frame
+// Checks, every few frames, each instance the culler hides against a full resolution z-buffer of the occluders at full detail, and that
+// rendering on every core hides the same instances
+//
+// Usage: OcclusionBenchmark [resource directory] [frames between keys] (Resources and 60 by default)
+// The lupines and lavenders are placed by hand, at the beds they're scattered over in the scene
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AssetCooker.h"
+#include "Benchmark.h"
+#include "Camera.h"
+#include "MappedFile.h"
+#include "OcclusionCuller.h"
+
+namespace
+{
+	const int OcclusionBufferWidth = 320; // ResourceManager's
+	const int OcclusionBufferHeight = 180;
+	const int ReferenceWidth = 1280;
+	const int ReferenceHeight = 720;
+	const int CheckInterval = 10; // Frames between the checks of what was hidden
+
+	struct Mesh
+	{
+		const char* filename = nullptr;
+		bool bOccluder = false;
+		std::vector<ModelData> vertices = {};
+		std::vector<unsigned int> indices = {};
+		std::vector<MeshLod> lods = {};
+		std::vector<Meshlet> meshlets = {};
+		XMFLOAT3 minimum = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		XMFLOAT3 maximum = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		std::vector<XMMATRIX> worldMatrices = {};
+		long long llInViewCount = 0;
+		long long llVisibleCount = 0;
+	};
+
+	// The camera at a key of the path: position, then yaw and pitch in degrees
+	struct PathKey
+	{
+		XMFLOAT3 position;
+		float fYaw;
+		float fPitch;
+	};
+
+	// MeshletBenchmark's: the start view, the statue close up, an orbit of the garden, overhead, and a walk down the middle and back to the start
+	const PathKey Path[] =
+	{
+		{ XMFLOAT3(0.0f, 8.0f, -22.0f), 0.0f, 20.0f }, { XMFLOAT3(0.0f, 3.7f, -12.0f), 0.0f, 10.0f }, { XMFLOAT3(6.0f, 3.0f, -6.0f), -45.0f, 15.0f },
+		{ XMFLOAT3(10.0f, 4.0f, 4.0f), -110.0f, 15.0f }, { XMFLOAT3(3.0f, 3.0f, 12.0f), -170.0f, 10.0f }, { XMFLOAT3(-8.0f, 3.0f, 9.0f), 120.0f, 10.0f },
+		{ XMFLOAT3(-10.0f, 4.0f, -4.0f), 60.0f, 15.0f }, { XMFLOAT3(-4.0f, 6.0f, -14.0f), 15.0f, 25.0f }, { XMFLOAT3(0.0f, 12.0f, 0.0f), 0.0f, 80.0f },
+		{ XMFLOAT3(0.0f, 2.0f, 10.0f), 0.0f, 0.0f }, { XMFLOAT3(0.0f, 2.0f, 20.0f), 180.0f, 5.0f }, { XMFLOAT3(0.0f, 8.0f, -22.0f), 0.0f, 20.0f }
+	};
+
+	bool LoadMesh(const std::string& resourceDirectory, Mesh& mesh)
+	{
+		MappedFile file;
+		std::vector<unsigned char> cooked;
+		if (!file.Open((resourceDirectory + "/" + mesh.filename).c_str()) || !AssetCooker::CookMesh(file.GetData(), file.GetSize(), cooked, nullptr) ||
+			!MeshFile::ReadCooked(cooked.data(), cooked.size(), mesh.vertices, mesh.indices, mesh.lods, mesh.meshlets))
+		{
+			return false;
+		}
+
+		XMVECTOR vMinimum = XMVectorReplicate(FLT_MAX);
+		XMVECTOR vMaximum = XMVectorReplicate(-FLT_MAX);
+		for (const ModelData& vertex : mesh.vertices)
+		{
+			XMVECTOR vPosition = XMVectorSet(vertex.x, vertex.y, vertex.z, 0.0f);
+			vMinimum = XMVectorMin(vMinimum, vPosition);
+			vMaximum = XMVectorMax(vMaximum, vPosition);
+		}
+		XMStoreFloat3(&mesh.minimum, vMinimum);
+		XMStoreFloat3(&mesh.maximum, vMaximum);
+		return true;
+	}
+
+	// As ResourceManager::UpdateOcclusion does: the occluders in view at their coarsest level; returns the triangles submitted
+	long long RenderOccluders(OcclusionCuller& culler, const Mesh* meshes, int iMeshCount, const XMMATRIX& viewProjectionMatrix)
+	{
+		long long llSubmittedTriangles = 0;
+		culler.BeginFrame(viewProjectionMatrix);
+		for (int i = 0; i < iMeshCount; i++)
+		{
+			const Mesh& mesh = meshes[i];
+			if (!mesh.bOccluder)
+			{
+				continue;
+			}
+
+			const MeshLod& lod = mesh.lods.back();
+			for (const XMMATRIX& worldMatrix : mesh.worldMatrices)
+			{
+				if (culler.IsInView(mesh.minimum, mesh.maximum, worldMatrix))
+				{
+					culler.AddOccluder(mesh.vertices.data(), mesh.indices.data() + lod.uiFirstIndex, lod.uiIndexCount, worldMatrix);
+					llSubmittedTriangles += lod.uiIndexCount / 3;
+				}
+			}
+		}
+		culler.RenderOccluders();
+		return llSubmittedTriangles;
+	}
+
+	// A plain z-buffer, sampled at pixel centres with no conservative rounding, to hold the culler to
+	class ReferenceBuffer
+	{
+	public:
+		std::vector<float> depths;
+
+		ReferenceBuffer() : depths(ReferenceWidth * ReferenceHeight, 1.0f)
+		{
+		}
+
+		// Calls pixel(index, depth) for each pixel the full level of the mesh covers, clipped against the near plane
+		template <class PixelFunction>
+		void Rasterize(const Mesh& mesh, const XMMATRIX& worldViewProjectionMatrix, PixelFunction pixel) const
+		{
+			for (unsigned int i = 0; i < mesh.lods[0].uiIndexCount; i += 3)
+			{
+				XMFLOAT4 corners[3];
+				for (int j = 0; j < 3; j++)
+				{
+					const ModelData& vertex = mesh.vertices[mesh.indices[mesh.lods[0].uiFirstIndex + i + j]];
+					XMStoreFloat4(&corners[j], XMVector4Transform(XMVectorSet(vertex.x, vertex.y, vertex.z, 1.0f), worldViewProjectionMatrix));
+				}
+
+				XMFLOAT4 clipped[4];
+				int iClippedCount = 0;
+				for (int j = 0; j < 3; j++)
+				{
+					const XMFLOAT4& a = corners[j];
+					const XMFLOAT4& b = corners[(j + 1) % 3];
+					if (a.z >= 0.0f)
+					{
+						clipped[iClippedCount++] = a;
+					}
+					if ((a.z >= 0.0f) != (b.z >= 0.0f))
+					{
+						float fT = a.z / (a.z - b.z);
+						clipped[iClippedCount++] = XMFLOAT4(a.x + (b.x - a.x) * fT, a.y + (b.y - a.y) * fT, 0.0f, a.w + (b.w - a.w) * fT);
+					}
+				}
+				for (int j = 1; j + 1 < iClippedCount; j++)
+				{
+					const XMFLOAT4* triangle[3] = { &clipped[0], &clipped[j], &clipped[j + 1] };
+					RasterizeTriangle(triangle, pixel);
+				}
+			}
+		}
+
+	private:
+		template <class PixelFunction>
+		void RasterizeTriangle(const XMFLOAT4** corners, PixelFunction pixel) const
+		{
+			float x[3], y[3], z[3];
+			for (int j = 0; j < 3; j++)
+			{
+				x[j] = (corners[j]->x / corners[j]->w * 0.5f + 0.5f) * ReferenceWidth;
+				y[j] = (0.5f - corners[j]->y / corners[j]->w * 0.5f) * ReferenceHeight;
+				z[j] = corners[j]->z / corners[j]->w;
+			}
+
+			// Clockwise on screen faces the camera
+			float fArea = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+			if (!(fArea > 0.0f))
+			{
+				return;
+			}
+
+			int iMinX = (std::max)(0, (int)floorf((std::min)({ x[0], x[1], x[2] })));
+			int iMaxX = (std::min)(ReferenceWidth - 1, (int)ceilf((std::max)({ x[0], x[1], x[2] })));
+			int iMinY = (std::max)(0, (int)floorf((std::min)({ y[0], y[1], y[2] })));
+			int iMaxY = (std::min)(ReferenceHeight - 1, (int)ceilf((std::max)({ y[0], y[1], y[2] })));
+			for (int iY = iMinY; iY <= iMaxY; iY++)
+			{
+				for (int iX = iMinX; iX <= iMaxX; iX++)
+				{
+					float fX = iX + 0.5f;
+					float fY = iY + 0.5f;
+					float fW0 = (x[2] - x[1]) * (fY - y[1]) - (y[2] - y[1]) * (fX - x[1]);
+					float fW1 = (x[0] - x[2]) * (fY - y[2]) - (y[0] - y[2]) * (fX - x[2]);
+					float fW2 = (x[1] - x[0]) * (fY - y[0]) - (y[1] - y[0]) * (fX - x[0]);
+					if (fW0 < 0.0f || fW1 < 0.0f || fW2 < 0.0f)
+					{
+						continue;
+					}
+
+					float fDepth = (fW0 * z[0] + fW1 * z[1] + fW2 * z[2]) / fArea;
+					if (fDepth >= 0.0f && fDepth <= 1.0f)
+					{
+						pixel(iY * ReferenceWidth + iX, fDepth);
+					}
+				}
+			}
+		}
+	};
+}
+
+int main(int argc, char* argv[])
+{
+	std::string resourceDirectory = Benchmark::GetArgument(argc, argv, 1, RESOURCE_DIRECTORY);
+	int iFramesPerKey = (std::max)(Benchmark::GetArgument(argc, argv, 2, 60), 1);
+
+	// Placed as ResourceManager places them
+	Mesh meshes[7] = { { "statue.txt", false }, { "pillar.txt", true }, { "fountain.txt", false }, { "lupine.txt", false }, { "lavender.txt", false },
+		{ "plane.txt", true }, { "balustrade.txt", true } };
+	Mesh& statue = meshes[0];
+	Mesh& pillar = meshes[1];
+	Mesh& fountain = meshes[2];
+	Mesh& lupine = meshes[3];
+	Mesh& lavender = meshes[4];
+	Mesh& hedge = meshes[5];
+	Mesh& balustrade = meshes[6];
+	for (Mesh& mesh : meshes)
+	{
+		if (!Benchmark::Check(LoadMesh(resourceDirectory, mesh), std::string(mesh.filename) + " cooks"))
+		{
+			return Benchmark::GetExitCode();
+		}
+	}
+
+	statue.worldMatrices.push_back(XMMatrixIdentity());
+	const float pillars[8][2] = { { -0.8f, -0.8f }, { -0.75f, -0.4f }, { -0.55f, -0.07f }, { -0.225f, 0.2f }, { 0.225f, 0.2f }, { 0.55f, -0.07f }, { 0.75f, -0.4f }, { 0.8f, -0.8f } };
+	for (const auto& position : pillars)
+	{
+		pillar.worldMatrices.push_back(XMMatrixTranslation(position[0], position[1], 0.0f) * XMMatrixRotationRollPitchYaw(XM_PI * 0.5f, XM_PI * 0.5f, XM_PI * 0.5f) * XMMatrixScaling(12.0f, 12.0f, 12.0f));
+	}
+	fountain.worldMatrices.push_back(XMMatrixTranslation(3.0f, 125.0f, -375.0f) * XMMatrixScaling(0.02f, 0.02f, 0.02f));
+	const float lupines[16][2] = { { -155.0f, -330.0f }, { -100.0f, -280.0f }, { -35.0f, -255.0f }, { 35.0f, -255.0f }, { 100.0f, -280.0f }, { 155.0f, -330.0f },
+		{ -155.0f, -555.0f }, { -100.0f, -605.0f }, { -35.0f, -630.0f }, { 35.0f, -630.0f }, { 100.0f, -605.0f }, { 155.0f, -555.0f },
+		{ -180.0f, -405.0f }, { -180.0f, -485.0f }, { 180.0f, -405.0f }, { 180.0f, -485.0f } };
+	for (const auto& position : lupines)
+	{
+		lupine.worldMatrices.push_back(XMMatrixTranslation(position[0], 0.0f, position[1]) * XMMatrixScaling(0.017f, 0.017f, 0.017f));
+	}
+	const float lavenders[27][2] = { { 30.0f, 0.0f }, { -100.0f, 0.0f }, { 100.0f, 0.0f }, { -500.0f, 400.0f }, { -600.0f, 500.0f }, { -700.0f, 500.0f },
+		{ 500.0f, 400.0f }, { 600.0f, 500.0f }, { 700.0f, 500.0f }, { -1250.0f, -150.0f }, { -1350.0f, -50.0f }, { -1450.0f, -50.0f },
+		{ 1250.0f, -150.0f }, { 1350.0f, -50.0f }, { 1450.0f, -50.0f }, { -1750.0f, -850.0f }, { -1850.0f, -750.0f }, { -1950.0f, -750.0f },
+		{ 1750.0f, -850.0f }, { 1850.0f, -750.0f }, { 1950.0f, -750.0f }, { -1850.0f, -1650.0f }, { -1950.0f, -1550.0f }, { -2050.0f, -1550.0f },
+		{ 1850.0f, -1650.0f }, { 1950.0f, -1550.0f }, { 2050.0f, -1550.0f } };
+	for (const auto& position : lavenders)
+	{
+		lavender.worldMatrices.push_back(XMMatrixTranslation(position[0], -250.0f, position[1]) * XMMatrixScaling(0.005f, 0.006f, 0.006f));
+	}
+	XMMATRIX hedgeScalingMatrix = XMMatrixScaling(0.7f, 0.7f, 0.7f);
+	hedge.worldMatrices.push_back(XMMatrixTranslation(-5.0f, -20.0f, 20.0f) * XMMatrixRotationRollPitchYaw(XM_PI * -0.5f, XM_PI * -0.5f, 0.0f) * hedgeScalingMatrix);
+	hedge.worldMatrices.push_back(XMMatrixTranslation(0.0f, -15.0f, 20.0f) * XMMatrixRotationRollPitchYaw(XM_PI * -0.5f, 0.0f, 0.0f) * hedgeScalingMatrix);
+	hedge.worldMatrices.push_back(XMMatrixTranslation(5.0f, -20.0f, 20.0f) * XMMatrixRotationRollPitchYaw(XM_PI * -0.5f, XM_PI * 0.5f, 0.0f) * hedgeScalingMatrix);
+	const float balustrades[9][3] = { { -0.84f, 0.95f, 0.0f }, { -0.03f, 0.95f, 0.0f }, { 0.78f, 0.95f, 0.0f }, { 0.45f, 1.273f, -0.5f }, { -0.36f, 1.273f, -0.5f }, { -1.17f, 1.273f, -0.5f },
+		{ -0.5f, 1.273f, 0.5f }, { 0.31f, 1.273f, 0.5f }, { 1.12f, 1.273f, 0.5f } };
+	for (const auto& position : balustrades)
+	{
+		balustrade.worldMatrices.push_back(XMMatrixTranslation(position[0], -0.125f, position[1]) * XMMatrixRotationRollPitchYaw(0.0f, XM_PI * position[2], 0.0f) * XMMatrixScaling(11.0f, 11.0f, 11.0f));
+	}
+
+	// One on a single thread, as the numbers checked below; the other on every core (at least four), timed alongside and held to the same result
+	OcclusionCuller culler;
+	OcclusionCuller threadedCuller;
+	int iThreadCount = (std::max)((int)std::thread::hardware_concurrency(), 4);
+	if (!Benchmark::Check(culler.Initialize(OcclusionBufferWidth, OcclusionBufferHeight, 1) && threadedCuller.Initialize(OcclusionBufferWidth, OcclusionBufferHeight, iThreadCount),
+		"the occlusion cullers initialize"))
+	{
+		return Benchmark::GetExitCode();
+	}
+
+	int iKeyCount = sizeof(Path) / sizeof(Path[0]);
+	int iFrameCount = (iKeyCount - 1) * iFramesPerKey;
+	long long llInViewTriangles = 0, llVisibleTriangles = 0;
+	long long llSubmittedTriangles = 0, llRasterizedTriangles = 0;
+	long long llCheckedCount = 0, llCheckedHiddenCount = 0;
+	int iWronglyHiddenCount = 0;
+	double dRenderTime = 0.0;
+	double dThreadedRenderTime = 0.0;
+	double dTestTime = 0.0;
+	long long llThreadedMismatchCount = 0;
+	std::vector<std::vector<bool>> visible(7);
+	for (int iFrame = 0; iFrame < iFrameCount; iFrame++)
+	{
+		const PathKey& key = Path[iFrame / iFramesPerKey];
+		const PathKey& nextKey = Path[iFrame / iFramesPerKey + 1];
+		float fT = (iFrame % iFramesPerKey) / (float)iFramesPerKey;
+		XMFLOAT3 position;
+		XMStoreFloat3(&position, XMVectorLerp(XMLoadFloat3(&key.position), XMLoadFloat3(&nextKey.position), fT));
+		Camera camera(position, 16.0f / 9.0f);
+		camera.Rotate(key.fYaw + (nextKey.fYaw - key.fYaw) * fT, key.fPitch + (nextKey.fPitch - key.fPitch) * fT - 20.0f); // The camera starts pitched down 20 degrees
+		camera.Update();
+		XMMATRIX viewProjectionMatrix = camera.GetViewMatrix() * camera.GetProjectionMatrix();
+
+		// The occluders, then every instance's bounds
+		auto start = Benchmark::Clock::now();
+		llSubmittedTriangles += RenderOccluders(culler, meshes, 7, viewProjectionMatrix);
+		dRenderTime += Benchmark::GetMilliseconds(start);
+		llRasterizedTriangles += culler.GetRasterizedTriangleCount();
+		start = Benchmark::Clock::now();
+		RenderOccluders(threadedCuller, meshes, 7, viewProjectionMatrix);
+		dThreadedRenderTime += Benchmark::GetMilliseconds(start);
+
+		// The occluders too, to see how much they hide of each other
+		start = Benchmark::Clock::now();
+		for (int i = 0; i < 7; i++)
+		{
+			visible[i].resize(meshes[i].worldMatrices.size());
+			for (size_t j = 0; j < meshes[i].worldMatrices.size(); j++)
+			{
+				visible[i][j] = culler.IsVisible(meshes[i].minimum, meshes[i].maximum, meshes[i].worldMatrices[j]);
+			}
+		}
+		dTestTime += Benchmark::GetMilliseconds(start);
+
+		// Each thread rasterizes its own rows of tiles, in the same order, so the split can't change what is hidden
+		for (int i = 0; i < 7; i++)
+		{
+			for (size_t j = 0; j < meshes[i].worldMatrices.size(); j++)
+			{
+				llThreadedMismatchCount += (threadedCuller.IsVisible(meshes[i].minimum, meshes[i].maximum, meshes[i].worldMatrices[j]) != visible[i][j]) ? 1 : 0;
+			}
+		}
+
+		for (int i = 0; i < 7; i++)
+		{
+			Mesh& mesh = meshes[i];
+			for (size_t j = 0; j < mesh.worldMatrices.size(); j++)
+			{
+				if (culler.IsInView(mesh.minimum, mesh.maximum, mesh.worldMatrices[j]))
+				{
+					mesh.llInViewCount++;
+					llInViewTriangles += mesh.lods[0].uiIndexCount / 3;
+					if (visible[i][j])
+					{
+						mesh.llVisibleCount++;
+						llVisibleTriangles += mesh.lods[0].uiIndexCount / 3;
+					}
+				}
+			}
+		}
+
+		// Any pixel of a hidden instance nearer than the occluders at full detail means it was wrongly hidden
+		if (iFrame % CheckInterval == 0)
+		{
+			ReferenceBuffer reference;
+			for (const Mesh& mesh : meshes)
+			{
+				for (size_t j = 0; j < mesh.worldMatrices.size() && mesh.bOccluder; j++)
+				{
+					reference.Rasterize(mesh, mesh.worldMatrices[j] * viewProjectionMatrix, [&reference](int iPixel, float fDepth)
+					{
+						reference.depths[iPixel] = (std::min)(reference.depths[iPixel], fDepth);
+					});
+				}
+			}
+			for (int i = 0; i < 7; i++)
+			{
+				const Mesh& mesh = meshes[i];
+				for (size_t j = 0; j < mesh.worldMatrices.size(); j++)
+				{
+					if (!culler.IsInView(mesh.minimum, mesh.maximum, mesh.worldMatrices[j]))
+					{
+						continue;
+					}
+					llCheckedCount++;
+					if (visible[i][j])
+					{
+						continue;
+					}
+					llCheckedHiddenCount++;
+
+					long long llShownPixels = 0;
+					reference.Rasterize(mesh, mesh.worldMatrices[j] * viewProjectionMatrix, [&reference, &llShownPixels](int iPixel, float fDepth)
+					{
+						llShownPixels += (fDepth < reference.depths[iPixel] - 1e-6f) ? 1 : 0;
+					});
+					if (llShownPixels > 0)
+					{
+						iWronglyHiddenCount++;
+						printf("Frame %d: %s instance %d hidden, but %lld pixels are in front of the occluders\n", iFrame, mesh.filename, (int)j, llShownPixels);
+					}
+				}
+			}
+		}
+	}
+
+	long long llInViewCount = 0, llVisibleCount = 0;
+	for (const Mesh& mesh : meshes)
+	{
+		llInViewCount += mesh.llInViewCount;
+		llVisibleCount += mesh.llVisibleCount;
+	}
+	printf("%d frames at %dx%d: %.1f instances in view, %.1f left visible (%.1f%% occluded)\n", iFrameCount, culler.GetWidth(), culler.GetHeight(),
+		(double)llInViewCount / iFrameCount, (double)llVisibleCount / iFrameCount, 100.0 * (llInViewCount - llVisibleCount) / (std::max)(llInViewCount, 1LL));
+	for (const Mesh& mesh : meshes)
+	{
+		printf("  %s%s: %.2f in view, %.2f visible\n", mesh.filename, mesh.bOccluder ? " (occluder)" : "", (double)mesh.llInViewCount / iFrameCount, (double)mesh.llVisibleCount / iFrameCount);
+	}
+	printf("Per frame: %lld full detail triangles in view, %lld left visible (%.1f%% occluded)\n", llInViewTriangles / iFrameCount, llVisibleTriangles / iFrameCount,
+		100.0 * (llInViewTriangles - llVisibleTriangles) / (std::max)(llInViewTriangles, 1LL));
+	printf("Per frame: %lld occluder triangles submitted, %lld rasterized; rendered in %.3f ms on one thread and %.3f ms on %d, instances tested in %.3f ms\n",
+		llSubmittedTriangles / iFrameCount, llRasterizedTriangles / iFrameCount, dRenderTime / iFrameCount, dThreadedRenderTime / iFrameCount, iThreadCount, dTestTime / iFrameCount);
+	Benchmark::Check(llThreadedMismatchCount == 0, std::to_string(iThreadCount) + " threads hide the same instances as one");
+	printf("Against the %dx%d reference: %lld instances checked, %lld hidden, %d wrongly\n", ReferenceWidth, ReferenceHeight, llCheckedCount, llCheckedHiddenCount, iWronglyHiddenCount);
+	Benchmark::Check(iWronglyHiddenCount == 0, "no hidden instance has a pixel in front of the occluders at full detail");
+
+	return Benchmark::GetExitCode();
+}
@@ -0,0 +1,154 @@
+//
+// SkyDomeBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Colour error of the generated sky dome at each quality level: random view rays are cast against the hemisphere, and the
+// pixel shader's gradient at the hit is compared with the gradient on a perfect sphere of the same radius
+// Checks the error, the vertex and index counts, that every index is in range, and that the mesh is closed with a consistent winding
+//
+// Usage: SkyDomeBenchmark [rays] (400 by default)
+//
+
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+#include "Benchmark.h"
+#include "SkyDome.h"
+
+namespace
+{
+	const float Radius = 2.0f; // SkyDome's, which the gradient is tuned for
+
+	// The scene's colours (set by ResourceManager), blended as SkyDomePixelShader.hlsl does, in 0-255 units
+	XMFLOAT3 GetGradientColor(float fHeight)
+	{
+		const XMFLOAT3 top(255.0f, 204.0f, 248.0f);
+		const XMFLOAT3 center(200.0f, 180.0f, 180.0f);
+		const XMFLOAT3 bottom(255.0f, 193.0f, 127.0f);
+
+		float fT = (std::max)(fHeight, 0.0f);
+		XMVECTOR vColor = XMVectorLerp(XMLoadFloat3(&bottom), XMLoadFloat3(&center), fT);
+		vColor = XMVectorLerp(vColor, XMLoadFloat3(&top), fT / 2.0f);
+
+		XMFLOAT3 color;
+		XMStoreFloat3(&color, vColor);
+		return color;
+	}
+
+	// Distance along the ray from the center to the nearest triangle it hits (Moller-Trumbore), or zero if it misses them all
+	float CastRay(const XMFLOAT3& direction, const std::vector<SkyDomeVertex>& vertices, const std::vector<unsigned long>& indices)
+	{
+		XMVECTOR vDirection = XMLoadFloat3(&direction);
+		float fNearest = 0.0f;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			XMVECTOR vA = XMLoadFloat3(&vertices[indices[i]].position);
+			XMVECTOR vEdge1 = XMLoadFloat3(&vertices[indices[i + 1]].position) - vA;
+			XMVECTOR vEdge2 = XMLoadFloat3(&vertices[indices[i + 2]].position) - vA;
+			XMVECTOR vP = XMVector3Cross(vDirection, vEdge2);
+			float fDeterminant = XMVectorGetX(XMVector3Dot(vEdge1, vP));
+			if (fabsf(fDeterminant) < 1e-12f)
+			{
+				continue;
+			}
+
+			XMVECTOR vS = -vA;
+			float fU = XMVectorGetX(XMVector3Dot(vS, vP)) / fDeterminant;
+			XMVECTOR vQ = XMVector3Cross(vS, vEdge1);
+			float fV = XMVectorGetX(XMVector3Dot(vDirection, vQ)) / fDeterminant;
+			float fDistance = XMVectorGetX(XMVector3Dot(vEdge2, vQ)) / fDeterminant;
+			if (fU >= -1e-6f && fV >= -1e-6f && fU + fV <= 1.0f + 1e-6f && fDistance > 0.0f && (fNearest == 0.0f || fDistance < fNearest))
+			{
+				fNearest = fDistance;
+			}
+		}
+
+		return fNearest;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int iRayCount = Benchmark::GetArgument(argc, argv, 1, 400);
+
+	std::mt19937 generator(1);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	std::vector<XMFLOAT3> directions(iRayCount);
+	for (auto& direction : directions)
+	{
+		// Uniform over the sphere
+		float fY = distribution(generator);
+		float fAzimuth = XM_PI * distribution(generator);
+		float fRing = sqrtf(1.0f - fY * fY);
+		direction = XMFLOAT3(fRing * cosf(fAzimuth), fY, fRing * sinf(fAzimuth));
+	}
+
+	const char* qualityNames[] = { "Low", "Medium", "High" };
+	const int expectedVertexCounts[] = { 50, 98, 194 };
+	const float maxErrors[] = { 3.5f, 2.0f, 1.0f }; // Of 255; the flat triangles sag most midway between the rings
+	for (int iQuality = LowQuality; iQuality <= HighQuality; iQuality++)
+	{
+		std::vector<SkyDomeVertex> vertices;
+		std::vector<unsigned long> indices;
+		auto start = Benchmark::Clock::now();
+		SkyDome::GenerateHemisphere((QualityLevel)iQuality, Radius, vertices, indices);
+		double dMilliseconds = Benchmark::GetMilliseconds(start);
+
+		Benchmark::Check((int)vertices.size() == expectedVertexCounts[iQuality], std::string(qualityNames[iQuality]) + " vertex count");
+		bool bInRange = true;
+		for (unsigned long ulIndex : indices)
+		{
+			bInRange &= ulIndex < vertices.size();
+		}
+		if (!Benchmark::Check(bInRange && indices.size() % 3 == 0, std::string(qualityNames[iQuality]) + " indices are in range"))
+		{
+			continue;
+		}
+
+		// Closed and consistently wound: every edge is used once in each direction
+		std::map<std::pair<unsigned long, unsigned long>, int> edges;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				edges[std::make_pair(indices[i + j], indices[i + (j + 1) % 3])]++;
+			}
+		}
+		bool bClosed = true;
+		for (const auto& edge : edges)
+		{
+			auto reverse = edges.find(std::make_pair(edge.first.second, edge.first.first));
+			bClosed &= edge.second == 1 && reverse != edges.end() && reverse->second == 1;
+		}
+		Benchmark::Check(bClosed, std::string(qualityNames[iQuality]) + " mesh is closed and consistently wound");
+
+		float fMaxError = 0.0f;
+		double dTotalError = 0.0;
+		int iMissCount = 0;
+		for (const auto& direction : directions)
+		{
+			float fDistance = CastRay(direction, vertices, indices);
+			if (fDistance == 0.0f)
+			{
+				iMissCount++;
+				continue;
+			}
+
+			XMFLOAT3 color = GetGradientColor(fDistance * direction.y);
+			XMFLOAT3 exactColor = GetGradientColor(Radius * direction.y);
+			float fError = (std::max)(fabsf(color.x - exactColor.x), (std::max)(fabsf(color.y - exactColor.y), fabsf(color.z - exactColor.z)));
+			fMaxError = (std::max)(fMaxError, fError);
+			dTotalError += fError;
+		}
+		Benchmark::Check(iMissCount == 0, std::string(qualityNames[iQuality]) + " every ray hits the dome");
+		Benchmark::Check(fMaxError <= maxErrors[iQuality], std::string(qualityNames[iQuality]) + " colour error");
+
+		printf("%s: %d vertices, %d indices, generated in %.3f ms; colour error against a sphere over %d rays: max %.2f, mean %.3f (of 255)\n",
+			qualityNames[iQuality], (int)vertices.size(), (int)indices.size(), dMilliseconds, iRayCount, fMaxError, dTotalError / iRayCount);
+	}
+
+	return Benchmark::GetExitCode();
+}
@@ -0,0 +1,233 @@
+//
+// TerrainQuadtreeBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Size of the shared index patterns, the time to generate a chunk on one thread, and the time to load the chunks wanted at the scene's
+// start camera; then, on a flight out of the garden and over the hills with one worker, the time each frame to update and to select the
+// chunks, the draws and triangles selected, the most chunks missing and the most memory held
+// Checks that every index pattern covers its square once, facing up, with only long edges where it is stitched, and, at the start and
+// every 150 frames of the flight, that the selected chunks leave no open edge inside the terrain
+//
+// Usage: TerrainQuadtreeBenchmark [frames] [milliseconds between frames] (1200 and 2 by default)
+// The pause between frames stands in for rendering, while the worker generates the chunks requested
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <map>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "Benchmark.h"
+#include "TerrainQuadtree.h"
+
+namespace
+{
+	const int ChunkCapacity = 512; // ResourceManager's
+	const int GenerateCount = 400;
+	const int CheckInterval = 150; // Frames between the checks for open edges
+
+	// ResourceManager's terrain, around its garden
+	TerrainSettings GetSettings()
+	{
+		TerrainSettings settings = {};
+		settings.fSize = 2048.0f;
+		settings.iLevelCount = 8;
+		settings.fHeightScale = 60.0f;
+		settings.fFeatureSize = 300.0f;
+		settings.flatMinimum = XMFLOAT2(-14.0f - 4.0f, -19.0f - 4.0f);
+		settings.flatMaximum = XMFLOAT2(14.0f + 4.0f, 9.0f + 4.0f);
+		settings.fFlatMargin = 40.0f;
+		settings.fLodRange = 2.0f;
+		settings.fTextureScale = 1.0f / 28.0f;
+		settings.uiSeed = 1;
+		return settings;
+	}
+
+	// Every triangle clockwise seen from above, covering the chunk's area once, and every edge left open on a stitched side two quads long
+	bool IsPatternValid(const std::vector<unsigned short>& indices, int iFirstIndex, int iEndIndex, int iStitchedEdges)
+	{
+		const int Width = TerrainQuadtree::ChunkQuads + 1;
+		double dArea = 0.0;
+		std::map<std::pair<int, int>, int> edges;
+		for (int i = iFirstIndex; i < iEndIndex; i += 3)
+		{
+			int x[3], z[3];
+			for (int j = 0; j < 3; j++)
+			{
+				x[j] = indices[i + j] % Width;
+				z[j] = indices[i + j] / Width;
+				int iA = indices[i + j];
+				int iB = indices[i + (j + 1) % 3];
+				edges[std::make_pair((std::min)(iA, iB), (std::max)(iA, iB))]++;
+			}
+
+			int iCross = (z[1] - z[0]) * (x[2] - x[0]) - (x[1] - x[0]) * (z[2] - z[0]);
+			if (iCross <= 0)
+			{
+				return false;
+			}
+			dArea += iCross * 0.5;
+		}
+
+		for (const auto& edge : edges)
+		{
+			int iA = edge.first.first;
+			int iB = edge.first.second;
+			bool bOnStitchedSide = ((iStitchedEdges & 1) && iA % Width == 0 && iB % Width == 0) || ((iStitchedEdges & 2) && iA % Width == Width - 1 && iB % Width == Width - 1) ||
+				((iStitchedEdges & 4) && iA / Width == 0 && iB / Width == 0) || ((iStitchedEdges & 8) && iA / Width == Width - 1 && iB / Width == Width - 1);
+			int iLength = abs(iA % Width - iB % Width) + abs(iA / Width - iB / Width);
+			if (edge.second == 1 && bOnStitchedSide && iLength != 2)
+			{
+				return false;
+			}
+		}
+
+		return dArea == TerrainQuadtree::ChunkQuads * TerrainQuadtree::ChunkQuads;
+	}
+
+	// Edges of the selected chunks' triangles, in world space, that only one triangle has, other than along the terrain's border
+	int CountOpenEdges(TerrainQuadtree& quadtree, const XMFLOAT3& cameraPosition, const std::vector<unsigned short>& indices, const std::vector<int>& firstIndices, float fHalfSize)
+	{
+		// Everything projects to the centre of the view, so nothing is culled
+		XMMATRIX viewProjectionMatrix = XMMatrixSet(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+		quadtree.Select(viewProjectionMatrix, cameraPosition);
+
+		typedef std::tuple<float, float, float, float, float, float> Edge;
+		std::map<Edge, int> edges;
+		std::vector<Vertex> vertices;
+		for (const TerrainDraw& draw : quadtree.GetDraws())
+		{
+			const TerrainChunk& chunk = quadtree.GetChunk(draw.iChunk);
+			float fMinHeight, fMaxHeight;
+			quadtree.GenerateChunk(chunk.iLevel, chunk.iX, chunk.iZ, vertices, &fMinHeight, &fMaxHeight);
+			for (int i = firstIndices[draw.iStitchedEdges]; i < firstIndices[draw.iStitchedEdges + 1]; i += 3)
+			{
+				for (int j = 0; j < 3; j++)
+				{
+					XMFLOAT3 a = vertices[indices[i + j]].position;
+					XMFLOAT3 b = vertices[indices[i + (j + 1) % 3]].position;
+					if (std::tie(a.x, a.z) > std::tie(b.x, b.z))
+					{
+						std::swap(a, b);
+					}
+					edges[Edge(a.x, a.y, a.z, b.x, b.y, b.z)]++;
+				}
+			}
+		}
+
+		int iOpenCount = 0;
+		for (const auto& edge : edges)
+		{
+			float fAX = std::get<0>(edge.first), fAZ = std::get<2>(edge.first);
+			float fBX = std::get<3>(edge.first), fBZ = std::get<5>(edge.first);
+			bool bOnBorder = (fAX == fBX && fabsf(fAX) == fHalfSize) || (fAZ == fBZ && fabsf(fAZ) == fHalfSize);
+			iOpenCount += (edge.second != 2 && !bOnBorder) ? 1 : 0;
+		}
+
+		return iOpenCount;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int iFrameCount = (std::max)(Benchmark::GetArgument(argc, argv, 1, 1200), 1);
+	int iPauseMilliseconds = (std::max)(Benchmark::GetArgument(argc, argv, 2, 2), 0);
+	TerrainSettings settings = GetSettings();
+
+	std::vector<unsigned short> indices;
+	std::vector<int> firstIndices;
+	TerrainQuadtree::BuildIndexPatterns(indices, firstIndices);
+	bool bPatternsValid = (int)firstIndices.size() == TerrainQuadtree::PatternCount + 1;
+	for (int i = 0; i < TerrainQuadtree::PatternCount && bPatternsValid; i++)
+	{
+		bPatternsValid &= IsPatternValid(indices, firstIndices[i], firstIndices[i + 1], i);
+	}
+	printf("Index patterns: %d indices (%.0f KB); %d triangles unstitched, %d stitched on every side\n", (int)indices.size(), indices.size() * sizeof(unsigned short) / 1024.0,
+		(firstIndices[1] - firstIndices[0]) / 3, (firstIndices[TerrainQuadtree::PatternCount] - firstIndices[TerrainQuadtree::PatternCount - 1]) / 3);
+	if (!Benchmark::Check(bPatternsValid, "every index pattern covers its chunk once, facing up, stitched only with long edges"))
+	{
+		return Benchmark::GetExitCode();
+	}
+
+	// Chunks of the finest level, spread over the terrain
+	{
+		TerrainQuadtree quadtree;
+		quadtree.Initialize(settings, 64);
+		std::vector<Vertex> vertices;
+		float fMinHeight, fMaxHeight;
+		int iLevelWidth = 1 << (settings.iLevelCount - 1);
+		auto start = Benchmark::Clock::now();
+		for (int i = 0; i < GenerateCount; i++)
+		{
+			quadtree.GenerateChunk(settings.iLevelCount - 1, (i * 37) % iLevelWidth, (i * 11) % iLevelWidth, vertices, &fMinHeight, &fMaxHeight);
+		}
+		double dMilliseconds = Benchmark::GetMilliseconds(start);
+		printf("Generated on one thread: %.3f ms per chunk (%.0f chunks and %.1f million vertices a second)\n", dMilliseconds / GenerateCount, GenerateCount * 1000.0 / dMilliseconds,
+			(double)GenerateCount * TerrainQuadtree::ChunkVertices / dMilliseconds / 1000.0);
+	}
+
+	TerrainQuadtree quadtree;
+	if (!Benchmark::Check(quadtree.Initialize(settings, ChunkCapacity), "the quadtree initializes"))
+	{
+		return Benchmark::GetExitCode();
+	}
+	XMFLOAT3 startPosition(0.0f, 8.0f, -22.0f); // GraphicsEngine's start
+	auto start = Benchmark::Clock::now();
+	quadtree.Load(startPosition);
+	double dLoadTime = Benchmark::GetMilliseconds(start);
+	printf("Loaded %d chunks in %.1f ms; %.1f MB before uploading\n", quadtree.GetResidentChunkCount(), dLoadTime, quadtree.GetMemoryUsage() / 1048576.0);
+	quadtree.ClearUploads();
+	int iOpenCount = CountOpenEdges(quadtree, startPosition, indices, firstIndices, settings.fSize * 0.5f);
+	printf("At the start: %d draws, %d open edges\n", (int)quadtree.GetDraws().size(), iOpenCount);
+
+	// Out of the garden, climbing and weaving over the hills, looking around as it goes
+	XMMATRIX projectionMatrix = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 1000.0f);
+	double dUpdateTime = 0.0, dSelectTime = 0.0, dWorstTime = 0.0;
+	long long llDrawCount = 0, llTriangleCount = 0;
+	int iMostMissing = 0;
+	size_t peakMemory = 0;
+	for (int iFrame = 0; iFrame < iFrameCount; iFrame++)
+	{
+		float fT = iFrame / (float)iFrameCount;
+		XMFLOAT3 position(sinf(fT * 3.0f) * 500.0f * fT, 8.0f + fT * 120.0f, -22.0f + fT * 700.0f);
+		position.y = (std::max)(position.y, quadtree.GetHeight(position.x, position.z) + 2.0f);
+		XMMATRIX viewMatrix = XMMatrixLookAtLH(XMVectorSet(position.x, position.y, position.z, 1.0f),
+			XMVectorSet(position.x + cosf(fT * 9.0f), position.y - 0.3f, position.z + sinf(fT * 9.0f), 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+		start = Benchmark::Clock::now();
+		int iMissing = quadtree.Update(position);
+		double dUpdate = Benchmark::GetMilliseconds(start);
+		quadtree.ClearUploads();
+		start = Benchmark::Clock::now();
+		quadtree.Select(viewMatrix * projectionMatrix, position);
+		double dSelect = Benchmark::GetMilliseconds(start);
+
+		dUpdateTime += dUpdate;
+		dSelectTime += dSelect;
+		dWorstTime = (std::max)(dWorstTime, dUpdate + dSelect);
+		llDrawCount += quadtree.GetDraws().size();
+		for (const TerrainDraw& draw : quadtree.GetDraws())
+		{
+			llTriangleCount += (firstIndices[draw.iStitchedEdges + 1] - firstIndices[draw.iStitchedEdges]) / 3;
+		}
+		iMostMissing = (std::max)(iMostMissing, iMissing);
+		peakMemory = (std::max)(peakMemory, quadtree.GetMemoryUsage());
+
+		if (iFrame % CheckInterval == 0)
+		{
+			int iFrameOpenCount = CountOpenEdges(quadtree, position, indices, firstIndices, settings.fSize * 0.5f);
+			printf("  Frame %d at (%.0f, %.0f, %.0f): %d missing, %d resident, %d open edges\n", iFrame, position.x, position.y, position.z, iMissing, quadtree.GetResidentChunkCount(), iFrameOpenCount);
+			iOpenCount += iFrameOpenCount;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(iPauseMilliseconds));
+	}
+	printf("Per frame of %d: update %.3f ms, select %.3f ms (worst frame %.3f ms), %.0f draws, %.0f triangles; at most %d chunks missing and %.2f MB held\n", iFrameCount,
+		dUpdateTime / iFrameCount, dSelectTime / iFrameCount, dWorstTime, (double)llDrawCount / iFrameCount, (double)llTriangleCount / iFrameCount, iMostMissing, peakMemory / 1048576.0);
+	Benchmark::Check(iOpenCount == 0, "the selected chunks leave no open edge inside the terrain");
+
+	return Benchmark::GetExitCode();
+}
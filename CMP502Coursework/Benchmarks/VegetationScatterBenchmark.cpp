@@ -0,0 +1,215 @@
+//
+// VegetationScatterBenchmark.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Time and memory to scatter square worlds of about one and ten million instances over a painted density map, at 0.25 unit spacing; then,
+// streaming a 60 unit radius on a fly-through across each, the time each frame to update the chunks, cull them and expand the instances in
+// view, and the most kept resident
+// Checks that no two instances are closer than the spacing across chunk borders, and that loading gives the same chunks and instances as updating
+//
+// Usage: VegetationScatterBenchmark [frames] [instances]... (600 frames over 1000000 and 10000000 instances by default)
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "Benchmark.h"
+#include "VegetationScatter.h"
+
+namespace
+{
+	const float Spacing = 0.25f;
+	const float StreamRadius = 60.0f;
+	const int MaxDrawnInstances = 4096;
+
+	ScatterSettings GetSettings(const XMMATRIX& modelMatrix, unsigned int uiSeed)
+	{
+		ScatterSettings settings = {};
+		settings.fMinDistance = Spacing;
+		settings.fMinScale = 0.8f;
+		settings.fMaxScale = 1.2f;
+		XMStoreFloat4x4(&settings.modelMatrix, modelMatrix);
+		settings.uiSeed = uiSeed;
+		return settings;
+	}
+
+	// Closest pair of instances in the 3x3 chunks from (2, 2), which have borders inside the world on every side
+	float GetClosestDistance(VegetationScatter& scatter, int& iCount)
+	{
+		std::vector<int> chunks;
+		scatter.GetResidentChunks(chunks);
+		std::vector<XMFLOAT2> positions;
+		for (int iChunk : chunks)
+		{
+			const ScatterChunk& chunk = scatter.GetChunk(iChunk);
+			if (chunk.iX < 2 || chunk.iX > 4 || chunk.iZ < 2 || chunk.iZ > 4)
+			{
+				continue;
+			}
+			for (const ScatterInstance& instance : chunk.instances)
+			{
+				positions.push_back(XMFLOAT2((chunk.iX + instance.usX / 65535.0f) * VegetationScatter::GetChunkSize(), (chunk.iZ + instance.usZ / 65535.0f) * VegetationScatter::GetChunkSize()));
+			}
+		}
+
+		float fClosest = FLT_MAX;
+		for (size_t i = 0; i < positions.size(); i++)
+		{
+			for (size_t j = i + 1; j < positions.size(); j++)
+			{
+				float fX = positions[i].x - positions[j].x;
+				float fZ = positions[i].y - positions[j].y;
+				fClosest = (std::min)(fClosest, fX * fX + fZ * fZ);
+			}
+		}
+		iCount = (int)positions.size();
+		return sqrtf(fClosest);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int iFrameCount = (std::max)(Benchmark::GetArgument(argc, argv, 1, 600), 1);
+	std::vector<int> targetCounts;
+	for (int i = 2; i < argc; i++)
+	{
+		targetCounts.push_back((std::max)(atoi(argv[i]), 10000));
+	}
+	if (targetCounts.empty())
+	{
+		targetCounts = { 1000000, 10000000 };
+	}
+
+	// Points of the pattern per unit of area, from a chunk painted fully dense
+	float fPatternDensity = 0.0f;
+	{
+		DensityMap densityMap;
+		densityMap.Initialize(0.0f, 0.0f, VegetationScatter::GetChunkSize(), VegetationScatter::GetChunkSize(), 2, 2);
+		VegetationScatter scatter;
+		scatter.Initialize(GetSettings(XMMatrixIdentity(), 7), densityMap, 1.0f);
+		fPatternDensity = scatter.GetPatternSize() / (VegetationScatter::GetChunkSize() * VegetationScatter::GetChunkSize());
+		printf("Pattern of %d points per chunk (%.2f per square unit, %.3f per spacing squared)\n", scatter.GetPatternSize(), fPatternDensity, fPatternDensity * Spacing * Spacing);
+	}
+
+	for (int iTargetCount : targetCounts)
+	{
+		// A thin meadow over the whole world, with denser patches, sized so that about 62% of the pattern is kept
+		float fSide = sqrtf(iTargetCount / (fPatternDensity * 0.62f));
+		int iMapSize = (int)(fSide / 2.0f) + 2;
+		DensityMap densityMap;
+		densityMap.Initialize(0.0f, 0.0f, fSide, fSide, iMapSize, iMapSize);
+		densityMap.PaintDisc(fSide * 0.5f, fSide * 0.5f, fSide, 0.0f, 0.35f);
+		std::mt19937 generator(3);
+		std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+		for (int i = 0; i < (int)(fSide * fSide / 400.0f); i++)
+		{
+			float fX = distribution(generator) * fSide;
+			float fZ = distribution(generator) * fSide;
+			float fRadius = 3.0f + distribution(generator) * 12.0f;
+			densityMap.PaintDisc(fX, fZ, fRadius, 2.0f, 0.6f + 0.4f * distribution(generator));
+		}
+		ScatterSettings settings = GetSettings(XMMatrixScaling(0.017f, 0.017f, 0.017f), 1); // Lupines
+
+		VegetationScatter scatter;
+		auto start = Benchmark::Clock::now();
+		bool bInitialized = scatter.Initialize(settings, densityMap, fSide * 1.5f);
+		double dPatternTime = Benchmark::GetMilliseconds(start);
+		if (!Benchmark::Check(bInitialized, "the scatter initializes"))
+		{
+			continue;
+		}
+		XMFLOAT3 center(fSide * 0.5f, 0.0f, fSide * 0.5f);
+		start = Benchmark::Clock::now();
+		scatter.Load(center);
+		double dLoadTime = Benchmark::GetMilliseconds(start);
+
+		std::vector<int> chunks;
+		scatter.GetResidentChunks(chunks);
+		long long llInstanceCount = 0;
+		for (int iChunk : chunks)
+		{
+			llInstanceCount += scatter.GetChunk(iChunk).instances.size();
+		}
+		printf("World of %.0f x %.0f units: %d chunks, %lld instances; pattern made in %.1f ms, chunks in %.1f ms (%.1f ns per instance)\n", fSide, fSide, (int)chunks.size(),
+			llInstanceCount, dPatternTime, dLoadTime, dLoadTime * 1e6 / (std::max)(llInstanceCount, 1LL));
+		printf("%.1f MB resident (%.2f bytes per instance)\n", scatter.GetMemoryUsage() / 1048576.0, (double)scatter.GetMemoryUsage() / (std::max)(llInstanceCount, 1LL));
+
+		// Positions are 16 bit fractions of a chunk, so may round closer by a little
+		int iCheckedCount = 0;
+		float fClosest = GetClosestDistance(scatter, iCheckedCount);
+		printf("Closest pair of %d instances across 3x3 chunks: %.4f units (spacing %.4f)\n", iCheckedCount, fClosest, Spacing);
+		Benchmark::Check(fClosest >= Spacing - 2.0f * VegetationScatter::GetChunkSize() / 65535.0f, "no two instances are closer than the spacing, across chunk borders");
+
+		// Loading and updating a few chunks at a time must agree
+		{
+			VegetationScatter loaded;
+			VegetationScatter updated;
+			loaded.Initialize(settings, densityMap, 30.0f);
+			updated.Initialize(settings, densityMap, 30.0f);
+			loaded.Load(center);
+			while (updated.Update(center) > 0)
+			{
+			}
+
+			std::vector<int> loadedChunks;
+			std::vector<int> updatedChunks;
+			loaded.GetResidentChunks(loadedChunks);
+			updated.GetResidentChunks(updatedChunks);
+			std::vector<Instance> loadedInstances;
+			std::vector<Instance> updatedInstances;
+			loaded.GetInstances(loadedChunks, INT_MAX, loadedInstances);
+			updated.GetInstances(updatedChunks, INT_MAX, updatedInstances);
+			printf("Within 30 units: %d chunks and %d instances from Load\n", (int)loadedChunks.size(), (int)loadedInstances.size());
+			Benchmark::Check(loadedChunks == updatedChunks && loadedInstances.size() == updatedInstances.size() &&
+				memcmp(loadedInstances.data(), updatedInstances.data(), loadedInstances.size() * sizeof(Instance)) == 0 && loaded.Update(center) == 0,
+				"loading gives the same chunks and instances as updating");
+		}
+
+		// Flying across the world, turning as it goes
+		VegetationScatter streamed;
+		streamed.Initialize(settings, densityMap, StreamRadius);
+		streamed.SetInstanceRadius(0.5f);
+		XMMATRIX projectionMatrix = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 200.0f);
+		double dUpdateTime = 0.0, dCullTime = 0.0, dExpandTime = 0.0, dWorstTime = 0.0;
+		long long llDrawnCount = 0;
+		size_t peakMemory = 0;
+		std::vector<Instance> instances;
+		for (int iFrame = 0; iFrame < iFrameCount; iFrame++)
+		{
+			float fT = iFrame / (float)iFrameCount;
+			XMFLOAT3 position(fSide * (0.1f + 0.8f * fT), 2.0f, fSide * (0.5f + 0.2f * sinf(fT * 6.0f)));
+			XMMATRIX viewMatrix = XMMatrixLookAtLH(XMVectorSet(position.x, position.y, position.z, 1.0f),
+				XMVectorSet(position.x + cosf(fT * 20.0f), position.y - 0.2f, position.z + sinf(fT * 20.0f), 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+			start = Benchmark::Clock::now();
+			streamed.Update(position);
+			double dUpdate = Benchmark::GetMilliseconds(start);
+			start = Benchmark::Clock::now();
+			bool bChanged = streamed.CullChunks(viewMatrix * projectionMatrix, position);
+			double dCull = Benchmark::GetMilliseconds(start);
+			start = Benchmark::Clock::now();
+			if (bChanged)
+			{
+				streamed.GetInstances(streamed.GetVisibleChunks(), MaxDrawnInstances, instances);
+			}
+			double dExpand = Benchmark::GetMilliseconds(start);
+
+			dUpdateTime += dUpdate;
+			dCullTime += dCull;
+			dExpandTime += dExpand;
+			dWorstTime = (std::max)(dWorstTime, dUpdate + dCull + dExpand);
+			llDrawnCount += instances.size();
+			peakMemory = (std::max)(peakMemory, streamed.GetMemoryUsage());
+		}
+		printf("Streaming %.0f units over %d frames, per frame: update %.3f ms, cull %.3f ms, expand %.3f ms (worst frame %.2f ms); %.0f instances drawn, at most %.2f MB resident\n",
+			StreamRadius, iFrameCount, dUpdateTime / iFrameCount, dCullTime / iFrameCount, dExpandTime / iFrameCount, dWorstTime, (double)llDrawnCount / iFrameCount, peakMemory / 1048576.0);
+	}
+
+	return Benchmark::GetExitCode();
+}
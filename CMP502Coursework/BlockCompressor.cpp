@@ -0,0 +1,1119 @@
+//
+// BlockCompressor.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Texture Block Compression in Direct3D 11 (https://docs.microsoft.com/en-us/windows/desktop/direct3d11/texture-block-compression-in-direct3d-11)
+// BC7 Format Mode Reference (https://docs.microsoft.com/en-us/windows/desktop/direct3d11/bc7-format-mode-reference)
+// Real-Time DXT Compression (J.M.P. van Waveren, 2006)
+//
+
+#include "BlockCompressor.h"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const float BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 }; // 4-bit index interpolation weights (out of 64)
+	const float BC1_WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f }; // Weight of the first endpoint for each index
+
+	// Writes fields from the least significant bit up, as the block formats are defined
+	struct BitWriter
+	{
+		unsigned char* data;
+		int iPosition;
+
+		void Write(unsigned int uiValue, int iBitCount)
+		{
+			for (int i = 0; i < iBitCount; i++, iPosition++)
+			{
+				data[iPosition >> 3] |= ((uiValue >> i) & 1) << (iPosition & 7);
+			}
+		}
+	};
+
+	float GetSquaredDistance(FXMVECTOR vA, FXMVECTOR vB)
+	{
+		XMVECTOR vDifference = vA - vB;
+		return XMVectorGetX(XMVector4Dot(vDifference, vDifference));
+	}
+
+	// Largest eigenvector of the covariance of the texels (power iteration), with channels outside the mask ignored
+	XMVECTOR GetPrincipalAxis(const XMVECTOR* texels, FXMVECTOR vMean, FXMVECTOR vMask)
+	{
+		XMVECTOR vRows[4] = { XMVectorZero(), XMVectorZero(), XMVectorZero(), XMVectorZero() };
+		XMVECTOR vMin = texels[0];
+		XMVECTOR vMax = texels[0];
+		for (int i = 0; i < 16; i++)
+		{
+			XMVECTOR vDifference = (texels[i] - vMean) * vMask;
+			vRows[0] = XMVectorMultiplyAdd(vDifference, XMVectorSplatX(vDifference), vRows[0]);
+			vRows[1] = XMVectorMultiplyAdd(vDifference, XMVectorSplatY(vDifference), vRows[1]);
+			vRows[2] = XMVectorMultiplyAdd(vDifference, XMVectorSplatZ(vDifference), vRows[2]);
+			vRows[3] = XMVectorMultiplyAdd(vDifference, XMVectorSplatW(vDifference), vRows[3]);
+			vMin = XMVectorMin(vMin, texels[i]);
+			vMax = XMVectorMax(vMax, texels[i]);
+		}
+
+		// Start along the bounding box diagonal, which is usually close already
+		XMVECTOR vAxis = (vMax - vMin) * vMask;
+		if (XMVectorGetX(XMVector4Dot(vAxis, vAxis)) < 1e-6f)
+		{
+			return XMVectorZero();
+		}
+
+		for (int i = 0; i < 8; i++)
+		{
+			XMVECTOR vProduct = vRows[0] * XMVectorSplatX(vAxis) + vRows[1] * XMVectorSplatY(vAxis) + vRows[2] * XMVectorSplatZ(vAxis) + vRows[3] * XMVectorSplatW(vAxis);
+			if (XMVectorGetX(XMVector4Dot(vProduct, vProduct)) < 1e-12f)
+			{
+				break;
+			}
+			vAxis = XMVector4Normalize(vProduct);
+		}
+
+		return XMVector4Normalize(vAxis);
+	}
+
+	// Endpoints at the extremes of the texels projected on the principal axis, optionally inset by a sixteenth of the range
+	void GetAxisEndpoints(const XMVECTOR* texels, FXMVECTOR vMask, bool bInset, XMVECTOR& vEndpoint0, XMVECTOR& vEndpoint1)
+	{
+		XMVECTOR vMean = XMVectorZero();
+		for (int i = 0; i < 16; i++)
+		{
+			vMean += texels[i];
+		}
+		vMean *= 1.0f / 16.0f;
+
+		XMVECTOR vAxis = GetPrincipalAxis(texels, vMean, vMask);
+
+		float fMin = 0.0f;
+		float fMax = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = XMVectorGetX(XMVector4Dot((texels[i] - vMean) * vMask, vAxis));
+			fMin = (std::min)(fMin, t);
+			fMax = (std::max)(fMax, t);
+		}
+		if (bInset)
+		{
+			float fInset = (fMax - fMin) / 16.0f;
+			fMin += fInset;
+			fMax -= fInset;
+		}
+
+		XMVECTOR vLimit = XMVectorReplicate(255.0f);
+		vEndpoint0 = XMVectorClamp(vMean + vAxis * fMax, XMVectorZero(), vLimit);
+		vEndpoint1 = XMVectorClamp(vMean + vAxis * fMin, XMVectorZero(), vLimit);
+	}
+
+	// Least squares endpoints for fixed indices, where texel i is weights[i] * endpoint0 + (1 - weights[i]) * endpoint1
+	bool FitEndpoints(const XMVECTOR* texels, const float* weights, XMVECTOR& vEndpoint0, XMVECTOR& vEndpoint1)
+	{
+		float fAA = 0.0f, fAB = 0.0f, fBB = 0.0f;
+		XMVECTOR vAX = XMVectorZero();
+		XMVECTOR vBX = XMVectorZero();
+		for (int i = 0; i < 16; i++)
+		{
+			float a = weights[i];
+			float b = 1.0f - a;
+			fAA += a * a;
+			fAB += a * b;
+			fBB += b * b;
+			vAX = XMVectorMultiplyAdd(texels[i], XMVectorReplicate(a), vAX);
+			vBX = XMVectorMultiplyAdd(texels[i], XMVectorReplicate(b), vBX);
+		}
+
+		float fDeterminant = fAA * fBB - fAB * fAB;
+		if (fabsf(fDeterminant) < 1e-6f)
+		{
+			return false; // Every texel uses the same index
+		}
+
+		float fInverse = 1.0f / fDeterminant;
+		XMVECTOR vLimit = XMVectorReplicate(255.0f);
+		vEndpoint0 = XMVectorClamp((vAX * fBB - vBX * fAB) * fInverse, XMVectorZero(), vLimit);
+		vEndpoint1 = XMVectorClamp((vBX * fAA - vAX * fAB) * fInverse, XMVectorZero(), vLimit);
+		return true;
+	}
+
+	// BC1 endpoints are 5:6:5
+	unsigned short QuantizeTo565(FXMVECTOR vColor)
+	{
+		XMFLOAT4 color;
+		XMStoreFloat4(&color, vColor);
+		int r = (int)(color.x * 31.0f / 255.0f + 0.5f);
+		int g = (int)(color.y * 63.0f / 255.0f + 0.5f);
+		int b = (int)(color.z * 31.0f / 255.0f + 0.5f);
+		return (unsigned short)((r << 11) | (g << 5) | b);
+	}
+
+	XMVECTOR ExpandFrom565(unsigned short usColor)
+	{
+		int r = (usColor >> 11) & 31;
+		int g = (usColor >> 5) & 63;
+		int b = usColor & 31;
+		return XMVectorSet((float)((r << 3) | (r >> 2)), (float)((g << 2) | (g >> 4)), (float)((b << 3) | (b >> 2)), 255.0f);
+	}
+
+	// Picks the nearest of the four colors for each texel and returns the total squared error (color only)
+	float EvaluateBC1(const XMVECTOR* texels, unsigned short& usColor0, unsigned short& usColor1, int* indices)
+	{
+		// Four color mode needs the first endpoint to be the larger one
+		if (usColor0 < usColor1)
+		{
+			std::swap(usColor0, usColor1);
+		}
+
+		XMVECTOR vPalette[4];
+		vPalette[0] = ExpandFrom565(usColor0);
+		vPalette[1] = ExpandFrom565(usColor1);
+		vPalette[2] = (vPalette[0] * 2.0f + vPalette[1]) * (1.0f / 3.0f);
+		vPalette[3] = (vPalette[0] + vPalette[1] * 2.0f) * (1.0f / 3.0f);
+
+		XMVECTOR vColorMask = XMVectorSet(1.0f, 1.0f, 1.0f, 0.0f);
+		float fError = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			int iBest = 0;
+			float fBest = FLT_MAX;
+			for (int j = 0; j < ((usColor0 == usColor1) ? 1 : 4); j++)
+			{
+				float fDistance = GetSquaredDistance(texels[i] * vColorMask, vPalette[j] * vColorMask);
+				if (fDistance < fBest)
+				{
+					fBest = fDistance;
+					iBest = j;
+				}
+			}
+			indices[i] = iBest;
+			fError += fBest;
+		}
+
+		return fError;
+	}
+
+	// BC3 alpha palette; eight interpolated values when the first endpoint is larger, otherwise six plus 0 and 255
+	void GetAlphaPalette(int iAlpha0, int iAlpha1, float* palette)
+	{
+		palette[0] = (float)iAlpha0;
+		palette[1] = (float)iAlpha1;
+		if (iAlpha0 > iAlpha1)
+		{
+			for (int i = 1; i < 7; i++)
+			{
+				palette[i + 1] = (float)(((7 - i) * iAlpha0 + i * iAlpha1 + 3) / 7);
+			}
+		}
+		else
+		{
+			for (int i = 1; i < 5; i++)
+			{
+				palette[i + 1] = (float)(((5 - i) * iAlpha0 + i * iAlpha1 + 2) / 5);
+			}
+			palette[6] = 0.0f;
+			palette[7] = 255.0f;
+		}
+	}
+
+	float EvaluateAlpha(const float* alphas, int iAlpha0, int iAlpha1, int* indices)
+	{
+		float palette[8];
+		GetAlphaPalette(iAlpha0, iAlpha1, palette);
+
+		float fError = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			int iBest = 0;
+			float fBest = FLT_MAX;
+			for (int j = 0; j < 8; j++)
+			{
+				float fDistance = (alphas[i] - palette[j]) * (alphas[i] - palette[j]);
+				if (fDistance < fBest)
+				{
+					fBest = fDistance;
+					iBest = j;
+				}
+			}
+			indices[i] = iBest;
+			fError += fBest;
+		}
+
+		return fError;
+	}
+
+	// BC7 mode 6 endpoints are 7 bits per channel plus a p-bit shared by the four channels of each endpoint
+	XMVECTOR QuantizeBC7Endpoint(FXMVECTOR vEndpoint, int iPBit, int* quantized)
+	{
+		XMFLOAT4 endpoint;
+		XMStoreFloat4(&endpoint, vEndpoint);
+		float channels[4] = { endpoint.x, endpoint.y, endpoint.z, endpoint.w };
+		float values[4];
+		for (int i = 0; i < 4; i++)
+		{
+			int q = (int)((channels[i] - iPBit) * 0.5f + 0.5f);
+			quantized[i] = (std::min)((std::max)(q, 0), 127);
+			values[i] = (float)((quantized[i] << 1) | iPBit);
+		}
+		return XMVectorSet(values[0], values[1], values[2], values[3]);
+	}
+
+	float EvaluateBC7(const XMVECTOR* texels, FXMVECTOR vEndpoint0, FXMVECTOR vEndpoint1, int* indices)
+	{
+		// Interpolate exactly as the hardware does: ((64 - w) * e0 + w * e1 + 32) >> 6
+		XMVECTOR vPalette[16];
+		for (int j = 0; j < 16; j++)
+		{
+			XMVECTOR vValue = (vEndpoint0 * (64.0f - BC7_WEIGHTS[j]) + vEndpoint1 * BC7_WEIGHTS[j] + XMVectorReplicate(32.0f)) * (1.0f / 64.0f);
+			vPalette[j] = XMVectorFloor(vValue);
+		}
+
+		float fError = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			int iBest = 0;
+			float fBest = FLT_MAX;
+			for (int j = 0; j < 16; j++)
+			{
+				float fDistance = GetSquaredDistance(texels[i], vPalette[j]);
+				if (fDistance < fBest)
+				{
+					fBest = fDistance;
+					iBest = j;
+				}
+			}
+			indices[i] = iBest;
+			fError += fBest;
+		}
+
+		return fError;
+	}
+
+	// Reads fields from the least significant bit up
+	struct BitReader
+	{
+		unsigned long long ullLow;
+		unsigned long long ullHigh;
+		int iPosition;
+
+		BitReader(const unsigned char* data, int iStart)
+		{
+			ullLow = 0;
+			ullHigh = 0;
+			for (int i = 7; i >= 0; i--)
+			{
+				ullLow = (ullLow << 8) | data[i];
+				ullHigh = (ullHigh << 8) | data[i + 8];
+			}
+			iPosition = iStart;
+		}
+
+		unsigned int Read(int iBitCount)
+		{
+			unsigned long long ullBits;
+			if (iPosition >= 64)
+			{
+				ullBits = ullHigh >> (iPosition - 64);
+			}
+			else
+			{
+				ullBits = (ullLow >> iPosition) | ((iPosition > 0) ? ullHigh << (64 - iPosition) : 0);
+			}
+			iPosition += iBitCount;
+			return (unsigned int)(ullBits & ((1ull << iBitCount) - 1));
+		}
+	};
+
+	// BC7 subset of each texel; bit i is set when texel i is in the second subset
+	const unsigned short BC7_PARTITIONS_2[64] =
+	{
+		0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80, 0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+		0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce, 0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+		0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a, 0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+		0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c, 0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22
+	};
+
+	// Two bits per texel, texel 0 in the lowest bits
+	const unsigned int BC7_PARTITIONS_3[64] =
+	{
+		0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+		0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090, 0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+		0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+		0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+		0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424, 0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+		0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+		0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+		0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000, 0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254
+	};
+
+	// Anchor texels of the second and third subsets, whose indices are stored with one bit less (the first subset's anchor is always texel 0)
+	const unsigned char BC7_ANCHORS_2[64] =
+	{
+		15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+		15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+		15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+		6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15
+	};
+
+	const unsigned char BC7_ANCHORS_3_SECOND[64] =
+	{
+		3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+		3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+		8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+		3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3
+	};
+
+	const unsigned char BC7_ANCHORS_3_THIRD[64] =
+	{
+		15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+		15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+		15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+		15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8
+	};
+
+	// Interpolation weights (out of 64) for 2, 3 and 4-bit indices
+	const int BC7_WEIGHTS_2[4] = { 0, 21, 43, 64 };
+	const int BC7_WEIGHTS_3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	const int BC7_WEIGHTS_4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct BC7Mode
+	{
+		int iSubsets;
+		int iPartitionBits;
+		int iRotationBits;
+		int iIndexSelectionBits;
+		int iColorBits;
+		int iAlphaBits;
+		int iEndpointPBits;	// One p-bit per endpoint
+		int iSharedPBits;	// One p-bit per subset
+		int iIndexBits;
+		int iSecondaryIndexBits;
+	};
+
+	const BC7Mode BC7_MODES[8] =
+	{
+		{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+		{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+		{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+		{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+		{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+		{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+		{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+		{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+	};
+
+	const int* GetBC7Weights(int iIndexBits)
+	{
+		return (iIndexBits == 2) ? BC7_WEIGHTS_2 : (iIndexBits == 3) ? BC7_WEIGHTS_3 : BC7_WEIGHTS_4;
+	}
+
+	// Widens an endpoint channel to 8 bits by repeating its high bits below it
+	int ExpandBits(int iValue, int iBitCount)
+	{
+		iValue <<= 8 - iBitCount;
+		return iValue | (iValue >> iBitCount);
+	}
+}
+
+#pragma region Compress
+
+bool BlockCompressor::Compress(const unsigned char* pixels, int iWidth, int iHeight, TextureFormat format, QualityLevel quality, std::vector<unsigned char>& blocks, double* pSquaredError, int iThreadCount)
+{
+	if (pixels == nullptr || iWidth <= 0 || iHeight <= 0 || !CanCompress(format))
+	{
+		return false;
+	}
+
+	int iBlockSize = GetBlockSize(format);
+	int iBlocksWide = (iWidth + 3) / 4;
+	int iBlocksHigh = (iHeight + 3) / 4;
+	blocks.assign((size_t)iBlocksWide * iBlocksHigh * iBlockSize, 0);
+
+	// Each block row keeps its own error so that the threads never share a sum
+	std::vector<double> rowErrors(iBlocksHigh, 0.0);
+
+	Utils::ParallelFor(iBlocksHigh, iThreadCount, [&](int iBegin, int iEnd)
+	{
+		XMVECTOR texels[16];
+		XMVECTOR decoded[16];
+
+		for (int by = iBegin; by < iEnd; by++)
+		{
+			for (int bx = 0; bx < iBlocksWide; bx++)
+			{
+				// Gather the block, repeating the last row and column past the edges of the image
+				for (int i = 0; i < 16; i++)
+				{
+					int x = (std::min)(bx * 4 + (i & 3), iWidth - 1);
+					int y = (std::min)(by * 4 + (i >> 2), iHeight - 1);
+					const unsigned char* texel = &pixels[((size_t)y * iWidth + x) * 4];
+					texels[i] = XMVectorSet(texel[0], texel[1], texel[2], texel[3]);
+				}
+
+				unsigned char* output = &blocks[((size_t)by * iBlocksWide + bx) * iBlockSize];
+				switch (format)
+				{
+				case BC1Format:
+					EncodeBC1Block(texels, quality, output, decoded);
+					break;
+				case BC3Format:
+					EncodeBC1Block(texels, quality, output + 8, decoded);
+					EncodeBC3AlphaBlock(texels, quality, output, decoded);
+					break;
+				default:
+					EncodeBC7Block(texels, quality, output, decoded);
+					break;
+				}
+
+				for (int i = 0; i < 16; i++)
+				{
+					if (bx * 4 + (i & 3) < iWidth && by * 4 + (i >> 2) < iHeight)
+					{
+						rowErrors[by] += GetSquaredDistance(XMVectorRound(decoded[i]), texels[i]);
+					}
+				}
+			}
+		}
+	});
+
+	if (pSquaredError)
+	{
+		*pSquaredError = 0.0;
+		for (double dError : rowErrors)
+		{
+			*pSquaredError += dError;
+		}
+	}
+
+	return true;
+}
+
+void BlockCompressor::EncodeBC1Block(const XMVECTOR* texels, QualityLevel quality, unsigned char* output, XMVECTOR* decoded)
+{
+	XMVECTOR vColorMask = XMVectorSet(1.0f, 1.0f, 1.0f, 0.0f);
+
+	XMVECTOR vEndpoint0, vEndpoint1;
+	GetAxisEndpoints(texels, vColorMask, true, vEndpoint0, vEndpoint1);
+
+	unsigned short usColor0 = QuantizeTo565(vEndpoint0);
+	unsigned short usColor1 = QuantizeTo565(vEndpoint1);
+	int indices[16];
+	float fError = EvaluateBC1(texels, usColor0, usColor1, indices);
+
+	// Refit the endpoints to the chosen indices
+	int iRefinements = (quality == LowQuality) ? 0 : (quality == MediumQuality) ? 1 : 3;
+	for (int r = 0; r < iRefinements && fError > 0.0f; r++)
+	{
+		float weights[16];
+		for (int i = 0; i < 16; i++)
+		{
+			weights[i] = BC1_WEIGHTS[indices[i]];
+		}
+		if (!FitEndpoints(texels, weights, vEndpoint0, vEndpoint1))
+		{
+			break;
+		}
+
+		unsigned short usCandidate0 = QuantizeTo565(vEndpoint0);
+		unsigned short usCandidate1 = QuantizeTo565(vEndpoint1);
+		int candidateIndices[16];
+		float fCandidateError = EvaluateBC1(texels, usCandidate0, usCandidate1, candidateIndices);
+		if (fCandidateError >= fError)
+		{
+			break;
+		}
+
+		fError = fCandidateError;
+		usColor0 = usCandidate0;
+		usColor1 = usCandidate1;
+		memcpy(indices, candidateIndices, sizeof(indices));
+	}
+
+	// Nudge each endpoint channel by one step while that lowers the error
+	if (quality == HighQuality)
+	{
+		const unsigned short channelSteps[3] = { 1 << 11, 1 << 5, 1 };
+		const unsigned short channelMasks[3] = { 31 << 11, 63 << 5, 31 };
+		bool bImproved = true;
+		for (int iPass = 0; iPass < 4 && bImproved && fError > 0.0f; iPass++)
+		{
+			bImproved = false;
+			for (int e = 0; e < 2; e++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					for (int iDirection = -1; iDirection <= 1; iDirection += 2)
+					{
+						unsigned short usCandidate0 = usColor0;
+						unsigned short usCandidate1 = usColor1;
+						unsigned short& usEndpoint = (e == 0) ? usCandidate0 : usCandidate1;
+						int iChannel = (usEndpoint & channelMasks[c]) / channelSteps[c] + iDirection;
+						if (iChannel < 0 || iChannel > (int)(channelMasks[c] / channelSteps[c]))
+						{
+							continue;
+						}
+						usEndpoint = (unsigned short)((usEndpoint & ~channelMasks[c]) | (iChannel * channelSteps[c]));
+
+						int candidateIndices[16];
+						float fCandidateError = EvaluateBC1(texels, usCandidate0, usCandidate1, candidateIndices);
+						if (fCandidateError < fError)
+						{
+							fError = fCandidateError;
+							usColor0 = usCandidate0;
+							usColor1 = usCandidate1;
+							memcpy(indices, candidateIndices, sizeof(indices));
+							bImproved = true;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Two 16-bit endpoints followed by 2-bit indices
+	output[0] = (unsigned char)usColor0;
+	output[1] = (unsigned char)(usColor0 >> 8);
+	output[2] = (unsigned char)usColor1;
+	output[3] = (unsigned char)(usColor1 >> 8);
+	unsigned int uiIndices = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		uiIndices |= indices[i] << (i * 2);
+	}
+	output[4] = (unsigned char)uiIndices;
+	output[5] = (unsigned char)(uiIndices >> 8);
+	output[6] = (unsigned char)(uiIndices >> 16);
+	output[7] = (unsigned char)(uiIndices >> 24);
+
+	// BC1 is opaque (BC3 overwrites the alpha afterwards)
+	XMVECTOR vPalette[4];
+	vPalette[0] = ExpandFrom565(usColor0);
+	vPalette[1] = ExpandFrom565(usColor1);
+	vPalette[2] = (vPalette[0] * 2.0f + vPalette[1]) * (1.0f / 3.0f);
+	vPalette[3] = (vPalette[0] + vPalette[1] * 2.0f) * (1.0f / 3.0f);
+	for (int i = 0; i < 16; i++)
+	{
+		decoded[i] = XMVectorSetW(vPalette[indices[i]], 255.0f);
+	}
+}
+
+void BlockCompressor::EncodeBC3AlphaBlock(const XMVECTOR* texels, QualityLevel quality, unsigned char* output, XMVECTOR* decoded)
+{
+	float alphas[16];
+	int iMin = 255;
+	int iMax = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		alphas[i] = XMVectorGetW(texels[i]);
+		iMin = (std::min)(iMin, (int)alphas[i]);
+		iMax = (std::max)(iMax, (int)alphas[i]);
+	}
+
+	// Eight value mode across the full range
+	int iAlpha0 = iMax;
+	int iAlpha1 = iMin;
+	int indices[16];
+	float fError = EvaluateAlpha(alphas, iAlpha0, iAlpha1, indices);
+
+	if (quality != LowQuality && fError > 0.0f)
+	{
+		// Shrinking the range slightly often lowers the error of the interpolated values
+		int iSearch = (quality == HighQuality) ? 4 : 2;
+		for (int d0 = 0; d0 <= iSearch; d0++)
+		{
+			for (int d1 = 0; d1 <= iSearch; d1++)
+			{
+				int iCandidate0 = iMax - d0;
+				int iCandidate1 = iMin + d1;
+				if (iCandidate0 <= iCandidate1 || (d0 == 0 && d1 == 0))
+				{
+					continue;
+				}
+
+				int candidateIndices[16];
+				float fCandidateError = EvaluateAlpha(alphas, iCandidate0, iCandidate1, candidateIndices);
+				if (fCandidateError < fError)
+				{
+					fError = fCandidateError;
+					iAlpha0 = iCandidate0;
+					iAlpha1 = iCandidate1;
+					memcpy(indices, candidateIndices, sizeof(indices));
+				}
+			}
+		}
+
+		// Six value mode, with 0 and 255 exact, for blocks mixing fully transparent or opaque texels with partial ones
+		if (quality == HighQuality)
+		{
+			int iInnerMin = 255;
+			int iInnerMax = 0;
+			for (int i = 0; i < 16; i++)
+			{
+				if (alphas[i] > 0.0f && alphas[i] < 255.0f)
+				{
+					iInnerMin = (std::min)(iInnerMin, (int)alphas[i]);
+					iInnerMax = (std::max)(iInnerMax, (int)alphas[i]);
+				}
+			}
+			if (iInnerMin <= iInnerMax)
+			{
+				int candidateIndices[16];
+				float fCandidateError = EvaluateAlpha(alphas, iInnerMin, iInnerMax, candidateIndices);
+				if (fCandidateError < fError)
+				{
+					fError = fCandidateError;
+					iAlpha0 = iInnerMin;
+					iAlpha1 = iInnerMax;
+					memcpy(indices, candidateIndices, sizeof(indices));
+				}
+			}
+		}
+	}
+
+	// Two 8-bit endpoints followed by 3-bit indices
+	output[0] = (unsigned char)iAlpha0;
+	output[1] = (unsigned char)iAlpha1;
+	BitWriter writer = { output + 2, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		writer.Write(indices[i], 3);
+	}
+
+	float palette[8];
+	GetAlphaPalette(iAlpha0, iAlpha1, palette);
+	for (int i = 0; i < 16; i++)
+	{
+		decoded[i] = XMVectorSetW(decoded[i], palette[indices[i]]);
+	}
+}
+
+void BlockCompressor::EncodeBC7Block(const XMVECTOR* texels, QualityLevel quality, unsigned char* output, XMVECTOR* decoded)
+{
+	XMVECTOR vEndpoint0, vEndpoint1;
+	GetAxisEndpoints(texels, XMVectorReplicate(1.0f), quality == LowQuality, vEndpoint0, vEndpoint1);
+
+	// Choose the p-bits; HighQuality tries all four combinations against the block, otherwise each endpoint takes the one that quantizes it best
+	int quantized0[4], quantized1[4];
+	int iPBit0 = 0, iPBit1 = 0;
+	int indices[16];
+	float fError = FLT_MAX;
+
+	auto tryEndpoints = [&](FXMVECTOR vCandidate0, FXMVECTOR vCandidate1)
+	{
+		bool bImproved = false;
+		for (int p = 0; p < 4; p++)
+		{
+			int iCandidatePBit0 = p & 1;
+			int iCandidatePBit1 = p >> 1;
+			int candidateQuantized0[4], candidateQuantized1[4];
+			XMVECTOR vQuantized0 = QuantizeBC7Endpoint(vCandidate0, iCandidatePBit0, candidateQuantized0);
+			XMVECTOR vQuantized1 = QuantizeBC7Endpoint(vCandidate1, iCandidatePBit1, candidateQuantized1);
+
+			if (quality != HighQuality)
+			{
+				// Pick the p-bits per endpoint by quantization error alone
+				int unused[4];
+				XMVECTOR vOther0 = QuantizeBC7Endpoint(vCandidate0, 1 - iCandidatePBit0, unused);
+				XMVECTOR vOther1 = QuantizeBC7Endpoint(vCandidate1, 1 - iCandidatePBit1, unused);
+				if (GetSquaredDistance(vQuantized0, vCandidate0) > GetSquaredDistance(vOther0, vCandidate0) ||
+					GetSquaredDistance(vQuantized1, vCandidate1) > GetSquaredDistance(vOther1, vCandidate1))
+				{
+					continue;
+				}
+			}
+
+			int candidateIndices[16];
+			float fCandidateError = EvaluateBC7(texels, vQuantized0, vQuantized1, candidateIndices);
+			if (fCandidateError < fError)
+			{
+				fError = fCandidateError;
+				iPBit0 = iCandidatePBit0;
+				iPBit1 = iCandidatePBit1;
+				memcpy(quantized0, candidateQuantized0, sizeof(quantized0));
+				memcpy(quantized1, candidateQuantized1, sizeof(quantized1));
+				memcpy(indices, candidateIndices, sizeof(indices));
+				bImproved = true;
+			}
+		}
+		return bImproved;
+	};
+
+	tryEndpoints(vEndpoint0, vEndpoint1);
+
+	// Refit the endpoints to the chosen indices
+	int iRefinements = (quality == LowQuality) ? 0 : (quality == MediumQuality) ? 1 : 3;
+	for (int r = 0; r < iRefinements && fError > 0.0f; r++)
+	{
+		float weights[16];
+		for (int i = 0; i < 16; i++)
+		{
+			weights[i] = 1.0f - BC7_WEIGHTS[indices[i]] / 64.0f;
+		}
+		if (!FitEndpoints(texels, weights, vEndpoint0, vEndpoint1) || !tryEndpoints(vEndpoint0, vEndpoint1))
+		{
+			break;
+		}
+	}
+
+	// The most significant index bit of the first texel is implied to be zero, so swap the endpoints if it is set
+	if (indices[0] & 8)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			std::swap(quantized0[c], quantized1[c]);
+		}
+		std::swap(iPBit0, iPBit1);
+		for (int i = 0; i < 16; i++)
+		{
+			indices[i] = 15 - indices[i];
+		}
+	}
+
+	// Mode 6: mode bits, 7-bit RGBA endpoints, p-bits, then 4-bit indices (3 for the anchor)
+	memset(output, 0, 16);
+	BitWriter writer = { output, 0 };
+	writer.Write(1 << 6, 7);
+	for (int c = 0; c < 4; c++)
+	{
+		writer.Write(quantized0[c], 7);
+		writer.Write(quantized1[c], 7);
+	}
+	writer.Write(iPBit0, 1);
+	writer.Write(iPBit1, 1);
+	writer.Write(indices[0], 3);
+	for (int i = 1; i < 16; i++)
+	{
+		writer.Write(indices[i], 4);
+	}
+
+	XMVECTOR vQuantized0 = XMVectorSet((float)((quantized0[0] << 1) | iPBit0), (float)((quantized0[1] << 1) | iPBit0), (float)((quantized0[2] << 1) | iPBit0), (float)((quantized0[3] << 1) | iPBit0));
+	XMVECTOR vQuantized1 = XMVectorSet((float)((quantized1[0] << 1) | iPBit1), (float)((quantized1[1] << 1) | iPBit1), (float)((quantized1[2] << 1) | iPBit1), (float)((quantized1[3] << 1) | iPBit1));
+	for (int i = 0; i < 16; i++)
+	{
+		float fWeight = BC7_WEIGHTS[indices[i]];
+		decoded[i] = XMVectorFloor((vQuantized0 * (64.0f - fWeight) + vQuantized1 * fWeight + XMVectorReplicate(32.0f)) * (1.0f / 64.0f));
+	}
+}
+
+#pragma endregion
+
+#pragma region Decompress
+
+bool BlockCompressor::Decompress(const unsigned char* blocks, int iWidth, int iHeight, TextureFormat format, unsigned char* pixels, int iThreadCount)
+{
+	if (blocks == nullptr || pixels == nullptr || iWidth <= 0 || iHeight <= 0 || format == RGBA8Format)
+	{
+		return false;
+	}
+
+	int iBlockSize = GetBlockSize(format);
+	int iBlocksWide = (iWidth + 3) / 4;
+	int iBlocksHigh = (iHeight + 3) / 4;
+
+	Utils::ParallelFor(iBlocksHigh, iThreadCount, [&](int iBegin, int iEnd)
+	{
+		unsigned char texels[64];
+
+		for (int by = iBegin; by < iEnd; by++)
+		{
+			for (int bx = 0; bx < iBlocksWide; bx++)
+			{
+				DecodeBlock(&blocks[((size_t)by * iBlocksWide + bx) * iBlockSize], format, texels);
+
+				// Copy the part of the block inside the image
+				int iColumns = (std::min)(4, iWidth - bx * 4);
+				int iRows = (std::min)(4, iHeight - by * 4);
+				for (int y = 0; y < iRows; y++)
+				{
+					memcpy(&pixels[(((size_t)by * 4 + y) * iWidth + bx * 4) * 4], &texels[y * 16], iColumns * 4);
+				}
+			}
+		}
+	});
+
+	return true;
+}
+
+void BlockCompressor::DecodeBlock(const unsigned char* block, TextureFormat format, unsigned char* texels)
+{
+	switch (format)
+	{
+	case BC1Format:
+		DecodeBC1Block(block, true, texels);
+		break;
+	case BC2Format:
+		// Colors always use four color mode when paired with alpha
+		DecodeBC1Block(block + 8, false, texels);
+		for (int i = 0; i < 16; i++)
+		{
+			texels[i * 4 + 3] = ((block[i >> 1] >> ((i & 1) * 4)) & 15) * 17;
+		}
+		break;
+	case BC3Format:
+		DecodeBC1Block(block + 8, false, texels);
+		DecodeAlphaBlock(block, 3, texels);
+		break;
+	case BC4Format:
+	case BC5Format:
+		for (int i = 0; i < 16; i++)
+		{
+			texels[i * 4 + 1] = 0;
+			texels[i * 4 + 2] = 0;
+			texels[i * 4 + 3] = 255;
+		}
+		DecodeAlphaBlock(block, 0, texels);
+		if (format == BC5Format)
+		{
+			DecodeAlphaBlock(block + 8, 1, texels);
+		}
+		break;
+	case BC7Format:
+		DecodeBC7Block(block, texels);
+		break;
+	default:
+		memset(texels, 0, 64);
+		break;
+	}
+}
+
+void BlockCompressor::DecodeBC1Block(const unsigned char* block, bool bAllowTransparency, unsigned char* texels)
+{
+	unsigned short usColor0 = (unsigned short)(block[0] | (block[1] << 8));
+	unsigned short usColor1 = (unsigned short)(block[2] | (block[3] << 8));
+	unsigned int uiIndices = block[4] | (block[5] << 8) | (block[6] << 16) | ((unsigned int)block[7] << 24);
+
+	unsigned char palette[4][4];
+	const unsigned short colors[2] = { usColor0, usColor1 };
+	for (int e = 0; e < 2; e++)
+	{
+		int r = (colors[e] >> 11) & 31;
+		int g = (colors[e] >> 5) & 63;
+		int b = colors[e] & 31;
+		palette[e][0] = (unsigned char)((r << 3) | (r >> 2));
+		palette[e][1] = (unsigned char)((g << 2) | (g >> 4));
+		palette[e][2] = (unsigned char)((b << 3) | (b >> 2));
+		palette[e][3] = 255;
+	}
+
+	// The first endpoint being the smaller one selects three colors plus transparent black
+	bool bFourColors = !bAllowTransparency || usColor0 > usColor1;
+	for (int c = 0; c < 3; c++)
+	{
+		if (bFourColors)
+		{
+			palette[2][c] = (unsigned char)((2 * palette[0][c] + palette[1][c] + 1) / 3);
+			palette[3][c] = (unsigned char)((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+		}
+		else
+		{
+			palette[2][c] = (unsigned char)((palette[0][c] + palette[1][c] + 1) / 2);
+			palette[3][c] = 0;
+		}
+	}
+	palette[2][3] = 255;
+	palette[3][3] = bFourColors ? 255 : 0;
+
+	for (int i = 0; i < 16; i++)
+	{
+		memcpy(&texels[i * 4], palette[(uiIndices >> (i * 2)) & 3], 4);
+	}
+}
+
+void BlockCompressor::DecodeAlphaBlock(const unsigned char* block, int iChannel, unsigned char* texels)
+{
+	float palette[8];
+	GetAlphaPalette(block[0], block[1], palette);
+
+	unsigned long long ullIndices = 0;
+	for (int i = 7; i >= 2; i--)
+	{
+		ullIndices = (ullIndices << 8) | block[i];
+	}
+
+	for (int i = 0; i < 16; i++)
+	{
+		texels[i * 4 + iChannel] = (unsigned char)palette[(ullIndices >> (i * 3)) & 7];
+	}
+}
+
+void BlockCompressor::DecodeBC7Block(const unsigned char* block, unsigned char* texels)
+{
+	// The mode is given by the position of the lowest set bit
+	int iMode = 0;
+	while (iMode < 8 && !(block[0] & (1 << iMode)))
+	{
+		iMode++;
+	}
+	if (iMode == 8)
+	{
+		memset(texels, 0, 64); // Reserved mode, decodes to transparent black
+		return;
+	}
+
+	const BC7Mode& mode = BC7_MODES[iMode];
+	BitReader reader(block, iMode + 1);
+	int iPartition = reader.Read(mode.iPartitionBits);
+	int iRotation = reader.Read(mode.iRotationBits);
+	int iIndexSelection = reader.Read(mode.iIndexSelectionBits);
+
+	// Endpoints are stored channel by channel, two per subset
+	int endpoints[6][4];
+	int iEndpointCount = mode.iSubsets * 2;
+	for (int c = 0; c < 4; c++)
+	{
+		int iBitCount = (c < 3) ? mode.iColorBits : mode.iAlphaBits;
+		for (int e = 0; e < iEndpointCount; e++)
+		{
+			endpoints[e][c] = reader.Read(iBitCount);
+		}
+	}
+
+	// P-bits add a shared least significant bit to every channel of an endpoint (or of both endpoints of a subset)
+	int iColorBits = mode.iColorBits;
+	int iAlphaBits = mode.iAlphaBits;
+	if (mode.iEndpointPBits || mode.iSharedPBits)
+	{
+		int pBits[6];
+		for (int e = 0; e < iEndpointCount; e++)
+		{
+			pBits[e] = (mode.iEndpointPBits || (e & 1) == 0) ? reader.Read(1) : pBits[e - 1];
+		}
+		for (int e = 0; e < iEndpointCount; e++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				endpoints[e][c] = (endpoints[e][c] << 1) | pBits[e];
+			}
+		}
+		iColorBits++;
+		iAlphaBits += (iAlphaBits > 0) ? 1 : 0;
+	}
+
+	for (int e = 0; e < iEndpointCount; e++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			endpoints[e][c] = ExpandBits(endpoints[e][c], iColorBits);
+		}
+		endpoints[e][3] = (iAlphaBits > 0) ? ExpandBits(endpoints[e][3], iAlphaBits) : 255;
+	}
+
+	// Subset of each texel and the anchor texels of each subset
+	int subsets[16];
+	int anchors[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		if (mode.iSubsets == 2)
+		{
+			subsets[i] = (BC7_PARTITIONS_2[iPartition] >> i) & 1;
+		}
+		else if (mode.iSubsets == 3)
+		{
+			subsets[i] = (BC7_PARTITIONS_3[iPartition] >> (i * 2)) & 3;
+		}
+		else
+		{
+			subsets[i] = 0;
+		}
+	}
+	if (mode.iSubsets == 2)
+	{
+		anchors[1] = BC7_ANCHORS_2[iPartition];
+	}
+	else if (mode.iSubsets == 3)
+	{
+		anchors[1] = BC7_ANCHORS_3_SECOND[iPartition];
+		anchors[2] = BC7_ANCHORS_3_THIRD[iPartition];
+	}
+
+	int indices[16];
+	int secondaryIndices[16];
+	for (int i = 0; i < 16; i++)
+	{
+		indices[i] = reader.Read(mode.iIndexBits - ((anchors[subsets[i]] == i) ? 1 : 0));
+	}
+	for (int i = 0; i < 16 && mode.iSecondaryIndexBits > 0; i++)
+	{
+		secondaryIndices[i] = reader.Read(mode.iSecondaryIndexBits - ((i == 0) ? 1 : 0));
+	}
+
+	const int* weights = GetBC7Weights(mode.iIndexBits);
+	const int* secondaryWeights = GetBC7Weights(mode.iSecondaryIndexBits);
+	for (int i = 0; i < 16; i++)
+	{
+		const int* endpoint0 = endpoints[subsets[i] * 2];
+		const int* endpoint1 = endpoints[subsets[i] * 2 + 1];
+
+		// With two index sets, color uses the first and alpha the second unless the index selection bit swaps them
+		int iColorWeight = weights[indices[i]];
+		int iAlphaWeight = iColorWeight;
+		if (mode.iSecondaryIndexBits > 0)
+		{
+			iAlphaWeight = secondaryWeights[secondaryIndices[i]];
+			if (iIndexSelection)
+			{
+				std::swap(iColorWeight, iAlphaWeight);
+			}
+		}
+
+		unsigned char* texel = &texels[i * 4];
+		for (int c = 0; c < 4; c++)
+		{
+			int iWeight = (c < 3) ? iColorWeight : iAlphaWeight;
+			texel[c] = (unsigned char)(((64 - iWeight) * endpoint0[c] + iWeight * endpoint1[c] + 32) >> 6);
+		}
+
+		// Rotation swaps alpha with one of the color channels
+		if (iRotation > 0)
+		{
+			std::swap(texel[3], texel[iRotation - 1]);
+		}
+	}
+}
+
+#pragma endregion
+
+#pragma region Getters
+
+int BlockCompressor::GetBlockSize(TextureFormat format)
+{
+	switch (format)
+	{
+	case BC1Format:
+	case BC4Format:
+		return 8;
+	case BC2Format:
+	case BC3Format:
+	case BC5Format:
+	case BC7Format:
+		return 16;
+	default:
+		return 64; // 4x4 RGBA8 texels
+	}
+}
+
+bool BlockCompressor::CanCompress(TextureFormat format)
+{
+	return format == BC1Format || format == BC3Format || format == BC7Format;
+}
+
+float BlockCompressor::GetRMSE(double dSquaredError, long long llTexelCount)
+{
+	if (llTexelCount <= 0)
+	{
+		return 0.0f;
+	}
+	return (float)sqrt(dSquaredError / (llTexelCount * 4.0));
+}
+
+float BlockCompressor::GetPSNR(float fRMSE)
+{
+	if (fRMSE <= 0.0f)
+	{
+		return 99.0f; // Lossless
+	}
+	return 20.0f * log10f(255.0f / fRMSE);
+}
+
+#pragma endregion
@@ -0,0 +1,59 @@
+//
+// BlockCompressor.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Texture Block Compression in Direct3D 11 (https://docs.microsoft.com/en-us/windows/desktop/direct3d11/texture-block-compression-in-direct3d-11)
+// BC7 Format Mode Reference (https://docs.microsoft.com/en-us/windows/desktop/direct3d11/bc7-format-mode-reference)
+// Real-Time DXT Compression (J.M.P. van Waveren, 2006)
+//
+
+#ifndef BLOCK_COMPRESSOR_H
+#define BLOCK_COMPRESSOR_H
+
+#include <directxmath.h>
+#include <vector>
+#include "Utils.h"
+
+using namespace DirectX;
+
+enum TextureFormat : int
+{
+	RGBA8Format = 0,	// Uncompressed
+	BC1Format,			// 4 bits per texel, opaque color (or 1-bit alpha)
+	BC2Format,			// 8 bits per texel, color with explicit 4-bit alpha (decode only)
+	BC3Format,			// 8 bits per texel, color with interpolated alpha
+	BC4Format,			// 4 bits per texel, red only (decode only)
+	BC5Format,			// 8 bits per texel, red and green (decode only)
+	BC7Format			// 8 bits per texel, high quality color and alpha (mode 6 only when encoding)
+};
+
+// Encodes RGBA8 images into Direct3D block compressed formats and decodes them back
+// Quality presets: LowQuality fits the endpoints once, MediumQuality adds a least squares refinement, HighQuality refines further and searches nearby endpoints
+class BlockCompressor
+{
+public:
+	// Pixels are four bytes per texel (R, G, B, A), rows top to bottom; blocks are written row by row
+	// pSquaredError receives the error summed over every channel of every texel (edge blocks only count the texels inside the image)
+	static bool Compress(const unsigned char* pixels, int iWidth, int iHeight, TextureFormat format, QualityLevel quality, std::vector<unsigned char>& blocks, double* pSquaredError = nullptr, int iThreadCount = 0);
+
+	// Expands every block to RGBA8 the way Direct3D samples it (BC4 and BC5 fill the missing channels with 0 and alpha with 255)
+	static bool Decompress(const unsigned char* blocks, int iWidth, int iHeight, TextureFormat format, unsigned char* pixels, int iThreadCount = 0);
+	static void DecodeBlock(const unsigned char* block, TextureFormat format, unsigned char* texels); // 16 RGBA8 texels, row by row
+
+	static int GetBlockSize(TextureFormat format); // Bytes per 4x4 block
+	static bool CanCompress(TextureFormat format);
+	static float GetRMSE(double dSquaredError, long long llTexelCount); // Per channel, in 8-bit units
+	static float GetPSNR(float fRMSE); // Decibels
+
+private:
+	static void EncodeBC1Block(const XMVECTOR* texels, QualityLevel quality, unsigned char* output, XMVECTOR* decoded);
+	static void EncodeBC3AlphaBlock(const XMVECTOR* texels, QualityLevel quality, unsigned char* output, XMVECTOR* decoded);
+	static void EncodeBC7Block(const XMVECTOR* texels, QualityLevel quality, unsigned char* output, XMVECTOR* decoded);
+
+	static void DecodeBC1Block(const unsigned char* block, bool bAllowTransparency, unsigned char* texels);
+	static void DecodeAlphaBlock(const unsigned char* block, int iChannel, unsigned char* texels); // BC3 alpha, BC4 and BC5 channels
+	static void DecodeBC7Block(const unsigned char* block, unsigned char* texels);
+};
+
+#endif
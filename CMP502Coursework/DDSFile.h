@@ -0,0 +1,134 @@
+//--------------------------------------------------------------------------------------
+// File: DDSFile.h
+//
+// Platform-neutral DDS parsing, split out of DDSTextureLoader so that the same header
+// interpretation serves both Direct3D resource creation and CPU-side texture tools
+//
+// Files are memory mapped read-only and never copied; subresources are returned as
+// views into the mapped data
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248926
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#include <dxgiformat.h>
+#else
+#include <wsl/winadapter.h>         // HRESULT and SAL annotations from the DirectX-Headers package
+#include <directx/dxgiformat.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace DirectX
+{
+    enum DDS_ALPHA_MODE
+    {
+        DDS_ALPHA_MODE_UNKNOWN       = 0,
+        DDS_ALPHA_MODE_STRAIGHT      = 1,
+        DDS_ALPHA_MODE_PREMULTIPLIED = 2,
+        DDS_ALPHA_MODE_OPAQUE        = 3,
+        DDS_ALPHA_MODE_CUSTOM        = 4,
+    };
+
+    // Same values as D3D11_RESOURCE_DIMENSION
+    enum DDS_RESOURCE_DIMENSION
+    {
+        DDS_DIMENSION_UNKNOWN   = 0,
+        DDS_DIMENSION_TEXTURE1D = 2,
+        DDS_DIMENSION_TEXTURE2D = 3,
+        DDS_DIMENSION_TEXTURE3D = 4,
+    };
+
+    struct DDSTextureInfo
+    {
+        DDS_RESOURCE_DIMENSION  dimension;
+        size_t                  width;
+        size_t                  height;
+        size_t                  depth;
+        size_t                  mipCount;
+        size_t                  arraySize;  // Includes the six faces of cube maps
+        DXGI_FORMAT             format;
+        bool                    isCubeMap;
+        DDS_ALPHA_MODE          alphaMode;
+    };
+
+    // One mip level of one array item, pointing into the file data
+    struct DDSSubresource
+    {
+        const uint8_t*  data;
+        size_t          width;
+        size_t          height;
+        size_t          depth;
+        size_t          rowPitch;   // Bytes per row of texels (or of 4x4 blocks)
+        size_t          slicePitch; // Bytes per depth slice
+    };
+
+    class DDSFile
+    {
+    public:
+        DDSFile() noexcept;
+        ~DDSFile();
+
+        DDSFile(const DDSFile&) = delete;
+        DDSFile& operator=(const DDSFile&) = delete;
+
+        // Maps the file and parses it
+        HRESULT Open(_In_z_ const char* fileName);
+    #ifdef _WIN32
+        HRESULT Open(_In_z_ const wchar_t* fileName);
+    #endif
+
+        // Parses a DDS file already in memory; the data must outlive the subresource views
+        HRESULT Parse(_In_reads_bytes_(ddsDataSize) const uint8_t* ddsData, _In_ size_t ddsDataSize);
+
+        void Close();
+
+        const DDSTextureInfo& GetInfo() const { return m_info; }
+
+        // Texel data following the headers
+        const uint8_t* GetBitData() const { return m_bitData; }
+        size_t GetBitSize() const { return m_bitSize; }
+
+        // Subresources are ordered by array item, then mip level (as D3D11CalcSubresource numbers them)
+        const std::vector<DDSSubresource>& GetSubresources() const { return m_subresources; }
+        const DDSSubresource& GetSubresource(size_t mipLevel, size_t item = 0) const { return m_subresources[item * m_info.mipCount + mipLevel]; }
+
+    private:
+        DDSTextureInfo              m_info;
+        const uint8_t*              m_bitData;
+        size_t                      m_bitSize;
+        std::vector<DDSSubresource> m_subresources;
+
+        // Mapping of the file opened by Open (unused when parsing memory)
+        const uint8_t*              m_mappedData;
+        size_t                      m_mappedSize;
+    #ifdef _WIN32
+        HANDLE                      m_hFile;
+        HANDLE                      m_hMapping;
+
+        HRESULT MapFile(_In_ HANDLE hFile);
+    #endif
+    };
+
+    // Format helpers shared with the Direct3D layer
+    size_t BitsPerPixel(_In_ DXGI_FORMAT fmt);
+
+    HRESULT GetSurfaceInfo(
+        _In_ size_t width,
+        _In_ size_t height,
+        _In_ DXGI_FORMAT fmt,
+        _Out_opt_ size_t* outNumBytes,
+        _Out_opt_ size_t* outRowBytes,
+        _Out_opt_ size_t* outNumRows);
+
+    DXGI_FORMAT MakeSRGB(_In_ DXGI_FORMAT format);
+}
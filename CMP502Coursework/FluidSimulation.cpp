@@ -0,0 +1,378 @@
+//
+// FluidSimulation.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Particle-Based Fluid Simulation for Interactive Applications (Muller et al., 2003)
+// Optimized Spatial Hashing for Collision Detection of Deformable Objects (Teschner et al., 2003)
+//
+
+#include "FluidSimulation.h"
+#include <algorithm>
+
+#pragma region Init
+
+FluidSimulation::FluidSimulation()
+{
+	m_iMaxParticles = 0;
+	m_iParticleCount = 0;
+	m_uiCellMask = 0;
+	m_fSmoothingRadius = 0.1f;
+	m_fRestDensity = 1000.0f;
+	m_fParticleMass = m_fRestDensity * powf(m_fSmoothingRadius * 0.5f, 3.0f); // Particles spaced at half the smoothing radius
+	m_fStiffness = 3.0f;
+	m_fViscosity = 3.5f;
+	m_fTimeStep = 1.0f / 240.0f;
+	m_fAccumulatedTime = 0.0f;
+	m_fLifetime = 4.0f;
+	m_fBoundaryDamping = 0.3f;
+	m_gravity = XMFLOAT3(0.0f, -9.81f, 0.0f);
+	m_boundsMin = XMFLOAT3(-2.5f, -3.0f, -2.5f);
+	m_boundsMax = XMFLOAT3(2.5f, 1.0f, 2.5f);
+
+	float fH = m_fSmoothingRadius;
+	m_fPoly6 = 315.0f / (64.0f * XM_PI * powf(fH, 9.0f));
+	m_fSpikyGradient = -45.0f / (XM_PI * powf(fH, 6.0f));
+	m_fViscosityLaplacian = 45.0f / (XM_PI * powf(fH, 6.0f));
+}
+
+FluidSimulation::~FluidSimulation()
+{
+}
+
+bool FluidSimulation::Initialize(int iMaxParticles, int iThreadCount)
+{
+	if (iMaxParticles <= 0)
+	{
+		return false;
+	}
+
+	m_iMaxParticles = iMaxParticles;
+	m_iParticleCount = 0;
+
+	// Started once, since two passes run on them every step
+	if (!m_workerPool.Initialize(iThreadCount))
+	{
+		return false;
+	}
+
+	m_positions.resize(iMaxParticles);
+	m_velocities.resize(iMaxParticles);
+	m_accelerations.resize(iMaxParticles);
+	m_densities.resize(iMaxParticles + 3);
+	m_pressures.resize(iMaxParticles + 3);
+	m_ages.resize(iMaxParticles);
+	m_positionsX.resize(iMaxParticles + 3);
+	m_positionsY.resize(iMaxParticles + 3);
+	m_positionsZ.resize(iMaxParticles + 3);
+	m_velocitiesX.resize(iMaxParticles + 3);
+	m_velocitiesY.resize(iMaxParticles + 3);
+	m_velocitiesZ.resize(iMaxParticles + 3);
+	m_sortedPositions.resize(iMaxParticles);
+	m_sortedVelocities.resize(iMaxParticles);
+	m_sortedAges.resize(iMaxParticles);
+	m_particleCells.resize(iMaxParticles);
+
+	// Hash table with at least twice as many cells as particles to keep collisions rare
+	unsigned int uiCellCount = 1;
+	while (uiCellCount < (unsigned int)iMaxParticles * 2)
+	{
+		uiCellCount <<= 1;
+	}
+	m_uiCellMask = uiCellCount - 1;
+	m_cellStart.resize(uiCellCount + 1);
+
+	return true;
+}
+
+#pragma endregion
+
+#pragma region Setters/Getters
+
+int FluidSimulation::GetParticleCount()
+{
+	return m_iParticleCount;
+}
+
+const XMFLOAT4* FluidSimulation::GetPositions()
+{
+	return m_positions.data();
+}
+
+void FluidSimulation::SetBounds(XMFLOAT3 minimum, XMFLOAT3 maximum)
+{
+	m_boundsMin = minimum;
+	m_boundsMax = maximum;
+}
+
+void FluidSimulation::SetParticleLifetime(float fLifetime)
+{
+	m_fLifetime = fLifetime;
+}
+
+#pragma endregion
+
+#pragma region Update
+
+bool FluidSimulation::EmitParticle(XMFLOAT3 position, XMFLOAT3 velocity)
+{
+	if (m_iParticleCount >= m_iMaxParticles)
+	{
+		return false;
+	}
+
+	m_positions[m_iParticleCount] = XMFLOAT4(position.x, position.y, position.z, 0.0f);
+	m_velocities[m_iParticleCount] = XMFLOAT4(velocity.x, velocity.y, velocity.z, 0.0f);
+	m_ages[m_iParticleCount] = 0.0f;
+	m_iParticleCount++;
+
+	return true;
+}
+
+void FluidSimulation::Update(float fDeltaTime)
+{
+	// Advance in fixed steps for stability, and drop time rather than spiral when a frame takes too long
+	m_fAccumulatedTime = (std::min)(m_fAccumulatedTime + fDeltaTime, m_fTimeStep * 4.0f);
+
+	while (m_fAccumulatedTime >= m_fTimeStep)
+	{
+		Step();
+		m_fAccumulatedTime -= m_fTimeStep;
+	}
+}
+
+void FluidSimulation::Step()
+{
+	if (m_iParticleCount == 0)
+	{
+		return;
+	}
+
+	BuildGrid();
+	m_workerPool.ParallelFor(m_iParticleCount, [this](int iBegin, int iEnd) { ComputeDensities(iBegin, iEnd); }, 1024);
+	m_workerPool.ParallelFor(m_iParticleCount, [this](int iBegin, int iEnd) { ComputeAccelerations(iBegin, iEnd); }, 1024);
+	Integrate();
+}
+
+unsigned int FluidSimulation::GetCell(int x, int y, int z)
+{
+	return ((unsigned int)x * 73856093u ^ (unsigned int)y * 19349663u ^ (unsigned int)z * 83492791u) & m_uiCellMask;
+}
+
+int FluidSimulation::GetNeighborCells(const XMFLOAT4& position, unsigned int* cells)
+{
+	// Two of the 27 cells around the position may hash to the same slot, which would count its particles twice
+	int x, y, z;
+	GetCellCoordinates(position, x, y, z);
+	int iCellCount = 0;
+	for (int dz = -1; dz <= 1; dz++)
+	{
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				unsigned int uiCell = GetCell(x + dx, y + dy, z + dz);
+				if (std::find(cells, cells + iCellCount, uiCell) == cells + iCellCount)
+				{
+					cells[iCellCount++] = uiCell;
+				}
+			}
+		}
+	}
+
+	return iCellCount;
+}
+
+void FluidSimulation::GetCellCoordinates(const XMFLOAT4& position, int& x, int& y, int& z)
+{
+	float fInverseCellSize = 1.0f / m_fSmoothingRadius;
+	x = (int)floorf(position.x * fInverseCellSize);
+	y = (int)floorf(position.y * fInverseCellSize);
+	z = (int)floorf(position.z * fInverseCellSize);
+}
+
+void FluidSimulation::BuildGrid()
+{
+	// Counting sort of the particles into hashed cells of the size of the smoothing radius
+
+	std::fill(m_cellStart.begin(), m_cellStart.end(), 0);
+
+	for (int i = 0; i < m_iParticleCount; i++)
+	{
+		int x, y, z;
+		GetCellCoordinates(m_positions[i], x, y, z);
+		m_particleCells[i] = GetCell(x, y, z);
+		m_cellStart[m_particleCells[i] + 1]++;
+	}
+
+	// Prefix sum turns the counts into the first index of each cell
+	for (unsigned int i = 1; i < m_cellStart.size(); i++)
+	{
+		m_cellStart[i] += m_cellStart[i - 1];
+	}
+
+	// Scatter the particles so that the particles of a cell are contiguous in memory
+	std::vector<unsigned int> cellCursor(m_cellStart.begin(), m_cellStart.end() - 1);
+	for (int i = 0; i < m_iParticleCount; i++)
+	{
+		unsigned int uiDestination = cellCursor[m_particleCells[i]]++;
+		m_sortedPositions[uiDestination] = m_positions[i];
+		m_sortedVelocities[uiDestination] = m_velocities[i];
+		m_sortedAges[uiDestination] = m_ages[i];
+		m_positionsX[uiDestination] = m_positions[i].x;
+		m_positionsY[uiDestination] = m_positions[i].y;
+		m_positionsZ[uiDestination] = m_positions[i].z;
+		m_velocitiesX[uiDestination] = m_velocities[i].x;
+		m_velocitiesY[uiDestination] = m_velocities[i].y;
+		m_velocitiesZ[uiDestination] = m_velocities[i].z;
+	}
+
+	m_positions.swap(m_sortedPositions);
+	m_velocities.swap(m_sortedVelocities);
+	m_ages.swap(m_sortedAges);
+}
+
+void FluidSimulation::ComputeDensities(int iBegin, int iEnd)
+{
+	XMVECTOR vH2 = XMVectorReplicate(m_fSmoothingRadius * m_fSmoothingRadius);
+	XMVECTOR vLanes = XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+
+	for (int i = iBegin; i < iEnd; i++)
+	{
+		XMVECTOR vX = XMVectorReplicate(m_positionsX[i]);
+		XMVECTOR vY = XMVectorReplicate(m_positionsY[i]);
+		XMVECTOR vZ = XMVectorReplicate(m_positionsZ[i]);
+		XMVECTOR vDensity = XMVectorZero();
+
+		// Visit the cells around the particle; particles of other cells hashed into them only add candidates that fail the distance test
+		unsigned int cells[27];
+		int iCellCount = GetNeighborCells(m_positions[i], cells);
+		for (int c = 0; c < iCellCount; c++)
+		{
+			unsigned int uiCell = cells[c];
+			unsigned int uiCellEnd = m_cellStart[uiCell + 1];
+
+			// Four neighbors at a time; the lanes past the end of the cell are masked out
+			for (unsigned int j = m_cellStart[uiCell]; j < uiCellEnd; j += 4)
+			{
+				XMVECTOR vOffsetX = vX - XMLoadFloat4((const XMFLOAT4*)&m_positionsX[j]);
+				XMVECTOR vOffsetY = vY - XMLoadFloat4((const XMFLOAT4*)&m_positionsY[j]);
+				XMVECTOR vOffsetZ = vZ - XMLoadFloat4((const XMFLOAT4*)&m_positionsZ[j]);
+				XMVECTOR vR2 = vOffsetX * vOffsetX + vOffsetY * vOffsetY + vOffsetZ * vOffsetZ;
+				XMVECTOR vInside = XMVectorAndInt(XMVectorLess(vR2, vH2), XMVectorLess(vLanes, XMVectorReplicate((float)(uiCellEnd - j))));
+
+				XMVECTOR vDifference = vH2 - vR2;
+				vDensity += XMVectorSelect(XMVectorZero(), vDifference * vDifference * vDifference, vInside);
+			}
+		}
+
+		m_densities[i] = m_fParticleMass * m_fPoly6 * XMVectorGetX(XMVectorSum(vDensity));
+		m_pressures[i] = (std::max)(m_fStiffness * (m_densities[i] - m_fRestDensity), 0.0f); // No tension, which would clump a sparse spray
+	}
+}
+
+void FluidSimulation::ComputeAccelerations(int iBegin, int iEnd)
+{
+	float fH = m_fSmoothingRadius;
+	XMVECTOR vH = XMVectorReplicate(fH);
+	XMVECTOR vH2 = XMVectorReplicate(fH * fH);
+	XMVECTOR vMinR2 = XMVectorReplicate(1e-12f);
+	XMVECTOR vLanes = XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+	XMVECTOR vPressureCoefficient = XMVectorReplicate(-m_fParticleMass * 0.5f * m_fSpikyGradient);
+	XMVECTOR vViscosityCoefficient = XMVectorReplicate(m_fViscosity * m_fParticleMass * m_fViscosityLaplacian);
+	XMVECTOR vGravity = XMLoadFloat3(&m_gravity);
+
+	for (int i = iBegin; i < iEnd; i++)
+	{
+		XMVECTOR vX = XMVectorReplicate(m_positionsX[i]);
+		XMVECTOR vY = XMVectorReplicate(m_positionsY[i]);
+		XMVECTOR vZ = XMVectorReplicate(m_positionsZ[i]);
+		XMVECTOR vVelocityX = XMVectorReplicate(m_velocitiesX[i]);
+		XMVECTOR vVelocityY = XMVectorReplicate(m_velocitiesY[i]);
+		XMVECTOR vVelocityZ = XMVectorReplicate(m_velocitiesZ[i]);
+		XMVECTOR vPressure = XMVectorReplicate(m_pressures[i]);
+		XMVECTOR vForceX = XMVectorZero();
+		XMVECTOR vForceY = XMVectorZero();
+		XMVECTOR vForceZ = XMVectorZero();
+
+		unsigned int cells[27];
+		int iCellCount = GetNeighborCells(m_positions[i], cells);
+		for (int c = 0; c < iCellCount; c++)
+		{
+			unsigned int uiCell = cells[c];
+			unsigned int uiCellEnd = m_cellStart[uiCell + 1];
+			for (unsigned int j = m_cellStart[uiCell]; j < uiCellEnd; j += 4)
+			{
+				XMVECTOR vOffsetX = vX - XMLoadFloat4((const XMFLOAT4*)&m_positionsX[j]);
+				XMVECTOR vOffsetY = vY - XMLoadFloat4((const XMFLOAT4*)&m_positionsY[j]);
+				XMVECTOR vOffsetZ = vZ - XMLoadFloat4((const XMFLOAT4*)&m_positionsZ[j]);
+				XMVECTOR vR2 = vOffsetX * vOffsetX + vOffsetY * vOffsetY + vOffsetZ * vOffsetZ;
+
+				// Lanes past the end of the cell, outside the radius, or at the particle itself add nothing (their terms may not be finite)
+				XMVECTOR vInside = XMVectorAndInt(XMVectorAndInt(XMVectorLess(vR2, vH2), XMVectorGreater(vR2, vMinR2)), XMVectorLess(vLanes, XMVectorReplicate((float)(uiCellEnd - j))));
+
+				XMVECTOR vR = XMVectorSqrt(vR2);
+				XMVECTOR vDifference = vH - vR;
+				XMVECTOR vInverseDensity = XMVectorReciprocal(XMLoadFloat4((const XMFLOAT4*)&m_densities[j]));
+
+				// Symmetric pressure term with the spiky kernel gradient
+				XMVECTOR vPressureScale = vPressureCoefficient * (vPressure + XMLoadFloat4((const XMFLOAT4*)&m_pressures[j])) * vInverseDensity * vDifference * vDifference / vR;
+				vPressureScale = XMVectorSelect(XMVectorZero(), vPressureScale, vInside);
+
+				// Viscosity pulls the velocity towards that of the neighbors
+				XMVECTOR vViscosityScale = XMVectorSelect(XMVectorZero(), vViscosityCoefficient * vInverseDensity * vDifference, vInside);
+
+				vForceX += vOffsetX * vPressureScale + (XMLoadFloat4((const XMFLOAT4*)&m_velocitiesX[j]) - vVelocityX) * vViscosityScale;
+				vForceY += vOffsetY * vPressureScale + (XMLoadFloat4((const XMFLOAT4*)&m_velocitiesY[j]) - vVelocityY) * vViscosityScale;
+				vForceZ += vOffsetZ * vPressureScale + (XMLoadFloat4((const XMFLOAT4*)&m_velocitiesZ[j]) - vVelocityZ) * vViscosityScale;
+			}
+		}
+
+		XMVECTOR vForce = XMVectorSet(XMVectorGetX(XMVectorSum(vForceX)), XMVectorGetX(XMVectorSum(vForceY)), XMVectorGetX(XMVectorSum(vForceZ)), 0.0f);
+		XMVECTOR vAcceleration = vForce / m_densities[i] + vGravity;
+		XMStoreFloat4(&m_accelerations[i], vAcceleration);
+	}
+}
+
+void FluidSimulation::Integrate()
+{
+	XMVECTOR vBoundsMin = XMLoadFloat3(&m_boundsMin);
+	XMVECTOR vBoundsMax = XMLoadFloat3(&m_boundsMax);
+
+	int i = 0;
+	while (i < m_iParticleCount)
+	{
+		// Semi-implicit Euler
+		XMVECTOR vVelocity = XMLoadFloat4(&m_velocities[i]) + XMLoadFloat4(&m_accelerations[i]) * m_fTimeStep;
+		XMVECTOR vPosition = XMLoadFloat4(&m_positions[i]) + vVelocity * m_fTimeStep;
+
+		// Bounce off the walls of the simulation box, losing energy
+		XMFLOAT3 position, velocity;
+		XMStoreFloat3(&position, vPosition);
+		XMStoreFloat3(&velocity, vVelocity);
+		if (position.x < m_boundsMin.x || position.x > m_boundsMax.x) { velocity.x *= -m_fBoundaryDamping; }
+		if (position.y < m_boundsMin.y || position.y > m_boundsMax.y) { velocity.y *= -m_fBoundaryDamping; }
+		if (position.z < m_boundsMin.z || position.z > m_boundsMax.z) { velocity.z *= -m_fBoundaryDamping; }
+		vPosition = XMVectorClamp(vPosition, vBoundsMin, vBoundsMax);
+
+		XMStoreFloat4(&m_positions[i], XMVectorSetW(vPosition, m_densities[i]));
+		m_velocities[i] = XMFLOAT4(velocity.x, velocity.y, velocity.z, 0.0f);
+		m_ages[i] += m_fTimeStep;
+
+		// Recycle expired particles by moving the last particle into their slot
+		if (m_ages[i] > m_fLifetime)
+		{
+			m_iParticleCount--;
+			m_positions[i] = m_positions[m_iParticleCount];
+			m_velocities[i] = m_velocities[m_iParticleCount];
+			m_accelerations[i] = m_accelerations[m_iParticleCount];
+			m_densities[i] = m_densities[m_iParticleCount];
+			m_ages[i] = m_ages[m_iParticleCount];
+			continue;
+		}
+
+		i++;
+	}
+}
+
+#pragma endregion
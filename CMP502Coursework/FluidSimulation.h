@@ -0,0 +1,92 @@
+//
+// FluidSimulation.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Particle-Based Fluid Simulation for Interactive Applications (Muller et al., 2003)
+// Optimized Spatial Hashing for Collision Detection of Deformable Objects (Teschner et al., 2003)
+//
+
+#ifndef FLUID_SIMULATION_H
+#define FLUID_SIMULATION_H
+
+#include <directxmath.h>
+#include <vector>
+#include "WorkerPool.h"
+
+using namespace DirectX;
+
+// Smoothed-particle hydrodynamics water simulation (no Direct3D dependency so it can run headless)
+class FluidSimulation
+{
+public:
+	FluidSimulation();
+	~FluidSimulation();
+
+	bool Initialize(int iMaxParticles, int iThreadCount = 0);
+	void Update(float fDeltaTime); // Seconds
+	bool EmitParticle(XMFLOAT3 position, XMFLOAT3 velocity);
+
+	int GetParticleCount();
+	const XMFLOAT4* GetPositions(); // xyz = position, w = density
+	void SetBounds(XMFLOAT3 minimum, XMFLOAT3 maximum);
+	void SetParticleLifetime(float fLifetime);
+
+private:
+	int m_iMaxParticles;
+	int m_iParticleCount;
+	WorkerPool m_workerPool;
+
+	// Particle data (structure of arrays, reordered by grid cell every step so neighbors are close in memory)
+	std::vector<XMFLOAT4> m_positions;
+	std::vector<XMFLOAT4> m_velocities;
+	std::vector<XMFLOAT4> m_accelerations;
+	std::vector<float> m_densities;
+	std::vector<float> m_pressures;
+	std::vector<float> m_ages;
+
+	// Components of the sorted positions and velocities in separate arrays, so that neighbors are read four at a time (padded by three)
+	std::vector<float> m_positionsX;
+	std::vector<float> m_positionsY;
+	std::vector<float> m_positionsZ;
+	std::vector<float> m_velocitiesX;
+	std::vector<float> m_velocitiesY;
+	std::vector<float> m_velocitiesZ;
+
+	// Scratch arrays for the counting sort
+	std::vector<XMFLOAT4> m_sortedPositions;
+	std::vector<XMFLOAT4> m_sortedVelocities;
+	std::vector<float> m_sortedAges;
+	std::vector<unsigned int> m_particleCells;
+	std::vector<unsigned int> m_cellStart; // Index of the first particle of each cell; cell i spans [m_cellStart[i], m_cellStart[i + 1])
+	unsigned int m_uiCellMask;
+
+	float m_fSmoothingRadius;
+	float m_fParticleMass;
+	float m_fRestDensity;
+	float m_fStiffness;
+	float m_fViscosity;
+	float m_fTimeStep;
+	float m_fAccumulatedTime;
+	float m_fLifetime;
+	float m_fBoundaryDamping;
+	XMFLOAT3 m_gravity;
+	XMFLOAT3 m_boundsMin;
+	XMFLOAT3 m_boundsMax;
+
+	// Precomputed kernel coefficients
+	float m_fPoly6;
+	float m_fSpikyGradient;
+	float m_fViscosityLaplacian;
+
+	void Step();
+	void BuildGrid();
+	void ComputeDensities(int iBegin, int iEnd);
+	void ComputeAccelerations(int iBegin, int iEnd);
+	void Integrate();
+	unsigned int GetCell(int x, int y, int z);
+	int GetNeighborCells(const XMFLOAT4& position, unsigned int* cells); // The distinct cells of the 27 around the position, at most 27
+	void GetCellCoordinates(const XMFLOAT4& position, int& x, int& y, int& z);
+};
+
+#endif
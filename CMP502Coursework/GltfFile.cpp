@@ -0,0 +1,846 @@
+//
+// GltfFile.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// glTF 2.0 Specification (https://github.com/KhronosGroup/glTF/tree/master/specification/2.0)
+// RFC 8259: The JavaScript Object Notation (JSON) Data Interchange Format (https://tools.ietf.org/html/rfc8259)
+//
+
+#include "GltfFile.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+	const unsigned int GlbMagic = 0x46546C67; // "glTF"
+	const unsigned int GlbVersion = 2;
+	const unsigned int JsonChunk = 0x4E4F534A; // "JSON"
+	const unsigned int BinaryChunk = 0x004E4942; // "BIN\0"
+	const int MaxJsonDepth = 64;
+
+	const int UnsignedByte = 5121;
+	const int UnsignedShort = 5123;
+	const int UnsignedInt = 5125;
+	const int Float = 5126;
+	const int Triangles = 4;
+
+	struct JsonValue
+	{
+		enum Type : int
+		{
+			Null = 0,
+			Boolean,
+			Number,
+			String,
+			Array,
+			Object
+		};
+
+		Type type = Null;
+		bool bBoolean = false;
+		double dNumber = 0.0;
+		std::string string;
+		std::vector<JsonValue> elements;
+		std::vector<std::pair<std::string, JsonValue>> members;
+
+		const JsonValue* Get(const char* key) const
+		{
+			for (const auto& member : members)
+			{
+				if (member.first == key)
+				{
+					return &member.second;
+				}
+			}
+			return nullptr;
+		}
+
+		const JsonValue* Get(size_t index) const
+		{
+			return (index < elements.size()) ? &elements[index] : nullptr;
+		}
+
+		int GetInt(const char* key, int iDefault) const
+		{
+			const JsonValue* pValue = Get(key);
+			return (pValue && pValue->type == Number) ? (int)pValue->dNumber : iDefault;
+		}
+
+		float GetFloat(size_t index, float fDefault) const
+		{
+			const JsonValue* pValue = Get(index);
+			return (pValue && pValue->type == Number) ? (float)pValue->dNumber : fDefault;
+		}
+
+		std::string GetString(const char* key) const
+		{
+			const JsonValue* pValue = Get(key);
+			return (pValue && pValue->type == String) ? pValue->string : std::string();
+		}
+	};
+
+	// Recursive descent over the JSON chunk; glTF only needs the values, so number formats and escapes are not checked beyond what parsing them requires
+	class JsonParser
+	{
+	public:
+		JsonParser(const char* text, size_t size) : m_p(text), m_end(text + size) {}
+
+		bool Parse(JsonValue& value)
+		{
+			return ParseValue(value, 0) && (SkipSpace(), m_p == m_end);
+		}
+
+	private:
+		const char* m_p;
+		const char* m_end;
+
+		void SkipSpace()
+		{
+			while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\r' || *m_p == '\n'))
+			{
+				m_p++;
+			}
+		}
+
+		bool Match(const char* literal)
+		{
+			size_t length = strlen(literal);
+			if ((size_t)(m_end - m_p) < length || memcmp(m_p, literal, length) != 0)
+			{
+				return false;
+			}
+			m_p += length;
+			return true;
+		}
+
+		bool ParseValue(JsonValue& value, int iDepth)
+		{
+			SkipSpace();
+			if (m_p == m_end || iDepth > MaxJsonDepth)
+			{
+				return false;
+			}
+
+			switch (*m_p)
+			{
+			case '{':
+				value.type = JsonValue::Object;
+				m_p++;
+				SkipSpace();
+				if (m_p < m_end && *m_p == '}')
+				{
+					m_p++;
+					return true;
+				}
+				for (;;)
+				{
+					value.members.emplace_back();
+					SkipSpace();
+					if (!ParseString(value.members.back().first))
+					{
+						return false;
+					}
+					SkipSpace();
+					if (m_p == m_end || *m_p++ != ':' || !ParseValue(value.members.back().second, iDepth + 1))
+					{
+						return false;
+					}
+					SkipSpace();
+					if (m_p < m_end && *m_p == ',')
+					{
+						m_p++;
+						continue;
+					}
+					return m_p < m_end && *m_p++ == '}';
+				}
+			case '[':
+				value.type = JsonValue::Array;
+				m_p++;
+				SkipSpace();
+				if (m_p < m_end && *m_p == ']')
+				{
+					m_p++;
+					return true;
+				}
+				for (;;)
+				{
+					value.elements.emplace_back();
+					if (!ParseValue(value.elements.back(), iDepth + 1))
+					{
+						return false;
+					}
+					SkipSpace();
+					if (m_p < m_end && *m_p == ',')
+					{
+						m_p++;
+						continue;
+					}
+					return m_p < m_end && *m_p++ == ']';
+				}
+			case '"':
+				value.type = JsonValue::String;
+				return ParseString(value.string);
+			case 't':
+				value.type = JsonValue::Boolean;
+				value.bBoolean = true;
+				return Match("true");
+			case 'f':
+				value.type = JsonValue::Boolean;
+				return Match("false");
+			case 'n':
+				return Match("null");
+			default:
+				value.type = JsonValue::Number;
+				return ParseNumber(value.dNumber);
+			}
+		}
+
+		bool ParseNumber(double& dNumber)
+		{
+			// strtod needs a terminated string, and numbers are short
+			char token[64];
+			size_t length = 0;
+			while (m_p + length < m_end && length < sizeof(token) - 1 && strchr("+-0123456789.eE", m_p[length]) && m_p[length] != '\0')
+			{
+				length++;
+			}
+			if (length == 0)
+			{
+				return false;
+			}
+			memcpy(token, m_p, length);
+			token[length] = '\0';
+
+			char* end;
+			dNumber = strtod(token, &end);
+			m_p += length;
+			return end == token + length;
+		}
+
+		bool ParseString(std::string& string)
+		{
+			if (m_p == m_end || *m_p++ != '"')
+			{
+				return false;
+			}
+			while (m_p < m_end && *m_p != '"')
+			{
+				char c = *m_p++;
+				if (c != '\\')
+				{
+					string += c;
+					continue;
+				}
+				if (m_p == m_end)
+				{
+					return false;
+				}
+				c = *m_p++;
+				switch (c)
+				{
+				case 'b': string += '\b'; break;
+				case 'f': string += '\f'; break;
+				case 'n': string += '\n'; break;
+				case 'r': string += '\r'; break;
+				case 't': string += '\t'; break;
+				case 'u':
+				{
+					// Encoded as UTF-8; surrogate pairs are joined
+					unsigned int uiCodePoint;
+					if (!ParseHex(uiCodePoint))
+					{
+						return false;
+					}
+					if (uiCodePoint >= 0xD800 && uiCodePoint < 0xDC00)
+					{
+						unsigned int uiLow;
+						if (!Match("\\u") || !ParseHex(uiLow) || uiLow < 0xDC00 || uiLow > 0xDFFF)
+						{
+							return false;
+						}
+						uiCodePoint = 0x10000 + ((uiCodePoint - 0xD800) << 10) + (uiLow - 0xDC00);
+					}
+					if (uiCodePoint < 0x80)
+					{
+						string += (char)uiCodePoint;
+					}
+					else if (uiCodePoint < 0x800)
+					{
+						string += (char)(0xC0 | (uiCodePoint >> 6));
+						string += (char)(0x80 | (uiCodePoint & 0x3F));
+					}
+					else if (uiCodePoint < 0x10000)
+					{
+						string += (char)(0xE0 | (uiCodePoint >> 12));
+						string += (char)(0x80 | ((uiCodePoint >> 6) & 0x3F));
+						string += (char)(0x80 | (uiCodePoint & 0x3F));
+					}
+					else
+					{
+						string += (char)(0xF0 | (uiCodePoint >> 18));
+						string += (char)(0x80 | ((uiCodePoint >> 12) & 0x3F));
+						string += (char)(0x80 | ((uiCodePoint >> 6) & 0x3F));
+						string += (char)(0x80 | (uiCodePoint & 0x3F));
+					}
+					break;
+				}
+				default: string += c; break; // '"', '\\' and '/'
+				}
+			}
+			return m_p < m_end && *m_p++ == '"';
+		}
+
+		bool ParseHex(unsigned int& uiValue)
+		{
+			if (m_end - m_p < 4)
+			{
+				return false;
+			}
+			uiValue = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				char c = *m_p++;
+				int iDigit = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+				if (iDigit < 0)
+				{
+					return false;
+				}
+				uiValue = uiValue * 16 + iDigit;
+			}
+			return true;
+		}
+	};
+
+	int GetComponentSize(int iComponentType)
+	{
+		switch (iComponentType)
+		{
+		case 5120: // Byte
+		case UnsignedByte:
+			return 1;
+		case 5122: // Short
+		case UnsignedShort:
+			return 2;
+		case UnsignedInt:
+		case Float:
+			return 4;
+		default:
+			return 0;
+		}
+	}
+
+	int GetComponentCount(const std::string& type)
+	{
+		return (type == "SCALAR") ? 1 : (type == "VEC2") ? 2 : (type == "VEC3") ? 3 : (type == "VEC4") ? 4 : 0;
+	}
+
+	// Finds the accessor's elements in the binary chunk, checking that every one of them is inside its buffer view
+	bool ReadAccessor(const JsonValue& root, int iAccessor, const unsigned char* binary, size_t binarySize, GltfAccessor& accessor, std::string& error)
+	{
+		const JsonValue* pAccessors = root.Get("accessors");
+		const JsonValue* pAccessor = pAccessors ? pAccessors->Get((size_t)iAccessor) : nullptr;
+		if (!pAccessor)
+		{
+			error = "missing accessor " + std::to_string(iAccessor);
+			return false;
+		}
+		if (pAccessor->Get("sparse"))
+		{
+			error = "sparse accessors are not supported";
+			return false;
+		}
+
+		const JsonValue* pBufferViews = root.Get("bufferViews");
+		const JsonValue* pView = pBufferViews ? pBufferViews->Get((size_t)pAccessor->GetInt("bufferView", -1)) : nullptr;
+		if (!pView)
+		{
+			error = "accessor " + std::to_string(iAccessor) + " has no buffer view";
+			return false;
+		}
+		if (pView->GetInt("buffer", -1) != 0)
+		{
+			error = "only the binary chunk's buffer is supported";
+			return false;
+		}
+
+		accessor.iComponentType = pAccessor->GetInt("componentType", 0);
+		accessor.iComponentCount = GetComponentCount(pAccessor->GetString("type"));
+		accessor.iCount = pAccessor->GetInt("count", 0);
+		const JsonValue* pNormalized = pAccessor->Get("normalized");
+		accessor.bNormalized = pNormalized && pNormalized->bBoolean;
+
+		int iComponentSize = GetComponentSize(accessor.iComponentType);
+		size_t elementSize = (size_t)iComponentSize * accessor.iComponentCount;
+		accessor.iStride = pView->GetInt("byteStride", (int)elementSize);
+		long long viewOffset = pView->GetInt("byteOffset", 0);
+		long long viewLength = pView->GetInt("byteLength", 0);
+		long long offset = pAccessor->GetInt("byteOffset", 0);
+		if (elementSize == 0 || accessor.iCount <= 0 || accessor.iStride < (int)elementSize || viewOffset < 0 || viewLength < 0 || offset < 0 ||
+			(viewOffset + offset) % iComponentSize != 0 || accessor.iStride % iComponentSize != 0)
+		{
+			error = "accessor " + std::to_string(iAccessor) + " is invalid";
+			return false;
+		}
+		if ((unsigned long long)(viewOffset + viewLength) > binarySize || offset + (long long)accessor.iStride * (accessor.iCount - 1) + (long long)elementSize > viewLength)
+		{
+			error = "accessor " + std::to_string(iAccessor) + " is out of bounds";
+			return false;
+		}
+
+		accessor.data = binary + viewOffset + offset;
+		return true;
+	}
+
+	XMMATRIX GetNodeMatrix(const JsonValue& node)
+	{
+		// glTF matrices are column-major for column vectors, which is the row-major layout of the transpose DirectXMath uses
+		const JsonValue* pMatrix = node.Get("matrix");
+		if (pMatrix && pMatrix->elements.size() == 16)
+		{
+			XMFLOAT4X4 matrix;
+			for (int i = 0; i < 16; i++)
+			{
+				matrix.m[i / 4][i % 4] = pMatrix->GetFloat(i, 0.0f);
+			}
+			return XMLoadFloat4x4(&matrix);
+		}
+
+		XMMATRIX scalingMatrix = XMMatrixIdentity();
+		XMMATRIX rotationMatrix = XMMatrixIdentity();
+		XMMATRIX translationMatrix = XMMatrixIdentity();
+		if (const JsonValue* pScale = node.Get("scale"))
+		{
+			scalingMatrix = XMMatrixScaling(pScale->GetFloat(0, 1.0f), pScale->GetFloat(1, 1.0f), pScale->GetFloat(2, 1.0f));
+		}
+		if (const JsonValue* pRotation = node.Get("rotation"))
+		{
+			rotationMatrix = XMMatrixRotationQuaternion(XMVectorSet(pRotation->GetFloat(0, 0.0f), pRotation->GetFloat(1, 0.0f), pRotation->GetFloat(2, 0.0f), pRotation->GetFloat(3, 1.0f)));
+		}
+		if (const JsonValue* pTranslation = node.Get("translation"))
+		{
+			translationMatrix = XMMatrixTranslation(pTranslation->GetFloat(0, 0.0f), pTranslation->GetFloat(1, 0.0f), pTranslation->GetFloat(2, 0.0f));
+		}
+		return scalingMatrix * rotationMatrix * translationMatrix;
+	}
+
+	void AddNode(const JsonValue& nodes, int iNode, XMMATRIX parentMatrix, int iDepth, std::vector<GltfMesh>& meshes)
+	{
+		const JsonValue* pNode = nodes.Get((size_t)iNode);
+		if (!pNode || iDepth > (int)nodes.elements.size()) // Deeper than the node count means a cycle
+		{
+			return;
+		}
+
+		XMMATRIX worldMatrix = GetNodeMatrix(*pNode) * parentMatrix;
+		int iMesh = pNode->GetInt("mesh", -1);
+		if (iMesh >= 0 && iMesh < (int)meshes.size())
+		{
+			XMFLOAT4X4 nodeMatrix;
+			XMStoreFloat4x4(&nodeMatrix, worldMatrix * XMMatrixScaling(1.0f, 1.0f, -1.0f));
+			meshes[iMesh].nodeMatrices.push_back(nodeMatrix);
+		}
+
+		if (const JsonValue* pChildren = pNode->Get("children"))
+		{
+			for (const auto& child : pChildren->elements)
+			{
+				AddNode(nodes, (int)child.dNumber, worldMatrix, iDepth + 1, meshes);
+			}
+		}
+	}
+
+	XMFLOAT3 ReadFloat3(const GltfAccessor& accessor, int i)
+	{
+		XMFLOAT3 value;
+		memcpy(&value, accessor.data + (size_t)accessor.iStride * i, sizeof(value));
+		return value;
+	}
+
+	XMFLOAT2 ReadTexcoord(const GltfAccessor& accessor, int i)
+	{
+		const unsigned char* element = accessor.data + (size_t)accessor.iStride * i;
+		XMFLOAT2 value;
+		if (accessor.iComponentType == Float)
+		{
+			memcpy(&value, element, sizeof(value));
+		}
+		else if (accessor.iComponentType == UnsignedShort)
+		{
+			unsigned short components[2];
+			memcpy(components, element, sizeof(components));
+			value = XMFLOAT2(components[0] / 65535.0f, components[1] / 65535.0f);
+		}
+		else
+		{
+			value = XMFLOAT2(element[0] / 255.0f, element[1] / 255.0f);
+		}
+		return value;
+	}
+
+	unsigned int ReadIndex(const GltfAccessor& accessor, int i)
+	{
+		const unsigned char* element = accessor.data + (size_t)accessor.iStride * i;
+		if (accessor.iComponentType == UnsignedInt)
+		{
+			unsigned int uiIndex;
+			memcpy(&uiIndex, element, sizeof(uiIndex));
+			return uiIndex;
+		}
+		if (accessor.iComponentType == UnsignedShort)
+		{
+			unsigned short usIndex;
+			memcpy(&usIndex, element, sizeof(usIndex));
+			return usIndex;
+		}
+		return *element;
+	}
+}
+
+#pragma region Init
+
+GltfFile::GltfFile()
+{
+}
+
+GltfFile::~GltfFile()
+{
+	Close();
+}
+
+bool GltfFile::Open(const char* filename)
+{
+	Close();
+	if (!m_file.Open(filename))
+	{
+		m_error = "could not be opened";
+		return false;
+	}
+	return Parse(m_file.GetData(), m_file.GetSize());
+}
+
+bool GltfFile::Parse(const unsigned char* data, size_t size)
+{
+	m_meshes.clear();
+	m_materials.clear();
+	m_error.clear();
+
+	// Header, then the JSON chunk and the (optional) binary chunk, each starting on a 4 byte boundary
+	unsigned int header[3];
+	unsigned int chunkHeader[2];
+	if (size < sizeof(header) + sizeof(chunkHeader))
+	{
+		m_error = "not a binary glTF file";
+		return false;
+	}
+	memcpy(header, data, sizeof(header));
+	memcpy(chunkHeader, data + sizeof(header), sizeof(chunkHeader));
+	if (header[0] != GlbMagic || header[1] != GlbVersion || header[2] > size || header[2] < sizeof(header) + sizeof(chunkHeader) || chunkHeader[1] != JsonChunk || chunkHeader[0] > header[2] - sizeof(header) - sizeof(chunkHeader))
+	{
+		m_error = "not a binary glTF 2.0 file";
+		return false;
+	}
+	size = header[2];
+	const char* json = (const char*)data + sizeof(header) + sizeof(chunkHeader);
+	size_t jsonSize = chunkHeader[0];
+
+	const unsigned char* binary = nullptr;
+	size_t binarySize = 0;
+	size_t binaryOffset = sizeof(header) + sizeof(chunkHeader) + ((jsonSize + 3) & ~(size_t)3);
+	if (binaryOffset + sizeof(chunkHeader) <= size)
+	{
+		memcpy(chunkHeader, data + binaryOffset, sizeof(chunkHeader));
+		if (chunkHeader[1] == BinaryChunk && chunkHeader[0] <= size - binaryOffset - sizeof(chunkHeader))
+		{
+			binary = data + binaryOffset + sizeof(chunkHeader);
+			binarySize = chunkHeader[0];
+		}
+	}
+
+	JsonValue root;
+	if (!JsonParser(json, jsonSize).Parse(root) || root.type != JsonValue::Object)
+	{
+		m_error = "the JSON chunk is invalid";
+		return false;
+	}
+
+	// Materials keep the name of their base color image, which is matched against the textures the game loads
+	const JsonValue* pTextures = root.Get("textures");
+	const JsonValue* pImages = root.Get("images");
+	if (const JsonValue* pMaterials = root.Get("materials"))
+	{
+		for (const auto& material : pMaterials->elements)
+		{
+			GltfMaterial gltfMaterial;
+			gltfMaterial.name = material.GetString("name");
+			gltfMaterial.baseColorFactor = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+			if (const JsonValue* pPbr = material.Get("pbrMetallicRoughness"))
+			{
+				if (const JsonValue* pFactor = pPbr->Get("baseColorFactor"))
+				{
+					gltfMaterial.baseColorFactor = XMFLOAT4(pFactor->GetFloat(0, 1.0f), pFactor->GetFloat(1, 1.0f), pFactor->GetFloat(2, 1.0f), pFactor->GetFloat(3, 1.0f));
+				}
+				const JsonValue* pTextureInfo = pPbr->Get("baseColorTexture");
+				const JsonValue* pTexture = (pTextureInfo && pTextures) ? pTextures->Get((size_t)pTextureInfo->GetInt("index", -1)) : nullptr;
+				const JsonValue* pImage = (pTexture && pImages) ? pImages->Get((size_t)pTexture->GetInt("source", -1)) : nullptr;
+				if (pImage)
+				{
+					gltfMaterial.baseColorTexture = pImage->GetString("uri").empty() ? pImage->GetString("name") : pImage->GetString("uri");
+				}
+			}
+			m_materials.push_back(gltfMaterial);
+		}
+	}
+
+	// Meshes, with every accessor checked now so that the views can be trusted later
+	if (const JsonValue* pMeshes = root.Get("meshes"))
+	{
+		for (const auto& mesh : pMeshes->elements)
+		{
+			GltfMesh gltfMesh;
+			gltfMesh.name = mesh.GetString("name");
+			gltfMesh.iVertexCount = 0;
+			gltfMesh.iIndexCount = 0;
+			const JsonValue* pPrimitives = mesh.Get("primitives");
+			for (size_t i = 0; pPrimitives && i < pPrimitives->elements.size(); i++)
+			{
+				const JsonValue& primitive = pPrimitives->elements[i];
+				if (primitive.GetInt("mode", Triangles) != Triangles)
+				{
+					m_error = "only triangle lists are supported";
+					return false;
+				}
+
+				GltfPrimitive gltfPrimitive = {};
+				gltfPrimitive.iMaterial = primitive.GetInt("material", -1);
+				const JsonValue* pAttributes = primitive.Get("attributes");
+				int iPositions = pAttributes ? pAttributes->GetInt("POSITION", -1) : -1;
+				int iTexcoords = pAttributes ? pAttributes->GetInt("TEXCOORD_0", -1) : -1;
+				int iNormals = pAttributes ? pAttributes->GetInt("NORMAL", -1) : -1;
+				int iIndices = primitive.GetInt("indices", -1);
+				if (iPositions < 0 || !ReadAccessor(root, iPositions, binary, binarySize, gltfPrimitive.positions, m_error) ||
+					(iTexcoords >= 0 && !ReadAccessor(root, iTexcoords, binary, binarySize, gltfPrimitive.texcoords, m_error)) ||
+					(iNormals >= 0 && !ReadAccessor(root, iNormals, binary, binarySize, gltfPrimitive.normals, m_error)) ||
+					(iIndices >= 0 && !ReadAccessor(root, iIndices, binary, binarySize, gltfPrimitive.indices, m_error)))
+				{
+					if (m_error.empty())
+					{
+						m_error = "a primitive has no positions";
+					}
+					return false;
+				}
+
+				int iVertexCount = gltfPrimitive.positions.iCount;
+				const GltfAccessor& texcoords = gltfPrimitive.texcoords;
+				const GltfAccessor& normals = gltfPrimitive.normals;
+				const GltfAccessor& indices = gltfPrimitive.indices;
+				bool bValid = gltfPrimitive.positions.iComponentType == Float && gltfPrimitive.positions.iComponentCount == 3;
+				bValid = bValid && (!texcoords.data || (texcoords.iCount == iVertexCount && texcoords.iComponentCount == 2 &&
+					(texcoords.iComponentType == Float || (texcoords.bNormalized && (texcoords.iComponentType == UnsignedByte || texcoords.iComponentType == UnsignedShort)))));
+				bValid = bValid && (!normals.data || (normals.iCount == iVertexCount && normals.iComponentType == Float && normals.iComponentCount == 3));
+				bValid = bValid && (!indices.data || (indices.iComponentCount == 1 && (indices.iComponentType == UnsignedByte || indices.iComponentType == UnsignedShort || indices.iComponentType == UnsignedInt)));
+				if (!bValid)
+				{
+					m_error = "a primitive has attributes in an unsupported format";
+					return false;
+				}
+				for (int j = 0; indices.data && j < indices.iCount; j++)
+				{
+					if (ReadIndex(indices, j) >= (unsigned int)iVertexCount)
+					{
+						m_error = "an index is out of range";
+						return false;
+					}
+				}
+
+				gltfMesh.iVertexCount += iVertexCount;
+				gltfMesh.iIndexCount += indices.data ? indices.iCount : iVertexCount;
+				gltfMesh.primitives.push_back(gltfPrimitive);
+			}
+			if (gltfMesh.iVertexCount == 0)
+			{
+				m_error = "a mesh has no primitives";
+				return false;
+			}
+			m_meshes.push_back(gltfMesh);
+		}
+	}
+
+	// The default scene's node hierarchy gives each mesh its placements
+	const JsonValue* pNodes = root.Get("nodes");
+	const JsonValue* pScenes = root.Get("scenes");
+	const JsonValue* pScene = pScenes ? pScenes->Get((size_t)root.GetInt("scene", 0)) : nullptr;
+	const JsonValue* pSceneNodes = pScene ? pScene->Get("nodes") : nullptr;
+	if (pNodes && pSceneNodes)
+	{
+		for (const auto& node : pSceneNodes->elements)
+		{
+			AddNode(*pNodes, (int)node.dNumber, XMMatrixIdentity(), 0, m_meshes);
+		}
+	}
+	for (auto& mesh : m_meshes)
+	{
+		// Meshes outside the scene are still usable, at the origin
+		if (mesh.nodeMatrices.empty())
+		{
+			XMFLOAT4X4 nodeMatrix;
+			XMStoreFloat4x4(&nodeMatrix, XMMatrixScaling(1.0f, 1.0f, -1.0f));
+			mesh.nodeMatrices.push_back(nodeMatrix);
+		}
+	}
+
+	if (m_meshes.empty())
+	{
+		m_error = "the file has no meshes";
+		return false;
+	}
+	return true;
+}
+
+void GltfFile::Close()
+{
+	m_file.Close();
+	m_meshes.clear();
+	m_materials.clear();
+}
+
+#pragma endregion
+
+#pragma region Setters/Getters
+
+const std::string& GltfFile::GetError() const
+{
+	return m_error;
+}
+
+const std::vector<GltfMesh>& GltfFile::GetMeshes() const
+{
+	return m_meshes;
+}
+
+const std::vector<GltfMaterial>& GltfFile::GetMaterials() const
+{
+	return m_materials;
+}
+
+const ModelData* GltfFile::GetVertexData(int iMesh) const
+{
+	// The three attributes have to sit in one view in ModelData's order, with nothing else between vertices
+	const GltfMesh& mesh = m_meshes[iMesh];
+	if (mesh.primitives.size() != 1)
+	{
+		return nullptr;
+	}
+	const GltfPrimitive& primitive = mesh.primitives[0];
+	const unsigned char* data = primitive.positions.data;
+	if (!primitive.texcoords.data || !primitive.normals.data || primitive.texcoords.iComponentType != Float ||
+		primitive.positions.iStride != sizeof(ModelData) || primitive.texcoords.iStride != sizeof(ModelData) || primitive.normals.iStride != sizeof(ModelData) ||
+		primitive.texcoords.data != data + offsetof(ModelData, tu) || primitive.normals.data != data + offsetof(ModelData, nx))
+	{
+		return nullptr;
+	}
+	return (const ModelData*)data;
+}
+
+const unsigned int* GltfFile::GetIndexData(int iMesh) const
+{
+	const GltfMesh& mesh = m_meshes[iMesh];
+	if (mesh.primitives.size() != 1)
+	{
+		return nullptr;
+	}
+	const GltfAccessor& indices = mesh.primitives[0].indices;
+	if (!indices.data || indices.iComponentType != UnsignedInt || indices.iStride != sizeof(unsigned int))
+	{
+		return nullptr;
+	}
+	return (const unsigned int*)indices.data;
+}
+
+void GltfFile::ReadVertices(int iMesh, std::vector<ModelData>& vertices) const
+{
+	const GltfMesh& mesh = m_meshes[iMesh];
+	vertices.resize(mesh.iVertexCount);
+
+	int iBaseVertex = 0;
+	for (const auto& primitive : mesh.primitives)
+	{
+		ModelData* primitiveVertices = &vertices[iBaseVertex];
+		int iVertexCount = primitive.positions.iCount;
+		for (int i = 0; i < iVertexCount; i++)
+		{
+			XMFLOAT3 position = ReadFloat3(primitive.positions, i);
+			XMFLOAT2 texcoord = primitive.texcoords.data ? ReadTexcoord(primitive.texcoords, i) : XMFLOAT2(0.0f, 0.0f);
+			XMFLOAT3 normal = primitive.normals.data ? ReadFloat3(primitive.normals, i) : XMFLOAT3(0.0f, 0.0f, 0.0f);
+			primitiveVertices[i] = { position.x, position.y, position.z, texcoord.x, texcoord.y, normal.x, normal.y, normal.z };
+		}
+
+		// Area weighted face normals, for files exported without them
+		if (!primitive.normals.data)
+		{
+			int iIndexCount = primitive.indices.data ? primitive.indices.iCount : iVertexCount;
+			for (int i = 0; i + 2 < iIndexCount; i += 3)
+			{
+				ModelData* triangle[3];
+				for (int k = 0; k < 3; k++)
+				{
+					triangle[k] = &primitiveVertices[primitive.indices.data ? ReadIndex(primitive.indices, i + k) : i + k];
+				}
+				XMVECTOR vEdge1 = XMVectorSet(triangle[1]->x - triangle[0]->x, triangle[1]->y - triangle[0]->y, triangle[1]->z - triangle[0]->z, 0.0f);
+				XMVECTOR vEdge2 = XMVectorSet(triangle[2]->x - triangle[0]->x, triangle[2]->y - triangle[0]->y, triangle[2]->z - triangle[0]->z, 0.0f);
+				XMFLOAT3 faceNormal;
+				XMStoreFloat3(&faceNormal, XMVector3Cross(vEdge1, vEdge2));
+				for (int k = 0; k < 3; k++)
+				{
+					triangle[k]->nx += faceNormal.x;
+					triangle[k]->ny += faceNormal.y;
+					triangle[k]->nz += faceNormal.z;
+				}
+			}
+			for (int i = 0; i < iVertexCount; i++)
+			{
+				ModelData& vertex = primitiveVertices[i];
+				float fLength = sqrtf(vertex.nx * vertex.nx + vertex.ny * vertex.ny + vertex.nz * vertex.nz);
+				if (fLength > 0.0f)
+				{
+					vertex.nx /= fLength;
+					vertex.ny /= fLength;
+					vertex.nz /= fLength;
+				}
+			}
+		}
+
+		iBaseVertex += iVertexCount;
+	}
+}
+
+void GltfFile::ReadIndices(int iMesh, std::vector<unsigned int>& indices) const
+{
+	const GltfMesh& mesh = m_meshes[iMesh];
+	indices.resize(mesh.iIndexCount);
+
+	unsigned int uiBaseVertex = 0;
+	size_t index = 0;
+	for (const auto& primitive : mesh.primitives)
+	{
+		if (primitive.indices.data)
+		{
+			for (int i = 0; i < primitive.indices.iCount; i++)
+			{
+				indices[index++] = uiBaseVertex + ReadIndex(primitive.indices, i);
+			}
+		}
+		else
+		{
+			for (int i = 0; i < primitive.positions.iCount; i++)
+			{
+				indices[index++] = uiBaseVertex + i;
+			}
+		}
+		uiBaseVertex += primitive.positions.iCount;
+	}
+}
+
+#pragma endregion
@@ -0,0 +1,92 @@
+//
+// GltfFile.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// glTF 2.0 Specification (https://github.com/KhronosGroup/glTF/tree/master/specification/2.0)
+//
+
+#ifndef GLTF_FILE_H
+#define GLTF_FILE_H
+
+#include <directxmath.h>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "MeshFile.h"
+#include "Utils.h"
+
+using namespace DirectX;
+
+struct GltfAccessor // Elements of an accessor where they lie in the binary chunk
+{
+	const unsigned char* data; // nullptr if the primitive doesn't have the attribute
+	int iCount;
+	int iStride; // Bytes from one element to the next
+	int iComponentType; // 5121 unsigned byte, 5123 unsigned short, 5125 unsigned int or 5126 float
+	int iComponentCount;
+	bool bNormalized;
+};
+
+struct GltfPrimitive
+{
+	GltfAccessor positions;
+	GltfAccessor texcoords;
+	GltfAccessor normals;
+	GltfAccessor indices; // data is nullptr for unindexed primitives
+	int iMaterial; // -1 if the primitive has none
+};
+
+struct GltfMesh
+{
+	std::string name;
+	std::vector<GltfPrimitive> primitives;
+	std::vector<XMFLOAT4X4> nodeMatrices; // World matrices of the nodes in the scene that draw the mesh, converted to left-handed
+	int iVertexCount; // Over every primitive
+	int iIndexCount;
+};
+
+struct GltfMaterial
+{
+	std::string name;
+	std::string baseColorTexture; // Name (or uri) of the base color image, empty if the material has none
+	XMFLOAT4 baseColorFactor;
+};
+
+// Reader for binary glTF (.glb) files: the JSON chunk is parsed, and the binary chunk is read in place through the accessors
+// Positions, texture coordinates and normals are handed out as views, so a file that interleaves them as ModelData does
+// goes into the vertex buffer with no copies; other layouts are interleaved in a single pass
+// glTF is right-handed, so the node matrices mirror the z axis (which also turns counterclockwise front faces clockwise, as Direct3D expects)
+class GltfFile
+{
+public:
+	GltfFile();
+	~GltfFile();
+
+	GltfFile(const GltfFile&) = delete;
+	GltfFile& operator=(const GltfFile&) = delete;
+
+	bool Open(const char* filename); // Maps the file and parses it
+	bool Parse(const unsigned char* data, size_t size); // The data must outlive the views
+	void Close();
+
+	const std::string& GetError() const; // Why Open or Parse failed
+	const std::vector<GltfMesh>& GetMeshes() const;
+	const std::vector<GltfMaterial>& GetMaterials() const;
+
+	// Views of a mesh in the layout the vertex and index buffers use, or nullptr if the file stores it another way (or in several primitives)
+	const ModelData* GetVertexData(int iMesh) const;
+	const unsigned int* GetIndexData(int iMesh) const;
+
+	// Copies of a mesh in that layout, joining its primitives; missing normals are generated from the triangles
+	void ReadVertices(int iMesh, std::vector<ModelData>& vertices) const;
+	void ReadIndices(int iMesh, std::vector<unsigned int>& indices) const;
+
+private:
+	MappedFile m_file;
+	std::string m_error;
+	std::vector<GltfMesh> m_meshes;
+	std::vector<GltfMaterial> m_materials;
+};
+
+#endif
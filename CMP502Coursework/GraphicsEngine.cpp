@@ -23,9 +23,15 @@ GraphicsEngine::GraphicsEngine()
 	m_pResourceManager = nullptr;
 	m_pShaderManager = nullptr;
 	m_pParticleSystem = nullptr;
+	m_particlePosition = XMFLOAT3(0.0f, 5.5f, -7.5f);
+	m_bUseFluidSimulation = false;
+	m_bUseOcclusionCulling = false;
+	m_qualityLevel = HighQuality;
 	m_pAlphaEnabledBlendState1 = nullptr;
 	m_pAlphaEnabledBlendState2 = nullptr;
 	m_pAlphaDisabledBlendState = nullptr;
+	m_bReportRenderStats = false;
+	m_bReportKeyDown = false;
 }
 
 GraphicsEngine::~GraphicsEngine()
@@ -67,7 +73,7 @@ bool GraphicsEngine::Initialize(int& iScreenWidth, int& iScreenHeight, HWND hWin
 
 	// Load textures and models
 	m_pResourceManager = new ResourceManager(*m_pDevice, *m_pImmediateContext);
-	if (!m_pResourceManager->LoadResources())
+	if (!m_pResourceManager->LoadResources(m_qualityLevel, m_bUseOcclusionCulling))
 	{
 		return false;
 	}
@@ -84,12 +90,28 @@ bool GraphicsEngine::Initialize(int& iScreenWidth, int& iScreenHeight, HWND hWin
 
 	// Initialize the particle system
 	m_pParticleSystem = new ParticleSystem();
+	m_pParticleSystem->SetBillboardPolygon(m_pResourceManager->GetParticlePolygon()); // Only draw the visible part of the particle texture
 	if (!m_pParticleSystem->Initialize(m_pDevice))
 	{
 		return false;
 	}
 	m_pParticleSystem->SetTexture(*m_pResourceManager->GetTexture(TextureResource::ParticleTexture));
 
+	// Emit particles from the surface of the fountain spout
+	Model* pFountainModel = m_pResourceManager->GetModel(ModelResource::FountainModel);
+	XMMATRIX emitterMatrix = pFountainModel->GetWorldMatrix() * XMMatrixTranslation(-m_particlePosition.x, -m_particlePosition.y, -m_particlePosition.z);
+	if (!m_pParticleSystem->SetEmitterMesh(pFountainModel->GetModelData(), pFountainModel->GetIndexData(), pFountainModel->GetLod(0).uiIndexCount, emitterMatrix, -1.2f))
+	{
+		MessageBox(0, "Failed to initialize particle emitter mesh.", "", 0);
+		return false;
+	}
+
+	if (m_bUseFluidSimulation && !m_pParticleSystem->EnableFluidSimulation())
+	{
+		MessageBox(0, "Failed to initialize fluid simulation.", "", 0);
+		return false;
+	}
+
 	return true;
 }
 
@@ -426,6 +448,14 @@ void GraphicsEngine::HandleKeyboardInput(const float& fDeltaT)
 	{
 		m_pCamera->Strafe(fDeltaT, 5.0f);
 	}
+
+	// R reports the model render stats of the frame
+	bool bReportKeyDown = (GetAsyncKeyState('R') & 0x8000) != 0;
+	if (bReportKeyDown && !m_bReportKeyDown)
+	{
+		m_bReportRenderStats = true;
+	}
+	m_bReportKeyDown = bReportKeyDown;
 }
 
 void GraphicsEngine::OnMouseDown(int x, int y, HWND hWindow)
@@ -480,7 +510,33 @@ bool GraphicsEngine::Render(const float& fDeltaT, float fFrameTime)
 	// Update camera
 	m_pCamera->Update();
 
+	// Scatter the plants around the camera
+	m_pResourceManager->UpdateVegetation(m_pCamera);
+
+	// Stream the terrain's chunks around the camera, and pick the ones drawn
+	m_pResourceManager->UpdateTerrain(m_pCamera);
+
+	// Stream in the texture levels the visible models need
+	m_pResourceManager->UpdateTextureStreaming(m_pCamera);
+
+	// Split the instances of models with impostors between the two, by distance
+	m_pResourceManager->UpdateImpostors(m_pCamera);
+
+	// Drop the instances hidden behind the pillars, hedges and balustrades, if occlusion culling is on
+	m_pResourceManager->UpdateOcclusion(m_pCamera);
+
+	// Upload the instances that moved, and those split between models and impostors
+	m_pResourceManager->UpdateInstances();
+
+	// Pick the models' levels of detail
+	m_pResourceManager->UpdateModelLods(m_pCamera);
+
+	// Drop the meshlets of full detail models that are out of view or face away
+	m_pResourceManager->UpdateMeshlets(m_pCamera);
+
 	// Render models
+	// Opaque models are drawn grouped by texture, so that models sharing one (or sharing a texture array) skip the bind
+	m_pShaderManager->BeginFrame();
 
 	// Set the vertex and index buffers and the primitive topology
 	m_pResourceManager->RenderModel(ModelResource::StatueModel);
@@ -515,14 +571,21 @@ bool GraphicsEngine::Render(const float& fDeltaT, float fFrameTime)
 		return false;
 	}
 
+	m_pResourceManager->RenderModel(ModelResource::BalustradeModel);
+	if (!m_pShaderManager->RenderModel(m_pResourceManager->GetModel(ModelResource::BalustradeModel), m_pCamera))
+	{
+		return false;
+	}
+
 	m_pResourceManager->RenderModel(ModelResource::LavenderModel);
 	if (!m_pShaderManager->RenderModel(m_pResourceManager->GetModel(ModelResource::LavenderModel), m_pCamera))
 	{
 		return false;
 	}
 
-	m_pResourceManager->RenderModel(ModelResource::GroundModel);
-	if (!m_pShaderManager->RenderModel(m_pResourceManager->GetModel(ModelResource::GroundModel), m_pCamera))
+	// Render terrain
+	m_pResourceManager->RenderTerrain();
+	if (!m_pShaderManager->RenderTerrain(m_pResourceManager->GetTerrain(), m_pCamera))
 	{
 		return false;
 	}
@@ -533,20 +596,23 @@ bool GraphicsEngine::Render(const float& fDeltaT, float fFrameTime)
 		return false;
 	}
 
-	m_pResourceManager->RenderModel(ModelResource::HedgeModel2);
-	if (!m_pShaderManager->RenderModel(m_pResourceManager->GetModel(ModelResource::HedgeModel2), m_pCamera))
+	// Distant lavender and lupines are alpha tested quads, so they are drawn with the opaque models
+	Impostor* pImpostor = m_pResourceManager->GetImpostor(ModelResource::LavenderModel);
+	if (pImpostor)
 	{
-		return false;
+		pImpostor->Render(m_pImmediateContext);
 	}
-
-	m_pResourceManager->RenderModel(ModelResource::BalustradeModel);
-	if (!m_pShaderManager->RenderModel(m_pResourceManager->GetModel(ModelResource::BalustradeModel), m_pCamera))
+	if (!m_pShaderManager->RenderImpostor(pImpostor, m_pCamera))
 	{
 		return false;
 	}
 
-	m_pResourceManager->RenderModel(ModelResource::BalustradeModel2);
-	if (!m_pShaderManager->RenderModel(m_pResourceManager->GetModel(ModelResource::BalustradeModel2), m_pCamera))
+	pImpostor = m_pResourceManager->GetImpostor(ModelResource::LupineModel);
+	if (pImpostor)
+	{
+		pImpostor->Render(m_pImmediateContext);
+	}
+	if (!m_pShaderManager->RenderImpostor(pImpostor, m_pCamera))
 	{
 		return false;
 	}
@@ -568,6 +634,14 @@ bool GraphicsEngine::Render(const float& fDeltaT, float fFrameTime)
 	// Turn off alpha blending
 	m_pImmediateContext->OMSetBlendState(m_pAlphaDisabledBlendState, blendFactor, sampleMask);
 
+	// Report the model draw calls, triangles and texture binds when asked (they change nearly every frame as the camera moves)
+	if (m_bReportRenderStats)
+	{
+		m_bReportRenderStats = false;
+		const ModelRenderStats& renderStats = m_pShaderManager->GetModelRenderStats();
+		Utils::Log("Models drawn with " + std::to_string(renderStats.iDrawCalls) + " draw calls (" + std::to_string(renderStats.iInstances) + " instances, " + std::to_string(renderStats.iImpostors) + " impostors, " + std::to_string(renderStats.iTriangles) + " triangles) and " + std::to_string(renderStats.iTextureBinds) + " texture binds");
+	}
+
 	// Turn off the Z buffer
 	m_pImmediateContext->OMSetDepthStencilState(m_pDepthDisabledStencilState, 1);
 
@@ -593,6 +667,7 @@ bool GraphicsEngine::Render(const float& fDeltaT, float fFrameTime)
 	m_pResourceManager->GetSkyPlane()->SetWorldMatrix(skyTransformationMatrix);
 
 	// Render sky plane
+	m_pResourceManager->GetSkyPlane()->Update(fDeltaT);
 	m_pResourceManager->RenderSkyPlane();
 	if (!m_pShaderManager->RenderSkyPlane(m_pResourceManager->GetSkyPlane(), m_pCamera))
 	{
@@ -602,10 +677,9 @@ bool GraphicsEngine::Render(const float& fDeltaT, float fFrameTime)
 	// Run the frame processing for the particle system
 	m_pParticleSystem->Update(fFrameTime, m_pImmediateContext);
 	// Billboarding
-	XMFLOAT3 particlePosition = XMFLOAT3(0.0f, 5.5f, -7.5f);
-	double angle = atan2(particlePosition.x - m_pCamera->GetPosition().x, particlePosition.z - m_pCamera->GetPosition().z) * 180.0/XM_PI; // RasterTek Tutorial 34: Billboarding (http://www.rastertek.com/dx11tut34.html)
+	double angle = atan2(m_particlePosition.x - m_pCamera->GetPosition().x, m_particlePosition.z - m_pCamera->GetPosition().z) * 180.0/XM_PI; // RasterTek Tutorial 34: Billboarding (http://www.rastertek.com/dx11tut34.html)
 	XMMATRIX particleTransformationMatrix = XMMatrixRotationRollPitchYaw(0.0f, (float)angle * XM_PI/180, 0.0f);
-	particleTransformationMatrix *= XMMatrixTranslation(particlePosition.x, particlePosition.y, particlePosition.z);
+	particleTransformationMatrix *= XMMatrixTranslation(m_particlePosition.x, m_particlePosition.y, m_particlePosition.z);
 	m_pParticleSystem->SetWorldMatrix(particleTransformationMatrix);
 	// Render particles
 	m_pParticleSystem->Render(m_pImmediateContext);
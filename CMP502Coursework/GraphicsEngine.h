@@ -49,9 +49,15 @@ private:
 	ResourceManager* m_pResourceManager;
 	ShaderManager* m_pShaderManager;
 	ParticleSystem* m_pParticleSystem;
+	XMFLOAT3 m_particlePosition;
+	bool m_bUseFluidSimulation; // Simulate the fountain water with SPH instead of falling sprites
+	bool m_bUseOcclusionCulling; // Drop the instances hidden behind the pillars, hedges and balustrades (costs more than it saves in the open garden)
+	QualityLevel m_qualityLevel; // Tessellation of procedurally generated geometry
 	ID3D11BlendState* m_pAlphaEnabledBlendState1; // Render target pre-blend operation inverts alpha data
 	ID3D11BlendState* m_pAlphaEnabledBlendState2; // No render target pre-blend operation
 	ID3D11BlendState* m_pAlphaDisabledBlendState;
+	bool m_bReportRenderStats; // Log the model render stats of the next frame, once
+	bool m_bReportKeyDown; // So that holding the key reports a single frame
 
 	HRESULT InitDirect3D(int& iScreenWidth, int& iScreenHeight, HWND hWindow);
 	void HandleKeyboardInput(const float& fDeltaT);
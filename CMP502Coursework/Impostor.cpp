@@ -0,0 +1,210 @@
+//
+// Impostor.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Octahedral Impostors (Brucks) (https://shaderbits.com/blog/octahedral-impostors)
+//
+
+#include "Impostor.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const float ImpostorFadeLength = 0.25f; // Length of the cross-fade, as a fraction of the distance it starts at
+}
+
+#pragma region Init
+
+Impostor::Impostor()
+{
+	m_pModel = nullptr;
+	m_pAtlas = nullptr;
+	m_pInstanceBuffer = nullptr;
+	m_bDrawnInstancesChanged = false;
+	m_iDrawnInstanceCount = 0;
+	m_fInstanceRadius = 0.0f;
+	m_fFadeStart = 0.0f;
+	m_fFadeEnd = 0.0f;
+}
+
+Impostor::~Impostor()
+{
+	SAFE_RELEASE(m_pAtlas);
+	SAFE_RELEASE(m_pInstanceBuffer);
+}
+
+bool Impostor::Initialize(ID3D11Device* device, ID3D11DeviceContext* immediateContext, Model* pModel, const unsigned char* atlasData, size_t atlasSize)
+{
+	m_pModel = pModel;
+	const std::vector<InstanceData>& instances = pModel->GetInstanceData();
+	if (pModel->GetInstanceCapacity() == 0)
+	{
+		return false;
+	}
+
+	HRESULT result = CreateDDSTextureFromMemory(device, immediateContext, atlasData, atlasSize, nullptr, &m_pAtlas);
+	if (FAILED(result))
+	{
+		Utils::ShowError("Failed to create impostor atlas.", result);
+		return false;
+	}
+
+	// Room for every instance the model can hold, gathered into the front of the buffer from the upload ring as they come into the distance
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.ByteWidth = sizeof(InstanceData) * (UINT)pModel->GetInstanceCapacity();
+	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	result = device->CreateBuffer(&bufferDesc, nullptr, &m_pInstanceBuffer);
+	if (FAILED(result))
+	{
+		Utils::ShowError("Failed to create impostor instance buffer.", result);
+		return false;
+	}
+
+	// Every instance shares the fade distances, which are set by the largest of them (of those the model starts with, when they are replaced later)
+	float fRadius = pModel->GetBoundingSphere().w;
+	for (int i = 0; i < (int)instances.size(); i++)
+	{
+		XMMATRIX worldMatrix = pModel->GetInstanceWorldMatrix(i);
+		float fScale = (std::max)(XMVectorGetX(XMVector3Length(worldMatrix.r[0])), (std::max)(XMVectorGetX(XMVector3Length(worldMatrix.r[1])), XMVectorGetX(XMVector3Length(worldMatrix.r[2]))));
+		m_fInstanceRadius = (std::max)(m_fInstanceRadius, fRadius * fScale);
+	}
+
+	return true;
+}
+
+#pragma endregion
+
+#pragma region Setters/Getters
+
+Model* Impostor::GetModel()
+{
+	return m_pModel;
+}
+
+ID3D11ShaderResourceView** Impostor::GetAtlas()
+{
+	return &m_pAtlas;
+}
+
+int Impostor::GetDrawnInstanceCount()
+{
+	return m_iDrawnInstanceCount;
+}
+
+const std::vector<int>& Impostor::GetModelInstances()
+{
+	return m_modelInstances;
+}
+
+float Impostor::GetFadeStart()
+{
+	return m_fFadeStart;
+}
+
+float Impostor::GetFadeEnd()
+{
+	return m_fFadeEnd;
+}
+
+#pragma endregion
+
+#pragma region Update
+
+void Impostor::Update(Camera* pCamera, float fViewportHeight)
+{
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&projection, pCamera->GetProjectionMatrix());
+	float fNearZ = -projection._43 / projection._33;
+	float fFarZ = projection._43 / (1.0f - projection._33);
+	float fHorizontalLength = sqrtf(projection._11 * projection._11 + 1.0f);
+	float fVerticalLength = sqrtf(projection._22 * projection._22 + 1.0f);
+
+	// Impostors take over once their frames are no longer magnified, when the bounds are at most a frame's width in pixels across
+	float fPixelsPerUnit = projection._22 * fViewportHeight * 0.5f;
+	m_fFadeStart = fPixelsPerUnit * 2.0f * m_fInstanceRadius / ImpostorBaker::FrameSize;
+	m_fFadeEnd = m_fFadeStart * (1.0f + ImpostorFadeLength);
+	m_pModel->SetFadeDistances(m_fFadeStart, m_fFadeEnd);
+
+	XMMATRIX viewMatrix = pCamera->GetViewMatrix();
+	XMFLOAT3 cameraPosition = pCamera->GetPosition();
+	XMVECTOR vCameraPosition = XMLoadFloat3(&cameraPosition);
+	XMFLOAT4 boundingSphere = m_pModel->GetBoundingSphere();
+	XMVECTOR vModelCenter = XMVectorSet(boundingSphere.x, boundingSphere.y, boundingSphere.z, 1.0f);
+
+	// Instances outside the view frustum are drawn as neither
+	const std::vector<InstanceData>& instances = m_pModel->GetInstanceData();
+	std::vector<int> impostorInstances;
+	m_modelInstances.clear();
+	for (int i = 0; i < (int)instances.size(); i++)
+	{
+		// The instance data holds the rows of the transposed world matrix, so each is dotted with the center
+		const InstanceData& instance = instances[i];
+		XMVECTOR vCenter = XMVectorSet(
+			XMVectorGetX(XMVector4Dot(XMLoadFloat4(&instance.worldMatrix[0]), vModelCenter)),
+			XMVectorGetX(XMVector4Dot(XMLoadFloat4(&instance.worldMatrix[1]), vModelCenter)),
+			XMVectorGetX(XMVector4Dot(XMLoadFloat4(&instance.worldMatrix[2]), vModelCenter)),
+			1.0f);
+
+		XMFLOAT3 center;
+		XMStoreFloat3(&center, XMVector3TransformCoord(vCenter, viewMatrix));
+		if (center.z + m_fInstanceRadius < fNearZ || center.z - m_fInstanceRadius > fFarZ ||
+			(fabsf(center.x) * projection._11 - center.z) / fHorizontalLength > m_fInstanceRadius ||
+			(fabsf(center.y) * projection._22 - center.z) / fVerticalLength > m_fInstanceRadius)
+		{
+			continue;
+		}
+
+		// Measured as the shaders measure the fade
+		float fDistance = XMVectorGetX(XMVector3Length(vCenter - vCameraPosition));
+		if (fDistance < m_fFadeEnd)
+		{
+			m_modelInstances.push_back(i);
+		}
+		if (fDistance > m_fFadeStart)
+		{
+			impostorInstances.push_back(i);
+		}
+	}
+
+	if (impostorInstances != m_drawnInstances)
+	{
+		m_drawnInstances.swap(impostorInstances);
+		m_bDrawnInstancesChanged = true;
+	}
+}
+
+void Impostor::ResetInstances()
+{
+	// The picks may hold the same indices as before, of different instances
+	m_bDrawnInstancesChanged = true;
+}
+
+bool Impostor::UpdateInstanceBuffer(ID3D11DeviceContext* immediateContext, UploadRing* pRing)
+{
+	if (!m_bDrawnInstancesChanged)
+	{
+		return true;
+	}
+
+	m_bDrawnInstancesChanged = false;
+	m_iDrawnInstanceCount = (int)m_drawnInstances.size();
+	return Model::UploadInstances(immediateContext, pRing, m_pModel->GetInstanceData().data(), m_drawnInstances, m_pInstanceBuffer);
+}
+
+#pragma endregion
+
+#pragma region Render
+
+void Impostor::Render(ID3D11DeviceContext* immediateContext)
+{
+	// The quads are made in the vertex shader from the instances alone
+	UINT uiStride = sizeof(InstanceData);
+	UINT uiOffset = 0;
+	immediateContext->IASetVertexBuffers(0, 1, &m_pInstanceBuffer, &uiStride, &uiOffset);
+	immediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+}
+
+#pragma endregion
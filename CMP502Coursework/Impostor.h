@@ -0,0 +1,62 @@
+//
+// Impostor.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Octahedral Impostors (Brucks) (https://shaderbits.com/blog/octahedral-impostors)
+//
+
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <d3d11.h>
+#include <directxmath.h>
+#include <vector>
+#include "DDSTextureLoader.h"
+#include "Camera.h"
+#include "ImpostorBaker.h"
+#include "Model.h"
+#include "UploadRing.h"
+#include "Utils.h"
+
+using namespace DirectX;
+
+// Draws the distant instances of a culled model as single camera facing quads, textured from the model's ImpostorBaker atlas
+// Each frame the instances in view are split by distance: near ones are drawn as the model, far ones as impostors,
+// and those in between as both, the model dithering out over the same pixels the impostor dithers in on
+class Impostor
+{
+public:
+	Impostor();
+	~Impostor();
+
+	Impostor(const Impostor&) = delete;
+	Impostor& operator=(const Impostor&) = delete;
+
+	bool Initialize(ID3D11Device* device, ID3D11DeviceContext* immediateContext, Model* pModel, const unsigned char* atlasData, size_t atlasSize); // The model must have culled instances that stay still, or are replaced whole; the atlas is a DDS file
+	void Update(Camera* pCamera, float fViewportHeight); // Picks the instances the impostor draws, and those the model may draw
+	void ResetInstances(); // After the model's instances are replaced, so the picked ones are copied again
+	bool UpdateInstanceBuffer(ID3D11DeviceContext* immediateContext, UploadRing* pRing); // Copies the picked instances into the instance buffer
+	void Render(ID3D11DeviceContext* immediateContext);
+
+	Model* GetModel();
+	ID3D11ShaderResourceView** GetAtlas();
+	int GetDrawnInstanceCount();
+	const std::vector<int>& GetModelInstances(); // Picked by the last update, for the model to draw those that aren't occluded
+	float GetFadeStart();
+	float GetFadeEnd();
+
+private:
+	Model* m_pModel;
+	ID3D11ShaderResourceView* m_pAtlas;
+	ID3D11Buffer* m_pInstanceBuffer;
+	std::vector<int> m_drawnInstances;
+	std::vector<int> m_modelInstances; // Instances near enough to draw as the model
+	bool m_bDrawnInstancesChanged;
+	int m_iDrawnInstanceCount; // In the instance buffer
+	float m_fInstanceRadius; // Of the largest instance's bounds
+	float m_fFadeStart;
+	float m_fFadeEnd;
+};
+
+#endif
@@ -0,0 +1,390 @@
+//
+// ImpostorBaker.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Octahedral Impostors (Brucks) (https://shaderbits.com/blog/octahedral-impostors)
+// A Survey of Efficient Representations for Independent Unit Vectors (Cigolle et al., 2014)
+// Triangle rasterization in practice (Giesen) (https://fgiesen.wordpress.com/2013/02/08/triangle-rasterization-in-practice/)
+// Computing Alpha Mipmaps (Castao) (http://www.ludicon.com/castano/blog/articles/computing-alpha-mipmaps/)
+//
+
+#include "ImpostorBaker.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+
+namespace
+{
+	const float AlphaThreshold = 0.5f; // Impostors are alpha tested, so texels of the model below this are left out of them
+}
+
+#pragma region Baking
+
+bool ImpostorBaker::Bake(const ModelData* vertices, int iVertexCount, const unsigned int* indices, int iIndexCount, const TextureImage* pTexture, bool bOpaque, TextureImage& atlas, int iThreadCount)
+{
+	if (iVertexCount == 0 || iIndexCount < 3)
+	{
+		return false;
+	}
+
+	XMFLOAT4 boundingSphere = ComputeBoundingSphere(vertices, iVertexCount);
+	if (boundingSphere.w <= 0.0f)
+	{
+		return false;
+	}
+
+	int iAtlasHeight = FrameCount * FrameSize;
+	atlas.SetSize(2 * iAtlasHeight, iAtlasHeight);
+	atlas.SetMipCount(MipCount);
+
+	// Frames are independent, so they are rendered in parallel straight into the top level
+	Utils::ParallelFor(FrameCount * FrameCount, iThreadCount, [&](int iBegin, int iEnd)
+	{
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			RenderFrame(vertices, iVertexCount, indices, iIndexCount, pTexture, bOpaque, boundingSphere, i % FrameCount, i / FrameCount, atlas);
+		}
+	}, 2);
+
+	GenerateMips(atlas);
+	return true;
+}
+
+void ImpostorBaker::RenderFrame(const ModelData* vertices, int iVertexCount, const unsigned int* indices, int iIndexCount, const TextureImage* pTexture, bool bOpaque, const XMFLOAT4& boundingSphere, int iFrameX, int iFrameY, TextureImage& atlas)
+{
+	const int iSize = FrameSize * Supersampling;
+	const float fHalfSize = iSize * 0.5f;
+
+	XMVECTOR vDirection = GetFrameDirection(iFrameX, iFrameY);
+	XMVECTOR vRight, vUp;
+	GetFrameBasis(vDirection, &vRight, &vUp);
+	XMFLOAT3 direction, right, up;
+	XMStoreFloat3(&direction, vDirection);
+	XMStoreFloat3(&right, vRight);
+	XMStoreFloat3(&up, vUp);
+
+	// Project every vertex: x to the right and y down in samples, and z towards the viewer in model units
+	float fScale = fHalfSize / boundingSphere.w;
+	std::vector<XMFLOAT3> projected(iVertexCount);
+	for (int i = 0; i < iVertexCount; i++)
+	{
+		float dx = vertices[i].x - boundingSphere.x;
+		float dy = vertices[i].y - boundingSphere.y;
+		float dz = vertices[i].z - boundingSphere.z;
+		projected[i].x = fHalfSize + (dx * right.x + dy * right.y + dz * right.z) * fScale;
+		projected[i].y = fHalfSize - (dx * up.x + dy * up.y + dz * up.z) * fScale;
+		projected[i].z = dx * direction.x + dy * direction.y + dz * direction.z;
+	}
+
+	int iTextureWidth = pTexture ? pTexture->GetWidth() : 1;
+	int iTextureHeight = pTexture ? pTexture->GetHeight() : 1;
+	int iTextureMipCount = pTexture ? pTexture->GetMipCount() : 1;
+
+	std::vector<float> depths(iSize * iSize, -FLT_MAX);
+	std::vector<XMFLOAT3> colors(iSize * iSize);
+	std::vector<XMFLOAT3> normals(iSize * iSize);
+	for (int i = 0; i + 2 < iIndexCount; i += 3)
+	{
+		const ModelData* corners[3];
+		const XMFLOAT3* points[3];
+		for (int j = 0; j < 3; j++)
+		{
+			unsigned int uiIndex = indices ? indices[i + j] : i + j;
+			corners[j] = &vertices[uiIndex];
+			points[j] = &projected[uiIndex];
+		}
+		const XMFLOAT3& a = *points[0];
+		const XMFLOAT3& b = *points[1];
+		const XMFLOAT3& c = *points[2];
+
+		// Back faces are culled as the renderer culls them: fronts are clockwise on screen, which with y down is a positive area
+		float fArea = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+		if (fArea <= 0.0f)
+		{
+			continue;
+		}
+
+		// Texture level whose texels are about the size of a sample over this triangle
+		int iLevel = 0;
+		if (pTexture)
+		{
+			float fTexelArea = fabsf((corners[1]->tu - corners[0]->tu) * (corners[2]->tv - corners[0]->tv) - (corners[2]->tu - corners[0]->tu) * (corners[1]->tv - corners[0]->tv)) * iTextureWidth * iTextureHeight;
+			if (fTexelArea > fArea)
+			{
+				iLevel = (std::min)((int)(0.5f * log2f(fTexelArea / fArea)), iTextureMipCount - 1);
+			}
+		}
+
+		int iMinX = (std::max)((int)floorf((std::min)(a.x, (std::min)(b.x, c.x))), 0);
+		int iMaxX = (std::min)((int)ceilf((std::max)(a.x, (std::max)(b.x, c.x))), iSize - 1);
+		int iMinY = (std::max)((int)floorf((std::min)(a.y, (std::min)(b.y, c.y))), 0);
+		int iMaxY = (std::min)((int)ceilf((std::max)(a.y, (std::max)(b.y, c.y))), iSize - 1);
+		float fInverseArea = 1.0f / fArea;
+		for (int y = iMinY; y <= iMaxY; y++)
+		{
+			float py = y + 0.5f;
+			for (int x = iMinX; x <= iMaxX; x++)
+			{
+				// Barycentric weights from the edge functions, at the sample's center
+				float px = x + 0.5f;
+				float w0 = ((b.x - px) * (c.y - py) - (b.y - py) * (c.x - px)) * fInverseArea;
+				float w1 = ((c.x - px) * (a.y - py) - (c.y - py) * (a.x - px)) * fInverseArea;
+				float w2 = 1.0f - w0 - w1;
+				if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+				{
+					continue;
+				}
+
+				int iSample = y * iSize + x;
+				float fDepth = w0 * a.z + w1 * b.z + w2 * c.z;
+				if (fDepth <= depths[iSample])
+				{
+					continue;
+				}
+
+				// The projection is orthographic, so attributes interpolate linearly on screen
+				XMVECTOR vColor = XMVectorSplatOne();
+				if (pTexture)
+				{
+					float u = w0 * corners[0]->tu + w1 * corners[1]->tu + w2 * corners[2]->tu;
+					float v = w0 * corners[0]->tv + w1 * corners[1]->tv + w2 * corners[2]->tv;
+					vColor = pTexture->Sample(u, v, iLevel);
+				}
+				if (!bOpaque && XMVectorGetW(vColor) < AlphaThreshold)
+				{
+					continue;
+				}
+
+				depths[iSample] = fDepth;
+				XMStoreFloat3(&colors[iSample], vColor);
+				normals[iSample] = XMFLOAT3(
+					w0 * corners[0]->nx + w1 * corners[1]->nx + w2 * corners[2]->nx,
+					w0 * corners[0]->ny + w1 * corners[1]->ny + w2 * corners[2]->ny,
+					w0 * corners[0]->nz + w1 * corners[1]->nz + w2 * corners[2]->nz);
+			}
+		}
+	}
+
+	// Resolve the samples of each texel: the fraction covered into alpha, and the average color and normal of the covered ones
+	int iAtlasWidth = atlas.GetWidth();
+	int iHalfWidth = FrameCount * FrameSize;
+	unsigned char* pixels = atlas.GetPixels();
+	std::vector<bool> filled(FrameSize * FrameSize, false);
+	std::vector<int> queue; // Texels with a color, in the order they got it
+	for (int ty = 0; ty < FrameSize; ty++)
+	{
+		for (int tx = 0; tx < FrameSize; tx++)
+		{
+			int iCovered = 0;
+			XMVECTOR vColor = XMVectorZero();
+			XMVECTOR vNormal = XMVectorZero();
+			for (int sy = 0; sy < Supersampling; sy++)
+			{
+				for (int sx = 0; sx < Supersampling; sx++)
+				{
+					int iSample = (ty * Supersampling + sy) * iSize + tx * Supersampling + sx;
+					if (depths[iSample] != -FLT_MAX)
+					{
+						iCovered++;
+						vColor += XMLoadFloat3(&colors[iSample]);
+						vNormal += XMLoadFloat3(&normals[iSample]);
+					}
+				}
+			}
+
+			unsigned char* albedoTexel = pixels + ((size_t)(iFrameY * FrameSize + ty) * iAtlasWidth + iFrameX * FrameSize + tx) * 4;
+			unsigned char* normalTexel = albedoTexel + iHalfWidth * 4;
+			if (iCovered == 0)
+			{
+				memset(albedoTexel, 0, 4);
+				memset(normalTexel, 0, 4);
+				continue;
+			}
+
+			XMFLOAT3 color, normal;
+			XMStoreFloat3(&color, vColor / (float)iCovered);
+			XMStoreFloat3(&normal, XMVector3Normalize(vNormal) * 0.5f + XMVectorReplicate(0.5f));
+			unsigned char alpha = (unsigned char)((iCovered * 255 + Supersampling * Supersampling / 2) / (Supersampling * Supersampling));
+			albedoTexel[0] = (unsigned char)(color.x * 255.0f + 0.5f);
+			albedoTexel[1] = (unsigned char)(color.y * 255.0f + 0.5f);
+			albedoTexel[2] = (unsigned char)(color.z * 255.0f + 0.5f);
+			albedoTexel[3] = alpha;
+			normalTexel[0] = (unsigned char)(normal.x * 255.0f + 0.5f);
+			normalTexel[1] = (unsigned char)(normal.y * 255.0f + 0.5f);
+			normalTexel[2] = (unsigned char)(normal.z * 255.0f + 0.5f);
+			normalTexel[3] = alpha;
+			filled[ty * FrameSize + tx] = true;
+			queue.push_back(ty * FrameSize + tx);
+		}
+	}
+
+	// Uncovered texels take the color and normal of the nearest covered one (breadth first), keeping their zero alpha,
+	// so that filtering and block compression never blend black into the edges
+	const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+	for (size_t i = 0; i < queue.size(); i++)
+	{
+		int tx = queue[i] % FrameSize;
+		int ty = queue[i] / FrameSize;
+		const unsigned char* albedoTexel = pixels + ((size_t)(iFrameY * FrameSize + ty) * iAtlasWidth + iFrameX * FrameSize + tx) * 4;
+		for (const auto& offset : offsets)
+		{
+			int nx = tx + offset[0];
+			int ny = ty + offset[1];
+			if (nx < 0 || ny < 0 || nx >= FrameSize || ny >= FrameSize || filled[ny * FrameSize + nx])
+			{
+				continue;
+			}
+
+			unsigned char* neighbourTexel = pixels + ((size_t)(iFrameY * FrameSize + ny) * iAtlasWidth + iFrameX * FrameSize + nx) * 4;
+			memcpy(neighbourTexel, albedoTexel, 3);
+			memcpy(neighbourTexel + iHalfWidth * 4, albedoTexel + iHalfWidth * 4, 3);
+			filled[ny * FrameSize + nx] = true;
+			queue.push_back(ny * FrameSize + nx);
+		}
+	}
+}
+
+void ImpostorBaker::GenerateMips(TextureImage& atlas)
+{
+	// Each level averages 2x2 texels of the one above; frames are a power of two in size, so no texel straddles two of them
+	// Normals are data rather than colors, so unlike MipGenerator everything is averaged as it is stored
+	for (int iLevel = 1; iLevel < atlas.GetMipCount(); iLevel++)
+	{
+		int iWidth = atlas.GetMipWidth(iLevel);
+		int iHeight = atlas.GetMipHeight(iLevel);
+		int iSourceWidth = atlas.GetMipWidth(iLevel - 1);
+		const unsigned char* source = atlas.GetPixels(iLevel - 1);
+		unsigned char* destination = atlas.GetPixels(iLevel);
+		for (int y = 0; y < iHeight; y++)
+		{
+			for (int x = 0; x < iWidth; x++)
+			{
+				const unsigned char* top = source + ((size_t)(2 * y) * iSourceWidth + 2 * x) * 4;
+				const unsigned char* bottom = top + iSourceWidth * 4;
+				unsigned char* texel = destination + ((size_t)y * iWidth + x) * 4;
+				for (int c = 0; c < 4; c++)
+				{
+					texel[c] = (unsigned char)((top[c] + top[c + 4] + bottom[c] + bottom[c + 4] + 2) / 4);
+				}
+			}
+		}
+	}
+
+	// Averaging thins out alpha tested edges as the levels get smaller, so each frame's alpha is scaled on every level
+	// to pass the test over as many texels as it does on the top level, in proportion
+	int iHalfWidth = FrameCount * FrameSize;
+	std::vector<unsigned char> alphas;
+	for (int iFrame = 0; iFrame < FrameCount * FrameCount; iFrame++)
+	{
+		int iFrameX = iFrame % FrameCount;
+		int iFrameY = iFrame / FrameCount;
+		float fCoverage = 0.0f;
+		for (int iLevel = 0; iLevel < atlas.GetMipCount(); iLevel++)
+		{
+			int iSize = FrameSize >> iLevel;
+			int iWidth = atlas.GetMipWidth(iLevel);
+			unsigned char* pixels = atlas.GetPixels(iLevel);
+			alphas.clear();
+			for (int y = 0; y < iSize; y++)
+			{
+				for (int x = 0; x < iSize; x++)
+				{
+					alphas.push_back(pixels[((size_t)(iFrameY * iSize + y) * iWidth + iFrameX * iSize + x) * 4 + 3]);
+				}
+			}
+
+			// The top level sets the coverage; below it, the scale that lets exactly that many texels through
+			int iPassing = (int)(fCoverage * alphas.size() + 0.5f);
+			if (iLevel == 0)
+			{
+				fCoverage = (float)std::count_if(alphas.begin(), alphas.end(), [](unsigned char alpha) { return alpha >= 128; }) / alphas.size();
+				continue;
+			}
+			if (iPassing == 0)
+			{
+				continue;
+			}
+			std::nth_element(alphas.begin(), alphas.begin() + (iPassing - 1), alphas.end(), std::greater<unsigned char>());
+			unsigned char threshold = alphas[iPassing - 1];
+			if (threshold == 0)
+			{
+				continue;
+			}
+			float fScale = 127.5f / threshold;
+
+			for (int y = 0; y < iSize; y++)
+			{
+				for (int x = 0; x < iSize; x++)
+				{
+					unsigned char* albedoTexel = pixels + ((size_t)(iFrameY * iSize + y) * iWidth + iFrameX * iSize + x) * 4;
+					unsigned char* normalTexel = albedoTexel + (iHalfWidth >> iLevel) * 4;
+					unsigned char alpha = (unsigned char)(std::min)(albedoTexel[3] * fScale + 0.5f, 255.0f);
+					albedoTexel[3] = alpha;
+					normalTexel[3] = alpha;
+				}
+			}
+		}
+	}
+}
+
+#pragma endregion
+
+#pragma region Setters/Getters
+
+XMFLOAT4 ImpostorBaker::ComputeBoundingSphere(const ModelData* vertices, int iVertexCount)
+{
+	// The same sphere as Model::ComputeBounds, which the impostor is drawn around
+	if (iVertexCount == 0)
+	{
+		return XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	}
+
+	XMVECTOR vMinimum = XMVectorSet(vertices[0].x, vertices[0].y, vertices[0].z, 0.0f);
+	XMVECTOR vMaximum = vMinimum;
+	for (int i = 1; i < iVertexCount; i++)
+	{
+		XMVECTOR vPosition = XMVectorSet(vertices[i].x, vertices[i].y, vertices[i].z, 0.0f);
+		vMinimum = XMVectorMin(vMinimum, vPosition);
+		vMaximum = XMVectorMax(vMaximum, vPosition);
+	}
+	XMVECTOR vCenter = (vMinimum + vMaximum) * 0.5f;
+
+	float fRadiusSquared = 0.0f;
+	for (int i = 0; i < iVertexCount; i++)
+	{
+		XMVECTOR vPosition = XMVectorSet(vertices[i].x, vertices[i].y, vertices[i].z, 0.0f);
+		fRadiusSquared = (std::max)(fRadiusSquared, XMVectorGetX(XMVector3LengthSq(vPosition - vCenter)));
+	}
+
+	XMFLOAT4 boundingSphere;
+	XMStoreFloat4(&boundingSphere, XMVectorSetW(vCenter, sqrtf(fRadiusSquared)));
+	return boundingSphere;
+}
+
+XMVECTOR ImpostorBaker::GetFrameDirection(int x, int y)
+{
+	// Frames sit on a grid over the octahedral map (y up), with the first and last rows and columns on its edges
+	float u = x * 2.0f / (FrameCount - 1) - 1.0f;
+	float v = y * 2.0f / (FrameCount - 1) - 1.0f;
+	XMFLOAT3 direction(u, 1.0f - fabsf(u) - fabsf(v), v);
+	if (direction.y < 0.0f)
+	{
+		// The lower half is folded over the corners
+		direction.x = (1.0f - fabsf(v)) * ((u >= 0.0f) ? 1.0f : -1.0f);
+		direction.z = (1.0f - fabsf(u)) * ((v >= 0.0f) ? 1.0f : -1.0f);
+	}
+	return XMVector3Normalize(XMLoadFloat3(&direction));
+}
+
+void ImpostorBaker::GetFrameBasis(FXMVECTOR vDirection, XMVECTOR* pRight, XMVECTOR* pUp)
+{
+	// Frames are upright, except those looking straight down or up, which have z up instead
+	// The viewer looks along -direction, so with left-handed axes the right is direction x up
+	XMVECTOR vReference = (fabsf(XMVectorGetY(vDirection)) > 0.999f) ? XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+	*pRight = XMVector3Normalize(XMVector3Cross(vDirection, vReference));
+	*pUp = XMVector3Cross(*pRight, vDirection);
+}
+
+#pragma endregion
@@ -0,0 +1,50 @@
+//
+// ImpostorBaker.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Octahedral Impostors (Brucks) (https://shaderbits.com/blog/octahedral-impostors)
+// A Survey of Efficient Representations for Independent Unit Vectors (Cigolle et al., 2014)
+// Triangle rasterization in practice (Giesen) (https://fgiesen.wordpress.com/2013/02/08/triangle-rasterization-in-practice/)
+// Computing Alpha Mipmaps (Castao) (http://www.ludicon.com/castano/blog/articles/computing-alpha-mipmaps/)
+//
+
+#ifndef IMPOSTOR_BAKER_H
+#define IMPOSTOR_BAKER_H
+
+#include <directxmath.h>
+#include <vector>
+#include "MeshFile.h"
+#include "TextureImage.h"
+#include "Utils.h"
+
+using namespace DirectX;
+
+// Renders a model from FrameCount x FrameCount directions, spread over the sphere by an octahedral map, into one atlas
+// The left half holds the albedo with the coverage in alpha and the right half the model space normals, frame for frame,
+// so that distant instances can be drawn as single quads and still be lit like the model
+// Frames are orthographic views of the model's bounding sphere (as Model computes it) looking at its center,
+// rendered on the CPU so that the baker runs without a device
+class ImpostorBaker
+{
+public:
+	// Indices may be nullptr for an unindexed triangle list, and the texture nullptr for a white model
+	// Opaque models ignore the alpha of their texture, as they are drawn without blending
+	static bool Bake(const ModelData* vertices, int iVertexCount, const unsigned int* indices, int iIndexCount, const TextureImage* pTexture, bool bOpaque, TextureImage& atlas, int iThreadCount = 0);
+
+	static XMFLOAT4 ComputeBoundingSphere(const ModelData* vertices, int iVertexCount); // xyz = center of the bounding box, w = radius
+	static XMVECTOR GetFrameDirection(int x, int y); // Unit vector from the center towards the viewer of frame (x, y)
+	static void GetFrameBasis(FXMVECTOR vDirection, XMVECTOR* pRight, XMVECTOR* pUp); // Axes of a frame's image, as they appear on screen
+
+	static const int FrameCount = 8; // Frames along each side of the atlas
+	static const int FrameSize = 128; // Texels along each side of a frame
+	static const int MipCount = 6; // Down to 4 texels per frame, below which frames would bleed into each other
+
+private:
+	static const int Supersampling = 2; // Samples along each side of a texel, for antialiased coverage
+
+	static void RenderFrame(const ModelData* vertices, int iVertexCount, const unsigned int* indices, int iIndexCount, const TextureImage* pTexture, bool bOpaque, const XMFLOAT4& boundingSphere, int iFrameX, int iFrameY, TextureImage& atlas);
+	static void GenerateMips(TextureImage& atlas);
+};
+
+#endif
@@ -0,0 +1,198 @@
+//
+// ImpostorShader.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Octahedral Impostors (Brucks) (https://shaderbits.com/blog/octahedral-impostors)
+// RasterTek Tutorial 37: Instancing (http://www.rastertek.com/dx11tut37.html)
+//
+
+#include "ImpostorShader.h"
+
+#pragma region Init
+
+ImpostorShader::ImpostorShader(ID3D11Device &device, ID3D11DeviceContext &immediateContext) : Shader(device, immediateContext)
+{
+	m_pImpostorBuffer = nullptr;
+	m_pLightBuffer = nullptr;
+	m_pSamplerState = nullptr;
+	m_renderStats = {};
+}
+
+ImpostorShader::~ImpostorShader()
+{
+	SAFE_RELEASE(m_pImpostorBuffer)
+	SAFE_RELEASE(m_pLightBuffer)
+	SAFE_RELEASE(m_pSamplerState)
+}
+
+HRESULT ImpostorShader::Initialize()
+{
+	HRESULT result = S_OK;
+
+	// Compile and create the vertex shader
+	// Compile and create the pixel shader
+	// Create the vertex input layout
+	// Create the matrix constant buffer
+
+	// Only the model's instances are read; the quad's corners come from the vertex ID
+	D3D11_INPUT_ELEMENT_DESC vertexInputDesc[] =
+	{
+		{ "WORLDMATRIX", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLDMATRIX", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLDMATRIX", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "TEXTURESLICE", 0, DXGI_FORMAT_R32_UINT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "LIGHTDIRECTION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+	};
+
+	UINT uiElementCount = ARRAYSIZE(vertexInputDesc);
+
+	result = Shader::Initialize(L"Shaders/ImpostorVertexShader.hlsl", "VS", L"Shaders/ImpostorPixelShader.hlsl", "PS", vertexInputDesc, uiElementCount);
+	if (FAILED(result))
+	{
+		return result;
+	}
+
+	// Create the impostor constant buffer
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.ByteWidth = sizeof(ImpostorBuffer);
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	result = m_pDevice->CreateBuffer(&bufferDesc, nullptr, &m_pImpostorBuffer);
+	if (FAILED(result))
+	{
+		Utils::ShowError("Failed to create impostor buffer.", result);
+		return result;
+	}
+
+	// Create the light constant buffer
+	bufferDesc.ByteWidth = sizeof(LightBuffer);
+	result = m_pDevice->CreateBuffer(&bufferDesc, nullptr, &m_pLightBuffer);
+	if (FAILED(result))
+	{
+		Utils::ShowError("Failed to create light buffer.", result);
+		return result;
+	}
+
+	// Create the atlas sampler state, clamped so that the frames on its edges don't wrap
+	D3D11_SAMPLER_DESC samplerDesc;
+	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.MipLODBias = 0.0f;
+	samplerDesc.MaxAnisotropy = 1;
+	samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
+	samplerDesc.BorderColor[0] = 0;
+	samplerDesc.BorderColor[1] = 0;
+	samplerDesc.BorderColor[2] = 0;
+	samplerDesc.BorderColor[3] = 0;
+	samplerDesc.MinLOD = 0;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	result = m_pDevice->CreateSamplerState(&samplerDesc, &m_pSamplerState);
+	if (FAILED(result))
+	{
+		Utils::ShowError("Failed to create impostor sampler state.", result);
+		return result;
+	}
+
+	return result;
+}
+
+#pragma endregion
+
+#pragma region Setters/Getters
+
+const ModelRenderStats& ImpostorShader::GetRenderStats()
+{
+	return m_renderStats;
+}
+
+#pragma endregion
+
+#pragma region Render
+
+void ImpostorShader::BeginFrame()
+{
+	m_renderStats = {};
+}
+
+bool ImpostorShader::Render(Impostor* pImpostor, Camera* pCamera)
+{
+	HRESULT result = S_OK;
+
+	if (pImpostor->GetDrawnInstanceCount() == 0)
+	{
+		return true;
+	}
+
+	// Set the vertex input layout
+	m_pImmediateContext->IASetInputLayout(m_pVertexInputLayout);
+
+	// The instances carry the world matrices
+	Shader::SetMatrixBuffer(XMMatrixIdentity(), pCamera);
+
+	// Update the impostor constant buffer
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	result = m_pImmediateContext->Map(m_pImpostorBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	if (FAILED(result))
+	{
+		Utils::ShowError("Failed to map the impostor buffer.", result);
+		return false;
+	}
+
+	// Impostors fade in over the same distances their model fades out
+	ImpostorBuffer* impostorBufferData = (ImpostorBuffer*)mappedResource.pData;
+	impostorBufferData->cameraPosition = pCamera->GetPosition();
+	impostorBufferData->frameCount = (float)ImpostorBaker::FrameCount;
+	impostorBufferData->boundingSphere = pImpostor->GetModel()->GetBoundingSphere();
+	impostorBufferData->fadeStart = pImpostor->GetFadeStart();
+	impostorBufferData->fadeScale = (pImpostor->GetFadeEnd() > pImpostor->GetFadeStart()) ? 1.0f / (pImpostor->GetFadeEnd() - pImpostor->GetFadeStart()) : 0.0f;
+
+	m_pImmediateContext->Unmap(m_pImpostorBuffer, 0);
+
+	// Set the constant buffers to be used by the vertex shader
+	m_pImmediateContext->VSSetConstantBuffers(1, 1, &m_pImpostorBuffer);
+
+	// Set the vertex shader to the device
+	m_pImmediateContext->VSSetShader(m_pVertexShader, nullptr, 0);
+
+	// Update the light constant buffer with the model's material
+	result = m_pImmediateContext->Map(m_pLightBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	if (FAILED(result))
+	{
+		Utils::ShowError("Failed to map the light buffer.", result);
+		return false;
+	}
+
+	LightBuffer* lightBufferData = (LightBuffer*)mappedResource.pData;
+	const Material& material = pImpostor->GetModel()->GetMaterial();
+	lightBufferData->ambientColor = material.ambientColor;
+	lightBufferData->diffuseColor = material.diffuseColor;
+	lightBufferData->specularColor = material.specularColor;
+	lightBufferData->specularPower = material.fSpecularPower;
+
+	m_pImmediateContext->Unmap(m_pLightBuffer, 0);
+
+	// Set the constant buffers to be used by the pixel shader
+	ID3D11Buffer* psConstantBuffers[2] = { m_pLightBuffer, m_pImpostorBuffer };
+	m_pImmediateContext->PSSetConstantBuffers(0, 2, psConstantBuffers);
+
+	// Set the atlas and its sampler state in slot 1, leaving the model texture in slot 0 bound
+	m_pImmediateContext->PSSetShaderResources(1, 1, pImpostor->GetAtlas());
+	m_pImmediateContext->PSSetSamplers(1, 1, &m_pSamplerState);
+
+	// Set the pixel shader to the device
+	m_pImmediateContext->PSSetShader(m_pPixelShader, nullptr, 0);
+
+	// Render a quad (as a strip of two triangles) per instance
+	m_pImmediateContext->DrawInstanced(4, pImpostor->GetDrawnInstanceCount(), 0, 0);
+	m_renderStats.iDrawCalls++;
+	m_renderStats.iImpostors += pImpostor->GetDrawnInstanceCount();
+	m_renderStats.iTriangles += 2 * pImpostor->GetDrawnInstanceCount();
+
+	return true;
+}
+
+#pragma endregion
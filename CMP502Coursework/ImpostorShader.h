@@ -0,0 +1,45 @@
+//
+// ImpostorShader.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Octahedral Impostors (Brucks) (https://shaderbits.com/blog/octahedral-impostors)
+// RasterTek Tutorial 37: Instancing (http://www.rastertek.com/dx11tut37.html)
+//
+
+#ifndef IMPOSTOR_SHADER_H
+#define IMPOSTOR_SHADER_H
+
+#include "Shader.h"
+#include "Impostor.h"
+#include "LightShader.h"
+
+struct ImpostorBuffer // For vertex and pixel shader
+{
+	XMFLOAT3 cameraPosition;
+	float frameCount;
+	XMFLOAT4 boundingSphere; // Of the model, in model space
+	float fadeStart;
+	float fadeScale;
+	XMFLOAT2 padding;
+};
+
+class ImpostorShader : public Shader
+{
+public:
+	ImpostorShader(ID3D11Device &device, ID3D11DeviceContext &immediateContext);
+	~ImpostorShader();
+
+	HRESULT Initialize();
+	void BeginFrame(); // Resets the stats
+	bool Render(Impostor* pImpostor, Camera* pCamera);
+	const ModelRenderStats& GetRenderStats();
+
+private:
+	ID3D11Buffer* m_pImpostorBuffer;
+	ID3D11Buffer* m_pLightBuffer;
+	ID3D11SamplerState* m_pSamplerState;
+	ModelRenderStats m_renderStats;
+};
+
+#endif
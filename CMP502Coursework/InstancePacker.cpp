@@ -0,0 +1,146 @@
+//
+// InstancePacker.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// RasterTek Tutorial 37: Instancing (http://www.rastertek.com/dx11tut37.html)
+//
+
+#include "InstancePacker.h"
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define INSTANCE_PACKER_SSE
+#endif
+
+void InstancePacker::Pack(const Instance& instance, InstanceData& data)
+{
+	// The instance matrix is already transposed, so its last row is (0, 0, 0, 1)
+	for (int i = 0; i < 3; i++)
+	{
+		XMStoreFloat4(&data.worldMatrix[i], instance.worldMatrix.r[i]);
+	}
+	data.uiTextureSlice = instance.uiTextureSlice;
+	data.lightDirection = instance.lightDirection;
+}
+
+void InstancePacker::ComposeMatrices(const XMFLOAT3* positions, const XMFLOAT4* rotations, const XMFLOAT3* scales, int iCount, InstanceData* instances)
+{
+	// Row i of the transposed matrix S * R * T is (sx * R[0][i], sy * R[1][i], sz * R[2][i], t[i]), where R is the rotation matrix of the quaternion
+	int i = 0;
+#ifdef INSTANCE_PACKER_SSE
+	// Four instances at a time, with each component in its own register (so no lane is wasted on the fourth column of a 3x3 matrix)
+	const __m128 vOne = _mm_set1_ps(1.0f);
+	const __m128 vTwo = _mm_set1_ps(2.0f);
+	for (; i + 4 <= iCount; i += 4)
+	{
+		__m128 vX = _mm_loadu_ps(&rotations[i].x);
+		__m128 vY = _mm_loadu_ps(&rotations[i + 1].x);
+		__m128 vZ = _mm_loadu_ps(&rotations[i + 2].x);
+		__m128 vW = _mm_loadu_ps(&rotations[i + 3].x);
+		_MM_TRANSPOSE4_PS(vX, vY, vZ, vW);
+
+		// Four XMFLOAT3s are three registers: x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+		__m128 vA = _mm_loadu_ps(&scales[i].x);
+		__m128 vB = _mm_loadu_ps(&scales[i + 1].y);
+		__m128 vC = _mm_loadu_ps(&scales[i + 2].z);
+		__m128 vScaleX = _mm_shuffle_ps(vA, _mm_shuffle_ps(vB, vC, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+		__m128 vScaleY = _mm_shuffle_ps(_mm_shuffle_ps(vA, vB, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(vB, vC, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 vScaleZ = _mm_shuffle_ps(_mm_shuffle_ps(vA, vB, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(vC, vC, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+		vA = _mm_loadu_ps(&positions[i].x);
+		vB = _mm_loadu_ps(&positions[i + 1].y);
+		vC = _mm_loadu_ps(&positions[i + 2].z);
+		__m128 vPositionX = _mm_shuffle_ps(vA, _mm_shuffle_ps(vB, vC, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+		__m128 vPositionY = _mm_shuffle_ps(_mm_shuffle_ps(vA, vB, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(vB, vC, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 vPositionZ = _mm_shuffle_ps(_mm_shuffle_ps(vA, vB, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(vC, vC, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+		__m128 vXX = _mm_mul_ps(vX, vX), vYY = _mm_mul_ps(vY, vY), vZZ = _mm_mul_ps(vZ, vZ);
+		__m128 vXY = _mm_mul_ps(vX, vY), vXZ = _mm_mul_ps(vX, vZ), vYZ = _mm_mul_ps(vY, vZ);
+		__m128 vXW = _mm_mul_ps(vX, vW), vYW = _mm_mul_ps(vY, vW), vZW = _mm_mul_ps(vZ, vW);
+
+		// Rows of the rotation matrix, scaled
+		__m128 vRows[3][4];
+		vRows[0][0] = _mm_mul_ps(vScaleX, _mm_sub_ps(vOne, _mm_mul_ps(vTwo, _mm_add_ps(vYY, vZZ))));
+		vRows[1][0] = _mm_mul_ps(vScaleX, _mm_mul_ps(vTwo, _mm_add_ps(vXY, vZW)));
+		vRows[2][0] = _mm_mul_ps(vScaleX, _mm_mul_ps(vTwo, _mm_sub_ps(vXZ, vYW)));
+		vRows[0][1] = _mm_mul_ps(vScaleY, _mm_mul_ps(vTwo, _mm_sub_ps(vXY, vZW)));
+		vRows[1][1] = _mm_mul_ps(vScaleY, _mm_sub_ps(vOne, _mm_mul_ps(vTwo, _mm_add_ps(vXX, vZZ))));
+		vRows[2][1] = _mm_mul_ps(vScaleY, _mm_mul_ps(vTwo, _mm_add_ps(vYZ, vXW)));
+		vRows[0][2] = _mm_mul_ps(vScaleZ, _mm_mul_ps(vTwo, _mm_add_ps(vXZ, vYW)));
+		vRows[1][2] = _mm_mul_ps(vScaleZ, _mm_mul_ps(vTwo, _mm_sub_ps(vYZ, vXW)));
+		vRows[2][2] = _mm_mul_ps(vScaleZ, _mm_sub_ps(vOne, _mm_mul_ps(vTwo, _mm_add_ps(vXX, vYY))));
+		vRows[0][3] = vPositionX;
+		vRows[1][3] = vPositionY;
+		vRows[2][3] = vPositionZ;
+
+		// Back to one register per instance row
+		for (int j = 0; j < 3; j++)
+		{
+			_MM_TRANSPOSE4_PS(vRows[j][0], vRows[j][1], vRows[j][2], vRows[j][3]);
+			for (int k = 0; k < 4; k++)
+			{
+				_mm_storeu_ps(&instances[i + k].worldMatrix[j].x, vRows[j][k]);
+			}
+		}
+	}
+#endif
+
+	for (; i < iCount; i++)
+	{
+		const XMFLOAT4& q = rotations[i];
+		const XMFLOAT3& s = scales[i];
+		const XMFLOAT3& t = positions[i];
+		float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+		float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+		float xw = q.x * q.w, yw = q.y * q.w, zw = q.z * q.w;
+		instances[i].worldMatrix[0] = XMFLOAT4(s.x * (1.0f - 2.0f * (yy + zz)), s.y * 2.0f * (xy - zw), s.z * 2.0f * (xz + yw), t.x);
+		instances[i].worldMatrix[1] = XMFLOAT4(s.x * 2.0f * (xy + zw), s.y * (1.0f - 2.0f * (xx + zz)), s.z * 2.0f * (yz - xw), t.y);
+		instances[i].worldMatrix[2] = XMFLOAT4(s.x * 2.0f * (xz - yw), s.y * 2.0f * (yz + xw), s.z * (1.0f - 2.0f * (xx + yy)), t.z);
+	}
+}
+
+bool InstancePacker::PackCompact(const Instance& instance, CompactInstanceData& data)
+{
+	// The rows of the world matrix must be orthogonal, of equal length and right-handed
+	XMMATRIX worldMatrix = XMMatrixTranspose(instance.worldMatrix);
+	float fScale = XMVectorGetX(XMVector3Length(worldMatrix.r[0]));
+	if (!(fScale > 0.0f) || !std::isfinite(fScale))
+	{
+		return false;
+	}
+	const float fTolerance = 1e-4f;
+	for (int i = 0; i < 3; i++)
+	{
+		if (fabsf(XMVectorGetX(XMVector3Length(worldMatrix.r[i])) - fScale) > fTolerance * fScale ||
+			fabsf(XMVectorGetX(XMVector3Dot(worldMatrix.r[i], worldMatrix.r[(i + 1) % 3]))) > fTolerance * fScale * fScale)
+		{
+			return false;
+		}
+	}
+	if (XMVectorGetX(XMVector3Dot(XMVector3Cross(worldMatrix.r[0], worldMatrix.r[1]), worldMatrix.r[2])) <= 0.0f)
+	{
+		return false;
+	}
+
+	const XMFLOAT3& lightDirection = instance.lightDirection;
+	if (fabsf(lightDirection.x) > 1.0f || fabsf(lightDirection.y) > 1.0f || fabsf(lightDirection.z) > 1.0f)
+	{
+		return false;
+	}
+
+	XMMATRIX rotationMatrix = worldMatrix * XMMatrixScaling(1.0f / fScale, 1.0f / fScale, 1.0f / fScale);
+	rotationMatrix.r[3] = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+	XMFLOAT4 rotation;
+	XMStoreFloat4(&rotation, XMQuaternionNormalize(XMQuaternionRotationMatrix(rotationMatrix)));
+	XMStoreFloat3(&data.position, worldMatrix.r[3]);
+	data.fScale = fScale;
+	data.rotation[0] = (short)lrintf(rotation.x * 32767.0f);
+	data.rotation[1] = (short)lrintf(rotation.y * 32767.0f);
+	data.rotation[2] = (short)lrintf(rotation.z * 32767.0f);
+	data.rotation[3] = (short)lrintf(rotation.w * 32767.0f);
+	data.uiTextureSlice = instance.uiTextureSlice;
+	data.uiLightDirection = (UINT)lrintf((lightDirection.x * 0.5f + 0.5f) * 1023.0f) | ((UINT)lrintf((lightDirection.y * 0.5f + 0.5f) * 1023.0f) << 10) | ((UINT)lrintf((lightDirection.z * 0.5f + 0.5f) * 1023.0f) << 20);
+	return true;
+}
@@ -0,0 +1,49 @@
+//
+// InstancePacker.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// RasterTek Tutorial 37: Instancing (http://www.rastertek.com/dx11tut37.html)
+//
+
+#ifndef INSTANCE_PACKER_H
+#define INSTANCE_PACKER_H
+
+#include <directxmath.h>
+#include "Utils.h"
+
+using namespace DirectX;
+
+struct Instance
+{
+	XMMATRIX worldMatrix;
+	UINT uiTextureSlice; // Slice of the texture array to sample, so that instances with different textures can share a draw
+	XMFLOAT3 lightDirection = XMFLOAT3(0.0f, 0.0f, 0.0f); // Zero takes the model's, so that instances lit from different directions can share a draw too
+};
+
+struct InstanceData // Instance as the instance buffer holds it: every instance transform is affine, so the transposed world matrix drops its constant last row
+{
+	XMFLOAT4 worldMatrix[3];
+	UINT uiTextureSlice;
+	XMFLOAT3 lightDirection;
+};
+
+struct CompactInstanceData // Half the size, for instances that are only rotated, uniformly scaled and translated (expanded in the vertex shader)
+{
+	XMFLOAT3 position;
+	float fScale;
+	short rotation[4]; // Unit quaternion (xyzw), signed normalized
+	UINT uiTextureSlice;
+	UINT uiLightDirection; // 10 bits per component (xyz), mapped from [-1, 1] to [0, 1023]
+};
+
+// Converts instances into the layouts the instance buffers hold (no Direct3D dependency, so it can run headless)
+class InstancePacker
+{
+public:
+	static void Pack(const Instance& instance, InstanceData& data);
+	static bool PackCompact(const Instance& instance, CompactInstanceData& data); // false if the transform shears, mirrors or scales unevenly, or the light direction is outside [-1, 1]
+	static void ComposeMatrices(const XMFLOAT3* positions, const XMFLOAT4* rotations, const XMFLOAT3* scales, int iCount, InstanceData* instances); // Scale, then rotate, then translate; only the matrices are written
+};
+
+#endif
@@ -0,0 +1,246 @@
+//
+// LZCompressor.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// LZ4 Block Format Description (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md)
+// A Universal Algorithm for Sequential Data Compression (Ziv & Lempel, 1977)
+//
+
+#include "LZCompressor.h"
+#include <cstring>
+
+#pragma region Compression
+
+namespace
+{
+	const int MinMatch = 4;
+	const int HashBits = 14;
+
+	unsigned int Read32(const unsigned char* p)
+	{
+		unsigned int value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	unsigned int Hash(unsigned int value)
+	{
+		return (value * 2654435761u) >> (32 - HashBits);
+	}
+}
+
+size_t LZCompressor::Compress(const unsigned char* input, size_t inputSize, std::vector<unsigned char>& output)
+{
+	size_t start = output.size();
+	if (inputSize > (size_t)MaxBlockSize)
+	{
+		return 0;
+	}
+
+	// Last position of each hashed 4-byte sequence (offset by one so that zero means empty)
+	std::vector<unsigned int> table(1 << HashBits, 0);
+
+	size_t literalStart = 0;
+	size_t i = 0;
+	while (i + MinMatch <= inputSize)
+	{
+		unsigned int sequence = Read32(&input[i]);
+		unsigned int& entry = table[Hash(sequence)];
+		size_t candidate = entry;
+		entry = (unsigned int)i + 1;
+
+		if (candidate == 0 || Read32(&input[candidate - 1]) != sequence)
+		{
+			i++;
+			continue;
+		}
+		candidate--;
+
+		// Extend the match as far as it goes, then back over literals that also match
+		size_t length = MinMatch;
+		while (i + length < inputSize && input[candidate + length] == input[i + length])
+		{
+			length++;
+		}
+		while (i > literalStart && candidate > 0 && input[i - 1] == input[candidate - 1])
+		{
+			i--;
+			candidate--;
+			length++;
+		}
+
+		// Token, literals, offset, then the rest of the match length
+		size_t literalLength = i - literalStart;
+		size_t matchLength = length - MinMatch;
+		output.push_back((unsigned char)(((std::min)(literalLength, (size_t)15) << 4) | (std::min)(matchLength, (size_t)15)));
+		if (literalLength >= 15)
+		{
+			WriteLength(literalLength - 15, output);
+		}
+		output.insert(output.end(), input + literalStart, input + i);
+
+		size_t offset = i - candidate;
+		output.push_back((unsigned char)(offset & 0xFF));
+		output.push_back((unsigned char)(offset >> 8));
+		if (matchLength >= 15)
+		{
+			WriteLength(matchLength - 15, output);
+		}
+
+		// Hash the positions inside the match too, so that later repeats of it are found
+		size_t end = i + length;
+		for (size_t j = i + 1; j < end && j + MinMatch <= inputSize; j += 2)
+		{
+			table[Hash(Read32(&input[j]))] = (unsigned int)j + 1;
+		}
+		i = end;
+		literalStart = end;
+	}
+
+	// The last sequence is literals only
+	size_t literalLength = inputSize - literalStart;
+	output.push_back((unsigned char)((std::min)(literalLength, (size_t)15) << 4));
+	if (literalLength >= 15)
+	{
+		WriteLength(literalLength - 15, output);
+	}
+	output.insert(output.end(), input + literalStart, input + inputSize);
+
+	return output.size() - start;
+}
+
+void LZCompressor::WriteLength(size_t length, std::vector<unsigned char>& output)
+{
+	while (length >= 255)
+	{
+		output.push_back(255);
+		length -= 255;
+	}
+	output.push_back((unsigned char)length);
+}
+
+size_t LZCompressor::GetMaxCompressedSize(size_t inputSize)
+{
+	// All literals: one token plus a length byte per 255
+	return inputSize + inputSize / 255 + 16;
+}
+
+#pragma endregion
+
+#pragma region Decompression
+
+bool LZCompressor::Decompress(const unsigned char* input, size_t inputSize, unsigned char* output, size_t outputSize)
+{
+	const unsigned char* in = input;
+	const unsigned char* inEnd = input + inputSize;
+	unsigned char* out = output;
+	unsigned char* outEnd = output + outputSize;
+
+	while (in < inEnd)
+	{
+		unsigned int token = *in++;
+		size_t literalLength = token >> 4;
+		size_t offset;
+
+		if (literalLength < 15 && inEnd - in >= 18 && outEnd - out >= 34)
+		{
+			// Away from the ends of the buffers, short literals and matches are copied with fixed size moves (a few wide loads and stores)
+			// There are at least 18 bytes of input left, so this isn't the last sequence and a match follows
+			memcpy(out, in, 16);
+			in += literalLength;
+			out += literalLength;
+			offset = in[0] | (in[1] << 8);
+			in += 2;
+
+			if ((token & 15) < 15 && offset >= 18 && offset <= (size_t)(out - output))
+			{
+				memcpy(out, out - offset, 18);
+				out += (token & 15) + MinMatch;
+				continue;
+			}
+		}
+		else
+		{
+			// Literals
+			if (literalLength == 15)
+			{
+				unsigned char byte;
+				do
+				{
+					if (in >= inEnd)
+					{
+						return false;
+					}
+					byte = *in++;
+					literalLength += byte;
+				} while (byte == 255);
+			}
+			if (literalLength > (size_t)(inEnd - in) || literalLength > (size_t)(outEnd - out))
+			{
+				return false;
+			}
+			memcpy(out, in, literalLength);
+			in += literalLength;
+			out += literalLength;
+
+			// The last sequence has no match
+			if (in == inEnd)
+			{
+				break;
+			}
+
+			if (inEnd - in < 2)
+			{
+				return false;
+			}
+			offset = in[0] | (in[1] << 8);
+			in += 2;
+		}
+
+		// Match
+		if (offset == 0 || offset > (size_t)(out - output))
+		{
+			return false;
+		}
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15)
+		{
+			unsigned char byte;
+			do
+			{
+				if (in >= inEnd)
+				{
+					return false;
+				}
+				byte = *in++;
+				matchLength += byte;
+			} while (byte == 255);
+		}
+		matchLength += MinMatch;
+		if (matchLength > (size_t)(outEnd - out))
+		{
+			return false;
+		}
+
+		// Matches may overlap the bytes they produce (runs), which copy forward one byte at a time
+		const unsigned char* match = out - offset;
+		if (offset >= matchLength)
+		{
+			memcpy(out, match, matchLength);
+			out += matchLength;
+		}
+		else
+		{
+			for (size_t j = 0; j < matchLength; j++)
+			{
+				*out++ = match[j];
+			}
+		}
+	}
+
+	return out == outEnd;
+}
+
+#pragma endregion
@@ -0,0 +1,35 @@
+//
+// LZCompressor.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// LZ4 Block Format Description (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md)
+// A Universal Algorithm for Sequential Data Compression (Ziv & Lempel, 1977)
+//
+
+#ifndef LZ_COMPRESSOR_H
+#define LZ_COMPRESSOR_H
+
+#include <vector>
+#include "Utils.h"
+
+// Byte oriented LZ77 compression in the LZ4 block layout: each sequence is a token, its literals, then a 16-bit match offset
+// Blocks are independent and at most 64 KB, so every match offset fits in 16 bits and blocks can be decoded in parallel
+class LZCompressor
+{
+public:
+	static const int MaxBlockSize = 65536;
+
+	// Appends the compressed block to the output; returns its size in bytes
+	static size_t Compress(const unsigned char* input, size_t inputSize, std::vector<unsigned char>& output);
+
+	// Fails on malformed data rather than reading or writing out of bounds; the block must decode to exactly outputSize bytes
+	static bool Decompress(const unsigned char* input, size_t inputSize, unsigned char* output, size_t outputSize);
+
+	static size_t GetMaxCompressedSize(size_t inputSize);
+
+private:
+	static void WriteLength(size_t length, std::vector<unsigned char>& output); // The part of a length past the token's 15
+};
+
+#endif
@@ -8,6 +8,7 @@
 //
 
 #include "LightShader.h"
+#include <cfloat>
 
 #pragma region Init
 
@@ -15,15 +16,23 @@ LightShader::LightShader(ID3D11Device &device, ID3D11DeviceContext &immediateCon
 {
 	m_pInstancedVertexShader = nullptr;
 	m_pInstancedVertexInputLayout = nullptr;
+	m_pCompactInstancedVertexShader = nullptr;
+	m_pCompactInstancedVertexInputLayout = nullptr;
+	m_pFadePixelShader = nullptr;
 	m_pCameraBuffer = nullptr;
 	m_pLightBuffer = nullptr;
 	m_pSamplerState = nullptr;
+	m_pBoundTexture = nullptr;
+	m_renderStats = {};
 }
 
 LightShader::~LightShader()
 {
 	SAFE_RELEASE(m_pInstancedVertexShader)
 	SAFE_RELEASE(m_pInstancedVertexInputLayout)
+	SAFE_RELEASE(m_pCompactInstancedVertexShader)
+	SAFE_RELEASE(m_pCompactInstancedVertexInputLayout)
+	SAFE_RELEASE(m_pFadePixelShader)
 	SAFE_RELEASE(m_pCameraBuffer)
 	SAFE_RELEASE(m_pLightBuffer)
 	SAFE_RELEASE(m_pSamplerState)
@@ -89,7 +98,8 @@ HRESULT LightShader::Initialize()
 		{ "WORLDMATRIX", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
 		{ "WORLDMATRIX", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
 		{ "WORLDMATRIX", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
-		{ "WORLDMATRIX", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+		{ "TEXTURESLICE", 0, DXGI_FORMAT_R32_UINT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "LIGHTDIRECTION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
 	};
 
 	uiElementCount = ARRAYSIZE(instancedVertexInputDesc);
@@ -101,6 +111,58 @@ HRESULT LightShader::Initialize()
 		return result;
 	}
 
+	// Compile and create the compact instanced vertex shader and its input layout
+	ID3DBlob* pCompiledCompactInstancedVertexShader;
+	result = CompileShaderFromFile(L"Shaders/LightInstancedVertexShader.hlsl", "CIVS", "vs_5_0", &pCompiledCompactInstancedVertexShader);
+	if (FAILED(result))
+	{
+		Utils::ShowError("Failed to compile compact instanced vertex shader.", result);
+		return result;
+	}
+
+	result = m_pDevice->CreateVertexShader(pCompiledCompactInstancedVertexShader->GetBufferPointer(), pCompiledCompactInstancedVertexShader->GetBufferSize(), nullptr, &m_pCompactInstancedVertexShader);
+	if (FAILED(result))
+	{
+		Utils::ShowError("Failed to create compact instanced vertex shader.", result);
+		return result;
+	}
+
+	D3D11_INPUT_ELEMENT_DESC compactInstancedVertexInputDesc[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,	D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "INSTANCEPOSITION", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "INSTANCEROTATION", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "TEXTURESLICE", 0, DXGI_FORMAT_R32_UINT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "LIGHTDIRECTION", 0, DXGI_FORMAT_R10G10B10A2_UNORM, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+	};
+
+	result = m_pDevice->CreateInputLayout(compactInstancedVertexInputDesc, ARRAYSIZE(compactInstancedVertexInputDesc), pCompiledCompactInstancedVertexShader->GetBufferPointer(), pCompiledCompactInstancedVertexShader->GetBufferSize(), &m_pCompactInstancedVertexInputLayout);
+	SAFE_RELEASE(pCompiledCompactInstancedVertexShader)
+	if (FAILED(result))
+	{
+		Utils::ShowError("Failed to create compact instanced vertex input layout.", result);
+		return result;
+	}
+
+	// Compile and create the pixel shader of models that fade out
+	ID3DBlob* pCompiledFadePixelShader;
+	result = CompileShaderFromFile(L"Shaders/LightPixelShader.hlsl", "FadePS", "ps_5_0", &pCompiledFadePixelShader);
+	if (FAILED(result))
+	{
+		Utils::ShowError("Failed to compile fade pixel shader.", result);
+		return result;
+	}
+
+	result = m_pDevice->CreatePixelShader(pCompiledFadePixelShader->GetBufferPointer(), pCompiledFadePixelShader->GetBufferSize(), nullptr, &m_pFadePixelShader);
+	SAFE_RELEASE(pCompiledFadePixelShader)
+	if (FAILED(result))
+	{
+		Utils::ShowError("Failed to create fade pixel shader.", result);
+		return result;
+	}
+
 	// Create the camera constant buffer
 	D3D11_BUFFER_DESC bufferDesc = {};
 	bufferDesc.ByteWidth = sizeof(CameraBuffer);
@@ -153,24 +215,143 @@ HRESULT LightShader::Initialize()
 
 #pragma endregion
 
+#pragma region Setters/Getters
+
+const ModelRenderStats& LightShader::GetRenderStats()
+{
+	return m_renderStats;
+}
+
+#pragma endregion
+
 #pragma region Render
 
+void LightShader::BeginFrame()
+{
+	m_pBoundTexture = nullptr;
+	m_renderStats = {};
+}
+
 bool LightShader::Render(Model* pModel, Camera* pCamera)
 {
-	HRESULT result = S_OK;
+	// Culled models may have nothing to draw this frame, whether no instance or no meshlet is in view
+	if (pModel->GetDrawnInstanceCount() == 0 || (pModel->IsDrawingMeshlets() && pModel->GetMeshletDraws().empty()))
+	{
+		return true;
+	}
 
 	// Set the vertex input layout
-	if (pModel->GetInstanceCount() == 1)
+	if (!pModel->IsInstanced())
 	{
 		m_pImmediateContext->IASetInputLayout(m_pVertexInputLayout);
 	}
+	else if (pModel->IsCompactInstanced())
+	{
+		m_pImmediateContext->IASetInputLayout(m_pCompactInstancedVertexInputLayout);
+	}
 	else
 	{
 		m_pImmediateContext->IASetInputLayout(m_pInstancedVertexInputLayout);
 	}
 
+	if (!SetSurface(pModel->GetWorldMatrix(), pCamera, *pModel->GetTexture(), pModel->GetTextureSlice(), pModel->GetMaterial(), pModel->GetLightDirection(), pModel->GetBoundingSphere(), pModel->GetFadeStart(), pModel->GetFadeEnd()))
+	{
+		return false;
+	}
+
+	// Set the vertex shader to the device
+	if (!pModel->IsInstanced())
+	{
+		m_pImmediateContext->VSSetShader(
+								m_pVertexShader,
+								nullptr,		// Array of class instance interfaces used by the vertex shader
+								0);				// Number of class instance interfaces
+	}
+	else if (pModel->IsCompactInstanced())
+	{
+		m_pImmediateContext->VSSetShader(m_pCompactInstancedVertexShader, nullptr, 0);
+	}
+	else
+	{
+		m_pImmediateContext->VSSetShader(m_pInstancedVertexShader, nullptr, 0);
+	}
+
+	// Render the meshlets kept, one draw for each run of instances keeping the same ones
+	if (pModel->IsDrawingMeshlets())
+	{
+		for (const auto& draw : pModel->GetMeshletDraws())
+		{
+			if (!pModel->IsInstanced())
+			{
+				m_pImmediateContext->DrawIndexed(draw.uiIndexCount, draw.uiFirstIndex, 0);
+			}
+			else
+			{
+				m_pImmediateContext->DrawIndexedInstanced(draw.uiIndexCount, draw.uiInstanceCount, draw.uiFirstIndex, 0, draw.uiFirstInstance);
+			}
+			m_renderStats.iDrawCalls++;
+			m_renderStats.iTriangles += draw.uiIndexCount / 3 * draw.uiInstanceCount;
+		}
+		m_renderStats.iInstances += pModel->GetDrawnInstanceCount();
+		return true;
+	}
+
+	// Render triangles, of the model's current level of detail
+	const MeshLod& lod = pModel->GetLod(pModel->GetCurrentLod());
+	if (!pModel->IsInstanced())
+	{
+		m_pImmediateContext->DrawIndexed(
+								lod.uiIndexCount,
+								lod.uiFirstIndex,			// Location of the first index read by the GPU from the index buffer
+								0);							// Value added to each index before reading a vertex from the vertex buffer
+	}
+	else
+	{
+		m_pImmediateContext->DrawIndexedInstanced(lod.uiIndexCount, pModel->GetDrawnInstanceCount(), lod.uiFirstIndex, 0, 0);
+	}
+	m_renderStats.iDrawCalls++;
+	m_renderStats.iInstances += pModel->GetDrawnInstanceCount();
+	m_renderStats.iTriangles += lod.uiIndexCount / 3 * pModel->GetDrawnInstanceCount();
+
+	return true;
+}
+
+bool LightShader::Render(Terrain* pTerrain, Camera* pCamera)
+{
+	const std::vector<TerrainDraw>& draws = pTerrain->GetDraws();
+	if (draws.empty())
+	{
+		return true;
+	}
+
+	// Chunks are in world space, and never fade
+	m_pImmediateContext->IASetInputLayout(m_pVertexInputLayout);
+	if (!SetSurface(XMMatrixIdentity(), pCamera, *pTerrain->GetTexture(), pTerrain->GetTextureSlice(), pTerrain->GetMaterial(), pTerrain->GetLightDirection(), XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f), 0.0f, 0.0f))
+	{
+		return false;
+	}
+	m_pImmediateContext->VSSetShader(m_pVertexShader, nullptr, 0);
+
+	// One draw for each chunk, with the pattern stitching its edges, reading the vertices of the chunk's slot
+	for (const TerrainDraw& draw : draws)
+	{
+		UINT uiFirstIndex, uiIndexCount;
+		pTerrain->GetPattern(draw.iStitchedEdges, &uiFirstIndex, &uiIndexCount);
+		m_pImmediateContext->DrawIndexed(uiIndexCount, uiFirstIndex, draw.iChunk * TerrainQuadtree::ChunkVertices);
+		m_renderStats.iDrawCalls++;
+		m_renderStats.iTriangles += uiIndexCount / 3;
+	}
+	m_renderStats.iInstances++;
+
+	return true;
+}
+
+bool LightShader::SetSurface(const XMMATRIX& worldMatrix, Camera* pCamera, ID3D11ShaderResourceView* texture, UINT uiTextureSlice, const Material& material, const XMFLOAT3& lightDirection, const XMFLOAT4& boundingSphere, float fFadeStart, float fFadeEnd)
+{
+	HRESULT result = S_OK;
+
 	// Update and set the matrix constant buffer to be used by the vertex shader
-	Shader::SetMatrixBuffer(pModel->GetWorldMatrix(), pCamera);
+	Shader::SetMatrixBuffer(worldMatrix, pCamera);
 
 	// Update the camera constant buffer
 
@@ -186,9 +367,14 @@ bool LightShader::Render(Model* pModel, Camera* pCamera)
 	// Get a pointer to the camera buffer data
 	CameraBuffer* cameraBufferData = (CameraBuffer*)mappedResource.pData;
 
-	// Copy the camera position into the camera buffer
+	// Copy the camera position, texture array slice, light direction and fade into the camera buffer
 	cameraBufferData->cameraPosition = pCamera->GetPosition();
-	cameraBufferData->padding = 0.0f;
+	cameraBufferData->textureSlice = uiTextureSlice;
+	cameraBufferData->lightDirection = lightDirection;
+	cameraBufferData->boundsCenter = XMFLOAT3(boundingSphere.x, boundingSphere.y, boundingSphere.z);
+	bool bFade = fFadeEnd > fFadeStart;
+	cameraBufferData->fadeStart = bFade ? fFadeStart : FLT_MAX;
+	cameraBufferData->fadeScale = bFade ? 1.0f / (fFadeEnd - fFadeStart) : 0.0f;
 
 	// Unlock the camera buffer
 	m_pImmediateContext->Unmap(m_pCameraBuffer, 0);
@@ -196,19 +382,6 @@ bool LightShader::Render(Model* pModel, Camera* pCamera)
 	// Set the constant buffers to be used by the vertex shader
 	m_pImmediateContext->VSSetConstantBuffers(1, 1, &m_pCameraBuffer);
 
-	// Set the vertex shader to the device
-	if (pModel->GetInstanceCount() == 1)
-	{
-		m_pImmediateContext->VSSetShader(
-								m_pVertexShader,
-								nullptr,		// Array of class instance interfaces used by the vertex shader
-								0);				// Number of class instance interfaces
-	}
-	else
-	{
-		m_pImmediateContext->VSSetShader(m_pInstancedVertexShader, nullptr, 0);
-	}
-
 	// Update the light constant buffer
 
 	// Lock the light buffer so it can be written to
@@ -222,12 +395,11 @@ bool LightShader::Render(Model* pModel, Camera* pCamera)
 	// Get a pointer to the light buffer data
 	LightBuffer* lightBufferData = (LightBuffer*)mappedResource.pData;
 
-	// Copy the lighting variables into the light buffer
-	lightBufferData->ambientColor = pModel->GetAmbientColor();
-	lightBufferData->diffuseColor = pModel->GetDiffuseColor();
-	lightBufferData->direction = pModel->GetLightDirection();
-	lightBufferData->specularColor = pModel->GetSpecularColor();
-	lightBufferData->specularPower = pModel->GetSpecularPower();
+	// Copy the material into the light buffer (the light direction comes with the instances)
+	lightBufferData->ambientColor = material.ambientColor;
+	lightBufferData->diffuseColor = material.diffuseColor;
+	lightBufferData->specularColor = material.specularColor;
+	lightBufferData->specularPower = material.fSpecularPower;
 
 	// Unlock the light buffer
 	m_pImmediateContext->Unmap(m_pLightBuffer, 0);
@@ -236,31 +408,23 @@ bool LightShader::Render(Model* pModel, Camera* pCamera)
 	ID3D11Buffer* psConstantBuffers[1] = { m_pLightBuffer };
 	m_pImmediateContext->PSSetConstantBuffers(0, 1, psConstantBuffers);
 
-	// Set the texture to be used by the pixel shader
-	m_pImmediateContext->PSSetShaderResources(0, 1, pModel->GetTexture());
+	// Set the texture to be used by the pixel shader, unless the previous model used the same one
+	if (texture != m_pBoundTexture)
+	{
+		m_pImmediateContext->PSSetShaderResources(0, 1, &texture);
+		m_pBoundTexture = texture;
+		m_renderStats.iTextureBinds++;
+	}
 
 	// Set the sampler state in the pixel shader
 	m_pImmediateContext->PSSetSamplers(0, 1, &m_pSamplerState);
 
 	// Set the pixel shader to the device
 	m_pImmediateContext->PSSetShader(
-							m_pPixelShader,
+							bFade ? m_pFadePixelShader : m_pPixelShader,
 							nullptr,		// Array of class instance interfaces used by the pixel shader 
 							0);				// Number of class instance interfaces
 
-	// Render triangles
-	if (pModel->GetInstanceCount() == 1)
-	{
-		m_pImmediateContext->DrawIndexed(
-								pModel->GetIndexCount(),
-								0,							// Location of the first index read by the GPU from the index buffer
-								0);							// Value added to each index before reading a vertex from the vertex buffer
-	}
-	else
-	{
-		m_pImmediateContext->DrawInstanced(pModel->GetIndexCount(), pModel->GetInstanceCount(), 0, 0);
-	}
-
 	return true;
 }
 
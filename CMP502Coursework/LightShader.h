@@ -12,20 +12,34 @@
 
 #include "Shader.h"
 #include "Model.h"
+#include "Terrain.h"
 
 struct CameraBuffer // For vertex shader
 {
 	XMFLOAT3 cameraPosition;
-	float padding;
+	UINT textureSlice;
+	XMFLOAT3 lightDirection; // Of a single instance, like the texture slice; instanced draws carry one per instance
+	float fadeStart; // Distance at which instances start to dither out
+	XMFLOAT3 boundsCenter; // Model space point the fade distance is measured to
+	float fadeScale; // Reciprocal of the fade's length; zero when the model doesn't fade
 };
 
 struct LightBuffer // For pixel shader
 {
 	XMFLOAT4 ambientColor;
 	XMFLOAT4 diffuseColor;
-	XMFLOAT3 direction;
-	float specularPower;
 	XMFLOAT4 specularColor;
+	float specularPower;
+	XMFLOAT3 padding;
+};
+
+struct ModelRenderStats
+{
+	int iDrawCalls;
+	int iInstances;
+	int iTriangles; // Over every instance, at the levels of detail drawn
+	int iImpostors; // Instances drawn as impostors (two triangles each, counted in the triangles too)
+	int iTextureBinds; // Draws that share the previous draw's texture (or texture array) skip the bind
 };
 
 class LightShader : public Shader
@@ -35,14 +49,24 @@ public:
 	~LightShader();
 
 	HRESULT Initialize();
+	void BeginFrame(); // Forgets the bound texture, since other shaders use the same slot, and resets the stats
 	bool Render(Model* pModel, Camera* pCamera);
+	bool Render(Terrain* pTerrain, Camera* pCamera); // One draw for each chunk picked
+	const ModelRenderStats& GetRenderStats();
 
 private:
 	ID3D11VertexShader* m_pInstancedVertexShader;
 	ID3D11InputLayout* m_pInstancedVertexInputLayout;
+	ID3D11VertexShader* m_pCompactInstancedVertexShader;
+	ID3D11InputLayout* m_pCompactInstancedVertexInputLayout;
+	ID3D11PixelShader* m_pFadePixelShader; // For models that fade out, so the others keep early depth testing
 	ID3D11Buffer* m_pCameraBuffer;
 	ID3D11Buffer* m_pLightBuffer;
 	ID3D11SamplerState* m_pSamplerState;
+	ID3D11ShaderResourceView* m_pBoundTexture;
+	ModelRenderStats m_renderStats;
+
+	bool SetSurface(const XMMATRIX& worldMatrix, Camera* pCamera, ID3D11ShaderResourceView* texture, UINT uiTextureSlice, const Material& material, const XMFLOAT3& lightDirection, const XMFLOAT4& boundingSphere, float fFadeStart, float fFadeEnd); // Constant buffers, texture, sampler and pixel shader of a model or the terrain; no fade unless the end is beyond the start
 };
 
 #endif
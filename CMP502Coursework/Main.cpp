@@ -4,6 +4,8 @@
 //
 
 #include "App.h"
+#include "AssetArchive.h"
+#include "AssetCooker.h"
 
 // Entry point
 int WINAPI WinMain(
@@ -12,6 +14,32 @@ int WINAPI WinMain(
 				PSTR pCmdLine,				// Address of command line string for the application
 				int iCmdShow)				// Controls how the window is to be shown
 {
+	// Cook the resources into their runtime forms, which are loaded instead of the sources when present
+	// Only the assets that changed since the last cook are processed again
+	if (pCmdLine && std::string(pCmdLine).find("-cook") != std::string::npos)
+	{
+		CookStats stats = {};
+		bool bResult = AssetCooker::Cook(AssetCooker::SourceDirectory, AssetCooker::OutputDirectory, AssetCooker::CacheDirectory, 0, &stats);
+		std::string message = "Cooked " + std::to_string(stats.iAssetCount) + " assets in " + std::to_string(stats.dSeconds) + " s: " + std::to_string(stats.iCookedCount) + " cooked, " + std::to_string(stats.iCachedCount) + " from the cache, " + std::to_string(stats.iFailedCount) + " failed";
+		MessageBox(0, message.c_str(), "", 0);
+		return bResult ? 0 : 1;
+	}
+
+	// Pack the resources into Resources.pak, which is read instead of the loose files when present
+	// The cooked resources are packed if there are any, as the sources would need processing every time they load
+	if (pCmdLine && std::string(pCmdLine).find("-pack") != std::string::npos)
+	{
+		std::vector<std::string> cookedFilenames;
+		bool bCooked = Utils::ListFiles(AssetCooker::OutputDirectory, cookedFilenames) && !cookedFilenames.empty();
+		ArchiveStats stats;
+		bool bResult = AssetArchive::Build(bCooked ? AssetCooker::OutputDirectory : AssetCooker::SourceDirectory, "Resources.pak", 0, &stats);
+		std::string message = bResult
+			? "Packed " + std::to_string(stats.iEntryCount) + " files: " + std::to_string(stats.originalBytes / 1024) + " KB to " + std::to_string(stats.archiveBytes / 1024) + " KB (" + std::to_string(stats.iCompressedChunks) + " chunks compressed, " + std::to_string(stats.iStoredChunks) + " stored)"
+			: "Failed to pack the resources";
+		MessageBox(0, message.c_str(), "", 0);
+		return bResult ? 0 : 1;
+	}
+
 	App* pApp = new App(hInstance);
 	if (pApp->Initialize())
 	{
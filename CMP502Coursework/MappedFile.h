@@ -0,0 +1,36 @@
+//
+// MappedFile.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include "Utils.h"
+
+// Read-only view of a whole file, so that it can be parsed where it lies rather than copied into a buffer first
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const char* filename); // An empty file opens with no data
+	void Close();
+
+	const unsigned char* GetData() const;
+	size_t GetSize() const;
+
+private:
+	const unsigned char* m_data;
+	size_t m_size;
+#ifdef _WIN32
+	HANDLE m_hFile;
+	HANDLE m_hMapping;
+#endif
+};
+
+#endif
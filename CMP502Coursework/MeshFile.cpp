@@ -0,0 +1,441 @@
+//
+// MeshFile.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// RasterTek Tutorial 8: Loading Maya 2011 Models (http://www.rastertek.com/dx11tut08.html)
+//
+
+#include "MeshFile.h"
+#include <cmath>
+#include <cstring>
+
+// SSE2 is part of every x64 and 32-bit Windows target
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MESH_FILE_SSE2
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace
+{
+	const unsigned int CookedMagic = 0x4853454D; // "MESH"
+	const unsigned int CookedVersion = 3;
+
+	const size_t TextChunkSize = 256 * 1024; // Text models are split into chunks of about this many bytes, parsed in parallel
+	const int MaxSignificantDigits = 19; // As many as fit in 64 bits; later ones are too small to change a float
+	const int MaxReportedErrors = 16;
+
+	const double PowersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 }; // Exact in a double
+
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+#ifdef MESH_FILE_SSE2
+	int CountTrailingZeros(unsigned int uiValue)
+	{
+#ifdef _MSC_VER
+		unsigned long ulIndex;
+		_BitScanForward(&ulIndex, uiValue);
+		return (int)ulIndex;
+#else
+		return __builtin_ctz(uiValue);
+#endif
+	}
+#endif
+
+	// Number of consecutive decimal digits starting at p
+	int CountDigits(const char* p, const char* end)
+	{
+		int iCount = 0;
+#ifdef MESH_FILE_SSE2
+		// A byte minus '0' is a digit if it is at most 9 (unsigned), so 16 characters are classified at once
+		const __m128i vZero = _mm_set1_epi8('0');
+		const __m128i vNine = _mm_set1_epi8(9);
+		while (end - (p + iCount) >= 16)
+		{
+			__m128i vDigits = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(p + iCount)), vZero);
+			unsigned int uiDigitMask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(vDigits, vNine), vNine));
+			int iRun = CountTrailingZeros(~uiDigitMask); // The upper bits of the inverted mask are set, so it is never 0
+			iCount += iRun;
+			if (iRun < 16)
+			{
+				return iCount;
+			}
+		}
+#endif
+		while (p + iCount < end && (unsigned char)(p[iCount] - '0') <= 9)
+		{
+			iCount++;
+		}
+		return iCount;
+	}
+
+	// Digits known to be there, 8 at a time (SWAR: each step combines neighbouring digits into numbers twice as long)
+	unsigned long long AccumulateDigits(const char* p, int iCount, unsigned long long ullValue)
+	{
+		int i = 0;
+		for (; i + 8 <= iCount; i += 8)
+		{
+			unsigned long long ullDigits;
+			memcpy(&ullDigits, p + i, sizeof(ullDigits));
+			ullDigits -= 0x3030303030303030ull;
+			ullDigits = (ullDigits * 10) + (ullDigits >> 8);
+			ullDigits = (((ullDigits & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) + (((ullDigits >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+			ullValue = ullValue * 100000000 + (unsigned int)ullDigits;
+		}
+		for (; i < iCount; i++)
+		{
+			ullValue = ullValue * 10 + (p[i] - '0');
+		}
+		return ullValue;
+	}
+
+	// [+-]digits[.digits][(e|E)[+-]digits], without a locale; returns the end of the number, or nullptr if there isn't one
+	// The digits become an exact integer, scaled by an exact power of 10, so the result is correctly rounded to double before it is rounded to float
+	const char* ParseFloat(const char* p, const char* end, float* pValue)
+	{
+		bool bNegative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			bNegative = (*p == '-');
+			p++;
+		}
+
+		const char* integerDigits = p;
+		int iIntegerCount = CountDigits(p, end);
+		p += iIntegerCount;
+		const char* fractionDigits = p;
+		int iFractionCount = 0;
+		if (p < end && *p == '.')
+		{
+			fractionDigits = ++p;
+			iFractionCount = CountDigits(p, end);
+			p += iFractionCount;
+		}
+		if (iIntegerCount + iFractionCount == 0)
+		{
+			return nullptr;
+		}
+
+		// Leading zeros are skipped, so that they don't use up significant digits
+		int iExponent = 0;
+		while (iIntegerCount > 0 && *integerDigits == '0')
+		{
+			integerDigits++;
+			iIntegerCount--;
+		}
+		if (iIntegerCount == 0)
+		{
+			while (iFractionCount > 0 && *fractionDigits == '0')
+			{
+				fractionDigits++;
+				iFractionCount--;
+				iExponent--;
+			}
+		}
+		int iIntegerTaken = (std::min)(iIntegerCount, MaxSignificantDigits);
+		int iFractionTaken = (std::min)(iFractionCount, MaxSignificantDigits - iIntegerTaken);
+		unsigned long long ullMantissa = AccumulateDigits(integerDigits, iIntegerTaken, 0);
+		ullMantissa = AccumulateDigits(fractionDigits, iFractionTaken, ullMantissa);
+		iExponent += (iIntegerCount - iIntegerTaken) - iFractionTaken;
+
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			p++;
+			bool bNegativeExponent = false;
+			if (p < end && (*p == '-' || *p == '+'))
+			{
+				bNegativeExponent = (*p == '-');
+				p++;
+			}
+			int iExponentCount = CountDigits(p, end);
+			if (iExponentCount == 0)
+			{
+				return nullptr;
+			}
+			int iWrittenExponent = (int)AccumulateDigits(p, (std::min)(iExponentCount, 4), 0); // Anything larger is out of range anyway
+			iExponent += bNegativeExponent ? -iWrittenExponent : iWrittenExponent;
+			p += iExponentCount;
+		}
+
+		double dValue = (double)ullMantissa;
+		if (ullMantissa != 0 && iExponent != 0)
+		{
+			if (iExponent >= -22 && iExponent <= 22)
+			{
+				dValue = (iExponent < 0) ? dValue / PowersOf10[-iExponent] : dValue * PowersOf10[iExponent];
+			}
+			else
+			{
+				dValue *= pow(10.0, iExponent);
+			}
+		}
+		*pValue = (float)(bNegative ? -dValue : dValue);
+		return p;
+	}
+
+	struct TextChunk
+	{
+		std::vector<ModelData> vertices;
+		std::vector<std::pair<int, std::string>> errors; // Line within the chunk, and what is wrong with it
+		int iLineCount;
+	};
+
+	// Start of the chunk's first line: just past the first newline at or after an even split of the data
+	const char* GetChunkStart(const char* data, const char* end, int iChunk, int iChunkCount)
+	{
+		if (iChunk == 0)
+		{
+			return data;
+		}
+		if (iChunk == iChunkCount)
+		{
+			return end;
+		}
+		const char* split = data + (size_t)(end - data) * iChunk / iChunkCount;
+		const char* newline = (const char*)memchr(split, '\n', end - split);
+		return newline ? newline + 1 : end;
+	}
+
+	void ParseTextChunk(const char* p, const char* chunkEnd, const char* end, TextChunk& chunk)
+	{
+		chunk.vertices.reserve((chunkEnd - p) / 64); // About as long as a line
+		chunk.iLineCount = 0;
+		for (; p < chunkEnd; chunk.iLineCount++)
+		{
+			const char* lineEnd = (const char*)memchr(p, '\n', chunkEnd - p);
+			if (!lineEnd)
+			{
+				lineEnd = chunkEnd;
+			}
+
+			// Blank lines are skipped; any other line is one vertex
+			while (p < lineEnd && IsSpace(*p))
+			{
+				p++;
+			}
+			if (p < lineEnd)
+			{
+				float values[8];
+				int iValueCount = 0;
+				while (iValueCount < 8 && p < lineEnd)
+				{
+					// The digits can be scanned past the end of the line (up to the end of the data), as a newline ends them
+					const char* numberEnd = ParseFloat(p, end, &values[iValueCount]);
+					if (!numberEnd || (numberEnd < lineEnd && !IsSpace(*numberEnd)))
+					{
+						break;
+					}
+					iValueCount++;
+					p = numberEnd;
+					while (p < lineEnd && IsSpace(*p))
+					{
+						p++;
+					}
+				}
+
+				if (iValueCount < 8)
+				{
+					chunk.errors.push_back({ chunk.iLineCount, (p < lineEnd) ? "value " + std::to_string(iValueCount + 1) + " is not a number" : "expected 8 values, found " + std::to_string(iValueCount) });
+				}
+				else if (p < lineEnd)
+				{
+					chunk.errors.push_back({ chunk.iLineCount, "more than 8 values" });
+				}
+				else
+				{
+					ModelData vertex = { values[0], values[1], values[2], values[3], values[4], values[5], values[6], values[7] };
+					chunk.vertices.push_back(vertex);
+				}
+			}
+
+			p = lineEnd + 1;
+		}
+	}
+}
+
+bool MeshFile::ParseText(const unsigned char* data, size_t size, std::vector<ModelData>& vertices, std::vector<std::string>* pErrors, int iThreadCount)
+{
+	const char* text = (const char*)data;
+	const char* end = text + size;
+	std::vector<std::string> errors;
+	auto fail = [&](const std::string& error)
+	{
+		if (pErrors)
+		{
+			pErrors->push_back(error);
+		}
+		vertices.clear();
+		return false;
+	};
+
+	// The vertex count follows the first ':', and the data follows the second
+	const char* p = (const char*)memchr(text, ':', size);
+	if (!p)
+	{
+		return fail("missing the vertex count");
+	}
+	p++;
+	while (p < end && IsSpace(*p))
+	{
+		p++;
+	}
+	int iDigitCount = CountDigits(p, end);
+	int iVertexCount = (iDigitCount > 0 && iDigitCount <= 9) ? (int)AccumulateDigits(p, iDigitCount, 0) : 0;
+	if (iVertexCount <= 0)
+	{
+		return fail("missing the vertex count");
+	}
+	p = (const char*)memchr(p, ':', end - p);
+	if (!p)
+	{
+		return fail("missing the data");
+	}
+	p++;
+
+	// Line numbers are counted from the line holding the second ':', which is where the first chunk starts
+	int iFirstLine = 1 + (int)std::count(text, p, '\n');
+
+	// Chunks are line aligned, so each one is parsed on its own; they are numbered and joined afterwards
+	int iChunkCount = (int)((end - p + TextChunkSize - 1) / TextChunkSize);
+	std::vector<TextChunk> chunks(iChunkCount);
+	Utils::ParallelFor(iChunkCount, iThreadCount, [&](int iBegin, int iEnd)
+	{
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			ParseTextChunk(GetChunkStart(p, end, i, iChunkCount), GetChunkStart(p, end, i + 1, iChunkCount), end, chunks[i]);
+		}
+	}, 2);
+
+	size_t vertexCount = 0;
+	int iErrorCount = 0;
+	int iLine = iFirstLine;
+	for (const auto& chunk : chunks)
+	{
+		vertexCount += chunk.vertices.size();
+		for (const auto& error : chunk.errors)
+		{
+			if (iErrorCount++ < MaxReportedErrors)
+			{
+				errors.push_back("line " + std::to_string(iLine + error.first) + ": " + error.second);
+			}
+		}
+		iLine += chunk.iLineCount;
+	}
+	if (iErrorCount > MaxReportedErrors)
+	{
+		errors.push_back("and " + std::to_string(iErrorCount - MaxReportedErrors) + " more malformed lines");
+	}
+	if (iErrorCount == 0 && vertexCount != (size_t)iVertexCount)
+	{
+		errors.push_back(std::to_string(iVertexCount) + " vertices declared, " + std::to_string(vertexCount) + " found");
+	}
+	if (!errors.empty())
+	{
+		if (pErrors)
+		{
+			pErrors->insert(pErrors->end(), errors.begin(), errors.end());
+		}
+		vertices.clear();
+		return false;
+	}
+
+	vertices.resize(vertexCount);
+	ModelData* pVertex = vertices.data();
+	for (const auto& chunk : chunks)
+	{
+		pVertex = std::copy(chunk.vertices.begin(), chunk.vertices.end(), pVertex);
+	}
+
+	return true;
+}
+
+bool MeshFile::ReadCooked(const unsigned char* data, size_t size, std::vector<ModelData>& vertices, std::vector<unsigned int>& indices, std::vector<MeshLod>& lods, std::vector<Meshlet>& meshlets)
+{
+	CookedHeader header;
+	if (size < sizeof(header))
+	{
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (header.uiMagic != CookedMagic || header.uiVersion != CookedVersion || header.uiVertexCount == 0 || header.uiIndexCount == 0 || header.uiLodCount == 0)
+	{
+		return false;
+	}
+
+	size_t vertexBytes = (size_t)header.uiVertexCount * sizeof(ModelData);
+	size_t indexBytes = (size_t)header.uiIndexCount * sizeof(unsigned int);
+	size_t lodBytes = (size_t)header.uiLodCount * sizeof(MeshLod);
+	size_t meshletBytes = (size_t)header.uiMeshletCount * sizeof(Meshlet);
+	if (size - sizeof(header) != vertexBytes + indexBytes + lodBytes + meshletBytes)
+	{
+		return false;
+	}
+
+	vertices.resize(header.uiVertexCount);
+	indices.resize(header.uiIndexCount);
+	lods.resize(header.uiLodCount);
+	meshlets.resize(header.uiMeshletCount);
+	memcpy(vertices.data(), data + sizeof(header), vertexBytes);
+	memcpy(indices.data(), data + sizeof(header) + vertexBytes, indexBytes);
+	memcpy(lods.data(), data + sizeof(header) + vertexBytes + indexBytes, lodBytes);
+	if (meshletBytes > 0)
+	{
+		memcpy(meshlets.data(), data + sizeof(header) + vertexBytes + indexBytes + lodBytes, meshletBytes);
+	}
+
+	for (const auto& lod : lods)
+	{
+		if (lod.uiIndexCount == 0 || lod.uiIndexCount % 3 != 0 || lod.uiFirstIndex > header.uiIndexCount || lod.uiIndexCount > header.uiIndexCount - lod.uiFirstIndex)
+		{
+			return false;
+		}
+	}
+
+	// Meshlets split up the full detail level
+	for (const auto& meshlet : meshlets)
+	{
+		if (meshlet.uiIndexCount == 0 || meshlet.uiIndexCount % 3 != 0 || meshlet.uiFirstIndex < lods[0].uiFirstIndex || meshlet.uiFirstIndex > lods[0].uiFirstIndex + lods[0].uiIndexCount ||
+			meshlet.uiIndexCount > lods[0].uiFirstIndex + lods[0].uiIndexCount - meshlet.uiFirstIndex)
+		{
+			return false;
+		}
+	}
+
+	for (unsigned int uiIndex : indices)
+	{
+		if (uiIndex >= header.uiVertexCount)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void MeshFile::WriteCooked(const std::vector<ModelData>& vertices, const std::vector<unsigned int>& indices, const std::vector<MeshLod>& lods, const std::vector<Meshlet>& meshlets, std::vector<unsigned char>& output)
+{
+	CookedHeader header;
+	header.uiMagic = CookedMagic;
+	header.uiVersion = CookedVersion;
+	header.uiVertexCount = (unsigned int)vertices.size();
+	header.uiIndexCount = (unsigned int)indices.size();
+	header.uiLodCount = (unsigned int)lods.size();
+	header.uiMeshletCount = (unsigned int)meshlets.size();
+
+	const unsigned char* headerBytes = (const unsigned char*)&header;
+	const unsigned char* vertexBytes = (const unsigned char*)vertices.data();
+	const unsigned char* indexBytes = (const unsigned char*)indices.data();
+	const unsigned char* lodBytes = (const unsigned char*)lods.data();
+	const unsigned char* meshletBytes = (const unsigned char*)meshlets.data();
+	output.insert(output.end(), headerBytes, headerBytes + sizeof(header));
+	output.insert(output.end(), vertexBytes, vertexBytes + vertices.size() * sizeof(ModelData));
+	output.insert(output.end(), indexBytes, indexBytes + indices.size() * sizeof(unsigned int));
+	output.insert(output.end(), lodBytes, lodBytes + lods.size() * sizeof(MeshLod));
+	output.insert(output.end(), meshletBytes, meshletBytes + meshlets.size() * sizeof(Meshlet));
+}
@@ -0,0 +1,71 @@
+//
+// MeshFile.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// RasterTek Tutorial 8: Loading Maya 2011 Models (http://www.rastertek.com/dx11tut08.html)
+//
+
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <directxmath.h>
+#include <string>
+#include <vector>
+#include "Utils.h"
+
+using namespace DirectX;
+
+struct ModelData
+{
+	float x, y, z;
+	float tu, tv;
+	float nx, ny, nz;
+};
+
+struct Vertex // As the vertex buffers hold it, for meshes built in code rather than read from a file
+{
+	XMFLOAT3 position;
+	XMFLOAT2 textureCoordinate;
+	XMFLOAT3 normal;
+};
+
+struct MeshLod // Level of detail: a range of the index buffer, and how far (in model units) its surface may stray from the full mesh
+{
+	unsigned int uiFirstIndex;
+	unsigned int uiIndexCount;
+	float fError;
+};
+
+struct Meshlet // Cluster of neighbouring triangles of the full detail level, with bounds for culling it as a whole
+{
+	unsigned int uiFirstIndex;
+	unsigned int uiIndexCount;
+	float x, y, z, fRadius; // Bounding sphere, in model units
+	float nx, ny, nz, fConeCutoff; // Axis of the cone holding every triangle's normal, and the sine of its half angle (1 when the normals are too spread to cull by)
+};
+
+// Reads the model formats without needing a device, so that the asset cooker can run on its own
+// Text models (RasterTek layout) are unindexed triangle lists; cooked models are welded and indexed
+class MeshFile
+{
+public:
+	// Splits the data into line aligned chunks that are parsed on iThreadCount threads (0 uses every core)
+	// Any malformed line fails the whole model (a missing vertex would shift every triangle after it); pErrors receives the line numbers and causes
+	static bool ParseText(const unsigned char* data, size_t size, std::vector<ModelData>& vertices, std::vector<std::string>* pErrors = nullptr, int iThreadCount = 0);
+	static bool ReadCooked(const unsigned char* data, size_t size, std::vector<ModelData>& vertices, std::vector<unsigned int>& indices, std::vector<MeshLod>& lods, std::vector<Meshlet>& meshlets); // Checks that every index, level and meshlet is in range
+	static void WriteCooked(const std::vector<ModelData>& vertices, const std::vector<unsigned int>& indices, const std::vector<MeshLod>& lods, const std::vector<Meshlet>& meshlets, std::vector<unsigned char>& output); // The indices of every level, one after another; meshlets may be empty
+
+private:
+	struct CookedHeader
+	{
+		unsigned int uiMagic;
+		unsigned int uiVersion;
+		unsigned int uiVertexCount;
+		unsigned int uiIndexCount;
+		unsigned int uiLodCount; // Levels of detail, listed after the indices
+		unsigned int uiMeshletCount; // Meshlets of the full detail level, listed after the levels
+	};
+};
+
+#endif
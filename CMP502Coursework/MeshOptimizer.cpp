@@ -0,0 +1,265 @@
+//
+// MeshOptimizer.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Linear-Speed Vertex Cache Optimisation (Forsyth, 2006) (https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html)
+// Fast Triangle Reordering for Vertex Locality and Reduced Overdraw (Sander et al., 2007)
+//
+
+#include "MeshOptimizer.h"
+#include <cmath>
+#include <cstring>
+
+void MeshOptimizer::Weld(const ModelData* vertices, int iVertexCount, std::vector<ModelData>& weldedVertices, std::vector<unsigned int>& indices)
+{
+	weldedVertices.clear();
+	indices.clear();
+
+	// Open addressing table of welded vertex indices, hashed on the vertex bytes (FNV-1a)
+	size_t tableSize = 1;
+	while (tableSize < (size_t)iVertexCount * 2)
+	{
+		tableSize *= 2;
+	}
+	std::vector<unsigned int> table(tableSize, ~0u);
+
+	std::vector<unsigned int> remap(iVertexCount);
+	for (int i = 0; i < iVertexCount; i++)
+	{
+		const unsigned char* bytes = (const unsigned char*)&vertices[i];
+		unsigned long long ullHash = 14695981039346656037ull;
+		for (size_t j = 0; j < sizeof(ModelData); j++)
+		{
+			ullHash = (ullHash ^ bytes[j]) * 1099511628211ull;
+		}
+
+		size_t slot = (size_t)ullHash & (tableSize - 1);
+		while (table[slot] != ~0u && memcmp(&weldedVertices[table[slot]], &vertices[i], sizeof(ModelData)) != 0)
+		{
+			slot = (slot + 1) & (tableSize - 1);
+		}
+		if (table[slot] == ~0u)
+		{
+			table[slot] = (unsigned int)weldedVertices.size();
+			weldedVertices.push_back(vertices[i]);
+		}
+		remap[i] = table[slot];
+	}
+
+	for (int i = 0; i + 2 < iVertexCount; i += 3)
+	{
+		unsigned int a = remap[i];
+		unsigned int b = remap[i + 1];
+		unsigned int c = remap[i + 2];
+		if (a != b && b != c && a != c)
+		{
+			indices.push_back(a);
+			indices.push_back(b);
+			indices.push_back(c);
+		}
+	}
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<unsigned int>& indices, int iVertexCount)
+{
+	int iTriangleCount = (int)indices.size() / 3;
+	if (iTriangleCount == 0)
+	{
+		return;
+	}
+
+	// Triangles that use each vertex; the ones not yet emitted are kept at the front of each list
+	std::vector<int> activeCounts(iVertexCount, 0);
+	for (unsigned int uiIndex : indices)
+	{
+		activeCounts[uiIndex]++;
+	}
+	std::vector<int> offsets(iVertexCount + 1, 0);
+	for (int i = 0; i < iVertexCount; i++)
+	{
+		offsets[i + 1] = offsets[i] + activeCounts[i];
+	}
+	std::vector<int> vertexTriangles(offsets[iVertexCount]);
+	{
+		std::vector<int> ends(offsets.begin(), offsets.end() - 1);
+		for (int i = 0; i < iTriangleCount * 3; i++)
+		{
+			vertexTriangles[ends[indices[i]]++] = i / 3;
+		}
+	}
+
+	std::vector<int> cachePositions(iVertexCount, -1);
+	std::vector<float> vertexScores(iVertexCount);
+	for (int i = 0; i < iVertexCount; i++)
+	{
+		vertexScores[i] = GetVertexScore(-1, activeCounts[i]);
+	}
+
+	std::vector<float> triangleScores(iTriangleCount);
+	std::vector<bool> emitted(iTriangleCount, false);
+	int iBestTriangle = 0;
+	for (int i = 0; i < iTriangleCount; i++)
+	{
+		triangleScores[i] = vertexScores[indices[i * 3]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+		if (triangleScores[i] > triangleScores[iBestTriangle])
+		{
+			iBestTriangle = i;
+		}
+	}
+
+	// Updates a vertex's score and the scores of the triangles it still has
+	auto rescore = [&](int iVertex)
+	{
+		float fScore = GetVertexScore(cachePositions[iVertex], activeCounts[iVertex]);
+		float fDelta = fScore - vertexScores[iVertex];
+		vertexScores[iVertex] = fScore;
+		for (int j = offsets[iVertex]; j < offsets[iVertex] + activeCounts[iVertex]; j++)
+		{
+			triangleScores[vertexTriangles[j]] += fDelta;
+		}
+	};
+
+	std::vector<unsigned int> optimizedIndices;
+	optimizedIndices.reserve(iTriangleCount * 3);
+	int cache[CacheSize + 3];
+	int iCacheCount = 0;
+	int iNextTriangle = 0; // Where to look for a new start once the cache has nothing left to offer
+
+	for (int iEmitted = 0; iEmitted < iTriangleCount; iEmitted++)
+	{
+		if (iBestTriangle < 0)
+		{
+			while (emitted[iNextTriangle])
+			{
+				iNextTriangle++;
+			}
+			iBestTriangle = iNextTriangle;
+		}
+
+		// Emit the triangle and take it out of its vertices' lists
+		int iTriangle = iBestTriangle;
+		emitted[iTriangle] = true;
+		const unsigned int* triangle = &indices[iTriangle * 3];
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int uiVertex = triangle[k];
+			optimizedIndices.push_back(uiVertex);
+
+			int* vertexList = &vertexTriangles[offsets[uiVertex]];
+			int iLast = activeCounts[uiVertex] - 1;
+			for (int j = 0; j <= iLast; j++)
+			{
+				if (vertexList[j] == iTriangle)
+				{
+					std::swap(vertexList[j], vertexList[iLast]);
+					break;
+				}
+			}
+			activeCounts[uiVertex]--;
+		}
+
+		// The triangle's vertices move to the front of the cache, pushing the rest back
+		int newCache[CacheSize + 3];
+		int iNewCount = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			if (std::find(newCache, newCache + iNewCount, (int)triangle[k]) == newCache + iNewCount)
+			{
+				newCache[iNewCount++] = triangle[k];
+			}
+		}
+		int iTriangleVertexCount = iNewCount;
+		for (int j = 0; j < iCacheCount; j++)
+		{
+			if (std::find(newCache, newCache + iTriangleVertexCount, cache[j]) == newCache + iTriangleVertexCount)
+			{
+				newCache[iNewCount++] = cache[j];
+			}
+		}
+
+		// Rescore what fell out of the cache, then what is in it, picking the best triangle that the cache touches
+		for (int j = CacheSize; j < iNewCount; j++)
+		{
+			cachePositions[newCache[j]] = -1;
+			rescore(newCache[j]);
+		}
+		iCacheCount = (std::min)(iNewCount, (int)CacheSize);
+		iBestTriangle = -1;
+		float fBestScore = -1.0f;
+		for (int j = 0; j < iCacheCount; j++)
+		{
+			int iVertex = newCache[j];
+			cache[j] = iVertex;
+			cachePositions[iVertex] = j;
+			rescore(iVertex);
+			for (int t = offsets[iVertex]; t < offsets[iVertex] + activeCounts[iVertex]; t++)
+			{
+				if (triangleScores[vertexTriangles[t]] > fBestScore)
+				{
+					fBestScore = triangleScores[vertexTriangles[t]];
+					iBestTriangle = vertexTriangles[t];
+				}
+			}
+		}
+	}
+
+	indices.swap(optimizedIndices);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<ModelData>& vertices, std::vector<unsigned int>& indices)
+{
+	std::vector<unsigned int> remap(vertices.size(), ~0u);
+	std::vector<ModelData> orderedVertices;
+	orderedVertices.reserve(vertices.size());
+	for (auto& uiIndex : indices)
+	{
+		if (remap[uiIndex] == ~0u)
+		{
+			remap[uiIndex] = (unsigned int)orderedVertices.size();
+			orderedVertices.push_back(vertices[uiIndex]);
+		}
+		uiIndex = remap[uiIndex];
+	}
+	vertices.swap(orderedVertices);
+}
+
+float MeshOptimizer::GetACMR(const std::vector<unsigned int>& indices, int iVertexCount, int iCacheSize)
+{
+	if (indices.size() < 3)
+	{
+		return 0.0f;
+	}
+
+	// A vertex is still in the FIFO if fewer than iCacheSize misses have happened since it was loaded
+	std::vector<int> loadedAt(iVertexCount, -iCacheSize - 1);
+	int iMissCount = 0;
+	for (unsigned int uiIndex : indices)
+	{
+		if (iMissCount - loadedAt[uiIndex] > iCacheSize)
+		{
+			loadedAt[uiIndex] = iMissCount;
+			iMissCount++;
+		}
+	}
+
+	return (float)iMissCount / (float)(indices.size() / 3);
+}
+
+float MeshOptimizer::GetVertexScore(int iCachePosition, int iActiveTriangles)
+{
+	if (iActiveTriangles == 0)
+	{
+		return -1.0f; // Nothing left to gain from this vertex
+	}
+
+	// The last triangle's vertices get a fixed score, so that the next triangle doesn't favour one of its edges over another
+	float fScore = 0.0f;
+	if (iCachePosition >= 0)
+	{
+		fScore = (iCachePosition < 3) ? 0.75f : powf(1.0f - (iCachePosition - 3) * (1.0f / (CacheSize - 3)), 1.5f);
+	}
+
+	// Vertices with few triangles left are boosted, so that they get finished off rather than stranded
+	return fScore + 2.0f * powf((float)iActiveTriangles, -0.5f);
+}
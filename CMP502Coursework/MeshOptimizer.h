@@ -0,0 +1,36 @@
+//
+// MeshOptimizer.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Linear-Speed Vertex Cache Optimisation (Forsyth, 2006) (https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html)
+// Fast Triangle Reordering for Vertex Locality and Reduced Overdraw (Sander et al., 2007)
+//
+
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+#include "MeshFile.h"
+#include "Utils.h"
+
+// Turns unindexed triangle lists into indexed meshes that the GPU transforms and fetches efficiently
+class MeshOptimizer
+{
+public:
+	// Merges bitwise identical vertices and drops the triangles that collapse as a result
+	static void Weld(const ModelData* vertices, int iVertexCount, std::vector<ModelData>& weldedVertices, std::vector<unsigned int>& indices);
+	// Reorders the triangles so that the post-transform cache reuses as many vertices as it can
+	static void OptimizeVertexCache(std::vector<unsigned int>& indices, int iVertexCount);
+	// Reorders the vertices by first use, so that fetches walk forwards through the buffer; unused vertices are dropped
+	static void OptimizeVertexFetch(std::vector<ModelData>& vertices, std::vector<unsigned int>& indices);
+	// Average cache miss ratio: vertices transformed per triangle with a FIFO cache (3 for an unindexed list, about 0.5 at best)
+	static float GetACMR(const std::vector<unsigned int>& indices, int iVertexCount, int iCacheSize = 16);
+
+private:
+	static const int CacheSize = 32; // Modelled LRU cache; larger than real FIFO caches so that the order suits any of them
+
+	static float GetVertexScore(int iCachePosition, int iActiveTriangles);
+};
+
+#endif
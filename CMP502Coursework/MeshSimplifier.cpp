@@ -0,0 +1,777 @@
+//
+// MeshSimplifier.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Surface Simplification Using Quadric Error Metrics (Garland and Heckbert, 1997)
+// Simplifying Surfaces with Color and Texture using Quadric Error Metrics (Garland and Heckbert, 1998)
+// meshoptimizer: simplifier.cpp (Kapoulkine) (https://github.com/zeux/meshoptimizer)
+//
+
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+	// Whether a vertex of the first kind may be collapsed onto one of the second: borders and seams only move along themselves
+	const bool CanCollapse[4][4] =
+	{
+		{ true, true, true, true },
+		{ false, true, false, false },
+		{ false, false, true, false },
+		{ false, false, false, false }
+	};
+
+	// Whether an edge between the two kinds is shared by two triangles (for seams, in the mesh with only positions), so that it is met twice
+	const bool HasOpposite[4][4] =
+	{
+		{ true, true, true, false },
+		{ true, false, true, false },
+		{ true, true, true, false },
+		{ false, false, false, false }
+	};
+
+	const float BoundaryWeight = 10.0f; // Of the planes that hold borders and seams in place, relative to the triangles'
+	const float PassErrorRatio = 1.5f; // Collapses in one pass stop at this much more error than the last one the pass needs, as their costs change once their neighbors move
+
+	void Cross(const float* a, const float* b, float* result)
+	{
+		result[0] = a[1] * b[2] - a[2] * b[1];
+		result[1] = a[2] * b[0] - a[0] * b[2];
+		result[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	float Dot(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	float GetDistance(const float* a, const float* b)
+	{
+		float difference[3] = { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+		return sqrtf(Dot(difference, difference));
+	}
+
+	float GetTriangleDistance(const float* p, const float* a, const float* b, const float* c)
+	{
+		// Reference:
+		// Real-Time Collision Detection (Ericson, 2005), 5.1.5 Closest Point on Triangle to Point
+
+		float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		float ap[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+		float bp[3] = { p[0] - b[0], p[1] - b[1], p[2] - b[2] };
+		float cp[3] = { p[0] - c[0], p[1] - c[1], p[2] - c[2] };
+		float d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+		float d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+		float d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+		float va = d3 * d6 - d5 * d4, vb = d5 * d2 - d1 * d6, vc = d1 * d4 - d3 * d2;
+
+		float u, v; // Closest point a + u * ab + v * ac
+		if (d1 <= 0.0f && d2 <= 0.0f)
+		{
+			u = 0.0f, v = 0.0f;
+		}
+		else if (d3 >= 0.0f && d4 <= d3)
+		{
+			u = 1.0f, v = 0.0f;
+		}
+		else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+		{
+			u = d1 / (d1 - d3), v = 0.0f;
+		}
+		else if (d6 >= 0.0f && d5 <= d6)
+		{
+			u = 0.0f, v = 1.0f;
+		}
+		else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+		{
+			u = 0.0f, v = d2 / (d2 - d6);
+		}
+		else if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+		{
+			v = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			u = 1.0f - v;
+		}
+		else
+		{
+			float fDenominator = va + vb + vc;
+			u = (fDenominator != 0.0f) ? vb / fDenominator : 0.0f;
+			v = (fDenominator != 0.0f) ? vc / fDenominator : 0.0f;
+		}
+		float closest[3] = { a[0] + u * ab[0] + v * ac[0], a[1] + u * ab[1] + v * ac[1], a[2] + u * ab[2] + v * ac[2] };
+		return GetDistance(p, closest);
+	}
+
+	// Uniform grid of triangles, for the distance from a point to the nearest of them
+	class TriangleGrid
+	{
+	public:
+		void Build(const float* positions, const std::vector<unsigned int>& indices) // Positions within the unit cube
+		{
+			m_positions = positions;
+			m_indices = &indices;
+			int iTriangleCount = (int)indices.size() / 3;
+			m_iResolution = (std::max)(1, (std::min)(128, (int)(2.0f * cbrtf((float)iTriangleCount))));
+			m_cells.assign(m_iResolution * m_iResolution * m_iResolution + 1, 0);
+
+			// Counted, then filled, with each triangle in every cell its bounding box touches
+			for (int iPass = 0; iPass < 2; iPass++)
+			{
+				std::vector<unsigned int> next;
+				if (iPass == 1)
+				{
+					for (size_t i = 1; i < m_cells.size(); i++)
+					{
+						m_cells[i] += m_cells[i - 1];
+					}
+					m_triangles.resize(m_cells.back());
+					next.assign(m_cells.begin(), m_cells.end() - 1);
+				}
+				for (int i = 0; i < iTriangleCount; i++)
+				{
+					int minimum[3], maximum[3];
+					for (int j = 0; j < 3; j++)
+					{
+						float fMinimum = (std::min)(GetPosition(i, 0)[j], (std::min)(GetPosition(i, 1)[j], GetPosition(i, 2)[j]));
+						float fMaximum = (std::max)(GetPosition(i, 0)[j], (std::max)(GetPosition(i, 1)[j], GetPosition(i, 2)[j]));
+						minimum[j] = GetCell(fMinimum);
+						maximum[j] = GetCell(fMaximum);
+					}
+					for (int z = minimum[2]; z <= maximum[2]; z++)
+					{
+						for (int y = minimum[1]; y <= maximum[1]; y++)
+						{
+							for (int x = minimum[0]; x <= maximum[0]; x++)
+							{
+								int iCell = (z * m_iResolution + y) * m_iResolution + x;
+								if (iPass == 0)
+								{
+									m_cells[iCell + 1]++;
+								}
+								else
+								{
+									m_triangles[next[iCell]++] = (unsigned int)i;
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+
+		float GetDistance(const float* p) const
+		{
+			// Search shells of cells outwards until the nearest triangle found is closer than any cell left to search
+			int center[3] = { GetCell(p[0]), GetCell(p[1]), GetCell(p[2]) };
+			float fCellSize = 1.0f / m_iResolution;
+			float fDistance = 3.0f;
+			for (int iRing = 0; iRing < m_iResolution; iRing++)
+			{
+				for (int z = (std::max)(0, center[2] - iRing); z <= (std::min)(m_iResolution - 1, center[2] + iRing); z++)
+				{
+					for (int y = (std::max)(0, center[1] - iRing); y <= (std::min)(m_iResolution - 1, center[1] + iRing); y++)
+					{
+						for (int x = (std::max)(0, center[0] - iRing); x <= (std::min)(m_iResolution - 1, center[0] + iRing); x++)
+						{
+							if (abs(x - center[0]) != iRing && abs(y - center[1]) != iRing && abs(z - center[2]) != iRing)
+							{
+								continue; // Searched in an earlier shell
+							}
+							float fCellDistanceSquared = 0.0f;
+							int cell[3] = { x, y, z };
+							for (int k = 0; k < 3; k++)
+							{
+								float fOutside = (std::max)(cell[k] * fCellSize - p[k], p[k] - (cell[k] + 1) * fCellSize);
+								fCellDistanceSquared += (fOutside > 0.0f) ? fOutside * fOutside : 0.0f;
+							}
+							if (fCellDistanceSquared >= fDistance * fDistance)
+							{
+								continue; // Nothing in the cell can be nearer
+							}
+							int iCell = (z * m_iResolution + y) * m_iResolution + x;
+							for (unsigned int j = m_cells[iCell]; j < m_cells[iCell + 1]; j++)
+							{
+								int iTriangle = (int)m_triangles[j];
+								fDistance = (std::min)(fDistance, GetTriangleDistance(p, GetPosition(iTriangle, 0), GetPosition(iTriangle, 1), GetPosition(iTriangle, 2)));
+							}
+						}
+					}
+				}
+				if (fDistance <= iRing * fCellSize)
+				{
+					break;
+				}
+			}
+			return fDistance;
+		}
+
+	private:
+		const float* m_positions;
+		const std::vector<unsigned int>* m_indices;
+		int m_iResolution;
+		std::vector<unsigned int> m_cells; // Start of each cell's triangles
+		std::vector<unsigned int> m_triangles;
+
+		const float* GetPosition(int iTriangle, int iCorner) const
+		{
+			return &m_positions[(*m_indices)[iTriangle * 3 + iCorner] * 3];
+		}
+
+		int GetCell(float fCoordinate) const
+		{
+			return (std::max)(0, (std::min)(m_iResolution - 1, (int)(fCoordinate * m_iResolution)));
+		}
+	};
+
+	// Compressed lists of the items belonging to each vertex
+	struct VertexLists
+	{
+		std::vector<unsigned int> offsets;
+		std::vector<unsigned int> items;
+
+		template <typename Function> void Build(int iVertexCount, int iItemCount, Function getVertex) // getVertex(item) is the vertex an item belongs to
+		{
+			offsets.assign(iVertexCount + 1, 0);
+			for (int i = 0; i < iItemCount; i++)
+			{
+				offsets[getVertex(i) + 1]++;
+			}
+			for (int i = 0; i < iVertexCount; i++)
+			{
+				offsets[i + 1] += offsets[i];
+			}
+			items.resize(iItemCount);
+			std::vector<unsigned int> next(offsets.begin(), offsets.end() - 1);
+			for (int i = 0; i < iItemCount; i++)
+			{
+				items[next[getVertex(i)]++] = (unsigned int)i;
+			}
+		}
+	};
+}
+
+#pragma region Simplification
+
+float MeshSimplifier::Simplify(const ModelData* vertices, int iVertexCount, const std::vector<unsigned int>& indices, int iTargetIndexCount, float fTargetError, std::vector<unsigned int>& result)
+{
+	result = indices;
+	if ((int)result.size() <= iTargetIndexCount || iVertexCount == 0)
+	{
+		return 0.0f;
+	}
+
+	// Positions are scaled into a unit cube, which keeps the quadrics well conditioned in single precision
+	float minimum[3] = { vertices[0].x, vertices[0].y, vertices[0].z };
+	float maximum[3] = { vertices[0].x, vertices[0].y, vertices[0].z };
+	for (int i = 1; i < iVertexCount; i++)
+	{
+		const float* position = &vertices[i].x;
+		for (int j = 0; j < 3; j++)
+		{
+			minimum[j] = (std::min)(minimum[j], position[j]);
+			maximum[j] = (std::max)(maximum[j], position[j]);
+		}
+	}
+	float fExtent = (std::max)(maximum[0] - minimum[0], (std::max)(maximum[1] - minimum[1], maximum[2] - minimum[2]));
+	if (fExtent <= 0.0f)
+	{
+		fExtent = 1.0f;
+	}
+	std::vector<float> positions(iVertexCount * 3);
+	for (int i = 0; i < iVertexCount; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			positions[i * 3 + j] = ((&vertices[i].x)[j] - minimum[j]) / fExtent;
+		}
+	}
+
+	// Vertices at the same position (split by their other attributes) are linked in rings, and share the first one's quadric
+	std::vector<unsigned int> remap(iVertexCount);
+	std::vector<unsigned int> wedge(iVertexCount);
+	{
+		size_t tableSize = 1;
+		while (tableSize < (size_t)iVertexCount * 2)
+		{
+			tableSize *= 2;
+		}
+		std::vector<unsigned int> table(tableSize, ~0u);
+		for (int i = 0; i < iVertexCount; i++)
+		{
+			const unsigned char* bytes = (const unsigned char*)&vertices[i].x;
+			unsigned long long ullHash = 14695981039346656037ull;
+			for (size_t j = 0; j < 3 * sizeof(float); j++)
+			{
+				ullHash = (ullHash ^ bytes[j]) * 1099511628211ull;
+			}
+
+			size_t slot = (size_t)ullHash & (tableSize - 1);
+			while (table[slot] != ~0u && memcmp(&vertices[table[slot]].x, &vertices[i].x, 3 * sizeof(float)) != 0)
+			{
+				slot = (slot + 1) & (tableSize - 1);
+			}
+			if (table[slot] == ~0u)
+			{
+				table[slot] = (unsigned int)i;
+				remap[i] = (unsigned int)i;
+				wedge[i] = (unsigned int)i;
+			}
+			else
+			{
+				unsigned int uiFirst = table[slot];
+				remap[i] = uiFirst;
+				wedge[i] = wedge[uiFirst];
+				wedge[uiFirst] = (unsigned int)i;
+			}
+		}
+	}
+
+	// Half-edges leaving each vertex, to find the edges that have no opposite (borders, and seams when the vertices are split)
+	int iIndexCount = (int)result.size();
+	VertexLists edges;
+	edges.Build(iVertexCount, iIndexCount, [&](int i) { return result[i]; });
+	auto hasEdge = [&](unsigned int a, unsigned int b)
+	{
+		for (unsigned int j = edges.offsets[a]; j < edges.offsets[a + 1]; j++)
+		{
+			int iCorner = (int)edges.items[j];
+			if (result[iCorner - iCorner % 3 + (iCorner + 1) % 3] == b)
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+
+	// The vertex at the other end of each vertex's open edge going out and coming in: ~0u if there is none, or the vertex itself if there are several
+	std::vector<unsigned int> openOut(iVertexCount, ~0u);
+	std::vector<unsigned int> openIn(iVertexCount, ~0u);
+	for (int i = 0; i < iIndexCount; i++)
+	{
+		unsigned int a = result[i];
+		unsigned int b = result[i - i % 3 + (i + 1) % 3];
+		if (!hasEdge(b, a))
+		{
+			openOut[a] = (openOut[a] == ~0u) ? b : a;
+			openIn[b] = (openIn[b] == ~0u) ? a : b;
+		}
+	}
+
+	std::vector<unsigned char> kinds(iVertexCount);
+	for (int i = 0; i < iVertexCount; i++)
+	{
+		if (remap[i] != (unsigned int)i)
+		{
+			continue;
+		}
+
+		unsigned int v = (unsigned int)i;
+		unsigned char kind = LockedVertex;
+		if (wedge[v] == v)
+		{
+			if (openOut[v] == ~0u && openIn[v] == ~0u)
+			{
+				kind = ManifoldVertex;
+			}
+			else if (openOut[v] != ~0u && openOut[v] != v && openIn[v] != ~0u && openIn[v] != v)
+			{
+				kind = BorderVertex;
+			}
+		}
+		else if (wedge[wedge[v]] == v)
+		{
+			// Each side of a seam has one open edge in and out, and the two sides' edges join the same positions the other way around
+			unsigned int w = wedge[v];
+			if (openOut[v] != ~0u && openOut[v] != v && openIn[v] != ~0u && openIn[v] != v &&
+				openOut[w] != ~0u && openOut[w] != w && openIn[w] != ~0u && openIn[w] != w &&
+				remap[openIn[v]] == remap[openOut[w]] && remap[openOut[v]] == remap[openIn[w]])
+			{
+				kind = SeamVertex;
+			}
+		}
+		kinds[i] = kind;
+	}
+	for (int i = 0; i < iVertexCount; i++)
+	{
+		kinds[i] = kinds[remap[i]];
+	}
+
+	// Quadrics of the triangles' planes weighted by their areas, and of planes through the open edges at right angles to their triangles
+	std::vector<Quadric> quadrics(iVertexCount);
+	memset(quadrics.data(), 0, quadrics.size() * sizeof(Quadric));
+	for (int i = 0; i + 2 < iIndexCount; i += 3)
+	{
+		const float* p[3] = { &positions[result[i] * 3], &positions[result[i + 1] * 3], &positions[result[i + 2] * 3] };
+		float edge1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+		float edge2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+		float normal[3];
+		Cross(edge1, edge2, normal);
+		float fLength = sqrtf(Dot(normal, normal));
+		if (fLength == 0.0f)
+		{
+			continue;
+		}
+		for (int j = 0; j < 3; j++)
+		{
+			normal[j] /= fLength;
+		}
+		for (int j = 0; j < 3; j++)
+		{
+			AddPlaneQuadric(quadrics[remap[result[i + j]]], normal[0], normal[1], normal[2], -Dot(normal, p[0]), fLength * 0.5f);
+		}
+
+		for (int j = 0; j < 3; j++)
+		{
+			unsigned int a = result[i + j];
+			unsigned int b = result[i + (j + 1) % 3];
+			if (hasEdge(b, a))
+			{
+				continue;
+			}
+			const float* pa = p[j];
+			const float* pb = p[(j + 1) % 3];
+			float edge[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+			float edgeNormal[3];
+			Cross(edge, normal, edgeNormal);
+			float fEdgeLength = sqrtf(Dot(edgeNormal, edgeNormal));
+			if (fEdgeLength == 0.0f)
+			{
+				continue;
+			}
+			for (int k = 0; k < 3; k++)
+			{
+				edgeNormal[k] /= fEdgeLength;
+			}
+			float fDistance = -Dot(edgeNormal, pa);
+			AddPlaneQuadric(quadrics[remap[a]], edgeNormal[0], edgeNormal[1], edgeNormal[2], fDistance, fEdgeLength * fEdgeLength * BoundaryWeight);
+			AddPlaneQuadric(quadrics[remap[b]], edgeNormal[0], edgeNormal[1], edgeNormal[2], fDistance, fEdgeLength * fEdgeLength * BoundaryWeight);
+		}
+	}
+
+	// Collapse edges in passes, each taking the cheapest collapses that don't touch one another, until the target or the error limit is reached
+	float fErrorLimit = (fTargetError / fExtent) * (fTargetError / fExtent);
+	float fResultError = 0.0f;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> collapseRemap(iVertexCount);
+	std::vector<unsigned char> collapseLocked(iVertexCount);
+	std::vector<unsigned int> finalVertex(iVertexCount); // Where each vertex has been collapsed to so far
+	for (int i = 0; i < iVertexCount; i++)
+	{
+		finalVertex[i] = (unsigned int)i;
+	}
+	VertexLists triangles;
+	while ((int)result.size() > iTargetIndexCount)
+	{
+		iIndexCount = (int)result.size();
+
+		collapses.clear();
+		for (int i = 0; i < iIndexCount; i++)
+		{
+			unsigned int a = result[i];
+			unsigned int b = result[i - i % 3 + (i + 1) % 3];
+			unsigned char kindA = kinds[a];
+			unsigned char kindB = kinds[b];
+			if (!CanCollapse[kindA][kindB] && !CanCollapse[kindB][kindA])
+			{
+				continue;
+			}
+			if (HasOpposite[kindA][kindB] && remap[b] > remap[a])
+			{
+				continue; // Taken from the other side
+			}
+			if (kindA == kindB && (kindA == BorderVertex || kindA == SeamVertex) && openOut[a] != b)
+			{
+				continue; // Crosses the surface between two borders or seams
+			}
+			unsigned int c = result[i - i % 3 + (i + 2) % 3];
+			if (kindA == BorderVertex && openOut[b] == c && openOut[c] == a)
+			{
+				continue; // Would remove a triangle that stands on its own, which the quadrics barely notice
+			}
+
+			Collapse collapse;
+			collapse.bBidirectional = CanCollapse[kindA][kindB] && CanCollapse[kindB][kindA];
+			collapse.uiFrom = CanCollapse[kindA][kindB] ? a : b;
+			collapse.uiTo = CanCollapse[kindA][kindB] ? b : a;
+			collapses.push_back(collapse);
+		}
+		if (collapses.empty())
+		{
+			break;
+		}
+
+		// The error of moving a vertex onto the other is measured against the planes of both, and the cheaper way round is taken
+		for (auto& collapse : collapses)
+		{
+			Quadric quadric = quadrics[remap[collapse.uiFrom]];
+			AddQuadric(quadric, quadrics[remap[collapse.uiTo]]);
+			collapse.fError = GetQuadricError(quadric, &positions[collapse.uiTo * 3]);
+			if (collapse.bBidirectional)
+			{
+				float fReverseError = GetQuadricError(quadric, &positions[collapse.uiFrom * 3]);
+				if (fReverseError < collapse.fError)
+				{
+					std::swap(collapse.uiFrom, collapse.uiTo);
+					collapse.fError = fReverseError;
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.fError < b.fError; });
+
+		int iTriangleGoal = (iIndexCount - iTargetIndexCount + 2) / 3;
+		size_t goalCollapse = (std::min)(collapses.size() - 1, (size_t)(iTriangleGoal / 2));
+		float fPassLimit = (std::min)(fErrorLimit, (std::max)(collapses[goalCollapse].fError * PassErrorRatio, collapses[0].fError));
+
+		// Triangles around each position, to check that a collapse doesn't turn any of them over
+		triangles.Build(iVertexCount, iIndexCount, [&](int i) { return remap[result[i]]; });
+		auto hasFlips = [&](unsigned int uiFrom, unsigned int uiTo)
+		{
+			const float* from = &positions[uiFrom * 3];
+			const float* to = &positions[uiTo * 3];
+			for (unsigned int j = triangles.offsets[remap[uiFrom]]; j < triangles.offsets[remap[uiFrom] + 1]; j++)
+			{
+				int iCorner = (int)triangles.items[j];
+				int iTriangle = iCorner - iCorner % 3;
+				unsigned int b = result[iTriangle + (iCorner + 1) % 3];
+				unsigned int c = result[iTriangle + (iCorner + 2) % 3];
+				if (remap[b] == remap[uiTo] || remap[c] == remap[uiTo])
+				{
+					continue; // Collapses away
+				}
+				const float* pb = &positions[b * 3];
+				const float* pc = &positions[c * 3];
+				float before1[3] = { pb[0] - from[0], pb[1] - from[1], pb[2] - from[2] };
+				float before2[3] = { pc[0] - from[0], pc[1] - from[1], pc[2] - from[2] };
+				float after1[3] = { pb[0] - to[0], pb[1] - to[1], pb[2] - to[2] };
+				float after2[3] = { pc[0] - to[0], pc[1] - to[1], pc[2] - to[2] };
+				float normalBefore[3], normalAfter[3];
+				Cross(before1, before2, normalBefore);
+				Cross(after1, after2, normalAfter);
+				if (Dot(normalBefore, normalAfter) <= 0.0f)
+				{
+					return true;
+				}
+
+				// Nor may it turn a triangle away from the normals it is shaded with
+				const ModelData& vertexB = vertices[b];
+				const ModelData& vertexC = vertices[c];
+				float shadingBefore[3] = { vertices[uiFrom].nx + vertexB.nx + vertexC.nx, vertices[uiFrom].ny + vertexB.ny + vertexC.ny, vertices[uiFrom].nz + vertexB.nz + vertexC.nz };
+				float shadingAfter[3] = { vertices[uiTo].nx + vertexB.nx + vertexC.nx, vertices[uiTo].ny + vertexB.ny + vertexC.ny, vertices[uiTo].nz + vertexB.nz + vertexC.nz };
+				if (Dot(normalBefore, shadingBefore) > 0.0f && Dot(normalAfter, shadingAfter) <= 0.0f)
+				{
+					return true;
+				}
+			}
+			return false;
+		};
+
+		for (int i = 0; i < iVertexCount; i++)
+		{
+			collapseRemap[i] = (unsigned int)i;
+		}
+		std::fill(collapseLocked.begin(), collapseLocked.end(), 0);
+		int iTriangleCollapses = 0;
+		int iCollapseCount = 0;
+		for (const auto& collapse : collapses)
+		{
+			if (collapse.fError > fPassLimit || iTriangleCollapses >= iTriangleGoal)
+			{
+				break;
+			}
+
+			unsigned int uiFrom = collapse.uiFrom;
+			unsigned int uiTo = collapse.uiTo;
+			if (collapseLocked[remap[uiFrom]] || collapseLocked[remap[uiTo]] || hasFlips(uiFrom, uiTo))
+			{
+				continue;
+			}
+
+			if (kinds[uiFrom] == SeamVertex)
+			{
+				// The other side of the seam collapses along with it, onto the other side of the target
+				unsigned int uiFromPair = wedge[uiFrom];
+				unsigned int uiToPair = (openOut[uiFrom] == uiTo) ? openIn[uiFromPair] : openOut[uiFromPair];
+				if (uiToPair == ~0u || uiToPair == uiFromPair || remap[uiToPair] != remap[uiTo])
+				{
+					continue;
+				}
+				collapseRemap[uiFrom] = uiTo;
+				collapseRemap[uiFromPair] = uiToPair;
+			}
+			else
+			{
+				collapseRemap[uiFrom] = uiTo;
+			}
+
+			AddQuadric(quadrics[remap[uiTo]], quadrics[remap[uiFrom]]);
+			collapseLocked[remap[uiFrom]] = 1;
+			collapseLocked[remap[uiTo]] = 1;
+			iTriangleCollapses += (kinds[uiFrom] == BorderVertex) ? 1 : 2;
+			iCollapseCount++;
+			fResultError = (std::max)(fResultError, collapse.fError);
+		}
+		if (iCollapseCount == 0)
+		{
+			break;
+		}
+
+		// Follow the open edges past the vertices that were collapsed
+		for (std::vector<unsigned int>* pLoop : { &openOut, &openIn })
+		{
+			std::vector<unsigned int>& loop = *pLoop;
+			for (int i = 0; i < iVertexCount; i++)
+			{
+				if (loop[i] == ~0u)
+				{
+					continue;
+				}
+				unsigned int uiNext = loop[i];
+				unsigned int uiTarget = collapseRemap[uiNext];
+				if (uiTarget == (unsigned int)i) // The edge was collapsed towards this vertex, so it now leads where the collapsed vertex's did
+				{
+					loop[i] = (loop[uiNext] != ~0u) ? collapseRemap[loop[uiNext]] : ~0u;
+				}
+				else
+				{
+					loop[i] = uiTarget;
+				}
+			}
+		}
+
+		for (int i = 0; i < iVertexCount; i++)
+		{
+			finalVertex[i] = collapseRemap[finalVertex[i]];
+		}
+
+		// Drop the triangles that collapsed
+		int iWrite = 0;
+		for (int i = 0; i + 2 < iIndexCount; i += 3)
+		{
+			unsigned int a = collapseRemap[result[i]];
+			unsigned int b = collapseRemap[result[i + 1]];
+			unsigned int c = collapseRemap[result[i + 2]];
+			if (remap[a] != remap[b] && remap[b] != remap[c] && remap[a] != remap[c])
+			{
+				result[iWrite++] = a;
+				result[iWrite++] = b;
+				result[iWrite++] = c;
+			}
+		}
+		result.resize(iWrite);
+	}
+
+	// The quadrics average the distances to many planes, so the error is also measured directly, from each vertex that was collapsed to the simplified surface
+	float fMeasuredError = 0.0f;
+	if (!result.empty())
+	{
+		TriangleGrid grid;
+		grid.Build(positions.data(), result);
+		for (int i = 0; i < iVertexCount; i++)
+		{
+			if (finalVertex[i] != (unsigned int)i)
+			{
+				fMeasuredError = (std::max)(fMeasuredError, grid.GetDistance(&positions[i * 3]));
+			}
+		}
+	}
+
+	return (std::max)(sqrtf(fResultError), fMeasuredError) * fExtent;
+}
+
+void MeshSimplifier::GenerateLods(const ModelData* vertices, int iVertexCount, std::vector<unsigned int>& indices, std::vector<MeshLod>& lods, int iMaxLodCount, float fMaxError)
+{
+	lods.clear();
+	MeshLod lod = { 0, (unsigned int)indices.size(), 0.0f };
+	lods.push_back(lod);
+	if (iVertexCount == 0)
+	{
+		return;
+	}
+
+	float minimum[3] = { vertices[0].x, vertices[0].y, vertices[0].z };
+	float maximum[3] = { vertices[0].x, vertices[0].y, vertices[0].z };
+	for (int i = 1; i < iVertexCount; i++)
+	{
+		const float* position = &vertices[i].x;
+		for (int j = 0; j < 3; j++)
+		{
+			minimum[j] = (std::min)(minimum[j], position[j]);
+			maximum[j] = (std::max)(maximum[j], position[j]);
+		}
+	}
+	float fSize = sqrtf((maximum[0] - minimum[0]) * (maximum[0] - minimum[0]) + (maximum[1] - minimum[1]) * (maximum[1] - minimum[1]) + (maximum[2] - minimum[2]) * (maximum[2] - minimum[2]));
+
+	// Every level is simplified from the full mesh, so that its error is measured against the surface that is actually drawn up close
+	std::vector<unsigned int> fullIndices(indices);
+	std::vector<unsigned int> simplified;
+	for (int i = 1; i < iMaxLodCount; i++)
+	{
+		int iTargetIndexCount = (int)lods.back().uiIndexCount / 6 * 3;
+		if (iTargetIndexCount < 3)
+		{
+			break;
+		}
+
+		float fError = Simplify(vertices, iVertexCount, fullIndices, iTargetIndexCount, fMaxError * fSize, simplified);
+		if (simplified.empty() || simplified.size() * 5 > (size_t)lods.back().uiIndexCount * 4 || fError > fMaxError * fSize)
+		{
+			break; // Less than a fifth fewer triangles isn't worth a level, and the measured error can exceed what the quadrics allowed
+		}
+
+		lod.uiFirstIndex = (unsigned int)indices.size();
+		lod.uiIndexCount = (unsigned int)simplified.size();
+		lod.fError = (std::max)(fError, lods.back().fError); // Coarser levels never claim to be closer
+		lods.push_back(lod);
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+	}
+}
+
+#pragma endregion
+
+#pragma region Quadrics
+
+void MeshSimplifier::AddPlaneQuadric(Quadric& quadric, float nx, float ny, float nz, float d, float fWeight)
+{
+	quadric.a00 += fWeight * nx * nx;
+	quadric.a11 += fWeight * ny * ny;
+	quadric.a22 += fWeight * nz * nz;
+	quadric.a10 += fWeight * ny * nx;
+	quadric.a20 += fWeight * nz * nx;
+	quadric.a21 += fWeight * nz * ny;
+	quadric.b0 += fWeight * nx * d;
+	quadric.b1 += fWeight * ny * d;
+	quadric.b2 += fWeight * nz * d;
+	quadric.c += fWeight * d * d;
+	quadric.w += fWeight;
+}
+
+void MeshSimplifier::AddQuadric(Quadric& quadric, const Quadric& other)
+{
+	quadric.a00 += other.a00;
+	quadric.a11 += other.a11;
+	quadric.a22 += other.a22;
+	quadric.a10 += other.a10;
+	quadric.a20 += other.a20;
+	quadric.a21 += other.a21;
+	quadric.b0 += other.b0;
+	quadric.b1 += other.b1;
+	quadric.b2 += other.b2;
+	quadric.c += other.c;
+	quadric.w += other.w;
+}
+
+float MeshSimplifier::GetQuadricError(const Quadric& quadric, const float* position)
+{
+	// p^T A p + 2 b.p + c, averaged over the weight so that it is a squared distance
+	float x = position[0], y = position[1], z = position[2];
+	float fError = quadric.a00 * x * x + quadric.a11 * y * y + quadric.a22 * z * z +
+		2.0f * (quadric.a10 * x * y + quadric.a20 * x * z + quadric.a21 * y * z) +
+		2.0f * (quadric.b0 * x + quadric.b1 * y + quadric.b2 * z) + quadric.c;
+	return (quadric.w > 0.0f) ? fabsf(fError) / quadric.w : 0.0f;
+}
+
+#pragma endregion
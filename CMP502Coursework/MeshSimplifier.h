@@ -0,0 +1,64 @@
+//
+// MeshSimplifier.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Surface Simplification Using Quadric Error Metrics (Garland and Heckbert, 1997)
+// Simplifying Surfaces with Color and Texture using Quadric Error Metrics (Garland and Heckbert, 1998)
+// meshoptimizer: simplifier.cpp (Kapoulkine) (https://github.com/zeux/meshoptimizer)
+//
+
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <vector>
+#include "MeshFile.h"
+#include "Utils.h"
+
+// Reduces indexed meshes by collapsing edges in order of the quadric error they add, for levels of detail that share the vertex buffer
+// Vertices are only ever collapsed onto other vertices, so the simplified index lists still refer to the original vertices
+// Open borders and attribute seams (vertices split by their texture coordinates or normals) only collapse along themselves,
+// so the silhouette and texture mapping hold together; vertices where more than two of them meet are never moved
+class MeshSimplifier
+{
+public:
+	// Simplifies towards iTargetIndexCount indices, stopping early rather than adding more than fTargetError (model units) of error
+	// Returns the error the result was simplified with, in model units
+	static float Simplify(const ModelData* vertices, int iVertexCount, const std::vector<unsigned int>& indices, int iTargetIndexCount, float fTargetError, std::vector<unsigned int>& result);
+	// Builds a chain of levels, each with about half the triangles of the one before, into one index list that starts with the indices
+	// Levels stop once they would lose more than fMaxError (a fraction of the mesh's size) or barely reduce the triangles any further
+	static void GenerateLods(const ModelData* vertices, int iVertexCount, std::vector<unsigned int>& indices, std::vector<MeshLod>& lods, int iMaxLodCount = MaxLodCount, float fMaxError = 0.05f);
+
+	static const int MaxLodCount = 4; // Including the full detail level
+
+private:
+	enum VertexKind : unsigned char
+	{
+		ManifoldVertex = 0, // Surrounded by triangles, with no seam
+		BorderVertex,		// On one open border
+		SeamVertex,			// On one seam, split in two
+		LockedVertex		// Anything else; never collapsed
+	};
+
+	struct Quadric // Sum of squared distances to planes, as a symmetric matrix A, vector b and constant c, and the total weight
+	{
+		float a00, a11, a22, a10, a20, a21;
+		float b0, b1, b2;
+		float c;
+		float w;
+	};
+
+	struct Collapse
+	{
+		unsigned int uiFrom;
+		unsigned int uiTo;
+		bool bBidirectional; // Either end may be collapsed onto the other
+		float fError;
+	};
+
+	static void AddPlaneQuadric(Quadric& quadric, float nx, float ny, float nz, float d, float fWeight);
+	static void AddQuadric(Quadric& quadric, const Quadric& other);
+	static float GetQuadricError(const Quadric& quadric, const float* position);
+};
+
+#endif
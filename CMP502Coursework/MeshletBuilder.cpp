@@ -0,0 +1,368 @@
+//
+// MeshletBuilder.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Optimizing the Graphics Pipeline with Compute (Wihlidal, 2016)
+// meshoptimizer: clusterizer.cpp (Kapoulkine) (https://github.com/zeux/meshoptimizer)
+// Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix (Gribb and Hartmann, 2001)
+//
+
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const float ConeWeight = 0.5f; // How much a triangle's normal counts against its distance when growing a meshlet
+	const float MinConeDot = 0.1f; // Meshlets whose normals spread wider than this (as the cosine from the axis) are never back-facing as a whole
+}
+
+void MeshletBuilder::Build(const ModelData* vertices, int iVertexCount, std::vector<unsigned int>& indices, int iFirstIndex, int iIndexCount, std::vector<Meshlet>& meshlets)
+{
+	meshlets.clear();
+	int iTriangleCount = iIndexCount / 3;
+	if (iTriangleCount == 0)
+	{
+		return;
+	}
+	const unsigned int* triangles = &indices[iFirstIndex];
+
+	// Unit normal and centroid of every triangle, and the radius a meshlet of average triangles would have
+	std::vector<XMFLOAT3> normals(iTriangleCount);
+	std::vector<XMFLOAT3> centroids(iTriangleCount);
+	float fTotalArea = 0.0f;
+	for (int i = 0; i < iTriangleCount; i++)
+	{
+		const ModelData& a = vertices[triangles[i * 3]];
+		const ModelData& b = vertices[triangles[i * 3 + 1]];
+		const ModelData& c = vertices[triangles[i * 3 + 2]];
+		XMVECTOR vA = XMVectorSet(a.x, a.y, a.z, 0.0f);
+		XMVECTOR vB = XMVectorSet(b.x, b.y, b.z, 0.0f);
+		XMVECTOR vC = XMVectorSet(c.x, c.y, c.z, 0.0f);
+		XMVECTOR vNormal = XMVector3Cross(vB - vA, vC - vA);
+		float fLength = XMVectorGetX(XMVector3Length(vNormal));
+		fTotalArea += fLength * 0.5f;
+		XMStoreFloat3(&normals[i], (fLength > 0.0f) ? vNormal / fLength : XMVectorZero());
+		XMStoreFloat3(&centroids[i], (vA + vB + vC) / 3.0f);
+	}
+	float fExpectedRadius = sqrtf(fTotalArea / iTriangleCount * MaxTriangles / XM_PI);
+	if (fExpectedRadius <= 0.0f)
+	{
+		fExpectedRadius = 1.0f;
+	}
+
+	// Vertices split by their texture coordinates or normals are still neighbours, so triangles are linked through shared positions
+	// Open addressing table of the first vertex at each position, hashed on the position bytes (FNV-1a)
+	size_t tableSize = 1;
+	while (tableSize < (size_t)iVertexCount * 2)
+	{
+		tableSize *= 2;
+	}
+	std::vector<int> table(tableSize, -1);
+	std::vector<int> positions(iVertexCount); // First vertex with the same position as each
+	for (int i = 0; i < iVertexCount; i++)
+	{
+		const unsigned char* bytes = (const unsigned char*)&vertices[i].x;
+		unsigned long long ullHash = 14695981039346656037ull;
+		for (size_t j = 0; j < 3 * sizeof(float); j++)
+		{
+			ullHash = (ullHash ^ bytes[j]) * 1099511628211ull;
+		}
+
+		size_t slot = (size_t)ullHash & (tableSize - 1);
+		while (table[slot] >= 0 && memcmp(&vertices[table[slot]].x, &vertices[i].x, 3 * sizeof(float)) != 0)
+		{
+			slot = (slot + 1) & (tableSize - 1);
+		}
+		if (table[slot] < 0)
+		{
+			table[slot] = i;
+		}
+		positions[i] = table[slot];
+	}
+
+	// Triangles at each position
+	std::vector<int> offsets(iVertexCount + 1, 0);
+	for (int i = 0; i < iTriangleCount * 3; i++)
+	{
+		offsets[positions[triangles[i]] + 1]++;
+	}
+	for (int i = 0; i < iVertexCount; i++)
+	{
+		offsets[i + 1] += offsets[i];
+	}
+	std::vector<int> positionTriangles(offsets[iVertexCount]);
+	{
+		std::vector<int> ends(offsets.begin(), offsets.end() - 1);
+		for (int i = 0; i < iTriangleCount * 3; i++)
+		{
+			positionTriangles[ends[positions[triangles[i]]]++] = i / 3;
+		}
+	}
+
+	// Triangles along a Morton curve through their centroids, so that consecutive ones are close together
+	XMVECTOR vMin = XMVectorReplicate(FLT_MAX);
+	XMVECTOR vMax = XMVectorReplicate(-FLT_MAX);
+	for (const auto& centroid : centroids)
+	{
+		vMin = XMVectorMin(vMin, XMLoadFloat3(&centroid));
+		vMax = XMVectorMax(vMax, XMLoadFloat3(&centroid));
+	}
+	XMVECTOR vExtent = XMVectorMax(vMax - vMin, XMVectorReplicate(1e-6f));
+	std::vector<std::pair<unsigned int, int>> mortonOrder(iTriangleCount);
+	for (int i = 0; i < iTriangleCount; i++)
+	{
+		XMFLOAT3 cell;
+		XMStoreFloat3(&cell, (XMLoadFloat3(&centroids[i]) - vMin) / vExtent * 1023.0f);
+		unsigned int uiCode = 0;
+		for (int iBit = 9; iBit >= 0; iBit--)
+		{
+			uiCode = (uiCode << 3) | ((((unsigned int)cell.x >> iBit) & 1) << 2) | ((((unsigned int)cell.y >> iBit) & 1) << 1) | (((unsigned int)cell.z >> iBit) & 1);
+		}
+		mortonOrder[i] = std::make_pair(uiCode, i);
+	}
+	std::sort(mortonOrder.begin(), mortonOrder.end());
+
+	std::vector<bool> emitted(iTriangleCount, false);
+	std::vector<int> vertexMeshlets(iVertexCount, -1); // Meshlet each vertex was last added to
+	std::vector<int> positionMeshlets(iVertexCount, -1);
+	int iMeshletVertexCount = 0;
+	std::vector<int> meshletPositions;
+	std::vector<int> meshletTriangles;
+	std::vector<unsigned int> orderedIndices;
+	orderedIndices.reserve(iTriangleCount * 3);
+	int iNextTriangle = 0; // Position along the Morton curve to look for a new start, once a meshlet has no neighbours left
+	int iSeedTriangle = -1; // Neighbour of the last meshlet that didn't fit in it
+
+	// Meshlets grow one triangle at a time from a seed, preferring triangles that bring the fewest new vertices, then those that face the same way and lie closest
+	int iEmittedCount = 0;
+	while (iEmittedCount < iTriangleCount)
+	{
+		int iMeshlet = (int)meshlets.size();
+		iMeshletVertexCount = 0;
+		meshletPositions.clear();
+		meshletTriangles.clear();
+		XMVECTOR vNormalSum = XMVectorZero();
+		XMVECTOR vCentroidSum = XMVectorZero();
+
+		if (iSeedTriangle < 0 || emitted[iSeedTriangle])
+		{
+			while (emitted[mortonOrder[iNextTriangle].second])
+			{
+				iNextTriangle++;
+			}
+			iSeedTriangle = mortonOrder[iNextTriangle].second;
+		}
+
+		int iTriangle = iSeedTriangle;
+		iSeedTriangle = -1;
+		while (iTriangle >= 0)
+		{
+			emitted[iTriangle] = true;
+			iEmittedCount++;
+			meshletTriangles.push_back(iTriangle);
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int uiVertex = triangles[iTriangle * 3 + k];
+				if (vertexMeshlets[uiVertex] != iMeshlet)
+				{
+					vertexMeshlets[uiVertex] = iMeshlet;
+					iMeshletVertexCount++;
+				}
+				int iPosition = positions[uiVertex];
+				if (positionMeshlets[iPosition] != iMeshlet)
+				{
+					positionMeshlets[iPosition] = iMeshlet;
+					meshletPositions.push_back(iPosition);
+				}
+			}
+			vNormalSum += XMLoadFloat3(&normals[iTriangle]);
+			vCentroidSum += XMLoadFloat3(&centroids[iTriangle]);
+			if ((int)meshletTriangles.size() == MaxTriangles)
+			{
+				break;
+			}
+
+			XMVECTOR vAxis = XMVector3Normalize(vNormalSum);
+			XMVECTOR vCenter = vCentroidSum / (float)meshletTriangles.size();
+
+			// The new vertex count dominates the score, so a triangle that closes a fan always beats one that opens a new edge
+			iTriangle = -1;
+			float fBestScore = FLT_MAX;
+			for (int iPosition : meshletPositions)
+			{
+				for (int j = offsets[iPosition]; j < offsets[iPosition + 1]; j++)
+				{
+					int iCandidate = positionTriangles[j];
+					if (emitted[iCandidate])
+					{
+						continue;
+					}
+
+					int iNewVertexCount = 0;
+					for (int k = 0; k < 3; k++)
+					{
+						iNewVertexCount += (vertexMeshlets[triangles[iCandidate * 3 + k]] != iMeshlet) ? 1 : 0;
+					}
+					if (iMeshletVertexCount + iNewVertexCount > MaxVertices)
+					{
+						iSeedTriangle = iCandidate;
+						continue;
+					}
+
+					float fSpread = (1.0f - XMVectorGetX(XMVector3Dot(XMLoadFloat3(&normals[iCandidate]), vAxis))) * 0.5f;
+					float fDistance = (std::min)(XMVectorGetX(XMVector3Length(XMLoadFloat3(&centroids[iCandidate]) - vCenter)) / fExpectedRadius, 1.0f);
+					float fScore = iNewVertexCount + (ConeWeight * fSpread + (1.0f - ConeWeight) * fDistance) * 0.99f;
+					if (fScore < fBestScore)
+					{
+						fBestScore = fScore;
+						iTriangle = iCandidate;
+					}
+				}
+			}
+
+			// Without neighbours, a meshlet takes in the next loose triangle along the curve if it lies within a meshlet's reach, so small separate pieces share meshlets
+			if (iTriangle < 0 && iSeedTriangle < 0 && iEmittedCount < iTriangleCount)
+			{
+				while (emitted[mortonOrder[iNextTriangle].second])
+				{
+					iNextTriangle++;
+				}
+				int iCandidate = mortonOrder[iNextTriangle].second;
+				if (iMeshletVertexCount + 3 <= MaxVertices && XMVectorGetX(XMVector3Length(XMLoadFloat3(&centroids[iCandidate]) - vCenter)) <= fExpectedRadius)
+				{
+					iTriangle = iCandidate;
+				}
+			}
+		}
+
+		// A full meshlet's next one starts next to it, where the triangles are most likely to be left
+		for (size_t i = 0; i < meshletPositions.size() && iSeedTriangle < 0; i++)
+		{
+			for (int j = offsets[meshletPositions[i]]; j < offsets[meshletPositions[i] + 1]; j++)
+			{
+				if (!emitted[positionTriangles[j]])
+				{
+					iSeedTriangle = positionTriangles[j];
+					break;
+				}
+			}
+		}
+
+		// Meshlets with nothing near enough left end early rather than jump to a triangle elsewhere, so their bounds stay tight
+		Meshlet meshlet;
+		meshlet.uiFirstIndex = (unsigned int)(iFirstIndex + orderedIndices.size());
+		meshlet.uiIndexCount = (unsigned int)meshletTriangles.size() * 3;
+		for (int iMeshletTriangle : meshletTriangles)
+		{
+			orderedIndices.insert(orderedIndices.end(), triangles + iMeshletTriangle * 3, triangles + iMeshletTriangle * 3 + 3);
+		}
+		meshlets.push_back(meshlet);
+	}
+
+	std::copy(orderedIndices.begin(), orderedIndices.end(), indices.begin() + iFirstIndex);
+	for (auto& meshlet : meshlets)
+	{
+		ComputeBounds(vertices, &indices[meshlet.uiFirstIndex], meshlet.uiIndexCount / 3, meshlet);
+	}
+}
+
+void MeshletBuilder::ComputeBounds(const ModelData* vertices, const unsigned int* indices, int iTriangleCount, Meshlet& meshlet)
+{
+	// Sphere around the bounding box
+	XMVECTOR vMin = XMVectorReplicate(FLT_MAX);
+	XMVECTOR vMax = XMVectorReplicate(-FLT_MAX);
+	for (int i = 0; i < iTriangleCount * 3; i++)
+	{
+		const ModelData& vertex = vertices[indices[i]];
+		XMVECTOR vPosition = XMVectorSet(vertex.x, vertex.y, vertex.z, 0.0f);
+		vMin = XMVectorMin(vMin, vPosition);
+		vMax = XMVectorMax(vMax, vPosition);
+	}
+	XMVECTOR vCenter = (vMin + vMax) * 0.5f;
+	float fRadius = 0.0f;
+	for (int i = 0; i < iTriangleCount * 3; i++)
+	{
+		const ModelData& vertex = vertices[indices[i]];
+		fRadius = (std::max)(fRadius, XMVectorGetX(XMVector3Length(XMVectorSet(vertex.x, vertex.y, vertex.z, 0.0f) - vCenter)));
+	}
+	meshlet.x = XMVectorGetX(vCenter);
+	meshlet.y = XMVectorGetY(vCenter);
+	meshlet.z = XMVectorGetZ(vCenter);
+	meshlet.fRadius = fRadius;
+
+	// Cone around the average normal, just wide enough for the normal furthest from it
+	std::vector<XMVECTOR> normals;
+	normals.reserve(iTriangleCount);
+	XMVECTOR vNormalSum = XMVectorZero();
+	for (int i = 0; i < iTriangleCount; i++)
+	{
+		const ModelData& a = vertices[indices[i * 3]];
+		const ModelData& b = vertices[indices[i * 3 + 1]];
+		const ModelData& c = vertices[indices[i * 3 + 2]];
+		XMVECTOR vA = XMVectorSet(a.x, a.y, a.z, 0.0f);
+		XMVECTOR vNormal = XMVector3Cross(XMVectorSet(b.x, b.y, b.z, 0.0f) - vA, XMVectorSet(c.x, c.y, c.z, 0.0f) - vA);
+		float fLength = XMVectorGetX(XMVector3Length(vNormal));
+		if (fLength > 0.0f)
+		{
+			normals.push_back(vNormal / fLength);
+			vNormalSum += normals.back();
+		}
+	}
+
+	float fAxisLength = XMVectorGetX(XMVector3Length(vNormalSum));
+	XMVECTOR vAxis = (fAxisLength > 0.0f) ? vNormalSum / fAxisLength : XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+	float fMinDot = (fAxisLength > 0.0f) ? 1.0f : -1.0f;
+	for (const auto& vNormal : normals)
+	{
+		fMinDot = (std::min)(fMinDot, XMVectorGetX(XMVector3Dot(vNormal, vAxis)));
+	}
+	meshlet.nx = XMVectorGetX(vAxis);
+	meshlet.ny = XMVectorGetY(vAxis);
+	meshlet.nz = XMVectorGetZ(vAxis);
+	meshlet.fConeCutoff = (fMinDot <= MinConeDot) ? 1.0f : sqrtf(1.0f - fMinDot * fMinDot);
+}
+
+bool MeshletBuilder::IsBackFacing(const Meshlet& meshlet, const XMFLOAT3& cameraPosition)
+{
+	// Every triangle faces away if the camera is outside the cone (widened by the sphere) behind the meshlet
+	float fX = meshlet.x - cameraPosition.x;
+	float fY = meshlet.y - cameraPosition.y;
+	float fZ = meshlet.z - cameraPosition.z;
+	float fDistance = sqrtf(fX * fX + fY * fY + fZ * fZ);
+	return fX * meshlet.nx + fY * meshlet.ny + fZ * meshlet.nz >= meshlet.fConeCutoff * fDistance + meshlet.fRadius;
+}
+
+bool MeshletBuilder::IsInFrustum(const Meshlet& meshlet, const XMFLOAT4* frustumPlanes)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		const XMFLOAT4& plane = frustumPlanes[i];
+		if (plane.x * meshlet.x + plane.y * meshlet.y + plane.z * meshlet.z + plane.w < -meshlet.fRadius)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void MeshletBuilder::GetFrustumPlanes(const XMMATRIX& modelViewProjectionMatrix, XMFLOAT4* frustumPlanes)
+{
+	// Clip space is bounded by -w <= x, y <= w and 0 <= z <= w, so each plane is a sum or difference of the matrix's columns
+	XMFLOAT4X4 columns;
+	XMStoreFloat4x4(&columns, XMMatrixTranspose(modelViewProjectionMatrix));
+	XMVECTOR vX = XMVectorSet(columns._11, columns._12, columns._13, columns._14);
+	XMVECTOR vY = XMVectorSet(columns._21, columns._22, columns._23, columns._24);
+	XMVECTOR vZ = XMVectorSet(columns._31, columns._32, columns._33, columns._34);
+	XMVECTOR vW = XMVectorSet(columns._41, columns._42, columns._43, columns._44);
+	XMVECTOR planes[6] = { vW + vX, vW - vX, vW + vY, vW - vY, vZ, vW - vZ };
+	for (int i = 0; i < 6; i++)
+	{
+		// Normalized, so that the distances are in model units
+		float fLength = XMVectorGetX(XMVector3Length(planes[i]));
+		XMStoreFloat4(&frustumPlanes[i], (fLength > 0.0f) ? planes[i] / fLength : planes[i]);
+	}
+}
@@ -0,0 +1,39 @@
+//
+// MeshletBuilder.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Optimizing the Graphics Pipeline with Compute (Wihlidal, 2016)
+// meshoptimizer: clusterizer.cpp (Kapoulkine) (https://github.com/zeux/meshoptimizer)
+//
+
+#ifndef MESHLET_BUILDER_H
+#define MESHLET_BUILDER_H
+
+#include <directxmath.h>
+#include <vector>
+#include "MeshFile.h"
+#include "Utils.h"
+
+using namespace DirectX;
+
+// Splits the full detail level of an indexed mesh into meshlets: small clusters of connected triangles that face roughly the same way,
+// so that clusters facing away from the camera or outside the view can be dropped before drawing, without testing every triangle
+class MeshletBuilder
+{
+public:
+	// Reorders the triangles of indices[iFirstIndex, iFirstIndex + iIndexCount) so that each meshlet's are contiguous, and bounds each meshlet
+	static void Build(const ModelData* vertices, int iVertexCount, std::vector<unsigned int>& indices, int iFirstIndex, int iIndexCount, std::vector<Meshlet>& meshlets);
+	// Both are tested in model space: the planes' normals (xyz) point into the view and w is their distance
+	static bool IsInFrustum(const Meshlet& meshlet, const XMFLOAT4* frustumPlanes); // false if the whole meshlet is outside the view
+	static bool IsBackFacing(const Meshlet& meshlet, const XMFLOAT3& cameraPosition); // true if every triangle faces away from the camera
+	static void GetFrustumPlanes(const XMMATRIX& modelViewProjectionMatrix, XMFLOAT4* frustumPlanes); // The six planes of a model to clip space matrix, in model space
+
+	static const int MaxVertices = 64;
+	static const int MaxTriangles = 124; // Leaves room in 128 for the primitive count of a mesh shader's output
+
+private:
+	static void ComputeBounds(const ModelData* vertices, const unsigned int* indices, int iTriangleCount, Meshlet& meshlet);
+};
+
+#endif
@@ -0,0 +1,229 @@
+//
+// MipGenerator.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Jonathan Blow, Inner Product: Mipmapping, Part 1 (http://number-none.com/product/Mipmapping,%20Part%201/index.html)
+// Jonathan Blow, Inner Product: Mipmapping, Part 2 (http://number-none.com/product/Mipmapping,%20Part%202/index.html)
+// Gamma error in picture scaling (http://www.ericbrasseur.org/gamma.html)
+//
+
+#include "MipGenerator.h"
+
+namespace
+{
+	const float KAISER_RADIUS = 3.0f; // In destination texels
+	const float KAISER_ALPHA = 4.0f;
+
+	// sRGB to linear for every 8-bit value, and linear (quantized to 16 bits) back to 8-bit sRGB
+	struct ColorTables
+	{
+		float toLinear[256];
+		unsigned char toSRGB[65536];
+
+		ColorTables()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				float c = i / 255.0f;
+				toLinear[i] = (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (int i = 0; i < 65536; i++)
+			{
+				float c = i / 65535.0f;
+				float s = (c <= 0.0031308f) ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+				toSRGB[i] = (unsigned char)(s * 255.0f + 0.5f);
+			}
+		}
+	};
+
+	const ColorTables& GetColorTables()
+	{
+		static const ColorTables tables; // Thread safe initialization on first use
+		return tables;
+	}
+}
+
+#pragma region Generate
+
+bool MipGenerator::GenerateMipChain(TextureImage& image, MipFilter filter, bool bWrap, int iThreadCount)
+{
+	int iWidth = image.GetWidth();
+	int iHeight = image.GetHeight();
+	if (iWidth <= 0 || iHeight <= 0 || image.GetMipCount() < 1)
+	{
+		return false;
+	}
+
+	// Full chain down to 1x1
+	int iMipCount = 1;
+	while ((iWidth >> iMipCount) > 0 || (iHeight >> iMipCount) > 0)
+	{
+		iMipCount++;
+	}
+	image.SetMipCount(iMipCount);
+
+	const ColorTables& tables = GetColorTables();
+
+	// Expand the top level to linear floats; each level is then filtered from the unquantized level above it
+	std::vector<XMFLOAT4> source((size_t)iWidth * iHeight);
+	const unsigned char* topPixels = image.GetPixels(0);
+	Utils::ParallelFor(iHeight, iThreadCount, [&](int iBegin, int iEnd)
+	{
+		for (int i = iBegin * iWidth; i < iEnd * iWidth; i++)
+		{
+			const unsigned char* texel = &topPixels[(size_t)i * 4];
+			source[i] = XMFLOAT4(tables.toLinear[texel[0]], tables.toLinear[texel[1]], tables.toLinear[texel[2]], texel[3] / 255.0f);
+		}
+	});
+
+	std::vector<XMFLOAT4> intermediate;
+	std::vector<XMFLOAT4> destination;
+	std::vector<int> horizontalStarts;
+	std::vector<int> verticalStarts;
+	std::vector<FilterTap> horizontalTaps;
+	std::vector<FilterTap> verticalTaps;
+
+	for (int iLevel = 1; iLevel < iMipCount; iLevel++)
+	{
+		int iSourceWidth = image.GetMipWidth(iLevel - 1);
+		int iSourceHeight = image.GetMipHeight(iLevel - 1);
+		int iDestinationWidth = image.GetMipWidth(iLevel);
+		int iDestinationHeight = image.GetMipHeight(iLevel);
+
+		ComputeTaps(iSourceWidth, iDestinationWidth, filter, bWrap, horizontalStarts, horizontalTaps);
+		ComputeTaps(iSourceHeight, iDestinationHeight, filter, bWrap, verticalStarts, verticalTaps);
+
+		// Horizontal pass (source rows into intermediate rows of the destination width)
+		intermediate.resize((size_t)iDestinationWidth * iSourceHeight);
+		Utils::ParallelFor(iSourceHeight, iThreadCount, [&](int iBegin, int iEnd)
+		{
+			for (int y = iBegin; y < iEnd; y++)
+			{
+				const XMFLOAT4* sourceRow = &source[(size_t)y * iSourceWidth];
+				XMFLOAT4* intermediateRow = &intermediate[(size_t)y * iDestinationWidth];
+				for (int x = 0; x < iDestinationWidth; x++)
+				{
+					XMVECTOR vSum = XMVectorZero();
+					for (int t = horizontalStarts[x]; t < horizontalStarts[x + 1]; t++)
+					{
+						vSum = XMVectorMultiplyAdd(XMLoadFloat4(&sourceRow[horizontalTaps[t].iSource]), XMVectorReplicate(horizontalTaps[t].fWeight), vSum);
+					}
+					XMStoreFloat4(&intermediateRow[x], vSum);
+				}
+			}
+		});
+
+		// Vertical pass, then quantize back to 8-bit sRGB
+		destination.resize((size_t)iDestinationWidth * iDestinationHeight);
+		unsigned char* destinationPixels = image.GetPixels(iLevel);
+		Utils::ParallelFor(iDestinationHeight, iThreadCount, [&](int iBegin, int iEnd)
+		{
+			for (int y = iBegin; y < iEnd; y++)
+			{
+				XMFLOAT4* destinationRow = &destination[(size_t)y * iDestinationWidth];
+				for (int x = 0; x < iDestinationWidth; x++)
+				{
+					XMVECTOR vSum = XMVectorZero();
+					for (int t = verticalStarts[y]; t < verticalStarts[y + 1]; t++)
+					{
+						vSum = XMVectorMultiplyAdd(XMLoadFloat4(&intermediate[(size_t)verticalTaps[t].iSource * iDestinationWidth + x]), XMVectorReplicate(verticalTaps[t].fWeight), vSum);
+					}
+
+					// The negative lobes of the Kaiser filter can overshoot
+					vSum = XMVectorSaturate(vSum);
+					XMStoreFloat4(&destinationRow[x], vSum);
+
+					XMFLOAT4 quantized;
+					XMStoreFloat4(&quantized, XMVectorMultiplyAdd(vSum, XMVectorReplicate(65535.0f), XMVectorReplicate(0.5f)));
+					unsigned char* texel = &destinationPixels[((size_t)y * iDestinationWidth + x) * 4];
+					texel[0] = tables.toSRGB[(int)quantized.x];
+					texel[1] = tables.toSRGB[(int)quantized.y];
+					texel[2] = tables.toSRGB[(int)quantized.z];
+					texel[3] = (unsigned char)(destinationRow[x].w * 255.0f + 0.5f);
+				}
+			}
+		});
+
+		source.swap(destination);
+	}
+
+	return true;
+}
+
+void MipGenerator::ComputeTaps(int iSourceSize, int iDestinationSize, MipFilter filter, bool bWrap, std::vector<int>& tapStarts, std::vector<FilterTap>& taps)
+{
+	tapStarts.clear();
+	taps.clear();
+
+	float fScale = (float)iSourceSize / (float)iDestinationSize; // Source texels per destination texel
+
+	for (int i = 0; i < iDestinationSize; i++)
+	{
+		tapStarts.push_back((int)taps.size());
+		size_t firstTap = taps.size();
+		float fTotalWeight = 0.0f;
+
+		if (filter == BoxFilter)
+		{
+			// Weight each source texel by how much of it lies under the destination texel (handles odd sizes)
+			float fBegin = i * fScale;
+			float fEnd = (i + 1) * fScale;
+			for (int s = (int)floorf(fBegin); s < (int)ceilf(fEnd); s++)
+			{
+				float fWeight = (std::min)(fEnd, s + 1.0f) - (std::max)(fBegin, (float)s);
+				if (fWeight > 0.0f)
+				{
+					taps.push_back({ (std::min)(s, iSourceSize - 1), fWeight });
+					fTotalWeight += fWeight;
+				}
+			}
+		}
+		else
+		{
+			// Kaiser windowed sinc, cut off at the destination Nyquist frequency
+			float fCenter = (i + 0.5f) * fScale;
+			float fSupport = KAISER_RADIUS * fScale;
+			float fWindowScale = 1.0f / BesselI0(KAISER_ALPHA);
+			for (int s = (int)floorf(fCenter - fSupport); s <= (int)ceilf(fCenter + fSupport); s++)
+			{
+				float d = (s + 0.5f - fCenter) / fScale; // Distance in destination texels
+				if (fabsf(d) >= KAISER_RADIUS)
+				{
+					continue;
+				}
+
+				float fSinc = (fabsf(d) < 1e-5f) ? 1.0f : sinf(XM_PI * d) / (XM_PI * d);
+				float fRatio = d / KAISER_RADIUS;
+				float fWeight = fSinc * BesselI0(KAISER_ALPHA * sqrtf(1.0f - fRatio * fRatio)) * fWindowScale;
+
+				int iSource = bWrap ? ((s % iSourceSize) + iSourceSize) % iSourceSize : (std::min)((std::max)(s, 0), iSourceSize - 1);
+				taps.push_back({ iSource, fWeight });
+				fTotalWeight += fWeight;
+			}
+		}
+
+		// Normalize so that flat areas keep their value
+		for (size_t t = firstTap; t < taps.size(); t++)
+		{
+			taps[t].fWeight /= fTotalWeight;
+		}
+	}
+	tapStarts.push_back((int)taps.size());
+}
+
+float MipGenerator::BesselI0(float x)
+{
+	// Power series of the zeroth order modified Bessel function of the first kind
+	float fSum = 1.0f;
+	float fTerm = 1.0f;
+	float fHalfX = x * 0.5f;
+	for (int k = 1; k < 20; k++)
+	{
+		fTerm *= (fHalfX / k) * (fHalfX / k);
+		fSum += fTerm;
+	}
+	return fSum;
+}
+
+#pragma endregion
@@ -0,0 +1,46 @@
+//
+// MipGenerator.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Jonathan Blow, Inner Product: Mipmapping, Part 1 (http://number-none.com/product/Mipmapping,%20Part%201/index.html)
+// Jonathan Blow, Inner Product: Mipmapping, Part 2 (http://number-none.com/product/Mipmapping,%20Part%202/index.html)
+// Gamma error in picture scaling (http://www.ericbrasseur.org/gamma.html)
+//
+
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <directxmath.h>
+#include <vector>
+#include "TextureImage.h"
+#include "Utils.h"
+
+using namespace DirectX;
+
+enum MipFilter : int
+{
+	BoxFilter = 0,	// Average of the texels under each destination texel; fastest
+	KaiserFilter	// Kaiser windowed sinc; sharper distant mips at a higher cost
+};
+
+// Builds the full mip chain of an image from its top level
+// Color is filtered in linear space (the texels are treated as sRGB) while alpha is filtered as is
+class MipGenerator
+{
+public:
+	static bool GenerateMipChain(TextureImage& image, MipFilter filter, bool bWrap, int iThreadCount = 0); // bWrap for tiling textures; iThreadCount 0 uses every core
+
+private:
+	struct FilterTap
+	{
+		int iSource;
+		float fWeight;
+	};
+
+	// Separable filter weights; the taps of destination texel i are [tapStarts[i], tapStarts[i + 1])
+	static void ComputeTaps(int iSourceSize, int iDestinationSize, MipFilter filter, bool bWrap, std::vector<int>& tapStarts, std::vector<FilterTap>& taps);
+	static float BesselI0(float x);
+};
+
+#endif
@@ -10,23 +10,48 @@
 //
 
 #include "Model.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
 
 #pragma region Init
 
 Model::Model()
 {
+	m_pTexture = nullptr;
+	m_uiTextureSlice = 0;
 	m_pVertexBuffer = nullptr;
 	m_iVertexCount = 0;
 	m_pIndexBuffer = nullptr;
 	m_iIndexCount = 0;
 	m_pInstanceBuffer = nullptr;
 	m_iInstanceCount = 0;
+	m_iInstanceCapacity = 0;
+	m_bCompactInstances = false;
+	m_bDynamicInstances = false;
+	m_bCulledInstances = false;
+	m_bDrawnInstancesChanged = false;
+	m_iDrawnInstanceCount = 0;
+	m_fFadeStart = 0.0f;
+	m_fFadeEnd = 0.0f;
+	m_iCurrentLod = 0;
+	m_iMeshletInstanceCount = 0;
+	m_bDrawnMeshletsChanged = false;
+	m_pMeshletIndexBuffer = nullptr;
+	m_modelData = nullptr;
+	m_indexData = nullptr;
+	m_boundingSphere = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	m_boundingBoxMinimum = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	m_boundingBoxMaximum = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	m_fTexcoordDensity = 0.0f;
 	m_worldMatrix = XMMatrixIdentity();
-	m_ambientColor = COLOR_XMF4(51.0f, 51.0f, 51.0f, 1.0f);
-	m_diffuseColor = COLOR_XMF4(255.0f, 204.0f, 248.0f, 1.0f); // Light pink
+	m_material.ambientColor = COLOR_XMF4(51.0f, 51.0f, 51.0f, 1.0f);
+	m_material.diffuseColor = COLOR_XMF4(255.0f, 204.0f, 248.0f, 1.0f); // Light pink
+	m_material.fSpecularPower = 24.0f;
+	m_material.specularColor = COLOR_XMF4(13.0f, 0.0f, 11.0f, 1.0f);
 	m_lightDirection = XMFLOAT3(0.0f, -0.8f, 0.5f);
-	m_fSpecularPower = 24.0f;
-	m_specularColor = COLOR_XMF4(13.0f, 0.0f, 11.0f, 1.0f);
 }
 
 Model::~Model()
@@ -34,21 +59,58 @@ Model::~Model()
 	SAFE_RELEASE(m_pVertexBuffer);
 	SAFE_RELEASE(m_pIndexBuffer);
 	SAFE_RELEASE(m_pInstanceBuffer);
+	SAFE_RELEASE(m_pMeshletIndexBuffer);
 }
 
 bool Model::InitializeBuffers(ID3D11Device* device, int iInstanceCount, Instance* instances)
 {
-	Vertex* vertices = new Vertex[m_iVertexCount];
-	unsigned long* indices = new unsigned long[m_iIndexCount];
+	// The model data is laid out as the vertex buffer is, so it is copied straight from where it was loaded (or mapped)
+	static_assert(sizeof(Vertex) == sizeof(ModelData) && offsetof(Vertex, textureCoordinate) == offsetof(ModelData, tu) && offsetof(Vertex, normal) == offsetof(ModelData, nx), "Vertex and ModelData layouts differ");
 
-	// Load the model data into the vertex and index arrays
-	for (int i = 0; i < m_iVertexCount; i++)
+	if (m_lods.empty())
 	{
-		vertices[i].position = XMFLOAT3(m_modelData[i].x, m_modelData[i].y, m_modelData[i].z);
-		vertices[i].textureCoordinate = XMFLOAT2(m_modelData[i].tu, m_modelData[i].tv);
-		vertices[i].normal = XMFLOAT3(m_modelData[i].nx, m_modelData[i].ny, m_modelData[i].nz);
+		MeshLod lod = { 0, (unsigned int)m_iIndexCount, 0.0f };
+		m_lods.push_back(lod);
+	}
 
-		indices[i] = i;
+	// Unindexed models get a sequential index buffer
+	std::vector<unsigned int> sequentialIndices;
+	const unsigned int* indices = m_indexData;
+	if (!indices)
+	{
+		sequentialIndices.resize(m_iIndexCount);
+		for (int i = 0; i < m_iIndexCount; i++)
+		{
+			sequentialIndices[i] = i;
+		}
+		indices = sequentialIndices.data();
+	}
+
+	// A model placed by several nodes draws every node for every instance
+	std::vector<Instance> nodeInstances;
+	if (m_nodeMatrices.size() == 1 && iInstanceCount <= 1)
+	{
+		m_worldMatrix = XMLoadFloat4x4(&m_nodeMatrices[0]) * m_worldMatrix;
+	}
+	else if (!m_nodeMatrices.empty())
+	{
+		int iPlacementCount = (iInstanceCount > 1) ? iInstanceCount : 1;
+		nodeInstances.resize(iPlacementCount * m_nodeMatrices.size());
+		for (int i = 0; i < iPlacementCount; i++)
+		{
+			XMMATRIX placementMatrix = (iInstanceCount > 1) ? XMMatrixTranspose(instances[i].worldMatrix) : m_worldMatrix;
+			for (size_t j = 0; j < m_nodeMatrices.size(); j++)
+			{
+				Instance& nodeInstance = nodeInstances[i * m_nodeMatrices.size() + j];
+				nodeInstance.worldMatrix = XMMatrixTranspose(XMLoadFloat4x4(&m_nodeMatrices[j]) * placementMatrix);
+				if (iInstanceCount > 1)
+				{
+					nodeInstance.lightDirection = instances[i].lightDirection;
+				}
+			}
+		}
+		iInstanceCount = (int)nodeInstances.size();
+		instances = nodeInstances.data();
 	}
 
 	// Create the vertex buffer
@@ -60,7 +122,7 @@ bool Model::InitializeBuffers(ID3D11Device* device, int iInstanceCount, Instance
 	bufferDesc.CPUAccessFlags = 0;								// No CPU access is necessary
 
 	D3D11_SUBRESOURCE_DATA subresourceData = {}; // Describes the actual data that will be copied to the vertex buffer during creation
-	subresourceData.pSysMem = vertices;
+	subresourceData.pSysMem = m_modelData;
 
 	HRESULT result = device->CreateBuffer(&bufferDesc, &subresourceData, &m_pVertexBuffer);
 	if (FAILED(result))
@@ -71,7 +133,7 @@ bool Model::InitializeBuffers(ID3D11Device* device, int iInstanceCount, Instance
 
 	// Create the index buffer
 
-	bufferDesc.ByteWidth = sizeof(unsigned long) * m_iIndexCount;
+	bufferDesc.ByteWidth = sizeof(unsigned int) * m_iIndexCount;
 	bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;				// Bind the buffer as an index buffer to the input assembler stage
 
 	subresourceData.pSysMem = indices;
@@ -83,18 +145,114 @@ bool Model::InitializeBuffers(ID3D11Device* device, int iInstanceCount, Instance
 		return false;
 	}
 
+	// The meshlets kept are gathered from the model's indices into a buffer of their own, with room for the whole of the full level for each instance culled on its own
+	if (!m_meshlets.empty() && m_indexData)
+	{
+		bufferDesc.ByteWidth = sizeof(unsigned int) * m_lods[0].uiIndexCount * (std::min)((std::max)(iInstanceCount, 1), (int)MaxMeshletInstances);
+		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+		result = device->CreateBuffer(&bufferDesc, nullptr, &m_pMeshletIndexBuffer);
+		if (FAILED(result))
+		{
+			Utils::ShowError("Failed to create meshlet index buffer.", result);
+			return false;
+		}
+
+		// It is filled with every meshlet for every instance, which is the full level as it is, until the first cull
+		m_drawnMeshlets.assign(1, std::vector<int>(m_meshlets.size()));
+		for (int i = 0; i < (int)m_meshlets.size(); i++)
+		{
+			m_drawnMeshlets[0][i] = i;
+		}
+		m_iMeshletInstanceCount = (std::max)(iInstanceCount, 1);
+		m_bDrawnMeshletsChanged = true;
+
+		bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+		bufferDesc.CPUAccessFlags = 0;
+	}
+	else
+	{
+		m_meshlets.clear();
+	}
+
 	m_iInstanceCount = iInstanceCount;
+	m_iDrawnInstanceCount = iInstanceCount;
+
+	// Models given a capacity have an instance buffer however many instances they start with
+	bool bInstanced = iInstanceCount > 1 || m_iInstanceCapacity > 1;
+	m_iInstanceCapacity = (std::max)(m_iInstanceCapacity, iInstanceCount);
 
-	if (iInstanceCount > 1)
+	// Culled models start out drawing every instance (a model without an instance buffer, its one instance)
+	if (m_bCulledInstances)
+	{
+		m_drawnInstances.resize(bInstanced ? iInstanceCount : 1);
+		for (int i = 0; i < (int)m_drawnInstances.size(); i++)
+		{
+			m_drawnInstances[i] = i;
+		}
+	}
+
+	if (bInstanced)
 	{
 		// Create the instance buffer
 
-		bufferDesc.ByteWidth = sizeof(Instance) * iInstanceCount;
+		for (int i = 0; i < iInstanceCount; i++)
+		{
+			instances[i].uiTextureSlice = m_uiTextureSlice;
+			if (instances[i].lightDirection.x == 0.0f && instances[i].lightDirection.y == 0.0f && instances[i].lightDirection.z == 0.0f)
+			{
+				instances[i].lightDirection = m_lightDirection;
+			}
+		}
+
+		// The 3x4 matrices are kept for the CPU either way, and are what dynamic instances upload
+		m_instanceData.resize(iInstanceCount);
+		Utils::ParallelFor(iInstanceCount, 0, [&](int iBegin, int iEnd)
+		{
+			for (int i = iBegin; i < iEnd; i++)
+			{
+				InstancePacker::Pack(instances[i], m_instanceData[i]);
+			}
+		}, 4096);
+
+		// Pack the instances compactly if every one of them allows it (and they won't move or be culled), otherwise as 3x4 matrices
+		std::vector<CompactInstanceData> compactInstances;
+		std::atomic<bool> bCompact(!m_bDynamicInstances && !m_bCulledInstances);
+		if (bCompact)
+		{
+			compactInstances.resize(iInstanceCount);
+			Utils::ParallelFor(iInstanceCount, 0, [&](int iBegin, int iEnd)
+			{
+				for (int i = iBegin; i < iEnd && bCompact; i++)
+				{
+					if (!InstancePacker::PackCompact(instances[i], compactInstances[i]))
+					{
+						bCompact = false;
+					}
+				}
+			}, 4096);
+		}
+		m_bCompactInstances = bCompact;
+
+		if (m_bCompactInstances)
+		{
+			bufferDesc.ByteWidth = sizeof(CompactInstanceData) * iInstanceCount;
+			subresourceData.pSysMem = compactInstances.data();
+		}
+		else
+		{
+			bufferDesc.ByteWidth = sizeof(InstanceData) * m_iInstanceCapacity;
+			subresourceData.pSysMem = m_instanceData.data();
+		}
 		bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-		
-		subresourceData.pSysMem = instances;
+		// Dynamic instances stay in a default buffer, updated by copies from the upload ring, so draws never wait on the CPU
+		// Culled models start out drawing every instance, and the instances they draw are gathered into the front of the buffer the same way
+		// A buffer with room to spare starts empty, and is filled that way by the first update
 
-		result = device->CreateBuffer(&bufferDesc, &subresourceData, &m_pInstanceBuffer);
+		bool bSpareRoom = m_iInstanceCapacity > iInstanceCount;
+		m_bDrawnInstancesChanged |= bSpareRoom;
+		result = device->CreateBuffer(&bufferDesc, bSpareRoom ? nullptr : &subresourceData, &m_pInstanceBuffer);
 		if (FAILED(result))
 		{
 			Utils::ShowError("Failed to create instance buffer.", result);
@@ -102,9 +260,87 @@ bool Model::InitializeBuffers(ID3D11Device* device, int iInstanceCount, Instance
 		}
 	}
 
-	// Release
-	SAFE_DELETE_ARRAY(vertices);
-	SAFE_DELETE_ARRAY(indices);
+	ComputeBounds();
+
+	return true;
+}
+
+void Model::ComputeBounds()
+{
+	if (m_iVertexCount == 0)
+	{
+		return;
+	}
+
+	// Center the sphere on the bounding box
+	XMVECTOR vMinimum = XMVectorSet(m_modelData[0].x, m_modelData[0].y, m_modelData[0].z, 0.0f);
+	XMVECTOR vMaximum = vMinimum;
+	for (int i = 1; i < m_iVertexCount; i++)
+	{
+		XMVECTOR vPosition = XMVectorSet(m_modelData[i].x, m_modelData[i].y, m_modelData[i].z, 0.0f);
+		vMinimum = XMVectorMin(vMinimum, vPosition);
+		vMaximum = XMVectorMax(vMaximum, vPosition);
+	}
+	XMVECTOR vCenter = (vMinimum + vMaximum) * 0.5f;
+	XMStoreFloat3(&m_boundingBoxMinimum, vMinimum);
+	XMStoreFloat3(&m_boundingBoxMaximum, vMaximum);
+
+	float fRadiusSquared = 0.0f;
+	for (int i = 0; i < m_iVertexCount; i++)
+	{
+		XMVECTOR vPosition = XMVectorSet(m_modelData[i].x, m_modelData[i].y, m_modelData[i].z, 0.0f);
+		fRadiusSquared = (std::max)(fRadiusSquared, XMVectorGetX(XMVector3LengthSq(vPosition - vCenter)));
+	}
+	XMStoreFloat4(&m_boundingSphere, XMVectorSetW(vCenter, sqrtf(fRadiusSquared)));
+
+	// Ratio of texture space area to surface area over every triangle of the full detail level
+	double dSurfaceArea = 0.0;
+	double dTextureArea = 0.0;
+	int iIndexCount = m_lods.empty() ? m_iIndexCount : (int)m_lods[0].uiIndexCount;
+	for (int i = 0; i + 2 < iIndexCount; i += 3)
+	{
+		const ModelData& a = m_modelData[m_indexData ? m_indexData[i] : i];
+		const ModelData& b = m_modelData[m_indexData ? m_indexData[i + 1] : i + 1];
+		const ModelData& c = m_modelData[m_indexData ? m_indexData[i + 2] : i + 2];
+
+		XMVECTOR vEdge1 = XMVectorSet(b.x - a.x, b.y - a.y, b.z - a.z, 0.0f);
+		XMVECTOR vEdge2 = XMVectorSet(c.x - a.x, c.y - a.y, c.z - a.z, 0.0f);
+		dSurfaceArea += 0.5f * XMVectorGetX(XMVector3Length(XMVector3Cross(vEdge1, vEdge2)));
+		dTextureArea += 0.5f * fabsf((b.tu - a.tu) * (c.tv - a.tv) - (c.tu - a.tu) * (b.tv - a.tv));
+	}
+	m_fTexcoordDensity = (dSurfaceArea > 0.0) ? (float)sqrt(dTextureArea / dSurfaceArea) : 0.0f;
+}
+
+bool Model::UploadInstances(ID3D11DeviceContext* immediateContext, UploadRing* pRing, const InstanceData* instances, const std::vector<int>& order, ID3D11Buffer* pBuffer)
+{
+	// As many instances as fit into the ring under one map, each batch copied into place before the next map can discard it
+	int iMaxCount = (int)(pRing->GetSize() / sizeof(InstanceData));
+	if (iMaxCount == 0)
+	{
+		return false;
+	}
+	for (int iFirst = 0; iFirst < (int)order.size(); iFirst += iMaxCount)
+	{
+		int iCount = (std::min)(iMaxCount, (int)order.size() - iFirst);
+		UINT uiRingOffset;
+		InstanceData* data = (InstanceData*)pRing->Map(immediateContext, iCount * sizeof(InstanceData), &uiRingOffset);
+		if (!data)
+		{
+			return false;
+		}
+		for (int i = 0; i < iCount; i++)
+		{
+			data[i] = instances[order[iFirst + i]];
+		}
+		pRing->Unmap(immediateContext);
+
+		D3D11_BOX sourceBox = {};
+		sourceBox.left = uiRingOffset;
+		sourceBox.right = uiRingOffset + iCount * sizeof(InstanceData);
+		sourceBox.bottom = 1;
+		sourceBox.back = 1;
+		immediateContext->CopySubresourceRegion(pBuffer, 0, iFirst * sizeof(InstanceData), 0, 0, pRing->GetBuffer(), 0, &sourceBox);
+	}
 
 	return true;
 }
@@ -123,11 +359,26 @@ ID3D11ShaderResourceView** Model::GetTexture()
 	return &m_pTexture;
 }
 
+void Model::SetTextureSlice(UINT uiSlice)
+{
+	m_uiTextureSlice = uiSlice;
+}
+
+UINT Model::GetTextureSlice()
+{
+	return m_uiTextureSlice;
+}
+
 void Model::SetVertexCount(int iCount)
 {
 	m_iVertexCount = iCount;
 }
 
+int Model::GetVertexCount()
+{
+	return m_iVertexCount;
+}
+
 void Model::SetIndexCount(int iCount)
 {
 	m_iIndexCount = iCount;
@@ -143,29 +394,249 @@ int Model::GetInstanceCount()
 	return m_iInstanceCount;
 }
 
-void Model::SetModelData(ModelData* modelData)
+bool Model::IsInstanced()
+{
+	return m_pInstanceBuffer != nullptr;
+}
+
+void Model::SetInstanceCapacity(int iCapacity)
+{
+	m_iInstanceCapacity = iCapacity;
+}
+
+int Model::GetInstanceCapacity()
+{
+	return m_iInstanceCapacity;
+}
+
+bool Model::SetInstances(const Instance* instances, int iCount)
+{
+	// Only culled models gather the instances they draw from the copies, so only they can swap the copies out
+	if (!m_bCulledInstances || !m_pInstanceBuffer || !m_nodeMatrices.empty() || iCount > m_iInstanceCapacity)
+	{
+		return false;
+	}
+
+	m_instanceData.resize(iCount);
+	for (int i = 0; i < iCount; i++)
+	{
+		Instance instance = instances[i];
+		instance.uiTextureSlice = m_uiTextureSlice;
+		if (instance.lightDirection.x == 0.0f && instance.lightDirection.y == 0.0f && instance.lightDirection.z == 0.0f)
+		{
+			instance.lightDirection = m_lightDirection;
+		}
+		InstancePacker::Pack(instance, m_instanceData[i]);
+	}
+
+	m_iInstanceCount = iCount;
+	m_drawnInstances.resize(iCount);
+	for (int i = 0; i < iCount; i++)
+	{
+		m_drawnInstances[i] = i;
+	}
+	m_dirtyInstances.clear();
+	m_bDrawnInstancesChanged = true;
+	return true;
+}
+
+bool Model::IsCompactInstanced()
+{
+	return m_bCompactInstances;
+}
+
+void Model::SetInstancesDynamic(bool bDynamic)
+{
+	m_bDynamicInstances = bDynamic;
+}
+
+bool Model::SetInstanceTransforms(int iFirst, int iCount, const XMFLOAT3* positions, const XMFLOAT4* rotations, const XMFLOAT3* scales)
+{
+	if (!m_bDynamicInstances || m_bCompactInstances || iFirst < 0 || iCount < 0 || iFirst + iCount > (int)m_instanceData.size())
+	{
+		return false;
+	}
+	if (iCount == 0)
+	{
+		return true;
+	}
+
+	InstancePacker::ComposeMatrices(positions, rotations, scales, iCount, &m_instanceData[iFirst]);
+
+	// Extend the last range when the updates run on from it, as they do when a model moves its instances in order
+	if (!m_dirtyInstances.empty() && m_dirtyInstances.back().first <= iFirst && iFirst <= m_dirtyInstances.back().second)
+	{
+		m_dirtyInstances.back().second = (std::max)(m_dirtyInstances.back().second, iFirst + iCount);
+	}
+	else
+	{
+		m_dirtyInstances.push_back(std::make_pair(iFirst, iFirst + iCount));
+	}
+	return true;
+}
+
+void Model::SetInstancesCulled(bool bCulled)
+{
+	m_bCulledInstances = bCulled;
+}
+
+bool Model::AreInstancesCulled()
+{
+	return m_bCulledInstances;
+}
+
+void Model::SetDrawnInstances(const std::vector<int>& instances)
+{
+	if (!m_bCulledInstances || instances == m_drawnInstances)
+	{
+		return;
+	}
+	m_drawnInstances = instances;
+	m_bDrawnInstancesChanged = true;
+}
+
+int Model::GetDrawnInstanceCount()
+{
+	return m_bCulledInstances ? m_iDrawnInstanceCount : m_iInstanceCount;
+}
+
+const std::vector<InstanceData>& Model::GetInstanceData()
+{
+	return m_instanceData;
+}
+
+void Model::SetFadeDistances(float fStart, float fEnd)
+{
+	m_fFadeStart = fStart;
+	m_fFadeEnd = fEnd;
+}
+
+float Model::GetFadeStart()
+{
+	return m_fFadeStart;
+}
+
+float Model::GetFadeEnd()
+{
+	return m_fFadeEnd;
+}
+
+void Model::SetModelData(const ModelData* modelData)
 {
 	m_modelData = modelData;
 }
 
+const ModelData* Model::GetModelData()
+{
+	return m_modelData;
+}
+
+void Model::SetIndexData(const unsigned int* indices)
+{
+	m_indexData = indices;
+}
+
+const unsigned int* Model::GetIndexData()
+{
+	return m_indexData;
+}
+
+void Model::SetLods(const std::vector<MeshLod>& lods)
+{
+	m_lods = lods;
+}
+
+int Model::GetLodCount()
+{
+	return (int)m_lods.size();
+}
+
+const MeshLod& Model::GetLod(int iLod)
+{
+	return m_lods[iLod];
+}
+
+void Model::SetCurrentLod(int iLod)
+{
+	m_iCurrentLod = iLod;
+}
+
+int Model::GetCurrentLod()
+{
+	return m_iCurrentLod;
+}
+
+void Model::SetMeshlets(const std::vector<Meshlet>& meshlets)
+{
+	m_meshlets = meshlets;
+}
+
+int Model::GetMeshletCount()
+{
+	return (int)m_meshlets.size();
+}
+
+bool Model::IsDrawingMeshlets()
+{
+	return m_iCurrentLod == 0 && m_pMeshletIndexBuffer;
+}
+
+const std::vector<MeshletDraw>& Model::GetMeshletDraws()
+{
+	return m_meshletDraws;
+}
+
+void Model::SetNodeMatrices(const std::vector<XMFLOAT4X4>& nodeMatrices)
+{
+	m_nodeMatrices = nodeMatrices;
+}
+
 XMMATRIX Model::GetWorldMatrix()
 {
 	return m_worldMatrix;
 }
 
-void Model::TransformWorldMatrix(XMMATRIX translationMatrix, XMMATRIX rotationMatrix, XMMATRIX scalingMatrix)
+XMMATRIX Model::GetInstanceWorldMatrix(int iInstance)
 {
-	m_worldMatrix = m_worldMatrix * translationMatrix * rotationMatrix * scalingMatrix;
+	if (m_instanceData.empty())
+	{
+		return m_worldMatrix;
+	}
+
+	// The instance data holds the first three rows of the transposed matrix
+	XMMATRIX transposedMatrix;
+	for (int i = 0; i < 3; i++)
+	{
+		transposedMatrix.r[i] = XMLoadFloat4(&m_instanceData[iInstance].worldMatrix[i]);
+	}
+	transposedMatrix.r[3] = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+	return XMMatrixTranspose(transposedMatrix);
 }
 
-XMFLOAT4 Model::GetAmbientColor()
+XMFLOAT4 Model::GetBoundingSphere()
 {
-	return m_ambientColor;
+	return m_boundingSphere;
 }
 
-XMFLOAT4 Model::GetDiffuseColor()
+void Model::GetBoundingBox(XMFLOAT3& minimum, XMFLOAT3& maximum)
 {
-	return m_diffuseColor;
+	minimum = m_boundingBoxMinimum;
+	maximum = m_boundingBoxMaximum;
+}
+
+float Model::GetTexcoordDensity()
+{
+	return m_fTexcoordDensity;
+}
+
+void Model::TransformWorldMatrix(XMMATRIX translationMatrix, XMMATRIX rotationMatrix, XMMATRIX scalingMatrix)
+{
+	m_worldMatrix = m_worldMatrix * translationMatrix * rotationMatrix * scalingMatrix;
+}
+
+const Material& Model::GetMaterial()
+{
+	return m_material;
 }
 
 void Model::SetLightDirection(float x, float y, float z)
@@ -178,14 +649,127 @@ XMFLOAT3 Model::GetLightDirection()
 	return m_lightDirection;
 }
 
-float Model::GetSpecularPower()
+#pragma endregion
+
+#pragma region Update
+
+void Model::CullMeshlets(const XMMATRIX& viewProjectionMatrix, const XMFLOAT3& cameraPosition)
 {
-	return m_fSpecularPower;
+	// Other levels are drawn whole; the meshlets kept last stay as they are until the full level comes back
+	if (!m_pMeshletIndexBuffer || m_iCurrentLod != 0)
+	{
+		return;
+	}
+
+	// The view is taken into each instance's model space, where the meshlet bounds are
+	int iInstanceCount = m_bCulledInstances ? (int)m_drawnInstances.size() : m_iInstanceCount;
+	bool bPerInstance = iInstanceCount <= MaxMeshletInstances;
+	m_culledMeshlets.resize(bPerInstance ? iInstanceCount : 1);
+	for (auto& meshlets : m_culledMeshlets)
+	{
+		meshlets.clear();
+	}
+	m_visibleMeshlets.assign(bPerInstance ? 0 : m_meshlets.size(), false);
+
+	XMVECTOR vCameraPosition = XMLoadFloat3(&cameraPosition);
+	for (int i = 0; i < iInstanceCount; i++)
+	{
+		XMMATRIX worldMatrix = GetInstanceWorldMatrix(m_bCulledInstances ? m_drawnInstances[i] : i);
+		XMFLOAT4 frustumPlanes[6];
+		MeshletBuilder::GetFrustumPlanes(worldMatrix * viewProjectionMatrix, frustumPlanes);
+
+		XMVECTOR vDeterminant;
+		XMMATRIX inverseWorldMatrix = XMMatrixInverse(&vDeterminant, worldMatrix);
+		XMFLOAT3 modelCameraPosition;
+		XMStoreFloat3(&modelCameraPosition, XMVector3TransformCoord(vCameraPosition, inverseWorldMatrix));
+		bool bMirrored = XMVectorGetX(vDeterminant) < 0.0f; // Its winding is flipped, so the side the cones face is culled by the rasterizer instead
+
+		for (int j = 0; j < (int)m_meshlets.size(); j++)
+		{
+			if ((bPerInstance || !m_visibleMeshlets[j]) && MeshletBuilder::IsInFrustum(m_meshlets[j], frustumPlanes) && (bMirrored || !MeshletBuilder::IsBackFacing(m_meshlets[j], modelCameraPosition)))
+			{
+				if (bPerInstance)
+				{
+					m_culledMeshlets[i].push_back(j);
+				}
+				else
+				{
+					m_visibleMeshlets[j] = true;
+				}
+			}
+		}
+	}
+	if (!bPerInstance)
+	{
+		for (int j = 0; j < (int)m_meshlets.size(); j++)
+		{
+			if (m_visibleMeshlets[j])
+			{
+				m_culledMeshlets[0].push_back(j);
+			}
+		}
+	}
+
+	// The buffer is only rewritten when what is kept changes
+	if (m_culledMeshlets != m_drawnMeshlets || iInstanceCount != m_iMeshletInstanceCount)
+	{
+		m_drawnMeshlets.swap(m_culledMeshlets);
+		m_iMeshletInstanceCount = iInstanceCount;
+		m_bDrawnMeshletsChanged = true;
+	}
 }
 
-XMFLOAT4 Model::GetSpecularColor()
+bool Model::UpdateMeshletIndices(ID3D11DeviceContext* immediateContext)
 {
-	return m_specularColor;
+	if (!m_bDrawnMeshletsChanged)
+	{
+		return true;
+	}
+	m_bDrawnMeshletsChanged = false;
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	HRESULT result = immediateContext->Map(m_pMeshletIndexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	if (FAILED(result))
+	{
+		return false;
+	}
+	unsigned int* indices = (unsigned int*)mappedResource.pData;
+	unsigned int uiIndexCount = 0;
+	m_meshletDraws.clear();
+	for (int i = 0; i < (int)m_drawnMeshlets.size(); i++)
+	{
+		const std::vector<int>& meshlets = m_drawnMeshlets[i];
+		if (meshlets.empty())
+		{
+			continue;
+		}
+
+		// An instance keeping the same meshlets as the one before it joins its draw
+		if (!m_meshletDraws.empty() && m_meshletDraws.back().uiFirstInstance + m_meshletDraws.back().uiInstanceCount == (UINT)i && meshlets == m_drawnMeshlets[i - 1])
+		{
+			m_meshletDraws.back().uiInstanceCount++;
+			continue;
+		}
+
+		// Meshlets are contiguous in the model's indices, so neighbouring ones kept are copied together
+		MeshletDraw draw = { uiIndexCount, 0, (UINT)i, (m_drawnMeshlets.size() == 1) ? (UINT)m_iMeshletInstanceCount : 1 };
+		for (size_t j = 0; j < meshlets.size(); )
+		{
+			const Meshlet& first = m_meshlets[meshlets[j]];
+			unsigned int uiRangeCount = first.uiIndexCount;
+			for (j++; j < meshlets.size() && m_meshlets[meshlets[j]].uiFirstIndex == first.uiFirstIndex + uiRangeCount; j++)
+			{
+				uiRangeCount += m_meshlets[meshlets[j]].uiIndexCount;
+			}
+			memcpy(indices + uiIndexCount, m_indexData + first.uiFirstIndex, uiRangeCount * sizeof(unsigned int));
+			uiIndexCount += uiRangeCount;
+		}
+		draw.uiIndexCount = uiIndexCount - draw.uiFirstIndex;
+		m_meshletDraws.push_back(draw);
+	}
+	immediateContext->Unmap(m_pMeshletIndexBuffer, 0);
+
+	return true;
 }
 
 #pragma endregion
@@ -196,7 +780,7 @@ void Model::Render(ID3D11DeviceContext* immediateContext)
 {
 	// Set the vertex and index buffers to active in the input assembler so they can be rendered (put them on the graphics pipeline)
 
-	if (m_iInstanceCount == 1)
+	if (!m_pInstanceBuffer)
 	{
 		UINT uiStrides = sizeof(Vertex);
 		UINT uiOffsets = 0;
@@ -212,7 +796,7 @@ void Model::Render(ID3D11DeviceContext* immediateContext)
 	{
 		UINT strides[2];
 		strides[0] = sizeof(Vertex);
-		strides[1] = sizeof(Instance);
+		strides[1] = m_bCompactInstances ? sizeof(CompactInstanceData) : sizeof(InstanceData);
 
 		UINT offsets[2];
 		offsets[0] = 0;
@@ -225,8 +809,9 @@ void Model::Render(ID3D11DeviceContext* immediateContext)
 		immediateContext->IASetVertexBuffers(0, 2, bufferPointers, strides, offsets);
 	}
 
+	// The full level is drawn from the meshlets kept, when it has them
 	immediateContext->IASetIndexBuffer(
-						m_pIndexBuffer,
+						IsDrawingMeshlets() ? m_pMeshletIndexBuffer : m_pIndexBuffer,
 						DXGI_FORMAT_R32_UINT,	// 32-bit format that supports 32 bits for the red channel
 						0);						// Offset in bytes from the start of the index buffer to the first index to use
 
@@ -234,4 +819,116 @@ void Model::Render(ID3D11DeviceContext* immediateContext)
 	immediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 }
 
+bool Model::UpdateInstanceBuffer(ID3D11DeviceContext* immediateContext, UploadRing* pRing)
+{
+	// Culled models hold copies of the instances they draw, so those are gathered again when the pick changes or any instance moves
+	if (m_bCulledInstances)
+	{
+		if (!m_bDrawnInstancesChanged && m_dirtyInstances.empty())
+		{
+			return true;
+		}
+		m_dirtyInstances.clear();
+		m_bDrawnInstancesChanged = false;
+		m_iDrawnInstanceCount = (int)m_drawnInstances.size();
+		if (!m_pInstanceBuffer)
+		{
+			return true; // The one instance is drawn with the world matrix, or not at all
+		}
+		return UploadInstances(immediateContext, pRing, m_instanceData.data(), m_drawnInstances, m_pInstanceBuffer);
+	}
+
+	if (m_dirtyInstances.empty())
+	{
+		return true;
+	}
+
+	// Join ranges that overlap or touch, so that each instance is uploaded once
+	std::sort(m_dirtyInstances.begin(), m_dirtyInstances.end());
+	std::vector<std::pair<int, int>> ranges;
+	for (const auto& range : m_dirtyInstances)
+	{
+		if (!ranges.empty() && range.first <= ranges.back().second)
+		{
+			ranges.back().second = (std::max)(ranges.back().second, range.second);
+		}
+		else
+		{
+			ranges.push_back(range);
+		}
+	}
+	m_dirtyInstances.clear();
+
+	// Write as many ranges as fit into the ring under one map, then copy each into place in the instance buffer
+	// A discard leaves the rest of the ring undefined, which is why the instance buffer isn't itself dynamic: only what moved is written
+	int iMaxCount = (int)(pRing->GetSize() / sizeof(InstanceData));
+	if (iMaxCount == 0)
+	{
+		return false;
+	}
+	size_t range = 0;
+	int iRangeOffset = 0; // Instances of the current range already uploaded
+	while (range < ranges.size())
+	{
+		// Instances in this batch
+		int iBatchCount = 0;
+		size_t lastRange = range;
+		int iLastOffset = iRangeOffset;
+		while (lastRange < ranges.size() && iBatchCount < iMaxCount)
+		{
+			int iCount = (std::min)(ranges[lastRange].second - ranges[lastRange].first - iLastOffset, iMaxCount - iBatchCount);
+			iBatchCount += iCount;
+			iLastOffset += iCount;
+			if (ranges[lastRange].first + iLastOffset == ranges[lastRange].second)
+			{
+				lastRange++;
+				iLastOffset = 0;
+			}
+		}
+
+		UINT uiRingOffset;
+		unsigned char* data = pRing->Map(immediateContext, iBatchCount * sizeof(InstanceData), &uiRingOffset);
+		if (!data)
+		{
+			return false;
+		}
+
+		std::vector<std::pair<UINT, D3D11_BOX>> copies; // Destination offset and source of each range
+		UINT uiSourceOffset = uiRingOffset;
+		while (range != lastRange || iRangeOffset != iLastOffset)
+		{
+			int iFirst = ranges[range].first + iRangeOffset;
+			int iEnd = (range == lastRange) ? ranges[range].first + iLastOffset : ranges[range].second;
+			UINT uiBytes = (iEnd - iFirst) * sizeof(InstanceData);
+			memcpy(data + (uiSourceOffset - uiRingOffset), &m_instanceData[iFirst], uiBytes);
+
+			D3D11_BOX sourceBox = {};
+			sourceBox.left = uiSourceOffset;
+			sourceBox.right = uiSourceOffset + uiBytes;
+			sourceBox.bottom = 1;
+			sourceBox.back = 1;
+			copies.push_back(std::make_pair(iFirst * (UINT)sizeof(InstanceData), sourceBox));
+			uiSourceOffset += uiBytes;
+
+			if (range == lastRange)
+			{
+				iRangeOffset = iLastOffset;
+			}
+			else
+			{
+				range++;
+				iRangeOffset = 0;
+			}
+		}
+		pRing->Unmap(immediateContext);
+
+		for (const auto& copy : copies)
+		{
+			immediateContext->CopySubresourceRegion(m_pInstanceBuffer, 0, copy.first, 0, 0, pRing->GetBuffer(), 0, &copy.second);
+		}
+	}
+
+	return true;
+}
+
 #pragma endregion
@@ -14,27 +14,30 @@
 
 #include <d3d11.h>
 #include <directxmath.h>
+#include <utility>
+#include <vector>
+#include "MeshFile.h"
+#include "InstancePacker.h"
+#include "MeshletBuilder.h"
+#include "UploadRing.h"
 #include "Utils.h"
 
 using namespace DirectX;
 
-struct Vertex
+struct MeshletDraw // Range of the meshlet index buffer, drawn for a run of instances
 {
-	XMFLOAT3 position;
-	XMFLOAT2 textureCoordinate;
-	XMFLOAT3 normal;
+	UINT uiFirstIndex;
+	UINT uiIndexCount;
+	UINT uiFirstInstance; // In the instance buffer
+	UINT uiInstanceCount;
 };
 
-struct Instance
+struct Material // Surface parameters shared by every instance of a model
 {
-	XMMATRIX worldMatrix;
-};
-
-struct ModelData
-{
-	float x, y, z;
-	float tu, tv;
-	float nx, ny, nz;
+	XMFLOAT4 ambientColor;
+	XMFLOAT4 diffuseColor;
+	float fSpecularPower;
+	XMFLOAT4 specularColor;
 };
 
 class Model
@@ -43,40 +46,110 @@ public:
 	Model();
 	~Model();
 
-	bool InitializeBuffers(ID3D11Device* device, int iInstanceCount, Instance* instances = nullptr);
+	Model(const Model&) = delete; // The model owns its buffers; place more instances of it rather than copying it
+	Model& operator=(const Model&) = delete;
+
+	bool InitializeBuffers(ID3D11Device* device, int iInstanceCount, Instance* instances = nullptr); // Instances are packed compactly when they all can be
 	void Render(ID3D11DeviceContext* immediateContext);
 
 	void SetTexture(ID3D11ShaderResourceView &texture);
 	ID3D11ShaderResourceView** GetTexture();
+	void SetTextureSlice(UINT uiSlice); // Set before the buffers are initialized; instances take the model's slice
+	UINT GetTextureSlice();
 	void SetVertexCount(int iCount);
-	void SetIndexCount(int iCount);
+	int GetVertexCount();
+	void SetIndexCount(int iCount); // Of the whole index buffer, over every level of detail
 	int GetIndexCount();
 	int GetInstanceCount();
-	void SetModelData(ModelData* modelData);
+	bool IsInstanced(); // Whether the model has an instance buffer, rather than drawing its one instance with the world matrix
+	void SetInstanceCapacity(int iCapacity); // Set before the buffers are initialized, for culled models whose instances SetInstances replaces
+	int GetInstanceCapacity(); // Instances the instance buffer holds
+	bool SetInstances(const Instance* instances, int iCount); // Replaces every instance of a culled model, up to its capacity, and draws them all; uploaded by UpdateInstanceBuffer
+	bool IsCompactInstanced(); // Whether the instance buffer holds CompactInstanceData rather than InstanceData
+	void SetInstancesDynamic(bool bDynamic); // Set before the buffers are initialized, for instances that move after loading (they are never packed compactly)
+	bool SetInstanceTransforms(int iFirst, int iCount, const XMFLOAT3* positions, const XMFLOAT4* rotations, const XMFLOAT3* scales); // Moves instances of a dynamic model (unit quaternion rotations); uploaded by UpdateInstanceBuffer
+	void SetInstancesCulled(bool bCulled); // Set before the buffers are initialized, for models that only draw the instances picked each frame (they are never packed compactly)
+	bool AreInstancesCulled();
+	void SetDrawnInstances(const std::vector<int>& instances); // Instances a culled model draws, in order; uploaded by UpdateInstanceBuffer
+	int GetDrawnInstanceCount(); // Every instance, unless the model is culled
+	const std::vector<InstanceData>& GetInstanceData();
+	void SetFadeDistances(float fStart, float fEnd); // Instances dither out between these distances from the camera (to the center of their bounds); zero for no fade
+	float GetFadeStart();
+	float GetFadeEnd();
+	void SetModelData(const ModelData* modelData); // Read straight into the vertex buffer, so it can be a view of a file
+	const ModelData* GetModelData();
+	void SetIndexData(const unsigned int* indices); // nullptr (the default) for an unindexed triangle list
+	const unsigned int* GetIndexData();
+	void SetLods(const std::vector<MeshLod>& lods); // Ranges of the index buffer, finest first; without them the whole buffer is the only level
+	int GetLodCount();
+	const MeshLod& GetLod(int iLod);
+	void SetCurrentLod(int iLod); // The level that is drawn
+	int GetCurrentLod();
+	void SetMeshlets(const std::vector<Meshlet>& meshlets); // Set before the buffers are initialized; the full level then only draws the meshlets CullMeshlets keeps
+	int GetMeshletCount();
+	bool IsDrawingMeshlets(); // Whether the full level is drawn, as the meshlet draws rather than the current level
+	const std::vector<MeshletDraw>& GetMeshletDraws();
+	void CullMeshlets(const XMMATRIX& viewProjectionMatrix, const XMFLOAT3& cameraPosition); // Keeps the meshlets each instance may show; uploaded by UpdateMeshletIndices
+	void SetNodeMatrices(const std::vector<XMFLOAT4X4>& nodeMatrices); // Placements of the mesh within the model (from the file's node hierarchy), applied before the world or instance matrices
 	XMMATRIX GetWorldMatrix();
+	XMMATRIX GetInstanceWorldMatrix(int iInstance); // The world matrix when there is a single instance
+	XMFLOAT4 GetBoundingSphere(); // Model space; xyz = center, w = radius
+	void GetBoundingBox(XMFLOAT3& minimum, XMFLOAT3& maximum); // Model space
+	float GetTexcoordDensity(); // Texture coordinate units per model space unit, averaged over the surface
 	void TransformWorldMatrix(XMMATRIX translationMatrix, XMMATRIX rotationMatrix, XMMATRIX scalingMatrix);
-	XMFLOAT4 GetAmbientColor();
-	XMFLOAT4 GetDiffuseColor();
-	void SetLightDirection(float x, float y, float z);
+	const Material& GetMaterial();
+	void SetLightDirection(float x, float y, float z); // Of instances that don't set their own
 	XMFLOAT3 GetLightDirection();
-	float GetSpecularPower();
-	XMFLOAT4 GetSpecularColor();
+
+	static bool UploadInstances(ID3D11DeviceContext* immediateContext, UploadRing* pRing, const InstanceData* instances, const std::vector<int>& order, ID3D11Buffer* pBuffer); // Gathers the instances in order into the start of a default buffer
+
+	bool UpdateInstanceBuffer(ID3D11DeviceContext* immediateContext, UploadRing* pRing); // Copies the instances moved (or, when culled, picked) since the last update into the instance buffer
+	bool UpdateMeshletIndices(ID3D11DeviceContext* immediateContext); // Gathers the indices of the meshlets kept, if they changed, into the meshlet index buffer
 
 protected:
 	ID3D11ShaderResourceView* m_pTexture;
+	UINT m_uiTextureSlice;
 	ID3D11Buffer* m_pVertexBuffer;
 	int m_iVertexCount;
 	ID3D11Buffer* m_pIndexBuffer;
 	int m_iIndexCount;
 	ID3D11Buffer* m_pInstanceBuffer;
 	int m_iInstanceCount;
-	ModelData* m_modelData;
+	int m_iInstanceCapacity;
+	bool m_bCompactInstances;
+	bool m_bDynamicInstances;
+	bool m_bCulledInstances;
+	std::vector<int> m_drawnInstances;
+	bool m_bDrawnInstancesChanged;
+	int m_iDrawnInstanceCount; // In the instance buffer of a culled model
+	float m_fFadeStart;
+	float m_fFadeEnd;
+	const ModelData* m_modelData;
+	const unsigned int* m_indexData;
+	std::vector<MeshLod> m_lods;
+	int m_iCurrentLod;
+	std::vector<Meshlet> m_meshlets;
+	std::vector<std::vector<int>> m_drawnMeshlets; // Kept by the last cull for each instance drawn, in order, or for all of them at once
+	std::vector<std::vector<int>> m_culledMeshlets; // Kept by the current cull, swapped with the last when they differ
+	std::vector<bool> m_visibleMeshlets;
+	int m_iMeshletInstanceCount; // Instances drawn at the last cull
+	bool m_bDrawnMeshletsChanged;
+	ID3D11Buffer* m_pMeshletIndexBuffer; // Dynamic, rewritten whole whenever the meshlets kept change
+	std::vector<MeshletDraw> m_meshletDraws;
+
+	static const int MaxMeshletInstances = 16; // Models drawing more instances keep the meshlets any of them may show, so they still draw in one call
+	std::vector<XMFLOAT4X4> m_nodeMatrices;
+	std::vector<InstanceData> m_instanceData; // Copy of the instance buffer (as InstanceData even when it is compact), for culling, texture streaming and updates
+	std::vector<std::pair<int, int>> m_dirtyInstances; // Ranges (first, end) moved since the last update
+	XMFLOAT4 m_boundingSphere;
+	XMFLOAT3 m_boundingBoxMinimum;
+	XMFLOAT3 m_boundingBoxMaximum;
+	float m_fTexcoordDensity;
 	XMMATRIX m_worldMatrix;
-	XMFLOAT4 m_ambientColor;
-	XMFLOAT4 m_diffuseColor;
+	Material m_material;
 	XMFLOAT3 m_lightDirection;
-	float m_fSpecularPower;
-	XMFLOAT4 m_specularColor;
+
+	void ComputeBounds();
 };
 
 #endif
@@ -0,0 +1,570 @@
+//
+// OcclusionCuller.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Masked Software Occlusion Culling (Hasselgren et al., 2016)
+// Triangle Scan Conversion using 2D Homogeneous Coordinates (Olano and Greer, 1997)
+//
+
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// SSE2 is part of every x64 and 32-bit Windows target
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define OCCLUSION_CULLER_SSE
+#endif
+
+namespace
+{
+	const int TriangleBatchSize = 1024; // Occluder triangles set up together, by one thread
+	const float GuardBand = 2.0f; // Triangles are clipped this many times the view's half width (and height) from its center, so the edge functions keep their precision
+}
+
+#pragma region Init
+
+OcclusionCuller::OcclusionCuller()
+{
+	m_iWidth = 0;
+	m_iHeight = 0;
+	m_iTilesWide = 0;
+	m_iTilesHigh = 0;
+	XMStoreFloat4x4(&m_viewProjectionMatrix, XMMatrixIdentity());
+	m_iRasterizedTriangleCount = 0;
+}
+
+bool OcclusionCuller::Initialize(int iWidth, int iHeight, int iThreadCount)
+{
+	if (iWidth <= 0 || iHeight <= 0)
+	{
+		return false;
+	}
+
+	m_iTilesWide = (iWidth + TileWidth - 1) / TileWidth;
+	m_iTilesHigh = (iHeight + TileHeight - 1) / TileHeight;
+	m_iWidth = m_iTilesWide * TileWidth;
+	m_iHeight = m_iTilesHigh * TileHeight;
+
+	// Started once, since every frame sets up and rasterizes on them
+	if (!m_workerPool.Initialize(iThreadCount))
+	{
+		return false;
+	}
+
+	int iSubtileCount = m_iTilesWide * m_iTilesHigh * (TileWidth / SubtileWidth);
+	m_farDepths.resize(iSubtileCount);
+	m_maskDepths.resize(iSubtileCount);
+	m_masks.resize(iSubtileCount);
+
+	return true;
+}
+
+#pragma endregion
+
+#pragma region Setters/Getters
+
+int OcclusionCuller::GetWidth()
+{
+	return m_iWidth;
+}
+
+int OcclusionCuller::GetHeight()
+{
+	return m_iHeight;
+}
+
+int OcclusionCuller::GetRasterizedTriangleCount()
+{
+	return m_iRasterizedTriangleCount;
+}
+
+#pragma endregion
+
+#pragma region Render
+
+void OcclusionCuller::BeginFrame(const XMMATRIX& viewProjectionMatrix)
+{
+	XMStoreFloat4x4(&m_viewProjectionMatrix, viewProjectionMatrix);
+	m_occluders.clear();
+	std::fill(m_farDepths.begin(), m_farDepths.end(), 1.0f);
+	std::fill(m_maskDepths.begin(), m_maskDepths.end(), 0.0f);
+	std::fill(m_masks.begin(), m_masks.end(), 0u);
+}
+
+void OcclusionCuller::AddOccluder(const ModelData* vertices, const unsigned int* indices, int iIndexCount, const XMMATRIX& worldMatrix)
+{
+	Occluder occluder;
+	occluder.vertices = vertices;
+	occluder.indices = indices;
+	occluder.iIndexCount = iIndexCount;
+	XMStoreFloat4x4(&occluder.worldViewProjectionMatrix, worldMatrix * XMLoadFloat4x4(&m_viewProjectionMatrix));
+	m_occluders.push_back(occluder);
+}
+
+void OcclusionCuller::RenderOccluders()
+{
+	m_firstTriangles.resize(m_occluders.size() + 1);
+	m_firstTriangles[0] = 0;
+	for (size_t i = 0; i < m_occluders.size(); i++)
+	{
+		m_firstTriangles[i + 1] = m_firstTriangles[i] + m_occluders[i].iIndexCount / 3;
+	}
+	int iTriangleCount = m_firstTriangles.back();
+
+	// Every batch is transformed, clipped and set up at once, then each thread rasterizes all of them into its own rows of tiles, in order
+	int iBatchCount = (iTriangleCount + TriangleBatchSize - 1) / TriangleBatchSize;
+	m_triangleBatches.resize(iBatchCount);
+	m_workerPool.ParallelFor(iBatchCount, [&](int iBegin, int iEnd)
+	{
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			SetUpTriangles(i, i * TriangleBatchSize, (std::min)((i + 1) * TriangleBatchSize, iTriangleCount));
+		}
+	}, 2);
+
+	m_iRasterizedTriangleCount = 0;
+	for (int i = 0; i < iBatchCount; i++)
+	{
+		m_iRasterizedTriangleCount += (int)m_triangleBatches[i].size();
+	}
+
+	m_workerPool.ParallelFor(m_iTilesHigh, [&](int iBegin, int iEnd)
+	{
+		for (int i = 0; i < iBatchCount; i++)
+		{
+			for (const auto& triangle : m_triangleBatches[i])
+			{
+				if (triangle.iMaxTileY >= iBegin && triangle.iMinTileY < iEnd)
+				{
+					RasterizeTriangle(triangle, (std::max)(triangle.iMinTileY, iBegin), (std::min)(triangle.iMaxTileY, iEnd - 1));
+				}
+			}
+		}
+	}, 2);
+}
+
+void OcclusionCuller::SetUpTriangles(int iBatch, int iFirstTriangle, int iEndTriangle)
+{
+	std::vector<ScreenTriangle>& triangles = m_triangleBatches[iBatch];
+	triangles.clear();
+
+	int iOccluder = (int)(std::upper_bound(m_firstTriangles.begin(), m_firstTriangles.end(), iFirstTriangle) - m_firstTriangles.begin()) - 1;
+	XMMATRIX worldViewProjectionMatrix = XMLoadFloat4x4(&m_occluders[iOccluder].worldViewProjectionMatrix);
+	for (int i = iFirstTriangle; i < iEndTriangle; i++)
+	{
+		while (i >= m_firstTriangles[iOccluder + 1])
+		{
+			iOccluder++;
+			worldViewProjectionMatrix = XMLoadFloat4x4(&m_occluders[iOccluder].worldViewProjectionMatrix);
+		}
+		const Occluder& occluder = m_occluders[iOccluder];
+
+		XMVECTOR clipPositions[3];
+		int iIndex = (i - m_firstTriangles[iOccluder]) * 3;
+		for (int j = 0; j < 3; j++)
+		{
+			const ModelData& vertex = occluder.vertices[occluder.indices ? occluder.indices[iIndex + j] : iIndex + j];
+			clipPositions[j] = XMVector4Transform(XMVectorSet(vertex.x, vertex.y, vertex.z, 1.0f), worldViewProjectionMatrix);
+		}
+		ClipTriangle(clipPositions, triangles);
+	}
+}
+
+void OcclusionCuller::ClipTriangle(const XMVECTOR* clipPositions, std::vector<ScreenTriangle>& triangles)
+{
+	// The near plane (z >= 0), then the guard band's sides, as distances that are positive inside
+	const XMVECTOR planes[5] =
+	{
+		XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f),
+		XMVectorSet(1.0f, 0.0f, 0.0f, GuardBand),
+		XMVectorSet(-1.0f, 0.0f, 0.0f, GuardBand),
+		XMVectorSet(0.0f, 1.0f, 0.0f, GuardBand),
+		XMVectorSet(0.0f, -1.0f, 0.0f, GuardBand)
+	};
+
+	// Most triangles are inside every plane, or wholly outside one; only the rest are clipped
+	int iCrossed = 0;
+	for (int i = 0; i < 5; i++)
+	{
+		int iOutside = 0;
+		for (int j = 0; j < 3; j++)
+		{
+			iOutside += XMVectorGetX(XMVector4Dot(planes[i], clipPositions[j])) < 0.0f;
+		}
+		if (iOutside == 3)
+		{
+			return;
+		}
+		iCrossed |= (iOutside > 0) << i;
+	}
+
+	// Or wholly outside the view, though inside the guard band, or beyond the far plane
+	int iOutsideView = 0x1F;
+	for (int j = 0; j < 3; j++)
+	{
+		XMFLOAT4 position;
+		XMStoreFloat4(&position, clipPositions[j]);
+		iOutsideView &= (position.x < -position.w) | ((position.x > position.w) << 1) | ((position.y < -position.w) << 2) | ((position.y > position.w) << 3) | ((position.z > position.w) << 4);
+	}
+	if (iOutsideView != 0)
+	{
+		return;
+	}
+
+	if (iCrossed == 0)
+	{
+		AddTriangle(clipPositions, triangles);
+		return;
+	}
+
+	// Each plane can add a vertex to the polygon, so five planes leave at most eight
+	XMVECTOR polygon[8];
+	XMVECTOR clippedPolygon[8];
+	int iVertexCount = 3;
+	std::copy(clipPositions, clipPositions + 3, polygon);
+	for (int i = 0; i < 5 && iVertexCount >= 3; i++)
+	{
+		if ((iCrossed & (1 << i)) == 0)
+		{
+			continue;
+		}
+
+		int iClippedCount = 0;
+		for (int j = 0; j < iVertexCount; j++)
+		{
+			const XMVECTOR& vCurrent = polygon[j];
+			const XMVECTOR& vNext = polygon[(j + 1) % iVertexCount];
+			float fCurrent = XMVectorGetX(XMVector4Dot(planes[i], vCurrent));
+			float fNext = XMVectorGetX(XMVector4Dot(planes[i], vNext));
+			if (fCurrent >= 0.0f)
+			{
+				clippedPolygon[iClippedCount++] = vCurrent;
+			}
+			if ((fCurrent >= 0.0f) != (fNext >= 0.0f))
+			{
+				clippedPolygon[iClippedCount++] = XMVectorLerp(vCurrent, vNext, fCurrent / (fCurrent - fNext));
+			}
+		}
+		iVertexCount = iClippedCount;
+		std::copy(clippedPolygon, clippedPolygon + iVertexCount, polygon);
+	}
+
+	// A fan of the polygon's vertices
+	for (int i = 1; i + 1 < iVertexCount; i++)
+	{
+		XMVECTOR fan[3] = { polygon[0], polygon[i], polygon[i + 1] };
+		AddTriangle(fan, triangles);
+	}
+}
+
+void OcclusionCuller::AddTriangle(const XMVECTOR* clipPositions, std::vector<ScreenTriangle>& triangles)
+{
+	// To pixels, with y down
+	float x[3], y[3], z[3];
+	for (int i = 0; i < 3; i++)
+	{
+		XMFLOAT4 position;
+		XMStoreFloat4(&position, clipPositions[i]);
+		float fInverseW = 1.0f / position.w;
+		x[i] = (position.x * fInverseW * 0.5f + 0.5f) * m_iWidth;
+		y[i] = (0.5f - position.y * fInverseW * 0.5f) * m_iHeight;
+		z[i] = position.z * fInverseW;
+	}
+
+	// Front faces wind clockwise on screen, which with y down is a positive area; the rest are culled as the rasterizer culls them
+	float fArea = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (!(fArea > 0.0f))
+	{
+		return;
+	}
+
+	// Pixels whose centers the bounds take in; triangles between pixel centers cover none
+	int iMinX = (std::max)((int)ceilf((std::min)(x[0], (std::min)(x[1], x[2])) - 0.5f), 0);
+	int iMaxX = (std::min)((int)floorf((std::max)(x[0], (std::max)(x[1], x[2])) - 0.5f), m_iWidth - 1);
+	int iMinY = (std::max)((int)ceilf((std::min)(y[0], (std::min)(y[1], y[2])) - 0.5f), 0);
+	int iMaxY = (std::min)((int)floorf((std::max)(y[0], (std::max)(y[1], y[2])) - 0.5f), m_iHeight - 1);
+	if (iMinX > iMaxX || iMinY > iMaxY)
+	{
+		return;
+	}
+
+	ScreenTriangle triangle;
+	for (int i = 0; i < 3; i++)
+	{
+		int iNext = (i + 1) % 3;
+		triangle.edges[i][0] = y[i] - y[iNext];
+		triangle.edges[i][1] = x[iNext] - x[i];
+		triangle.edges[i][2] = -(triangle.edges[i][0] * x[i] + triangle.edges[i][1] * y[i]);
+	}
+
+	// Depth over the screen is a plane, since z / w is linear in screen space
+	float fInverseArea = 1.0f / fArea;
+	triangle.depthPlane[0] = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) * fInverseArea;
+	triangle.depthPlane[1] = ((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0])) * fInverseArea;
+	triangle.depthPlane[2] = z[0] - triangle.depthPlane[0] * x[0] - triangle.depthPlane[1] * y[0];
+	triangle.fMaxDepth = (std::max)(z[0], (std::max)(z[1], z[2]));
+
+	triangle.iMinTileX = iMinX / TileWidth;
+	triangle.iMaxTileX = iMaxX / TileWidth;
+	triangle.iMinTileY = iMinY / TileHeight;
+	triangle.iMaxTileY = iMaxY / TileHeight;
+	triangles.push_back(triangle);
+}
+
+void OcclusionCuller::RasterizeTriangle(const ScreenTriangle& triangle, int iMinTileY, int iMaxTileY)
+{
+	// Each subtile is covered by the pixels inside every edge, and is at most as deep as the depth plane at its farthest corner (or the triangle's farthest vertex)
+	// The coverage is then merged into the subtile: while the triangle is nearer than its farthest depth, the mask grows and its depth becomes the farther of the two,
+	// unless the triangle is much nearer than the mask already is, when the mask starts again from the triangle alone
+	const int SubtileCount = TileWidth / SubtileWidth;
+	float fCornerOffsetX = (triangle.depthPlane[0] > 0.0f) ? (float)SubtileWidth : 0.0f;
+	float fCornerOffsetY = (triangle.depthPlane[1] > 0.0f) ? (float)TileHeight : 0.0f;
+
+#ifdef OCCLUSION_CULLER_SSE
+	const __m128 vZero = _mm_setzero_ps();
+	const __m128 vSubtileOffsets = _mm_setr_ps(0.0f, (float)SubtileWidth, 2.0f * SubtileWidth, 3.0f * SubtileWidth);
+	const __m128i vFullMask = _mm_set1_epi32(-1);
+	__m128 vEdgeA[3], vEdgeB[3], vEdgeC[3], vEdgeLowest[3], vEdgeHighest[3];
+	for (int i = 0; i < 3; i++)
+	{
+		vEdgeA[i] = _mm_set1_ps(triangle.edges[i][0]);
+		vEdgeB[i] = _mm_set1_ps(triangle.edges[i][1]);
+		vEdgeC[i] = _mm_set1_ps(triangle.edges[i][2]);
+
+		// Lowest and highest of the edge function over a subtile's pixel centers, from its first pixel's
+		float fAcross = triangle.edges[i][0] * (SubtileWidth - 1);
+		float fDown = triangle.edges[i][1] * (TileHeight - 1);
+		vEdgeLowest[i] = _mm_set1_ps((std::min)(fAcross, 0.0f) + (std::min)(fDown, 0.0f));
+		vEdgeHighest[i] = _mm_set1_ps((std::max)(fAcross, 0.0f) + (std::max)(fDown, 0.0f));
+	}
+	const __m128 vDepthA = _mm_set1_ps(triangle.depthPlane[0]);
+	const __m128 vMaxDepth = _mm_set1_ps(triangle.fMaxDepth);
+
+	// Each edge function at every pixel center of a subtile, from its first pixel's, for the subtiles only partly covered
+	float pixelOffsets[3][TileHeight * SubtileWidth];
+	for (int i = 0; i < 3; i++)
+	{
+		for (int iPixel = 0; iPixel < TileHeight * SubtileWidth; iPixel++)
+		{
+			pixelOffsets[i][iPixel] = triangle.edges[i][0] * (iPixel % SubtileWidth) + triangle.edges[i][1] * (iPixel / SubtileWidth);
+		}
+	}
+
+	for (int iTileY = iMinTileY; iTileY <= iMaxTileY; iTileY++)
+	{
+		float fY = (float)(iTileY * TileHeight);
+		__m128 vDepthRow = _mm_set1_ps(triangle.depthPlane[1] * (fY + fCornerOffsetY) + triangle.depthPlane[2]);
+		for (int iTileX = triangle.iMinTileX; iTileX <= triangle.iMaxTileX; iTileX++)
+		{
+			// Each lane is a subtile, and starts at its first pixel center
+			__m128 vX = _mm_add_ps(_mm_set1_ps(iTileX * TileWidth + 0.5f), vSubtileOffsets);
+			__m128 vEdges[3];
+			__m128 vOutside = vZero;
+			__m128 vInside = _mm_castsi128_ps(vFullMask);
+			int iCrossingEdges = 0;
+			for (int i = 0; i < 3; i++)
+			{
+				vEdges[i] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vEdgeA[i], vX), _mm_mul_ps(vEdgeB[i], _mm_set1_ps(fY + 0.5f))), vEdgeC[i]);
+				vOutside = _mm_or_ps(vOutside, _mm_cmplt_ps(_mm_add_ps(vEdges[i], vEdgeHighest[i]), vZero));
+				__m128 vInsideEdge = _mm_cmpge_ps(_mm_add_ps(vEdges[i], vEdgeLowest[i]), vZero);
+				vInside = _mm_and_ps(vInside, vInsideEdge);
+				iCrossingEdges |= (_mm_movemask_ps(vInsideEdge) != 0xF) << i;
+			}
+			int iOutsideLanes = _mm_movemask_ps(vOutside);
+			if (iOutsideLanes == 0xF)
+			{
+				continue;
+			}
+
+			// Subtiles the triangle only partly covers test each pixel center, in every lane at once
+			__m128i vCoverage = _mm_castps_si128(vInside);
+			if ((_mm_movemask_ps(vInside) | iOutsideLanes) != 0xF)
+			{
+				// Edges that every subtile of the tile is wholly inside cover every pixel, so are skipped
+				__m128i vMask = _mm_setzero_si128();
+				for (int iPixel = 0; iPixel < TileHeight * SubtileWidth; iPixel++)
+				{
+					__m128 vCovered = _mm_castsi128_ps(vFullMask);
+					for (int i = 0; i < 3; i++)
+					{
+						if (iCrossingEdges & (1 << i))
+						{
+							vCovered = _mm_and_ps(vCovered, _mm_cmpge_ps(_mm_add_ps(vEdges[i], _mm_set1_ps(pixelOffsets[i][iPixel])), vZero));
+						}
+					}
+					vMask = _mm_or_si128(vMask, _mm_and_si128(_mm_castps_si128(vCovered), _mm_set1_epi32(1 << iPixel)));
+				}
+				vCoverage = _mm_or_si128(vCoverage, vMask);
+			}
+			vCoverage = _mm_andnot_si128(_mm_castps_si128(vOutside), vCoverage);
+
+			// Farthest depth of the triangle over each subtile
+			__m128 vDepth = _mm_add_ps(vDepthRow, _mm_mul_ps(vDepthA, _mm_add_ps(_mm_set1_ps(iTileX * TileWidth + fCornerOffsetX), vSubtileOffsets)));
+			vDepth = _mm_max_ps(_mm_min_ps(vDepth, vMaxDepth), vZero);
+
+			int iSubtile = (iTileY * m_iTilesWide + iTileX) * SubtileCount;
+			__m128 vFarDepth = _mm_loadu_ps(&m_farDepths[iSubtile]);
+			__m128 vMaskDepth = _mm_loadu_ps(&m_maskDepths[iSubtile]);
+			__m128i vSubtileMask = _mm_loadu_si128((const __m128i*)&m_masks[iSubtile]);
+
+			__m128 vUpdated = _mm_and_ps(_mm_cmplt_ps(vDepth, vFarDepth), _mm_castsi128_ps(_mm_xor_si128(_mm_cmpeq_epi32(vCoverage, _mm_setzero_si128()), vFullMask)));
+			if (_mm_movemask_ps(vUpdated) == 0)
+			{
+				continue;
+			}
+
+			__m128 vRestart = _mm_cmpgt_ps(_mm_sub_ps(vMaskDepth, vDepth), _mm_sub_ps(vFarDepth, vMaskDepth));
+			__m128i vNewMask = _mm_or_si128(_mm_andnot_si128(_mm_castps_si128(vRestart), vSubtileMask), vCoverage);
+			__m128 vNewMaskDepth = _mm_max_ps(_mm_andnot_ps(vRestart, vMaskDepth), vDepth);
+			__m128 vFull = _mm_castsi128_ps(_mm_cmpeq_epi32(vNewMask, vFullMask));
+			__m128 vNewFarDepth = _mm_or_ps(_mm_and_ps(vFull, _mm_min_ps(vNewMaskDepth, vFarDepth)), _mm_andnot_ps(vFull, vFarDepth));
+			vNewMaskDepth = _mm_andnot_ps(vFull, vNewMaskDepth);
+			vNewMask = _mm_andnot_si128(_mm_castps_si128(vFull), vNewMask);
+
+			__m128i vUpdatedMask = _mm_castps_si128(vUpdated);
+			_mm_storeu_ps(&m_farDepths[iSubtile], _mm_or_ps(_mm_and_ps(vUpdated, vNewFarDepth), _mm_andnot_ps(vUpdated, vFarDepth)));
+			_mm_storeu_ps(&m_maskDepths[iSubtile], _mm_or_ps(_mm_and_ps(vUpdated, vNewMaskDepth), _mm_andnot_ps(vUpdated, vMaskDepth)));
+			_mm_storeu_si128((__m128i*)&m_masks[iSubtile], _mm_or_si128(_mm_and_si128(vUpdatedMask, vNewMask), _mm_andnot_si128(vUpdatedMask, vSubtileMask)));
+		}
+	}
+#else
+	for (int iTileY = iMinTileY; iTileY <= iMaxTileY; iTileY++)
+	{
+		float fY = (float)(iTileY * TileHeight);
+		for (int iTileX = triangle.iMinTileX; iTileX <= triangle.iMaxTileX; iTileX++)
+		{
+			for (int iLane = 0; iLane < SubtileCount; iLane++)
+			{
+				float fX = (float)(iTileX * TileWidth + iLane * SubtileWidth);
+				unsigned int uiCoverage = 0;
+				for (int iRow = 0; iRow < TileHeight; iRow++)
+				{
+					for (int iColumn = 0; iColumn < SubtileWidth; iColumn++)
+					{
+						bool bCovered = true;
+						for (int i = 0; i < 3; i++)
+						{
+							bCovered &= triangle.edges[i][0] * (fX + iColumn + 0.5f) + triangle.edges[i][1] * (fY + iRow + 0.5f) + triangle.edges[i][2] >= 0.0f;
+						}
+						uiCoverage |= (bCovered ? 1u : 0u) << (iRow * SubtileWidth + iColumn);
+					}
+				}
+
+				float fDepth = triangle.depthPlane[0] * (fX + fCornerOffsetX) + triangle.depthPlane[1] * (fY + fCornerOffsetY) + triangle.depthPlane[2];
+				fDepth = (std::max)((std::min)(fDepth, triangle.fMaxDepth), 0.0f);
+
+				int iSubtile = (iTileY * m_iTilesWide + iTileX) * SubtileCount + iLane;
+				if (uiCoverage == 0 || fDepth >= m_farDepths[iSubtile])
+				{
+					continue;
+				}
+
+				if (m_maskDepths[iSubtile] - fDepth > m_farDepths[iSubtile] - m_maskDepths[iSubtile])
+				{
+					m_masks[iSubtile] = 0;
+					m_maskDepths[iSubtile] = 0.0f;
+				}
+				m_masks[iSubtile] |= uiCoverage;
+				m_maskDepths[iSubtile] = (std::max)(m_maskDepths[iSubtile], fDepth);
+				if (m_masks[iSubtile] == 0xFFFFFFFF)
+				{
+					m_farDepths[iSubtile] = (std::min)(m_maskDepths[iSubtile], m_farDepths[iSubtile]);
+					m_maskDepths[iSubtile] = 0.0f;
+					m_masks[iSubtile] = 0;
+				}
+			}
+		}
+	}
+#endif
+}
+
+#pragma endregion
+
+#pragma region Test
+
+bool OcclusionCuller::IsInView(const XMFLOAT3& minimum, const XMFLOAT3& maximum, const XMMATRIX& worldMatrix)
+{
+	// Outside if every corner is outside one plane
+	XMMATRIX worldViewProjectionMatrix = worldMatrix * XMLoadFloat4x4(&m_viewProjectionMatrix);
+	int iInside[6] = {};
+	for (int i = 0; i < 8; i++)
+	{
+		XMFLOAT4 corner;
+		XMStoreFloat4(&corner, XMVector4Transform(XMVectorSet((i & 1) ? maximum.x : minimum.x, (i & 2) ? maximum.y : minimum.y, (i & 4) ? maximum.z : minimum.z, 1.0f), worldViewProjectionMatrix));
+		iInside[0] += corner.x >= -corner.w;
+		iInside[1] += corner.x <= corner.w;
+		iInside[2] += corner.y >= -corner.w;
+		iInside[3] += corner.y <= corner.w;
+		iInside[4] += corner.z >= 0.0f;
+		iInside[5] += corner.z <= corner.w;
+	}
+	return std::find(iInside, iInside + 6, 0) == iInside + 6;
+}
+
+bool OcclusionCuller::IsVisible(const XMFLOAT3& minimum, const XMFLOAT3& maximum, const XMMATRIX& worldMatrix)
+{
+	if (!IsInView(minimum, maximum, worldMatrix))
+	{
+		return false;
+	}
+
+	// The box's screen rectangle, at the depth of its nearest corner; boxes through the near plane are always visible
+	XMMATRIX worldViewProjectionMatrix = worldMatrix * XMLoadFloat4x4(&m_viewProjectionMatrix);
+	float fMinX = FLT_MAX, fMaxX = -FLT_MAX, fMinY = FLT_MAX, fMaxY = -FLT_MAX, fMinDepth = FLT_MAX;
+	for (int i = 0; i < 8; i++)
+	{
+		XMFLOAT4 corner;
+		XMStoreFloat4(&corner, XMVector4Transform(XMVectorSet((i & 1) ? maximum.x : minimum.x, (i & 2) ? maximum.y : minimum.y, (i & 4) ? maximum.z : minimum.z, 1.0f), worldViewProjectionMatrix));
+		if (corner.z < 0.0f)
+		{
+			return true;
+		}
+		float fInverseW = 1.0f / corner.w;
+		float fX = (corner.x * fInverseW * 0.5f + 0.5f) * m_iWidth;
+		float fY = (0.5f - corner.y * fInverseW * 0.5f) * m_iHeight;
+		fMinX = (std::min)(fMinX, fX);
+		fMaxX = (std::max)(fMaxX, fX);
+		fMinY = (std::min)(fMinY, fY);
+		fMaxY = (std::max)(fMaxY, fY);
+		fMinDepth = (std::min)(fMinDepth, corner.z * fInverseW);
+	}
+
+	// Every pixel the rectangle touches, as subtiles: hidden only if each is farther than its farthest depth
+	int iMinSubtileX = (std::max)((int)floorf(fMinX), 0) / SubtileWidth;
+	int iMaxSubtileX = (std::min)((int)ceilf(fMaxX) - 1, m_iWidth - 1) / SubtileWidth;
+	int iMinTileY = (std::max)((int)floorf(fMinY), 0) / TileHeight;
+	int iMaxTileY = (std::min)((int)ceilf(fMaxY) - 1, m_iHeight - 1) / TileHeight;
+	if (iMinSubtileX > iMaxSubtileX || iMinTileY > iMaxTileY)
+	{
+		return true;
+	}
+	int iSubtilesWide = m_iTilesWide * (TileWidth / SubtileWidth);
+	for (int iTileY = iMinTileY; iTileY <= iMaxTileY; iTileY++)
+	{
+		const float* farDepths = &m_farDepths[iTileY * iSubtilesWide];
+		int iSubtileX = iMinSubtileX;
+#ifdef OCCLUSION_CULLER_SSE
+		__m128 vMinDepth = _mm_set1_ps(fMinDepth);
+		for (; iSubtileX + 4 <= iMaxSubtileX + 1; iSubtileX += 4)
+		{
+			if (_mm_movemask_ps(_mm_cmplt_ps(vMinDepth, _mm_loadu_ps(&farDepths[iSubtileX]))) != 0)
+			{
+				return true;
+			}
+		}
+#endif
+		for (; iSubtileX <= iMaxSubtileX; iSubtileX++)
+		{
+			if (fMinDepth < farDepths[iSubtileX])
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+#pragma endregion
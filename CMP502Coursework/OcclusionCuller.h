@@ -0,0 +1,86 @@
+//
+// OcclusionCuller.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Masked Software Occlusion Culling (Hasselgren et al., 2016)
+// Triangle Scan Conversion using 2D Homogeneous Coordinates (Olano and Greer, 1997)
+//
+
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <directxmath.h>
+#include <vector>
+#include "MeshFile.h"
+#include "Utils.h"
+#include "WorkerPool.h"
+
+using namespace DirectX;
+
+// Rasterizes low detail occluders into a small CPU depth buffer, then tests bounding boxes against it (no Direct3D dependency so it can run headless)
+// The buffer is split into 8x4 pixel subtiles, four to a 32x4 tile so that a tile fills an SSE register, and each subtile keeps a farthest depth
+// for all of its pixels, plus a nearer depth for the pixels in its coverage mask; once the mask fills, the nearer depth replaces the farthest
+class OcclusionCuller
+{
+public:
+	OcclusionCuller();
+
+	bool Initialize(int iWidth, int iHeight, int iThreadCount = 0); // The width is rounded up to whole tiles and the height to whole rows of them; iThreadCount 0 uses every core
+	void BeginFrame(const XMMATRIX& viewProjectionMatrix); // Clears the buffer and the occluders
+	void AddOccluder(const ModelData* vertices, const unsigned int* indices, int iIndexCount, const XMMATRIX& worldMatrix); // Drawn by RenderOccluders; indices may be nullptr for unindexed vertices, and both must outlive it
+	void RenderOccluders(); // Sets up batches of triangles, then rasterizes bands of tile rows, on the workers started by Initialize
+	bool IsInView(const XMFLOAT3& minimum, const XMFLOAT3& maximum, const XMMATRIX& worldMatrix); // false if the model space box is outside the view frustum
+	bool IsVisible(const XMFLOAT3& minimum, const XMFLOAT3& maximum, const XMMATRIX& worldMatrix); // false if the model space box is outside the view, or behind the occluders
+
+	int GetWidth();
+	int GetHeight();
+	int GetRasterizedTriangleCount(); // By the last RenderOccluders, after clipping and back face culling
+
+	static const int TileWidth = 32;
+	static const int TileHeight = 4;
+	static const int SubtileWidth = 8;
+
+private:
+	struct Occluder
+	{
+		const ModelData* vertices;
+		const unsigned int* indices;
+		int iIndexCount;
+		XMFLOAT4X4 worldViewProjectionMatrix;
+	};
+
+	struct ScreenTriangle // Set up for rasterizing: edge functions, positive inside, and a depth plane, in pixels
+	{
+		float edges[3][3]; // a, b and c of a * x + b * y + c for each edge
+		float depthPlane[3];
+		float fMaxDepth;
+		int iMinTileX;
+		int iMaxTileX;
+		int iMinTileY;
+		int iMaxTileY;
+	};
+
+	int m_iWidth;
+	int m_iHeight;
+	int m_iTilesWide;
+	int m_iTilesHigh;
+	WorkerPool m_workerPool;
+	XMFLOAT4X4 m_viewProjectionMatrix;
+	std::vector<Occluder> m_occluders;
+	std::vector<int> m_firstTriangles; // Of each occluder, counting those of every occluder before it
+	std::vector<std::vector<ScreenTriangle>> m_triangleBatches; // Set up in parallel, a batch per run of occluder triangles, and rasterized in order
+	int m_iRasterizedTriangleCount;
+
+	// Four floats (or masks) per tile, one for each subtile, so a tile loads as one SSE register
+	std::vector<float> m_farDepths; // Every pixel of the subtile is at most this deep
+	std::vector<float> m_maskDepths; // Pixels in the mask are at most this deep
+	std::vector<unsigned int> m_masks; // Bit y * 8 + x for each pixel of the subtile
+
+	void SetUpTriangles(int iBatch, int iFirstTriangle, int iEndTriangle);
+	void ClipTriangle(const XMVECTOR* clipPositions, std::vector<ScreenTriangle>& triangles); // Against the near plane and a guard band around the view
+	void AddTriangle(const XMVECTOR* clipPositions, std::vector<ScreenTriangle>& triangles); // Already clipped, so every w is positive
+	void RasterizeTriangle(const ScreenTriangle& triangle, int iMinTileY, int iMaxTileY); // Within the rows of tiles given
+};
+
+#endif
@@ -27,12 +27,22 @@ ParticleSystem::ParticleSystem()
 	m_iMaxParticles = 10000;
 	m_iCurrentParticleCount = 0;
 	m_fAccumulatedTime = 0.0f;
+	m_uniformDistribution = std::uniform_real_distribution<float>(0.0f, 1.0f);
+	m_pFluidSimulation = nullptr;
+
+	// Full quad until a trimmed polygon is set
+	m_billboardPolygon.push_back(XMFLOAT2(0.0f, 0.0f));
+	m_billboardPolygon.push_back(XMFLOAT2(1.0f, 0.0f));
+	m_billboardPolygon.push_back(XMFLOAT2(1.0f, 1.0f));
+	m_billboardPolygon.push_back(XMFLOAT2(0.0f, 1.0f));
+	m_iVerticesPerParticle = 6;
 }
 
 ParticleSystem::~ParticleSystem()
 {
 	SAFE_RELEASE(m_pVertexBuffer);
 	SAFE_RELEASE(m_pIndexBuffer);
+	SAFE_DELETE(m_pFluidSimulation);
 }
 
 bool ParticleSystem::Initialize(ID3D11Device* device)
@@ -46,7 +56,7 @@ bool ParticleSystem::Initialize(ID3D11Device* device)
 
 	// Initialize the vertex and index arrays
 
-	m_iVertexCount = m_iMaxParticles * 6;
+	m_iVertexCount = m_iMaxParticles * m_iVerticesPerParticle;
 	m_iIndexCount = m_iVertexCount;
 
 	m_vertices = new ParticleVertex[m_iVertexCount];
@@ -97,10 +107,84 @@ bool ParticleSystem::Initialize(ID3D11Device* device)
 	return true;
 }
 
+bool ParticleSystem::SetEmitterMesh(const ModelData* modelData, const unsigned int* indices, int iIndexCount, XMMATRIX transformMatrix, float fMinHeight)
+{
+	// Keep the triangles of the mesh (a triangle list) that lie entirely above the minimum height once transformed into particle system space
+
+	m_emitterTriangles.clear();
+	std::vector<float> areas;
+
+	for (int i = 0; i + 2 < iIndexCount; i += 3)
+	{
+		const ModelData& vertexA = modelData[indices ? indices[i] : i];
+		const ModelData& vertexB = modelData[indices ? indices[i + 1] : i + 1];
+		const ModelData& vertexC = modelData[indices ? indices[i + 2] : i + 2];
+		XMVECTOR vA = XMVector3TransformCoord(XMVectorSet(vertexA.x, vertexA.y, vertexA.z, 1.0f), transformMatrix);
+		XMVECTOR vB = XMVector3TransformCoord(XMVectorSet(vertexB.x, vertexB.y, vertexB.z, 1.0f), transformMatrix);
+		XMVECTOR vC = XMVector3TransformCoord(XMVectorSet(vertexC.x, vertexC.y, vertexC.z, 1.0f), transformMatrix);
+
+		if (XMVectorGetY(vA) < fMinHeight || XMVectorGetY(vB) < fMinHeight || XMVectorGetY(vC) < fMinHeight)
+		{
+			continue;
+		}
+
+		float fArea = 0.5f * XMVectorGetX(XMVector3Length(XMVector3Cross(vB - vA, vC - vA)));
+		if (fArea <= 0.0f)
+		{
+			continue;
+		}
+
+		XMFLOAT3 a, b, c;
+		XMStoreFloat3(&a, vA);
+		XMStoreFloat3(&b, vB);
+		XMStoreFloat3(&c, vC);
+		m_emitterTriangles.push_back(a);
+		m_emitterTriangles.push_back(b);
+		m_emitterTriangles.push_back(c);
+		areas.push_back(fArea);
+	}
+
+	// Build the alias table over the triangle areas so that emission is uniform over the surface
+	if (!m_emitterTable.Initialize(areas.data(), (int)areas.size()))
+	{
+		m_emitterTriangles.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool ParticleSystem::EnableFluidSimulation()
+{
+	// Replace the falling sprites with an SPH water simulation that shares the emitter and the render path
+	m_pFluidSimulation = new FluidSimulation();
+	if (!m_pFluidSimulation->Initialize(m_iMaxParticles))
+	{
+		SAFE_DELETE(m_pFluidSimulation);
+		return false;
+	}
+
+	m_fluidDrawOrder.reserve(m_iMaxParticles);
+
+	return true;
+}
+
 #pragma endregion
 
 #pragma region Setters/Getters
 
+void ParticleSystem::SetBillboardPolygon(const std::vector<XMFLOAT2>& polygon)
+{
+	if (polygon.size() < 3)
+	{
+		return;
+	}
+
+	// Drawn as a triangle fan around the first vertex, unrolled into a triangle list
+	m_billboardPolygon = polygon;
+	m_iVerticesPerParticle = 3 * ((int)polygon.size() - 2);
+}
+
 void ParticleSystem::SetTexture(ID3D11ShaderResourceView &texture)
 {
 	m_pTexture = &texture;
@@ -132,54 +216,40 @@ XMMATRIX ParticleSystem::GetWorldMatrix()
 
 bool ParticleSystem::Update(float fFrameTime, ID3D11DeviceContext* immediateContext)
 {
-	KillParticles();
-	EmitParticles(fFrameTime);
-	UpdateParticles(fFrameTime);
+	if (m_pFluidSimulation)
+	{
+		EmitFluidParticles(fFrameTime);
+		m_pFluidSimulation->Update(fFrameTime * 0.001f);
+		CopyFluidParticles();
+	}
+	else
+	{
+		KillParticles();
+		EmitParticles(fFrameTime);
+		UpdateParticles(fFrameTime);
+	}
 
-	// Build the vertex array from the particle array (each particle is a quad made out of two triangles)
+	// Build the vertex array from the particle array (each particle is the trimmed billboard polygon, which is a quad made out of two triangles by default)
 	memset(m_vertices, 0, sizeof(ParticleVertex) * m_iVertexCount);
 	int index = 0;
+	int iPolygonCount = (int)m_billboardPolygon.size();
 	for (int i = 0; i < m_iCurrentParticleCount; i++)
 	{
-		// Triangle 1
-
-		// Bottom left
-		m_vertices[index].position = XMFLOAT3(m_particles[i].x - m_fParticleSize, m_particles[i].y - m_fParticleSize, m_particles[i].z);
-		m_vertices[index].textureCoordinate = XMFLOAT2(0.0f, 1.0f);
-		m_vertices[index].color = XMFLOAT4(m_particles[i].red, m_particles[i].green, m_particles[i].blue, 1.0f);
-		index++;
-
-		// Top left
-		m_vertices[index].position = XMFLOAT3(m_particles[i].x - m_fParticleSize, m_particles[i].y + m_fParticleSize, m_particles[i].z);
-		m_vertices[index].textureCoordinate = XMFLOAT2(0.0f, 0.0f);
-		m_vertices[index].color = XMFLOAT4(m_particles[i].red, m_particles[i].green, m_particles[i].blue, 1.0f);
-		index++;
-
-		// Bottom right
-		m_vertices[index].position = XMFLOAT3(m_particles[i].x + m_fParticleSize, m_particles[i].y - m_fParticleSize, m_particles[i].z);
-		m_vertices[index].textureCoordinate = XMFLOAT2(1.0f, 1.0f);
-		m_vertices[index].color = XMFLOAT4(m_particles[i].red, m_particles[i].green, m_particles[i].blue, 1.0f);
-		index++;
-
-		// Triangle 2
-
-		// Bottom right
-		m_vertices[index].position = XMFLOAT3(m_particles[i].x + m_fParticleSize, m_particles[i].y - m_fParticleSize, m_particles[i].z);
-		m_vertices[index].textureCoordinate = XMFLOAT2(1.0f, 1.0f);
-		m_vertices[index].color = XMFLOAT4(m_particles[i].red, m_particles[i].green, m_particles[i].blue, 1.0f);
-		index++;
-
-		// Top left
-		m_vertices[index].position = XMFLOAT3(m_particles[i].x - m_fParticleSize, m_particles[i].y + m_fParticleSize, m_particles[i].z);
-		m_vertices[index].textureCoordinate = XMFLOAT2(0.0f, 0.0f);
-		m_vertices[index].color = XMFLOAT4(m_particles[i].red, m_particles[i].green, m_particles[i].blue, 1.0f);
-		index++;
-
-		// Top right
-		m_vertices[index].position = XMFLOAT3(m_particles[i].x + m_fParticleSize, m_particles[i].y + m_fParticleSize, m_particles[i].z);
-		m_vertices[index].textureCoordinate = XMFLOAT2(1.0f, 0.0f);
-		m_vertices[index].color = XMFLOAT4(m_particles[i].red, m_particles[i].green, m_particles[i].blue, 1.0f);
-		index++;
+		XMFLOAT4 color = XMFLOAT4(m_particles[i].red, m_particles[i].green, m_particles[i].blue, 1.0f);
+
+		for (int j = 1; j < iPolygonCount - 1; j++)
+		{
+			int polygonIndices[3] = { 0, j, j + 1 };
+			for (int k = 0; k < 3; k++)
+			{
+				// Texture coordinate (0, 0) is the top left corner of the quad and (1, 1) the bottom right
+				const XMFLOAT2& textureCoordinate = m_billboardPolygon[polygonIndices[k]];
+				m_vertices[index].position = XMFLOAT3(m_particles[i].x + (textureCoordinate.x * 2.0f - 1.0f) * m_fParticleSize, m_particles[i].y + (1.0f - textureCoordinate.y * 2.0f) * m_fParticleSize, m_particles[i].z);
+				m_vertices[index].textureCoordinate = textureCoordinate;
+				m_vertices[index].color = color;
+				index++;
+			}
+		}
 	}
 
 	// Update the dynamic vertex buffer with the new position of each particle
@@ -226,9 +296,22 @@ void ParticleSystem::EmitParticles(float fFrameTime)
 		m_iCurrentParticleCount++;
 
 		// Randomize particle properties
-		float x = (((float)rand() - (float)rand()) / RAND_MAX) * m_fParticleDeviationX;
-		float y = (((float)rand() - (float)rand()) / RAND_MAX) * m_fParticleDeviationY;
-		float z = (((float)rand() - (float)rand()) / RAND_MAX) * m_fParticleDeviationZ;
+		float x, y, z;
+		if (m_emitterTable.GetCount() > 0)
+		{
+			// Spawn on the surface of the emitter mesh
+			XMFLOAT3 position = SampleEmitterMesh();
+			x = position.x;
+			y = position.y;
+			z = position.z;
+		}
+		else
+		{
+			// Spawn inside the emitter box
+			x = (((float)rand() - (float)rand()) / RAND_MAX) * m_fParticleDeviationX;
+			y = (((float)rand() - (float)rand()) / RAND_MAX) * m_fParticleDeviationY;
+			z = (((float)rand() - (float)rand()) / RAND_MAX) * m_fParticleDeviationZ;
+		}
 		float red = 255.0f / 255.0f; // (((float)rand() - (float)rand()) / RAND_MAX) + 0.5f;
 		float green = 204.0f / 255.0f; // (((float)rand() - (float)rand()) / RAND_MAX) + 0.5f;
 		float blue = 248.0f / 255.0f; // (((float)rand() - (float)rand()) / RAND_MAX) + 0.5f;
@@ -279,6 +362,94 @@ void ParticleSystem::EmitParticles(float fFrameTime)
 	}
 }
 
+XMFLOAT3 ParticleSystem::SampleEmitterMesh()
+{
+	// Pick a triangle with probability proportional to its area (O(1) regardless of the triangle count)
+	int iTriangle = m_emitterTable.Sample(m_uniformDistribution(m_randomGenerator), m_uniformDistribution(m_randomGenerator));
+
+	XMVECTOR vA = XMLoadFloat3(&m_emitterTriangles[iTriangle * 3]);
+	XMVECTOR vB = XMLoadFloat3(&m_emitterTriangles[iTriangle * 3 + 1]);
+	XMVECTOR vC = XMLoadFloat3(&m_emitterTriangles[iTriangle * 3 + 2]);
+
+	// Pick a uniformly distributed point inside the triangle
+	float fSqrtU = sqrtf(m_uniformDistribution(m_randomGenerator));
+	float fV = m_uniformDistribution(m_randomGenerator);
+	XMVECTOR vPosition = vA * (1.0f - fSqrtU) + vB * (fSqrtU * (1.0f - fV)) + vC * (fSqrtU * fV);
+
+	XMFLOAT3 position;
+	XMStoreFloat3(&position, vPosition);
+	return position;
+}
+
+void ParticleSystem::EmitFluidParticles(float fFrameTime)
+{
+	// Emit as many particles as the elapsed time allows (the simulation needs a steady flow rather than one per frame)
+	m_fAccumulatedTime += fFrameTime;
+	float fEmitInterval = 1000.0f / m_fParticlesPerSecond;
+
+	while (m_fAccumulatedTime > fEmitInterval)
+	{
+		m_fAccumulatedTime -= fEmitInterval;
+
+		XMFLOAT3 position;
+		if (m_emitterTable.GetCount() > 0)
+		{
+			position = SampleEmitterMesh();
+		}
+		else
+		{
+			position.x = (((float)rand() - (float)rand()) / RAND_MAX) * m_fParticleDeviationX;
+			position.y = (((float)rand() - (float)rand()) / RAND_MAX) * m_fParticleDeviationY;
+			position.z = (((float)rand() - (float)rand()) / RAND_MAX) * m_fParticleDeviationZ;
+		}
+
+		float fVelocity = m_fParticleVelocity + (((float)rand() - (float)rand()) / RAND_MAX) * m_fParticleVelocityVariation;
+		if (!m_pFluidSimulation->EmitParticle(position, XMFLOAT3(0.0f, -fVelocity, 0.0f)))
+		{
+			m_fAccumulatedTime = 0.0f;
+			break;
+		}
+	}
+}
+
+void ParticleSystem::CopyFluidParticles()
+{
+	// Feed the simulated positions to the particle array, sorted back to front along Z for blending
+
+	int iCount = m_pFluidSimulation->GetParticleCount();
+	if (iCount > m_iMaxParticles - 1)
+	{
+		iCount = m_iMaxParticles - 1;
+	}
+
+	const XMFLOAT4* positions = m_pFluidSimulation->GetPositions();
+
+	m_fluidDrawOrder.resize(iCount);
+	for (int i = 0; i < iCount; i++)
+	{
+		m_fluidDrawOrder[i] = i;
+	}
+	std::sort(m_fluidDrawOrder.begin(), m_fluidDrawOrder.end(), [positions](int a, int b) { return positions[a].z > positions[b].z; });
+
+	for (int i = 0; i < iCount; i++)
+	{
+		const XMFLOAT4& position = positions[m_fluidDrawOrder[i]];
+		m_particles[i].x = position.x;
+		m_particles[i].y = position.y;
+		m_particles[i].z = position.z;
+		m_particles[i].red = 255.0f / 255.0f;
+		m_particles[i].green = 204.0f / 255.0f;
+		m_particles[i].blue = 248.0f / 255.0f;
+		m_particles[i].isActive = true;
+	}
+	for (int i = iCount; i < m_iCurrentParticleCount; i++)
+	{
+		m_particles[i].isActive = false;
+	}
+
+	m_iCurrentParticleCount = iCount;
+}
+
 void ParticleSystem::UpdateParticles(float fFrameTime)
 {
 	// Move particles downwards each frame
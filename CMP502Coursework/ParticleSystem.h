@@ -11,6 +11,12 @@
 
 #include <d3d11.h>
 #include <directxmath.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "AliasTable.h"
+#include "FluidSimulation.h"
+#include "Model.h"
 #include "Utils.h"
 
 using namespace DirectX;
@@ -39,6 +45,9 @@ public:
 	bool Initialize(ID3D11Device* device);
 	bool Update(float fFrameTime, ID3D11DeviceContext* immediateContext);
 	void Render(ID3D11DeviceContext* immediateContext);
+	bool SetEmitterMesh(const ModelData* modelData, const unsigned int* indices, int iIndexCount, XMMATRIX transformMatrix, float fMinHeight); // indices may be nullptr for an unindexed triangle list
+	bool EnableFluidSimulation();
+	void SetBillboardPolygon(const std::vector<XMFLOAT2>& polygon); // Must be called before Initialize
 
 	void SetTexture(ID3D11ShaderResourceView &texture);
 	ID3D11ShaderResourceView** GetTexture();
@@ -51,6 +60,8 @@ private:
 	ID3D11Buffer* m_pVertexBuffer;
 	ParticleVertex* m_vertices;
 	int m_iVertexCount;
+	std::vector<XMFLOAT2> m_billboardPolygon; // Convex outline of the visible part of the texture, in texture coordinates
+	int m_iVerticesPerParticle;
 	ID3D11Buffer* m_pIndexBuffer;
 	int m_iIndexCount;
 	Particle* m_particles;
@@ -65,8 +76,17 @@ private:
 	int m_iMaxParticles;
 	int m_iCurrentParticleCount;
 	float m_fAccumulatedTime;
+	std::vector<XMFLOAT3> m_emitterTriangles; // Three vertices per triangle in particle system space
+	AliasTable m_emitterTable;
+	std::mt19937 m_randomGenerator;
+	std::uniform_real_distribution<float> m_uniformDistribution;
+	FluidSimulation* m_pFluidSimulation; // Optional; when set, particle positions come from the water simulation
+	std::vector<int> m_fluidDrawOrder;
 
 	void EmitParticles(float fFrameTime);
+	XMFLOAT3 SampleEmitterMesh();
+	void EmitFluidParticles(float fFrameTime);
+	void CopyFluidParticles();
 	void UpdateParticles(float fFrameTime);
 	void KillParticles();
 };
@@ -4,6 +4,32 @@
 //
 
 #include "ResourceManager.h"
+#include <chrono>
+
+namespace
+{
+	const float LodPixelError = 1.0f; // Most error, in pixels, a level of detail may show
+	const float LodHysteresis = 0.6f; // A coarser level is only picked once its error is this far under the limit, so models near the threshold don't flicker between levels
+	const int OcclusionBufferWidth = 320; // Pixels of the occlusion culler's depth buffer, stretched over the view
+	const int OcclusionBufferHeight = 180;
+	const float GardenMinX = -14.0f; // Ground the plants are scattered over, inside the hedges
+	const float GardenMinZ = -19.0f;
+	const float GardenMaxX = 14.0f;
+	const float GardenMaxZ = 9.0f;
+	const int DensityMapSize = 113; // Samples along each side of the garden's density maps, a quarter unit apart
+	const float VegetationStreamRadius = 30.0f; // Scattered plants are generated in chunks within this distance of the camera
+	const int LupineCapacity = 1024; // Most scattered instances of each plant drawn at once, from the nearest chunks in view
+	const int LavenderCapacity = 4096;
+	const float TerrainSize = 2048.0f; // World units along each side of the terrain, centered on the origin
+	const int TerrainLevelCount = 8; // The finest chunks are 16 units wide, half a unit between vertices
+	const int TerrainChunkCapacity = 512; // Chunks resident at once (about 18 MB of vertices), beyond the 400 or so the camera wants at most
+	const float TerrainHeightScale = 60.0f;
+	const float TerrainFeatureSize = 300.0f;
+	const float TerrainFlatBorder = 4.0f; // Ground kept flat around the garden, beneath the hedges
+	const float TerrainFlatMargin = 40.0f; // Distance over which the hills rise from the flat ground
+	const float TerrainLodRange = 2.0f; // Chunks are split while the camera is within two of their widths
+	const float TerrainTextureScale = 1.0f / 28.0f; // The grass repeats every 28 units, as it did on the flat ground the terrain replaced
+}
 
 #pragma region Init
 
@@ -11,26 +37,91 @@ ResourceManager::ResourceManager(ID3D11Device &device, ID3D11DeviceContext &imme
 {
 	m_pDevice = &device;
 	m_pImmediateContext = &immediateContext;
+	m_pArchive = nullptr;
+	m_pFileReader = nullptr;
+	m_pTextureStreamer = nullptr;
+	m_pInstanceRing = nullptr;
+	m_pOcclusionCuller = nullptr;
+	m_bOcclusionCulling = false;
+	m_pSkyDome = nullptr;
+	m_pSkyPlane = nullptr;
+	m_pTerrain = nullptr;
 }
 
 ResourceManager::~ResourceManager()
 {
+	SAFE_DELETE(m_pFileReader); // Waits for the models still being parsed
 	for (auto& texture : m_textures)
 	{
 		SAFE_RELEASE(texture);
 	}
+	SAFE_DELETE(m_pTextureStreamer);
+	SAFE_DELETE(m_pArchive); // After the streamer, whose textures may point into it
+	for (auto& impostor : m_impostors)
+	{
+		SAFE_DELETE(impostor);
+	}
+	for (auto& scatter : m_scatters)
+	{
+		SAFE_DELETE(scatter);
+	}
 	for (auto& model : m_models)
 	{
 		SAFE_DELETE(model);
 	}
+	SAFE_DELETE(m_pInstanceRing);
+	SAFE_DELETE(m_pOcclusionCuller);
 	SAFE_DELETE(m_pSkyDome);
 	SAFE_DELETE(m_pSkyPlane);
+	SAFE_DELETE(m_pTerrain); // Waits for the chunks being generated
 }
 
-bool ResourceManager::LoadResources()
+bool ResourceManager::LoadResources(QualityLevel quality, bool bOcclusionCulling)
 {
 	// Loading of resources should be in the same order as the enum
 
+	// Read resources from the packed archive when there is one (built by running with -pack)
+	m_pArchive = new AssetArchive();
+	if (m_pArchive->Open("Resources.pak"))
+	{
+		Utils::Log("Loading resources from Resources.pak (" + std::to_string(m_pArchive->GetEntryCount()) + " entries)");
+	}
+	else
+	{
+		SAFE_DELETE(m_pArchive);
+	}
+
+	ReadModels();
+
+	// Model textures start with only their smallest levels and stream in the rest as they are needed
+	size_t textureBudget = (quality == LowQuality) ? 16 : (quality == MediumQuality) ? 32 : 64;
+	m_pTextureStreamer = new TextureStreamer();
+	if (!m_pTextureStreamer->Initialize(m_pDevice, m_pImmediateContext, textureBudget * 1024 * 1024))
+	{
+		MessageBox(0, "Failed to initialize texture streamer.", "", 0);
+		return false;
+	}
+
+	// Instances that move are copied into their buffers through a ring of upload memory
+	m_pInstanceRing = new UploadRing();
+	if (!m_pInstanceRing->Initialize(m_pDevice, 8 * 1024 * 1024))
+	{
+		MessageBox(0, "Failed to initialize instance upload ring.", "", 0);
+		return false;
+	}
+
+	// Instances hidden behind the occluders are culled against a small depth buffer they are drawn into on the CPU
+	m_bOcclusionCulling = bOcclusionCulling;
+	if (m_bOcclusionCulling)
+	{
+		m_pOcclusionCuller = new OcclusionCuller();
+		if (!m_pOcclusionCuller->Initialize(OcclusionBufferWidth, OcclusionBufferHeight))
+		{
+			MessageBox(0, "Failed to initialize occlusion culler.", "", 0);
+			return false;
+		}
+	}
+
 	// Statue
 
 	HRESULT result = LoadTexture(TextureResource::StatueTexture);
@@ -46,7 +137,7 @@ bool ResourceManager::LoadResources()
 		return false;
 	}
 
-	m_models[ModelResource::StatueModel]->SetTexture(*m_textures[TextureResource::StatueTexture]);
+	SetModelTexture(ModelResource::StatueModel, TextureResource::StatueTexture);
 
 	// Lion
 
@@ -63,7 +154,7 @@ bool ResourceManager::LoadResources()
 		return false;
 	}
 
-	m_models[ModelResource::LionModel]->SetTexture(*m_textures[TextureResource::LionTexture]);*/
+	SetModelTexture(ModelResource::LionModel, TextureResource::LionTexture);*/
 
 	// Stone (pillar & fountain)
 
@@ -80,7 +171,7 @@ bool ResourceManager::LoadResources()
 		return false;
 	}
 
-	m_models[ModelResource::VaseModel]->SetTexture(*m_textures[TextureResource::StoneTexture]);*/
+	SetModelTexture(ModelResource::VaseModel, TextureResource::StoneTexture);*/
 
 	if (!LoadModel(ModelResource::PillarModel))
 	{
@@ -88,7 +179,7 @@ bool ResourceManager::LoadResources()
 		return false;
 	}
 
-	m_models[ModelResource::PillarModel]->SetTexture(*m_textures[TextureResource::StoneTexture]);
+	SetModelTexture(ModelResource::PillarModel, TextureResource::StoneTexture);
 
 	if (!LoadModel(ModelResource::FountainModel))
 	{
@@ -96,7 +187,7 @@ bool ResourceManager::LoadResources()
 		return false;
 	}
 
-	m_models[ModelResource::FountainModel]->SetTexture(*m_textures[TextureResource::StoneTexture]);
+	SetModelTexture(ModelResource::FountainModel, TextureResource::StoneTexture);
 
 	// Lupine
 
@@ -113,7 +204,7 @@ bool ResourceManager::LoadResources()
 		return false;
 	}
 
-	m_models[ModelResource::LupineModel]->SetTexture(*m_textures[TextureResource::LupineTexture]);
+	SetModelTexture(ModelResource::LupineModel, TextureResource::LupineTexture);
 
 	// Lavender
 
@@ -130,25 +221,17 @@ bool ResourceManager::LoadResources()
 		return false;
 	}
 
-	m_models[ModelResource::LavenderModel]->SetTexture(*m_textures[TextureResource::LavenderTexture]);
+	SetModelTexture(ModelResource::LavenderModel, TextureResource::LavenderTexture);
 
-	// Ground
+	// Terrain
 
-	result = LoadTexture(TextureResource::GroundTexture);
+	result = LoadTexture(TextureResource::TerrainTexture);
 	if (FAILED(result))
 	{
-		Utils::ShowError("Failed to load ground texture.", result);
-		return false;
-	}
-
-	if (!LoadModel(ModelResource::GroundModel))
-	{
-		MessageBox(0, "Failed to load ground model.", "", 0);
+		Utils::ShowError("Failed to load terrain texture.", result);
 		return false;
 	}
 
-	m_models[ModelResource::GroundModel]->SetTexture(*m_textures[TextureResource::GroundTexture]);
-
 	// Hedge
 
 	result = LoadTexture(TextureResource::HedgeTexture);
@@ -164,15 +247,8 @@ bool ResourceManager::LoadResources()
 		return false;
 	}
 
-	m_models[ModelResource::HedgeModel]->SetTexture(*m_textures[TextureResource::HedgeTexture]);
-	m_models[ModelResource::HedgeModel]->SetLightDirection(-0.5f, -0.8f, 0.5f);
-
-	Model *hedgeModel2 = new Model();
-	*hedgeModel2 = *m_models[ModelResource::HedgeModel];
-	m_models.push_back(hedgeModel2);
-
-	m_models[ModelResource::HedgeModel2]->SetTexture(*m_textures[TextureResource::HedgeTexture]);
-	m_models[ModelResource::HedgeModel2]->SetLightDirection(0.5f, -0.8f, 0.5f);
+	SetModelTexture(ModelResource::HedgeModel, TextureResource::HedgeTexture);
+	m_models[ModelResource::HedgeModel]->SetLightDirection(-0.5f, -0.8f, 0.5f); // The hedge facing the other way sets its own
 
 	// Balustrade
 
@@ -182,15 +258,8 @@ bool ResourceManager::LoadResources()
 		return false;
 	}
 
-	m_models[ModelResource::BalustradeModel]->SetTexture(*m_textures[TextureResource::StoneTexture]);
-	m_models[ModelResource::BalustradeModel]->SetLightDirection(-0.3f, -0.8f, 0.5f);
-
-	Model *balustradeModel2 = new Model();
-	*balustradeModel2 = *m_models[ModelResource::BalustradeModel];
-	m_models.push_back(balustradeModel2);
-
-	m_models[ModelResource::BalustradeModel2]->SetTexture(*m_textures[TextureResource::StoneTexture]);
-	m_models[ModelResource::BalustradeModel2]->SetLightDirection(0.3f, -0.8f, 0.5f);
+	SetModelTexture(ModelResource::BalustradeModel, TextureResource::StoneTexture);
+	m_models[ModelResource::BalustradeModel]->SetLightDirection(-0.3f, -0.8f, 0.5f); // The balustrades facing the other way set their own
 
 	// Particle
 
@@ -201,14 +270,15 @@ bool ResourceManager::LoadResources()
 		return false;
 	}
 
-	// Sky Dome (not in models array)
-
-	if (!LoadModel(ModelResource::SkyDomeModel))
+	if (!TrimParticleTexture())
 	{
-		MessageBox(0, "Failed to load sky dome model.", "", 0);
+		MessageBox(0, "Failed to trim particle texture.", "", 0);
 		return false;
 	}
 
+	// Sky Dome (not in models array, generated when the buffers are initialized)
+
+	m_pSkyDome = new SkyDome();
 	m_pSkyDome->SetTopColor(COLOR_XMF4(255.0f, 204.0f, 248.0f, 1.0f)); // Light pink
 	m_pSkyDome->SetCenterColor(COLOR_XMF4(200.0f, 180.0f, 180.0f, 1.0f)); // Light gray
 	m_pSkyDome->SetBottomColor(COLOR_XMF4(255.0f, 193.0f, 127.0f, 1.0f)); // Light orange
@@ -233,6 +303,24 @@ bool ResourceManager::LoadResources()
 	m_pSkyPlane->SetTexture1(*m_textures[TextureResource::CloudTexture1]);
 	m_pSkyPlane->SetTexture2(*m_textures[TextureResource::CloudTexture2]);
 
+	// Pack model textures into arrays (before the instance buffers take their slices)
+
+	if (!PackTextures())
+	{
+		MessageBox(0, "Failed to pack model textures.", "", 0);
+		return false;
+	}
+
+	// Transform models (before their buffers are initialized, which places models with several nodes)
+
+	/*XMMATRIX vaseTranslationMatrix = XMMatrixTranslation(-5.0f, 0.0f, 0.0f);
+	XMMATRIX vaseScalingMatrix = XMMatrixScaling(0.75f, 0.75f, 0.75f);
+	m_models[ModelResource::VaseModel]->TransformWorldMatrix(vaseTranslationMatrix, XMMatrixIdentity(), vaseScalingMatrix);*/
+
+	XMMATRIX fountainTranslationMatrix = XMMatrixTranslation(3.0f, 125.0f, -375.0f);
+	XMMATRIX fountainScalingMatrix = XMMatrixScaling(0.02f, 0.02f, 0.02f);
+	m_models[ModelResource::FountainModel]->TransformWorldMatrix(fountainTranslationMatrix, XMMatrixIdentity(), fountainScalingMatrix);
+
 	// Initialize the vertex, index, and instance buffers
 
 	if (!m_models[ModelResource::StatueModel]->InitializeBuffers(m_pDevice, 1))
@@ -256,7 +344,7 @@ bool ResourceManager::LoadResources()
 	int iPillarsCount = 8;
 	XMMATRIX pillarRotationMatrix = XMMatrixRotationRollPitchYaw(XM_PI * 0.5f, XM_PI * 0.5f, XM_PI * 0.5f);
 	XMMATRIX pillarScalingMatrix = XMMatrixScaling(12.0f, 12.0f, 12.0f);
-	Instance* pillarInstances = new Instance[iPillarsCount];
+	std::vector<Instance> pillarInstances(iPillarsCount);
 	pillarInstances[0].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-0.8f, -0.8f, 0.0f) * pillarRotationMatrix * pillarScalingMatrix);
 	pillarInstances[1].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-0.75f, -0.4f, 0.0f) * pillarRotationMatrix * pillarScalingMatrix);
 	pillarInstances[2].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-0.55f, -0.07f, 0.0f) * pillarRotationMatrix * pillarScalingMatrix);
@@ -265,7 +353,7 @@ bool ResourceManager::LoadResources()
 	pillarInstances[5].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(0.55f, -0.07f, 0.0f) * pillarRotationMatrix * pillarScalingMatrix);
 	pillarInstances[6].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(0.75f, -0.4f, 0.0f) * pillarRotationMatrix * pillarScalingMatrix);
 	pillarInstances[7].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(0.8f, -0.8f, 0.0f) * pillarRotationMatrix * pillarScalingMatrix);
-	if (!m_models[ModelResource::PillarModel]->InitializeBuffers(m_pDevice, iPillarsCount, pillarInstances))
+	if (!m_models[ModelResource::PillarModel]->InitializeBuffers(m_pDevice, iPillarsCount, pillarInstances.data()))
 	{
 		MessageBox(0, "Failed to initialize pillar vertex and index buffers.", "", 0);
 		return false;
@@ -277,315 +365,708 @@ bool ResourceManager::LoadResources()
 		return false;
 	}
 
-	int iLupineCount = 16;
-	XMMATRIX lupineScalingMatrix = XMMatrixScaling(0.017f, 0.017f, 0.017f);
-	Instance* lupineInstances = new Instance[iLupineCount];
-	lupineInstances[0].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-155.0f, 0.0f, -330.0f) * lupineScalingMatrix);
-	lupineInstances[1].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-100.0f, 0.0f, -280.0f) * lupineScalingMatrix);
-	lupineInstances[2].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-35.0f, 0.0f, -255.0f) * lupineScalingMatrix);
-	lupineInstances[3].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(35.0f, 0.0f, -255.0f) * lupineScalingMatrix);
-	lupineInstances[4].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(100.0f, 0.0f, -280.0f) * lupineScalingMatrix);
-	lupineInstances[5].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(155.0f, 0.0f, -330.0f) * lupineScalingMatrix);
-	lupineInstances[6].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-155.0f, 0.0f, -555.0f) * lupineScalingMatrix);
-	lupineInstances[7].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-100.0f, 0.0f, -605.0f) * lupineScalingMatrix);
-	lupineInstances[8].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-35.0f, 0.0f, -630.0f) * lupineScalingMatrix);
-	lupineInstances[9].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(35.0f, 0.0f, -630.0f) * lupineScalingMatrix);
-	lupineInstances[10].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(100.0f, 0.0f, -605.0f) * lupineScalingMatrix);
-	lupineInstances[11].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(155.0f, 0.0f, -555.0f) * lupineScalingMatrix);
-	lupineInstances[12].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-180.0f, 0.0f, -405.0f) * lupineScalingMatrix);
-	lupineInstances[13].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-180.0f, 0.0f, -485.0f) * lupineScalingMatrix);
-	lupineInstances[14].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(180.0f, 0.0f, -405.0f) * lupineScalingMatrix);
-	lupineInstances[15].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(180.0f, 0.0f, -485.0f) * lupineScalingMatrix);
-	if (!m_models[ModelResource::LupineModel]->InitializeBuffers(m_pDevice, iLupineCount, lupineInstances))
+	// Lupines ring the fountain, and lavender grows in beds beside the paths, scattered over density maps of the garden in chunks streamed around the camera
+	DensityMap lupineDensity;
+	lupineDensity.Initialize(GardenMinX, GardenMinZ, GardenMaxX, GardenMaxZ, DensityMapSize, DensityMapSize);
+	lupineDensity.PaintRing(0.06f, -7.5f, 2.8f, 3.6f, 0.4f, 1.0f);
+	ScatterSettings lupineSettings = {};
+	lupineSettings.fMinDistance = 0.9f;
+	lupineSettings.fMinScale = 0.85f;
+	lupineSettings.fMaxScale = 1.15f;
+	lupineSettings.fHeight = 0.0f;
+	XMStoreFloat4x4(&lupineSettings.modelMatrix, XMMatrixScaling(0.017f, 0.017f, 0.017f));
+	lupineSettings.uiSeed = 1;
+	if (!LoadScatter(ModelResource::LupineModel, lupineSettings, lupineDensity, LupineCapacity))
 	{
 		MessageBox(0, "Failed to initialize lupine vertex and index buffers.", "", 0);
 		return false;
 	}
 
-	int iLavenderCount = 27;
-	XMMATRIX lavenderScalingMatrix = XMMatrixScaling(0.005f, 0.006f, 0.006f);
-	Instance* lavenderInstances = new Instance[iLavenderCount];
-	lavenderInstances[0].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(30.0f, -250.0f, 0.0f) * lavenderScalingMatrix);
-	lavenderInstances[1].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-100.0f, -250.0f, 0.0f) * lavenderScalingMatrix);
-	lavenderInstances[2].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(100.0f, -250.0f, 0.0f) * lavenderScalingMatrix);
-	lavenderInstances[3].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-500.0f, -250.0f, 400.0f) * lavenderScalingMatrix);
-	lavenderInstances[4].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-600.0f, -250.0f, 500.0f) * lavenderScalingMatrix);
-	lavenderInstances[5].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-700.0f, -250.0f, 500.0f) * lavenderScalingMatrix);
-	lavenderInstances[6].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(500.0f, -250.0f, 400.0f) * lavenderScalingMatrix);
-	lavenderInstances[7].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(600.0f, -250.0f, 500.0f) * lavenderScalingMatrix);
-	lavenderInstances[8].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(700.0f, -250.0f, 500.0f) * lavenderScalingMatrix);
-	lavenderInstances[9].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-1250.0f, -250.0f, -150.0f) * lavenderScalingMatrix);
-	lavenderInstances[10].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-1350.0f, -250.0f, -50.0f) * lavenderScalingMatrix);
-	lavenderInstances[11].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-1450.0f, -250.0f, -50.0f) * lavenderScalingMatrix);
-	lavenderInstances[12].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(1250.0f, -250.0f, -150.0f) * lavenderScalingMatrix);
-	lavenderInstances[13].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(1350.0f, -250.0f, -50.0f) * lavenderScalingMatrix);
-	lavenderInstances[14].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(1450.0f, -250.0f, -50.0f) * lavenderScalingMatrix);
-	lavenderInstances[15].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-1750.0f, -250.0f, -850.0f) * lavenderScalingMatrix);
-	lavenderInstances[16].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-1850.0f, -250.0f, -750.0f) * lavenderScalingMatrix);
-	lavenderInstances[17].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-1950.0f, -250.0f, -750.0f) * lavenderScalingMatrix);
-	lavenderInstances[18].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(1750.0f, -250.0f, -850.0f) * lavenderScalingMatrix);
-	lavenderInstances[19].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(1850.0f, -250.0f, -750.0f) * lavenderScalingMatrix);
-	lavenderInstances[20].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(1950.0f, -250.0f, -750.0f) * lavenderScalingMatrix);
-	lavenderInstances[21].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-1850.0f, -250.0f, -1650.0f) * lavenderScalingMatrix);
-	lavenderInstances[22].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-1950.0f, -250.0f, -1550.0f) * lavenderScalingMatrix);
-	lavenderInstances[23].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-2050.0f, -250.0f, -1550.0f) * lavenderScalingMatrix);
-	lavenderInstances[24].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(1850.0f, -250.0f, -1650.0f) * lavenderScalingMatrix);
-	lavenderInstances[25].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(1950.0f, -250.0f, -1550.0f) * lavenderScalingMatrix);
-	lavenderInstances[26].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(2050.0f, -250.0f, -1550.0f) * lavenderScalingMatrix);
-	if (!m_models[ModelResource::LavenderModel]->InitializeBuffers(m_pDevice, iLavenderCount, lavenderInstances))
+	if (!LoadImpostor(ModelResource::LupineModel, TextureResource::LupineTexture))
+	{
+		MessageBox(0, "Failed to load lupine impostor.", "", 0);
+		return false;
+	}
+
+	DensityMap lavenderDensity;
+	lavenderDensity.Initialize(GardenMinX, GardenMinZ, GardenMaxX, GardenMaxZ, DensityMapSize, DensityMapSize);
+	const XMFLOAT2 lavenderBeds[] = { XMFLOAT2(0.0f, 0.0f), XMFLOAT2(3.0f, 2.8f), XMFLOAT2(6.75f, -0.5f), XMFLOAT2(9.25f, -4.7f), XMFLOAT2(9.75f, -9.5f) };
+	for (const auto& bed : lavenderBeds)
+	{
+		// Mirrored across the garden
+		lavenderDensity.PaintDisc(bed.x, bed.y, 0.7f, 0.3f, 1.0f);
+		lavenderDensity.PaintDisc(-bed.x, bed.y, 0.7f, 0.3f, 1.0f);
+	}
+	ScatterSettings lavenderSettings = {};
+	lavenderSettings.fMinDistance = 0.45f;
+	lavenderSettings.fMinScale = 0.85f;
+	lavenderSettings.fMaxScale = 1.15f;
+	lavenderSettings.fHeight = 0.0f;
+	XMStoreFloat4x4(&lavenderSettings.modelMatrix, XMMatrixTranslation(0.0f, -250.0f, 0.0f) * XMMatrixScaling(0.005f, 0.006f, 0.006f));
+	lavenderSettings.uiSeed = 2;
+	if (!LoadScatter(ModelResource::LavenderModel, lavenderSettings, lavenderDensity, LavenderCapacity))
 	{
 		MessageBox(0, "Failed to initialize lavender vertex and index buffers.", "", 0);
 		return false;
 	}
 
-	if (!m_models[ModelResource::GroundModel]->InitializeBuffers(m_pDevice, 1))
+	if (!LoadImpostor(ModelResource::LavenderModel, TextureResource::LavenderTexture))
 	{
-		MessageBox(0, "Failed to initialize ground vertex and index buffers.", "", 0);
+		MessageBox(0, "Failed to load lavender impostor.", "", 0);
 		return false;
 	}
 
-	int iHedgesCount = 2;
-	XMMATRIX hedgeScalingMatrix = XMMatrixScaling(0.7f, 0.7f, 0.7f);
-	Instance* hedgeInstances = new Instance[iHedgesCount];
-	hedgeInstances[0].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-5.0f, -20.0f, 20.0f) * XMMatrixRotationRollPitchYaw(XM_PI * -0.5f, XM_PI * -0.5f, 0.0f) * hedgeScalingMatrix);
-	hedgeInstances[1].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(0.0f, -15.0f, 20.0f) * XMMatrixRotationRollPitchYaw(XM_PI * -0.5f, 0.0f, 0.0f) * hedgeScalingMatrix);
-	if (!m_models[ModelResource::HedgeModel]->InitializeBuffers(m_pDevice, iHedgesCount, hedgeInstances))
+	// The terrain is flat under the garden, and rises into hills beyond it
+	TerrainSettings terrainSettings = {};
+	terrainSettings.fSize = TerrainSize;
+	terrainSettings.iLevelCount = TerrainLevelCount;
+	terrainSettings.fHeightScale = TerrainHeightScale;
+	terrainSettings.fFeatureSize = TerrainFeatureSize;
+	terrainSettings.flatMinimum = XMFLOAT2(GardenMinX - TerrainFlatBorder, GardenMinZ - TerrainFlatBorder);
+	terrainSettings.flatMaximum = XMFLOAT2(GardenMaxX + TerrainFlatBorder, GardenMaxZ + TerrainFlatBorder);
+	terrainSettings.fFlatMargin = TerrainFlatMargin;
+	terrainSettings.fLodRange = TerrainLodRange;
+	terrainSettings.fTextureScale = TerrainTextureScale;
+	terrainSettings.uiSeed = 1;
+	m_pTerrain = new Terrain();
+	XMFLOAT3 gardenCenter((GardenMinX + GardenMaxX) * 0.5f, 0.0f, (GardenMinZ + GardenMaxZ) * 0.5f);
+	if (!m_pTerrain->Initialize(m_pDevice, terrainSettings, gardenCenter, TerrainChunkCapacity))
 	{
-		MessageBox(0, "Failed to initialize hedge vertex and index buffers.", "", 0);
+		MessageBox(0, "Failed to initialize terrain.", "", 0);
 		return false;
 	}
+	m_pTerrain->SetTexture(*m_textures[TextureResource::TerrainTexture]);
+	m_pTerrain->SetTextureSlice(m_textureSlices[TextureResource::TerrainTexture]);
 
-	if (!m_models[ModelResource::HedgeModel2]->InitializeBuffers(m_pDevice, 1))
+	int iHedgesCount = 3;
+	XMMATRIX hedgeScalingMatrix = XMMatrixScaling(0.7f, 0.7f, 0.7f);
+	std::vector<Instance> hedgeInstances(iHedgesCount);
+	hedgeInstances[0].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-5.0f, -20.0f, 20.0f) * XMMatrixRotationRollPitchYaw(XM_PI * -0.5f, XM_PI * -0.5f, 0.0f) * hedgeScalingMatrix);
+	hedgeInstances[1].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(0.0f, -15.0f, 20.0f) * XMMatrixRotationRollPitchYaw(XM_PI * -0.5f, 0.0f, 0.0f) * hedgeScalingMatrix);
+	hedgeInstances[2].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(5.0f, -20.0f, 20.0f) * XMMatrixRotationRollPitchYaw(XM_PI * -0.5f, XM_PI * 0.5f, 0.0f) * hedgeScalingMatrix);
+	hedgeInstances[2].lightDirection = XMFLOAT3(0.5f, -0.8f, 0.5f);
+	if (!m_models[ModelResource::HedgeModel]->InitializeBuffers(m_pDevice, iHedgesCount, hedgeInstances.data()))
 	{
 		MessageBox(0, "Failed to initialize hedge vertex and index buffers.", "", 0);
 		return false;
 	}
 
-	int iBalustradesCount = 6;
+	int iBalustradesCount = 9;
 	XMMATRIX balustradeScalingMatrix = XMMatrixScaling(11.0f, 11.0f, 11.0f);
-	Instance* balustradeInstances = new Instance[iBalustradesCount];
+	std::vector<Instance> balustradeInstances(iBalustradesCount);
 	balustradeInstances[0].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-0.84f, -0.125f, 0.95f) * balustradeScalingMatrix);
 	balustradeInstances[1].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-0.03f, -0.125f, 0.95f) * balustradeScalingMatrix);
 	balustradeInstances[2].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(0.78f, -0.125f, 0.95f) * balustradeScalingMatrix);
 	balustradeInstances[3].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(0.45f, -0.125f, 1.273f) * XMMatrixRotationRollPitchYaw(0.0f, XM_PI * -0.5f, 0.0f) * balustradeScalingMatrix);
 	balustradeInstances[4].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-0.36f, -0.125f, 1.273f) * XMMatrixRotationRollPitchYaw(0.0f, XM_PI * -0.5f, 0.0f) * balustradeScalingMatrix);
 	balustradeInstances[5].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-1.17f, -0.125f, 1.273f) * XMMatrixRotationRollPitchYaw(0.0f, XM_PI * -0.5f, 0.0f) * balustradeScalingMatrix);
-	if (!m_models[ModelResource::BalustradeModel]->InitializeBuffers(m_pDevice, iBalustradesCount, balustradeInstances))
+	balustradeInstances[6].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-0.5f, -0.125f, 1.273f) * XMMatrixRotationRollPitchYaw(0.0f, XM_PI * 0.5f, 0.0f) * balustradeScalingMatrix);
+	balustradeInstances[7].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(0.31f, -0.125f, 1.273f) * XMMatrixRotationRollPitchYaw(0.0f, XM_PI * 0.5f, 0.0f) * balustradeScalingMatrix);
+	balustradeInstances[8].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(1.12f, -0.125f, 1.273f) * XMMatrixRotationRollPitchYaw(0.0f, XM_PI * 0.5f, 0.0f) * balustradeScalingMatrix);
+	for (int i = 6; i < iBalustradesCount; i++)
 	{
-		MessageBox(0, "Failed to initialize balustrade vertex and index buffers.", "", 0);
-		return false;
+		balustradeInstances[i].lightDirection = XMFLOAT3(0.3f, -0.8f, 0.5f);
 	}
-
-	int iBalustradesCount2 = 3;
-	Instance* balustradeInstances2 = new Instance[iBalustradesCount2];
-	balustradeInstances2[0].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(-0.5f, -0.125f, 1.273f) * XMMatrixRotationRollPitchYaw(0.0f, XM_PI * 0.5f, 0.0f) * balustradeScalingMatrix);
-	balustradeInstances2[1].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(0.31f, -0.125f, 1.273f) * XMMatrixRotationRollPitchYaw(0.0f, XM_PI * 0.5f, 0.0f) * balustradeScalingMatrix);
-	balustradeInstances2[2].worldMatrix = XMMatrixTranspose(XMMatrixTranslation(1.12f, -0.125f, 1.273f) * XMMatrixRotationRollPitchYaw(0.0f, XM_PI * 0.5f, 0.0f) * balustradeScalingMatrix);
-	if (!m_models[ModelResource::BalustradeModel2]->InitializeBuffers(m_pDevice, iBalustradesCount2, balustradeInstances2))
+	if (!m_models[ModelResource::BalustradeModel]->InitializeBuffers(m_pDevice, iBalustradesCount, balustradeInstances.data()))
 	{
 		MessageBox(0, "Failed to initialize balustrade vertex and index buffers.", "", 0);
 		return false;
 	}
 
-	if (!m_pSkyDome->InitializeBuffers(m_pDevice))
+	if (!m_pSkyDome->Initialize(m_pDevice, quality))
 	{
 		MessageBox(0, "Failed to initialize sky dome vertex and index buffers.", "", 0);
 		return false;
 	}
+	Utils::Log("Sky dome generated with " + std::to_string(m_pSkyDome->GetVertexCount()) + " vertices and " + std::to_string(m_pSkyDome->GetIndexCount()) + " indices");
 
-	if (!m_pSkyPlane->Initialize(m_pDevice))
+	int iSkyPlaneResolution = (quality == LowQuality) ? 32 : (quality == MediumQuality) ? 64 : 100;
+	if (!m_pSkyPlane->Initialize(m_pDevice, iSkyPlaneResolution))
 	{
 		MessageBox(0, "Failed to initialize sky plane.", "", 0);
 		return false;
 	}
 
-	// Transform models
-
-	/*XMMATRIX vaseTranslationMatrix = XMMatrixTranslation(-5.0f, 0.0f, 0.0f);
-	XMMATRIX vaseScalingMatrix = XMMatrixScaling(0.75f, 0.75f, 0.75f);
-	m_models[ModelResource::VaseModel]->TransformWorldMatrix(vaseTranslationMatrix, XMMatrixIdentity(), vaseScalingMatrix);*/
+	return true;
+}
 
-	XMMATRIX fountainTranslationMatrix = XMMatrixTranslation(3.0f, 125.0f, -375.0f);
-	XMMATRIX fountainScalingMatrix = XMMatrixScaling(0.02f, 0.02f, 0.02f);
-	m_models[ModelResource::FountainModel]->TransformWorldMatrix(fountainTranslationMatrix, XMMatrixIdentity(), fountainScalingMatrix);
+std::string ResourceManager::ResolveFilename(const char* filename)
+{
+	// Cooked resources come from the archive or the cooked directory (built with -cook); otherwise the sources are loaded, or parsed, as they are
+	std::string cookedFilename = AssetCooker::GetCookedFilename(filename);
+	return ResourceExists(cookedFilename) ? cookedFilename : filename;
+}
 
-	XMMATRIX groundTranslationMatrix = XMMatrixTranslation(0.0f, 0.0f, -5.0f);
-	XMMATRIX groundScalingMatrix = XMMatrixScaling(0.7f, 0.7f, 0.7f);
-	m_models[ModelResource::GroundModel]->TransformWorldMatrix(groundTranslationMatrix, XMMatrixIdentity(), groundScalingMatrix);
+bool ResourceManager::ResourceExists(const std::string& filename)
+{
+	return (m_pArchive && m_pArchive->Contains(filename.c_str())) || std::ifstream(filename).good();
+}
 
-	XMMATRIX hedgeTranslationMatrix = XMMatrixTranslation(5.0f, -20.0f, 20.0f);
-	XMMATRIX hedgeRotationMatrix = XMMatrixRotationRollPitchYaw(XM_PI * -0.5f, XM_PI * 0.5f, 0.0f);
-	m_models[ModelResource::HedgeModel2]->TransformWorldMatrix(hedgeTranslationMatrix, hedgeRotationMatrix, hedgeScalingMatrix);
+const unsigned char* ResourceManager::ReadResource(const char* filename, size_t* pSize, std::vector<unsigned char>& buffer)
+{
+	if (m_pArchive && m_pArchive->Contains(filename))
+	{
+		return m_pArchive->Load(filename, pSize, buffer);
+	}
 
-	return true;
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (file.fail())
+	{
+		return nullptr;
+	}
+	buffer.resize((size_t)file.tellg());
+	file.seekg(0);
+	file.read((char*)buffer.data(), buffer.size());
+	if (file.fail())
+	{
+		return nullptr;
+	}
+	*pSize = buffer.size();
+	return buffer.data();
 }
 
 HRESULT ResourceManager::LoadTexture(TextureResource resource)
 {
 	HRESULT result = S_OK;
 
+	const char* sourceFilename = GetTextureFilename(resource);
+	bool bStreamed = (resource != ParticleTexture && resource != CloudTexture1 && resource != CloudTexture2); // Model textures are streamed; sprites and the sky are always drawn at full size
+
+	// Cooked textures have a full mip chain and are block compressed; a source that hasn't been cooked is loaded as it is, and never rewritten
+	std::string resolvedFilename = ResolveFilename(sourceFilename);
+	const char* filename = resolvedFilename.c_str();
+	bool bArchived = m_pArchive && m_pArchive->Contains(filename);
+	if (resolvedFilename == sourceFilename)
+	{
+		Utils::Log(std::string(filename) + " isn't cooked, so it is loaded without the mipmaps and compression it may lack (run with -cook)");
+	}
+
 	// Create texture
-	ID3D11ShaderResourceView* texture;
+	ID3D11ShaderResourceView* texture = nullptr;
+	if (bStreamed)
+	{
+		// Streamed textures are created once every model texture is known, so that compatible ones can share an array
+		DDSFile file;
+		std::vector<unsigned char> buffer;
+		if (bArchived)
+		{
+			size_t size = 0;
+			const unsigned char* data = m_pArchive->Load(filename, &size, buffer);
+			result = data ? file.Parse(data, size) : E_FAIL;
+		}
+		else
+		{
+			result = file.Open(filename);
+		}
+		if (FAILED(result))
+		{
+			return result;
+		}
+
+		const DDSTextureInfo& info = file.GetInfo();
+		if (info.dimension != DDS_DIMENSION_TEXTURE2D || info.isCubeMap || info.arraySize != 1)
+		{
+			return E_FAIL;
+		}
+
+		m_pendingTextures.push_back({ resource, filename, info });
+	}
+	else if (bArchived)
+	{
+		std::vector<unsigned char> buffer;
+		size_t size = 0;
+		const unsigned char* data = m_pArchive->Load(filename, &size, buffer);
+		result = data ? CreateDDSTextureFromMemory(m_pDevice, m_pImmediateContext, data, size, nullptr, &texture) : E_FAIL;
+		if (FAILED(result))
+		{
+			return result;
+		}
+	}
+	else
+	{
+		std::string narrowFilename(filename);
+		std::wstring wideFilename(narrowFilename.begin(), narrowFilename.end());
+		result = CreateDDSTextureFromFile(m_pDevice, m_pImmediateContext, wideFilename.c_str(), nullptr, &texture, 0, nullptr);
+		if (FAILED(result))
+		{
+			return result;
+		}
+	}
+
+	// Store texture in array
+	m_textures.push_back(texture);
+	m_streamedTextures.push_back(-1);
+	m_textureSlices.push_back(0);
+
+	return result;
+}
+
+const char* ResourceManager::GetTextureFilename(TextureResource resource)
+{
 	switch (resource)
 	{
 	case StatueTexture:
-		result = CreateDDSTextureFromFile(m_pDevice, m_pImmediateContext, L"Resources/statue_d.dds", nullptr, &texture, 0, nullptr);
-		break;
+		return "Resources/statue_d.dds";
 	/*case LionTexture:
-		result = CreateDDSTextureFromFile(m_pDevice, m_pImmediateContext, L"Resources/lion.dds", nullptr, &texture, 0, nullptr);
-		break;*/
+		return "Resources/lion.dds";*/
 	case StoneTexture:
-		result = CreateDDSTextureFromFile(m_pDevice, m_pImmediateContext, L"Resources/stone.dds", nullptr, &texture, 0, nullptr);
-		break;
+		return "Resources/stone.dds";
 	case LupineTexture:
-		result = CreateDDSTextureFromFile(m_pDevice, m_pImmediateContext, L"Resources/lupine.dds", nullptr, &texture, 0, nullptr);
-		break;
+		return "Resources/lupine.dds";
 	case LavenderTexture:
-		result = CreateDDSTextureFromFile(m_pDevice, m_pImmediateContext, L"Resources/lavender.dds", nullptr, &texture, 0, nullptr);
-		break;
-	case GroundTexture:
-		result = CreateDDSTextureFromFile(m_pDevice, m_pImmediateContext, L"Resources/grass.dds", nullptr, &texture, 0, nullptr);
-		break;
+		return "Resources/lavender.dds";
+	case TerrainTexture:
+		return "Resources/grass.dds";
 	case HedgeTexture:
-		result = CreateDDSTextureFromFile(m_pDevice, m_pImmediateContext, L"Resources/hedge.dds", nullptr, &texture, 0, nullptr);
-		break;
+		return "Resources/hedge.dds";
 	case ParticleTexture:
-		result = CreateDDSTextureFromFile(m_pDevice, m_pImmediateContext, L"Resources/particle.dds", nullptr, &texture, 0, nullptr);
-		break;
+		return "Resources/particle.dds";
 	case CloudTexture1:
-		result = CreateDDSTextureFromFile(m_pDevice, m_pImmediateContext, L"Resources/cloud1.dds", nullptr, &texture, 0, nullptr);
-		break;
+		return "Resources/cloud1.dds";
 	case CloudTexture2:
-		result = CreateDDSTextureFromFile(m_pDevice, m_pImmediateContext, L"Resources/cloud2.dds", nullptr, &texture, 0, nullptr);
-		break;
+		return "Resources/cloud2.dds";
+	default:
+		return nullptr;
 	}
-	if (FAILED(result))
+}
+
+bool ResourceManager::FindTexture(const std::string& name, TextureResource* pResource)
+{
+	auto getStem = [](const std::string& filename)
 	{
-		return result;
+		size_t start = filename.find_last_of("/\\");
+		start = (start == std::string::npos) ? 0 : start + 1;
+		size_t end = filename.find_last_of('.');
+		std::string stem = filename.substr(start, (end == std::string::npos || end < start) ? std::string::npos : end - start);
+		std::transform(stem.begin(), stem.end(), stem.begin(), ::tolower);
+		return stem;
+	};
+
+	std::string stem = getStem(name);
+	for (int i = 0; i <= TextureResource::CloudTexture2; i++)
+	{
+		const char* filename = GetTextureFilename((TextureResource)i);
+		if (filename && getStem(filename) == stem)
+		{
+			*pResource = (TextureResource)i;
+			return true;
+		}
 	}
-
-	// Store texture in array
-	m_textures.push_back(texture);
-
-	return result;
+	return false;
 }
 
-bool ResourceManager::LoadModel(ModelResource resource)
+void ResourceManager::ReadModels()
 {
-	// Reference:
-	// RasterTek Tutorial 8: Loading Maya 2011 Models (http://www.rastertek.com/dx11tut08.html)
+	// Every model file is read at once, and each is parsed on a worker as soon as it arrives, while the textures load on this thread
+	m_modelFiles.resize(ModelResource::SkyDomeModel);
+	m_pFileReader = new AsyncFileReader();
+	m_pFileReader->Initialize();
 
-	// Create model
-	Model* model = nullptr;
-	if (resource == SkyDomeModel)
+	int iReadCount = 0;
+	for (int i = 0; i < ModelResource::SkyDomeModel; i++)
 	{
-		m_pSkyDome = new SkyDome();
+		ModelFile* pModelFile = &m_modelFiles[i];
+		pModelFile->iRequest = -1;
+		pModelFile->bParsed = false;
+		pModelFile->vertexData = nullptr;
+		pModelFile->indexData = nullptr;
+		pModelFile->iVertexCount = 0;
+		pModelFile->iIndexCount = 0;
+
+		const char* filename = GetModelFilename((ModelResource)i);
+		if (!filename)
+		{
+			continue;
+		}
+		pModelFile->filename = ResolveFilename(filename);
+
+		// A glTF version of the model (exported straight from the source asset) is used instead of the text one, and mapped when it is loaded
+		std::string gltfFilename(filename);
+		gltfFilename.replace(gltfFilename.find_last_of('.'), std::string::npos, ".glb");
+		gltfFilename = ResolveFilename(gltfFilename.c_str());
+		if (ResourceExists(gltfFilename))
+		{
+			pModelFile->filename = gltfFilename;
+			continue;
+		}
+
+		// Archived models are already mapped, so they are parsed when they are loaded
+		if (m_pArchive && m_pArchive->Contains(pModelFile->filename.c_str()))
+		{
+			continue;
+		}
+
+		pModelFile->iRequest = m_pFileReader->Read(pModelFile->filename.c_str(), [pModelFile](const unsigned char* data, size_t size)
+		{
+			if (data)
+			{
+				pModelFile->bParsed = ParseModel(pModelFile->filename, data, size, *pModelFile);
+			}
+		});
+		iReadCount++;
 	}
-	else
-	{
-		model = new Model();
-	}
-	
-	// Open file
+	m_pFileReader->Submit();
 
-	std::ifstream file;
-	char input;
+	Utils::Log("Reading " + std::to_string(iReadCount) + " model files (" + m_pFileReader->GetBackendName() + ")");
+}
 
+const char* ResourceManager::GetModelFilename(ModelResource resource)
+{
 	switch (resource)
 	{
 	case StatueModel:
-		file.open("Resources/statue.txt");
-		break;
+		return "Resources/statue.txt";
 	/*case LionModel:
-		file.open("Resources/lion.txt");
-		break;*/
+		return "Resources/lion.txt";*/
 	/*case VaseModel:
-		file.open("Resources/vase.txt");
-		break;*/
+		return "Resources/vase.txt";*/
 	case PillarModel:
-		file.open("Resources/pillar.txt");
-		break;
+		return "Resources/pillar.txt";
 	case FountainModel:
-		file.open("Resources/fountain.txt");
-		break;
+		return "Resources/fountain.txt";
 	case LupineModel:
-		file.open("Resources/lupine.txt");
-		break;
+		return "Resources/lupine.txt";
 	case LavenderModel:
-		file.open("Resources/lavender.txt");
-		break;
-	case GroundModel:
+		return "Resources/lavender.txt";
 	case HedgeModel:
-		file.open("Resources/plane.txt");
-		break;
+		return "Resources/plane.txt";
 	case BalustradeModel:
-		file.open("Resources/balustrade.txt");
-		break;
-	case SkyDomeModel:
-		file.open("Resources/skydome.txt");
-		break;
+		return "Resources/balustrade.txt";
+	default:
+		return nullptr; // The sky dome, which is generated
 	}
-	if (file.fail())
+}
+
+bool ResourceManager::IsOccluder(ModelResource resource)
+{
+	// Large and solid enough to hide much of the garden from the paths between them
+	return resource == ModelResource::PillarModel || resource == ModelResource::HedgeModel || resource == ModelResource::BalustradeModel;
+}
+
+bool ResourceManager::ParseModel(const std::string& filename, const unsigned char* data, size_t size, ModelFile& modelFile)
+{
+	// Cooked models are welded and indexed; text models are parsed as they are
+	if (filename.size() > 5 && filename.compare(filename.size() - 5, 5, ".mesh") == 0)
+	{
+		return MeshFile::ReadCooked(data, size, modelFile.vertices, modelFile.indices, modelFile.lods, modelFile.meshlets);
+	}
+	std::vector<std::string> errors;
+	if (!MeshFile::ParseText(data, size, modelFile.vertices, &errors))
 	{
+		for (const auto& error : errors)
+		{
+			Utils::Log(filename + ": " + error);
+		}
 		return false;
 	}
+	return true;
+}
 
-	// Read up to the value of the vertex count
-	file.get(input);
-	while (input != ':')
+bool ResourceManager::ImportModel(ModelFile& modelFile)
+{
+	// The file stays mapped (or in the archive's mapping) so that the buffers can be created from it directly
+	const char* filename = modelFile.filename.c_str();
+	modelFile.pGltfFile.reset(new GltfFile());
+	bool bResult = false;
+	if (m_pArchive && m_pArchive->Contains(filename))
+	{
+		size_t size = 0;
+		const unsigned char* data = m_pArchive->Load(filename, &size, modelFile.buffer);
+		bResult = data && modelFile.pGltfFile->Parse(data, size);
+	}
+	else
 	{
-		file.get(input);
+		bResult = modelFile.pGltfFile->Open(filename);
+	}
+	if (!bResult)
+	{
+		Utils::Log(modelFile.filename + ": " + modelFile.pGltfFile->GetError());
+		return false;
 	}
 
-	// Read the vertex count
-	int iVertexCount;
-	file >> iVertexCount;
-	if (resource == SkyDomeModel)
+	// The file's first mesh is the model; its views are used where they match the buffer layouts, and copied into it where they don't
+	GltfFile* pGltfFile = modelFile.pGltfFile.get();
+	const GltfMesh& mesh = pGltfFile->GetMeshes()[0];
+	modelFile.vertexData = pGltfFile->GetVertexData(0);
+	if (!modelFile.vertexData)
 	{
-		m_pSkyDome->SetVertexCount(iVertexCount);
-		m_pSkyDome->SetIndexCount(iVertexCount);
+		pGltfFile->ReadVertices(0, modelFile.vertices);
+		modelFile.vertexData = modelFile.vertices.data();
 	}
-	else
+	modelFile.indexData = pGltfFile->GetIndexData(0);
+	if (!modelFile.indexData)
 	{
-		model->SetVertexCount(iVertexCount);
-		model->SetIndexCount(iVertexCount);
+		pGltfFile->ReadIndices(0, modelFile.indices);
+		modelFile.indexData = modelFile.indices.data();
 	}
+	modelFile.iVertexCount = mesh.iVertexCount;
+	modelFile.iIndexCount = mesh.iIndexCount;
+	modelFile.nodeMatrices = mesh.nodeMatrices;
 
-	// Read up to the beginning of the data
-	file.get(input);
-	while (input != ':')
+	int iMaterial = mesh.primitives[0].iMaterial;
+	if (iMaterial >= 0 && iMaterial < (int)pGltfFile->GetMaterials().size())
 	{
-		file.get(input);
+		modelFile.materialTexture = pGltfFile->GetMaterials()[iMaterial].baseColorTexture;
 	}
-	file.get(input);
-	file.get(input);
 
-	// Read the vertex data
-	ModelData* modelData = new ModelData[iVertexCount];
-	for (int i = 0; i < iVertexCount; i++)
+	Utils::Log("Imported " + modelFile.filename + ": " + std::to_string(modelFile.iVertexCount) + " vertices " + (modelFile.vertices.empty() ? "in place" : "interleaved") + ", " +
+		std::to_string(modelFile.iIndexCount) + " indices " + (modelFile.indices.empty() ? "in place" : "widened") + ", " + std::to_string(mesh.nodeMatrices.size()) + " nodes");
+	return true;
+}
+
+bool ResourceManager::LoadModel(ModelResource resource)
+{
+	// Reference:
+	// RasterTek Tutorial 8: Loading Maya 2011 Models (http://www.rastertek.com/dx11tut08.html)
+
+	// Wait for the model's file to be read and parsed in the background, or parse it from the archive, or import it in place
+	ModelFile& modelFile = m_modelFiles[resource];
+	if (modelFile.iRequest >= 0)
 	{
-		file >> modelData[i].x >> modelData[i].y >> modelData[i].z;
-		file >> modelData[i].tu >> modelData[i].tv;
-		file >> modelData[i].nx >> modelData[i].ny >> modelData[i].nz;
+		m_pFileReader->Wait(modelFile.iRequest);
 	}
-	if (resource == SkyDomeModel)
+	else if (modelFile.filename.size() > 4 && modelFile.filename.compare(modelFile.filename.size() - 4, 4, ".glb") == 0)
 	{
-		m_pSkyDome->SetModelData(modelData);
+		modelFile.bParsed = ImportModel(modelFile);
 	}
-	else
+	else if (!modelFile.filename.empty())
+	{
+		std::vector<unsigned char> buffer;
+		size_t size = 0;
+		const unsigned char* data = ReadResource(modelFile.filename.c_str(), &size, buffer);
+		modelFile.bParsed = data && ParseModel(modelFile.filename, data, size, modelFile);
+	}
+	if (!modelFile.bParsed)
+	{
+		return false;
+	}
+	if (!modelFile.pGltfFile)
 	{
-		model->SetModelData(modelData);
+		modelFile.vertexData = modelFile.vertices.data();
+		modelFile.indexData = modelFile.indices.empty() ? nullptr : modelFile.indices.data();
+		modelFile.iVertexCount = (int)modelFile.vertices.size();
+		modelFile.iIndexCount = modelFile.indices.empty() ? (int)modelFile.vertices.size() : (int)modelFile.indices.size();
 	}
 
-	// Close file
-	file.close();
+	// Create model
+	Model* model = new Model();
+	model->SetVertexCount(modelFile.iVertexCount);
+	model->SetIndexCount(modelFile.iIndexCount);
+	model->SetModelData(modelFile.vertexData);
+	model->SetIndexData(modelFile.indexData);
+	model->SetLods(modelFile.lods);
+	model->SetMeshlets(modelFile.meshlets);
+	model->SetNodeMatrices(modelFile.nodeMatrices);
+	// Impostors draw the distant instances of their models; with occlusion culling, every model but the occluders (which keep their compact instances) also drops those hidden
+	bool bImpostor = AssetCooker::GetImpostorSettings(GetModelFilename(resource)).bEnabled;
+	model->SetInstancesCulled(bImpostor || (m_bOcclusionCulling && !IsOccluder(resource)));
+
+	// Store model in array
+	m_models.push_back(model);
+
+	return true;
+}
 
-	if (resource != SkyDomeModel)
+bool ResourceManager::LoadScatter(ModelResource model, const ScatterSettings& settings, const DensityMap& densityMap, int iCapacity)
+{
+	VegetationScatter* pScatter = new VegetationScatter();
+	if (!pScatter->Initialize(settings, densityMap, VegetationStreamRadius))
 	{
-		// Store model in array
-		m_models.push_back(model);
+		delete pScatter;
+		return false;
+	}
+
+	// The model starts out with every instance in reach of the middle of the map, so that its impostor's fade is set by them
+	XMFLOAT3 center((densityMap.GetMinX() + densityMap.GetMaxX()) * 0.5f, settings.fHeight, (densityMap.GetMinZ() + densityMap.GetMaxZ()) * 0.5f);
+	pScatter->Load(center);
+	std::vector<int> chunks;
+	pScatter->GetResidentChunks(chunks);
+	std::vector<Instance> instances;
+	pScatter->GetInstances(chunks, iCapacity, instances);
+
+	Model* pModel = m_models[model];
+	pModel->SetInstanceCapacity(iCapacity);
+	if (!pModel->InitializeBuffers(m_pDevice, (int)instances.size(), instances.data()))
+	{
+		delete pScatter;
+		return false;
 	}
 
+	// Chunks are culled by the model's bounds, placed within an instance, around the instance's position
+	XMFLOAT4 boundingSphere = pModel->GetBoundingSphere();
+	XMMATRIX modelMatrix = XMLoadFloat4x4(&settings.modelMatrix);
+	XMVECTOR vCenter = XMVector3TransformCoord(XMVectorSet(boundingSphere.x, boundingSphere.y, boundingSphere.z, 1.0f), modelMatrix);
+	float fScale = (std::max)(XMVectorGetX(XMVector3Length(modelMatrix.r[0])), (std::max)(XMVectorGetX(XMVector3Length(modelMatrix.r[1])), XMVectorGetX(XMVector3Length(modelMatrix.r[2]))));
+	pScatter->SetInstanceRadius(XMVectorGetX(XMVector3Length(vCenter)) + boundingSphere.w * fScale);
+
+	if ((int)m_scatters.size() <= model)
+	{
+		m_scatters.resize(model + 1, nullptr);
+	}
+	m_scatters[model] = pScatter;
+
+	return true;
+}
+
+bool ResourceManager::LoadImpostor(ModelResource model, TextureResource texture)
+{
+	// The cooked atlas is block compressed; without one, the atlas is baked from the model and its source texture and used uncompressed
+	const char* filename = GetModelFilename(model);
+	std::string atlasFilename = AssetCooker::GetImpostorFilename(filename);
+	std::vector<unsigned char> buffer;
+	size_t size = 0;
+	const unsigned char* data = ResourceExists(atlasFilename) ? ReadResource(atlasFilename.c_str(), &size, buffer) : nullptr;
+	if (!data)
+	{
+		auto startTime = std::chrono::steady_clock::now();
+
+		TextureImage textureImage;
+		std::vector<unsigned char> textureBuffer;
+		size_t textureSize = 0;
+		const unsigned char* textureData = ReadResource(ResolveFilename(GetTextureFilename(texture)).c_str(), &textureSize, textureBuffer);
+		bool bTextured = textureData && textureImage.LoadFromMemory(textureData, textureSize);
+
+		Model* pModel = m_models[model];
+		TextureImage atlas;
+		buffer.clear();
+		if (!ImpostorBaker::Bake(pModel->GetModelData(), pModel->GetVertexCount(), pModel->GetIndexData(), pModel->GetLod(0).uiIndexCount, bTextured ? &textureImage : nullptr, AssetCooker::GetImpostorSettings(filename).bOpaque, atlas) ||
+			!atlas.SaveToMemory(buffer, RGBA8Format))
+		{
+			return false;
+		}
+		data = buffer.data();
+		size = buffer.size();
+
+		double dMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+		Utils::Log("Baked the impostor of " + std::string(filename) + (bTextured ? "" : " untextured") + " in " + std::to_string((int)dMilliseconds) + " ms (cooking with -cook bakes and compresses it ahead of time)");
+	}
+
+	Impostor* pImpostor = new Impostor();
+	if (!pImpostor->Initialize(m_pDevice, m_pImmediateContext, m_models[model], data, size))
+	{
+		delete pImpostor;
+		return false;
+	}
+
+	if ((int)m_impostors.size() <= model)
+	{
+		m_impostors.resize(model + 1, nullptr);
+	}
+	m_impostors[model] = pImpostor;
+
+	return true;
+}
+
+bool ResourceManager::PackTextures()
+{
+	// Reference:
+	// Improve Batching Using Texture Atlases (NVIDIA, 2004)
+
+	// Group textures that can be slices of one array; only the views differ between models in a group, so their draws share the bind
+	std::vector<std::vector<int>> groups; // Indices into the pending textures
+	for (int i = 0; i < (int)m_pendingTextures.size(); i++)
+	{
+		const DDSTextureInfo& info = m_pendingTextures[i].info;
+		auto group = std::find_if(groups.begin(), groups.end(), [&](const std::vector<int>& members)
+		{
+			const DDSTextureInfo& groupInfo = m_pendingTextures[members[0]].info;
+			return info.format == groupInfo.format && info.width == groupInfo.width && info.height == groupInfo.height && info.mipCount == groupInfo.mipCount;
+		});
+		if (group == groups.end())
+		{
+			groups.push_back(std::vector<int>(1, i));
+		}
+		else
+		{
+			group->push_back(i);
+		}
+	}
+
+	for (const auto& group : groups)
+	{
+		std::vector<std::string> filenames;
+		for (int i : group)
+		{
+			filenames.push_back(m_pendingTextures[i].filename);
+		}
+
+		int iStreamedTexture = m_pTextureStreamer->AddTextureArray(filenames, m_pArchive);
+		if (iStreamedTexture == -1)
+		{
+			return false;
+		}
+
+		for (int iSlice = 0; iSlice < (int)group.size(); iSlice++)
+		{
+			// The streamer replaces the view as levels come and go, so the array holds its own reference
+			TextureResource resource = m_pendingTextures[group[iSlice]].resource;
+			m_textures[resource] = m_pTextureStreamer->GetTexture(iStreamedTexture);
+			m_textures[resource]->AddRef();
+			m_streamedTextures[resource] = iStreamedTexture;
+			m_textureSlices[resource] = iSlice;
+		}
+	}
+
+	Utils::Log("Packed " + std::to_string(m_pendingTextures.size()) + " model textures into " + std::to_string(groups.size()) + " texture arrays");
+	m_pendingTextures.clear();
+
+	for (int i = 0; i < (int)m_models.size(); i++)
+	{
+		m_models[i]->SetTexture(*m_textures[m_modelTextures[i]]);
+		m_models[i]->SetTextureSlice(m_textureSlices[m_modelTextures[i]]);
+	}
+
+	return true;
+}
+
+void ResourceManager::SetModelTexture(ModelResource model, TextureResource texture)
+{
+	// Imported models use the texture their material names, when it is one of the game's
+	if (model < (int)m_modelFiles.size() && !m_modelFiles[model].materialTexture.empty())
+	{
+		TextureResource materialTexture;
+		if (FindTexture(m_modelFiles[model].materialTexture, &materialTexture))
+		{
+			texture = materialTexture;
+		}
+		else
+		{
+			Utils::Log(m_modelFiles[model].filename + ": material texture " + m_modelFiles[model].materialTexture + " is not loaded, so " + GetTextureFilename(texture) + " is used");
+		}
+	}
+
+	if ((int)m_modelTextures.size() <= model)
+	{
+		m_modelTextures.resize(model + 1, texture);
+	}
+	m_modelTextures[model] = texture;
+}
+
+bool ResourceManager::TrimParticleTexture()
+{
+	// Reference:
+	// Graphics Gems for Games: Particle Trimmer (https://www.humus.name/index.php?page=Comments&ID=266)
+
+	TextureImage image;
+	std::vector<unsigned char> buffer;
+	size_t size = 0;
+	const unsigned char* data = ReadResource(ResolveFilename("Resources/particle.dds").c_str(), &size, buffer);
+	if (!data || !image.LoadFromMemory(data, size))
+	{
+		return false;
+	}
+
+	// Only the top level is considered; the blur that lower mips spread past the outline is faint and only seen on distant particles
+	// The particles are blended additively and particle.dds is opaque everywhere, so black texels (rather than transparent ones) are the ones that add nothing
+	// A threshold of 1 ignores the near black texels that BC7 leaves around the outline
+	if (!SpriteTrimmer::ComputePolygon(image, SpriteCoverage::ColorCoverage, 1, 8, m_particlePolygon))
+	{
+		return false;
+	}
+
+	float fArea = SpriteTrimmer::GetArea(m_particlePolygon);
+	Utils::Log("Particle billboard trimmed to " + std::to_string(m_particlePolygon.size()) + " vertices covering " + std::to_string((int)(fArea * 100.0f + 0.5f)) + "% of the quad (" + std::to_string((int)((1.0f - fArea) * 100.0f + 0.5f)) + "% less overdraw)");
+
 	return true;
 }
 
@@ -603,6 +1084,11 @@ Model* ResourceManager::GetModel(ModelResource resource)
 	return m_models[resource];
 }
 
+Impostor* ResourceManager::GetImpostor(ModelResource resource)
+{
+	return (resource < (int)m_impostors.size()) ? m_impostors[resource] : nullptr;
+}
+
 SkyDome* ResourceManager::GetSkyDome()
 {
 	return m_pSkyDome;
@@ -613,6 +1099,359 @@ SkyPlane* ResourceManager::GetSkyPlane()
 	return m_pSkyPlane;
 }
 
+Terrain* ResourceManager::GetTerrain()
+{
+	return m_pTerrain;
+}
+
+const std::vector<XMFLOAT2>& ResourceManager::GetParticlePolygon()
+{
+	return m_particlePolygon;
+}
+
+const TextureResidency* ResourceManager::GetTextureResidency(TextureResource resource)
+{
+	if (m_streamedTextures[resource] == -1)
+	{
+		return nullptr;
+	}
+
+	return &m_pTextureStreamer->GetResidency(m_streamedTextures[resource]);
+}
+
+void ResourceManager::SetTextureBudget(size_t budget)
+{
+	m_pTextureStreamer->SetBudget(budget);
+}
+
+#pragma endregion
+
+#pragma region Update
+
+ResourceManager::ViewBounds ResourceManager::GetViewBounds(Camera* pCamera)
+{
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&projection, pCamera->GetProjectionMatrix());
+
+	ViewBounds view;
+	view.viewMatrix = pCamera->GetViewMatrix();
+	view.fProjectionX = projection._11;
+	view.fProjectionY = projection._22;
+	view.fNearZ = -projection._43 / projection._33;
+	view.fFarZ = projection._43 / (1.0f - projection._33);
+	view.fHorizontalLength = sqrtf(projection._11 * projection._11 + 1.0f);
+	view.fVerticalLength = sqrtf(projection._22 * projection._22 + 1.0f);
+
+	D3D11_VIEWPORT viewport;
+	UINT uiViewportCount = 1;
+	m_pImmediateContext->RSGetViewports(&uiViewportCount, &viewport);
+	view.fPixelsPerUnit = projection._22 * viewport.Height * 0.5f;
+
+	return view;
+}
+
+template <typename Function>
+void ResourceManager::ForEachVisibleInstance(const ViewBounds& view, Model* pModel, Function function)
+{
+	XMFLOAT4 boundingSphere = pModel->GetBoundingSphere();
+	XMVECTOR vModelCenter = XMLoadFloat4(&boundingSphere);
+
+	for (int i = 0; i < pModel->GetInstanceCount(); i++)
+	{
+		XMMATRIX worldMatrix = pModel->GetInstanceWorldMatrix(i);
+		float fScale = (std::max)(XMVectorGetX(XMVector3Length(worldMatrix.r[0])), (std::max)(XMVectorGetX(XMVector3Length(worldMatrix.r[1])), XMVectorGetX(XMVector3Length(worldMatrix.r[2]))));
+		float fRadius = boundingSphere.w * fScale;
+
+		// Skip instances outside the view frustum
+		XMFLOAT3 center;
+		XMStoreFloat3(&center, XMVector3TransformCoord(vModelCenter, worldMatrix * view.viewMatrix));
+		if (center.z + fRadius < view.fNearZ || center.z - fRadius > view.fFarZ ||
+			(fabsf(center.x) * view.fProjectionX - center.z) / view.fHorizontalLength > fRadius ||
+			(fabsf(center.y) * view.fProjectionY - center.z) / view.fVerticalLength > fRadius)
+		{
+			continue;
+		}
+
+		function(fScale, (std::max)(center.z - fRadius, view.fNearZ));
+	}
+}
+
+void ResourceManager::UpdateImpostors(Camera* pCamera)
+{
+	D3D11_VIEWPORT viewport;
+	UINT uiViewportCount = 1;
+	m_pImmediateContext->RSGetViewports(&uiViewportCount, &viewport);
+
+	for (auto& impostor : m_impostors)
+	{
+		if (impostor)
+		{
+			impostor->Update(pCamera, viewport.Height);
+			if (!m_bOcclusionCulling)
+			{
+				impostor->GetModel()->SetDrawnInstances(impostor->GetModelInstances()); // Otherwise UpdateOcclusion drops the hidden ones first
+			}
+		}
+	}
+}
+
+void ResourceManager::UpdateVegetation(Camera* pCamera)
+{
+	XMMATRIX viewProjectionMatrix = pCamera->GetViewMatrix() * pCamera->GetProjectionMatrix();
+	XMFLOAT3 cameraPosition = pCamera->GetPosition();
+	std::vector<Instance> instances;
+	for (int i = 0; i < (int)m_scatters.size(); i++)
+	{
+		VegetationScatter* pScatter = m_scatters[i];
+		if (!pScatter)
+		{
+			continue;
+		}
+
+		// The model's instances are only replaced when the chunks in view change
+		pScatter->Update(cameraPosition);
+		if (!pScatter->CullChunks(viewProjectionMatrix, cameraPosition))
+		{
+			continue;
+		}
+
+		Model* pModel = m_models[i];
+		pScatter->GetInstances(pScatter->GetVisibleChunks(), pModel->GetInstanceCapacity(), instances);
+		pModel->SetInstances(instances.data(), (int)instances.size());
+		Impostor* pImpostor = GetImpostor((ModelResource)i);
+		if (pImpostor)
+		{
+			pImpostor->ResetInstances();
+		}
+	}
+}
+
+void ResourceManager::UpdateTerrain(Camera* pCamera)
+{
+	if (!m_pTerrain->Update(m_pImmediateContext, m_pInstanceRing, pCamera))
+	{
+		Utils::Log("Failed to upload the terrain's chunks");
+	}
+}
+
+void ResourceManager::UpdateOcclusion(Camera* pCamera)
+{
+	if (!m_bOcclusionCulling)
+	{
+		return;
+	}
+
+	m_pOcclusionCuller->BeginFrame(pCamera->GetViewMatrix() * pCamera->GetProjectionMatrix());
+
+	// The occluders in view are drawn at their coarsest level
+	for (int i = 0; i < (int)m_models.size(); i++)
+	{
+		if (!IsOccluder((ModelResource)i))
+		{
+			continue;
+		}
+
+		Model* pModel = m_models[i];
+		const MeshLod& lod = pModel->GetLod(pModel->GetLodCount() - 1);
+		const unsigned int* indices = pModel->GetIndexData() ? pModel->GetIndexData() + lod.uiFirstIndex : nullptr;
+		XMFLOAT3 minimum, maximum;
+		pModel->GetBoundingBox(minimum, maximum);
+		for (int j = 0; j < pModel->GetInstanceCount(); j++)
+		{
+			XMMATRIX worldMatrix = pModel->GetInstanceWorldMatrix(j);
+			if (m_pOcclusionCuller->IsInView(minimum, maximum, worldMatrix))
+			{
+				m_pOcclusionCuller->AddOccluder(pModel->GetModelData(), indices, lod.uiIndexCount, worldMatrix);
+			}
+		}
+	}
+	m_pOcclusionCuller->RenderOccluders();
+
+	// Each culled model draws the instances whose bounds are left visible, of those its impostor doesn't draw alone
+	std::vector<int> instances;
+	std::vector<int> visibleInstances;
+	for (int i = 0; i < (int)m_models.size(); i++)
+	{
+		Model* pModel = m_models[i];
+		if (!pModel->AreInstancesCulled())
+		{
+			continue;
+		}
+
+		Impostor* pImpostor = GetImpostor((ModelResource)i);
+		if (pImpostor)
+		{
+			instances = pImpostor->GetModelInstances();
+		}
+		else
+		{
+			instances.resize(pModel->GetInstanceCount());
+			for (int j = 0; j < (int)instances.size(); j++)
+			{
+				instances[j] = j;
+			}
+		}
+
+		XMFLOAT3 minimum, maximum;
+		pModel->GetBoundingBox(minimum, maximum);
+		visibleInstances.clear();
+		for (int iInstance : instances)
+		{
+			if (m_pOcclusionCuller->IsVisible(minimum, maximum, pModel->GetInstanceWorldMatrix(iInstance)))
+			{
+				visibleInstances.push_back(iInstance);
+			}
+		}
+		pModel->SetDrawnInstances(visibleInstances);
+	}
+}
+
+void ResourceManager::UpdateInstances()
+{
+	for (size_t i = 0; i < m_models.size(); i++)
+	{
+		if (!m_models[i]->UpdateInstanceBuffer(m_pImmediateContext, m_pInstanceRing))
+		{
+			Utils::Log("Failed to upload the instances of model " + std::to_string(i));
+		}
+	}
+	for (size_t i = 0; i < m_impostors.size(); i++)
+	{
+		if (m_impostors[i] && !m_impostors[i]->UpdateInstanceBuffer(m_pImmediateContext, m_pInstanceRing))
+		{
+			Utils::Log("Failed to upload the impostors of model " + std::to_string(i));
+		}
+	}
+}
+
+void ResourceManager::UpdateModelLods(Camera* pCamera)
+{
+	ViewBounds view = GetViewBounds(pCamera);
+	for (int i = 0; i < (int)m_models.size(); i++)
+	{
+		Model* pModel = m_models[i];
+		if (pModel->GetLodCount() < 2)
+		{
+			continue;
+		}
+
+		// Pixels covered by one model unit at the nearest visible instance; every instance draws the same level
+		float fPixelsPerModelUnit = 0.0f;
+		ForEachVisibleInstance(view, pModel, [&](float fScale, float fDepth)
+		{
+			fPixelsPerModelUnit = (std::max)(fPixelsPerModelUnit, view.fPixelsPerUnit * fScale / fDepth);
+		});
+
+		// Models with nothing in view keep their level, so they don't pop when they come back
+		if (fPixelsPerModelUnit == 0.0f)
+		{
+			continue;
+		}
+
+		// Refine while the current level's error shows, and coarsen while the next level's error is well under a pixel
+		int iLod = pModel->GetCurrentLod();
+		while (iLod > 0 && pModel->GetLod(iLod).fError * fPixelsPerModelUnit > LodPixelError)
+		{
+			iLod--;
+		}
+		while (iLod + 1 < pModel->GetLodCount() && pModel->GetLod(iLod + 1).fError * fPixelsPerModelUnit <= LodPixelError * LodHysteresis)
+		{
+			iLod++;
+		}
+		pModel->SetCurrentLod(iLod);
+	}
+}
+
+void ResourceManager::UpdateMeshlets(Camera* pCamera)
+{
+	XMMATRIX viewProjectionMatrix = pCamera->GetViewMatrix() * pCamera->GetProjectionMatrix();
+	XMFLOAT3 cameraPosition = pCamera->GetPosition();
+	for (size_t i = 0; i < m_models.size(); i++)
+	{
+		if (m_models[i]->GetMeshletCount() == 0)
+		{
+			continue;
+		}
+
+		m_models[i]->CullMeshlets(viewProjectionMatrix, cameraPosition);
+		if (!m_models[i]->UpdateMeshletIndices(m_pImmediateContext))
+		{
+			Utils::Log("Failed to upload the meshlets of model " + std::to_string(i));
+		}
+	}
+}
+
+void ResourceManager::UpdateTextureStreaming(Camera* pCamera)
+{
+	// Reference:
+	// Mip-Map Level Selection for Texture Mapping (Ewins et al., 1998)
+
+	ViewBounds view = GetViewBounds(pCamera);
+	for (int i = 0; i < (int)m_models.size(); i++)
+	{
+		int iTexture = m_streamedTextures[m_modelTextures[i]];
+		if (iTexture == -1)
+		{
+			continue;
+		}
+
+		Model* pModel = m_models[i];
+		const TextureResidency& residency = m_pTextureStreamer->GetResidency(iTexture);
+		float fTextureSize = sqrtf((float)residency.iWidth * residency.iHeight);
+		ForEachVisibleInstance(view, pModel, [&](float fScale, float fDepth)
+		{
+			// Texels under one pixel at the nearest point of the bounds, whose base 2 logarithm is the level the sampler would pick
+			// Models mapped to a single texel (zero density) leave the texture at its base level
+			float fTexelsPerPixel = pModel->GetTexcoordDensity() / fScale * fTextureSize * fDepth / view.fPixelsPerUnit;
+			if (fTexelsPerPixel > 0.0f)
+			{
+				int iLevel = (fTexelsPerPixel > 1.0f) ? (int)log2f(fTexelsPerPixel) : 0;
+				m_pTextureStreamer->RequestMip(iTexture, iLevel);
+			}
+		});
+	}
+
+	// The terrain nearest the camera is straight below it, at most
+	int iTerrainTexture = m_streamedTextures[TextureResource::TerrainTexture];
+	if (iTerrainTexture != -1)
+	{
+		const TextureResidency& residency = m_pTextureStreamer->GetResidency(iTerrainTexture);
+		float fTextureSize = sqrtf((float)residency.iWidth * residency.iHeight);
+		XMFLOAT3 cameraPosition = pCamera->GetPosition();
+		float fDepth = (std::max)(cameraPosition.y - m_pTerrain->GetHeight(cameraPosition.x, cameraPosition.z), view.fNearZ);
+		float fTexelsPerPixel = m_pTerrain->GetTextureScale() * fTextureSize * fDepth / view.fPixelsPerUnit;
+		if (fTexelsPerPixel > 0.0f)
+		{
+			int iLevel = (fTexelsPerPixel > 1.0f) ? (int)log2f(fTexelsPerPixel) : 0;
+			m_pTextureStreamer->RequestMip(iTerrainTexture, iLevel);
+		}
+	}
+
+	m_pTextureStreamer->Update();
+
+	// Swap in the views of textures whose resident levels changed
+	for (int i = 0; i < (int)m_textures.size(); i++)
+	{
+		if (m_streamedTextures[i] == -1)
+		{
+			continue;
+		}
+
+		ID3D11ShaderResourceView* texture = m_pTextureStreamer->GetTexture(m_streamedTextures[i]);
+		if (texture != m_textures[i])
+		{
+			texture->AddRef();
+			SAFE_RELEASE(m_textures[i]);
+			m_textures[i] = texture;
+		}
+	}
+	for (int i = 0; i < (int)m_models.size(); i++)
+	{
+		m_models[i]->SetTexture(*m_textures[m_modelTextures[i]]);
+	}
+	m_pTerrain->SetTexture(*m_textures[TextureResource::TerrainTexture]);
+}
+
 #pragma endregion
 
 #pragma region Render
@@ -634,4 +1473,9 @@ void ResourceManager::RenderSkyPlane()
 	m_pSkyPlane->Render(m_pImmediateContext);
 }
 
+void ResourceManager::RenderTerrain()
+{
+	m_pTerrain->Render(m_pImmediateContext);
+}
+
 #pragma endregion
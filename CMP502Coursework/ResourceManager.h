@@ -8,10 +8,25 @@
 
 #include "DDSTextureLoader.h"
 #include <fstream>
+#include <memory>
+#include <sstream>
 #include <vector>
+#include "AssetArchive.h"
+#include "AssetCooker.h"
+#include "AsyncFileReader.h"
+#include "Camera.h"
+#include "GltfFile.h"
+#include "Impostor.h"
+#include "MipGenerator.h"
+#include "OcclusionCuller.h"
 #include "SkyDome.h"
 #include "SkyPlane.h"
+#include "SpriteTrimmer.h"
+#include "Terrain.h"
+#include "TextureStreamer.h"
+#include "UploadRing.h"
 #include "Utils.h"
+#include "VegetationScatter.h"
 
 enum TextureResource : int
 {
@@ -20,7 +35,7 @@ enum TextureResource : int
 	StoneTexture,
 	LupineTexture,
 	LavenderTexture,
-	GroundTexture,
+	TerrainTexture,
 	HedgeTexture,
 	ParticleTexture,
 	CloudTexture1,
@@ -36,11 +51,8 @@ enum ModelResource : int
 	FountainModel,
 	LupineModel,
 	LavenderModel,
-	GroundModel,
-	HedgeModel,
-	HedgeModel2,
+	HedgeModel, // Every hedge and every balustrade is an instance of the one model, drawn together
 	BalustradeModel,
-	BalustradeModel2,
 	SkyDomeModel,	  // Not in models array
 };
 
@@ -50,24 +62,108 @@ public:
 	ResourceManager(ID3D11Device &device, ID3D11DeviceContext &immediateContext);
 	~ResourceManager();
 
-	bool LoadResources();
+	bool LoadResources(QualityLevel quality, bool bOcclusionCulling = false); // Occlusion culling is opt-in, as the open garden hides few instances
 	ID3D11ShaderResourceView* GetTexture(TextureResource resource);
 	Model* GetModel(ModelResource resource);
+	Impostor* GetImpostor(ModelResource resource); // nullptr for models drawn in full at any distance
 	SkyDome* GetSkyDome();
 	SkyPlane* GetSkyPlane();
+	Terrain* GetTerrain();
+	const std::vector<XMFLOAT2>& GetParticlePolygon();
+	const TextureResidency* GetTextureResidency(TextureResource resource); // nullptr for textures that are loaded whole
+	void SetTextureBudget(size_t budget); // Bytes of streamed texture memory
+	void UpdateTextureStreaming(Camera* pCamera); // Requests the mip levels the visible models need and points them at the current textures
+	void UpdateVegetation(Camera* pCamera); // Streams the chunks of scattered plants around the camera, and gives their models the instances of those in view
+	void UpdateTerrain(Camera* pCamera); // Streams the terrain's chunks around the camera, and picks the ones drawn
+	void UpdateImpostors(Camera* pCamera); // Splits the instances of models with impostors between the two by distance
+	void UpdateOcclusion(Camera* pCamera); // Picks the instances culled models draw: those in view that the occluders don't hide (after UpdateImpostors; nothing unless occlusion culling is on)
+	void UpdateInstances(); // Uploads the instances moved (or split between models and impostors) since the last frame
+	void UpdateModelLods(Camera* pCamera); // Picks each model's level of detail from how large its error would be on screen
+	void UpdateMeshlets(Camera* pCamera); // Culls the meshlets of models drawing their full level, and uploads the ones kept
 	void RenderModel(ModelResource resource);
 	void RenderSkyPlane();
+	void RenderTerrain();
 
 private:
+	struct PendingTexture // Streamed texture waiting to be packed
+	{
+		TextureResource resource;
+		std::string filename;
+		DDSTextureInfo info;
+	};
+
+	struct ModelFile // Read and parsed in the background; models point into the data, so it is kept until the manager is destroyed
+	{
+		std::string filename; // Cooked when there is a cooked version, and glTF when there is a glTF version
+		int iRequest; // File reader request, or -1 if the model is read from the archive or mapped
+		bool bParsed;
+		std::vector<ModelData> vertices;
+		std::vector<unsigned int> indices; // Empty for text models, which are unindexed
+		std::vector<MeshLod> lods; // Empty unless the model is cooked
+		std::vector<Meshlet> meshlets; // Empty unless the model is cooked, and large
+		std::unique_ptr<GltfFile> pGltfFile; // Kept open, as glTF models are read in place where their layout allows
+		std::vector<unsigned char> buffer; // glTF file decompressed from the archive
+		const ModelData* vertexData; // The vertices, or a view of the glTF file
+		const unsigned int* indexData; // nullptr for unindexed models
+		int iVertexCount;
+		int iIndexCount;
+		std::vector<XMFLOAT4X4> nodeMatrices; // Empty unless the file has a node hierarchy
+		std::string materialTexture; // Texture the file's material names, if any
+	};
+
+	struct ViewBounds // The camera's projection decoded for the instance loops, once a frame
+	{
+		XMMATRIX viewMatrix;
+		float fProjectionX; // Horizontal and vertical scale of the projection
+		float fProjectionY;
+		float fNearZ;
+		float fFarZ;
+		float fHorizontalLength; // Of the side planes' normals, before normalizing
+		float fVerticalLength;
+		float fPixelsPerUnit; // Pixels covered by one world unit at a depth of one
+	};
+
 	ID3D11Device* m_pDevice;
 	ID3D11DeviceContext* m_pImmediateContext;
+	AssetArchive* m_pArchive; // Resources.pak when there is one; otherwise the loose files are read
+	AsyncFileReader* m_pFileReader;
+	std::vector<ModelFile> m_modelFiles; // Indexed by model resource
 	std::vector<ID3D11ShaderResourceView*> m_textures;
+	std::vector<int> m_streamedTextures; // Streamer index of each texture, or -1
+	std::vector<int> m_textureSlices; // Slice of each texture within its streamed array
+	TextureStreamer* m_pTextureStreamer;
+	UploadRing* m_pInstanceRing;
+	OcclusionCuller* m_pOcclusionCuller; // nullptr unless occlusion culling is on
+	bool m_bOcclusionCulling;
+	std::vector<PendingTexture> m_pendingTextures;
 	std::vector<Model*> m_models;
+	std::vector<Impostor*> m_impostors; // Indexed by model resource
+	std::vector<VegetationScatter*> m_scatters; // Indexed by model resource
+	std::vector<TextureResource> m_modelTextures;
 	SkyDome *m_pSkyDome;
 	SkyPlane *m_pSkyPlane;
+	Terrain* m_pTerrain;
+	std::vector<XMFLOAT2> m_particlePolygon;
 
+	std::string ResolveFilename(const char* filename); // The cooked version of a resource if there is one, otherwise the source
+	bool ResourceExists(const std::string& filename);
+	const unsigned char* ReadResource(const char* filename, size_t* pSize, std::vector<unsigned char>& buffer); // From the archive, or the loose file into the buffer
 	HRESULT LoadTexture(TextureResource resource);
-	bool LoadModel(ModelResource resource);
+	static const char* GetTextureFilename(TextureResource resource);
+	static bool FindTexture(const std::string& name, TextureResource* pResource); // Matches the file name without its directory or extension
+	void ReadModels(); // Starts reading and parsing every model file
+	static const char* GetModelFilename(ModelResource resource); // nullptr for models that aren't loaded from files
+	static bool IsOccluder(ModelResource resource); // Whether the model's instances hide those behind them, for occlusion culling
+	static bool ParseModel(const std::string& filename, const unsigned char* data, size_t size, ModelFile& modelFile);
+	bool ImportModel(ModelFile& modelFile); // Opens a glTF model in place
+	bool LoadModel(ModelResource resource); // Once its file has been parsed
+	bool LoadScatter(ModelResource model, const ScatterSettings& settings, const DensityMap& densityMap, int iCapacity); // Initializes the model's buffers with the instances first scattered
+	bool LoadImpostor(ModelResource model, TextureResource texture); // Once the model's buffers are initialized; baked now if it wasn't cooked
+	bool PackTextures(); // Streams the model textures, with those of the same format, size and mip count sharing an array
+	void SetModelTexture(ModelResource model, TextureResource texture); // Takes effect once the textures are packed
+	bool TrimParticleTexture();
+	ViewBounds GetViewBounds(Camera* pCamera);
+	template <typename Function> void ForEachVisibleInstance(const ViewBounds& view, Model* pModel, Function function); // function(fScale, fDepth) for each instance whose bounds are in view: its largest scale, and the depth of the nearest point of its bounds
 };
 
 #endif
@@ -10,14 +10,17 @@
 ShaderManager::ShaderManager(ID3D11Device &device, ID3D11DeviceContext &immediateContext)
 {
 	m_pLightShader = new LightShader(device, immediateContext);
+	m_pImpostorShader = new ImpostorShader(device, immediateContext);
 	m_pParticleShader = new ParticleShader(device, immediateContext);
 	m_pSkyDomeShader = new SkyDomeShader(device, immediateContext);
 	m_pSkyPlaneShader = new SkyPlaneShader(device, immediateContext);
+	m_modelRenderStats = {};
 }
 
 ShaderManager::~ShaderManager()
 {
 	SAFE_DELETE(m_pLightShader)
+	SAFE_DELETE(m_pImpostorShader)
 	SAFE_DELETE(m_pParticleShader)
 	SAFE_DELETE(m_pSkyDomeShader)
 	SAFE_DELETE(m_pSkyPlaneShader)
@@ -31,6 +34,12 @@ HRESULT ShaderManager::InitializeShaders()
 		return result;
 	}
 
+	result = m_pImpostorShader->Initialize();
+	if (FAILED(result))
+	{
+		return result;
+	}
+
 	result = m_pParticleShader->Initialize();
 	if (FAILED(result))
 	{
@@ -51,11 +60,39 @@ HRESULT ShaderManager::InitializeShaders()
 
 #pragma region Render
 
+void ShaderManager::BeginFrame()
+{
+	m_pLightShader->BeginFrame();
+	m_pImpostorShader->BeginFrame();
+}
+
 bool ShaderManager::RenderModel(Model* pModel, Camera* pCamera)
 {
 	return m_pLightShader->Render(pModel, pCamera);
 }
 
+bool ShaderManager::RenderTerrain(Terrain* pTerrain, Camera* pCamera)
+{
+	return m_pLightShader->Render(pTerrain, pCamera);
+}
+
+bool ShaderManager::RenderImpostor(Impostor* pImpostor, Camera* pCamera)
+{
+	return !pImpostor || m_pImpostorShader->Render(pImpostor, pCamera);
+}
+
+const ModelRenderStats& ShaderManager::GetModelRenderStats()
+{
+	const ModelRenderStats& modelStats = m_pLightShader->GetRenderStats();
+	const ModelRenderStats& impostorStats = m_pImpostorShader->GetRenderStats();
+	m_modelRenderStats.iDrawCalls = modelStats.iDrawCalls + impostorStats.iDrawCalls;
+	m_modelRenderStats.iInstances = modelStats.iInstances;
+	m_modelRenderStats.iTriangles = modelStats.iTriangles + impostorStats.iTriangles;
+	m_modelRenderStats.iImpostors = impostorStats.iImpostors;
+	m_modelRenderStats.iTextureBinds = modelStats.iTextureBinds;
+	return m_modelRenderStats;
+}
+
 bool ShaderManager::RenderParticles(ParticleSystem *pParticleSystem, Camera* pCamera)
 {
 	return m_pParticleShader->Render(pParticleSystem, pCamera);
@@ -6,6 +6,7 @@
 #ifndef SHADER_MANAGER_H
 #define SHADER_MANAGER_H
 
+#include "ImpostorShader.h"
 #include "LightShader.h"
 #include "ParticleShader.h"
 #include "SkyDomeShader.h"
@@ -18,16 +19,22 @@ public:
 	~ShaderManager();
 
 	HRESULT InitializeShaders();
+	void BeginFrame();
 	bool RenderModel(Model* pModel, Camera* pCamera);
+	bool RenderTerrain(Terrain* pTerrain, Camera* pCamera); // Counted with the models
+	bool RenderImpostor(Impostor* pImpostor, Camera* pCamera); // Models without an impostor pass nullptr, which draws nothing
+	const ModelRenderStats& GetModelRenderStats(); // Models and impostors together
 	bool RenderParticles(ParticleSystem *pParticleSystem, Camera* pCamera);
 	bool RenderSkyDome(SkyDome *pSkyDome, Camera* pCamera);
 	bool RenderSkyPlane(SkyPlane *pSkyPlane, Camera* pCamera);
 
 private:
 	LightShader* m_pLightShader;
+	ImpostorShader* m_pImpostorShader;
 	ParticleShader* m_pParticleShader;
 	SkyDomeShader* m_pSkyDomeShader;
 	SkyPlaneShader* m_pSkyPlaneShader;
+	ModelRenderStats m_modelRenderStats;
 };
 
 #endif
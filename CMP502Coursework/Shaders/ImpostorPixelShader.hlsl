@@ -0,0 +1,108 @@
+//
+// ImpostorPixelShader.hlsl
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Octahedral Impostors (Brucks) (https://shaderbits.com/blog/octahedral-impostors)
+// RasterTek Tutorial 10: Specular Lighting (http://www.rastertek.com/dx11tut10.html)
+//
+
+// Slot 1, so that the model texture bound in slot 0 stays bound for the next model
+Texture2D impostorAtlas : register(t1); // Albedo and coverage on the left, model space normals on the right
+SamplerState samplerState : register(s1);
+
+// Constant buffers
+
+cbuffer LightBuffer : register(b0)
+{
+	float4 ambientColor;
+	float4 diffuseColor;
+	float4 specularColor;
+	float specularPower;
+};
+
+cbuffer ImpostorBuffer : register(b1) // Shared with the vertex shader
+{
+	float3 cameraPosition;
+	float frameCount;
+	float4 boundingSphere;
+	float fadeStart;
+	float fadeScale;
+};
+
+// Input
+
+struct PS_INPUT
+{
+	float4 position : SV_POSITION;
+	float4 frameCoords01 : TEXCOORD0;
+	float4 frameCoords23 : TEXCOORD1;
+	nointerpolation float4 frameOrigins01 : TEXCOORD2;
+	nointerpolation float4 frameOrigins23 : TEXCOORD3;
+	nointerpolation float4 frameWeights : TEXCOORD4;
+	float3 viewDirection : TEXCOORD5;
+	nointerpolation float3 normalMatrix0 : NORMAL0;
+	nointerpolation float3 normalMatrix1 : NORMAL1;
+	nointerpolation float3 normalMatrix2 : NORMAL2;
+	nointerpolation float3 lightDirection : LIGHTDIRECTION;
+	nointerpolation float fade : FADE;
+};
+
+// Helpers
+
+float Dither(float2 screenPosition)
+{
+	// The same thresholds as LightPixelShader, so impostors fade in on exactly the pixels models fade out on
+	const float bayer[16] = { 0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5 };
+	uint2 pixel = uint2(screenPosition) % 4;
+	return (bayer[pixel.y * 4 + pixel.x] + 0.5f) / 16.0f;
+}
+
+void SampleFrame(float2 frameCoords, float2 frameOrigin, float fWeight, inout float4 albedo, inout float3 normal)
+{
+	// Coordinates are clamped to the frame, so nothing of its neighbours is sampled
+	float2 atlasCoords = (frameOrigin + saturate(frameCoords)) * float2(0.5f, 1.0f) / frameCount;
+	float4 frameAlbedo = impostorAtlas.Sample(samplerState, atlasCoords);
+	float3 frameNormal = impostorAtlas.Sample(samplerState, atlasCoords + float2(0.5f, 0.0f)).xyz * 2.0f - 1.0f;
+
+	// Weighted by coverage too, so that frames the model doesn't cover here add nothing to the color
+	float fCoverageWeight = fWeight * frameAlbedo.a;
+	albedo += float4(frameAlbedo.rgb * fCoverageWeight, fCoverageWeight);
+	normal += frameNormal * fCoverageWeight;
+}
+
+// Entry point
+
+float4 PS(PS_INPUT input) : SV_TARGET
+{
+	// Blend the four frames nearest to the view
+	float4 albedo = float4(0.0f, 0.0f, 0.0f, 0.0f);
+	float3 normal = float3(0.0f, 0.0f, 0.0f);
+	SampleFrame(input.frameCoords01.xy, input.frameOrigins01.xy, input.frameWeights.x, albedo, normal);
+	SampleFrame(input.frameCoords01.zw, input.frameOrigins01.zw, input.frameWeights.y, albedo, normal);
+	SampleFrame(input.frameCoords23.xy, input.frameOrigins23.xy, input.frameWeights.z, albedo, normal);
+	SampleFrame(input.frameCoords23.zw, input.frameOrigins23.zw, input.frameWeights.w, albedo, normal);
+
+	// Alpha tested like the bake, and dithered in over the model as it dithers out
+	clip(albedo.a - 0.5f);
+	clip(input.fade - Dither(input.position.xy));
+
+	albedo.rgb /= albedo.a;
+	normal = normalize(float3(dot(input.normalMatrix0, normal), dot(input.normalMatrix1, normal), dot(input.normalMatrix2, normal)));
+
+	// Lit as LightPixelShader lights the model
+	float4 outputColor = ambientColor;
+	float lightIntensity = saturate(dot(normal, -input.lightDirection));
+	float4 specular = float4(0.0f, 0.0f, 0.0f, 0.0f);
+	if (lightIntensity > 0.0f)
+	{
+		outputColor += (diffuseColor * lightIntensity);
+		float3 reflection = normalize(2 * lightIntensity * normal - input.lightDirection);
+		specular = specularColor * pow(saturate(dot(reflection, input.viewDirection)), specularPower);
+	}
+	outputColor = saturate(outputColor);
+	outputColor *= float4(albedo.rgb, 1.0f);
+	outputColor = saturate(outputColor + specular);
+
+	return outputColor;
+}
@@ -0,0 +1,134 @@
+//
+// ImpostorVertexShader.hlsl
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Octahedral Impostors (Brucks) (https://shaderbits.com/blog/octahedral-impostors)
+// A Survey of Efficient Representations for Independent Unit Vectors (Cigolle et al., 2014)
+//
+
+// Constant buffers
+
+cbuffer MatrixBuffer : register(b0)
+{
+	matrix worldMatrix;
+	matrix viewMatrix;
+	matrix projectionMatrix;
+};
+
+cbuffer ImpostorBuffer : register(b1)
+{
+	float3 cameraPosition;
+	float frameCount; // Frames along each side of the atlas
+	float4 boundingSphere; // Model space; xyz = center, w = radius
+	float fadeStart; // Distance from the camera at which impostors start to dither in
+	float fadeScale; // Reciprocal of the fade's length
+};
+
+// Input/output
+
+struct VS_INPUT // One quad per instance, with no vertex buffer
+{
+	row_major float3x4 worldMatrix : WORLDMATRIX; // Transposed world matrix without its constant last row
+	uint textureSlice : TEXTURESLICE; // Baked into the atlas
+	float3 lightDirection : LIGHTDIRECTION;
+	uint vertexID : SV_VertexID;
+};
+
+struct PS_INPUT
+{
+	float4 position : SV_POSITION;
+	float4 frameCoords01 : TEXCOORD0; // Where the quad's point falls within each of the four nearest frames, in [0, 1] inside them
+	float4 frameCoords23 : TEXCOORD1;
+	nointerpolation float4 frameOrigins01 : TEXCOORD2; // Each frame's column and row in the atlas
+	nointerpolation float4 frameOrigins23 : TEXCOORD3;
+	nointerpolation float4 frameWeights : TEXCOORD4;
+	float3 viewDirection : TEXCOORD5;
+	nointerpolation float3 normalMatrix0 : NORMAL0; // Rows of the model to world matrix, for the baked model space normals
+	nointerpolation float3 normalMatrix1 : NORMAL1;
+	nointerpolation float3 normalMatrix2 : NORMAL2;
+	nointerpolation float3 lightDirection : LIGHTDIRECTION;
+	nointerpolation float fade : FADE; // 1 once the impostor has dithered in completely
+};
+
+// Helpers
+
+float3 GetFrameDirection(float2 frame)
+{
+	// Same mapping as ImpostorBaker::GetFrameDirection: octahedral map with y up, frames on its grid
+	float2 uv = frame * 2.0f / (frameCount - 1.0f) - 1.0f;
+	float3 direction = float3(uv.x, 1.0f - abs(uv.x) - abs(uv.y), uv.y);
+	if (direction.y < 0.0f)
+	{
+		direction.xz = (1.0f - abs(uv.yx)) * (uv >= 0.0f ? 1.0f : -1.0f);
+	}
+	return normalize(direction);
+}
+
+void GetFrameBasis(float3 direction, out float3 right, out float3 up)
+{
+	float3 reference = (abs(direction.y) > 0.999f) ? float3(0.0f, 0.0f, 1.0f) : float3(0.0f, 1.0f, 0.0f);
+	right = normalize(cross(direction, reference));
+	up = cross(right, direction);
+}
+
+float2 ProjectOntoFrame(float3 offset, float3 viewDirection, float2 frame)
+{
+	// The frame is a plane through the center; the point is moved along the view onto it, then mapped into the frame's image
+	float3 frameDirection = GetFrameDirection(frame);
+	float3 right, up;
+	GetFrameBasis(frameDirection, right, up);
+	float3 planeOffset = offset - viewDirection * dot(offset, frameDirection) / max(dot(viewDirection, frameDirection), 0.1f);
+	return float2(dot(planeOffset, right), -dot(planeOffset, up)) / (2.0f * boundingSphere.w) + 0.5f;
+}
+
+// Entry point
+
+PS_INPUT VS(VS_INPUT input)
+{
+	PS_INPUT output;
+
+	// Direction from the instance to the camera in model space, through the inverse (adjugate) of the instance's rotation and scale
+	float3 row0 = input.worldMatrix[0].xyz;
+	float3 row1 = input.worldMatrix[1].xyz;
+	float3 row2 = input.worldMatrix[2].xyz;
+	float3 worldCenter = mul(input.worldMatrix, float4(boundingSphere.xyz, 1.0f));
+	float3 worldView = cameraPosition - worldCenter;
+	float3 viewDirection = normalize(cross(row1, row2) * worldView.x + cross(row2, row0) * worldView.y + cross(row0, row1) * worldView.z);
+
+	// Position on the octahedral map, between four frames
+	float3 octahedron = viewDirection / (abs(viewDirection.x) + abs(viewDirection.y) + abs(viewDirection.z));
+	float2 uv = octahedron.xz;
+	if (octahedron.y < 0.0f)
+	{
+		uv = (1.0f - abs(uv.yx)) * (uv >= 0.0f ? 1.0f : -1.0f);
+	}
+	float2 frame = (uv * 0.5f + 0.5f) * (frameCount - 1.0f);
+	float2 baseFrame = min(floor(frame), frameCount - 2.0f);
+	float2 blend = frame - baseFrame;
+
+	// Corner of a quad facing the camera, large enough for the bounds from any direction
+	float2 corner = float2((input.vertexID & 1) ? 1.0f : -1.0f, (input.vertexID & 2) ? -1.0f : 1.0f);
+	float3 right, up;
+	GetFrameBasis(viewDirection, right, up);
+	float3 offset = (right * corner.x + up * corner.y) * boundingSphere.w;
+
+	float4 worldPosition = float4(mul(input.worldMatrix, float4(boundingSphere.xyz + offset, 1.0f)), 1.0f);
+	output.position = mul(worldPosition, viewMatrix);
+	output.position = mul(output.position, projectionMatrix);
+
+	output.frameCoords01 = float4(ProjectOntoFrame(offset, viewDirection, baseFrame), ProjectOntoFrame(offset, viewDirection, baseFrame + float2(1.0f, 0.0f)));
+	output.frameCoords23 = float4(ProjectOntoFrame(offset, viewDirection, baseFrame + float2(0.0f, 1.0f)), ProjectOntoFrame(offset, viewDirection, baseFrame + float2(1.0f, 1.0f)));
+	output.frameOrigins01 = float4(baseFrame, baseFrame + float2(1.0f, 0.0f));
+	output.frameOrigins23 = float4(baseFrame + float2(0.0f, 1.0f), baseFrame + float2(1.0f, 1.0f));
+	output.frameWeights = float4((1.0f - blend.x) * (1.0f - blend.y), blend.x * (1.0f - blend.y), (1.0f - blend.x) * blend.y, blend.x * blend.y);
+
+	output.viewDirection = normalize(cameraPosition - worldPosition.xyz);
+	output.normalMatrix0 = row0;
+	output.normalMatrix1 = row1;
+	output.normalMatrix2 = row2;
+	output.lightDirection = input.lightDirection;
+	output.fade = saturate((length(worldView) - fadeStart) * fadeScale);
+
+	return output;
+}
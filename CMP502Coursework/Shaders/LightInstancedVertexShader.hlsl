@@ -20,7 +20,11 @@ cbuffer MatrixBuffer
 cbuffer CameraBuffer
 {
 	float3 cameraPosition;
-	float padding;
+	uint textureSlice; // Of a single instance; instanced draws carry one per instance
+	float3 lightDirection; // Likewise
+	float fadeStart; // Distance from the camera at which instances start to dither out
+	float3 boundsCenter; // Model space point the distance is measured to
+	float fadeScale; // Reciprocal of the fade's length; zero when the model doesn't fade
 };
 
 // Input/output
@@ -30,7 +34,20 @@ struct IVS_INPUT
 	float4 position : POSITION;
 	float2 texCoord : TEXCOORD0;
 	float3 normal : NORMAL;
-	matrix worldMatrix : WORLDMATRIX;
+	row_major float3x4 worldMatrix : WORLDMATRIX; // Transposed world matrix without its constant last row
+	uint textureSlice : TEXTURESLICE;
+	float3 lightDirection : LIGHTDIRECTION;
+};
+
+struct CIVS_INPUT // Compact instances
+{
+	float4 position : POSITION;
+	float2 texCoord : TEXCOORD0;
+	float3 normal : NORMAL;
+	float4 instancePosition : INSTANCEPOSITION; // w = uniform scale
+	float4 instanceRotation : INSTANCEROTATION; // Quaternion
+	uint textureSlice : TEXTURESLICE;
+	float4 lightDirection : LIGHTDIRECTION; // xyz mapped to [0, 1]
 };
 
 struct PS_INPUT
@@ -39,9 +56,19 @@ struct PS_INPUT
 	float2 texCoord : TEXCOORD0;
 	float3 normal : NORMAL;
 	float3 viewDirection : TEXCOORD1;
+	nointerpolation uint textureSlice : TEXTURESLICE;
+	nointerpolation float3 lightDirection : LIGHTDIRECTION;
+	nointerpolation float fade : FADE; // 1 once the instance has dithered out completely
 };
 
-// Entry point
+// Helpers
+
+float3 Rotate(float3 v, float4 q)
+{
+	return v + 2.0f * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// Entry points
 
 PS_INPUT IVS(IVS_INPUT input)
 {
@@ -51,7 +78,7 @@ PS_INPUT IVS(IVS_INPUT input)
 	input.position.w = 1.0f;
 
 	// Calculate the position of the vertex in the world
-	float4 worldPosition = mul(input.position, input.worldMatrix);
+	float4 worldPosition = float4(mul(input.worldMatrix, input.position), 1.0f);
 	output.position = worldPosition;
 
 	// Calculate the position of the vertex against the view and projection matrices
@@ -62,7 +89,7 @@ PS_INPUT IVS(IVS_INPUT input)
 	output.texCoord = input.texCoord;
 
 	// Calculate the normal vector against the world matrix only
-	output.normal = mul(input.normal, (float3x3)input.worldMatrix);
+	output.normal = mul((float3x3)input.worldMatrix, input.normal);
 
 	// Normalize the normal vector
 	output.normal = normalize(output.normal);
@@ -73,5 +100,41 @@ PS_INPUT IVS(IVS_INPUT input)
 	// Normalize the view direction
 	output.viewDirection = normalize(output.viewDirection);
 
+	// Pass on the slice of the texture array and the light direction
+	output.textureSlice = input.textureSlice;
+	output.lightDirection = input.lightDirection;
+
+	// Fade by the distance to the instance's bounds, the same for each of its vertices
+	float3 instanceCenter = mul(input.worldMatrix, float4(boundsCenter, 1.0f));
+	output.fade = saturate((distance(instanceCenter, cameraPosition.xyz) - fadeStart) * fadeScale);
+
+	return output;
+}
+
+PS_INPUT CIVS(CIVS_INPUT input)
+{
+	PS_INPUT output;
+
+	// Expand the instance's rotation (renormalized after its quantization), uniform scale and translation
+	float4 rotation = normalize(input.instanceRotation);
+	float4 worldPosition = float4(Rotate(input.position.xyz, rotation) * input.instancePosition.w + input.instancePosition.xyz, 1.0f);
+
+	// Calculate the position of the vertex against the view and projection matrices
+	output.position = mul(worldPosition, viewMatrix);
+	output.position = mul(output.position, projectionMatrix);
+
+	output.texCoord = input.texCoord;
+
+	// A uniform scale doesn't change the direction of the normal
+	output.normal = normalize(Rotate(input.normal, rotation));
+
+	output.viewDirection = normalize(cameraPosition.xyz - worldPosition.xyz);
+
+	output.textureSlice = input.textureSlice;
+	output.lightDirection = input.lightDirection.xyz * 2.0f - 1.0f;
+
+	float3 instanceCenter = Rotate(boundsCenter, rotation) * input.instancePosition.w + input.instancePosition.xyz;
+	output.fade = saturate((distance(instanceCenter, cameraPosition.xyz) - fadeStart) * fadeScale);
+
 	return output;
 }
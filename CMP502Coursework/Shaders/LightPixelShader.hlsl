@@ -5,9 +5,10 @@
 // Reference:
 // RasterTek Tutorial 7: 3D Model Rendering (http://www.rastertek.com/dx11tut07.html)
 // RasterTek Tutorial 10: Specular Lighting (http://www.rastertek.com/dx11tut10.html)
+// Ordered dithering (https://en.wikipedia.org/wiki/Ordered_dithering)
 //
 
-Texture2D shaderTexture;
+Texture2DArray shaderTexture; // Textures of the same format and size share an array
 SamplerState samplerState;
 
 // Constant buffer
@@ -16,9 +17,8 @@ cbuffer LightBuffer
 {
 	float4 ambientColor;
 	float4 diffuseColor;
-	float3 lightDirection;
-	float specularPower;
 	float4 specularColor;
+	float specularPower;
 };
 
 // Input
@@ -29,9 +29,22 @@ struct PS_INPUT
 	float2 texCoord : TEXCOORD0;
 	float3 normal : NORMAL;
 	float3 viewDirection : TEXCOORD1;
+	nointerpolation uint textureSlice : TEXTURESLICE;
+	nointerpolation float3 lightDirection : LIGHTDIRECTION; // Per instance, so that instances lit from different directions share a draw
+	nointerpolation float fade : FADE; // 1 once the instance has dithered out completely
 };
 
-// Entry point
+// Helpers
+
+float Dither(float2 screenPosition)
+{
+	// 4x4 Bayer matrix, as thresholds in (0, 1); impostors fade in on exactly the pixels models fade out on
+	const float bayer[16] = { 0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5 };
+	uint2 pixel = uint2(screenPosition) % 4;
+	return (bayer[pixel.y * 4 + pixel.x] + 0.5f) / 16.0f;
+}
+
+// Entry points
 
 float4 PS(PS_INPUT input) : SV_TARGET
 {
@@ -39,7 +52,7 @@ float4 PS(PS_INPUT input) : SV_TARGET
 	float4 outputColor = ambientColor;
 
 	// Invert the light direction and calculate the amount of light on this pixel
-	float lightIntensity = saturate(dot(input.normal, -lightDirection));
+	float lightIntensity = saturate(dot(input.normal, -input.lightDirection));
 
 	// Initialize the specular light
 	float4 specular = float4(0.0f, 0.0f, 0.0f, 0.0f);
@@ -50,7 +63,7 @@ float4 PS(PS_INPUT input) : SV_TARGET
 		outputColor += (diffuseColor * lightIntensity);
 
 		// Calculate the reflection vector
-		float3 reflection = normalize(2 * lightIntensity * input.normal - lightDirection);
+		float3 reflection = normalize(2 * lightIntensity * input.normal - input.lightDirection);
 
 		// Determine the amount of specular light
 		float specularIntensity = 1.0f; // Specular intensity of the material (http://ogldev.atspace.co.uk/www/tutorial19/tutorial19.html)
@@ -60,8 +73,8 @@ float4 PS(PS_INPUT input) : SV_TARGET
 	// Saturate the ambient color and the diffuse color
 	outputColor = saturate(outputColor);
 
-	// Sample the pixel color from the texture using the sampler at this texture coordinate
-	float4 textureColor = shaderTexture.Sample(samplerState, input.texCoord);
+	// Sample the pixel color from the texture using the sampler at this texture coordinate and array slice
+	float4 textureColor = shaderTexture.Sample(samplerState, float3(input.texCoord, input.textureSlice));
 
 	// Multiply the texture color
 	outputColor *= textureColor;
@@ -71,3 +84,11 @@ float4 PS(PS_INPUT input) : SV_TARGET
 
 	return outputColor;
 }
+
+float4 FadePS(PS_INPUT input) : SV_TARGET
+{
+	// Dither out rather than blend, so that fading models still write depth and need no sorting
+	clip(Dither(input.position.xy) - input.fade);
+
+	return PS(input);
+}
@@ -19,7 +19,11 @@ cbuffer MatrixBuffer
 cbuffer CameraBuffer
 {
 	float3 cameraPosition;
-	float padding;
+	uint textureSlice; // Of a single instance; instanced draws carry one per instance
+	float3 lightDirection; // Likewise
+	float fadeStart; // Distance from the camera at which instances start to dither out
+	float3 boundsCenter; // Model space point the distance is measured to
+	float fadeScale; // Reciprocal of the fade's length; zero when the model doesn't fade
 };
 
 // Input/output
@@ -37,6 +41,9 @@ struct PS_INPUT
 	float2 texCoord : TEXCOORD0;
 	float3 normal : NORMAL;
 	float3 viewDirection : TEXCOORD1;
+	nointerpolation uint textureSlice : TEXTURESLICE;
+	nointerpolation float3 lightDirection : LIGHTDIRECTION;
+	nointerpolation float fade : FADE; // 1 once the instance has dithered out completely
 };
 
 // Entry point
@@ -71,5 +78,12 @@ PS_INPUT VS(VS_INPUT input)
 	// Normalize the view direction
 	output.viewDirection = normalize(output.viewDirection);
 
+	// Pass on the slice of the texture array and the light direction
+	output.textureSlice = textureSlice;
+	output.lightDirection = lightDirection;
+
+	// Single instances don't fade
+	output.fade = 0.0f;
+
 	return output;
 }
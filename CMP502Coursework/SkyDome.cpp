@@ -17,6 +17,7 @@ SkyDome::SkyDome()
 	m_pIndexBuffer = nullptr;
 	m_iIndexCount = 0;
 	m_worldMatrix = XMMatrixIdentity();
+	m_fRadius = 2.0f; // Same size as the sky dome model it replaces, which the pixel shader gradient is tuned for
 }
 
 SkyDome::~SkyDome()
@@ -25,18 +26,13 @@ SkyDome::~SkyDome()
 	SAFE_RELEASE(m_pIndexBuffer);
 }
 
-bool SkyDome::InitializeBuffers(ID3D11Device* device)
+bool SkyDome::Initialize(ID3D11Device* device, QualityLevel quality)
 {
-	SkyDomeVertex* vertices = new SkyDomeVertex[m_iVertexCount];
-	unsigned long* indices = new unsigned long[m_iIndexCount];
-
-	// Load the model data into the vertex and index arrays
-	for (int i = 0; i < m_iVertexCount; i++)
-	{
-		vertices[i].position = XMFLOAT3(m_modelData[i].x, m_modelData[i].y, m_modelData[i].z);
-
-		indices[i] = i;
-	}
+	std::vector<SkyDomeVertex> vertices;
+	std::vector<unsigned long> indices;
+	GenerateHemisphere(quality, m_fRadius, vertices, indices);
+	m_iVertexCount = (int)vertices.size();
+	m_iIndexCount = (int)indices.size();
 
 	// Create the vertex buffer
 
@@ -47,7 +43,7 @@ bool SkyDome::InitializeBuffers(ID3D11Device* device)
 	bufferDesc.CPUAccessFlags = 0;									// No CPU access is necessary
 
 	D3D11_SUBRESOURCE_DATA subresourceData = {}; // Describes the actual data that will be copied to the vertex buffer during creation
-	subresourceData.pSysMem = vertices;
+	subresourceData.pSysMem = vertices.data();
 
 	HRESULT result = device->CreateBuffer(&bufferDesc, &subresourceData, &m_pVertexBuffer);
 	if (FAILED(result))
@@ -61,7 +57,7 @@ bool SkyDome::InitializeBuffers(ID3D11Device* device)
 	bufferDesc.ByteWidth = sizeof(unsigned long) * m_iIndexCount;
 	bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;					// Bind the buffer as an index buffer to the input assembler stage
 
-	subresourceData.pSysMem = indices;
+	subresourceData.pSysMem = indices.data();
 
 	result = device->CreateBuffer(&bufferDesc, &subresourceData, &m_pIndexBuffer);
 	if (FAILED(result))
@@ -70,25 +66,95 @@ bool SkyDome::InitializeBuffers(ID3D11Device* device)
 		return false;
 	}
 
-	// Release
-	SAFE_DELETE_ARRAY(vertices);
-	SAFE_DELETE_ARRAY(indices);
-
 	return true;
 }
 
-#pragma endregion
+void SkyDome::GenerateHemisphere(QualityLevel quality, float fRadius, std::vector<SkyDomeVertex>& vertices, std::vector<unsigned long>& indices)
+{
+	// Generate an indexed hemisphere instead of loading a sphere as a triangle soup
+	// The gradient is constant below the horizon, so the lower half is a single cone from the horizon ring down to the bottom pole
 
-#pragma region Setters/Getters
+	int iSlices;
+	int iStacks; // Rings from the horizon up to (but not including) the top pole
+	switch (quality)
+	{
+	case LowQuality:
+		iSlices = 12;
+		iStacks = 4;
+		break;
+	case MediumQuality:
+		iSlices = 16;
+		iStacks = 6;
+		break;
+	default:
+		iSlices = 24;
+		iStacks = 8;
+		break;
+	}
 
-void SkyDome::SetVertexCount(int iCount)
-{
-	m_iVertexCount = iCount;
+	vertices.resize(iSlices * iStacks + 2);
+	indices.resize(iSlices * (iStacks - 1) * 6 + iSlices * 3 * 2);
+
+	// Rings, starting at the horizon
+	int iVertex = 0;
+	for (int i = 0; i < iStacks; i++)
+	{
+		float fElevation = XM_PIDIV2 * i / iStacks;
+		for (int j = 0; j < iSlices; j++)
+		{
+			float fAzimuth = XM_2PI * j / iSlices;
+			vertices[iVertex++].position = XMFLOAT3(fRadius * cosf(fElevation) * cosf(fAzimuth), fRadius * sinf(fElevation), fRadius * cosf(fElevation) * sinf(fAzimuth));
+		}
+	}
+	int iTopPole = iVertex;
+	vertices[iVertex++].position = XMFLOAT3(0.0f, fRadius, 0.0f);
+	int iBottomPole = iVertex;
+	vertices[iVertex++].position = XMFLOAT3(0.0f, -fRadius, 0.0f);
+
+	int iIndex = 0;
+	for (int i = 0; i < iStacks; i++)
+	{
+		for (int j = 0; j < iSlices; j++)
+		{
+			unsigned long ulCurrent = i * iSlices + j;
+			unsigned long ulNext = i * iSlices + (j + 1) % iSlices;
+
+			if (i < iStacks - 1)
+			{
+				// Two triangles between this ring and the one above
+				indices[iIndex++] = ulCurrent;
+				indices[iIndex++] = ulCurrent + iSlices;
+				indices[iIndex++] = ulNext;
+				indices[iIndex++] = ulNext;
+				indices[iIndex++] = ulCurrent + iSlices;
+				indices[iIndex++] = ulNext + iSlices;
+			}
+			else
+			{
+				// Top cap
+				indices[iIndex++] = ulCurrent;
+				indices[iIndex++] = iTopPole;
+				indices[iIndex++] = ulNext;
+			}
+		}
+	}
+
+	// Bottom cone from the horizon ring
+	for (int j = 0; j < iSlices; j++)
+	{
+		indices[iIndex++] = j;
+		indices[iIndex++] = (j + 1) % iSlices;
+		indices[iIndex++] = iBottomPole;
+	}
 }
 
-void SkyDome::SetIndexCount(int iCount)
+#pragma endregion
+
+#pragma region Setters/Getters
+
+int SkyDome::GetVertexCount()
 {
-	m_iIndexCount = iCount;
+	return m_iVertexCount;
 }
 
 int SkyDome::GetIndexCount()
@@ -96,11 +162,6 @@ int SkyDome::GetIndexCount()
 	return m_iIndexCount;
 }
 
-void SkyDome::SetModelData(ModelData* modelData)
-{
-	m_modelData = modelData;
-}
-
 void SkyDome::SetWorldMatrix(XMMATRIX worldMatrix)
 {
 	m_worldMatrix = worldMatrix;
@@ -22,13 +22,11 @@ public:
 	SkyDome();
 	~SkyDome();
 
-	bool InitializeBuffers(ID3D11Device* device);
+	bool Initialize(ID3D11Device* device, QualityLevel quality);
 	void Render(ID3D11DeviceContext* immediateContext);
 
-	void SetVertexCount(int iCount);
-	void SetIndexCount(int iCount);
+	int GetVertexCount();
 	int GetIndexCount();
-	void SetModelData(ModelData* modelData);
 	void SetWorldMatrix(XMMATRIX worldMatrix);
 	XMMATRIX GetWorldMatrix();
 	void SetTopColor(XMFLOAT4 topColor);
@@ -38,12 +36,14 @@ public:
 	void SetBottomColor(XMFLOAT4 bottomColor);
 	XMFLOAT4 GetBottomColor();
 
+	static void GenerateHemisphere(QualityLevel quality, float fRadius, std::vector<SkyDomeVertex>& vertices, std::vector<unsigned long>& indices); // Indexed triangle list, tessellated by the quality
+
 private:
 	ID3D11Buffer* m_pVertexBuffer;
 	int m_iVertexCount;
 	ID3D11Buffer* m_pIndexBuffer;
 	int m_iIndexCount;
-	ModelData* m_modelData;
+	float m_fRadius;
 	XMMATRIX m_worldMatrix;
 	XMFLOAT4 m_topColor;
 	XMFLOAT4 m_centerColor;
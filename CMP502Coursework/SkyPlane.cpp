@@ -16,9 +16,10 @@ SkyPlane::SkyPlane()
 	m_iVertexCount = 0;
 	m_pIndexBuffer = nullptr;
 	m_iIndexCount = 0;
+	m_indexFormat = DXGI_FORMAT_R32_UINT;
 	m_worldMatrix = XMMatrixIdentity();
 	m_textureTranslation = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f); // Texture1 x & z coordinates, texture2 x & z coordinates
-	m_textureTranslationSpeed = XMFLOAT4(0.0001f, 0.0f, 0.00007f, 0.0f);
+	m_textureTranslationSpeed = XMFLOAT4(0.006f, 0.0f, 0.0042f, 0.0f); // Per second (the previous per frame speeds at 60 fps)
 	m_fBrightness = 0.35f;
 }
 
@@ -28,11 +29,10 @@ SkyPlane::~SkyPlane()
 	SAFE_RELEASE(m_pIndexBuffer);
 }
 
-bool SkyPlane::Initialize(ID3D11Device* device)
+bool SkyPlane::Initialize(ID3D11Device* device, int iSkyPlaneResolution)
 {
 	// Create the sky plane
 
-	int iSkyPlaneResolution = 100;
 	float fSkyPlaneWidth = 150.0f;
 	float fSkyPlaneTop = 0.5f;
 	float fSkyPlaneBottom = 0.0f;
@@ -43,83 +43,62 @@ bool SkyPlane::Initialize(ID3D11Device* device)
 	float fConstant = (fSkyPlaneTop - fSkyPlaneBottom) / (fRadius * fRadius); // Height constant to increment by
 	float fTextureDelta = (float)iTextureRepeat / (float)iSkyPlaneResolution; // Texture coordinate increment value
 
-	m_iVertexCount = (iSkyPlaneResolution + 1) * (iSkyPlaneResolution + 1) * 6;
-	m_iIndexCount = m_iVertexCount;
+	// One shared vertex per grid point, referenced by the six indices of each quad
+	int iRowCount = iSkyPlaneResolution + 1;
+	m_iVertexCount = iRowCount * iRowCount;
+	m_iIndexCount = iSkyPlaneResolution * iSkyPlaneResolution * 6;
 
-	m_modelData = new ModelData[(iSkyPlaneResolution + 1) * (iSkyPlaneResolution + 1)];
+	// 16-bit indices are enough for resolutions up to 255
+	m_indexFormat = (m_iVertexCount <= 65536) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	UINT uiIndexSize = (m_indexFormat == DXGI_FORMAT_R16_UINT) ? sizeof(unsigned short) : sizeof(unsigned long);
 
-	for (int i = 0; i <= iSkyPlaneResolution; i++)
+	SkyPlaneVertex* vertices = new SkyPlaneVertex[m_iVertexCount];
+	unsigned long* indices = new unsigned long[m_iIndexCount];
+
+	for (int j = 0; j < iRowCount; j++)
 	{
-		for (int j = 0; j <= iSkyPlaneResolution; j++)
+		for (int i = 0; i < iRowCount; i++)
 		{
-			int index = j * (iSkyPlaneResolution + 1) + i;
+			int index = j * iRowCount + i;
 
 			float x = (-0.5f * fSkyPlaneWidth) + ((float)i * fQuadSize);
 			float z = (-0.5f * fSkyPlaneWidth) + ((float)j * fQuadSize);
 
-			m_modelData[index].x = x;
-			m_modelData[index].y = fSkyPlaneTop - (fConstant * ((x * x) + (z * z)));
-			m_modelData[index].z = z;
-
-			m_modelData[index].tu = (float)i * fTextureDelta;
-			m_modelData[index].tv = (float)j * fTextureDelta;
+			vertices[index].position = XMFLOAT3(x, fSkyPlaneTop - (fConstant * ((x * x) + (z * z))), z);
+			vertices[index].textureCoordinate = XMFLOAT2((float)i * fTextureDelta, (float)j * fTextureDelta);
 		}
 	}
-	
-	// Load the model data into the vertex and index arrays
-
-	SkyPlaneVertex* vertices = new SkyPlaneVertex[m_iVertexCount];
-	unsigned long* indices = new unsigned long[m_iIndexCount];
 
 	int index = 0;
 	for (int i = 0; i < iSkyPlaneResolution; i++)
 	{
 		for (int j = 0; j < iSkyPlaneResolution; j++)
 		{
-			int index1 = j * (iSkyPlaneResolution + 1) + i;
-			int index2 = j * (iSkyPlaneResolution + 1) + (i + 1);
-			int index3 = (j + 1) * (iSkyPlaneResolution + 1) + i;
-			int index4 = (j + 1) * (iSkyPlaneResolution + 1) + (i + 1);
+			unsigned long index1 = j * iRowCount + i;				// Top left
+			unsigned long index2 = j * iRowCount + (i + 1);			// Top right
+			unsigned long index3 = (j + 1) * iRowCount + i;			// Bottom left
+			unsigned long index4 = (j + 1) * iRowCount + (i + 1);	// Bottom right
 
 			// Triangle 1
-
-			// Top left
-			vertices[index].position = XMFLOAT3(m_modelData[index1].x, m_modelData[index1].y, m_modelData[index1].z);
-			vertices[index].textureCoordinate = XMFLOAT2(m_modelData[index1].tu, m_modelData[index1].tv);
-			indices[index] = index;
-			index++;
-
-			// Top right
-			vertices[index].position = XMFLOAT3(m_modelData[index2].x, m_modelData[index2].y, m_modelData[index2].z);
-			vertices[index].textureCoordinate = XMFLOAT2(m_modelData[index2].tu, m_modelData[index2].tv);
-			indices[index] = index;
-			index++;
-
-			// Bottom left
-			vertices[index].position = XMFLOAT3(m_modelData[index3].x, m_modelData[index3].y, m_modelData[index3].z);
-			vertices[index].textureCoordinate = XMFLOAT2(m_modelData[index3].tu, m_modelData[index3].tv);
-			indices[index] = index;
-			index++;
+			indices[index++] = index1;
+			indices[index++] = index2;
+			indices[index++] = index3;
 
 			// Triangle 2
+			indices[index++] = index3;
+			indices[index++] = index2;
+			indices[index++] = index4;
+		}
+	}
 
-			// Bottom left
-			vertices[index].position = XMFLOAT3(m_modelData[index3].x, m_modelData[index3].y, m_modelData[index3].z);
-			vertices[index].textureCoordinate = XMFLOAT2(m_modelData[index3].tu, m_modelData[index3].tv);
-			indices[index] = index;
-			index++;
-
-			// Top right
-			vertices[index].position = XMFLOAT3(m_modelData[index2].x, m_modelData[index2].y, m_modelData[index2].z);
-			vertices[index].textureCoordinate = XMFLOAT2(m_modelData[index2].tu, m_modelData[index2].tv);
-			indices[index] = index;
-			index++;
-
-			// Bottom right
-			vertices[index].position = XMFLOAT3(m_modelData[index4].x, m_modelData[index4].y, m_modelData[index4].z);
-			vertices[index].textureCoordinate = XMFLOAT2(m_modelData[index4].tu, m_modelData[index4].tv);
-			indices[index] = index;
-			index++;
+	// Narrow the indices to halve the index buffer
+	unsigned short* shortIndices = nullptr;
+	if (m_indexFormat == DXGI_FORMAT_R16_UINT)
+	{
+		shortIndices = new unsigned short[m_iIndexCount];
+		for (int i = 0; i < m_iIndexCount; i++)
+		{
+			shortIndices[i] = (unsigned short)indices[i];
 		}
 	}
 
@@ -143,10 +122,10 @@ bool SkyPlane::Initialize(ID3D11Device* device)
 
 	// Create the index buffer
 
-	bufferDesc.ByteWidth = sizeof(unsigned long) * m_iIndexCount;
+	bufferDesc.ByteWidth = uiIndexSize * m_iIndexCount;
 	bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;					// Bind the buffer as an index buffer to the input assembler stage
 
-	subresourceData.pSysMem = indices;
+	subresourceData.pSysMem = shortIndices ? (void*)shortIndices : (void*)indices;
 
 	result = device->CreateBuffer(&bufferDesc, &subresourceData, &m_pIndexBuffer);
 	if (FAILED(result))
@@ -158,6 +137,12 @@ bool SkyPlane::Initialize(ID3D11Device* device)
 	// Release
 	SAFE_DELETE_ARRAY(vertices);
 	SAFE_DELETE_ARRAY(indices);
+	SAFE_DELETE_ARRAY(shortIndices);
+
+	// Compare with the previous layout of six unique vertices and 32-bit indices per grid point
+	int iPreviousVertexCount = iRowCount * iRowCount * 6;
+	Utils::Log("Sky plane buffers: " + std::to_string(sizeof(SkyPlaneVertex) * m_iVertexCount / 1024) + " KB vertices, " + std::to_string(uiIndexSize * m_iIndexCount / 1024) + " KB indices (previously "
+		+ std::to_string(sizeof(SkyPlaneVertex) * iPreviousVertexCount / 1024) + " KB vertices, " + std::to_string(sizeof(unsigned long) * iPreviousVertexCount / 1024) + " KB indices)");
 
 	return true;
 }
@@ -228,27 +213,34 @@ float SkyPlane::GetBrightness()
 
 #pragma endregion
 
-#pragma region Render
+#pragma region Update
 
-void SkyPlane::Render(ID3D11DeviceContext* immediateContext)
+void SkyPlane::Update(float fDeltaTime)
 {
-	// Increment the translation values to simulate moving clouds
-	m_textureTranslation.x += m_textureTranslationSpeed.x; // Texture1 x coordinate
-	m_textureTranslation.y += m_textureTranslationSpeed.y; // Texture1 z coordinate
-	m_textureTranslation.z += m_textureTranslationSpeed.z; // Texture2 x coordinate
-	m_textureTranslation.w += m_textureTranslationSpeed.w; // Texture2 z coordinate
+	// Increment the translation values by the elapsed time to simulate moving clouds at the same speed regardless of frame rate
+	m_textureTranslation.x += m_textureTranslationSpeed.x * fDeltaTime; // Texture1 x coordinate
+	m_textureTranslation.y += m_textureTranslationSpeed.y * fDeltaTime; // Texture1 z coordinate
+	m_textureTranslation.z += m_textureTranslationSpeed.z * fDeltaTime; // Texture2 x coordinate
+	m_textureTranslation.w += m_textureTranslationSpeed.w * fDeltaTime; // Texture2 z coordinate
 
 	// Keep the values in the zero to one range
 	if (m_textureTranslation.x > 1.0f) { m_textureTranslation.x -= 1.0f; }
 	if (m_textureTranslation.y > 1.0f) { m_textureTranslation.y -= 1.0f; }
 	if (m_textureTranslation.z > 1.0f) { m_textureTranslation.z -= 1.0f; }
 	if (m_textureTranslation.w > 1.0f) { m_textureTranslation.w -= 1.0f; }
-	
+}
+
+#pragma endregion
+
+#pragma region Render
+
+void SkyPlane::Render(ID3D11DeviceContext* immediateContext)
+{
 	UINT uiStrides = sizeof(SkyPlaneVertex);
 	UINT uiOffsets = 0;
 
 	immediateContext->IASetVertexBuffers(0, 1, &m_pVertexBuffer, &uiStrides, &uiOffsets);
-	immediateContext->IASetIndexBuffer(m_pIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	immediateContext->IASetIndexBuffer(m_pIndexBuffer, m_indexFormat, 0);
 	immediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 }
 
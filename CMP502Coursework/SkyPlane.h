@@ -24,7 +24,8 @@ public:
 	SkyPlane();
 	~SkyPlane();
 
-	bool Initialize(ID3D11Device* device);
+	bool Initialize(ID3D11Device* device, int iSkyPlaneResolution); // Number of quads along each side
+	void Update(float fDeltaTime); // Seconds
 	void Render(ID3D11DeviceContext* immediateContext);
 
 	void SetTexture1(ID3D11ShaderResourceView &texture);
@@ -47,10 +48,10 @@ private:
 	int m_iVertexCount;
 	ID3D11Buffer* m_pIndexBuffer;
 	int m_iIndexCount;
-	ModelData* m_modelData;
+	DXGI_FORMAT m_indexFormat;
 	XMMATRIX m_worldMatrix;
 	XMFLOAT4 m_textureTranslation;
-	XMFLOAT4 m_textureTranslationSpeed;
+	XMFLOAT4 m_textureTranslationSpeed; // Per second
 	float m_fBrightness;
 };
 
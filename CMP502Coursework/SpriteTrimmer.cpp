@@ -0,0 +1,215 @@
+//
+// SpriteTrimmer.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Graphics Gems for Games: Particle Trimmer (https://www.humus.name/index.php?page=Comments&ID=266)
+// Monotone Chain Convex Hull (https://en.wikibooks.org/wiki/Algorithm_Implementation/Geometry/Convex_hull/Monotone_chain)
+//
+
+#include "SpriteTrimmer.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+	float Cross(const XMFLOAT2& o, const XMFLOAT2& a, const XMFLOAT2& b)
+	{
+		return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+	}
+}
+
+#pragma region Trim
+
+bool SpriteTrimmer::ComputePolygon(const TextureImage& image, SpriteCoverage coverage, unsigned char threshold, int iMaxVertices, std::vector<XMFLOAT2>& polygon)
+{
+	polygon.clear();
+
+	int iWidth = image.GetWidth();
+	int iHeight = image.GetHeight();
+	if (iWidth <= 0 || iHeight <= 0 || iMaxVertices < 3)
+	{
+		return false;
+	}
+
+	float fWidth = (float)iWidth;
+	float fHeight = (float)iHeight;
+
+	// Only the leftmost and rightmost visible texels of each row can contribute to the hull
+	// Each texel is grown by half a texel on every side since bilinear filtering bleeds it that far, then clamped to the texture
+	std::vector<XMFLOAT2> points;
+	for (int y = 0; y < iHeight; y++)
+	{
+		int iLeft = -1;
+		int iRight = -1;
+		for (int x = 0; x < iWidth; x++)
+		{
+			const unsigned char* texel = image.GetPixel(x, y);
+			unsigned char value = (coverage == AlphaCoverage) ? texel[3] : (std::max)(texel[0], (std::max)(texel[1], texel[2]));
+			if (value > threshold)
+			{
+				if (iLeft < 0)
+				{
+					iLeft = x;
+				}
+				iRight = x;
+			}
+		}
+		if (iLeft < 0)
+		{
+			continue;
+		}
+
+		float fLeft = (std::max)(iLeft - 0.5f, 0.0f);
+		float fRight = (std::min)(iRight + 1.5f, fWidth);
+		float fTop = (std::max)(y - 0.5f, 0.0f);
+		float fBottom = (std::min)(y + 1.5f, fHeight);
+		points.push_back(XMFLOAT2(fLeft, fTop));
+		points.push_back(XMFLOAT2(fLeft, fBottom));
+		points.push_back(XMFLOAT2(fRight, fTop));
+		points.push_back(XMFLOAT2(fRight, fBottom));
+	}
+
+	std::vector<XMFLOAT2> hull;
+	ComputeConvexHull(points, hull);
+	ReduceVertexCount(hull, iMaxVertices, fWidth, fHeight, 0.01f * fWidth * fHeight);
+
+	// Fall back to the full quad if the sprite is empty or the hull could not be simplified enough
+	if (hull.size() < 3 || (int)hull.size() > iMaxVertices)
+	{
+		hull.clear();
+		hull.push_back(XMFLOAT2(0.0f, 0.0f));
+		hull.push_back(XMFLOAT2(fWidth, 0.0f));
+		hull.push_back(XMFLOAT2(fWidth, fHeight));
+		hull.push_back(XMFLOAT2(0.0f, fHeight));
+	}
+
+	// Convert from texels to texture coordinates
+	for (auto& point : hull)
+	{
+		polygon.push_back(XMFLOAT2(point.x / fWidth, point.y / fHeight));
+	}
+
+	return true;
+}
+
+void SpriteTrimmer::ComputeConvexHull(std::vector<XMFLOAT2>& points, std::vector<XMFLOAT2>& hull)
+{
+	hull.clear();
+	if (points.size() < 3)
+	{
+		return;
+	}
+
+	std::sort(points.begin(), points.end(), [](const XMFLOAT2& a, const XMFLOAT2& b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+
+	// Andrew's monotone chain; collinear points are dropped so that every hull vertex is a real corner
+	hull.resize(points.size() * 2);
+	int k = 0;
+
+	// Lower hull
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		while (k >= 2 && Cross(hull[k - 2], hull[k - 1], points[i]) <= 0.0f)
+		{
+			k--;
+		}
+		hull[k++] = points[i];
+	}
+
+	// Upper hull
+	for (int i = (int)points.size() - 2, t = k + 1; i >= 0; i--)
+	{
+		while (k >= t && Cross(hull[k - 2], hull[k - 1], points[i]) <= 0.0f)
+		{
+			k--;
+		}
+		hull[k++] = points[i];
+	}
+
+	// The last point is the same as the first
+	hull.resize(k - 1);
+}
+
+void SpriteTrimmer::ReduceVertexCount(std::vector<XMFLOAT2>& hull, int iMaxVertices, float fWidth, float fHeight, float fMaxAddedArea)
+{
+	// Repeatedly remove the edge whose neighbors can be extended to meet with the least added area
+	// The polygon stays convex and still contains every visible texel
+	// Below the maximum, a vertex is only removed if it costs less than fMaxAddedArea (fewer vertices are cheaper when the area barely changes)
+	while ((int)hull.size() > 4)
+	{
+		int iCount = (int)hull.size();
+		int iBestEdge = -1;
+		float fBestArea = FLT_MAX;
+		XMFLOAT2 bestPoint;
+
+		for (int i = 0; i < iCount; i++)
+		{
+			// Edge from b to c, with a before and d after
+			const XMFLOAT2& a = hull[(i + iCount - 1) % iCount];
+			const XMFLOAT2& b = hull[i];
+			const XMFLOAT2& c = hull[(i + 1) % iCount];
+			const XMFLOAT2& d = hull[(i + 2) % iCount];
+
+			// Intersect the line through a and b with the line through d and c
+			XMFLOAT2 direction1(b.x - a.x, b.y - a.y);
+			XMFLOAT2 direction2(c.x - d.x, c.y - d.y);
+			float fDenominator = direction1.x * direction2.y - direction1.y * direction2.x;
+			if (fabsf(fDenominator) < 1e-6f)
+			{
+				continue; // Parallel edges never meet
+			}
+
+			float t = ((d.x - a.x) * direction2.y - (d.y - a.y) * direction2.x) / fDenominator;
+			float s = ((d.x - a.x) * direction1.y - (d.y - a.y) * direction1.x) / fDenominator;
+			if (t < 1.0f || s < 1.0f)
+			{
+				continue; // The edges diverge, so extending them would not enclose the removed edge
+			}
+
+			XMFLOAT2 point(a.x + direction1.x * t, a.y + direction1.y * t);
+			if (point.x < -1e-3f || point.y < -1e-3f || point.x > fWidth + 1e-3f || point.y > fHeight + 1e-3f)
+			{
+				continue; // The billboard cannot grow past the quad
+			}
+
+			float fArea = 0.5f * fabsf(Cross(b, point, c));
+			if (fArea < fBestArea)
+			{
+				fBestArea = fArea;
+				iBestEdge = i;
+				bestPoint = point;
+			}
+		}
+
+		if (iBestEdge < 0 || ((int)hull.size() <= iMaxVertices && fBestArea > fMaxAddedArea))
+		{
+			return;
+		}
+
+		// Replace b and c with the intersection point
+		int iNext = (iBestEdge + 1) % iCount;
+		hull[iBestEdge] = bestPoint;
+		hull.erase(hull.begin() + iNext);
+	}
+}
+
+#pragma endregion
+
+#pragma region Getters
+
+float SpriteTrimmer::GetArea(const std::vector<XMFLOAT2>& polygon)
+{
+	// Shoelace formula
+	float fArea = 0.0f;
+	for (size_t i = 0; i < polygon.size(); i++)
+	{
+		const XMFLOAT2& a = polygon[i];
+		const XMFLOAT2& b = polygon[(i + 1) % polygon.size()];
+		fArea += a.x * b.y - b.x * a.y;
+	}
+
+	return fabsf(fArea) * 0.5f;
+}
+
+#pragma endregion
@@ -0,0 +1,38 @@
+//
+// SpriteTrimmer.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Graphics Gems for Games: Particle Trimmer (https://www.humus.name/index.php?page=Comments&ID=266)
+// Monotone Chain Convex Hull (https://en.wikibooks.org/wiki/Algorithm_Implementation/Geometry/Convex_hull/Monotone_chain)
+//
+
+#ifndef SPRITE_TRIMMER_H
+#define SPRITE_TRIMMER_H
+
+#include <directxmath.h>
+#include <vector>
+#include "TextureImage.h"
+
+using namespace DirectX;
+
+enum SpriteCoverage : int
+{
+	AlphaCoverage = 0,	// Alpha blended sprites; transparent texels are invisible
+	ColorCoverage		// Additive sprites; black texels are invisible
+};
+
+// Computes a tight convex polygon around the visible texels of a sprite so that billboards cover fewer pixels than a full quad
+class SpriteTrimmer
+{
+public:
+	// Polygon is in texture coordinates, counterclockwise in UV space (the same winding as the particle quad) and suitable for a triangle fan
+	static bool ComputePolygon(const TextureImage& image, SpriteCoverage coverage, unsigned char threshold, int iMaxVertices, std::vector<XMFLOAT2>& polygon);
+	static float GetArea(const std::vector<XMFLOAT2>& polygon); // Fraction of the full quad
+
+private:
+	static void ComputeConvexHull(std::vector<XMFLOAT2>& points, std::vector<XMFLOAT2>& hull);
+	static void ReduceVertexCount(std::vector<XMFLOAT2>& hull, int iMaxVertices, float fWidth, float fHeight, float fMaxAddedArea);
+};
+
+#endif
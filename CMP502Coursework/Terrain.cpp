@@ -0,0 +1,199 @@
+//
+// Terrain.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Rendering Massive Terrains using Chunked Level of Detail Control (Ulrich, 2002)
+// Fast Terrain Rendering Using Geometrical MipMapping (de Boer, 2000)
+//
+
+#include "Terrain.h"
+#include <cstring>
+
+#pragma region Init
+
+Terrain::Terrain()
+{
+	m_pQuadtree = nullptr;
+	m_pTexture = nullptr;
+	m_uiTextureSlice = 0;
+	m_material.ambientColor = COLOR_XMF4(51.0f, 51.0f, 51.0f, 1.0f);
+	m_material.diffuseColor = COLOR_XMF4(255.0f, 204.0f, 248.0f, 1.0f); // Light pink, as the models are lit
+	m_material.fSpecularPower = 24.0f;
+	m_material.specularColor = COLOR_XMF4(13.0f, 0.0f, 11.0f, 1.0f);
+	m_lightDirection = XMFLOAT3(0.0f, -0.8f, 0.5f);
+	m_pVertexBuffer = nullptr;
+	m_pIndexBuffer = nullptr;
+	m_fTextureScale = 0.0f;
+}
+
+Terrain::~Terrain()
+{
+	SAFE_DELETE(m_pQuadtree); // Waits for the chunk being generated
+	SAFE_RELEASE(m_pVertexBuffer);
+	SAFE_RELEASE(m_pIndexBuffer);
+}
+
+bool Terrain::Initialize(ID3D11Device* device, const TerrainSettings& settings, const XMFLOAT3& loadPosition, int iChunkCapacity, int iThreadCount)
+{
+	m_fTextureScale = settings.fTextureScale;
+
+	m_pQuadtree = new TerrainQuadtree();
+	if (!m_pQuadtree->Initialize(settings, iChunkCapacity, iThreadCount))
+	{
+		return false;
+	}
+
+	// Room for every chunk slot, filled by copies from the upload ring as chunks are streamed in
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.ByteWidth = sizeof(Vertex) * TerrainQuadtree::ChunkVertices * (UINT)iChunkCapacity;
+	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	HRESULT result = device->CreateBuffer(&bufferDesc, nullptr, &m_pVertexBuffer);
+	if (FAILED(result))
+	{
+		Utils::ShowError("Failed to create terrain vertex buffer.", result);
+		return false;
+	}
+
+	std::vector<unsigned short> indices;
+	TerrainQuadtree::BuildIndexPatterns(indices, m_patternFirstIndices);
+
+	bufferDesc.ByteWidth = sizeof(unsigned short) * (UINT)indices.size();
+	bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	D3D11_SUBRESOURCE_DATA indexData = {};
+	indexData.pSysMem = indices.data();
+	result = device->CreateBuffer(&bufferDesc, &indexData, &m_pIndexBuffer);
+	if (FAILED(result))
+	{
+		Utils::ShowError("Failed to create terrain index buffer.", result);
+		return false;
+	}
+
+	// Uploaded by the first update
+	m_pQuadtree->Load(loadPosition);
+	Utils::Log("Terrain generated with " + std::to_string(m_pQuadtree->GetResidentChunkCount()) + " chunks of " + std::to_string(TerrainQuadtree::ChunkVertices) + " vertices, sharing " + std::to_string(indices.size()) + " indices");
+
+	return true;
+}
+
+#pragma endregion
+
+#pragma region Setters/Getters
+
+void Terrain::SetTexture(ID3D11ShaderResourceView &texture)
+{
+	m_pTexture = &texture;
+}
+
+ID3D11ShaderResourceView** Terrain::GetTexture()
+{
+	return &m_pTexture;
+}
+
+void Terrain::SetTextureSlice(UINT uiSlice)
+{
+	m_uiTextureSlice = uiSlice;
+}
+
+UINT Terrain::GetTextureSlice()
+{
+	return m_uiTextureSlice;
+}
+
+const Material& Terrain::GetMaterial()
+{
+	return m_material;
+}
+
+XMFLOAT3 Terrain::GetLightDirection()
+{
+	return m_lightDirection;
+}
+
+const std::vector<TerrainDraw>& Terrain::GetDraws()
+{
+	return m_pQuadtree->GetDraws();
+}
+
+void Terrain::GetPattern(int iStitchedEdges, UINT* puiFirstIndex, UINT* puiIndexCount)
+{
+	*puiFirstIndex = (UINT)m_patternFirstIndices[iStitchedEdges];
+	*puiIndexCount = (UINT)(m_patternFirstIndices[iStitchedEdges + 1] - m_patternFirstIndices[iStitchedEdges]);
+}
+
+float Terrain::GetHeight(float fX, float fZ)
+{
+	return m_pQuadtree->GetHeight(fX, fZ);
+}
+
+float Terrain::GetTextureScale()
+{
+	return m_fTextureScale;
+}
+
+TerrainQuadtree* Terrain::GetQuadtree()
+{
+	return m_pQuadtree;
+}
+
+#pragma endregion
+
+#pragma region Update
+
+bool Terrain::Update(ID3D11DeviceContext* immediateContext, UploadRing* pRing, Camera* pCamera)
+{
+	XMFLOAT3 cameraPosition = pCamera->GetPosition();
+	m_pQuadtree->Update(cameraPosition);
+
+	// Copy each chunk taken in into its slot
+	bool bUploaded = true;
+	const UINT uiChunkSize = sizeof(Vertex) * TerrainQuadtree::ChunkVertices;
+	for (int iChunk : m_pQuadtree->GetUploads())
+	{
+		// A chunk evicted again before it was uploaded has no vertices left
+		const TerrainChunk& chunk = m_pQuadtree->GetChunk(iChunk);
+		if (!chunk.bResident || chunk.vertices.empty())
+		{
+			continue;
+		}
+
+		UINT uiRingOffset;
+		unsigned char* data = pRing->Map(immediateContext, uiChunkSize, &uiRingOffset);
+		if (!data)
+		{
+			bUploaded = false;
+			break;
+		}
+		memcpy(data, chunk.vertices.data(), uiChunkSize);
+		pRing->Unmap(immediateContext);
+
+		D3D11_BOX sourceBox = {};
+		sourceBox.left = uiRingOffset;
+		sourceBox.right = uiRingOffset + uiChunkSize;
+		sourceBox.bottom = 1;
+		sourceBox.back = 1;
+		immediateContext->CopySubresourceRegion(m_pVertexBuffer, 0, iChunk * uiChunkSize, 0, 0, pRing->GetBuffer(), 0, &sourceBox);
+	}
+	m_pQuadtree->ClearUploads();
+
+	m_pQuadtree->Select(pCamera->GetViewMatrix() * pCamera->GetProjectionMatrix(), cameraPosition);
+
+	return bUploaded;
+}
+
+#pragma endregion
+
+#pragma region Render
+
+void Terrain::Render(ID3D11DeviceContext* immediateContext)
+{
+	UINT uiStride = sizeof(Vertex);
+	UINT uiOffset = 0;
+	immediateContext->IASetVertexBuffers(0, 1, &m_pVertexBuffer, &uiStride, &uiOffset);
+	immediateContext->IASetIndexBuffer(m_pIndexBuffer, DXGI_FORMAT_R16_UINT, 0); // A chunk has fewer than 65536 vertices, and each draw offsets them to its slot
+	immediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+#pragma endregion
@@ -0,0 +1,64 @@
+//
+// Terrain.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Rendering Massive Terrains using Chunked Level of Detail Control (Ulrich, 2002)
+// Fast Terrain Rendering Using Geometrical MipMapping (de Boer, 2000)
+//
+
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <d3d11.h>
+#include <directxmath.h>
+#include <vector>
+#include "Camera.h"
+#include "Model.h"
+#include "TerrainQuadtree.h"
+#include "UploadRing.h"
+#include "Utils.h"
+
+using namespace DirectX;
+
+// Draws the chunks a TerrainQuadtree picks, lit and textured like the models
+// Every chunk slot has a fixed range of one vertex buffer, so a chunk streamed in is a single copy into its slot, and all of them share
+// one 16-bit index buffer of stitching patterns, drawn with the slot's first vertex as the base
+class Terrain
+{
+public:
+	Terrain();
+	~Terrain();
+
+	Terrain(const Terrain&) = delete;
+	Terrain& operator=(const Terrain&) = delete;
+
+	bool Initialize(ID3D11Device* device, const TerrainSettings& settings, const XMFLOAT3& loadPosition, int iChunkCapacity, int iThreadCount = 1); // The chunks wanted from the load position are generated up front
+	bool Update(ID3D11DeviceContext* immediateContext, UploadRing* pRing, Camera* pCamera); // Streams chunks around the camera, uploads those taken in, and picks the ones drawn
+	void Render(ID3D11DeviceContext* immediateContext);
+
+	void SetTexture(ID3D11ShaderResourceView &texture);
+	ID3D11ShaderResourceView** GetTexture();
+	void SetTextureSlice(UINT uiSlice);
+	UINT GetTextureSlice();
+	const Material& GetMaterial();
+	XMFLOAT3 GetLightDirection();
+	const std::vector<TerrainDraw>& GetDraws();
+	void GetPattern(int iStitchedEdges, UINT* puiFirstIndex, UINT* puiIndexCount);
+	float GetHeight(float fX, float fZ);
+	float GetTextureScale(); // Texture coordinate units per world unit
+	TerrainQuadtree* GetQuadtree();
+
+private:
+	TerrainQuadtree* m_pQuadtree;
+	ID3D11ShaderResourceView* m_pTexture;
+	UINT m_uiTextureSlice; // Slice of the texture array to sample
+	Material m_material;
+	XMFLOAT3 m_lightDirection;
+	ID3D11Buffer* m_pVertexBuffer; // TerrainQuadtree::ChunkVertices for each chunk slot
+	ID3D11Buffer* m_pIndexBuffer;
+	std::vector<int> m_patternFirstIndices;
+	float m_fTextureScale;
+};
+
+#endif
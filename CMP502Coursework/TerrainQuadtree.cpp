@@ -0,0 +1,667 @@
+//
+// TerrainQuadtree.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Rendering Massive Terrains using Chunked Level of Detail Control (Ulrich, 2002)
+// Fast Terrain Rendering Using Geometrical MipMapping (de Boer, 2000)
+// Improved Noise (Perlin, 2002)
+//
+
+#include "TerrainQuadtree.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const int OctaveCount = 6; // Of the hills' noise, each half the width and height of the one before
+	const float Diagonal = 0.70710678f;
+	const float Gradients[8][2] = { { 1.0f, 0.0f }, { -1.0f, 0.0f }, { 0.0f, 1.0f }, { 0.0f, -1.0f }, { Diagonal, Diagonal }, { -Diagonal, Diagonal }, { Diagonal, -Diagonal }, { -Diagonal, -Diagonal } };
+
+	unsigned int Mix(unsigned int h)
+	{
+		h ^= h >> 16;
+		h *= 0x85EBCA6Bu;
+		h ^= h >> 13;
+		h *= 0xC2B2AE35u;
+		h ^= h >> 16;
+		return h;
+	}
+}
+
+#pragma region Init
+
+TerrainQuadtree::TerrainQuadtree()
+{
+	m_settings = {};
+	m_fSampleSpacing = 0.0f;
+	m_iResidentChunkCount = 0;
+	m_iPendingChunkCount = 0;
+	m_uiFrame = 0;
+	m_uiSelection = 0;
+	m_bStopping = false;
+}
+
+TerrainQuadtree::~TerrainQuadtree()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_condition.notify_all();
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+
+	for (auto pRequest : m_requests)
+	{
+		SAFE_DELETE(pRequest);
+	}
+	for (auto pRequest : m_completedRequests)
+	{
+		SAFE_DELETE(pRequest);
+	}
+}
+
+bool TerrainQuadtree::Initialize(const TerrainSettings& settings, int iChunkCapacity, int iThreadCount)
+{
+	// Splitting a chunk needs its four children, so the finest level is only reached with room for four chunks a level below the root
+	if (settings.iLevelCount < 1 || settings.iLevelCount > 16 || iChunkCapacity < 1 + 4 * (settings.iLevelCount - 1))
+	{
+		return false;
+	}
+
+	m_settings = settings;
+	m_fSampleSpacing = settings.fSize / ((1 << (settings.iLevelCount - 1)) * ChunkQuads);
+
+	// The selection's scratch never holds more than every chunk, so it is sized up front and a frame never allocates
+	m_chunks.resize(iChunkCapacity);
+	m_selectedChunks.reserve(iChunkCapacity);
+	m_draws.reserve(iChunkCapacity);
+	m_sortedDraws.reserve(iChunkCapacity);
+	m_drawDistances.reserve(iChunkCapacity);
+	m_chunkSlots.reserve(iChunkCapacity);
+	m_wantedChunks.reserve(iChunkCapacity);
+	m_missingChunks.reserve(iChunkCapacity);
+	for (int i = iChunkCapacity - 1; i >= 0; i--)
+	{
+		m_freeChunks.push_back(i);
+	}
+
+	for (int i = 0; i < (std::max)(iThreadCount, 1); i++)
+	{
+		m_workers.emplace_back(&TerrainQuadtree::WorkerThread, this);
+	}
+
+	return true;
+}
+
+void TerrainQuadtree::Load(const XMFLOAT3& cameraPosition)
+{
+	m_uiFrame++;
+
+	// Every chunk wanted is claimed first, ancestors first, so that those that don't fit are the most detailed
+	FindWantedChunks(cameraPosition);
+	std::vector<int> chunks;
+	for (const auto& wanted : m_wantedChunks)
+	{
+		auto slot = m_chunkSlots.find(wanted.second);
+		if (slot != m_chunkSlots.end())
+		{
+			m_chunks[slot->second].uiLastUsedFrame = m_uiFrame;
+			continue;
+		}
+
+		int iChunk = AllocateChunk();
+		if (iChunk == -1)
+		{
+			break;
+		}
+
+		TerrainChunk& chunk = m_chunks[iChunk];
+		chunk.iLevel = (int)(wanted.second >> 48);
+		chunk.iX = (int)((wanted.second >> 24) & 0xFFFFFF);
+		chunk.iZ = (int)(wanted.second & 0xFFFFFF);
+		chunk.bResident = false;
+		chunk.uiLastUsedFrame = m_uiFrame;
+		chunk.uiSelection = 0;
+		m_chunkSlots[wanted.second] = iChunk;
+		chunks.push_back(iChunk);
+	}
+
+	Utils::ParallelFor((int)chunks.size(), 0, [&](int iBegin, int iEnd)
+	{
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			TerrainChunk& chunk = m_chunks[chunks[i]];
+			GenerateChunk(chunk.iLevel, chunk.iX, chunk.iZ, chunk.vertices, &chunk.fMinHeight, &chunk.fMaxHeight);
+		}
+	}, 4);
+
+	for (int iChunk : chunks)
+	{
+		m_chunks[iChunk].bResident = true;
+		m_uploads.push_back(iChunk);
+	}
+	m_iResidentChunkCount += (int)chunks.size();
+}
+
+#pragma endregion
+
+#pragma region Setters/Getters
+
+const std::vector<TerrainDraw>& TerrainQuadtree::GetDraws()
+{
+	return m_draws;
+}
+
+const std::vector<int>& TerrainQuadtree::GetUploads()
+{
+	return m_uploads;
+}
+
+void TerrainQuadtree::ClearUploads()
+{
+	for (int iChunk : m_uploads)
+	{
+		std::vector<Vertex>().swap(m_chunks[iChunk].vertices);
+	}
+	m_uploads.clear();
+}
+
+const TerrainChunk& TerrainQuadtree::GetChunk(int iChunk)
+{
+	return m_chunks[iChunk];
+}
+
+int TerrainQuadtree::GetChunkCapacity()
+{
+	return (int)m_chunks.size();
+}
+
+int TerrainQuadtree::GetResidentChunkCount()
+{
+	return m_iResidentChunkCount;
+}
+
+float TerrainQuadtree::GetChunkSize(int iLevel)
+{
+	return m_settings.fSize / (1 << iLevel);
+}
+
+size_t TerrainQuadtree::GetMemoryUsage()
+{
+	size_t bytes = m_chunks.capacity() * sizeof(TerrainChunk) + m_chunkSlots.size() * (sizeof(long long) + sizeof(int) + 2 * sizeof(void*));
+	for (const auto& chunk : m_chunks)
+	{
+		bytes += chunk.vertices.capacity() * sizeof(Vertex);
+	}
+	return bytes;
+}
+
+long long TerrainQuadtree::GetChunkKey(int iLevel, int iX, int iZ)
+{
+	return ((long long)iLevel << 48) | ((long long)iX << 24) | (long long)iZ;
+}
+
+int TerrainQuadtree::FindChunk(int iLevel, int iX, int iZ)
+{
+	auto slot = m_chunkSlots.find(GetChunkKey(iLevel, iX, iZ));
+	return (slot != m_chunkSlots.end() && m_chunks[slot->second].bResident) ? slot->second : -1;
+}
+
+bool TerrainQuadtree::IsChunkSelected(int iLevel, int iX, int iZ)
+{
+	int iWidth = 1 << iLevel;
+	if (iX < 0 || iZ < 0 || iX >= iWidth || iZ >= iWidth)
+	{
+		return true;
+	}
+	int iChunk = FindChunk(iLevel, iX, iZ);
+	return iChunk != -1 && m_chunks[iChunk].uiSelection == m_uiSelection;
+}
+
+float TerrainQuadtree::GetDistance(int iLevel, int iX, int iZ, const XMFLOAT3& cameraPosition, float fAltitude)
+{
+	// Measured across the ground, then lifted by the camera's altitude rather than each chunk's heights, so that chunks twice as wide
+	// are always split at twice the distance, whatever the hills under them
+	float fSize = GetChunkSize(iLevel);
+	float fMinX = iX * fSize - m_settings.fSize * 0.5f;
+	float fMinZ = iZ * fSize - m_settings.fSize * 0.5f;
+	float fDeltaX = (std::max)((std::max)(fMinX - cameraPosition.x, cameraPosition.x - (fMinX + fSize)), 0.0f);
+	float fDeltaZ = (std::max)((std::max)(fMinZ - cameraPosition.z, cameraPosition.z - (fMinZ + fSize)), 0.0f);
+	return sqrtf(fDeltaX * fDeltaX + fDeltaZ * fDeltaZ + fAltitude * fAltitude);
+}
+
+float TerrainQuadtree::GetAltitude(const XMFLOAT3& cameraPosition)
+{
+	return (std::max)(cameraPosition.y - GetHeight(cameraPosition.x, cameraPosition.z), 0.0f);
+}
+
+#pragma endregion
+
+#pragma region Generate
+
+float TerrainQuadtree::GradientNoise(float fX, float fZ, unsigned int uiSeed)
+{
+	// Each lattice point hashes to one of eight gradients, blended with Perlin's quintic fade; the result is within about [-0.7, 0.7]
+	float fFloorX = floorf(fX);
+	float fFloorZ = floorf(fZ);
+	int iX = (int)fFloorX;
+	int iZ = (int)fFloorZ;
+	float fU = fX - fFloorX;
+	float fV = fZ - fFloorZ;
+
+	float dots[4];
+	for (int i = 0; i < 4; i++)
+	{
+		int iCornerX = i & 1;
+		int iCornerZ = i >> 1;
+		unsigned int uiHash = Mix((unsigned int)(iX + iCornerX) * 0x9E3779B1u ^ Mix((unsigned int)(iZ + iCornerZ) * 0x85EBCA77u ^ uiSeed));
+		const float* gradient = Gradients[uiHash & 7];
+		dots[i] = gradient[0] * (fU - iCornerX) + gradient[1] * (fV - iCornerZ);
+	}
+
+	float fFadeU = fU * fU * fU * (fU * (fU * 6.0f - 15.0f) + 10.0f);
+	float fFadeV = fV * fV * fV * (fV * (fV * 6.0f - 15.0f) + 10.0f);
+	float fLower = dots[0] + (dots[1] - dots[0]) * fFadeU;
+	float fUpper = dots[2] + (dots[3] - dots[2]) * fFadeU;
+	return fLower + (fUpper - fLower) * fFadeV;
+}
+
+float TerrainQuadtree::GetHeight(float fX, float fZ) const
+{
+	// Hills rise out of the flat rectangle over its margin
+	float fDeltaX = (std::max)((std::max)(m_settings.flatMinimum.x - fX, fX - m_settings.flatMaximum.x), 0.0f);
+	float fDeltaZ = (std::max)((std::max)(m_settings.flatMinimum.y - fZ, fZ - m_settings.flatMaximum.y), 0.0f);
+	float fRise = (m_settings.fFlatMargin > 0.0f) ? (std::min)(sqrtf(fDeltaX * fDeltaX + fDeltaZ * fDeltaZ) / m_settings.fFlatMargin, 1.0f) : 1.0f;
+	if (fRise <= 0.0f)
+	{
+		return 0.0f;
+	}
+	fRise = fRise * fRise * (3.0f - 2.0f * fRise);
+
+	// Fractal sum of octaves of gradient noise, mapped from about [-0.7, 0.7] to [0, 1]
+	float fFrequency = 1.0f / m_settings.fFeatureSize;
+	float fAmplitude = 1.0f;
+	float fNoise = 0.0f;
+	float fTotalAmplitude = 0.0f;
+	for (int i = 0; i < OctaveCount; i++)
+	{
+		fNoise += GradientNoise(fX * fFrequency, fZ * fFrequency, m_settings.uiSeed + i) * fAmplitude;
+		fTotalAmplitude += fAmplitude;
+		fFrequency *= 2.0f;
+		fAmplitude *= 0.5f;
+	}
+	float fHill = (std::min)((std::max)(fNoise / fTotalAmplitude * Diagonal * 2.0f + 0.5f, 0.0f), 1.0f);
+
+	return fHill * fRise * m_settings.fHeightScale;
+}
+
+void TerrainQuadtree::GenerateChunk(int iLevel, int iX, int iZ, std::vector<Vertex>& vertices, float* pfMinHeight, float* pfMaxHeight) const
+{
+	// Vertices are placed on the finest level's samples, counted in whole numbers from the terrain's corner, so that chunks of every level
+	// compute the same positions and heights where they meet
+	int iStep = 1 << (m_settings.iLevelCount - 1 - iLevel);
+	int iFirstX = iX * ChunkQuads * iStep;
+	int iFirstZ = iZ * ChunkQuads * iStep;
+	float fHalfSize = m_settings.fSize * 0.5f;
+
+	// Heights with a border of one vertex all round, for the normals
+	const int iBorderedWidth = ChunkQuads + 3;
+	std::vector<float> heights(iBorderedWidth * iBorderedWidth);
+	for (int j = 0; j < iBorderedWidth; j++)
+	{
+		float fZ = (float)(iFirstZ + (j - 1) * iStep) * m_fSampleSpacing - fHalfSize;
+		for (int i = 0; i < iBorderedWidth; i++)
+		{
+			float fX = (float)(iFirstX + (i - 1) * iStep) * m_fSampleSpacing - fHalfSize;
+			heights[j * iBorderedWidth + i] = GetHeight(fX, fZ);
+		}
+	}
+
+	vertices.resize(ChunkVertices);
+	float fSpacing = iStep * m_fSampleSpacing;
+	float fMinHeight = heights[iBorderedWidth + 1];
+	float fMaxHeight = fMinHeight;
+	for (int j = 0; j <= ChunkQuads; j++)
+	{
+		float fZ = (float)(iFirstZ + j * iStep) * m_fSampleSpacing - fHalfSize;
+		for (int i = 0; i <= ChunkQuads; i++)
+		{
+			float fX = (float)(iFirstX + i * iStep) * m_fSampleSpacing - fHalfSize;
+			const float* height = &heights[(j + 1) * iBorderedWidth + i + 1];
+			Vertex& vertex = vertices[j * (ChunkQuads + 1) + i];
+			vertex.position = XMFLOAT3(fX, *height, fZ);
+			vertex.textureCoordinate = XMFLOAT2(fX * m_settings.fTextureScale, -fZ * m_settings.fTextureScale);
+
+			// Central differences
+			XMVECTOR vNormal = XMVectorSet(height[-1] - height[1], 2.0f * fSpacing, height[-iBorderedWidth] - height[iBorderedWidth], 0.0f);
+			XMStoreFloat3(&vertex.normal, XMVector3Normalize(vNormal));
+
+			fMinHeight = (std::min)(fMinHeight, *height);
+			fMaxHeight = (std::max)(fMaxHeight, *height);
+		}
+	}
+
+	*pfMinHeight = fMinHeight;
+	*pfMaxHeight = fMaxHeight;
+}
+
+void TerrainQuadtree::BuildIndexPatterns(std::vector<unsigned short>& indices, std::vector<int>& firstIndices)
+{
+	// Stitching an edge moves each of its odd vertices onto the even one before it; that collapses one triangle of each pair of cells along the edge,
+	// and leaves the edge as the coarser neighbour's, which has only the even vertices
+	const int iWidth = ChunkQuads + 1;
+	indices.clear();
+	firstIndices.clear();
+	std::vector<int> remap(ChunkVertices);
+	for (int iPattern = 0; iPattern < PatternCount; iPattern++)
+	{
+		firstIndices.push_back((int)indices.size());
+
+		for (int i = 0; i < ChunkVertices; i++)
+		{
+			remap[i] = i;
+		}
+		for (int k = 1; k < ChunkQuads; k += 2)
+		{
+			if (iPattern & 1) remap[k * iWidth] = (k - 1) * iWidth; // -x
+			if (iPattern & 2) remap[k * iWidth + ChunkQuads] = (k - 1) * iWidth + ChunkQuads; // +x
+			if (iPattern & 4) remap[k] = k - 1; // -z
+			if (iPattern & 8) remap[ChunkQuads * iWidth + k] = ChunkQuads * iWidth + k - 1; // +z
+		}
+
+		// Two triangles a cell, split along the diagonal from its minimum corner, wound clockwise seen from above
+		for (int j = 0; j < ChunkQuads; j++)
+		{
+			for (int i = 0; i < ChunkQuads; i++)
+			{
+				int iCorner = j * iWidth + i;
+				int triangles[2][3] = { { iCorner, iCorner + iWidth, iCorner + iWidth + 1 }, { iCorner, iCorner + iWidth + 1, iCorner + 1 } };
+				for (const auto& triangle : triangles)
+				{
+					int a = remap[triangle[0]];
+					int b = remap[triangle[1]];
+					int c = remap[triangle[2]];
+					if (a != b && b != c && c != a)
+					{
+						indices.push_back((unsigned short)a);
+						indices.push_back((unsigned short)b);
+						indices.push_back((unsigned short)c);
+					}
+				}
+			}
+		}
+	}
+	firstIndices.push_back((int)indices.size());
+}
+
+#pragma endregion
+
+#pragma region Update
+
+void TerrainQuadtree::FindWantedChunks(const XMFLOAT3& cameraPosition)
+{
+	// Breadth first from the root, so ancestors come before their descendants and each level is in one run
+	float fAltitude = GetAltitude(cameraPosition);
+	m_wantedChunks.clear();
+	m_wantedChunks.push_back(std::make_pair(GetDistance(0, 0, 0, cameraPosition, fAltitude), GetChunkKey(0, 0, 0)));
+	for (size_t i = 0; i < m_wantedChunks.size(); i++)
+	{
+		long long key = m_wantedChunks[i].second;
+		int iLevel = (int)(key >> 48);
+		if (iLevel + 1 >= m_settings.iLevelCount || m_wantedChunks[i].first >= m_settings.fLodRange * GetChunkSize(iLevel))
+		{
+			continue;
+		}
+
+		int iX = (int)((key >> 24) & 0xFFFFFF);
+		int iZ = (int)(key & 0xFFFFFF);
+		for (int iChild = 0; iChild < 4; iChild++)
+		{
+			int iChildX = iX * 2 + (iChild & 1);
+			int iChildZ = iZ * 2 + (iChild >> 1);
+			m_wantedChunks.push_back(std::make_pair(GetDistance(iLevel + 1, iChildX, iChildZ, cameraPosition, fAltitude), GetChunkKey(iLevel + 1, iChildX, iChildZ)));
+		}
+	}
+}
+
+int TerrainQuadtree::AllocateChunk()
+{
+	if (!m_freeChunks.empty())
+	{
+		int iChunk = m_freeChunks.back();
+		m_freeChunks.pop_back();
+		return iChunk;
+	}
+
+	int iOldest = -1;
+	for (int i = 0; i < (int)m_chunks.size(); i++)
+	{
+		const TerrainChunk& chunk = m_chunks[i];
+		if (chunk.bResident && chunk.uiLastUsedFrame != m_uiFrame && (iOldest == -1 || chunk.uiLastUsedFrame < m_chunks[iOldest].uiLastUsedFrame))
+		{
+			iOldest = i;
+		}
+	}
+	if (iOldest == -1)
+	{
+		return -1;
+	}
+
+	// Chunks no longer wanted have no wanted descendants either, so nothing drawn needs them
+	TerrainChunk& chunk = m_chunks[iOldest];
+	m_chunkSlots.erase(GetChunkKey(chunk.iLevel, chunk.iX, chunk.iZ));
+	std::vector<Vertex>().swap(chunk.vertices);
+	chunk.bResident = false;
+	m_iResidentChunkCount--;
+	return iOldest;
+}
+
+int TerrainQuadtree::Update(const XMFLOAT3& cameraPosition)
+{
+	m_uiFrame++;
+
+	// Take in the chunks generated since the last update
+	std::vector<ChunkRequest*> completedRequests;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		while (!m_completedRequests.empty() && (int)completedRequests.size() < MaxUploadsPerUpdate)
+		{
+			completedRequests.push_back(m_completedRequests.front());
+			m_completedRequests.pop_front();
+		}
+	}
+	for (auto pRequest : completedRequests)
+	{
+		TerrainChunk& chunk = m_chunks[pRequest->iChunk];
+		chunk.vertices.swap(pRequest->vertices);
+		chunk.fMinHeight = pRequest->fMinHeight;
+		chunk.fMaxHeight = pRequest->fMaxHeight;
+		chunk.bResident = true;
+		m_uploads.push_back(pRequest->iChunk);
+		m_iResidentChunkCount++;
+		m_iPendingChunkCount--;
+		SAFE_DELETE(pRequest);
+	}
+
+	// Keep the chunks still wanted, and find those missing
+	FindWantedChunks(cameraPosition);
+	m_missingChunks.clear();
+	for (const auto& wanted : m_wantedChunks)
+	{
+		auto slot = m_chunkSlots.find(wanted.second);
+		if (slot != m_chunkSlots.end())
+		{
+			m_chunks[slot->second].uiLastUsedFrame = m_uiFrame;
+		}
+		else
+		{
+			m_missingChunks.push_back(wanted);
+		}
+	}
+
+	// Request the coarsest first, so there is always a parent to draw in place of the chunks still coming, then the nearest
+	std::sort(m_missingChunks.begin(), m_missingChunks.end(), [](const std::pair<float, long long>& a, const std::pair<float, long long>& b)
+	{
+		int iLevelA = (int)(a.second >> 48);
+		int iLevelB = (int)(b.second >> 48);
+		return (iLevelA != iLevelB) ? iLevelA < iLevelB : a.first < b.first;
+	});
+
+	for (const auto& missing : m_missingChunks)
+	{
+		if (m_iPendingChunkCount >= MaxPendingChunks)
+		{
+			break;
+		}
+
+		int iChunk = AllocateChunk();
+		if (iChunk == -1)
+		{
+			break;
+		}
+
+		TerrainChunk& chunk = m_chunks[iChunk];
+		chunk.iLevel = (int)(missing.second >> 48);
+		chunk.iX = (int)((missing.second >> 24) & 0xFFFFFF);
+		chunk.iZ = (int)(missing.second & 0xFFFFFF);
+		chunk.bResident = false;
+		chunk.uiLastUsedFrame = m_uiFrame;
+		chunk.uiSelection = 0;
+		m_chunkSlots[missing.second] = iChunk;
+
+		ChunkRequest* pRequest = new ChunkRequest();
+		pRequest->iChunk = iChunk;
+		pRequest->iLevel = chunk.iLevel;
+		pRequest->iX = chunk.iX;
+		pRequest->iZ = chunk.iZ;
+		m_iPendingChunkCount++;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_requests.push_back(pRequest);
+		}
+		m_condition.notify_one();
+	}
+
+	return (int)m_missingChunks.size();
+}
+
+void TerrainQuadtree::Select(const XMMATRIX& viewProjectionMatrix, const XMFLOAT3& cameraPosition)
+{
+	m_uiSelection++;
+	m_draws.clear();
+	m_drawDistances.clear();
+
+	int iRoot = FindChunk(0, 0, 0);
+	if (iRoot == -1)
+	{
+		return;
+	}
+
+	XMFLOAT4 frustumPlanes[6];
+	MeshletBuilder::GetFrustumPlanes(viewProjectionMatrix, frustumPlanes);
+	float fAltitude = GetAltitude(cameraPosition);
+
+	// A level at a time, so that every chunk of a level is known before any of them looks for its neighbours
+	m_selectedChunks.clear();
+	m_selectedChunks.push_back(iRoot);
+	m_chunks[iRoot].uiSelection = m_uiSelection;
+	size_t levelBegin = 0;
+	while (levelBegin < m_selectedChunks.size())
+	{
+		size_t levelEnd = m_selectedChunks.size();
+		for (size_t i = levelBegin; i < levelEnd; i++)
+		{
+			const TerrainChunk& chunk = m_chunks[m_selectedChunks[i]];
+			int iLevel = chunk.iLevel;
+			int iX = chunk.iX;
+			int iZ = chunk.iZ;
+			float fDistance = GetDistance(iLevel, iX, iZ, cameraPosition, fAltitude);
+
+			// Split only once the children are resident, and the neighbours are at this level too, so that no two neighbours differ by more than a level
+			int children[4];
+			bool bSplit = iLevel + 1 < m_settings.iLevelCount && fDistance < m_settings.fLodRange * GetChunkSize(iLevel) &&
+				IsChunkSelected(iLevel, iX - 1, iZ) && IsChunkSelected(iLevel, iX + 1, iZ) && IsChunkSelected(iLevel, iX, iZ - 1) && IsChunkSelected(iLevel, iX, iZ + 1);
+			for (int iChild = 0; iChild < 4 && bSplit; iChild++)
+			{
+				children[iChild] = FindChunk(iLevel + 1, iX * 2 + (iChild & 1), iZ * 2 + (iChild >> 1));
+				bSplit = children[iChild] != -1;
+			}
+			if (bSplit)
+			{
+				for (int iChild : children)
+				{
+					m_chunks[iChild].uiSelection = m_uiSelection;
+					m_selectedChunks.push_back(iChild);
+				}
+				continue;
+			}
+
+			// Drawn if it is in view
+			float fSize = GetChunkSize(iLevel);
+			XMFLOAT3 minimum(iX * fSize - m_settings.fSize * 0.5f, chunk.fMinHeight, iZ * fSize - m_settings.fSize * 0.5f);
+			XMFLOAT3 maximum(minimum.x + fSize, chunk.fMaxHeight, minimum.z + fSize);
+			bool bInView = true;
+			for (int j = 0; j < 6 && bInView; j++)
+			{
+				// Outside if the corner farthest along the plane's normal is behind it
+				const XMFLOAT4& plane = frustumPlanes[j];
+				bInView = plane.x * ((plane.x > 0.0f) ? maximum.x : minimum.x) + plane.y * ((plane.y > 0.0f) ? maximum.y : minimum.y) +
+					plane.z * ((plane.z > 0.0f) ? maximum.z : minimum.z) + plane.w >= 0.0f;
+			}
+			if (!bInView)
+			{
+				continue;
+			}
+
+			// A neighbour missing at this level is drawn a level coarser
+			TerrainDraw draw;
+			draw.iChunk = m_selectedChunks[i];
+			draw.iStitchedEdges = (IsChunkSelected(iLevel, iX - 1, iZ) ? 0 : 1) | (IsChunkSelected(iLevel, iX + 1, iZ) ? 0 : 2) |
+				(IsChunkSelected(iLevel, iX, iZ - 1) ? 0 : 4) | (IsChunkSelected(iLevel, iX, iZ + 1) ? 0 : 8);
+			m_drawDistances.push_back(std::make_pair(fDistance, (int)m_draws.size()));
+			m_draws.push_back(draw);
+		}
+		levelBegin = levelEnd;
+	}
+
+	// Nearest first, so the chunks in front hide as much as they can from the depth test
+	std::sort(m_drawDistances.begin(), m_drawDistances.end());
+	m_sortedDraws.clear();
+	for (const auto& drawDistance : m_drawDistances)
+	{
+		m_sortedDraws.push_back(m_draws[drawDistance.second]);
+	}
+	m_draws.swap(m_sortedDraws);
+}
+
+void TerrainQuadtree::WorkerThread()
+{
+	for (;;)
+	{
+		ChunkRequest* pRequest = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this] { return m_bStopping || !m_requests.empty(); });
+			if (m_bStopping)
+			{
+				return;
+			}
+			pRequest = m_requests.front();
+			m_requests.pop_front();
+		}
+
+		GenerateChunk(pRequest->iLevel, pRequest->iX, pRequest->iZ, pRequest->vertices, &pRequest->fMinHeight, &pRequest->fMaxHeight);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_completedRequests.push_back(pRequest);
+		}
+	}
+}
+
+#pragma endregion
@@ -0,0 +1,142 @@
+//
+// TerrainQuadtree.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Rendering Massive Terrains using Chunked Level of Detail Control (Ulrich, 2002)
+// Fast Terrain Rendering Using Geometrical MipMapping (de Boer, 2000)
+// Improved Noise (Perlin, 2002)
+//
+
+#ifndef TERRAIN_QUADTREE_H
+#define TERRAIN_QUADTREE_H
+
+#include <condition_variable>
+#include <deque>
+#include <directxmath.h>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "MeshFile.h"
+#include "MeshletBuilder.h"
+#include "Utils.h"
+
+using namespace DirectX;
+
+struct TerrainSettings
+{
+	float fSize; // World units along each side of the square terrain, centered on the origin, which is the root chunk
+	int iLevelCount; // Of the quadtree; chunks of the last level are the most detailed
+	float fHeightScale; // Height of the highest hills
+	float fFeatureSize; // Width of the largest hills
+	XMFLOAT2 flatMinimum; // Rectangle (in x and z) kept flat at height zero
+	XMFLOAT2 flatMaximum;
+	float fFlatMargin; // Distance over which the hills rise from the flat rectangle
+	float fLodRange; // A chunk is split into its four children while the camera is within this many of its widths
+	float fTextureScale; // Texture coordinate units per world unit
+	unsigned int uiSeed;
+};
+
+struct TerrainChunk // Node of the quadtree, holding a grid of vertices over its square
+{
+	int iLevel;
+	int iX; // Position within its level, in chunk widths from the terrain's minimum corner
+	int iZ;
+	bool bResident; // Generated; otherwise it is still being generated in the background
+	float fMinHeight;
+	float fMaxHeight;
+	unsigned int uiLastUsedFrame; // Last update the chunk was wanted, for evicting the least recently used
+	unsigned int uiSelection; // Last selection the chunk was part of the tree drawn, so its neighbours can find it
+	std::vector<Vertex> vertices; // Until they are uploaded
+};
+
+struct TerrainDraw // A chunk drawn with the index pattern that stitches its edges to coarser neighbours
+{
+	int iChunk;
+	int iStitchedEdges; // Bits 0 to 3 for the -x, +x, -z and +z edges
+};
+
+// Streams a heightfield in chunks of a quadtree (chunked level of detail): every chunk is a grid of the same number of vertices, so each level
+// halves the spacing of the one above, and they all share the index patterns. Chunks near the camera are split into their children, but only
+// once those are resident and the chunks beside them exist at the same level, so neighbouring chunks never differ by more than one level;
+// the finer of two then drops every other vertex along the shared edge, as geomipmapping does, and the two meet without cracks
+// Chunks are generated by background workers, and the least recently wanted are evicted to make room (no Direct3D dependency so it can run headless)
+class TerrainQuadtree
+{
+public:
+	TerrainQuadtree();
+	~TerrainQuadtree(); // Waits for the chunk being generated
+
+	bool Initialize(const TerrainSettings& settings, int iChunkCapacity, int iThreadCount = 1); // false if the capacity can't hold a path from the root to the finest level
+	void Load(const XMFLOAT3& cameraPosition); // Generates every chunk wanted from the position at once, on every core
+	int Update(const XMFLOAT3& cameraPosition); // Takes in the chunks generated, a few at a time, and requests the nearest of those missing; returns how many are missing
+	void Select(const XMMATRIX& viewProjectionMatrix, const XMFLOAT3& cameraPosition); // Picks the chunks drawn, and their stitched edges
+	void GenerateChunk(int iLevel, int iX, int iZ, std::vector<Vertex>& vertices, float* pfMinHeight, float* pfMaxHeight) const;
+	float GetHeight(float fX, float fZ) const;
+
+	const std::vector<TerrainDraw>& GetDraws(); // Picked by the last selection
+	const std::vector<int>& GetUploads(); // Chunks taken in since the last ClearUploads, whose vertices are waiting to be uploaded
+	void ClearUploads(); // Frees the vertices of the uploaded chunks
+	const TerrainChunk& GetChunk(int iChunk);
+	int GetChunkCapacity();
+	int GetResidentChunkCount();
+	float GetChunkSize(int iLevel); // World units along each side of a chunk of the level
+	size_t GetMemoryUsage(); // Bytes of the chunk records, and of vertices waiting to be uploaded
+
+	static void BuildIndexPatterns(std::vector<unsigned short>& indices, std::vector<int>& firstIndices); // One pattern for each combination of stitched edges; pattern i is [firstIndices[i], firstIndices[i + 1])
+
+	static const int ChunkQuads = 32; // Along each side of a chunk
+	static const int ChunkVertices = (ChunkQuads + 1) * (ChunkQuads + 1);
+	static const int PatternCount = 16;
+	static const int MaxUploadsPerUpdate = 8; // Chunks taken in by one update, so that flying into new ground doesn't stall a frame
+	static const int MaxPendingChunks = 16; // Requested from the workers at once
+
+private:
+	struct ChunkRequest
+	{
+		int iChunk;
+		int iLevel;
+		int iX;
+		int iZ;
+		std::vector<Vertex> vertices;
+		float fMinHeight;
+		float fMaxHeight;
+	};
+
+	TerrainSettings m_settings;
+	float m_fSampleSpacing; // Between the vertices of the finest level
+	std::vector<TerrainChunk> m_chunks; // Slots, reused as chunks are evicted
+	std::vector<int> m_freeChunks;
+	std::unordered_map<long long, int> m_chunkSlots; // Slot of each chunk resident or being generated, by its level and coordinates
+	int m_iResidentChunkCount;
+	int m_iPendingChunkCount;
+	unsigned int m_uiFrame;
+	unsigned int m_uiSelection;
+	std::vector<TerrainDraw> m_draws;
+	std::vector<int> m_selectedChunks; // Scratch for the selection, level by level
+	std::vector<std::pair<float, int>> m_drawDistances; // Scratch for sorting the draws nearest first
+	std::vector<TerrainDraw> m_sortedDraws;
+	std::vector<int> m_uploads;
+	std::vector<std::pair<float, long long>> m_wantedChunks; // Scratch for finding the chunks wanted: distance and key of each
+	std::vector<std::pair<float, long long>> m_missingChunks;
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque<ChunkRequest*> m_requests;
+	std::deque<ChunkRequest*> m_completedRequests;
+	bool m_bStopping;
+
+	void FindWantedChunks(const XMFLOAT3& cameraPosition); // Every chunk the camera would split down to, ancestors first, into m_wantedChunks
+	float GetDistance(int iLevel, int iX, int iZ, const XMFLOAT3& cameraPosition, float fAltitude); // From the camera to the nearest point of the chunk's square, as though it were the altitude above it
+	float GetAltitude(const XMFLOAT3& cameraPosition); // Of the camera above the ground beneath it
+	int AllocateChunk(); // A free slot, or the least recently wanted resident chunk evicted; -1 if every chunk is wanted
+	int FindChunk(int iLevel, int iX, int iZ); // Slot of the chunk if it is resident, or -1
+	bool IsChunkSelected(int iLevel, int iX, int iZ); // Whether the chunk is part of the tree drawn (chunks outside the terrain count as selected)
+	void WorkerThread();
+	static long long GetChunkKey(int iLevel, int iX, int iZ);
+	static float GradientNoise(float fX, float fZ, unsigned int uiSeed);
+};
+
+#endif
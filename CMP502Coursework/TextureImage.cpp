@@ -0,0 +1,396 @@
+//
+// TextureImage.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Programming Guide for DDS (https://docs.microsoft.com/en-us/windows/desktop/direct3ddds/dx-graphics-dds-pguide)
+//
+
+#include "TextureImage.h"
+#include <cmath>
+
+namespace
+{
+	const unsigned int DDS_MAGIC = 0x20534444; // "DDS "
+	const unsigned int DDS_HEADER_SIZE = 124;
+	const unsigned int DDS_PIXEL_FORMAT_SIZE = 32;
+	const unsigned int DDSD_CAPS = 0x1;
+	const unsigned int DDSD_HEIGHT = 0x2;
+	const unsigned int DDSD_WIDTH = 0x4;
+	const unsigned int DDSD_PITCH = 0x8;
+	const unsigned int DDSD_PIXELFORMAT = 0x1000;
+	const unsigned int DDSD_MIPMAPCOUNT = 0x20000;
+	const unsigned int DDSD_LINEARSIZE = 0x80000;
+	const unsigned int DDSCAPS_COMPLEX = 0x8;
+	const unsigned int DDSCAPS_TEXTURE = 0x1000;
+	const unsigned int DDSCAPS_MIPMAP = 0x400000;
+	const unsigned int DDPF_ALPHAPIXELS = 0x1;
+	const unsigned int DDPF_FOURCC = 0x4;
+	const unsigned int DDPF_RGB = 0x40;
+	const unsigned int FOURCC_DXT1 = 0x31545844; // "DXT1"
+	const unsigned int FOURCC_DXT5 = 0x35545844; // "DXT5"
+	const unsigned int FOURCC_DX10 = 0x30315844; // "DX10"
+
+	void WriteUInt(unsigned char* data, unsigned int uiValue)
+	{
+		data[0] = (unsigned char)uiValue;
+		data[1] = (unsigned char)(uiValue >> 8);
+		data[2] = (unsigned char)(uiValue >> 16);
+		data[3] = (unsigned char)(uiValue >> 24);
+	}
+
+	// How the texels of a DXGI format are stored, or false if they can't be expanded to RGBA8
+	bool GetTextureFormat(DXGI_FORMAT dxgiFormat, TextureFormat& format, bool& bSwapRedBlue, bool& bOpaque)
+	{
+		format = RGBA8Format;
+		bSwapRedBlue = false;
+		bOpaque = false;
+
+		switch (dxgiFormat)
+		{
+		case DXGI_FORMAT_R8G8B8A8_UNORM:
+		case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+			return true;
+		case DXGI_FORMAT_B8G8R8A8_UNORM:
+		case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+			bSwapRedBlue = true;
+			return true;
+		case DXGI_FORMAT_B8G8R8X8_UNORM:
+		case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+			bSwapRedBlue = true;
+			bOpaque = true;
+			return true;
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+			format = BC1Format;
+			return true;
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB:
+			format = BC2Format;
+			return true;
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+			format = BC3Format;
+			return true;
+		case DXGI_FORMAT_BC4_UNORM:
+			format = BC4Format;
+			return true;
+		case DXGI_FORMAT_BC5_UNORM:
+			format = BC5Format;
+			return true;
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			format = BC7Format;
+			return true;
+		default:
+			return false; // Floating point (BC6H), signed, packed 16-bit and other formats are not supported
+		}
+	}
+}
+
+#pragma region Init
+
+TextureImage::TextureImage()
+{
+	m_iWidth = 0;
+	m_iHeight = 0;
+	m_format = RGBA8Format;
+}
+
+TextureImage::~TextureImage()
+{
+}
+
+bool TextureImage::LoadFromFile(const char* filename)
+{
+	// The file is mapped and each level is decoded straight from the mapping
+	DDSFile file;
+	if (FAILED(file.Open(filename)))
+	{
+		return false;
+	}
+
+	return Load(file);
+}
+
+bool TextureImage::LoadFromMemory(const unsigned char* data, size_t size)
+{
+	DDSFile file;
+	if (FAILED(file.Parse(data, size)))
+	{
+		return false;
+	}
+
+	return Load(file);
+}
+
+bool TextureImage::Load(const DDSFile& file)
+{
+	const DDSTextureInfo& info = file.GetInfo();
+	TextureFormat format;
+	bool bSwapRedBlue;
+	bool bOpaque;
+	if (info.dimension != DDS_DIMENSION_TEXTURE2D || info.isCubeMap || info.arraySize != 1 || !GetTextureFormat(info.format, format, bSwapRedBlue, bOpaque))
+	{
+		return false; // Only single 2D textures
+	}
+
+	m_iWidth = (int)info.width;
+	m_iHeight = (int)info.height;
+	m_format = format;
+	SetMipCount((int)info.mipCount);
+
+	for (int iLevel = 0; iLevel < GetMipCount(); iLevel++)
+	{
+		const DDSSubresource& subresource = file.GetSubresource(iLevel);
+		int iMipWidth = GetMipWidth(iLevel);
+		int iMipHeight = GetMipHeight(iLevel);
+		unsigned char* pixels = GetPixels(iLevel);
+
+		if (format != RGBA8Format)
+		{
+			if (!BlockCompressor::Decompress(subresource.data, iMipWidth, iMipHeight, format, pixels))
+			{
+				return false;
+			}
+			continue;
+		}
+
+		for (int y = 0; y < iMipHeight; y++)
+		{
+			const unsigned char* source = subresource.data + (size_t)y * subresource.rowPitch;
+			unsigned char* destination = pixels + (size_t)y * iMipWidth * 4;
+			for (int x = 0; x < iMipWidth; x++, source += 4, destination += 4)
+			{
+				destination[0] = source[bSwapRedBlue ? 2 : 0];
+				destination[1] = source[1];
+				destination[2] = source[bSwapRedBlue ? 0 : 2];
+				destination[3] = bOpaque ? 255 : source[3];
+			}
+		}
+	}
+
+	return true;
+}
+
+bool TextureImage::SaveToFile(const char* filename, TextureFormat format, QualityLevel quality, float* pRMSE)
+{
+	std::vector<unsigned char> data;
+	if (!SaveToMemory(data, format, quality, pRMSE))
+	{
+		return false;
+	}
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	return file.is_open() && file.write((const char*)data.data(), data.size());
+}
+
+bool TextureImage::SaveToMemory(std::vector<unsigned char>& output, TextureFormat format, QualityLevel quality, float* pRMSE)
+{
+	// BC2, BC4 and BC5 are only decoded, so there is no pixel format to write for them
+	if (m_mipLevels.empty() || (format != RGBA8Format && !BlockCompressor::CanCompress(format)))
+	{
+		return false;
+	}
+
+	// Compress every level up front so that nothing is written if it fails
+	std::vector<std::vector<unsigned char>> levelData(GetMipCount());
+	double dSquaredError = 0.0;
+	long long llTexelCount = 0;
+	for (int iLevel = 0; iLevel < GetMipCount(); iLevel++)
+	{
+		const std::vector<unsigned char>& pixels = m_mipLevels[iLevel];
+		if (format == RGBA8Format)
+		{
+			// Swizzle RGBA to BGRA
+			levelData[iLevel].resize(pixels.size());
+			for (size_t i = 0; i < pixels.size(); i += 4)
+			{
+				levelData[iLevel][i] = pixels[i + 2];
+				levelData[iLevel][i + 1] = pixels[i + 1];
+				levelData[iLevel][i + 2] = pixels[i];
+				levelData[iLevel][i + 3] = pixels[i + 3];
+			}
+		}
+		else
+		{
+			double dLevelError = 0.0;
+			if (!BlockCompressor::Compress(pixels.data(), GetMipWidth(iLevel), GetMipHeight(iLevel), format, quality, levelData[iLevel], &dLevelError))
+			{
+				return false;
+			}
+			dSquaredError += dLevelError;
+			llTexelCount += (long long)GetMipWidth(iLevel) * GetMipHeight(iLevel);
+		}
+	}
+	if (pRMSE)
+	{
+		*pRMSE = BlockCompressor::GetRMSE(dSquaredError, llTexelCount);
+	}
+
+	unsigned char header[4 + DDS_HEADER_SIZE] = {};
+	WriteUInt(header, DDS_MAGIC);
+	WriteUInt(header + 4, DDS_HEADER_SIZE);
+	WriteUInt(header + 8, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | (format == RGBA8Format ? DDSD_PITCH : DDSD_LINEARSIZE));
+	WriteUInt(header + 12, m_iHeight);
+	WriteUInt(header + 16, m_iWidth);
+	WriteUInt(header + 20, (format == RGBA8Format) ? m_iWidth * 4 : (unsigned int)levelData[0].size()); // Pitch or size of the top level
+	WriteUInt(header + 28, GetMipCount());
+
+	unsigned char* pixelFormat = header + 76;
+	WriteUInt(pixelFormat, DDS_PIXEL_FORMAT_SIZE);
+	switch (format)
+	{
+	case RGBA8Format:
+		// A8R8G8B8 (DXGI_FORMAT_B8G8R8A8_UNORM)
+		WriteUInt(pixelFormat + 4, DDPF_RGB | DDPF_ALPHAPIXELS);
+		WriteUInt(pixelFormat + 12, 32);
+		WriteUInt(pixelFormat + 16, 0x00ff0000);
+		WriteUInt(pixelFormat + 20, 0x0000ff00);
+		WriteUInt(pixelFormat + 24, 0x000000ff);
+		WriteUInt(pixelFormat + 28, 0xff000000);
+		break;
+	case BC1Format:
+		WriteUInt(pixelFormat + 4, DDPF_FOURCC);
+		WriteUInt(pixelFormat + 8, FOURCC_DXT1);
+		break;
+	case BC3Format:
+		WriteUInt(pixelFormat + 4, DDPF_FOURCC);
+		WriteUInt(pixelFormat + 8, FOURCC_DXT5);
+		break;
+	case BC7Format:
+		WriteUInt(pixelFormat + 4, DDPF_FOURCC);
+		WriteUInt(pixelFormat + 8, FOURCC_DX10); // BC7 has no legacy four character code
+		break;
+	default:
+		return false; // Rejected above
+	}
+
+	WriteUInt(header + 108, DDSCAPS_TEXTURE | (GetMipCount() > 1 ? DDSCAPS_MIPMAP | DDSCAPS_COMPLEX : 0));
+
+	output.insert(output.end(), header, header + sizeof(header));
+
+	if (format == BC7Format)
+	{
+		// DX10 extension header: format, dimension, misc flags, array size, misc flags 2
+		unsigned char extendedHeader[20] = {};
+		WriteUInt(extendedHeader, DXGI_FORMAT_BC7_UNORM);
+		WriteUInt(extendedHeader + 4, DDS_DIMENSION_TEXTURE2D);
+		WriteUInt(extendedHeader + 12, 1);
+		output.insert(output.end(), extendedHeader, extendedHeader + sizeof(extendedHeader));
+	}
+
+	for (auto& data : levelData)
+	{
+		output.insert(output.end(), data.begin(), data.end());
+	}
+
+	return true;
+}
+
+void TextureImage::SetSize(int iWidth, int iHeight)
+{
+	m_iWidth = iWidth;
+	m_iHeight = iHeight;
+	m_format = RGBA8Format;
+	m_mipLevels.clear();
+	SetMipCount(1);
+}
+
+#pragma endregion
+
+#pragma region Setters/Getters
+
+int TextureImage::GetWidth() const
+{
+	return m_iWidth;
+}
+
+int TextureImage::GetHeight() const
+{
+	return m_iHeight;
+}
+
+TextureFormat TextureImage::GetFormat() const
+{
+	return m_format;
+}
+
+int TextureImage::GetMipCount() const
+{
+	return (int)m_mipLevels.size();
+}
+
+int TextureImage::GetMipWidth(int iLevel) const
+{
+	int iWidth = m_iWidth >> iLevel;
+	return (iWidth > 0) ? iWidth : 1;
+}
+
+int TextureImage::GetMipHeight(int iLevel) const
+{
+	int iHeight = m_iHeight >> iLevel;
+	return (iHeight > 0) ? iHeight : 1;
+}
+
+void TextureImage::SetMipCount(int iCount)
+{
+	m_mipLevels.resize(iCount);
+	for (int iLevel = 0; iLevel < iCount; iLevel++)
+	{
+		m_mipLevels[iLevel].resize((size_t)GetMipWidth(iLevel) * GetMipHeight(iLevel) * 4);
+	}
+}
+
+unsigned char* TextureImage::GetPixels(int iLevel)
+{
+	return m_mipLevels[iLevel].data();
+}
+
+const unsigned char* TextureImage::GetPixels(int iLevel) const
+{
+	return m_mipLevels[iLevel].data();
+}
+
+const unsigned char* TextureImage::GetPixel(int x, int y, int iLevel) const
+{
+	return &m_mipLevels[iLevel][((size_t)y * GetMipWidth(iLevel) + x) * 4];
+}
+
+XMVECTOR TextureImage::Sample(float u, float v, int iLevel, bool bWrap) const
+{
+	int iWidth = GetMipWidth(iLevel);
+	int iHeight = GetMipHeight(iLevel);
+
+	// Texel centers lie at half texel offsets
+	float x = u * iWidth - 0.5f;
+	float y = v * iHeight - 0.5f;
+	int x0 = (int)floorf(x);
+	int y0 = (int)floorf(y);
+
+	XMVECTOR vTexels[4];
+	for (int i = 0; i < 4; i++)
+	{
+		int tx = x0 + (i & 1);
+		int ty = y0 + (i >> 1);
+		if (bWrap)
+		{
+			tx = ((tx % iWidth) + iWidth) % iWidth;
+			ty = ((ty % iHeight) + iHeight) % iHeight;
+		}
+		else
+		{
+			tx = (std::min)((std::max)(tx, 0), iWidth - 1);
+			ty = (std::min)((std::max)(ty, 0), iHeight - 1);
+		}
+
+		const unsigned char* texel = GetPixel(tx, ty, iLevel);
+		vTexels[i] = XMVectorSet(texel[0], texel[1], texel[2], texel[3]);
+	}
+
+	XMVECTOR vTop = XMVectorLerp(vTexels[0], vTexels[1], x - x0);
+	XMVECTOR vBottom = XMVectorLerp(vTexels[2], vTexels[3], x - x0);
+	return XMVectorLerp(vTop, vBottom, y - y0) * (1.0f / 255.0f);
+}
+
+#pragma endregion
@@ -0,0 +1,53 @@
+//
+// TextureImage.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Programming Guide for DDS (https://docs.microsoft.com/en-us/windows/desktop/direct3ddds/dx-graphics-dds-pguide)
+//
+
+#ifndef TEXTURE_IMAGE_H
+#define TEXTURE_IMAGE_H
+
+#include <fstream>
+#include <vector>
+#include "BlockCompressor.h"
+#include "DDSFile.h"
+
+// CPU copy of a DDS texture and its mip chain, expanded to 8-bit RGBA, for import-time processing
+class TextureImage
+{
+public:
+	TextureImage();
+	~TextureImage();
+
+	bool LoadFromFile(const char* filename); // 8-bit RGBA/BGRA and BC1-BC5/BC7 DDS files; block compressed levels are decoded
+	bool LoadFromMemory(const unsigned char* data, size_t size); // A DDS file already in memory (for example an archive entry)
+	bool SaveToFile(const char* filename, TextureFormat format = RGBA8Format, QualityLevel quality = HighQuality, float* pRMSE = nullptr); // Writes every mip level; pRMSE receives the compression error
+	bool SaveToMemory(std::vector<unsigned char>& output, TextureFormat format = RGBA8Format, QualityLevel quality = HighQuality, float* pRMSE = nullptr); // Appends the file SaveToFile would write
+	void SetSize(int iWidth, int iHeight);	 // Discards the contents and allocates a single level
+
+	int GetWidth() const;
+	int GetHeight() const;
+	TextureFormat GetFormat() const; // How the loaded file stored its texels
+	int GetMipCount() const;
+	int GetMipWidth(int iLevel) const;
+	int GetMipHeight(int iLevel) const;
+	void SetMipCount(int iCount); // Keeps the top level and allocates (or drops) the levels below it
+
+	// Four bytes per texel (R, G, B, A), rows top to bottom
+	unsigned char* GetPixels(int iLevel = 0);
+	const unsigned char* GetPixels(int iLevel = 0) const;
+	const unsigned char* GetPixel(int x, int y, int iLevel = 0) const;
+	XMVECTOR Sample(float u, float v, int iLevel = 0, bool bWrap = true) const; // Bilinear, channels in [0, 1] as stored (no sRGB conversion)
+
+private:
+	int m_iWidth;
+	int m_iHeight;
+	TextureFormat m_format;
+	std::vector<std::vector<unsigned char>> m_mipLevels;
+
+	bool Load(const DDSFile& file);
+};
+
+#endif
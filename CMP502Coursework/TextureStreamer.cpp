@@ -0,0 +1,510 @@
+//
+// TextureStreamer.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Texture Streaming in Unreal Engine 4 (https://docs.unrealengine.com/en-us/Engine/Content/Types/Textures/Streaming)
+// Mip-Map Level Selection for Texture Mapping (Ewins et al., 1998)
+//
+
+#include "TextureStreamer.h"
+#include <cstring>
+
+#pragma region Init
+
+TextureStreamer::TextureStreamer()
+{
+	m_pDevice = nullptr;
+	m_pImmediateContext = nullptr;
+	m_budget = 0;
+	m_residentBytes = 0;
+	m_pendingBytes = 0;
+	m_iBaseSize = 64;
+	m_uiFrame = 0;
+	m_bStopping = false;
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_condition.notify_all();
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+
+	for (auto pRequest : m_requests)
+	{
+		SAFE_DELETE(pRequest);
+	}
+	for (auto pRequest : m_completedRequests)
+	{
+		SAFE_DELETE(pRequest);
+	}
+	for (auto& texture : m_textures)
+	{
+		SAFE_RELEASE(texture.pTextureView);
+		SAFE_RELEASE(texture.pTexture);
+	}
+}
+
+bool TextureStreamer::Initialize(ID3D11Device* device, ID3D11DeviceContext* immediateContext, size_t budget, int iThreadCount)
+{
+	m_pDevice = device;
+	m_pImmediateContext = immediateContext;
+	m_budget = budget;
+
+	for (int i = 0; i < (std::max)(iThreadCount, 1); i++)
+	{
+		m_workers.emplace_back(&TextureStreamer::WorkerThread, this);
+	}
+
+	return true;
+}
+
+int TextureStreamer::AddTexture(const char* filename)
+{
+	return AddTextureArray(std::vector<std::string>(1, filename));
+}
+
+int TextureStreamer::AddTextureArray(const std::vector<std::string>& filenames, const AssetArchive* pArchive)
+{
+	if (filenames.empty())
+	{
+		return -1;
+	}
+
+	StreamedTexture texture;
+	for (const auto& filename : filenames)
+	{
+		// Archive entries stored uncompressed are parsed in place in the archive's mapping
+		std::unique_ptr<DDSFile> file(new DDSFile());
+		if (pArchive && pArchive->Contains(filename.c_str()))
+		{
+			std::vector<unsigned char> buffer;
+			size_t size = 0;
+			const unsigned char* data = pArchive->Load(filename.c_str(), &size, buffer);
+			if (!data || FAILED(file->Parse(data, size)))
+			{
+				return -1;
+			}
+			texture.fileData.push_back(std::move(buffer)); // Moving keeps the data where it is
+		}
+		else if (FAILED(file->Open(filename.c_str())))
+		{
+			return -1;
+		}
+
+		const DDSTextureInfo& sliceInfo = file->GetInfo();
+		if (sliceInfo.dimension != DDS_DIMENSION_TEXTURE2D || sliceInfo.isCubeMap || sliceInfo.arraySize != 1)
+		{
+			return -1; // Only single 2D textures are streamed
+		}
+
+		if (!texture.files.empty())
+		{
+			const DDSTextureInfo& firstInfo = texture.files[0]->GetInfo();
+			if (sliceInfo.format != firstInfo.format || sliceInfo.width != firstInfo.width || sliceInfo.height != firstInfo.height || sliceInfo.mipCount != firstInfo.mipCount)
+			{
+				return -1;
+			}
+		}
+		texture.files.push_back(std::move(file));
+	}
+
+	DDSTextureInfo info = texture.files[0]->GetInfo();
+	texture.filename = filenames[0];
+	texture.bBlockCompressed = (info.format >= DXGI_FORMAT_BC1_TYPELESS && info.format <= DXGI_FORMAT_BC5_SNORM) || (info.format >= DXGI_FORMAT_BC6H_TYPELESS && info.format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+	texture.pTexture = nullptr;
+	texture.pTextureView = nullptr;
+	texture.iPendingMip = -1;
+	for (size_t i = 0; i < info.mipCount; i++)
+	{
+		texture.levelSizes.push_back(texture.files[0]->GetSubresource(i).slicePitch);
+	}
+
+	// Start from the most detailed level that fits the base size (or the least detailed one allowed)
+	int iMipCount = (int)info.mipCount;
+	texture.iBaseMip = 0;
+	for (int iLevel = 0; iLevel < iMipCount; iLevel++)
+	{
+		if (CanBeTopMip(texture, iLevel))
+		{
+			texture.iBaseMip = iLevel;
+			if ((int)((std::max)(info.width, info.height) >> iLevel) <= m_iBaseSize)
+			{
+				break;
+			}
+		}
+	}
+	texture.iNextRequest = texture.iBaseMip;
+
+	TextureResidency& residency = texture.residency;
+	residency.iWidth = (int)info.width;
+	residency.iHeight = (int)info.height;
+	residency.iMipCount = iMipCount;
+	residency.iResidentMip = iMipCount; // Nothing yet
+	residency.iRequestedMip = texture.iBaseMip;
+	residency.bStreaming = false;
+	residency.residentBytes = 0;
+	residency.fullBytes = GetBytes(texture, 0);
+	residency.uiLastUsedFrame = m_uiFrame;
+
+	m_textures.push_back(std::move(texture));
+
+	int iTexture = (int)m_textures.size() - 1;
+	if (!SetResidentMip(iTexture, m_textures[iTexture].iBaseMip, nullptr))
+	{
+		m_textures.pop_back();
+		return -1;
+	}
+
+	return iTexture;
+}
+
+#pragma endregion
+
+#pragma region Setters/Getters
+
+void TextureStreamer::RequestMip(int iTexture, int iLevel)
+{
+	StreamedTexture& texture = m_textures[iTexture];
+	texture.iNextRequest = (std::min)(texture.iNextRequest, iLevel);
+}
+
+ID3D11ShaderResourceView* TextureStreamer::GetTexture(int iTexture)
+{
+	return m_textures[iTexture].pTextureView;
+}
+
+int TextureStreamer::GetTextureCount()
+{
+	return (int)m_textures.size();
+}
+
+const TextureResidency& TextureStreamer::GetResidency(int iTexture)
+{
+	return m_textures[iTexture].residency;
+}
+
+size_t TextureStreamer::GetResidentBytes()
+{
+	return m_residentBytes;
+}
+
+void TextureStreamer::SetBudget(size_t budget)
+{
+	m_budget = budget;
+}
+
+size_t TextureStreamer::GetBudget()
+{
+	return m_budget;
+}
+
+void TextureStreamer::SetBaseSize(int iSize)
+{
+	m_iBaseSize = iSize;
+}
+
+bool TextureStreamer::CanBeTopMip(const StreamedTexture& texture, int iLevel)
+{
+	if (!texture.bBlockCompressed)
+	{
+		return true;
+	}
+
+	const DDSSubresource& level = texture.files[0]->GetSubresource(iLevel);
+	return (level.width % 4 == 0) && (level.height % 4 == 0);
+}
+
+size_t TextureStreamer::GetBytes(const StreamedTexture& texture, int iTopMip)
+{
+	size_t bytes = 0;
+	for (size_t i = iTopMip; i < texture.levelSizes.size(); i++)
+	{
+		bytes += texture.levelSizes[i];
+	}
+	return bytes * texture.files.size();
+}
+
+#pragma endregion
+
+#pragma region Update
+
+void TextureStreamer::Update()
+{
+	m_uiFrame++;
+
+	// Upload the levels that were read since the last update
+	std::deque<StreamRequest*> completedRequests;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		completedRequests.swap(m_completedRequests);
+	}
+	for (auto pRequest : completedRequests)
+	{
+		StreamedTexture& texture = m_textures[pRequest->iTexture];
+		m_pendingBytes -= pRequest->bytes;
+		texture.iPendingMip = -1;
+		texture.residency.bStreaming = false;
+
+		if (SetResidentMip(pRequest->iTexture, pRequest->iTopMip, pRequest))
+		{
+			Utils::Log("Streamed in " + texture.filename + " from mip " + std::to_string(pRequest->iTopMip) + " (" + std::to_string(m_residentBytes / 1024) + " KB resident)");
+		}
+		SAFE_DELETE(pRequest);
+	}
+
+	// Settle this frame's requests on levels a texture can start at, keeping at least the detail that was asked for
+	std::vector<int> shortfalls;
+	for (int i = 0; i < (int)m_textures.size(); i++)
+	{
+		StreamedTexture& texture = m_textures[i];
+		TextureResidency& residency = texture.residency;
+
+		int iRequestedMip = (std::max)(0, (std::min)(texture.iNextRequest, texture.iBaseMip));
+		while (iRequestedMip > 0 && !CanBeTopMip(texture, iRequestedMip))
+		{
+			iRequestedMip--;
+		}
+		residency.iRequestedMip = iRequestedMip;
+		texture.iNextRequest = texture.iBaseMip; // Textures nobody asks for fall back to the base level
+
+		// A texture only ages while it holds more detail than it needs
+		if (iRequestedMip <= residency.iResidentMip)
+		{
+			residency.uiLastUsedFrame = m_uiFrame;
+		}
+		if (iRequestedMip < residency.iResidentMip && texture.iPendingMip == -1)
+		{
+			shortfalls.push_back(i);
+		}
+	}
+
+	// Serve the textures missing the most levels first
+	std::sort(shortfalls.begin(), shortfalls.end(), [this](int a, int b)
+	{
+		const TextureResidency& residencyA = m_textures[a].residency;
+		const TextureResidency& residencyB = m_textures[b].residency;
+		return residencyA.iResidentMip - residencyA.iRequestedMip > residencyB.iResidentMip - residencyB.iRequestedMip;
+	});
+
+	for (int iTexture : shortfalls)
+	{
+		StreamedTexture& texture = m_textures[iTexture];
+		int iTopMip = GetAffordableMip(iTexture, texture.residency.iRequestedMip);
+		if (iTopMip >= texture.residency.iResidentMip)
+		{
+			continue;
+		}
+
+		StreamRequest* pRequest = new StreamRequest();
+		pRequest->iTexture = iTexture;
+		for (const auto& file : texture.files)
+		{
+			pRequest->files.push_back(file.get());
+		}
+		pRequest->iTopMip = iTopMip;
+		pRequest->iResidentMip = texture.residency.iResidentMip;
+		pRequest->bytes = GetBytes(texture, iTopMip) - texture.residency.residentBytes;
+
+		m_pendingBytes += pRequest->bytes;
+		texture.iPendingMip = iTopMip;
+		texture.residency.bStreaming = true;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_requests.push_back(pRequest);
+		}
+		m_condition.notify_one();
+	}
+}
+
+int TextureStreamer::GetAffordableMip(int iTexture, int iTopMip)
+{
+	StreamedTexture& texture = m_textures[iTexture];
+	int iResidentMip = texture.residency.iResidentMip;
+
+	for (int iLevel = iTopMip; iLevel < iResidentMip; iLevel++)
+	{
+		if (!CanBeTopMip(texture, iLevel))
+		{
+			continue;
+		}
+
+		// Make room by trimming other textures, but settle for fewer levels rather than fail outright
+		size_t requiredBytes = GetBytes(texture, iLevel) - texture.residency.residentBytes;
+		if (Evict(requiredBytes, iTexture))
+		{
+			return iLevel;
+		}
+	}
+
+	return iResidentMip;
+}
+
+bool TextureStreamer::Evict(size_t requiredBytes, int iExcludedTexture)
+{
+	while (m_residentBytes + m_pendingBytes + requiredBytes > m_budget)
+	{
+		// Least recently used texture holding levels it no longer needs
+		int iVictim = -1;
+		for (int i = 0; i < (int)m_textures.size(); i++)
+		{
+			const StreamedTexture& texture = m_textures[i];
+			if (i == iExcludedTexture || texture.iPendingMip != -1 || texture.residency.iRequestedMip <= texture.residency.iResidentMip)
+			{
+				continue;
+			}
+
+			if (iVictim == -1 || texture.residency.uiLastUsedFrame < m_textures[iVictim].residency.uiLastUsedFrame)
+			{
+				iVictim = i;
+			}
+		}
+		if (iVictim == -1)
+		{
+			return false;
+		}
+
+		StreamedTexture& victim = m_textures[iVictim];
+		int iOldResidentMip = victim.residency.iResidentMip;
+		if (!SetResidentMip(iVictim, victim.residency.iRequestedMip, nullptr))
+		{
+			return false;
+		}
+		Utils::Log("Evicted mips " + std::to_string(iOldResidentMip) + "-" + std::to_string(victim.residency.iResidentMip - 1) + " of " + victim.filename);
+	}
+
+	return true;
+}
+
+bool TextureStreamer::SetResidentMip(int iTexture, int iTopMip, const StreamRequest* pRequest)
+{
+	StreamedTexture& texture = m_textures[iTexture];
+	const DDSTextureInfo& info = texture.files[0]->GetInfo();
+	int iOldTopMip = texture.residency.iResidentMip;
+	int iLevelCount = (int)info.mipCount - iTopMip;
+	int iOldLevelCount = (int)info.mipCount - iOldTopMip;
+	int iSliceCount = (int)texture.files.size();
+
+	// D3D11 textures can't change their level count, so build a new one holding levels [iTopMip, mipCount)
+	const DDSSubresource& topLevel = texture.files[0]->GetSubresource(iTopMip);
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = (UINT)topLevel.width;
+	textureDesc.Height = (UINT)topLevel.height;
+	textureDesc.MipLevels = (UINT)iLevelCount;
+	textureDesc.ArraySize = (UINT)iSliceCount;
+	textureDesc.Format = info.format;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	ID3D11Texture2D* pTexture = nullptr;
+	HRESULT result = m_pDevice->CreateTexture2D(&textureDesc, nullptr, &pTexture);
+	if (FAILED(result))
+	{
+		Utils::Log("Failed to create streamed texture " + texture.filename);
+		return false;
+	}
+
+	for (int iSlice = 0; iSlice < iSliceCount; iSlice++)
+	{
+		for (int iLevel = iTopMip; iLevel < (int)info.mipCount; iLevel++)
+		{
+			UINT uiDestination = D3D11CalcSubresource(iLevel - iTopMip, iSlice, iLevelCount);
+			if (texture.pTexture && iLevel >= iOldTopMip)
+			{
+				// Already on the GPU
+				m_pImmediateContext->CopySubresourceRegion(pTexture, uiDestination, 0, 0, 0, texture.pTexture, D3D11CalcSubresource(iLevel - iOldTopMip, iSlice, iOldLevelCount), nullptr);
+			}
+			else
+			{
+				// Levels streamed in come from the worker's copy; the base levels are uploaded straight from the mapping
+				const DDSSubresource& level = texture.files[iSlice]->GetSubresource(iLevel);
+				const unsigned char* data = pRequest ? &pRequest->data[pRequest->levelOffsets[iSlice * (pRequest->iResidentMip - iTopMip) + iLevel - iTopMip]] : level.data;
+				m_pImmediateContext->UpdateSubresource(pTexture, uiDestination, nullptr, data, (UINT)level.rowPitch, (UINT)level.slicePitch);
+			}
+		}
+	}
+
+	// Always an array view, so that one shader samples single textures and packed ones alike
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+	viewDesc.Format = info.format;
+	viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+	viewDesc.Texture2DArray.MostDetailedMip = 0;
+	viewDesc.Texture2DArray.MipLevels = (UINT)iLevelCount;
+	viewDesc.Texture2DArray.FirstArraySlice = 0;
+	viewDesc.Texture2DArray.ArraySize = (UINT)iSliceCount;
+
+	ID3D11ShaderResourceView* pTextureView = nullptr;
+	result = m_pDevice->CreateShaderResourceView(pTexture, &viewDesc, &pTextureView);
+	if (FAILED(result))
+	{
+		SAFE_RELEASE(pTexture);
+		Utils::Log("Failed to create streamed texture view " + texture.filename);
+		return false;
+	}
+
+	SAFE_RELEASE(texture.pTextureView);
+	SAFE_RELEASE(texture.pTexture);
+	texture.pTexture = pTexture;
+	texture.pTextureView = pTextureView;
+
+	size_t residentBytes = GetBytes(texture, iTopMip);
+	m_residentBytes = m_residentBytes - texture.residency.residentBytes + residentBytes;
+	texture.residency.residentBytes = residentBytes;
+	texture.residency.iResidentMip = iTopMip;
+
+	return true;
+}
+
+void TextureStreamer::WorkerThread()
+{
+	for (;;)
+	{
+		StreamRequest* pRequest = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this] { return m_bStopping || !m_requests.empty(); });
+			if (m_bStopping)
+			{
+				return;
+			}
+			pRequest = m_requests.front();
+			m_requests.pop_front();
+		}
+
+		// Copying the levels out of the mappings is what reads them from disk
+		size_t size = 0;
+		for (const DDSFile* pFile : pRequest->files)
+		{
+			for (int iLevel = pRequest->iTopMip; iLevel < pRequest->iResidentMip; iLevel++)
+			{
+				pRequest->levelOffsets.push_back(size);
+				size += pFile->GetSubresource(iLevel).slicePitch;
+			}
+		}
+		pRequest->data.resize(size);
+		int iLevelCount = pRequest->iResidentMip - pRequest->iTopMip;
+		for (int iSlice = 0; iSlice < (int)pRequest->files.size(); iSlice++)
+		{
+			for (int iLevel = pRequest->iTopMip; iLevel < pRequest->iResidentMip; iLevel++)
+			{
+				const DDSSubresource& level = pRequest->files[iSlice]->GetSubresource(iLevel);
+				memcpy(&pRequest->data[pRequest->levelOffsets[iSlice * iLevelCount + iLevel - pRequest->iTopMip]], level.data, level.slicePitch);
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_completedRequests.push_back(pRequest);
+		}
+	}
+}
+
+#pragma endregion
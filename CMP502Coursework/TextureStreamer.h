@@ -0,0 +1,116 @@
+//
+// TextureStreamer.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Texture Streaming in Unreal Engine 4 (https://docs.unrealengine.com/en-us/Engine/Content/Types/Textures/Streaming)
+// Mip-Map Level Selection for Texture Mapping (Ewins et al., 1998)
+//
+
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <d3d11.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AssetArchive.h"
+#include "DDSFile.h"
+#include "Utils.h"
+
+using namespace DirectX;
+
+struct TextureResidency
+{
+	int iWidth;				  // Of the most detailed level
+	int iHeight;
+	int iMipCount;
+	int iResidentMip;		  // Most detailed level on the GPU
+	int iRequestedMip;		  // Most detailed level asked for by the last update
+	bool bStreaming;		  // Levels are being read on a background thread
+	size_t residentBytes;
+	size_t fullBytes;		  // Size with every level resident
+	unsigned int uiLastUsedFrame; // Last update in which every resident level was needed
+};
+
+// Keeps only the mip levels that are needed on the GPU, reading more detailed ones from memory mapped DDS files on background threads
+// Each update, textures whose extra levels are no longer needed are trimmed (least recently used first) until the requests fit in the budget
+class TextureStreamer
+{
+public:
+	TextureStreamer();
+	~TextureStreamer();
+
+	bool Initialize(ID3D11Device* device, ID3D11DeviceContext* immediateContext, size_t budget, int iThreadCount = 1);
+	int AddTexture(const char* filename); // Loads the levels no larger than the base size; returns the texture index, or -1 on failure
+	// Each file becomes a slice; they must share format, size and mip count
+	// Files held by the archive are read from it, so it must stay open while the texture is streamed
+	int AddTextureArray(const std::vector<std::string>& filenames, const AssetArchive* pArchive = nullptr);
+	void RequestMip(int iTexture, int iLevel); // The most detailed request since the last update wins
+	void Update(); // Once per frame: uploads finished reads, evicts, then starts new reads
+
+	ID3D11ShaderResourceView* GetTexture(int iTexture); // Texture2DArray view (single textures have one slice); replaced whenever the resident levels change
+	int GetTextureCount();
+	const TextureResidency& GetResidency(int iTexture);
+	size_t GetResidentBytes();
+	void SetBudget(size_t budget); // Bytes of texture memory
+	size_t GetBudget();
+	void SetBaseSize(int iSize); // Largest level loaded up front (and never evicted), in texels; applies to textures added afterwards
+
+private:
+	struct StreamedTexture
+	{
+		std::vector<std::unique_ptr<DDSFile>> files; // One per slice; they stay mapped for as long as the texture is streamed
+		std::vector<std::vector<unsigned char>> fileData; // Archive entries that had to be decompressed, which their files point into
+		std::string filename; // Of the first slice, for logging
+		bool bBlockCompressed;
+		ID3D11Texture2D* pTexture;
+		ID3D11ShaderResourceView* pTextureView;
+		int iBaseMip;	  // Least detailed level that is allowed to be resident
+		int iPendingMip;  // Level being read, or -1
+		int iNextRequest; // Most detailed request since the last update
+		std::vector<size_t> levelSizes; // Of one slice
+		TextureResidency residency;
+	};
+
+	// Levels [iTopMip, iResidentMip) of every slice of one texture, copied out of the mappings by a worker thread so the page faults happen off the render thread
+	struct StreamRequest
+	{
+		int iTexture;
+		std::vector<const DDSFile*> files;
+		int iTopMip;
+		int iResidentMip;
+		size_t bytes; // Added to the resident size once uploaded
+		std::vector<unsigned char> data;
+		std::vector<size_t> levelOffsets; // Slice by slice, then level by level
+	};
+
+	ID3D11Device* m_pDevice;
+	ID3D11DeviceContext* m_pImmediateContext;
+	std::vector<StreamedTexture> m_textures;
+	size_t m_budget;
+	size_t m_residentBytes;
+	size_t m_pendingBytes; // Requested but not yet resident
+	int m_iBaseSize;
+	unsigned int m_uiFrame;
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque<StreamRequest*> m_requests;
+	std::deque<StreamRequest*> m_completedRequests;
+	bool m_bStopping;
+
+	bool SetResidentMip(int iTexture, int iTopMip, const StreamRequest* pRequest);
+	bool CanBeTopMip(const StreamedTexture& texture, int iLevel); // Block compressed textures must start with a whole number of blocks
+	int GetAffordableMip(int iTexture, int iTopMip); // Most detailed level from iTopMip down that fits in the budget after evicting
+	size_t GetBytes(const StreamedTexture& texture, int iTopMip);
+	bool Evict(size_t requiredBytes, int iExcludedTexture); // Trims least recently used textures down to their requested level until requiredBytes more fit
+	void WorkerThread();
+};
+
+#endif
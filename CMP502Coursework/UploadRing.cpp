@@ -0,0 +1,104 @@
+//
+// UploadRing.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// How to: Use dynamic resources (https://docs.microsoft.com/en-us/windows/desktop/direct3d11/how-to--use-dynamic-resources)
+// ID3D11DeviceContext::Map (https://docs.microsoft.com/en-us/windows/desktop/api/d3d11/nf-d3d11-id3d11devicecontext-map)
+//
+
+#include "UploadRing.h"
+
+#pragma region Init
+
+UploadRing::UploadRing()
+{
+	m_pBuffer = nullptr;
+	m_uiSize = 0;
+	m_uiOffset = 0;
+	m_iDiscardCount = 0;
+}
+
+UploadRing::~UploadRing()
+{
+	SAFE_RELEASE(m_pBuffer);
+}
+
+bool UploadRing::Initialize(ID3D11Device* device, UINT uiSize)
+{
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.ByteWidth = uiSize;
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Dynamic buffers need a bind flag, though the ring is only ever copied from
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+	HRESULT result = device->CreateBuffer(&bufferDesc, nullptr, &m_pBuffer);
+	if (FAILED(result))
+	{
+		Utils::ShowError("Failed to create upload ring buffer.", result);
+		return false;
+	}
+
+	m_uiSize = uiSize;
+	m_uiOffset = uiSize; // The first write discards, as the buffer starts out undefined
+	return true;
+}
+
+#pragma endregion
+
+#pragma region Setters/Getters
+
+ID3D11Buffer* UploadRing::GetBuffer()
+{
+	return m_pBuffer;
+}
+
+UINT UploadRing::GetSize()
+{
+	return m_uiSize;
+}
+
+int UploadRing::GetDiscardCount()
+{
+	return m_iDiscardCount;
+}
+
+#pragma endregion
+
+#pragma region Render
+
+unsigned char* UploadRing::Map(ID3D11DeviceContext* immediateContext, UINT uiSize, UINT* puiOffset)
+{
+	if (!m_pBuffer || uiSize == 0 || uiSize > m_uiSize)
+	{
+		return nullptr;
+	}
+
+	// Append after the last write, or start over in fresh memory when the ring is full
+	D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (uiSize > m_uiSize - m_uiOffset)
+	{
+		mapType = D3D11_MAP_WRITE_DISCARD;
+		m_uiOffset = 0;
+		m_iDiscardCount++;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	HRESULT result = immediateContext->Map(m_pBuffer, 0, mapType, 0, &mappedResource);
+	if (FAILED(result))
+	{
+		Utils::ShowError("Failed to map the upload ring buffer.", result);
+		return nullptr;
+	}
+
+	*puiOffset = m_uiOffset;
+	m_uiOffset += uiSize;
+	return (unsigned char*)mappedResource.pData + *puiOffset;
+}
+
+void UploadRing::Unmap(ID3D11DeviceContext* immediateContext)
+{
+	immediateContext->Unmap(m_pBuffer, 0);
+}
+
+#pragma endregion
@@ -0,0 +1,40 @@
+//
+// UploadRing.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// How to: Use dynamic resources (https://docs.microsoft.com/en-us/windows/desktop/direct3d11/how-to--use-dynamic-resources)
+// ID3D11DeviceContext::Map (https://docs.microsoft.com/en-us/windows/desktop/api/d3d11/nf-d3d11-id3d11devicecontext-map)
+//
+
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include <d3d11.h>
+#include "Utils.h"
+
+// Dynamic buffer that CPU data passes through on its way into default buffers (copied there on the GPU)
+// Writes are appended with D3D11_MAP_WRITE_NO_OVERWRITE, so they never wait for copies still reading earlier data,
+// and the ring is discarded when it wraps, which has the driver hand back memory the GPU is done with
+class UploadRing
+{
+public:
+	UploadRing();
+	~UploadRing();
+
+	bool Initialize(ID3D11Device* device, UINT uiSize);
+	unsigned char* Map(ID3D11DeviceContext* immediateContext, UINT uiSize, UINT* puiOffset); // Space for uiSize bytes at *puiOffset in the buffer, or nullptr if it doesn't fit in the ring
+	void Unmap(ID3D11DeviceContext* immediateContext);
+
+	ID3D11Buffer* GetBuffer();
+	UINT GetSize();
+	int GetDiscardCount(); // Times the ring has wrapped
+
+private:
+	ID3D11Buffer* m_pBuffer;
+	UINT m_uiSize;
+	UINT m_uiOffset; // Where the next write goes
+	int m_iDiscardCount;
+};
+
+#endif
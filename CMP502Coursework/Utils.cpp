@@ -5,8 +5,15 @@
 
 #include "Utils.h"
 
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/stat.h>
+#include <cstdio>
+#endif
+
 void Utils::ShowError(LPCTSTR message, HRESULT result)
 {
+#ifdef _WIN32
 	_com_error error(result);
 	LPCTSTR errorMessage = error.ErrorMessage();
 
@@ -14,4 +21,55 @@ void Utils::ShowError(LPCTSTR message, HRESULT result)
 	text = std::string(message) + "\n\n" + std::string(errorMessage);
 
 	MessageBox(0, text.c_str(), "", 0);
+#else
+	fprintf(stderr, "%s (0x%08X)\n", message, (unsigned int)result);
+#endif
+}
+
+void Utils::Log(const std::string& message)
+{
+#ifdef _WIN32
+	OutputDebugString((message + "\n").c_str());
+#else
+	fprintf(stderr, "%s\n", message.c_str());
+#endif
+}
+
+bool Utils::ListFiles(const char* directory, std::vector<std::string>& filenames)
+{
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	HANDLE hFind = FindFirstFileA((std::string(directory) + "/*").c_str(), &findData);
+	if (hFind == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	do
+	{
+		if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+		{
+			filenames.push_back(findData.cFileName);
+		}
+	} while (FindNextFileA(hFind, &findData));
+	FindClose(hFind);
+#else
+	DIR* pDirectory = opendir(directory);
+	if (!pDirectory)
+	{
+		return false;
+	}
+	while (dirent* pEntry = readdir(pDirectory))
+	{
+		struct stat fileInfo;
+		if (stat((std::string(directory) + "/" + pEntry->d_name).c_str(), &fileInfo) == 0 && S_ISREG(fileInfo.st_mode))
+		{
+			filenames.push_back(pEntry->d_name);
+		}
+	}
+	closedir(pDirectory);
+#endif
+
+	// Sorted so that the results don't depend on the file system
+	std::sort(filenames.begin(), filenames.end());
+	return true;
 }
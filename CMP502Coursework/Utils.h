@@ -6,9 +6,17 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#ifdef _WIN32
 #include <winerror.h>
 #include <comdef.h> 
+#else
+#include <wsl/winadapter.h> // HRESULT from the DirectX-Headers package, for the tools that also build on Linux
+typedef const char* LPCTSTR;
+#endif
+#include <algorithm>
 #include <string>
+#include <thread>
+#include <vector>
 
 #define COLOR_F4(r, g, b, a)	{ r/255.0f, g/255.0f, b/255.0f, a };
 #define COLOR_XMF4(r, g, b, a)	XMFLOAT4(r/255.0f, g/255.0f, b/255.0f, a)
@@ -17,10 +25,55 @@
 #define SAFE_DELETE(p)			{ if (p) { delete p; p = nullptr; } }
 #define SAFE_DELETE_ARRAY(p)	{ if (p) { delete[] p; p = nullptr; } }
 
+enum QualityLevel : int
+{
+	LowQuality = 0,
+	MediumQuality,
+	HighQuality
+};
+
 class Utils
 {
 public:
 	static void ShowError(LPCTSTR message, HRESULT result);
+	static void Log(const std::string& message); // Writes to the debugger output window (standard error elsewhere)
+	static bool ListFiles(const char* directory, std::vector<std::string>& filenames); // Names of the files directly inside, sorted
+	template <typename Function> static void ParallelFor(int iCount, int iThreadCount, Function function, int iMinParallelCount = 64); // iThreadCount 0 uses every core; smaller counts stay on the calling thread
 };
 
+template <typename Function>
+void Utils::ParallelFor(int iCount, int iThreadCount, Function function, int iMinParallelCount)
+{
+	// Split [0, iCount) into contiguous batches, one per thread (the calling thread takes the first batch)
+	if (iThreadCount <= 0)
+	{
+		iThreadCount = (std::max)(1, (int)std::thread::hardware_concurrency());
+	}
+	if (iThreadCount == 1 || iCount < (std::max)(iMinParallelCount, 2))
+	{
+		function(0, iCount);
+		return;
+	}
+
+	int iBatchSize = (iCount + iThreadCount - 1) / iThreadCount;
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < iThreadCount; i++)
+	{
+		int iBegin = i * iBatchSize;
+		int iEnd = (std::min)(iBegin + iBatchSize, iCount);
+		if (iBegin < iEnd)
+		{
+			threads.emplace_back(function, iBegin, iEnd);
+		}
+	}
+
+	function(0, (std::min)(iBatchSize, iCount));
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+}
+
 #endif
@@ -0,0 +1,541 @@
+//
+// VegetationScatter.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Fast Poisson Disk Sampling in Arbitrary Dimensions (Bridson, 2007)
+// GPU-Based Procedural Placement in Horizon Zero Dawn (van Muijden, 2017)
+// MurmurHash3 (Appleby) (https://github.com/aappleby/smhasher)
+//
+
+#include "VegetationScatter.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+#include <random>
+
+namespace
+{
+	const float ChunkSize = 8.0f; // World units along each side of a chunk
+	const int PatternAttempts = 30; // Candidates tried around each point before it stops growing the pattern
+	const float MaxFraction = 65535.0f; // Of the 16 bit fractions packed into instances
+
+	unsigned int Mix(unsigned int h)
+	{
+		h ^= h >> 16;
+		h *= 0x85EBCA6Bu;
+		h ^= h >> 13;
+		h *= 0xC2B2AE35u;
+		h ^= h >> 16;
+		return h;
+	}
+
+	float GetChunkDistance(int iX, int iZ, const XMFLOAT3& position) // From the position to the nearest point of the chunk, across the ground
+	{
+		float fDeltaX = (std::max)((std::max)(iX * ChunkSize - position.x, position.x - (iX + 1) * ChunkSize), 0.0f);
+		float fDeltaZ = (std::max)((std::max)(iZ * ChunkSize - position.z, position.z - (iZ + 1) * ChunkSize), 0.0f);
+		return sqrtf(fDeltaX * fDeltaX + fDeltaZ * fDeltaZ);
+	}
+}
+
+#pragma region DensityMap
+
+DensityMap::DensityMap()
+{
+	m_fMinX = 0.0f;
+	m_fMinZ = 0.0f;
+	m_fMaxX = 0.0f;
+	m_fMaxZ = 0.0f;
+	m_iWidth = 0;
+	m_iHeight = 0;
+	m_fPaintedMinX = FLT_MAX;
+	m_fPaintedMinZ = FLT_MAX;
+	m_fPaintedMaxX = -FLT_MAX;
+	m_fPaintedMaxZ = -FLT_MAX;
+}
+
+void DensityMap::Initialize(float fMinX, float fMinZ, float fMaxX, float fMaxZ, int iWidth, int iHeight)
+{
+	m_fMinX = fMinX;
+	m_fMinZ = fMinZ;
+	m_fMaxX = fMaxX;
+	m_fMaxZ = fMaxZ;
+	m_iWidth = (std::max)(iWidth, 2);
+	m_iHeight = (std::max)(iHeight, 2);
+	m_densities.assign(m_iWidth * m_iHeight, 0.0f);
+	m_fPaintedMinX = FLT_MAX;
+	m_fPaintedMinZ = FLT_MAX;
+	m_fPaintedMaxX = -FLT_MAX;
+	m_fPaintedMaxZ = -FLT_MAX;
+}
+
+void DensityMap::PaintDisc(float fX, float fZ, float fRadius, float fFalloff, float fDensity)
+{
+	Paint(fX, fZ, 0.0f, fRadius, fFalloff, fDensity);
+}
+
+void DensityMap::PaintRing(float fX, float fZ, float fInnerRadius, float fOuterRadius, float fFalloff, float fDensity)
+{
+	Paint(fX, fZ, fInnerRadius, fOuterRadius, fFalloff, fDensity);
+}
+
+void DensityMap::Paint(float fX, float fZ, float fInnerRadius, float fOuterRadius, float fFalloff, float fDensity)
+{
+	float fReach = fOuterRadius + fFalloff;
+	float fSpacingX = (m_fMaxX - m_fMinX) / (m_iWidth - 1);
+	float fSpacingZ = (m_fMaxZ - m_fMinZ) / (m_iHeight - 1);
+	int iMinX = (std::max)((int)ceilf((fX - fReach - m_fMinX) / fSpacingX), 0);
+	int iMaxX = (std::min)((int)floorf((fX + fReach - m_fMinX) / fSpacingX), m_iWidth - 1);
+	int iMinZ = (std::max)((int)ceilf((fZ - fReach - m_fMinZ) / fSpacingZ), 0);
+	int iMaxZ = (std::min)((int)floorf((fZ + fReach - m_fMinZ) / fSpacingZ), m_iHeight - 1);
+	for (int z = iMinZ; z <= iMaxZ; z++)
+	{
+		for (int x = iMinX; x <= iMaxX; x++)
+		{
+			// Full density between the radii, fading to nothing over the falloff either side
+			float fDeltaX = m_fMinX + x * fSpacingX - fX;
+			float fDeltaZ = m_fMinZ + z * fSpacingZ - fZ;
+			float fDistance = sqrtf(fDeltaX * fDeltaX + fDeltaZ * fDeltaZ);
+			float fOutside = (std::max)(fInnerRadius - fDistance, fDistance - fOuterRadius);
+			float fCoverage = (fOutside <= 0.0f) ? 1.0f : (fFalloff > 0.0f) ? (std::max)(1.0f - fOutside / fFalloff, 0.0f) : 0.0f;
+			float& fValue = m_densities[z * m_iWidth + x];
+			fValue = (std::max)(fValue, fDensity * fCoverage);
+		}
+	}
+
+	m_fPaintedMinX = (std::min)(m_fPaintedMinX, fX - fReach);
+	m_fPaintedMinZ = (std::min)(m_fPaintedMinZ, fZ - fReach);
+	m_fPaintedMaxX = (std::max)(m_fPaintedMaxX, fX + fReach);
+	m_fPaintedMaxZ = (std::max)(m_fPaintedMaxZ, fZ + fReach);
+}
+
+float DensityMap::Sample(float fX, float fZ) const
+{
+	if (m_densities.empty() || fX < m_fMinX || fX > m_fMaxX || fZ < m_fMinZ || fZ > m_fMaxZ)
+	{
+		return 0.0f;
+	}
+
+	float fU = (fX - m_fMinX) / (m_fMaxX - m_fMinX) * (m_iWidth - 1);
+	float fV = (fZ - m_fMinZ) / (m_fMaxZ - m_fMinZ) * (m_iHeight - 1);
+	int x = (std::min)((int)fU, m_iWidth - 2);
+	int z = (std::min)((int)fV, m_iHeight - 2);
+	fU -= x;
+	fV -= z;
+	const float* row = &m_densities[z * m_iWidth + x];
+	float fNear = row[0] + (row[1] - row[0]) * fU;
+	float fFar = row[m_iWidth] + (row[m_iWidth + 1] - row[m_iWidth]) * fU;
+	return fNear + (fFar - fNear) * fV;
+}
+
+bool DensityMap::Overlaps(float fMinX, float fMinZ, float fMaxX, float fMaxZ) const
+{
+	return fMaxX >= (std::max)(m_fMinX, m_fPaintedMinX) && fMinX <= (std::min)(m_fMaxX, m_fPaintedMaxX) &&
+		fMaxZ >= (std::max)(m_fMinZ, m_fPaintedMinZ) && fMinZ <= (std::min)(m_fMaxZ, m_fPaintedMaxZ);
+}
+
+float DensityMap::GetMinX() const
+{
+	return m_fMinX;
+}
+
+float DensityMap::GetMinZ() const
+{
+	return m_fMinZ;
+}
+
+float DensityMap::GetMaxX() const
+{
+	return m_fMaxX;
+}
+
+float DensityMap::GetMaxZ() const
+{
+	return m_fMaxZ;
+}
+
+#pragma endregion
+
+#pragma region Init
+
+VegetationScatter::VegetationScatter()
+{
+	m_settings = {};
+	m_fStreamRadius = 0.0f;
+	m_iThreadCount = 0;
+	m_fInstanceRadius = 0.0f;
+	m_bChunksChanged = false;
+	m_bMissingChunksFound = false;
+	m_iCameraChunkX = 0;
+	m_iCameraChunkZ = 0;
+}
+
+bool VegetationScatter::Initialize(const ScatterSettings& settings, const DensityMap& densityMap, float fStreamRadius, int iThreadCount)
+{
+	// The pattern wraps around the chunk, which only keeps its spacing when the chunk is several spacings across
+	if (settings.fMinDistance <= 0.0f || settings.fMinDistance * 4.0f > ChunkSize)
+	{
+		return false;
+	}
+
+	m_settings = settings;
+	m_densityMap = densityMap;
+	m_fStreamRadius = fStreamRadius;
+	m_iThreadCount = iThreadCount;
+	m_generatedSlots.reserve(MaxChunksPerUpdate);
+	GeneratePattern();
+	return true;
+}
+
+void VegetationScatter::GeneratePattern()
+{
+	// Positions are fractions of the chunk, wrapped into [0, 1), and the grid's cells are small enough to hold one point each
+	float fRadius = m_settings.fMinDistance / ChunkSize;
+	int iGridSize = (int)(sqrtf(2.0f) / fRadius);
+	std::vector<int> grid(iGridSize * iGridSize, -1);
+	std::mt19937 generator(m_settings.uiSeed);
+	std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+
+	m_pattern.clear();
+	std::vector<int> active;
+	auto addPoint = [&](float fX, float fZ)
+	{
+		grid[(std::min)((int)(fZ * iGridSize), iGridSize - 1) * iGridSize + (std::min)((int)(fX * iGridSize), iGridSize - 1)] = (int)m_pattern.size();
+		active.push_back((int)m_pattern.size());
+		m_pattern.push_back(XMFLOAT3(fX, 0.0f, fZ));
+	};
+	addPoint(distribution(generator), distribution(generator));
+
+	while (!active.empty())
+	{
+		int iActive = (int)(distribution(generator) * active.size()) % (int)active.size();
+		XMFLOAT3 point = m_pattern[active[iActive]];
+
+		// Candidates are spread evenly over the ring between one and two radii around the point
+		bool bFound = false;
+		for (int i = 0; i < PatternAttempts && !bFound; i++)
+		{
+			float fAngle = distribution(generator) * XM_2PI;
+			float fDistance = fRadius * sqrtf(1.0f + 3.0f * distribution(generator));
+			float fX = point.x + cosf(fAngle) * fDistance;
+			float fZ = point.z + sinf(fAngle) * fDistance;
+			fX -= floorf(fX);
+			fZ -= floorf(fZ);
+			if (fX >= 1.0f || fZ >= 1.0f)
+			{
+				continue; // Rounded up from just under zero
+			}
+
+			// Any point nearer than the radius, around the wrapped edges too, is within two cells
+			int iCellX = (std::min)((int)(fX * iGridSize), iGridSize - 1);
+			int iCellZ = (std::min)((int)(fZ * iGridSize), iGridSize - 1);
+			bool bClear = true;
+			for (int z = iCellZ - 2; z <= iCellZ + 2 && bClear; z++)
+			{
+				for (int x = iCellX - 2; x <= iCellX + 2 && bClear; x++)
+				{
+					int iPoint = grid[((z + iGridSize) % iGridSize) * iGridSize + (x + iGridSize) % iGridSize];
+					if (iPoint >= 0)
+					{
+						float fDeltaX = fabsf(m_pattern[iPoint].x - fX);
+						float fDeltaZ = fabsf(m_pattern[iPoint].z - fZ);
+						fDeltaX = (std::min)(fDeltaX, 1.0f - fDeltaX);
+						fDeltaZ = (std::min)(fDeltaZ, 1.0f - fDeltaZ);
+						bClear = fDeltaX * fDeltaX + fDeltaZ * fDeltaZ >= fRadius * fRadius;
+					}
+				}
+			}
+
+			if (bClear)
+			{
+				addPoint(fX, fZ);
+				bFound = true;
+			}
+		}
+
+		if (!bFound)
+		{
+			active[iActive] = active.back();
+			active.pop_back();
+		}
+	}
+
+	// Ranks are shuffled so that thinning by the density drops points evenly over the chunk
+	for (auto& point : m_pattern)
+	{
+		point.y = distribution(generator);
+	}
+}
+
+#pragma endregion
+
+#pragma region Setters/Getters
+
+void VegetationScatter::SetInstanceRadius(float fRadius)
+{
+	m_fInstanceRadius = fRadius;
+}
+
+const std::vector<int>& VegetationScatter::GetVisibleChunks()
+{
+	return m_visibleChunks;
+}
+
+void VegetationScatter::GetResidentChunks(std::vector<int>& chunks)
+{
+	chunks.clear();
+	for (const auto& slot : m_chunkSlots)
+	{
+		chunks.push_back(slot.second);
+	}
+	std::sort(chunks.begin(), chunks.end());
+}
+
+const ScatterChunk& VegetationScatter::GetChunk(int iChunk)
+{
+	return m_chunks[iChunk];
+}
+
+int VegetationScatter::GetPatternSize()
+{
+	return (int)m_pattern.size();
+}
+
+size_t VegetationScatter::GetMemoryUsage()
+{
+	size_t size = m_pattern.capacity() * sizeof(XMFLOAT3) + m_chunks.capacity() * sizeof(ScatterChunk);
+	for (const auto& chunk : m_chunks)
+	{
+		size += chunk.instances.capacity() * sizeof(ScatterInstance);
+	}
+	return size;
+}
+
+float VegetationScatter::GetChunkSize()
+{
+	return ChunkSize;
+}
+
+long long VegetationScatter::GetChunkKey(int iX, int iZ)
+{
+	return ((long long)iX << 32) | (unsigned int)iZ;
+}
+
+unsigned int VegetationScatter::Hash(unsigned int a, unsigned int b, unsigned int c)
+{
+	return Mix(Mix(Mix(c) ^ (a * 0x9E3779B1u)) ^ (b * 0x85EBCA77u));
+}
+
+#pragma endregion
+
+#pragma region Update
+
+void VegetationScatter::Load(const XMFLOAT3& cameraPosition)
+{
+	FindMissingChunks(cameraPosition);
+	GenerateMissingChunks((int)m_missingChunks.size());
+}
+
+int VegetationScatter::Update(const XMFLOAT3& cameraPosition)
+{
+	// The chunks to keep and make are only found again once the camera crosses into another chunk; until then the rest of those missing are made
+	if (!m_bMissingChunksFound || (int)floorf(cameraPosition.x / ChunkSize) != m_iCameraChunkX || (int)floorf(cameraPosition.z / ChunkSize) != m_iCameraChunkZ)
+	{
+		FindMissingChunks(cameraPosition);
+	}
+	GenerateMissingChunks(MaxChunksPerUpdate);
+	return (int)m_missingChunks.size();
+}
+
+void VegetationScatter::FindMissingChunks(const XMFLOAT3& cameraPosition)
+{
+	// Chunks are kept until they are a chunk beyond the stream radius, so that those near its edge aren't dropped and made again as the camera wanders
+	for (auto it = m_chunkSlots.begin(); it != m_chunkSlots.end();)
+	{
+		const ScatterChunk& chunk = m_chunks[it->second];
+		if (GetChunkDistance(chunk.iX, chunk.iZ, cameraPosition) > m_fStreamRadius + ChunkSize)
+		{
+			m_freeChunks.push_back(it->second);
+			it = m_chunkSlots.erase(it);
+			m_bChunksChanged = true;
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	// Missing chunks within the radius, farthest first so the nearest are taken off the back; those off the density map would be empty, so are never made
+	m_missingChunks.clear();
+	int iMinX = (int)floorf((cameraPosition.x - m_fStreamRadius) / ChunkSize);
+	int iMaxX = (int)floorf((cameraPosition.x + m_fStreamRadius) / ChunkSize);
+	int iMinZ = (int)floorf((cameraPosition.z - m_fStreamRadius) / ChunkSize);
+	int iMaxZ = (int)floorf((cameraPosition.z + m_fStreamRadius) / ChunkSize);
+	for (int z = iMinZ; z <= iMaxZ; z++)
+	{
+		for (int x = iMinX; x <= iMaxX; x++)
+		{
+			float fDistance = GetChunkDistance(x, z, cameraPosition);
+			if (fDistance <= m_fStreamRadius && m_chunkSlots.find(GetChunkKey(x, z)) == m_chunkSlots.end() &&
+				m_densityMap.Overlaps(x * ChunkSize, z * ChunkSize, (x + 1) * ChunkSize, (z + 1) * ChunkSize))
+			{
+				m_missingChunks.push_back(std::make_pair(fDistance, GetChunkKey(x, z)));
+			}
+		}
+	}
+	std::sort(m_missingChunks.begin(), m_missingChunks.end(), std::greater<std::pair<float, long long>>());
+
+	m_iCameraChunkX = (int)floorf(cameraPosition.x / ChunkSize);
+	m_iCameraChunkZ = (int)floorf(cameraPosition.z / ChunkSize);
+	m_bMissingChunksFound = true;
+}
+
+void VegetationScatter::GenerateMissingChunks(int iMaxCount)
+{
+	// Slots are taken before generating, so the chunks can be made in parallel
+	int iGenerateCount = (std::min)((int)m_missingChunks.size(), iMaxCount);
+	m_generatedSlots.resize(iGenerateCount);
+	for (int i = 0; i < iGenerateCount; i++)
+	{
+		if (m_freeChunks.empty())
+		{
+			m_freeChunks.push_back((int)m_chunks.size());
+			m_chunks.emplace_back();
+		}
+		m_generatedSlots[i] = m_freeChunks.back();
+		m_freeChunks.pop_back();
+
+		long long key = m_missingChunks[m_missingChunks.size() - 1 - i].second;
+		ScatterChunk& chunk = m_chunks[m_generatedSlots[i]];
+		chunk.iX = (int)(key >> 32);
+		chunk.iZ = (int)(unsigned int)key;
+		m_chunkSlots[key] = m_generatedSlots[i];
+	}
+
+	Utils::ParallelFor(iGenerateCount, m_iThreadCount, [&](int iBegin, int iEnd)
+	{
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			ScatterChunk& chunk = m_chunks[m_generatedSlots[i]];
+			GenerateChunk(chunk.iX, chunk.iZ, chunk.instances);
+		}
+	}, 2);
+
+	m_missingChunks.resize(m_missingChunks.size() - iGenerateCount);
+	m_bChunksChanged |= iGenerateCount > 0;
+}
+
+void VegetationScatter::GenerateChunk(int iX, int iZ, std::vector<ScatterInstance>& instances)
+{
+	instances.clear();
+	float fOriginX = iX * ChunkSize;
+	float fOriginZ = iZ * ChunkSize;
+	if (!m_densityMap.Overlaps(fOriginX, fOriginZ, fOriginX + ChunkSize, fOriginZ + ChunkSize))
+	{
+		return;
+	}
+
+	// The ranks are turned by a different amount in each chunk, so that an even density doesn't keep the same points in every one
+	float fRankOffset = (Hash(iX, iZ, m_settings.uiSeed) >> 8) / 16777216.0f;
+	for (int i = 0; i < (int)m_pattern.size(); i++)
+	{
+		const XMFLOAT3& point = m_pattern[i];
+		float fRank = point.y + fRankOffset;
+		fRank -= (fRank >= 1.0f) ? 1.0f : 0.0f;
+		if (fRank >= m_densityMap.Sample(fOriginX + point.x * ChunkSize, fOriginZ + point.z * ChunkSize))
+		{
+			continue;
+		}
+
+		unsigned int uiHash = Hash(iX, iZ, m_settings.uiSeed + 1 + i);
+		ScatterInstance instance;
+		instance.usX = (unsigned short)(point.x * MaxFraction + 0.5f);
+		instance.usZ = (unsigned short)(point.z * MaxFraction + 0.5f);
+		instance.usYaw = (unsigned short)(uiHash & 0xFFFF);
+		instance.usScale = (unsigned short)(uiHash >> 16);
+		instances.push_back(instance);
+	}
+
+	// Trimmed, as the resident chunks may hold millions of instances between them
+	if (instances.capacity() > instances.size() + instances.size() / 4)
+	{
+		std::vector<ScatterInstance>(instances).swap(instances);
+	}
+}
+
+bool VegetationScatter::CullChunks(const XMMATRIX& viewProjectionMatrix, const XMFLOAT3& cameraPosition)
+{
+	XMFLOAT4 frustumPlanes[6];
+	MeshletBuilder::GetFrustumPlanes(viewProjectionMatrix, frustumPlanes);
+
+	// Each chunk is bounded by its ground, grown by the largest instance's bounds
+	float fMargin = m_fInstanceRadius * m_settings.fMaxScale;
+	std::vector<std::pair<float, int>> chunks;
+	for (const auto& slot : m_chunkSlots)
+	{
+		const ScatterChunk& chunk = m_chunks[slot.second];
+		if (chunk.instances.empty())
+		{
+			continue;
+		}
+
+		XMFLOAT3 minimum(chunk.iX * ChunkSize - fMargin, m_settings.fHeight - fMargin, chunk.iZ * ChunkSize - fMargin);
+		XMFLOAT3 maximum((chunk.iX + 1) * ChunkSize + fMargin, m_settings.fHeight + fMargin, (chunk.iZ + 1) * ChunkSize + fMargin);
+		bool bInView = true;
+		for (int i = 0; i < 6 && bInView; i++)
+		{
+			// Outside if the corner farthest along the plane's normal is behind it
+			const XMFLOAT4& plane = frustumPlanes[i];
+			bInView = plane.x * ((plane.x > 0.0f) ? maximum.x : minimum.x) + plane.y * ((plane.y > 0.0f) ? maximum.y : minimum.y) +
+				plane.z * ((plane.z > 0.0f) ? maximum.z : minimum.z) + plane.w >= 0.0f;
+		}
+
+		if (bInView)
+		{
+			chunks.push_back(std::make_pair(GetChunkDistance(chunk.iX, chunk.iZ, cameraPosition), slot.second));
+		}
+	}
+	std::sort(chunks.begin(), chunks.end());
+
+	std::vector<int> visibleChunks(chunks.size());
+	for (int i = 0; i < (int)chunks.size(); i++)
+	{
+		visibleChunks[i] = chunks[i].second;
+	}
+
+	bool bChanged = m_bChunksChanged || visibleChunks != m_visibleChunks;
+	m_visibleChunks.swap(visibleChunks);
+	m_bChunksChanged = false;
+	return bChanged;
+}
+
+void VegetationScatter::GetInstances(const std::vector<int>& chunks, int iMaxCount, std::vector<Instance>& instances)
+{
+	instances.clear();
+	XMMATRIX modelMatrix = XMLoadFloat4x4(&m_settings.modelMatrix);
+	float fScaleRange = m_settings.fMaxScale - m_settings.fMinScale;
+	for (int iChunk : chunks)
+	{
+		const ScatterChunk& chunk = m_chunks[iChunk];
+		for (const auto& scatterInstance : chunk.instances)
+		{
+			if ((int)instances.size() >= iMaxCount)
+			{
+				return;
+			}
+
+			float fScale = m_settings.fMinScale + fScaleRange * (scatterInstance.usScale / MaxFraction);
+			float fYaw = XM_2PI * (scatterInstance.usYaw / (MaxFraction + 1.0f));
+			float fX = (chunk.iX + scatterInstance.usX / MaxFraction) * ChunkSize;
+			float fZ = (chunk.iZ + scatterInstance.usZ / MaxFraction) * ChunkSize;
+
+			Instance instance;
+			instance.worldMatrix = XMMatrixTranspose(modelMatrix * XMMatrixScaling(fScale, fScale, fScale) * XMMatrixRotationY(fYaw) * XMMatrixTranslation(fX, m_settings.fHeight, fZ));
+			instance.uiTextureSlice = 0;
+			instances.push_back(instance);
+		}
+	}
+}
+
+#pragma endregion
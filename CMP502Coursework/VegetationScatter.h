@@ -0,0 +1,130 @@
+//
+// VegetationScatter.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+// Reference:
+// Fast Poisson Disk Sampling in Arbitrary Dimensions (Bridson, 2007)
+// GPU-Based Procedural Placement in Horizon Zero Dawn (van Muijden, 2017)
+//
+
+#ifndef VEGETATION_SCATTER_H
+#define VEGETATION_SCATTER_H
+
+#include <directxmath.h>
+#include <unordered_map>
+#include <vector>
+#include "InstancePacker.h"
+#include "MeshletBuilder.h"
+#include "Utils.h"
+
+using namespace DirectX;
+
+// How densely a plant grows over a rectangle of the ground, from 0 (never) to 1 (as densely as its spacing allows), and 0 outside it
+class DensityMap
+{
+public:
+	DensityMap();
+
+	void Initialize(float fMinX, float fMinZ, float fMaxX, float fMaxZ, int iWidth, int iHeight); // Cleared to 0
+	void PaintDisc(float fX, float fZ, float fRadius, float fFalloff, float fDensity); // Fades out over the falloff outside the radius; keeps the denser of the two
+	void PaintRing(float fX, float fZ, float fInnerRadius, float fOuterRadius, float fFalloff, float fDensity); // Fades out over the falloff on both sides
+	float Sample(float fX, float fZ) const; // Bilinear
+	bool Overlaps(float fMinX, float fMinZ, float fMaxX, float fMaxZ) const; // Whether the rectangle reaches anything painted
+
+	float GetMinX() const;
+	float GetMinZ() const;
+	float GetMaxX() const;
+	float GetMaxZ() const;
+
+private:
+	float m_fMinX;
+	float m_fMinZ;
+	float m_fMaxX;
+	float m_fMaxZ;
+	int m_iWidth;
+	int m_iHeight;
+	std::vector<float> m_densities; // Row by row from the minimum z, sampled at the corners of the cells
+	float m_fPaintedMinX; // Bounds of everything painted, so that empty chunks are skipped without sampling
+	float m_fPaintedMinZ;
+	float m_fPaintedMaxX;
+	float m_fPaintedMaxZ;
+
+	void Paint(float fX, float fZ, float fInnerRadius, float fOuterRadius, float fFalloff, float fDensity);
+};
+
+struct ScatterSettings
+{
+	float fMinDistance; // Between any two instances (the Poisson disk radius)
+	float fMinScale; // Each instance is scaled uniformly by a random amount between these, and turned a random amount about y
+	float fMaxScale;
+	float fHeight; // Of the ground the instances stand on
+	XMFLOAT4X4 modelMatrix; // Placement of the model within an instance, before its scale, turn and position
+	unsigned int uiSeed;
+};
+
+struct ScatterInstance // Eight bytes: the position within its chunk, and the turn and scale, as 16 bit fractions of their ranges
+{
+	unsigned short usX;
+	unsigned short usZ;
+	unsigned short usYaw;
+	unsigned short usScale;
+};
+
+struct ScatterChunk
+{
+	int iX; // Chunk coordinates, in chunk sizes from the origin
+	int iZ;
+	std::vector<ScatterInstance> instances;
+};
+
+// Places the instances of one plant over the ground in chunks of a grid, generated as the camera comes near and dropped once it is far away
+// A single Poisson disk pattern is made on a torus the size of a chunk, so that it tiles without any two instances closer than the spacing,
+// and each chunk keeps the points of it whose random rank is under the density there; thinning a Poisson disk set keeps its spacing
+class VegetationScatter
+{
+public:
+	VegetationScatter();
+
+	bool Initialize(const ScatterSettings& settings, const DensityMap& densityMap, float fStreamRadius, int iThreadCount = 0); // false if the spacing is too large for a chunk
+	void Load(const XMFLOAT3& cameraPosition); // Generates every chunk within the stream radius at once, for loading
+	int Update(const XMFLOAT3& cameraPosition); // Generates the nearest chunks missing within the stream radius, a few at a time, and drops far ones; returns how many are still missing
+	bool CullChunks(const XMMATRIX& viewProjectionMatrix, const XMFLOAT3& cameraPosition); // Picks the chunks in view, nearest first; true if they (or their instances) changed
+	void GetInstances(const std::vector<int>& chunks, int iMaxCount, std::vector<Instance>& instances); // Expands the chunks' instances, in order, up to the count
+	void GenerateChunk(int iX, int iZ, std::vector<ScatterInstance>& instances);
+
+	void SetInstanceRadius(float fRadius); // Of the model's bounds around an instance's position at scale one, for culling chunks
+	const std::vector<int>& GetVisibleChunks(); // Picked by the last cull
+	void GetResidentChunks(std::vector<int>& chunks); // Every chunk generated and not yet dropped
+	const ScatterChunk& GetChunk(int iChunk);
+	int GetPatternSize(); // Points in the pattern, which a chunk keeps some of
+	size_t GetMemoryUsage(); // Bytes of the resident chunks and the pattern
+	static float GetChunkSize(); // World units along each side of a chunk
+
+	static const int MaxChunksPerUpdate = 8; // Generated by one update, so that walking into new ground doesn't stall a frame
+
+private:
+	ScatterSettings m_settings;
+	DensityMap m_densityMap;
+	float m_fStreamRadius;
+	int m_iThreadCount;
+	float m_fInstanceRadius;
+	std::vector<XMFLOAT3> m_pattern; // x and z within a chunk, as fractions of its size, and the rank (y) under which the density keeps the point
+	std::vector<ScatterChunk> m_chunks; // Slots reused as chunks are dropped and generated, so their instance storage is too
+	std::vector<int> m_freeChunks;
+	std::unordered_map<long long, int> m_chunkSlots; // Slot of each resident chunk, by its coordinates
+	std::vector<int> m_visibleChunks;
+	bool m_bChunksChanged; // Since the last cull
+	std::vector<std::pair<float, long long>> m_missingChunks; // Distance and coordinates of the chunks left to make, farthest first
+	bool m_bMissingChunksFound;
+	int m_iCameraChunkX; // Chunk the camera was in when the missing chunks were found
+	int m_iCameraChunkZ;
+	std::vector<int> m_generatedSlots; // Of the chunks being generated, kept so updates don't allocate
+
+	void GeneratePattern(); // Bridson's algorithm, wrapping around the chunk's edges
+	void FindMissingChunks(const XMFLOAT3& cameraPosition); // Drops the far chunks, and lists those missing within the stream radius
+	void GenerateMissingChunks(int iMaxCount); // The nearest of those listed
+	static long long GetChunkKey(int iX, int iZ);
+	static unsigned int Hash(unsigned int a, unsigned int b, unsigned int c);
+};
+
+#endif
@@ -0,0 +1,134 @@
+//
+// WorkerPool.cpp
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+
+#include "WorkerPool.h"
+#include <algorithm>
+
+#pragma region Init
+
+WorkerPool::WorkerPool()
+{
+	m_bStopping = false;
+	m_pFunction = nullptr;
+	m_iCount = 0;
+	m_iBatchSize = 0;
+	m_iBatchCount = 0;
+	m_iNextBatch = 0;
+	m_iPendingBatches = 0;
+}
+
+WorkerPool::~WorkerPool()
+{
+	Stop();
+}
+
+bool WorkerPool::Initialize(int iThreadCount)
+{
+	Stop();
+
+	if (iThreadCount <= 0)
+	{
+		iThreadCount = (std::max)(1, (int)std::thread::hardware_concurrency());
+	}
+
+	m_bStopping = false;
+	for (int i = 1; i < iThreadCount; i++)
+	{
+		m_workers.emplace_back(&WorkerPool::WorkerThread, this);
+	}
+
+	return true;
+}
+
+void WorkerPool::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_condition.notify_all();
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+}
+
+#pragma endregion
+
+#pragma region Work
+
+void WorkerPool::ParallelFor(int iCount, const std::function<void(int, int)>& function, int iMinParallelCount)
+{
+	int iThreadCount = GetThreadCount();
+	if (iThreadCount == 1 || iCount < (std::max)(iMinParallelCount, 2))
+	{
+		function(0, iCount);
+		return;
+	}
+
+	// The calling thread takes the first batch, as in Utils::ParallelFor, and the workers share the rest
+	int iBatchSize = (iCount + iThreadCount - 1) / iThreadCount;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pFunction = &function;
+		m_iCount = iCount;
+		m_iBatchSize = iBatchSize;
+		m_iBatchCount = (iCount + iBatchSize - 1) / iBatchSize;
+		m_iNextBatch = 1;
+		m_iPendingBatches = m_iBatchCount - 1;
+	}
+	m_condition.notify_all();
+
+	function(0, iBatchSize);
+
+	// Once every batch is done no worker can take another, so the function may go out of scope
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this] { return m_iPendingBatches == 0; });
+	m_pFunction = nullptr;
+}
+
+void WorkerPool::WorkerThread()
+{
+	for (;;)
+	{
+		int iBegin, iEnd;
+		const std::function<void(int, int)>* pFunction = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this] { return m_bStopping || m_iNextBatch < m_iBatchCount; });
+			if (m_bStopping)
+			{
+				return;
+			}
+			iBegin = m_iNextBatch++ * m_iBatchSize;
+			iEnd = (std::min)(iBegin + m_iBatchSize, m_iCount);
+			pFunction = m_pFunction;
+		}
+
+		(*pFunction)(iBegin, iEnd);
+
+		bool bDone = false;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			bDone = --m_iPendingBatches == 0;
+		}
+		if (bDone)
+		{
+			m_doneCondition.notify_one();
+		}
+	}
+}
+
+#pragma endregion
+
+#pragma region Getters
+
+int WorkerPool::GetThreadCount() const
+{
+	return (int)m_workers.size() + 1;
+}
+
+#pragma endregion
@@ -0,0 +1,46 @@
+//
+// WorkerPool.h
+// Copyright  2018 Diel Barnes. All rights reserved.
+//
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads kept waiting between calls, for passes run every frame where Utils::ParallelFor would start and join threads each time
+class WorkerPool
+{
+public:
+	WorkerPool();
+	~WorkerPool();
+
+	bool Initialize(int iThreadCount); // 0 uses every core; the calling thread counts as one, so 1 starts no workers
+	void ParallelFor(int iCount, const std::function<void(int, int)>& function, int iMinParallelCount = 64); // Batches as Utils::ParallelFor does, returning when all are done
+
+	int GetThreadCount() const;
+
+private:
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_condition; // Wakes the workers for a new call, or to stop
+	std::condition_variable m_doneCondition; // Wakes the caller when the last batch is done
+	bool m_bStopping;
+
+	// The current call; batch i spans [i * m_iBatchSize, (i + 1) * m_iBatchSize) clamped to m_iCount
+	const std::function<void(int, int)>* m_pFunction;
+	int m_iCount;
+	int m_iBatchSize;
+	int m_iBatchCount;
+	int m_iNextBatch;
+	int m_iPendingBatches; // Taken by workers and not yet done
+
+	void Stop();
+	void WorkerThread();
+};
+
+#endif